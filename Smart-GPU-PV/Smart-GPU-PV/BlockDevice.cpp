@@ -0,0 +1,461 @@
+﻿/********************************************************************************
+* 文件名称：BlockDevice.cpp
+* 文件功能：实现可移植的文件随机读写、原始镜像块设备及LRU块缓存
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "BlockDevice.h"
+#include <cstring>
+#include <iterator>
+#include <cstdio>
+#include <mutex>
+#include <random>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#endif
+
+// 单次系统调用读写的最大字节数（ReadFile/WriteFile的长度是DWORD）
+static const size_t MAX_IO_CHUNK = 64 * 1024 * 1024;
+
+#ifdef _WIN32
+
+/********************************************************************************
+* 函数实现：打开文件（Windows）
+*********************************************************************************/
+bool RawFile::Open(const std::string& strPath, bool bReadOnly, std::string& strError) {
+    Close();
+    m_strPath = strPath;
+    m_bReadOnly = bReadOnly;
+
+    int nChars = MultiByteToWideChar(CP_UTF8, 0, strPath.c_str(), -1, nullptr, 0);
+    std::wstring wstrPath(nChars > 0 ? nChars : 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, strPath.c_str(), -1, &wstrPath[0], nChars);
+
+    HANDLE hFile = CreateFileW(wstrPath.c_str(), bReadOnly ? GENERIC_READ : (GENERIC_READ | GENERIC_WRITE),
+                               FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        strError = "无法打开文件 " + strPath + "（错误码 " + std::to_string(GetLastError()) + "）";
+        return false;
+    }
+    LARGE_INTEGER liSize = { 0 };
+    if (!GetFileSizeEx(hFile, &liSize)) {
+        strError = "无法获取文件大小 " + strPath + "（错误码 " + std::to_string(GetLastError()) + "）";
+        CloseHandle(hFile);
+        return false;
+    }
+    m_hFile = hFile;
+    m_ui64Size = static_cast<uint64_t>(liSize.QuadPart);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：关闭文件（Windows）
+*********************************************************************************/
+void RawFile::Close() {
+    if (m_hFile) {
+        CloseHandle(static_cast<HANDLE>(m_hFile));
+        m_hFile = nullptr;
+    }
+    m_ui64Size = 0;
+}
+
+bool RawFile::IsOpen() const {
+    return m_hFile != nullptr;
+}
+
+/********************************************************************************
+* 函数实现：按偏移读取（Windows）
+*********************************************************************************/
+bool RawFile::ReadAt(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) {
+    char* pDest = static_cast<char*>(pBuffer);
+    while (nBytes > 0) {
+        DWORD dwChunk = static_cast<DWORD>(nBytes > MAX_IO_CHUNK ? MAX_IO_CHUNK : nBytes);
+        OVERLAPPED stcOverlapped = { 0 };
+        stcOverlapped.Offset = static_cast<DWORD>(ui64Offset);
+        stcOverlapped.OffsetHigh = static_cast<DWORD>(ui64Offset >> 32);
+        DWORD dwRead = 0;
+        if (!ReadFile(static_cast<HANDLE>(m_hFile), pDest, dwChunk, &dwRead, &stcOverlapped)) {
+            DWORD dwError = GetLastError();
+            if (dwError != ERROR_HANDLE_EOF) {
+                strError = "读取失败 " + m_strPath + "（错误码 " + std::to_string(dwError) + "）";
+                return false;
+            }
+        }
+        if (dwRead == 0) {
+            strError = "读取超出文件末尾 " + m_strPath + "（偏移 " + std::to_string(ui64Offset) + "）";
+            return false;
+        }
+        pDest += dwRead;
+        ui64Offset += dwRead;
+        nBytes -= dwRead;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：按偏移写入（Windows）
+*********************************************************************************/
+bool RawFile::WriteAt(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) {
+    if (m_bReadOnly) {
+        strError = "文件以只读方式打开 " + m_strPath;
+        return false;
+    }
+    const char* pSource = static_cast<const char*>(pBuffer);
+    while (nBytes > 0) {
+        DWORD dwChunk = static_cast<DWORD>(nBytes > MAX_IO_CHUNK ? MAX_IO_CHUNK : nBytes);
+        OVERLAPPED stcOverlapped = { 0 };
+        stcOverlapped.Offset = static_cast<DWORD>(ui64Offset);
+        stcOverlapped.OffsetHigh = static_cast<DWORD>(ui64Offset >> 32);
+        DWORD dwWritten = 0;
+        if (!WriteFile(static_cast<HANDLE>(m_hFile), pSource, dwChunk, &dwWritten, &stcOverlapped) || dwWritten == 0) {
+            strError = "写入失败 " + m_strPath + "（错误码 " + std::to_string(GetLastError()) + "）";
+            return false;
+        }
+        pSource += dwWritten;
+        ui64Offset += dwWritten;
+        nBytes -= dwWritten;
+    }
+    if (ui64Offset > m_ui64Size) {
+        m_ui64Size = ui64Offset;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：设置文件大小（Windows）
+*********************************************************************************/
+bool RawFile::Resize(uint64_t ui64Size, std::string& strError) {
+    FILE_END_OF_FILE_INFO stcInfo = { 0 };
+    stcInfo.EndOfFile.QuadPart = static_cast<LONGLONG>(ui64Size);
+    if (!SetFileInformationByHandle(static_cast<HANDLE>(m_hFile), FileEndOfFileInfo, &stcInfo, sizeof(stcInfo))) {
+        strError = "无法设置文件大小 " + m_strPath + "（错误码 " + std::to_string(GetLastError()) + "）";
+        return false;
+    }
+    m_ui64Size = ui64Size;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：刷新到磁盘（Windows）
+*********************************************************************************/
+bool RawFile::Flush(std::string& strError) {
+    if (m_bReadOnly) {
+        return true;
+    }
+    if (!FlushFileBuffers(static_cast<HANDLE>(m_hFile))) {
+        strError = "刷新失败 " + m_strPath + "（错误码 " + std::to_string(GetLastError()) + "）";
+        return false;
+    }
+    return true;
+}
+
+#else
+
+/********************************************************************************
+* 函数实现：打开文件（POSIX）
+*********************************************************************************/
+bool RawFile::Open(const std::string& strPath, bool bReadOnly, std::string& strError) {
+    Close();
+    m_strPath = strPath;
+    m_bReadOnly = bReadOnly;
+
+    int nFd = open(strPath.c_str(), (bReadOnly ? O_RDONLY : O_RDWR) | O_CLOEXEC);
+    if (nFd < 0) {
+        strError = "无法打开文件 " + strPath + "（" + strerror(errno) + "）";
+        return false;
+    }
+    struct stat stcStat;
+    if (fstat(nFd, &stcStat) != 0) {
+        strError = "无法获取文件大小 " + strPath + "（" + strerror(errno) + "）";
+        close(nFd);
+        return false;
+    }
+    m_nFd = nFd;
+    m_ui64Size = static_cast<uint64_t>(stcStat.st_size);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：关闭文件（POSIX）
+*********************************************************************************/
+void RawFile::Close() {
+    if (m_nFd >= 0) {
+        close(m_nFd);
+        m_nFd = -1;
+    }
+    m_ui64Size = 0;
+}
+
+bool RawFile::IsOpen() const {
+    return m_nFd >= 0;
+}
+
+/********************************************************************************
+* 函数实现：按偏移读取（POSIX）
+*********************************************************************************/
+bool RawFile::ReadAt(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) {
+    char* pDest = static_cast<char*>(pBuffer);
+    while (nBytes > 0) {
+        size_t nChunk = nBytes > MAX_IO_CHUNK ? MAX_IO_CHUNK : nBytes;
+        ssize_t nRead = pread(m_nFd, pDest, nChunk, static_cast<off_t>(ui64Offset));
+        if (nRead < 0) {
+            if (errno == EINTR) continue;
+            strError = "读取失败 " + m_strPath + "（" + strerror(errno) + "）";
+            return false;
+        }
+        if (nRead == 0) {
+            strError = "读取超出文件末尾 " + m_strPath + "（偏移 " + std::to_string(ui64Offset) + "）";
+            return false;
+        }
+        pDest += nRead;
+        ui64Offset += static_cast<uint64_t>(nRead);
+        nBytes -= static_cast<size_t>(nRead);
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：按偏移写入（POSIX）
+*********************************************************************************/
+bool RawFile::WriteAt(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) {
+    if (m_bReadOnly) {
+        strError = "文件以只读方式打开 " + m_strPath;
+        return false;
+    }
+    const char* pSource = static_cast<const char*>(pBuffer);
+    while (nBytes > 0) {
+        size_t nChunk = nBytes > MAX_IO_CHUNK ? MAX_IO_CHUNK : nBytes;
+        ssize_t nWritten = pwrite(m_nFd, pSource, nChunk, static_cast<off_t>(ui64Offset));
+        if (nWritten < 0) {
+            if (errno == EINTR) continue;
+            strError = "写入失败 " + m_strPath + "（" + strerror(errno) + "）";
+            return false;
+        }
+        pSource += nWritten;
+        ui64Offset += static_cast<uint64_t>(nWritten);
+        nBytes -= static_cast<size_t>(nWritten);
+    }
+    if (ui64Offset > m_ui64Size) {
+        m_ui64Size = ui64Offset;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：设置文件大小（POSIX）
+*********************************************************************************/
+bool RawFile::Resize(uint64_t ui64Size, std::string& strError) {
+    if (ftruncate(m_nFd, static_cast<off_t>(ui64Size)) != 0) {
+        strError = "无法设置文件大小 " + m_strPath + "（" + strerror(errno) + "）";
+        return false;
+    }
+    m_ui64Size = ui64Size;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：刷新到磁盘（POSIX）
+*********************************************************************************/
+bool RawFile::Flush(std::string& strError) {
+    if (m_bReadOnly) {
+        return true;
+    }
+    if (fsync(m_nFd) != 0) {
+        strError = "刷新失败 " + m_strPath + "（" + strerror(errno) + "）";
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+/********************************************************************************
+* 函数实现：DiskGuid成员
+*********************************************************************************/
+bool DiskGuid::IsZero() const {
+    for (uint8_t ui8Byte : ui8Bytes) {
+        if (ui8Byte != 0) return false;
+    }
+    return true;
+}
+
+bool DiskGuid::operator==(const DiskGuid& objOther) const {
+    return memcmp(ui8Bytes, objOther.ui8Bytes, sizeof(ui8Bytes)) == 0;
+}
+
+std::string DiskGuid::ToString() const {
+    uint32_t d1;
+    uint16_t d2, d3;
+    memcpy(&d1, ui8Bytes, 4);
+    memcpy(&d2, ui8Bytes + 4, 2);
+    memcpy(&d3, ui8Bytes + 6, 2);
+    char szBuffer[40];
+    snprintf(szBuffer, sizeof(szBuffer), "{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}",
+             d1, d2, d3, ui8Bytes[8], ui8Bytes[9], ui8Bytes[10], ui8Bytes[11],
+             ui8Bytes[12], ui8Bytes[13], ui8Bytes[14], ui8Bytes[15]);
+    return szBuffer;
+}
+
+DiskGuid DiskGuid::Make(uint32_t d1, uint16_t d2, uint16_t d3, uint64_t d4) {
+    DiskGuid objGuid;
+    memcpy(objGuid.ui8Bytes, &d1, 4);
+    memcpy(objGuid.ui8Bytes + 4, &d2, 2);
+    memcpy(objGuid.ui8Bytes + 6, &d3, 2);
+    for (int i = 0; i < 8; i++) {
+        objGuid.ui8Bytes[8 + i] = static_cast<uint8_t>(d4 >> (56 - 8 * i));
+    }
+    return objGuid;
+}
+
+DiskGuid DiskGuid::Random() {
+    static std::mutex s_mtxRandom;
+    static std::mt19937_64 s_objEngine{ std::random_device{}() };
+    DiskGuid objGuid;
+    {
+        std::lock_guard<std::mutex> lock(s_mtxRandom);
+        uint64_t ui64Random[2] = { s_objEngine(), s_objEngine() };
+        memcpy(objGuid.ui8Bytes, ui64Random, sizeof(ui64Random));
+    }
+    objGuid.ui8Bytes[7] = static_cast<uint8_t>((objGuid.ui8Bytes[7] & 0x0F) | 0x40);
+    objGuid.ui8Bytes[8] = static_cast<uint8_t>((objGuid.ui8Bytes[8] & 0x3F) | 0x80);
+    return objGuid;
+}
+
+/********************************************************************************
+* 函数实现：打开原始镜像
+*********************************************************************************/
+bool FileBlockDevice::Open(const std::string& strPath, bool bReadOnly, std::string& strError, uint32_t ui32SectorSize) {
+    m_ui32SectorSize = ui32SectorSize;
+    return m_objFile.Open(strPath, bReadOnly, strError);
+}
+
+/********************************************************************************
+* 函数实现：读取原始镜像
+*********************************************************************************/
+bool FileBlockDevice::Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) {
+    if (ui64Offset > Size() || nBytes > Size() - ui64Offset) {
+        strError = "读取超出磁盘范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+    return m_objFile.ReadAt(ui64Offset, pBuffer, nBytes, strError);
+}
+
+/********************************************************************************
+* 函数实现：写入原始镜像（不扩展镜像大小）
+*********************************************************************************/
+bool FileBlockDevice::Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) {
+    if (ui64Offset > Size() || nBytes > Size() - ui64Offset) {
+        strError = "写入超出磁盘范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+    return m_objFile.WriteAt(ui64Offset, pBuffer, nBytes, strError);
+}
+
+/********************************************************************************
+* 函数实现：LRU块缓存构造函数
+*********************************************************************************/
+LruBlockCache::LruBlockCache(size_t nPageSize, size_t nCapacity)
+    : m_nPageSize(nPageSize), m_nCapacity(nCapacity) {
+}
+
+/********************************************************************************
+* 函数实现：查找页
+*********************************************************************************/
+const char* LruBlockCache::Lookup(uint64_t ui64Page) {
+    auto it = m_mapPages.find(ui64Page);
+    if (it == m_mapPages.end()) {
+        m_ui64Misses++;
+        return nullptr;
+    }
+    m_ui64Hits++;
+    // 移到表头（splice不复制页数据，迭代器保持有效）
+    m_lstPages.splice(m_lstPages.begin(), m_lstPages, it->second);
+    return it->second->vecData.data();
+}
+
+/********************************************************************************
+* 函数实现：插入页
+*********************************************************************************/
+char* LruBlockCache::Insert(uint64_t ui64Page) {
+    if (m_nCapacity == 0) {
+        return nullptr;
+    }
+    auto it = m_mapPages.find(ui64Page);
+    if (it != m_mapPages.end()) {
+        m_lstPages.splice(m_lstPages.begin(), m_lstPages, it->second);
+        return it->second->vecData.data();
+    }
+
+    // 已满时复用表尾（最久未使用）页的缓冲区，避免重新分配
+    if (m_lstPages.size() >= m_nCapacity) {
+        m_mapPages.erase(m_lstPages.back().ui64Index);
+        m_lstPages.splice(m_lstPages.begin(), m_lstPages, std::prev(m_lstPages.end()));
+        m_lstPages.front().ui64Index = ui64Page;
+    } else {
+        m_lstPages.push_front({ ui64Page, std::vector<char>(m_nPageSize) });
+    }
+    m_mapPages[ui64Page] = m_lstPages.begin();
+    return m_lstPages.front().vecData.data();
+}
+
+/********************************************************************************
+* 函数实现：删除页
+*********************************************************************************/
+void LruBlockCache::Erase(uint64_t ui64Page) {
+    auto it = m_mapPages.find(ui64Page);
+    if (it != m_mapPages.end()) {
+        m_lstPages.erase(it->second);
+        m_mapPages.erase(it);
+    }
+}
+
+/********************************************************************************
+* 函数实现：同步写入的数据
+*********************************************************************************/
+void LruBlockCache::Update(uint64_t ui64Offset, const void* pData, size_t nBytes) {
+    if (m_mapPages.empty() || nBytes == 0) {
+        return;
+    }
+    const char* pSource = static_cast<const char*>(pData);
+    uint64_t ui64First = ui64Offset / m_nPageSize;
+    uint64_t ui64Last = (ui64Offset + nBytes - 1) / m_nPageSize;
+
+    // 写入范围很大时遍历已缓存的页，否则逐页查找
+    if (ui64Last - ui64First + 1 > m_mapPages.size()) {
+        for (auto& stcPage : m_lstPages) {
+            if (stcPage.ui64Index < ui64First || stcPage.ui64Index > ui64Last) continue;
+            uint64_t ui64PageStart = stcPage.ui64Index * m_nPageSize;
+            uint64_t ui64Begin = ui64PageStart > ui64Offset ? ui64PageStart : ui64Offset;
+            uint64_t ui64End = ui64PageStart + m_nPageSize < ui64Offset + nBytes ? ui64PageStart + m_nPageSize : ui64Offset + nBytes;
+            memcpy(stcPage.vecData.data() + (ui64Begin - ui64PageStart), pSource + (ui64Begin - ui64Offset),
+                   static_cast<size_t>(ui64End - ui64Begin));
+        }
+        return;
+    }
+    for (uint64_t ui64Page = ui64First; ui64Page <= ui64Last; ui64Page++) {
+        auto it = m_mapPages.find(ui64Page);
+        if (it == m_mapPages.end()) continue;
+        uint64_t ui64PageStart = ui64Page * m_nPageSize;
+        uint64_t ui64Begin = ui64PageStart > ui64Offset ? ui64PageStart : ui64Offset;
+        uint64_t ui64End = ui64PageStart + m_nPageSize < ui64Offset + nBytes ? ui64PageStart + m_nPageSize : ui64Offset + nBytes;
+        memcpy(it->second->vecData.data() + (ui64Begin - ui64PageStart), pSource + (ui64Begin - ui64Offset),
+               static_cast<size_t>(ui64End - ui64Begin));
+    }
+}
+
+/********************************************************************************
+* 函数实现：清空
+*********************************************************************************/
+void LruBlockCache::Clear() {
+    m_lstPages.clear();
+    m_mapPages.clear();
+}
@@ -0,0 +1,304 @@
+﻿/********************************************************************************
+* 文件名称：BlockDevice.h
+* 文件功能：块设备抽象、可移植的文件随机读写及LRU块缓存
+*
+* 类说明：
+*    不挂载虚拟磁盘直接读写其内容时，分区表、文件系统等上层解析代码只需要
+*    "按字节偏移读写一段数据"，不关心底层是VHDX、VHD还是原始镜像：
+*    - BlockDevice：块设备接口（大小、扇区大小、按偏移读写）
+*    - DiskGuid：磁盘格式（VHDX、GPT）中按字节顺序保存的GUID
+*    - RawFile：按偏移读写文件（Windows使用Win32 API，其他平台使用POSIX
+*      pread/pwrite），磁盘格式代码不直接依赖windows.h，可以在Linux上
+*      对生成的镜像文件运行
+*    - FileBlockDevice：原始磁盘镜像（.img）
+*    - LruBlockCache：按固定大小页缓存最近读过的数据，供各磁盘格式实现
+*      缓存小块随机读取（分区表、MFT记录、目录索引等）
+*
+* 依赖项：
+*    - Windows API / POSIX（文件读写）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+/********************************************************************************
+* 结构体名称：磁盘GUID
+* 结构体功能：按磁盘上的字节顺序保存的GUID（前三段小端）
+*********************************************************************************/
+struct DiskGuid {
+    uint8_t ui8Bytes[16] = { 0 };
+
+    bool IsZero() const;
+    bool operator==(const DiskGuid& objOther) const;
+    bool operator!=(const DiskGuid& objOther) const { return !(*this == objOther); }
+
+    /********************************************************************************
+    * 函数名称：格式化
+    * 返回类型：std::string
+    *    "{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}"（大写）
+    *********************************************************************************/
+    std::string ToString() const;
+
+    /********************************************************************************
+    * 函数名称：由文本形式的各段构造
+    * 函数参数：
+    *    [IN]  uint32_t d1, uint16_t d2, uint16_t d3：前三段
+    *    [IN]  uint64_t d4：最后两段（共8字节）按书写顺序组成的整数
+    * 调用示例：
+    *    // {EBD0A0A2-B9E5-4433-87C0-68B6B72699C7}
+    *    DiskGuid objType = DiskGuid::Make(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C068B6B72699C7ULL);
+    *********************************************************************************/
+    static DiskGuid Make(uint32_t d1, uint16_t d2, uint16_t d3, uint64_t d4);
+
+    /********************************************************************************
+    * 函数名称：生成随机GUID（版本4）
+    *********************************************************************************/
+    static DiskGuid Random();
+};
+
+/********************************************************************************
+* 类名称：块设备
+* 类功能：按字节偏移读写的磁盘接口
+*
+* 注意事项：
+*    - Read/Write的范围必须在[0, Size())之内，越界返回false
+*    - 偏移和长度不要求按扇区对齐，实现负责处理
+*    - 实现需要保证多线程并发调用Read/Write是安全的
+*********************************************************************************/
+class BlockDevice {
+public:
+    virtual ~BlockDevice() = default;
+
+    /********************************************************************************
+    * 函数名称：取磁盘大小
+    * 返回类型：uint64_t
+    *    虚拟磁盘的字节数
+    *********************************************************************************/
+    virtual uint64_t Size() const = 0;
+
+    /********************************************************************************
+    * 函数名称：取逻辑扇区大小
+    * 返回类型：uint32_t
+    *    512或4096
+    *********************************************************************************/
+    virtual uint32_t SectorSize() const = 0;
+
+    /********************************************************************************
+    * 函数名称：是否只读
+    *********************************************************************************/
+    virtual bool IsReadOnly() const = 0;
+
+    /********************************************************************************
+    * 函数名称：读取
+    * 函数参数：
+    *    [IN]  uint64_t ui64Offset：磁盘偏移（字节）
+    *    [OUT] void* pBuffer：缓冲区
+    *    [IN]  size_t nBytes：字节数
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *********************************************************************************/
+    virtual bool Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) = 0;
+
+    /********************************************************************************
+    * 函数名称：写入
+    * 函数参数：
+    *    [IN]  uint64_t ui64Offset：磁盘偏移（字节）
+    *    [IN]  const void* pBuffer：数据
+    *    [IN]  size_t nBytes：字节数
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *********************************************************************************/
+    virtual bool Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) = 0;
+
+    /********************************************************************************
+    * 函数名称：刷新
+    * 函数功能：把已写入的数据刷到存储介质
+    *********************************************************************************/
+    virtual bool Flush(std::string& strError) = 0;
+};
+
+/********************************************************************************
+* 类名称：原始文件
+* 类功能：按偏移读写文件，不使用文件指针（多个调用者互不影响）
+*********************************************************************************/
+class RawFile {
+public:
+    RawFile() = default;
+    ~RawFile() { Close(); }
+
+    /********************************************************************************
+    * 函数名称：打开文件
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径（UTF-8）
+    *    [IN]  bool bReadOnly：是否只读
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *********************************************************************************/
+    bool Open(const std::string& strPath, bool bReadOnly, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：关闭文件
+    *********************************************************************************/
+    void Close();
+
+    bool IsOpen() const;
+    bool IsReadOnly() const { return m_bReadOnly; }
+    uint64_t Size() const { return m_ui64Size; }
+
+    /********************************************************************************
+    * 函数名称：按偏移读取
+    * 注意事项：
+    *    - 必须读满nBytes，超出文件末尾返回false
+    *********************************************************************************/
+    bool ReadAt(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：按偏移写入
+    * 注意事项：
+    *    - 写到文件末尾之后会扩展文件
+    *********************************************************************************/
+    bool WriteAt(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：设置文件大小
+    * 注意事项：
+    *    - 扩展出的部分读出为0
+    *********************************************************************************/
+    bool Resize(uint64_t ui64Size, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：刷新到磁盘
+    *********************************************************************************/
+    bool Flush(std::string& strError);
+
+private:
+#ifdef _WIN32
+    void*    m_hFile = nullptr;     // 文件句柄（HANDLE，nullptr表示未打开）
+#else
+    int      m_nFd = -1;            // 文件描述符
+#endif
+    bool     m_bReadOnly = true;    // 是否只读
+    uint64_t m_ui64Size = 0;        // 当前文件大小
+    std::string m_strPath;          // 文件路径（错误信息用）
+
+    RawFile(const RawFile&) = delete;
+    RawFile& operator=(const RawFile&) = delete;
+};
+
+/********************************************************************************
+* 类名称：原始镜像块设备
+* 类功能：把整个文件当作磁盘（dd/qemu-img生成的raw镜像）
+*********************************************************************************/
+class FileBlockDevice : public BlockDevice {
+public:
+    /********************************************************************************
+    * 函数名称：打开镜像
+    * 函数参数：
+    *    [IN]  const std::string& strPath：镜像路径（UTF-8）
+    *    [IN]  bool bReadOnly：是否只读
+    *    [OUT] std::string& strError：错误信息
+    *    [IN]  uint32_t ui32SectorSize：逻辑扇区大小
+    * 返回类型：bool
+    *********************************************************************************/
+    bool Open(const std::string& strPath, bool bReadOnly, std::string& strError, uint32_t ui32SectorSize = 512);
+
+    uint64_t Size() const override { return m_objFile.Size(); }
+    uint32_t SectorSize() const override { return m_ui32SectorSize; }
+    bool IsReadOnly() const override { return m_objFile.IsReadOnly(); }
+    bool Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) override;
+    bool Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) override;
+    bool Flush(std::string& strError) override { return m_objFile.Flush(strError); }
+
+private:
+    RawFile  m_objFile;                 // 镜像文件
+    uint32_t m_ui32SectorSize = 512;    // 逻辑扇区大小
+};
+
+/********************************************************************************
+* 类名称：LRU块缓存
+* 类功能：按固定大小的页缓存磁盘数据，容量满时淘汰最久未使用的页
+*
+* 调用示例：
+*    LruBlockCache objCache(64 * 1024, 256);
+*    const char* pPage = objCache.Lookup(ui64Page);
+*    if (!pPage) {
+*        char* pNew = objCache.Insert(ui64Page);
+*        // 从磁盘读取整页到pNew，失败时调用objCache.Erase(ui64Page)
+*    }
+*
+* 注意事项：
+*    - 不加锁，由所属的磁盘对象负责同步
+*    - 写入磁盘后调用Update同步已缓存的页（写穿透），缓存与磁盘始终一致
+*********************************************************************************/
+class LruBlockCache {
+public:
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  size_t nPageSize：页大小（字节）
+    *    [IN]  size_t nCapacity：最多缓存的页数（0表示不缓存）
+    *********************************************************************************/
+    LruBlockCache(size_t nPageSize, size_t nCapacity);
+
+    size_t PageSize() const { return m_nPageSize; }
+    size_t Capacity() const { return m_nCapacity; }
+
+    /********************************************************************************
+    * 函数名称：查找页
+    * 返回类型：const char*
+    *    命中返回页数据（并标记为最近使用），未命中返回nullptr
+    *********************************************************************************/
+    const char* Lookup(uint64_t ui64Page);
+
+    /********************************************************************************
+    * 函数名称：插入页
+    * 返回类型：char*
+    *    新页的缓冲区（内容未初始化，由调用者填充）；容量为0时返回nullptr
+    *********************************************************************************/
+    char* Insert(uint64_t ui64Page);
+
+    /********************************************************************************
+    * 函数名称：删除页
+    *********************************************************************************/
+    void Erase(uint64_t ui64Page);
+
+    /********************************************************************************
+    * 函数名称：同步写入的数据
+    * 函数功能：把写入磁盘的数据复制到已缓存的重叠页中
+    * 函数参数：
+    *    [IN]  uint64_t ui64Offset：磁盘偏移
+    *    [IN]  const void* pData：数据
+    *    [IN]  size_t nBytes：字节数
+    *********************************************************************************/
+    void Update(uint64_t ui64Offset, const void* pData, size_t nBytes);
+
+    /********************************************************************************
+    * 函数名称：清空
+    *********************************************************************************/
+    void Clear();
+
+    uint64_t Hits() const { return m_ui64Hits; }
+    uint64_t Misses() const { return m_ui64Misses; }
+
+private:
+    struct Page {
+        uint64_t          ui64Index;    // 页号
+        std::vector<char> vecData;      // 页数据
+    };
+
+    size_t                 m_nPageSize;             // 页大小
+    size_t                 m_nCapacity;             // 最多页数
+    std::list<Page>        m_lstPages;              // 按使用时间排序，表头最近使用
+    std::unordered_map<uint64_t, std::list<Page>::iterator> m_mapPages;    // 页号 → 节点
+    uint64_t               m_ui64Hits = 0;          // 命中次数
+    uint64_t               m_ui64Misses = 0;        // 未命中次数
+};
@@ -0,0 +1,250 @@
+﻿/********************************************************************************
+* 文件名称：ContentHash.cpp
+* 文件功能：实现xxHash64内容哈希及CRC-32C校验和
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "ContentHash.h"
+#include <cstring>
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t RotateLeft(uint64_t ui64Value, int nBits) {
+    return (ui64Value << nBits) | (ui64Value >> (64 - nBits));
+}
+
+// 小端读取（x86/x64/ARM64均为小端，memcpy避免未对齐访问）
+static inline uint64_t Read64(const uint8_t* p) {
+    uint64_t ui64Value;
+    memcpy(&ui64Value, p, sizeof(ui64Value));
+    return ui64Value;
+}
+
+static inline uint32_t Read32(const uint8_t* p) {
+    uint32_t ui32Value;
+    memcpy(&ui32Value, p, sizeof(ui32Value));
+    return ui32Value;
+}
+
+static inline uint64_t Round(uint64_t ui64Acc, uint64_t ui64Input) {
+    ui64Acc += ui64Input * PRIME64_2;
+    ui64Acc = RotateLeft(ui64Acc, 31);
+    return ui64Acc * PRIME64_1;
+}
+
+static inline uint64_t MergeRound(uint64_t ui64Acc, uint64_t ui64Value) {
+    ui64Acc ^= Round(0, ui64Value);
+    return ui64Acc * PRIME64_1 + PRIME64_4;
+}
+
+/********************************************************************************
+* 函数实现：处理完整的32字节条带（内部辅助）
+*********************************************************************************/
+static const uint8_t* ConsumeStripes(uint64_t (&ui64Acc)[4], const uint8_t* p, const uint8_t* pLimit) {
+    uint64_t v1 = ui64Acc[0], v2 = ui64Acc[1], v3 = ui64Acc[2], v4 = ui64Acc[3];
+    while (p + 32 <= pLimit) {
+        v1 = Round(v1, Read64(p));
+        v2 = Round(v2, Read64(p + 8));
+        v3 = Round(v3, Read64(p + 16));
+        v4 = Round(v4, Read64(p + 24));
+        p += 32;
+    }
+    ui64Acc[0] = v1;
+    ui64Acc[1] = v2;
+    ui64Acc[2] = v3;
+    ui64Acc[3] = v4;
+    return p;
+}
+
+/********************************************************************************
+* 函数实现：重置
+*********************************************************************************/
+void XXHash64::Reset(uint64_t ui64Seed) {
+    m_ui64Seed = ui64Seed;
+    m_ui64Acc[0] = ui64Seed + PRIME64_1 + PRIME64_2;
+    m_ui64Acc[1] = ui64Seed + PRIME64_2;
+    m_ui64Acc[2] = ui64Seed;
+    m_ui64Acc[3] = ui64Seed - PRIME64_1;
+    m_ui64TotalLength = 0;
+    m_nPending = 0;
+}
+
+/********************************************************************************
+* 函数实现：追加数据
+*********************************************************************************/
+void XXHash64::Update(const void* pData, size_t nBytes) {
+    const uint8_t* p = static_cast<const uint8_t*>(pData);
+    const uint8_t* pEnd = p + nBytes;
+    m_ui64TotalLength += nBytes;
+
+    // 1. 先补齐上次剩余的不完整条带
+    if (m_nPending > 0) {
+        size_t nFill = 32 - m_nPending;
+        if (nBytes < nFill) {
+            memcpy(m_ui8Pending + m_nPending, p, nBytes);
+            m_nPending += nBytes;
+            return;
+        }
+        memcpy(m_ui8Pending + m_nPending, p, nFill);
+        ConsumeStripes(m_ui64Acc, m_ui8Pending, m_ui8Pending + 32);
+        p += nFill;
+        m_nPending = 0;
+    }
+
+    // 2. 整条带直接处理，剩余部分留到下次
+    p = ConsumeStripes(m_ui64Acc, p, pEnd);
+    if (p < pEnd) {
+        m_nPending = static_cast<size_t>(pEnd - p);
+        memcpy(m_ui8Pending, p, m_nPending);
+    }
+}
+
+/********************************************************************************
+* 函数实现：取哈希值
+*********************************************************************************/
+uint64_t XXHash64::Digest() const {
+    uint64_t ui64Hash;
+    if (m_ui64TotalLength >= 32) {
+        ui64Hash = RotateLeft(m_ui64Acc[0], 1) + RotateLeft(m_ui64Acc[1], 7) +
+                   RotateLeft(m_ui64Acc[2], 12) + RotateLeft(m_ui64Acc[3], 18);
+        ui64Hash = MergeRound(ui64Hash, m_ui64Acc[0]);
+        ui64Hash = MergeRound(ui64Hash, m_ui64Acc[1]);
+        ui64Hash = MergeRound(ui64Hash, m_ui64Acc[2]);
+        ui64Hash = MergeRound(ui64Hash, m_ui64Acc[3]);
+    } else {
+        ui64Hash = m_ui64Seed + PRIME64_5;
+    }
+    ui64Hash += m_ui64TotalLength;
+
+    // 剩余的不足32字节：按8、4、1字节依次混入
+    const uint8_t* p = m_ui8Pending;
+    const uint8_t* pEnd = m_ui8Pending + m_nPending;
+    while (p + 8 <= pEnd) {
+        ui64Hash ^= Round(0, Read64(p));
+        ui64Hash = RotateLeft(ui64Hash, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= pEnd) {
+        ui64Hash ^= static_cast<uint64_t>(Read32(p)) * PRIME64_1;
+        ui64Hash = RotateLeft(ui64Hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < pEnd) {
+        ui64Hash ^= (*p) * PRIME64_5;
+        ui64Hash = RotateLeft(ui64Hash, 11) * PRIME64_1;
+        p++;
+    }
+
+    // 最终雪崩
+    ui64Hash ^= ui64Hash >> 33;
+    ui64Hash *= PRIME64_2;
+    ui64Hash ^= ui64Hash >> 29;
+    ui64Hash *= PRIME64_3;
+    ui64Hash ^= ui64Hash >> 32;
+    return ui64Hash;
+}
+
+/********************************************************************************
+* 函数实现：一次性计算
+*********************************************************************************/
+uint64_t XXHash64::Hash(const void* pData, size_t nBytes, uint64_t ui64Seed) {
+    XXHash64 objHash(ui64Seed);
+    objHash.Update(pData, nBytes);
+    return objHash.Digest();
+}
+
+#ifdef _WIN32
+/********************************************************************************
+* 函数实现：计算已打开文件的哈希
+*********************************************************************************/
+bool XXHash64::HashFile(HANDLE hFile, char* pBuffer, DWORD dwBufferSize, uint64_t& ui64Hash) {
+    XXHash64 objHash;
+    while (true) {
+        DWORD dwRead = 0;
+        if (!ReadFile(hFile, pBuffer, dwBufferSize, &dwRead, nullptr)) {
+            return false;
+        }
+        if (dwRead == 0) {
+            break;
+        }
+        objHash.Update(pBuffer, dwRead);
+    }
+    ui64Hash = objHash.Digest();
+    return true;
+}
+#else
+/********************************************************************************
+* 函数实现：计算已打开文件的哈希
+*********************************************************************************/
+bool XXHash64::HashFile(int nFd, char* pBuffer, size_t nBufferSize, uint64_t& ui64Hash) {
+    XXHash64 objHash;
+    while (true) {
+        ssize_t nRead = read(nFd, pBuffer, nBufferSize);
+        if (nRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nRead < 0) {
+            return false;
+        }
+        if (nRead == 0) {
+            break;
+        }
+        objHash.Update(pBuffer, static_cast<size_t>(nRead));
+    }
+    ui64Hash = objHash.Digest();
+    return true;
+}
+#endif
+
+/********************************************************************************
+* 结构体名称：CRC-32查找表（内部辅助）
+* 说明：按反射多项式生成256项的字节表
+*********************************************************************************/
+struct Crc32Table {
+    uint32_t ui32Entries[256];
+    explicit Crc32Table(uint32_t ui32Polynomial) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t ui32Crc = i;
+            for (int j = 0; j < 8; j++) {
+                ui32Crc = (ui32Crc >> 1) ^ ((ui32Crc & 1) ? ui32Polynomial : 0);
+            }
+            ui32Entries[i] = ui32Crc;
+        }
+    }
+};
+
+static uint32_t Crc32Update(const uint32_t* pTable, const void* pData, size_t nBytes, uint32_t ui32Previous) {
+    const uint8_t* p = static_cast<const uint8_t*>(pData);
+    uint32_t ui32Crc = ~ui32Previous;
+    for (size_t i = 0; i < nBytes; i++) {
+        ui32Crc = pTable[(ui32Crc ^ p[i]) & 0xFF] ^ (ui32Crc >> 8);
+    }
+    return ~ui32Crc;
+}
+
+/********************************************************************************
+* 函数实现：计算CRC-32C
+*********************************************************************************/
+uint32_t Crc32::Castagnoli(const void* pData, size_t nBytes, uint32_t ui32Previous) {
+    static const Crc32Table s_stcTable(0x82F63B78u);
+    return Crc32Update(s_stcTable.ui32Entries, pData, nBytes, ui32Previous);
+}
+
+/********************************************************************************
+* 函数实现：计算CRC-32（IEEE）
+*********************************************************************************/
+uint32_t Crc32::Ieee(const void* pData, size_t nBytes, uint32_t ui32Previous) {
+    static const Crc32Table s_stcTable(0xEDB88320u);
+    return Crc32Update(s_stcTable.ui32Entries, pData, nBytes, ui32Previous);
+}
@@ -0,0 +1,142 @@
+﻿/********************************************************************************
+* 文件名称：ContentHash.h
+* 文件功能：文件内容哈希（xxHash64）及CRC-32C校验和
+*
+* 类说明：
+*    驱动同步需要判断主机与虚拟机中的文件内容是否相同。xxHash64是非加密
+*    哈希，吞吐量接近内存带宽，可以在复制的同时对每个缓冲区增量计算，
+*    不需要额外读一遍文件。
+*    - 支持一次性计算和流式计算（Update可多次调用，结果与一次性计算相同）
+*    - 结果与xxHash官方实现（XXH64）一致
+*    虚拟磁盘格式（VHDX头、区域表、日志）使用CRC-32C（Castagnoli）校验
+*    元数据，GPT分区表使用标准CRC-32（IEEE 802.3），Crc32提供两者的
+*    按字节表实现，可以分段累加。
+*
+* 依赖项：
+*    - Windows API或POSIX（HashFile读取文件）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/********************************************************************************
+* 类名称：xxHash64
+* 类功能：流式计算64位内容哈希
+*
+* 调用示例：
+*    XXHash64 objHash;
+*    objHash.Update(pBuffer, nBytes);
+*    ...
+*    uint64_t ui64Hash = objHash.Digest();
+*********************************************************************************/
+class XXHash64 {
+public:
+    explicit XXHash64(uint64_t ui64Seed = 0) { Reset(ui64Seed); }
+
+    /********************************************************************************
+    * 函数名称：重置
+    * 函数参数：
+    *    [IN]  uint64_t ui64Seed：种子
+    *********************************************************************************/
+    void Reset(uint64_t ui64Seed = 0);
+
+    /********************************************************************************
+    * 函数名称：追加数据
+    * 函数参数：
+    *    [IN]  const void* pData：数据
+    *    [IN]  size_t nBytes：字节数
+    *********************************************************************************/
+    void Update(const void* pData, size_t nBytes);
+
+    /********************************************************************************
+    * 函数名称：取哈希值
+    * 返回类型：uint64_t
+    *    已追加的全部数据的哈希值（不改变状态，可以继续追加）
+    *********************************************************************************/
+    uint64_t Digest() const;
+
+    /********************************************************************************
+    * 函数名称：一次性计算
+    * 函数参数：
+    *    [IN]  const void* pData：数据
+    *    [IN]  size_t nBytes：字节数
+    *    [IN]  uint64_t ui64Seed：种子
+    * 返回类型：uint64_t
+    *********************************************************************************/
+    static uint64_t Hash(const void* pData, size_t nBytes, uint64_t ui64Seed = 0);
+
+#ifdef _WIN32
+    /********************************************************************************
+    * 函数名称：计算已打开文件的哈希
+    * 函数功能：从当前位置读到文件末尾
+    * 函数参数：
+    *    [IN]  HANDLE hFile：以GENERIC_READ打开的文件
+    *    [IN]  char* pBuffer：读缓冲区
+    *    [IN]  DWORD dwBufferSize：缓冲区大小
+    *    [OUT] uint64_t& ui64Hash：哈希值
+    * 返回类型：bool
+    *    读取失败返回false（GetLastError可取得原因）
+    *********************************************************************************/
+    static bool HashFile(HANDLE hFile, char* pBuffer, DWORD dwBufferSize, uint64_t& ui64Hash);
+#else
+    /********************************************************************************
+    * 函数名称：计算已打开文件的哈希
+    * 函数功能：从当前位置读到文件末尾
+    * 函数参数：
+    *    [IN]  int nFd：以只读方式打开的文件描述符
+    *    [IN]  char* pBuffer：读缓冲区
+    *    [IN]  size_t nBufferSize：缓冲区大小
+    *    [OUT] uint64_t& ui64Hash：哈希值
+    * 返回类型：bool
+    *    读取失败返回false（errno为原因）
+    *********************************************************************************/
+    static bool HashFile(int nFd, char* pBuffer, size_t nBufferSize, uint64_t& ui64Hash);
+#endif
+
+private:
+    uint64_t m_ui64Acc[4];          // 4路累加器
+    uint64_t m_ui64Seed;            // 种子
+    uint64_t m_ui64TotalLength;     // 已追加的总字节数
+    uint8_t  m_ui8Pending[32];      // 不足一个条带（32字节）的剩余数据
+    size_t   m_nPending;            // 剩余数据字节数
+};
+
+/********************************************************************************
+* 类名称：CRC-32校验和
+* 类功能：计算CRC-32C（Castagnoli，多项式0x1EDC6F41）和CRC-32（IEEE，多项式0x04C11DB7）
+*
+* 调用示例：
+*    uint32_t ui32Crc = Crc32::Castagnoli(pHeader, 4096);
+*    // 分段计算：结果与一次性计算相同
+*    uint32_t ui32Part = Crc32::Castagnoli(pFirst, nFirst);
+*    ui32Part = Crc32::Castagnoli(pSecond, nSecond, ui32Part);
+*********************************************************************************/
+class Crc32 {
+public:
+    /********************************************************************************
+    * 函数名称：计算CRC-32C
+    * 函数参数：
+    *    [IN]  const void* pData：数据
+    *    [IN]  size_t nBytes：字节数
+    *    [IN]  uint32_t ui32Previous：前一段数据的结果（第一段为0）
+    * 返回类型：uint32_t
+    *********************************************************************************/
+    static uint32_t Castagnoli(const void* pData, size_t nBytes, uint32_t ui32Previous = 0);
+
+    /********************************************************************************
+    * 函数名称：计算CRC-32（IEEE）
+    * 函数参数：同Castagnoli
+    * 返回类型：uint32_t
+    *    与zlib crc32()的结果相同
+    *********************************************************************************/
+    static uint32_t Ieee(const void* pData, size_t nBytes, uint32_t ui32Previous = 0);
+};
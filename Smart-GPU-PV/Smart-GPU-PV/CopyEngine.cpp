@@ -0,0 +1,932 @@
+﻿/********************************************************************************
+* 文件名称：CopyEngine.cpp
+* 文件功能：实现并行复制驱动文件和目录的本地复制引擎
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "CopyEngine.h"
+#include "Utils.h"
+#include "ContentHash.h"
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cwctype>
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 复制后保留的文件属性（目录、压缩等属性由文件系统决定，不能直接设置）
+static const DWORD PRESERVED_ATTRIBUTES = FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN |
+                                          FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_ARCHIVE |
+                                          FILE_ATTRIBUTE_NOT_CONTENT_INDEXED;
+
+/********************************************************************************
+* 结构体名称：文件时间（内部辅助）
+* 说明：各平台统一使用FILETIME单位（1601年起的100ns间隔，UTC），与清单和
+*       镜像中的NTFS时间戳一致
+*********************************************************************************/
+struct FileTimes {
+    uint64_t ui64Creation = 0;
+    uint64_t ui64Access = 0;
+    uint64_t ui64Write = 0;
+};
+
+//==============================================================================
+// 平台相关的文件操作（内部辅助）：两个平台提供同名函数，复制逻辑不区分平台
+//==============================================================================
+
+#ifdef _WIN32
+static const CopyEngine::FileHandle NO_FILE = INVALID_HANDLE_VALUE;
+
+static uint64_t FileTimeToUInt64(const FILETIME& ftTime) {
+    return (static_cast<uint64_t>(ftTime.dwHighDateTime) << 32) | ftTime.dwLowDateTime;
+}
+
+static FILETIME UInt64ToFileTime(uint64_t ui64Time) {
+    FILETIME ftTime;
+    ftTime.dwLowDateTime = static_cast<DWORD>(ui64Time);
+    ftTime.dwHighDateTime = static_cast<DWORD>(ui64Time >> 32);
+    return ftTime;
+}
+
+static std::filesystem::path ToPath(const std::string& strPath) { return Utils::StringToWString(strPath); }
+static std::string FromPath(const std::filesystem::path& path) { return Utils::WStringToString(path.wstring()); }
+static std::wstring WidePath(const std::filesystem::path& path) { return path.wstring(); }
+static DWORD LastError() { return GetLastError(); }
+static bool IsPathNotFound(DWORD dwError) { return dwError == ERROR_PATH_NOT_FOUND; }
+
+static char* AllocateBuffer(size_t nBytes) {
+    return static_cast<char*>(VirtualAlloc(nullptr, nBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+}
+
+static void FreeBuffer(char* pBuffer) { VirtualFree(pBuffer, 0, MEM_RELEASE); }
+
+static DWORD GetAttributes(const std::filesystem::path& path) { return GetFileAttributesW(path.c_str()); }
+
+static void SetAttributes(const std::filesystem::path& path, DWORD dwAttributes) {
+    SetFileAttributesW(path.c_str(), dwAttributes);
+}
+
+static bool StatFile(const std::filesystem::path& path, DWORD& dwAttributes, uint64_t& ui64Size,
+                     uint64_t& ui64WriteTime) {
+    WIN32_FILE_ATTRIBUTE_DATA stcData = { 0 };
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &stcData)) {
+        return false;
+    }
+    dwAttributes = stcData.dwFileAttributes;
+    ui64Size = (static_cast<uint64_t>(stcData.nFileSizeHigh) << 32) | stcData.nFileSizeLow;
+    ui64WriteTime = FileTimeToUInt64(stcData.ftLastWriteTime);
+    return true;
+}
+
+static CopyEngine::FileHandle OpenSource(const std::filesystem::path& path) {
+    // 系统目录中的DLL可能正被加载，允许共享
+    return CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+}
+
+static bool QuerySource(CopyEngine::FileHandle hFile, uint64_t& ui64Size, FileTimes& stcTimes) {
+    LARGE_INTEGER liSize = { 0 };
+    GetFileSizeEx(hFile, &liSize);
+    ui64Size = static_cast<uint64_t>(liSize.QuadPart);
+    FILETIME ftCreation = { 0 }, ftAccess = { 0 }, ftWrite = { 0 };
+    if (!GetFileTime(hFile, &ftCreation, &ftAccess, &ftWrite)) {
+        return false;
+    }
+    stcTimes.ui64Creation = FileTimeToUInt64(ftCreation);
+    stcTimes.ui64Access = FileTimeToUInt64(ftAccess);
+    stcTimes.ui64Write = FileTimeToUInt64(ftWrite);
+    return true;
+}
+
+static CopyEngine::FileHandle CreateDest(const std::filesystem::path& path) {
+    return CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+}
+
+static void Preallocate(CopyEngine::FileHandle hFile, uint64_t ui64Size) {
+    LARGE_INTEGER liSize = { 0 }, liZero = { 0 };
+    liSize.QuadPart = static_cast<LONGLONG>(ui64Size);
+    if (SetFilePointerEx(hFile, liSize, nullptr, FILE_BEGIN) && SetEndOfFile(hFile)) {
+        SetFilePointerEx(hFile, liZero, nullptr, FILE_BEGIN);
+    }
+}
+
+static bool ReadChunk(CopyEngine::FileHandle hFile, char* pBuffer, DWORD dwWanted, DWORD& dwRead) {
+    dwRead = 0;
+    return ReadFile(hFile, pBuffer, dwWanted, &dwRead, nullptr) != FALSE;
+}
+
+static bool WriteChunk(CopyEngine::FileHandle hFile, const char* pBuffer, DWORD dwBytes) {
+    DWORD dwWritten = 0;
+    return WriteFile(hFile, pBuffer, dwBytes, &dwWritten, nullptr) && dwWritten == dwBytes;
+}
+
+static bool Rewind(CopyEngine::FileHandle hFile) {
+    LARGE_INTEGER liZero = { 0 };
+    return SetFilePointerEx(hFile, liZero, nullptr, FILE_BEGIN) != FALSE;
+}
+
+static void SetTimes(CopyEngine::FileHandle hFile, const FileTimes& stcTimes) {
+    FILETIME ftCreation = UInt64ToFileTime(stcTimes.ui64Creation);
+    FILETIME ftAccess = UInt64ToFileTime(stcTimes.ui64Access);
+    FILETIME ftWrite = UInt64ToFileTime(stcTimes.ui64Write);
+    SetFileTime(hFile, &ftCreation, &ftAccess, &ftWrite);
+}
+
+static void CloseFile(CopyEngine::FileHandle hFile) { CloseHandle(hFile); }
+static void RemoveFile(const std::filesystem::path& path) { DeleteFileW(path.c_str()); }
+#else
+static const CopyEngine::FileHandle NO_FILE = -1;
+
+// FILETIME起点（1601-01-01）到Unix时间起点的100ns间隔数
+static const uint64_t UNIX_EPOCH_FILETIME = 116444736000000000ULL;
+
+static uint64_t TimespecToFileTime(const timespec& stcTime) {
+    return UNIX_EPOCH_FILETIME + static_cast<uint64_t>(stcTime.tv_sec) * 10000000ULL +
+           static_cast<uint64_t>(stcTime.tv_nsec) / 100;
+}
+
+static timespec FileTimeToTimespec(uint64_t ui64Time) {
+    uint64_t ui64Unix = ui64Time > UNIX_EPOCH_FILETIME ? ui64Time - UNIX_EPOCH_FILETIME : 0;
+    timespec stcTime;
+    stcTime.tv_sec = static_cast<time_t>(ui64Unix / 10000000ULL);
+    stcTime.tv_nsec = static_cast<long>(ui64Unix % 10000000ULL * 100);
+    return stcTime;
+}
+
+// 本地路径是UTF-8字节串，清单键仍为宽字符串
+static std::filesystem::path ToPath(const std::string& strPath) { return std::filesystem::path(strPath); }
+static std::string FromPath(const std::filesystem::path& path) { return path.string(); }
+static std::wstring WidePath(const std::filesystem::path& path) { return Utils::StringToWString(path.string()); }
+static DWORD LastError() { return static_cast<DWORD>(errno); }
+static bool IsPathNotFound(DWORD dwError) { return dwError == ENOENT; }
+
+static char* AllocateBuffer(size_t nBytes) {
+    return static_cast<char*>(std::aligned_alloc(4096, nBytes));
+}
+
+static void FreeBuffer(char* pBuffer) { std::free(pBuffer); }
+
+// 属性的对应：没有属主写权限为只读，以'.'开头为隐藏，普通文件带存档属性
+static DWORD AttributesFromStat(const std::filesystem::path& path, const struct stat& stcStat) {
+    DWORD dwAttributes = S_ISDIR(stcStat.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_ARCHIVE;
+    if (!(stcStat.st_mode & S_IWUSR)) {
+        dwAttributes |= FILE_ATTRIBUTE_READONLY;
+    }
+    if (path.filename().string().rfind('.', 0) == 0) {
+        dwAttributes |= FILE_ATTRIBUTE_HIDDEN;
+    }
+    return dwAttributes;
+}
+
+static DWORD GetAttributes(const std::filesystem::path& path) {
+    struct stat stcStat;
+    return stat(path.c_str(), &stcStat) == 0 ? AttributesFromStat(path, stcStat) : INVALID_FILE_ATTRIBUTES;
+}
+
+static void SetAttributes(const std::filesystem::path& path, DWORD dwAttributes) {
+    struct stat stcStat;
+    if (stat(path.c_str(), &stcStat) != 0) {
+        return;
+    }
+    mode_t nMode = stcStat.st_mode & 07777;
+    nMode = (dwAttributes & FILE_ATTRIBUTE_READONLY) ? (nMode & ~(S_IWUSR | S_IWGRP | S_IWOTH)) : (nMode | S_IWUSR);
+    chmod(path.c_str(), nMode);
+}
+
+static bool StatFile(const std::filesystem::path& path, DWORD& dwAttributes, uint64_t& ui64Size,
+                     uint64_t& ui64WriteTime) {
+    struct stat stcStat;
+    if (stat(path.c_str(), &stcStat) != 0) {
+        return false;
+    }
+    dwAttributes = AttributesFromStat(path, stcStat);
+    ui64Size = static_cast<uint64_t>(stcStat.st_size);
+    ui64WriteTime = TimespecToFileTime(stcStat.st_mtim);
+    return true;
+}
+
+static CopyEngine::FileHandle OpenSource(const std::filesystem::path& path) {
+    int nFd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (nFd >= 0) {
+        posix_fadvise(nFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    return nFd;
+}
+
+static bool QuerySource(CopyEngine::FileHandle nFd, uint64_t& ui64Size, FileTimes& stcTimes) {
+    struct stat stcStat;
+    if (fstat(nFd, &stcStat) != 0) {
+        return false;
+    }
+    ui64Size = static_cast<uint64_t>(stcStat.st_size);
+    // 没有可移植的创建时间，以修改时间代替
+    stcTimes.ui64Creation = TimespecToFileTime(stcStat.st_mtim);
+    stcTimes.ui64Access = TimespecToFileTime(stcStat.st_atim);
+    stcTimes.ui64Write = TimespecToFileTime(stcStat.st_mtim);
+    return true;
+}
+
+static CopyEngine::FileHandle CreateDest(const std::filesystem::path& path) {
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+static void Preallocate(CopyEngine::FileHandle nFd, uint64_t ui64Size) {
+#ifdef __linux__
+    // 不使用posix_fallocate：文件系统不支持时它以写零代替，比复制本身还慢
+    fallocate(nFd, 0, 0, static_cast<off_t>(ui64Size));
+#else
+    (void)nFd;
+    (void)ui64Size;
+#endif
+}
+
+static bool ReadChunk(CopyEngine::FileHandle nFd, char* pBuffer, DWORD dwWanted, DWORD& dwRead) {
+    ssize_t nRead;
+    do {
+        nRead = read(nFd, pBuffer, dwWanted);
+    } while (nRead < 0 && errno == EINTR);
+    dwRead = nRead > 0 ? static_cast<DWORD>(nRead) : 0;
+    return nRead >= 0;
+}
+
+static bool WriteChunk(CopyEngine::FileHandle nFd, const char* pBuffer, DWORD dwBytes) {
+    while (dwBytes > 0) {
+        ssize_t nWritten = write(nFd, pBuffer, dwBytes);
+        if (nWritten < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nWritten <= 0) {
+            return false;
+        }
+        pBuffer += nWritten;
+        dwBytes -= static_cast<DWORD>(nWritten);
+    }
+    return true;
+}
+
+static bool Rewind(CopyEngine::FileHandle nFd) { return lseek(nFd, 0, SEEK_SET) == 0; }
+
+static void SetTimes(CopyEngine::FileHandle nFd, const FileTimes& stcTimes) {
+    timespec stcTimesArray[2] = { FileTimeToTimespec(stcTimes.ui64Access), FileTimeToTimespec(stcTimes.ui64Write) };
+    futimens(nFd, stcTimesArray);
+}
+
+static void CloseFile(CopyEngine::FileHandle nFd) { close(nFd); }
+static void RemoveFile(const std::filesystem::path& path) { unlink(path.c_str()); }
+#endif
+
+/********************************************************************************
+* 函数实现：不区分大小写比较宽字符串的前n个字符（内部辅助）
+*********************************************************************************/
+static bool EqualsNoCase(const wchar_t* pwszLeft, const wchar_t* pwszRight, size_t nCount) {
+    for (size_t i = 0; i < nCount; i++) {
+        if (std::towlower(pwszLeft[i]) != std::towlower(pwszRight[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：格式化字节数（内部辅助）
+*********************************************************************************/
+static std::string FormatBytes(uint64_t ui64Bytes) {
+    char szBuffer[32] = { 0 };
+    if (ui64Bytes >= 1024ULL * 1024 * 1024) {
+        snprintf(szBuffer, sizeof(szBuffer), "%.2f GB", ui64Bytes / (1024.0 * 1024 * 1024));
+    } else {
+        snprintf(szBuffer, sizeof(szBuffer), "%.1f MB", ui64Bytes / (1024.0 * 1024));
+    }
+    return szBuffer;
+}
+
+/********************************************************************************
+* 函数实现：格式化速度（内部辅助）
+*********************************************************************************/
+static std::string FormatRate(uint64_t ui64Bytes, uint64_t ui64ElapsedMs) {
+    double dMBps = ui64ElapsedMs ? (ui64Bytes / (1024.0 * 1024)) / (ui64ElapsedMs / 1000.0) : 0.0;
+    char szBuffer[32] = { 0 };
+    snprintf(szBuffer, sizeof(szBuffer), "%.1f MB/s", dMBps);
+    return szBuffer;
+}
+
+/********************************************************************************
+* 函数实现：构造函数
+*********************************************************************************/
+CopyEngine::CopyEngine(unsigned int nWorkers) : m_nWorkers(nWorkers) {
+    if (m_nWorkers == 0) {
+        // 复制受磁盘限制，线程数超过8没有收益
+        m_nWorkers = std::thread::hardware_concurrency();
+        if (m_nWorkers < 2) m_nWorkers = 2;
+        if (m_nWorkers > 8) m_nWorkers = 8;
+    }
+}
+
+CopyEngine::~CopyEngine() = default;
+
+/********************************************************************************
+* 函数实现：添加作业
+*********************************************************************************/
+void CopyEngine::Add(const std::string& strSource, const std::string& strDest, bool bSkipExisting) {
+    Task stcTask;
+    stcTask.pathSource = ToPath(strSource);
+    stcTask.pathDest = ToPath(strDest);
+    stcTask.bSkipExisting = bSkipExisting;
+    m_vecJobs.push_back(std::move(stcTask));
+}
+
+/********************************************************************************
+* 函数实现：设置镜像目标
+*********************************************************************************/
+void CopyEngine::SetImageTarget(NtfsWriter* pWriter, const std::string& strImageRoot) {
+    m_pImage = pWriter;
+    if (m_pImage && m_nWorkers > IMAGE_MAX_WORKERS) {
+        m_nWorkers = IMAGE_MAX_WORKERS;
+    }
+    m_wstrImageRoot = Utils::StringToWString(strImageRoot);
+    while (!m_wstrImageRoot.empty() && (m_wstrImageRoot.back() == L'\\' || m_wstrImageRoot.back() == L'/')) {
+        m_wstrImageRoot.pop_back();
+    }
+}
+
+/********************************************************************************
+* 函数实现：目标路径转为镜像中的卷内路径（内部辅助）
+*********************************************************************************/
+bool CopyEngine::ImagePath(const std::filesystem::path& pathDest, std::string& strImagePath) const {
+    if (!m_pImage || m_wstrImageRoot.empty()) {
+        return false;
+    }
+    const std::wstring wstrDest = WidePath(pathDest);
+    const size_t nRoot = m_wstrImageRoot.size();
+    if (wstrDest.size() < nRoot || !EqualsNoCase(wstrDest.c_str(), m_wstrImageRoot.c_str(), nRoot)) {
+        return false;
+    }
+    if (wstrDest.size() > nRoot && wstrDest[nRoot] != L'\\' && wstrDest[nRoot] != L'/') {
+        return false;
+    }
+    strImagePath = Utils::WStringToString(wstrDest.substr(nRoot));
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：记录错误（内部辅助）
+*********************************************************************************/
+void CopyEngine::AddError(const std::filesystem::path& pathSource, const std::string& strMessage) {
+    std::lock_guard<std::mutex> lock(m_mtxState);
+    m_vecErrors.push_back({ FromPath(pathSource), strMessage });
+}
+
+/********************************************************************************
+* 函数实现：提交任务（内部辅助）
+*********************************************************************************/
+void CopyEngine::Push(unsigned int nIndex, Task stcTask) {
+    // 先计数再入队，保证队列中有任务时未完成计数不为0
+    m_ui64Outstanding++;
+    if (stcTask.bDirectory) {
+        m_ui64Walking++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_vecQueues[nIndex]->mtxTasks);
+        m_vecQueues[nIndex]->deqTasks.push_back(std::move(stcTask));
+    }
+    m_cvWork.notify_one();
+}
+
+/********************************************************************************
+* 函数实现：取任务（内部辅助）
+*********************************************************************************/
+bool CopyEngine::TakeTask(unsigned int nIndex, Task& stcTask) {
+    // 1. 自己的队列：从尾部取（最近产生的子任务，目录局部性好）
+    {
+        WorkerQueue& objOwn = *m_vecQueues[nIndex];
+        std::lock_guard<std::mutex> lock(objOwn.mtxTasks);
+        if (!objOwn.deqTasks.empty()) {
+            stcTask = std::move(objOwn.deqTasks.back());
+            objOwn.deqTasks.pop_back();
+            return true;
+        }
+    }
+
+    // 2. 从其他线程的队列头部窃取（最早产生的任务，通常是较大的子树）
+    for (unsigned int k = 1; k < m_nWorkers; k++) {
+        WorkerQueue& objVictim = *m_vecQueues[(nIndex + k) % m_nWorkers];
+        std::lock_guard<std::mutex> lock(objVictim.mtxTasks);
+        if (!objVictim.deqTasks.empty()) {
+            stcTask = std::move(objVictim.deqTasks.front());
+            objVictim.deqTasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：完成任务（内部辅助）
+*********************************************************************************/
+void CopyEngine::FinishTask() {
+    if (--m_ui64Outstanding == 0) {
+        // 最后一个任务完成：唤醒空闲的工作线程退出，唤醒Run返回
+        std::lock_guard<std::mutex> lock(m_mtxState);
+        m_cvWork.notify_all();
+    }
+}
+
+/********************************************************************************
+* 函数实现：工作线程主循环（内部辅助）
+*********************************************************************************/
+void CopyEngine::WorkerLoop(unsigned int nIndex) {
+    char* pBuffer = AllocateBuffer(BUFFER_SIZE);
+    std::vector<char> vecStaging;   // 写入镜像前暂存小文件（只在镜像模式下分配）
+
+    while (true) {
+        Task stcTask;
+        if (!TakeTask(nIndex, stcTask)) {
+            // 没有可取的任务：全部完成则退出，否则等待新任务
+            //（短超时等待，避免检查队列与开始等待之间错过通知）
+            std::unique_lock<std::mutex> lock(m_mtxState);
+            if (m_ui64Outstanding == 0) {
+                break;
+            }
+            m_cvWork.wait_for(lock, std::chrono::milliseconds(5));
+            continue;
+        }
+
+        if (stcTask.bDirectory) {
+            WalkDirectory(nIndex, stcTask);
+        } else if (pBuffer) {
+            CopyFileTask(stcTask, pBuffer, vecStaging);
+        } else {
+            AddError(stcTask.pathSource, "无法分配复制缓冲区");
+        }
+        FinishTask();
+    }
+
+    if (pBuffer) {
+        FreeBuffer(pBuffer);
+    }
+}
+
+/********************************************************************************
+* 函数实现：遍历目录（内部辅助）
+*********************************************************************************/
+void CopyEngine::WalkDirectory(unsigned int nIndex, const Task& stcTask) {
+    std::error_code ec;
+
+    // 1. 目标已存在且要求跳过时不遍历
+    std::string strImagePath;
+    bool bImage = ImagePath(stcTask.pathDest, strImagePath);
+    bool bExists = false;
+    if (stcTask.bSkipExisting && bImage) {
+        NtfsFileInfo stcInfo;
+        std::string strIgnored;
+        std::lock_guard<std::mutex> lock(m_mtxImage);
+        bExists = m_pImage->Stat(strImagePath, stcInfo, strIgnored);
+    } else if (stcTask.bSkipExisting) {
+        bExists = std::filesystem::exists(stcTask.pathDest, ec);
+    }
+    if (bExists) {
+        m_ui64Skipped++;
+        m_ui64Walking--;
+        return;
+    }
+
+    // 2. 创建目标目录并保留属性（镜像中的目录创建时即带有属性）
+    DWORD dwAttributes = GetAttributes(stcTask.pathSource);
+    if (bImage) {
+        std::string strError;
+        bool bCreated = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mtxImage);
+            bCreated = m_pImage->CreateDirectories(strImagePath, dwAttributes == INVALID_FILE_ATTRIBUTES ? 0 :
+                                                   dwAttributes & PRESERVED_ATTRIBUTES, strError);
+        }
+        if (!bCreated) {
+            AddError(stcTask.pathSource, "无法创建目标目录（" + strError + "）");
+            m_ui64Walking--;
+            return;
+        }
+    } else {
+        std::filesystem::create_directories(stcTask.pathDest, ec);
+        if (ec) {
+            AddError(stcTask.pathSource, "无法创建目标目录（错误码 " + std::to_string(ec.value()) + "）");
+            m_ui64Walking--;
+            return;
+        }
+        if (dwAttributes != INVALID_FILE_ATTRIBUTES) {
+            SetAttributes(stcTask.pathDest, dwAttributes & PRESERVED_ATTRIBUTES);
+        }
+    }
+    m_ui64Directories++;
+
+    // 3. 子目录和文件作为新任务放入自己的队列
+    std::filesystem::directory_iterator itEntry(stcTask.pathSource, ec);
+    if (ec) {
+        AddError(stcTask.pathSource, "无法读取目录（错误码 " + std::to_string(ec.value()) + "）");
+    }
+    for (; !ec && itEntry != std::filesystem::directory_iterator(); itEntry.increment(ec)) {
+        Task stcChild;
+        stcChild.pathSource = itEntry->path();
+        stcChild.pathDest = stcTask.pathDest / itEntry->path().filename();
+
+        std::error_code ecEntry;
+        if (itEntry->is_directory(ecEntry)) {
+            stcChild.bDirectory = true;
+            Push(nIndex, std::move(stcChild));
+        } else if (itEntry->is_regular_file(ecEntry)) {
+            uint64_t ui64Size = itEntry->file_size(ecEntry);
+            m_ui64FilesFound++;
+            m_ui64BytesFound += ecEntry ? 0 : ui64Size;
+            Push(nIndex, std::move(stcChild));
+        }
+    }
+    if (ec) {
+        AddError(stcTask.pathSource, "遍历目录时出错（错误码 " + std::to_string(ec.value()) + "）");
+    }
+    m_ui64Walking--;
+}
+
+/********************************************************************************
+* 函数实现：判断目标文件是否与源一致（内部辅助）
+*********************************************************************************/
+bool CopyEngine::IsUnchanged(FileHandle hSource, char* pBuffer, uint64_t ui64DestSize, uint64_t ui64DestWriteTime,
+                             const std::wstring& wstrKey, ManifestEntry& stcEntry) {
+    // 1. 目标文件大小必须与源一致
+    if (ui64DestSize != stcEntry.ui64Size) {
+        return false;
+    }
+
+    // 2. 大小和修改时间与清单一致：未变化
+    ManifestEntry stcOld;
+    bool bHasOld = m_pManifest->Lookup(wstrKey, stcOld);
+    if (bHasOld && stcOld.ui64Size == stcEntry.ui64Size && stcOld.ui64WriteTime == stcEntry.ui64WriteTime) {
+        stcEntry.ui64Hash = stcOld.ui64Hash;
+        return true;
+    }
+
+    // 3. 需要源文件哈希的两种情况：
+    //    - 清单中有但修改时间不同（例如重新安装了同版本驱动）：内容哈希一致则未变化
+    //    - 清单中没有，目标修改时间与源一致（旧版本复制的镜像）：视为未变化并纳入清单
+    if (!bHasOld && ui64DestWriteTime != stcEntry.ui64WriteTime) {
+        return false;
+    }
+    uint64_t ui64Hash = 0;
+    if (XXHash64::HashFile(hSource, pBuffer, BUFFER_SIZE, ui64Hash) && (!bHasOld || ui64Hash == stcOld.ui64Hash)) {
+        stcEntry.ui64Hash = ui64Hash;
+        return true;
+    }
+
+    // 4. 内容已变化：源文件回到开头，由调用者复制
+    Rewind(hSource);
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：复制文件（内部辅助）
+*********************************************************************************/
+void CopyEngine::CopyFileTask(const Task& stcTask, char* pBuffer, std::vector<char>& vecStaging) {
+    // 1. 查询目标（镜像中的目标由写入器查询，包含本次会话写入的文件），
+    //    目标已存在且要求跳过
+    std::string strImagePath;
+    bool bImage = ImagePath(stcTask.pathDest, strImagePath);
+    DWORD dwDestAttributes = INVALID_FILE_ATTRIBUTES;
+    uint64_t ui64DestSize = 0;
+    uint64_t ui64DestWriteTime = 0;
+    if (bImage) {
+        NtfsFileInfo stcInfo;
+        std::string strIgnored;
+        std::lock_guard<std::mutex> lock(m_mtxImage);
+        if (m_pImage->Stat(strImagePath, stcInfo, strIgnored)) {
+            dwDestAttributes = stcInfo.ui32Attributes;
+            ui64DestSize = stcInfo.ui64Size;
+            ui64DestWriteTime = stcInfo.ui64ModifiedTime;
+        }
+    } else {
+        StatFile(stcTask.pathDest, dwDestAttributes, ui64DestSize, ui64DestWriteTime);
+    }
+    if (stcTask.bSkipExisting && dwDestAttributes != INVALID_FILE_ATTRIBUTES) {
+        m_ui64Skipped++;
+        return;
+    }
+
+    // 2. 打开源文件
+    FileHandle hSource = OpenSource(stcTask.pathSource);
+    if (hSource == NO_FILE) {
+        AddError(stcTask.pathSource, "无法打开源文件（错误码 " + std::to_string(LastError()) + "）");
+        return;
+    }
+    uint64_t ui64Size = 0;
+    FileTimes stcTimes;
+    bool bHasTimes = QuerySource(hSource, ui64Size, stcTimes);
+    DWORD dwAttributes = GetAttributes(stcTask.pathSource);
+
+    // 3. 增量同步：目标内容未变化时不复制，只记入清单
+    std::wstring wstrKey;
+    bool bTracked = m_pManifest && bHasTimes && m_pManifest->MakeKey(WidePath(stcTask.pathDest), wstrKey);
+    ManifestEntry stcEntry;
+    stcEntry.ui64Size = ui64Size;
+    stcEntry.ui64WriteTime = stcTimes.ui64Write;
+    stcEntry.wstrSource = WidePath(stcTask.pathSource);
+    if (bTracked && dwDestAttributes != INVALID_FILE_ATTRIBUTES &&
+        IsUnchanged(hSource, pBuffer, ui64DestSize, ui64DestWriteTime, wstrKey, stcEntry)) {
+        CloseFile(hSource);
+        m_pManifest->Record(wstrKey, stcEntry);
+        m_ui64Unchanged++;
+        m_ui64BytesSaved += stcEntry.ui64Size;
+        // 不计入进度总量，进度只反映实际复制的部分
+        m_ui64FilesFound--;
+        m_ui64BytesFound -= stcEntry.ui64Size;
+        return;
+    }
+
+    // 4. 镜像目标：由写入器写入（写时复制，失败时镜像中的旧文件保持原内容）
+    if (bImage) {
+        NtfsFileProperties stcProperties;
+        stcProperties.ui64Size = stcEntry.ui64Size;
+        stcProperties.ui64CreationTime = stcTimes.ui64Creation;
+        stcProperties.ui64ModifiedTime = stcTimes.ui64Write;
+        stcProperties.ui64AccessTime = stcTimes.ui64Access;
+        stcProperties.ui32Attributes = dwAttributes == INVALID_FILE_ATTRIBUTES ? FILE_ATTRIBUTE_ARCHIVE :
+                                       dwAttributes & PRESERVED_ATTRIBUTES;
+        CopyToImage(stcTask, strImagePath, hSource, stcProperties, bTracked, wstrKey, stcEntry, vecStaging);
+        CloseFile(hSource);
+        return;
+    }
+
+    // 5. 创建目标文件：只读的目标先清除属性（与Copy-Item -Force一致），
+    //    父目录不存在时创建后重试
+    if (dwDestAttributes != INVALID_FILE_ATTRIBUTES && (dwDestAttributes & FILE_ATTRIBUTE_READONLY)) {
+        SetAttributes(stcTask.pathDest, dwDestAttributes & ~FILE_ATTRIBUTE_READONLY);
+    }
+    FileHandle hDest = CreateDest(stcTask.pathDest);
+    if (hDest == NO_FILE && IsPathNotFound(LastError())) {
+        std::error_code ec;
+        std::filesystem::create_directories(stcTask.pathDest.parent_path(), ec);
+        hDest = CreateDest(stcTask.pathDest);
+    }
+    if (hDest == NO_FILE) {
+        AddError(stcTask.pathSource, "无法创建目标文件（错误码 " + std::to_string(LastError()) + "）");
+        CloseFile(hSource);
+        return;
+    }
+
+    // 6. 按源文件大小预分配，减少目标文件碎片
+    if (ui64Size > 0) {
+        Preallocate(hDest, ui64Size);
+    }
+
+    // 7. 顺序读写，参与增量同步的文件同时计算哈希
+    std::string strFailure;
+    uint64_t ui64Copied = 0;
+    XXHash64 objHash;
+    while (true) {
+        DWORD dwRead = 0;
+        if (!ReadChunk(hSource, pBuffer, BUFFER_SIZE, dwRead)) {
+            strFailure = "读取失败（错误码 " + std::to_string(LastError()) + "）";
+            break;
+        }
+        if (dwRead == 0) {
+            break;
+        }
+        if (!WriteChunk(hDest, pBuffer, dwRead)) {
+            strFailure = "写入失败（错误码 " + std::to_string(LastError()) + "）";
+            break;
+        }
+        if (bTracked) {
+            objHash.Update(pBuffer, dwRead);
+        }
+        ui64Copied += dwRead;
+        m_ui64BytesDone += dwRead;
+    }
+
+    // 8. 保留时间戳（必须在关闭前设置），失败时删除不完整的目标文件
+    if (strFailure.empty() && bHasTimes) {
+        SetTimes(hDest, stcTimes);
+    }
+    CloseFile(hDest);
+    CloseFile(hSource);
+    if (!strFailure.empty()) {
+        RemoveFile(stcTask.pathDest);
+        m_ui64BytesDone -= ui64Copied;
+        AddError(stcTask.pathSource, strFailure);
+        return;
+    }
+
+    // 9. 保留属性（最后设置，只读属性不影响前面的写入）
+    if (dwAttributes != INVALID_FILE_ATTRIBUTES) {
+        SetAttributes(stcTask.pathDest, dwAttributes & PRESERVED_ATTRIBUTES);
+    }
+    if (bTracked) {
+        stcEntry.ui64Size = ui64Copied;
+        stcEntry.ui64Hash = objHash.Digest();
+        stcEntry.bWritten = true;
+        m_pManifest->Record(wstrKey, stcEntry);
+    }
+    m_ui64FilesDone++;
+}
+
+/********************************************************************************
+* 函数实现：复制文件到镜像（内部辅助）
+* 说明：写入器按顺序请求数据。不超过IMAGE_STAGING_LIMIT的文件在取得镜像锁之前
+*       读入暂存区并计算哈希，锁内只做簇分配和镜像写入，其他工作线程的读取
+*       和哈希与之重叠；更大的文件在锁内直接读入写入器的缓冲区
+*********************************************************************************/
+void CopyEngine::CopyToImage(const Task& stcTask, const std::string& strImagePath, FileHandle hSource,
+                             const NtfsFileProperties& stcProperties, bool bTracked, const std::wstring& wstrKey,
+                             ManifestEntry& stcEntry, std::vector<char>& vecStaging) {
+    uint64_t ui64Copied = 0;
+    XXHash64 objHash;
+    auto fnReadSource = [&](char* pData, size_t nBytes, std::string& strError) {
+        while (nBytes > 0) {
+            DWORD dwRead = 0;
+            DWORD dwWanted = nBytes > BUFFER_SIZE ? BUFFER_SIZE : static_cast<DWORD>(nBytes);
+            if (!ReadChunk(hSource, pData, dwWanted, dwRead)) {
+                strError = "读取失败（错误码 " + std::to_string(LastError()) + "）";
+                return false;
+            }
+            if (dwRead == 0) {
+                strError = "源文件在复制过程中变短";
+                return false;
+            }
+            if (bTracked) {
+                objHash.Update(pData, dwRead);
+            }
+            pData += dwRead;
+            nBytes -= dwRead;
+        }
+        return true;
+    };
+
+    // 1. 选择数据来源：暂存区或源文件
+    std::string strError;
+    NtfsWriter::DataSource fnRead;
+    const size_t nSize = static_cast<size_t>(stcProperties.ui64Size);
+    if (stcProperties.ui64Size <= IMAGE_STAGING_LIMIT) {
+        if (vecStaging.size() < nSize) {
+            vecStaging.resize(nSize);
+        }
+        if (!fnReadSource(vecStaging.data(), nSize, strError)) {
+            AddError(stcTask.pathSource, strError);
+            return;
+        }
+        size_t nOffset = 0;
+        fnRead = [&](char* pData, size_t nBytes, std::string& strReadError) {
+            if (nBytes > nSize - nOffset) {
+                strReadError = "源文件在复制过程中变短";
+                return false;
+            }
+            memcpy(pData, vecStaging.data() + nOffset, nBytes);
+            nOffset += nBytes;
+            ui64Copied += nBytes;
+            m_ui64BytesDone += nBytes;
+            return true;
+        };
+    } else {
+        fnRead = [&](char* pData, size_t nBytes, std::string& strReadError) {
+            if (!fnReadSource(pData, nBytes, strReadError)) {
+                return false;
+            }
+            ui64Copied += nBytes;
+            m_ui64BytesDone += nBytes;
+            return true;
+        };
+    }
+
+    // 2. 写入镜像（写入器不是线程安全的）
+    bool bWritten = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mtxImage);
+        bWritten = m_pImage->WriteFile(strImagePath, stcProperties, fnRead, strError);
+    }
+    if (!bWritten) {
+        m_ui64BytesDone -= ui64Copied;
+        AddError(stcTask.pathSource, strError);
+        return;
+    }
+    if (bTracked) {
+        stcEntry.ui64Hash = objHash.Digest();
+        stcEntry.bWritten = true;
+        m_pManifest->Record(wstrKey, stcEntry);
+    }
+    m_ui64FilesDone++;
+}
+
+/********************************************************************************
+* 函数实现：执行
+*********************************************************************************/
+bool CopyEngine::Run(const ProgressSink& fnProgress, CopyReport& stcReport) {
+    stcReport = CopyReport();
+    if (m_vecJobs.empty()) {
+        return true;
+    }
+
+    // 1. 重置状态，作业轮流分配到各工作线程的队列
+    m_ui64Outstanding = 0;
+    m_ui64Walking = 0;
+    m_ui64FilesFound = 0;
+    m_ui64BytesFound = 0;
+    m_ui64FilesDone = 0;
+    m_ui64BytesDone = 0;
+    m_ui64Directories = 0;
+    m_ui64Skipped = 0;
+    m_ui64Unchanged = 0;
+    m_ui64BytesSaved = 0;
+    m_vecErrors.clear();
+    m_vecQueues.clear();
+    for (unsigned int i = 0; i < m_nWorkers; i++) {
+        m_vecQueues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < m_vecJobs.size(); i++) {
+        Task& stcJob = m_vecJobs[i];
+        std::error_code ec;
+        stcJob.bDirectory = std::filesystem::is_directory(stcJob.pathSource, ec);
+        if (!stcJob.bDirectory) {
+            uint64_t ui64Size = std::filesystem::file_size(stcJob.pathSource, ec);
+            m_ui64FilesFound++;
+            m_ui64BytesFound += ec ? 0 : ui64Size;
+        }
+        Push(static_cast<unsigned int>(i % m_nWorkers), std::move(stcJob));
+    }
+    m_vecJobs.clear();
+
+    // 2. 启动工作线程
+    auto tpStart = std::chrono::steady_clock::now();
+    auto elapsedMs = [&]() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - tpStart).count());
+    };
+    std::vector<std::thread> vecThreads;
+    for (unsigned int i = 0; i < m_nWorkers; i++) {
+        vecThreads.emplace_back(&CopyEngine::WorkerLoop, this, i);
+    }
+
+    // 3. 在调用线程上定期报告进度，直到所有任务完成
+    {
+        std::unique_lock<std::mutex> lock(m_mtxState);
+        while (!m_cvWork.wait_for(lock, std::chrono::milliseconds(PROGRESS_INTERVAL_MS),
+                                  [this]() { return m_ui64Outstanding == 0; })) {
+            if (!fnProgress) {
+                continue;
+            }
+            uint64_t ui64Elapsed = elapsedMs();
+            uint64_t ui64BytesDone = m_ui64BytesDone;
+            uint64_t ui64BytesFound = m_ui64BytesFound;
+            std::string strMessage = "正在复制: " + std::to_string(m_ui64FilesDone.load()) + "/" +
+                                     std::to_string(m_ui64FilesFound.load()) + " 个文件, " +
+                                     FormatBytes(ui64BytesDone) + "/" + FormatBytes(ui64BytesFound) + ", " +
+                                     FormatRate(ui64BytesDone, ui64Elapsed);
+            // 仍在遍历目录时总量未知，不估计剩余时间
+            if (m_ui64Walking == 0 && ui64BytesDone > 0 && ui64BytesFound > ui64BytesDone) {
+                uint64_t ui64RemainingSec = (ui64BytesFound - ui64BytesDone) * ui64Elapsed / ui64BytesDone / 1000;
+                strMessage += ", 剩余约 " + std::to_string(ui64RemainingSec + 1) + " 秒";
+            }
+            lock.unlock();
+            fnProgress(strMessage);
+            lock.lock();
+        }
+    }
+    for (auto& objThread : vecThreads) {
+        objThread.join();
+    }
+
+    // 4. 汇总结果
+    stcReport.ui64Files = m_ui64FilesDone;
+    stcReport.ui64Bytes = m_ui64BytesDone;
+    stcReport.ui64Directories = m_ui64Directories;
+    stcReport.ui64Skipped = m_ui64Skipped;
+    stcReport.ui64Unchanged = m_ui64Unchanged;
+    stcReport.ui64BytesSaved = m_ui64BytesSaved;
+    stcReport.ui64ElapsedMs = elapsedMs();
+    stcReport.vecErrors = std::move(m_vecErrors);
+    m_vecErrors.clear();
+    m_vecQueues.clear();
+
+    if (fnProgress) {
+        std::string strSummary = "复制完成: " + std::to_string(stcReport.ui64Files) + " 个文件, " +
+                                 FormatBytes(stcReport.ui64Bytes) + ", 用时 " +
+                                 std::to_string(stcReport.ui64ElapsedMs / 1000) + "." +
+                                 std::to_string(stcReport.ui64ElapsedMs % 1000 / 100) + " 秒 (" +
+                                 FormatRate(stcReport.ui64Bytes, stcReport.ui64ElapsedMs) + ")";
+        if (stcReport.ui64Unchanged > 0) {
+            strSummary += ", 未变化 " + std::to_string(stcReport.ui64Unchanged) + " 个文件（节省 " +
+                          FormatBytes(stcReport.ui64BytesSaved) + "）";
+        }
+        if (stcReport.ui64Skipped > 0) {
+            strSummary += ", 跳过 " + std::to_string(stcReport.ui64Skipped) + " 项";
+        }
+        if (!stcReport.vecErrors.empty()) {
+            strSummary += ", 失败 " + std::to_string(stcReport.vecErrors.size()) + " 项";
+        }
+        fnProgress(strSummary);
+    }
+    return stcReport.vecErrors.empty();
+}
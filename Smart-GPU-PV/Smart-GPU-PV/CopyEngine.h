@@ -0,0 +1,226 @@
+﻿/********************************************************************************
+* 文件名称：CopyEngine.h
+* 文件功能：并行复制驱动文件和目录的本地复制引擎
+*
+* 类说明：
+*    驱动包过去由PowerShell的Copy-Item -Recurse -Force复制：单线程、没有
+*    进度、在SilentlyContinue下错误被静默丢弃。CopyEngine在C++中完成复制：
+*    - 目录遍历和文件复制都是任务，由一组工作线程执行；每个线程有自己的
+*      任务队列，遍历产生的子任务放入自己的队列，空闲线程从其他线程的
+*      队列头部窃取任务（大目录树可以迅速分散到所有线程）
+*    - 每个工作线程使用一块页对齐的大缓冲区（BUFFER_SIZE）顺序读写，
+*      写入前按源文件大小预分配目标文件
+*    - 复制后保留源文件的创建/访问/修改时间和文件属性
+*    - 每个失败的文件记录一条错误（路径 + 原因），不中断其他文件
+*    - 运行期间定期通过回调报告已复制的文件数、字节数、速度和剩余时间
+*    - 设置DriverManifest后增量同步：内容未变化的文件不复制，复制的同时计算
+*      xxHash64并写入清单
+*    - 设置镜像目标后，目标在镜像根之下的作业不经过本地文件系统，由NtfsWriter
+*      直接写入虚拟机磁盘镜像中的NTFS卷（不需要挂载）
+*
+* 作业语义：
+*    - 源为文件：复制到目标文件路径（自动创建父目录，覆盖只读文件）
+*    - 源为目录：目录的内容递归复制到目标目录（目标目录自动创建）
+*    - bSkipExisting：目标已存在时跳过整个作业
+*
+* 依赖项：
+*    - Windows API或POSIX（文件读写、时间和属性；其他平台上用于测试和基准测试，
+*      只读属性对应属主写权限，创建时间以修改时间代替）
+*    - DriverManifest、XXHash64（增量同步）
+*    - NtfsWriter（写入镜像）
+*    - std::filesystem（目录遍历）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <filesystem>
+#include <cstdint>
+#include "Platform.h"
+#include "DriverManifest.h"
+#include "NtfsWriter.h"
+
+/********************************************************************************
+* 结构体名称：复制错误
+*********************************************************************************/
+struct CopyError {
+    std::string strPath;      // 出错的源路径（UTF-8）
+    std::string strMessage;   // 错误原因
+};
+
+/********************************************************************************
+* 结构体名称：复制报告
+*********************************************************************************/
+struct CopyReport {
+    uint64_t               ui64Files = 0;         // 已复制的文件数
+    uint64_t               ui64Bytes = 0;         // 已复制的字节数
+    uint64_t               ui64Directories = 0;   // 已遍历的目录数
+    uint64_t               ui64Skipped = 0;       // 因目标已存在而跳过的作业数
+    uint64_t               ui64Unchanged = 0;     // 增量同步时内容未变化、未复制的文件数
+    uint64_t               ui64BytesSaved = 0;    // 未变化文件的字节数
+    uint64_t               ui64ElapsedMs = 0;     // 总耗时（毫秒）
+    std::vector<CopyError> vecErrors;             // 失败的文件
+};
+
+/********************************************************************************
+* 类名称：复制引擎
+* 类功能：收集复制作业并以多线程执行
+*
+* 调用示例：
+*    CopyEngine objEngine;
+*    objEngine.Add("C:\\Windows\\System32\\DriverStore\\FileRepository\\nv_dispi.inf_amd64_x",
+*                  "E:\\Windows\\System32\\HostDriverStore\\FileRepository\\nv_dispi.inf_amd64_x", true);
+*    objEngine.Add("C:\\Windows\\System32\\nvapi64.dll", "E:\\Windows\\System32\\nvapi64.dll");
+*    CopyReport stcReport;
+*    if (!objEngine.Run(callback, stcReport)) {
+*        for (const auto& stcError : stcReport.vecErrors) { ... }
+*    }
+*********************************************************************************/
+class CopyEngine {
+public:
+    // 平台文件句柄（Windows为HANDLE，其他平台为文件描述符）
+#ifdef _WIN32
+    using FileHandle = HANDLE;
+#else
+    using FileHandle = int;
+#endif
+
+    // 进度回调：每条消息一行（不含换行符）
+    using ProgressSink = std::function<void(const std::string& strMessage)>;
+
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  unsigned int nWorkers：工作线程数（0表示按CPU核数选择，2~8个）
+    *********************************************************************************/
+    explicit CopyEngine(unsigned int nWorkers = 0);
+    ~CopyEngine();
+    CopyEngine(const CopyEngine&) = delete;
+    CopyEngine& operator=(const CopyEngine&) = delete;
+
+    /********************************************************************************
+    * 函数名称：添加作业
+    * 函数参数：
+    *    [IN]  const std::string& strSource：源文件或目录（UTF-8）
+    *    [IN]  const std::string& strDest：目标文件或目录（UTF-8）
+    *    [IN]  bool bSkipExisting：目标已存在时跳过
+    *********************************************************************************/
+    void Add(const std::string& strSource, const std::string& strDest, bool bSkipExisting = false);
+
+    /********************************************************************************
+    * 函数名称：设置同步清单
+    * 函数功能：之后的执行按清单增量同步，复制或确认未变化的文件记入清单
+    * 函数参数：
+    *    [IN]  DriverManifest* pManifest：清单（nullptr表示不使用，由调用者保存）
+    * 注意事项：
+    *    - 只有目标在清单所属卷根目录下的文件参与增量比较
+    *    - 目标大小与源不一致时总是复制（截断的文件不会被当作未变化）
+    *********************************************************************************/
+    void SetManifest(DriverManifest* pManifest) { m_pManifest = pManifest; }
+
+    /********************************************************************************
+    * 函数名称：设置镜像目标
+    * 函数功能：目标路径在镜像根之下的作业写入NtfsWriter，镜像根之后的部分是卷内路径
+    * 函数参数：
+    *    [IN]  NtfsWriter* pWriter：已开始会话的写入器（nullptr表示不使用）
+    *    [IN]  const std::string& strImageRoot：镜像根（UTF-8，通常是VHDX文件路径）
+    * 注意事项：
+    *    - NtfsWriter不是线程安全的，m_mtxImage串行化所有调用，包括
+    *      NtfsWriter::WriteFile：写入镜像的文件逐个写入。不超过
+    *      IMAGE_STAGING_LIMIT的文件在取得镜像锁之前读入暂存区并计算哈希，
+    *      锁内只有簇分配和镜像写入；更大的文件在持有锁时边读边写
+    *    - 锁外只有读源文件和哈希可以并行，工作线程数因此限制为
+    *      IMAGE_MAX_WORKERS，更多的线程只会在锁上等待并各占一块暂存区
+    *    - 写入器由调用者提交
+    *********************************************************************************/
+    void SetImageTarget(NtfsWriter* pWriter, const std::string& strImageRoot);
+
+    /********************************************************************************
+    * 函数名称：执行
+    * 函数功能：执行所有已添加的作业，期间在调用线程上定期报告进度
+    * 函数参数：
+    *    [IN]  const ProgressSink& fnProgress：进度回调（可为空）
+    *    [OUT] CopyReport& stcReport：复制结果
+    * 返回类型：bool
+    *    没有任何错误返回true
+    * 注意事项：
+    *    - 回调只在调用线程上执行
+    *    - 执行后作业列表被清空，可以继续添加作业再次执行
+    *********************************************************************************/
+    bool Run(const ProgressSink& fnProgress, CopyReport& stcReport);
+
+    // 每个工作线程的复制缓冲区大小（字节，页对齐）
+    static const DWORD BUFFER_SIZE = 1024 * 1024;
+    // 写入镜像前整体读入暂存区的文件大小上限（字节，每个工作线程一块暂存区）
+    static const uint64_t IMAGE_STAGING_LIMIT = 16 * 1024 * 1024;
+    // 写入镜像时的工作线程数上限（一个线程持有镜像锁写入，其余读取和哈希下一批文件）
+    static const unsigned int IMAGE_MAX_WORKERS = 3;
+    // 进度报告间隔（毫秒）
+    static const DWORD PROGRESS_INTERVAL_MS = 1000;
+
+private:
+    /********************************************************************************
+    * 结构体名称：任务
+    *********************************************************************************/
+    struct Task {
+        bool                   bDirectory = false;     // 遍历目录（否则复制文件）
+        std::filesystem::path  pathSource;
+        std::filesystem::path  pathDest;
+        bool                   bSkipExisting = false;
+    };
+
+    /********************************************************************************
+    * 结构体名称：工作线程队列
+    *********************************************************************************/
+    struct WorkerQueue {
+        std::mutex        mtxTasks;
+        std::deque<Task>  deqTasks;   // 所有者从尾部取，窃取者从头部取
+    };
+
+    unsigned int                               m_nWorkers;         // 工作线程数
+    std::vector<Task>                          m_vecJobs;          // 待执行的作业
+    DriverManifest*                            m_pManifest = nullptr;  // 增量同步清单
+    NtfsWriter*                                m_pImage = nullptr;     // 镜像写入器
+    std::wstring                               m_wstrImageRoot;        // 镜像根（不含末尾的分隔符）
+    std::mutex                                 m_mtxImage;             // 串行化镜像写入器的调用
+    std::vector<std::unique_ptr<WorkerQueue>>  m_vecQueues;        // 每个工作线程一个队列
+
+    std::atomic<uint64_t>                      m_ui64Outstanding{ 0 };  // 已提交、尚未完成的任务数
+    std::atomic<uint64_t>                      m_ui64Walking{ 0 };      // 尚未完成的目录遍历任务数
+    std::atomic<uint64_t>                      m_ui64FilesFound{ 0 };   // 已发现的文件数
+    std::atomic<uint64_t>                      m_ui64BytesFound{ 0 };   // 已发现的字节数
+    std::atomic<uint64_t>                      m_ui64FilesDone{ 0 };    // 已复制的文件数
+    std::atomic<uint64_t>                      m_ui64BytesDone{ 0 };    // 已复制的字节数
+    std::atomic<uint64_t>                      m_ui64Directories{ 0 };
+    std::atomic<uint64_t>                      m_ui64Skipped{ 0 };
+    std::atomic<uint64_t>                      m_ui64Unchanged{ 0 };
+    std::atomic<uint64_t>                      m_ui64BytesSaved{ 0 };
+
+    std::mutex                                 m_mtxState;         // 保护m_vecErrors和等待
+    std::condition_variable                    m_cvWork;           // 有新任务或全部完成时通知
+    std::vector<CopyError>                     m_vecErrors;
+
+    void WorkerLoop(unsigned int nIndex);
+    bool TakeTask(unsigned int nIndex, Task& stcTask);
+    void Push(unsigned int nIndex, Task stcTask);
+    void FinishTask();
+    void WalkDirectory(unsigned int nIndex, const Task& stcTask);
+    void CopyFileTask(const Task& stcTask, char* pBuffer, std::vector<char>& vecStaging);
+    void CopyToImage(const Task& stcTask, const std::string& strImagePath, FileHandle hSource,
+                     const NtfsFileProperties& stcProperties, bool bTracked, const std::wstring& wstrKey,
+                     ManifestEntry& stcEntry, std::vector<char>& vecStaging);
+    bool IsUnchanged(FileHandle hSource, char* pBuffer, uint64_t ui64DestSize, uint64_t ui64DestWriteTime,
+                     const std::wstring& wstrKey, ManifestEntry& stcEntry);
+    bool ImagePath(const std::filesystem::path& pathDest, std::string& strImagePath) const;
+    void AddError(const std::filesystem::path& pathSource, const std::string& strMessage);
+};
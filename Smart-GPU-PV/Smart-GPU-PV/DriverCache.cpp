@@ -0,0 +1,369 @@
+﻿/********************************************************************************
+* 文件名称：DriverCache.cpp
+* 文件功能：实现主机端驱动文件缓存
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "DriverCache.h"
+#include "Utils.h"
+#include "Platform.h"
+#include <fstream>
+#include <charconv>
+#include <mutex>
+#include <unordered_set>
+#include <algorithm>
+#include <cstdio>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// 版本清单文件的版本标记
+static const char* const VERSION_HEADER = "# Smart-GPU-PV driver cache version v1";
+
+// 进程内所有DriverCache实例共用的锁
+static std::mutex g_mtxCache;
+
+//==============================================================================
+// 平台相关的本地文件操作（内部辅助）：缓存中的路径以UTF-8保存，
+// 虚拟机中的相对路径以'\'分隔，其他平台上访问本地文件时转换为'/'
+//==============================================================================
+
+#ifdef _WIN32
+static std::filesystem::path LocalPath(const std::string& strPath) { return Utils::StringToWString(strPath); }
+static std::string FromPath(const std::filesystem::path& path) { return Utils::WStringToString(path.wstring()); }
+
+static std::filesystem::path DefaultRoot() {
+    wchar_t szProgramData[MAX_PATH] = { 0 };
+    DWORD dwLength = GetEnvironmentVariableW(L"ProgramData", szProgramData, MAX_PATH);
+    std::filesystem::path pathRoot = (dwLength > 0 && dwLength < MAX_PATH) ? szProgramData : L"C:\\ProgramData";
+    return pathRoot / L"Smart-GPU-PV" / L"DriverCache";
+}
+
+static bool DeleteLocalFile(const std::filesystem::path& path) {
+    SetFileAttributesW(path.c_str(), FILE_ATTRIBUTE_NORMAL);
+    return DeleteFileW(path.c_str()) != FALSE;
+}
+
+static void RemoveLocalDirectory(const std::filesystem::path& path) { RemoveDirectoryW(path.c_str()); }
+
+static bool ReplaceLocalFile(const std::filesystem::path& pathTemp, const std::filesystem::path& pathTarget) {
+    if (!MoveFileExW(pathTemp.c_str(), pathTarget.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(pathTemp.c_str());
+        return false;
+    }
+    return true;
+}
+#else
+static std::filesystem::path LocalPath(const std::string& strPath) {
+    std::string strLocal(strPath);
+    std::replace(strLocal.begin(), strLocal.end(), '\\', '/');
+    return std::filesystem::path(strLocal);
+}
+
+static std::string FromPath(const std::filesystem::path& path) { return path.string(); }
+
+static std::filesystem::path DefaultRoot() {
+    std::error_code ec;
+    return std::filesystem::temp_directory_path(ec) / "Smart-GPU-PV" / "DriverCache";
+}
+
+static bool DeleteLocalFile(const std::filesystem::path& path) { return unlink(path.c_str()) == 0; }
+
+static void RemoveLocalDirectory(const std::filesystem::path& path) { rmdir(path.c_str()); }
+
+static bool ReplaceLocalFile(const std::filesystem::path& pathTemp, const std::filesystem::path& pathTarget) {
+    if (std::rename(pathTemp.c_str(), pathTarget.c_str()) != 0) {
+        unlink(pathTemp.c_str());
+        return false;
+    }
+    return true;
+}
+#endif
+
+/********************************************************************************
+* 函数实现：对象文件名（内部辅助）
+*********************************************************************************/
+static std::string ObjectName(uint64_t ui64Hash, uint64_t ui64Size) {
+    char szName[48] = { 0 };
+    snprintf(szName, sizeof(szName), "%016llx-%llu", static_cast<unsigned long long>(ui64Hash),
+             static_cast<unsigned long long>(ui64Size));
+    return szName;
+}
+
+/********************************************************************************
+* 函数实现：取出下一个以空格分隔的无符号整数字段（内部辅助）
+*********************************************************************************/
+static bool NextNumber(std::string_view& svRest, uint64_t& ui64Value, int nBase) {
+    size_t nSpace = svRest.find(' ');
+    if (nSpace == std::string_view::npos) {
+        return false;
+    }
+    auto stcResult = std::from_chars(svRest.data(), svRest.data() + nSpace, ui64Value, nBase);
+    if (stcResult.ec != std::errc() || stcResult.ptr != svRest.data() + nSpace) {
+        return false;
+    }
+    svRest.remove_prefix(nSpace + 1);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：构造函数
+*********************************************************************************/
+DriverCache::DriverCache(const std::string& strRoot)
+    : m_pathRoot(strRoot.empty() ? DefaultRoot() : LocalPath(strRoot)) {
+}
+
+/********************************************************************************
+* 函数实现：生成版本键
+*********************************************************************************/
+std::string DriverCache::MakeVersionKey(const std::string& strGPUName, const std::string& strDriverVersion) {
+    if (strDriverVersion.empty()) {
+        return "";
+    }
+    // 只保留文件名安全的字符
+    std::string strKey = strGPUName + "_" + strDriverVersion;
+    for (auto& ch : strKey) {
+        bool bSafe = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+                     ch == '.' || ch == '-' || ch == '_';
+        if (!bSafe) {
+            ch = '_';
+        }
+    }
+    return strKey;
+}
+
+/********************************************************************************
+* 函数实现：版本文件路径（内部辅助）
+*********************************************************************************/
+std::filesystem::path DriverCache::VersionPath(const std::string& strKey, const char* pszExtension) const {
+    return m_pathRoot / "versions" / LocalPath(strKey + pszExtension);
+}
+
+/********************************************************************************
+* 函数实现：取对象路径
+*********************************************************************************/
+std::string DriverCache::ObjectPath(const CacheEntry& stcEntry) const {
+    std::string strName = ObjectName(stcEntry.ui64Hash, stcEntry.ui64Size);
+    return FromPath(m_pathRoot / "objects" / strName.substr(0, 2) / strName);
+}
+
+/********************************************************************************
+* 函数实现：读取文本行（内部辅助）
+*********************************************************************************/
+bool DriverCache::ReadLines(const std::filesystem::path& path, std::vector<std::string>& vecLines) {
+    std::ifstream objFile{ path, std::ios::binary };
+    if (!objFile) {
+        return false;
+    }
+    std::string strLine;
+    while (std::getline(objFile, strLine)) {
+        std::string_view svLine = Utils::TrimView(strLine);
+        if (!svLine.empty()) {
+            vecLines.emplace_back(svLine);
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：写入文本行（内部辅助，写临时文件后替换）
+*********************************************************************************/
+bool DriverCache::WriteLines(const std::filesystem::path& path, const std::vector<std::string>& vecLines) {
+    std::filesystem::path pathTemp = path;
+    pathTemp += ".tmp";
+    {
+        std::ofstream objFile{ pathTemp, std::ios::binary | std::ios::trunc };
+        if (!objFile) {
+            return false;
+        }
+        for (const auto& strLine : vecLines) {
+            objFile << strLine << "\n";
+        }
+        if (!objFile.flush()) {
+            return false;
+        }
+    }
+    return ReplaceLocalFile(pathTemp, path);
+}
+
+/********************************************************************************
+* 函数实现：加载版本清单
+*********************************************************************************/
+bool DriverCache::LoadVersion(const std::string& strKey, std::vector<CacheEntry>& vecEntries) const {
+    std::lock_guard<std::mutex> lock(g_mtxCache);
+    vecEntries.clear();
+    if (strKey.empty()) {
+        return false;
+    }
+
+    // 1. 读取并校验版本清单
+    std::vector<std::string> vecLines;
+    if (!ReadLines(VersionPath(strKey, ".txt"), vecLines) || vecLines.empty() || vecLines[0] != VERSION_HEADER) {
+        return false;
+    }
+
+    // 2. 解析条目：哈希 大小 时间 路径，任何对象缺失都视为未缓存
+    for (size_t i = 1; i < vecLines.size(); i++) {
+        std::string_view svLine = vecLines[i];
+        CacheEntry stcEntry;
+        if (!NextNumber(svLine, stcEntry.ui64Hash, 16) ||
+            !NextNumber(svLine, stcEntry.ui64Size, 10) ||
+            !NextNumber(svLine, stcEntry.ui64WriteTime, 10) ||
+            svLine.empty()) {
+            vecEntries.clear();
+            return false;
+        }
+        stcEntry.strRelativePath.assign(svLine);
+        std::error_code ec;
+        if (!std::filesystem::exists(LocalPath(ObjectPath(stcEntry)), ec)) {
+            vecEntries.clear();
+            return false;
+        }
+        vecEntries.push_back(std::move(stcEntry));
+    }
+    return !vecEntries.empty();
+}
+
+/********************************************************************************
+* 函数实现：保存版本
+*********************************************************************************/
+bool DriverCache::StoreVersion(const std::string& strKey, const std::string& strVolumeRoot,
+                               const std::vector<CacheEntry>& vecEntries, std::string& strError) {
+    std::lock_guard<std::mutex> lock(g_mtxCache);
+    if (strKey.empty() || vecEntries.empty()) {
+        strError = "没有可缓存的驱动文件";
+        return false;
+    }
+
+    // 1. 缺失的对象从源文件复制（同一内容只复制一次，已有的对象跳过）
+    std::error_code ec;
+    std::filesystem::create_directories(m_pathRoot / "versions", ec);
+    CopyEngine objEngine;
+    std::unordered_set<std::string> setObjects;
+    std::vector<std::string> vecLines = { VERSION_HEADER };
+    char szHash[20] = { 0 };
+    for (const auto& stcEntry : vecEntries) {
+        std::string strObject = ObjectPath(stcEntry);
+        if (setObjects.insert(strObject).second) {
+            std::string strSource = stcEntry.strSourcePath.empty() ?
+                                    FromPath(LocalPath(strVolumeRoot + "\\" + stcEntry.strRelativePath)) :
+                                    stcEntry.strSourcePath;
+            objEngine.Add(strSource, strObject, true);
+        }
+        snprintf(szHash, sizeof(szHash), "%016llx", static_cast<unsigned long long>(stcEntry.ui64Hash));
+        vecLines.push_back(std::string(szHash) + " " + std::to_string(stcEntry.ui64Size) + " " +
+                           std::to_string(stcEntry.ui64WriteTime) + " " + stcEntry.strRelativePath);
+    }
+    CopyReport stcReport;
+    if (!objEngine.Run(nullptr, stcReport)) {
+        strError = "写入驱动缓存失败: " + stcReport.vecErrors.front().strPath + " - " +
+                   stcReport.vecErrors.front().strMessage;
+        return false;
+    }
+
+    // 2. 对象齐全后才写版本清单，清单存在即表示版本可用
+    if (!WriteLines(VersionPath(strKey, ".txt"), vecLines)) {
+        strError = "写入驱动缓存版本清单失败";
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：添加引用
+*********************************************************************************/
+void DriverCache::AddReference(const std::string& strKey, const std::string& strVMName) {
+    std::lock_guard<std::mutex> lock(g_mtxCache);
+    std::filesystem::path pathTarget = VersionPath(strKey, ".refs");
+
+    // 1. 从其他版本的引用中移除该虚拟机
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(m_pathRoot / "versions", ec), itEnd; !ec && it != itEnd; it.increment(ec)) {
+        if (it->path().extension() != ".refs" || it->path() == pathTarget) {
+            continue;
+        }
+        std::vector<std::string> vecNames;
+        if (!ReadLines(it->path(), vecNames)) {
+            continue;
+        }
+        size_t nBefore = vecNames.size();
+        vecNames.erase(std::remove(vecNames.begin(), vecNames.end(), strVMName), vecNames.end());
+        if (vecNames.size() != nBefore) {
+            WriteLines(it->path(), vecNames);
+        }
+    }
+
+    // 2. 加入当前版本
+    std::vector<std::string> vecNames;
+    ReadLines(pathTarget, vecNames);
+    if (std::find(vecNames.begin(), vecNames.end(), strVMName) == vecNames.end()) {
+        vecNames.push_back(strVMName);
+        WriteLines(pathTarget, vecNames);
+    }
+}
+
+/********************************************************************************
+* 函数实现：垃圾回收
+*********************************************************************************/
+void DriverCache::CollectGarbage(size_t& nVersions, size_t& nObjects, uint64_t& ui64Bytes) {
+    std::lock_guard<std::mutex> lock(g_mtxCache);
+    nVersions = 0;
+    nObjects = 0;
+    ui64Bytes = 0;
+
+    // 1. 删除引用为空的版本（还没有.refs文件的版本刚保存、尚未被引用，保留）
+    std::error_code ec;
+    std::unordered_set<std::string> setLive;
+    std::vector<std::filesystem::path> vecVersions;
+    for (std::filesystem::directory_iterator it(m_pathRoot / "versions", ec), itEnd; !ec && it != itEnd; it.increment(ec)) {
+        if (it->path().extension() == ".txt") {
+            vecVersions.push_back(it->path());
+        }
+    }
+    for (const auto& pathVersion : vecVersions) {
+        std::filesystem::path pathRefs = pathVersion;
+        pathRefs.replace_extension(".refs");
+        std::vector<std::string> vecNames;
+        if (ReadLines(pathRefs, vecNames) && vecNames.empty()) {
+            DeleteLocalFile(pathVersion);
+            DeleteLocalFile(pathRefs);
+            nVersions++;
+            continue;
+        }
+
+        // 2. 保留的版本引用的对象
+        std::vector<std::string> vecLines;
+        ReadLines(pathVersion, vecLines);
+        for (size_t i = 1; i < vecLines.size(); i++) {
+            std::string_view svLine = vecLines[i];
+            uint64_t ui64Hash = 0, ui64Size = 0;
+            if (NextNumber(svLine, ui64Hash, 16) && NextNumber(svLine, ui64Size, 10)) {
+                setLive.insert(ObjectName(ui64Hash, ui64Size));
+            }
+        }
+    }
+
+    // 3. 删除不再被引用的对象（只读对象先清除属性）
+    std::vector<std::filesystem::path> vecPrefixes;
+    for (std::filesystem::directory_iterator it(m_pathRoot / "objects", ec), itEnd; !ec && it != itEnd; it.increment(ec)) {
+        vecPrefixes.push_back(it->path());
+    }
+    for (const auto& pathPrefix : vecPrefixes) {
+        std::error_code ecObject;
+        for (std::filesystem::directory_iterator it(pathPrefix, ecObject), itEnd; !ecObject && it != itEnd; it.increment(ecObject)) {
+            if (setLive.count(FromPath(it->path().filename())) > 0) {
+                continue;
+            }
+            std::error_code ecSize;
+            uint64_t ui64Size = it->file_size(ecSize);
+            if (DeleteLocalFile(it->path())) {
+                nObjects++;
+                ui64Bytes += ecSize ? 0 : ui64Size;
+            }
+        }
+        RemoveLocalDirectory(pathPrefix);
+    }
+}
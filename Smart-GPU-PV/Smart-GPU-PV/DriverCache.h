@@ -0,0 +1,141 @@
+﻿/********************************************************************************
+* 文件名称：DriverCache.h
+* 文件功能：主机端按内容寻址的驱动文件缓存，多个虚拟机共用
+*
+* 类说明：
+*    用同一版本的主机驱动配置多台虚拟机时，每台都要重新枚举驱动文件
+*    （Win32_PNPSignedDriverCIMDataFile查询需要数十秒），并从分散的
+*    FileRepository目录读取同样的文件。DriverCache按驱动版本缓存一次：
+*    - 对象：每个文件内容保存一份，以xxHash64和大小命名，内容相同的文件
+*      （不同版本、不同目录）只保存一次
+*    - 版本清单：某个驱动版本需要写入虚拟机的全部文件（对象 + 虚拟机中的
+*      相对路径），命中时直接按清单复制，不再枚举
+*    - 引用：每个版本记录使用它的虚拟机；虚拟机改用新版本时释放旧版本
+*    - 垃圾回收：删除没有虚拟机引用的旧版本，以及不再被任何版本引用的对象
+*
+* 目录结构（默认位于%ProgramData%\Smart-GPU-PV\DriverCache）：
+*    objects\<哈希前2位>\<哈希16位>-<大小>
+*    versions\<版本键>.txt     版本清单（格式同DriverManifest）
+*    versions\<版本键>.refs    引用该版本的虚拟机名称，每行一个
+*    Windows以外的平台上默认位于临时目录（只用于测试）
+*
+* 线程安全：
+*    同一进程内的所有实例共用一把锁，并发配置多台虚拟机时串行化缓存写入
+*
+* 依赖项：
+*    - CopyEngine（写入对象）
+*    - DriverManifest（条目格式）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "CopyEngine.h"
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <cstdint>
+
+/********************************************************************************
+* 结构体名称：缓存条目
+*********************************************************************************/
+struct CacheEntry {
+    std::string strRelativePath;    // 虚拟机中相对于卷根目录的路径（UTF-8）
+    uint64_t    ui64Size = 0;       // 文件大小
+    uint64_t    ui64WriteTime = 0;  // 源文件修改时间（FILETIME）
+    uint64_t    ui64Hash = 0;       // 内容的xxHash64
+    std::string strSourcePath;      // 主机上的源文件（UTF-8，不保存；为空时从虚拟机磁盘读取）
+};
+
+/********************************************************************************
+* 类名称：驱动文件缓存
+* 类功能：按驱动版本保存和提供驱动文件
+*
+* 调用示例：
+*    DriverCache objCache;
+*    std::string strKey = DriverCache::MakeVersionKey(strGPUName, strDriverVersion);
+*    std::vector<CacheEntry> vecEntries;
+*    if (objCache.LoadVersion(strKey, vecEntries)) {
+*        for (const auto& stcEntry : vecEntries) {
+*            objEngine.Add(objCache.ObjectPath(stcEntry), "E:\\" + stcEntry.strRelativePath);
+*        }
+*    }
+*********************************************************************************/
+class DriverCache {
+public:
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  const std::string& strRoot：缓存根目录（UTF-8，空表示默认位置）
+    *********************************************************************************/
+    explicit DriverCache(const std::string& strRoot = "");
+
+    /********************************************************************************
+    * 函数名称：生成版本键
+    * 函数参数：
+    *    [IN]  const std::string& strGPUName：GPU名称
+    *    [IN]  const std::string& strDriverVersion：驱动版本号
+    * 返回类型：std::string
+    *    可用作文件名的版本键；驱动版本为空时返回空字符串（不使用缓存）
+    *********************************************************************************/
+    static std::string MakeVersionKey(const std::string& strGPUName, const std::string& strDriverVersion);
+
+    /********************************************************************************
+    * 函数名称：加载版本清单
+    * 函数参数：
+    *    [IN]  const std::string& strKey：版本键
+    *    [OUT] std::vector<CacheEntry>& vecEntries：条目
+    * 返回类型：bool
+    *    版本已缓存且所有对象都存在返回true
+    *********************************************************************************/
+    bool LoadVersion(const std::string& strKey, std::vector<CacheEntry>& vecEntries) const;
+
+    /********************************************************************************
+    * 函数名称：保存版本
+    * 函数功能：把刚同步的文件存为对象（已有的对象跳过），再写版本清单
+    * 函数参数：
+    *    [IN]  const std::string& strKey：版本键
+    *    [IN]  const std::string& strVolumeRoot：虚拟机系统卷的根目录（条目没有源文件路径时从这里读取）
+    *    [IN]  const std::vector<CacheEntry>& vecEntries：条目
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    * 注意事项：
+    *    - 对象优先从主机上的源文件读取（离线写入镜像时虚拟机磁盘没有挂载）；
+    *      文件刚被读取过，仍在系统文件缓存中，读取很快；哈希在复制时已经算出，
+    *      不需要再读一遍
+    *********************************************************************************/
+    bool StoreVersion(const std::string& strKey, const std::string& strVolumeRoot,
+                      const std::vector<CacheEntry>& vecEntries, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：取对象路径
+    * 返回类型：std::string
+    *    对象文件的完整路径（UTF-8）
+    *********************************************************************************/
+    std::string ObjectPath(const CacheEntry& stcEntry) const;
+
+    /********************************************************************************
+    * 函数名称：添加引用
+    * 函数功能：记录虚拟机使用该版本，并从其他版本的引用中移除该虚拟机
+    *********************************************************************************/
+    void AddReference(const std::string& strKey, const std::string& strVMName);
+
+    /********************************************************************************
+    * 函数名称：垃圾回收
+    * 函数功能：删除没有引用的版本及不再被任何版本引用的对象
+    * 函数参数：
+    *    [OUT] size_t& nVersions：删除的版本数
+    *    [OUT] size_t& nObjects：删除的对象数
+    *    [OUT] uint64_t& ui64Bytes：释放的字节数
+    *********************************************************************************/
+    void CollectGarbage(size_t& nVersions, size_t& nObjects, uint64_t& ui64Bytes);
+
+private:
+    std::filesystem::path m_pathRoot;   // 缓存根目录
+
+    std::filesystem::path VersionPath(const std::string& strKey, const char* pszExtension) const;
+    static bool ReadLines(const std::filesystem::path& path, std::vector<std::string>& vecLines);
+    static bool WriteLines(const std::filesystem::path& path, const std::vector<std::string>& vecLines);
+};
@@ -0,0 +1,407 @@
+﻿/********************************************************************************
+* 文件名称：DriverManifest.cpp
+* 文件功能：实现驱动文件同步清单
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "DriverManifest.h"
+#include "Utils.h"
+#include "NtfsWriter.h"
+#include "Platform.h"
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <filesystem>
+#include <charconv>
+#include <cwctype>
+#include <cstdio>
+#include <cstring>
+#ifndef _WIN32
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+const wchar_t* const DriverManifest::MANIFEST_PATH = L"Windows\\System32\\HostDriverStore\\sgp-driver-manifest.txt";
+const char* const DriverManifest::MANIFEST_HEADER = "# Smart-GPU-PV driver manifest v1";
+
+//==============================================================================
+// 平台相关的本地文件操作（内部辅助）：条目键和卷根目录以'\'分隔，
+// 其他平台上访问本地文件时转换为'/'
+//==============================================================================
+
+#ifdef _WIN32
+static std::filesystem::path LocalPath(const std::wstring& wstrPath) { return std::filesystem::path(wstrPath); }
+
+static uint64_t CurrentFileTime() {
+    FILETIME ftNow = { 0 };
+    GetSystemTimeAsFileTime(&ftNow);
+    return (static_cast<uint64_t>(ftNow.dwHighDateTime) << 32) | ftNow.dwLowDateTime;
+}
+
+static bool DeleteLocalFile(const std::filesystem::path& path, bool& bExists) {
+    DWORD dwAttributes = GetFileAttributesW(path.c_str());
+    bExists = dwAttributes != INVALID_FILE_ATTRIBUTES;
+    if (bExists && (dwAttributes & FILE_ATTRIBUTE_READONLY)) {
+        SetFileAttributesW(path.c_str(), dwAttributes & ~FILE_ATTRIBUTE_READONLY);
+    }
+    return !bExists || DeleteFileW(path.c_str());
+}
+
+static bool RemoveLocalDirectory(const std::filesystem::path& path) { return RemoveDirectoryW(path.c_str()) != FALSE; }
+
+static bool ReplaceLocalFile(const std::filesystem::path& pathTemp, const std::filesystem::path& pathTarget,
+                             std::string& strError) {
+    if (!MoveFileExW(pathTemp.c_str(), pathTarget.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        strError = "替换驱动清单文件失败（错误码 " + std::to_string(GetLastError()) + "）";
+        DeleteFileW(pathTemp.c_str());
+        return false;
+    }
+    return true;
+}
+#else
+static std::filesystem::path LocalPath(const std::wstring& wstrPath) {
+    std::wstring wstrLocal(wstrPath);
+    for (auto& ch : wstrLocal) {
+        if (ch == L'\\') {
+            ch = L'/';
+        }
+    }
+    return std::filesystem::path(Utils::WStringToString(wstrLocal));
+}
+
+static uint64_t CurrentFileTime() {
+    // FILETIME起点（1601-01-01）到Unix时间起点的100ns间隔数
+    const uint64_t ui64UnixEpoch = 116444736000000000ULL;
+    auto durSinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    return ui64UnixEpoch + static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(durSinceEpoch).count() / 100);
+}
+
+static bool DeleteLocalFile(const std::filesystem::path& path, bool& bExists) {
+    std::error_code ec;
+    bExists = std::filesystem::exists(path, ec);
+    return !bExists || unlink(path.c_str()) == 0;
+}
+
+static bool RemoveLocalDirectory(const std::filesystem::path& path) { return rmdir(path.c_str()) == 0; }
+
+static bool ReplaceLocalFile(const std::filesystem::path& pathTemp, const std::filesystem::path& pathTarget,
+                             std::string& strError) {
+    if (std::rename(pathTemp.c_str(), pathTarget.c_str()) != 0) {
+        strError = "替换驱动清单文件失败（错误码 " + std::to_string(errno) + "）";
+        unlink(pathTemp.c_str());
+        return false;
+    }
+    return true;
+}
+#endif
+
+/********************************************************************************
+* 函数实现：统一路径分隔符（内部辅助）
+*********************************************************************************/
+static std::wstring NormalizePath(const std::wstring& wstrPath) {
+    std::wstring wstrResult(wstrPath);
+    for (auto& ch : wstrResult) {
+        if (ch == L'/') {
+            ch = L'\\';
+        }
+    }
+    return wstrResult;
+}
+
+/********************************************************************************
+* 函数实现：不区分大小写比较前缀（内部辅助）
+*********************************************************************************/
+static bool StartsWithNoCase(const std::wstring& wstrText, const std::wstring& wstrPrefix) {
+    if (wstrText.size() < wstrPrefix.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < wstrPrefix.size(); i++) {
+        if (std::towlower(wstrText[i]) != std::towlower(wstrPrefix[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：不区分大小写的路径哈希（FNV-1a）
+*********************************************************************************/
+size_t ManifestPathHash::operator()(const std::wstring& wstrPath) const {
+    uint64_t ui64Hash = 0xCBF29CE484222325ULL;
+    for (wchar_t ch : wstrPath) {
+        ui64Hash ^= static_cast<uint64_t>(std::towlower(ch));
+        ui64Hash *= 0x100000001B3ULL;
+    }
+    return static_cast<size_t>(ui64Hash);
+}
+
+/********************************************************************************
+* 函数实现：不区分大小写的路径比较
+*********************************************************************************/
+bool ManifestPathEqual::operator()(const std::wstring& wstrLeft, const std::wstring& wstrRight) const {
+    return wstrLeft.size() == wstrRight.size() && StartsWithNoCase(wstrLeft, wstrRight);
+}
+
+/********************************************************************************
+* 函数实现：取出下一个以空格分隔的无符号整数字段（内部辅助）
+*********************************************************************************/
+static bool NextNumber(std::string_view& svRest, uint64_t& ui64Value, int nBase) {
+    size_t nSpace = svRest.find(' ');
+    if (nSpace == std::string_view::npos) {
+        return false;
+    }
+    auto stcResult = std::from_chars(svRest.data(), svRest.data() + nSpace, ui64Value, nBase);
+    if (stcResult.ec != std::errc() || stcResult.ptr != svRest.data() + nSpace) {
+        return false;
+    }
+    svRest.remove_prefix(nSpace + 1);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：加载清单
+*********************************************************************************/
+bool DriverManifest::Load(const std::string& strVolumeRoot, std::string& strError) {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    m_wstrRoot = NormalizePath(Utils::StringToWString(strVolumeRoot));
+    if (!m_wstrRoot.empty() && m_wstrRoot.back() != L'\\') {
+        m_wstrRoot += L'\\';
+    }
+    m_mapEntries.clear();
+
+    // 1. 清单不存在：首次同步或由旧版本复制的镜像
+    std::unique_ptr<std::istream> pFile;
+    if (m_pImage) {
+        std::vector<char> vecData;
+        std::string strIgnored;
+        if (!m_pImage->ReadFile(Utils::WStringToString(MANIFEST_PATH), vecData, strIgnored)) {
+            return true;
+        }
+        pFile = std::make_unique<std::istringstream>(std::string(vecData.begin(), vecData.end()));
+    } else {
+        pFile = std::make_unique<std::ifstream>(LocalPath(m_wstrRoot + MANIFEST_PATH), std::ios::binary);
+        if (!*pFile) {
+            return true;
+        }
+    }
+    std::istream& objFile = *pFile;
+
+    // 2. 校验版本标记
+    std::string strLine;
+    if (!std::getline(objFile, strLine) || Utils::TrimView(strLine) != MANIFEST_HEADER) {
+        strError = "驱动清单版本不匹配，将全量同步";
+        return false;
+    }
+
+    // 3. 逐行解析：哈希 大小 时间 路径
+    size_t nLineNumber = 1;
+    while (std::getline(objFile, strLine)) {
+        nLineNumber++;
+        std::string_view svLine = Utils::TrimView(strLine);
+        if (svLine.empty()) {
+            continue;
+        }
+        ManifestEntry stcEntry;
+        if (!NextNumber(svLine, stcEntry.ui64Hash, 16) ||
+            !NextNumber(svLine, stcEntry.ui64Size, 10) ||
+            !NextNumber(svLine, stcEntry.ui64WriteTime, 10) ||
+            svLine.empty()) {
+            m_mapEntries.clear();
+            strError = "驱动清单格式错误（第" + std::to_string(nLineNumber) + "行），将全量同步";
+            return false;
+        }
+        m_mapEntries[NormalizePath(Utils::StringToWString(std::string(svLine)))] = stcEntry;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：保存清单
+*********************************************************************************/
+bool DriverManifest::Save(std::string& strError) const {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    std::ostringstream objContent;
+    objContent << MANIFEST_HEADER << "\n";
+    char szHash[20] = { 0 };
+    for (const auto& [wstrKey, stcEntry] : m_mapEntries) {
+        snprintf(szHash, sizeof(szHash), "%016llx", static_cast<unsigned long long>(stcEntry.ui64Hash));
+        objContent << szHash << ' ' << stcEntry.ui64Size << ' ' << stcEntry.ui64WriteTime << ' '
+                   << Utils::WStringToString(wstrKey) << "\n";
+    }
+    const std::string strContent = objContent.str();
+
+    // 镜像中由写入器写时复制替换，不需要临时文件
+    if (m_pImage) {
+        NtfsFileProperties stcProperties;
+        stcProperties.ui64Size = strContent.size();
+        stcProperties.ui64CreationTime = CurrentFileTime();
+        stcProperties.ui64ModifiedTime = stcProperties.ui64CreationTime;
+        stcProperties.ui64AccessTime = stcProperties.ui64CreationTime;
+        stcProperties.ui32Attributes = FILE_ATTRIBUTE_ARCHIVE;
+        size_t nOffset = 0;
+        auto fnRead = [&](char* pBuffer, size_t nBytes, std::string&) {
+            memcpy(pBuffer, strContent.data() + nOffset, nBytes);
+            nOffset += nBytes;
+            return true;
+        };
+        std::string strDetail;
+        if (!m_pImage->WriteFile(Utils::WStringToString(MANIFEST_PATH), stcProperties, fnRead, strDetail)) {
+            strError = "写入驱动清单文件失败: " + strDetail;
+            return false;
+        }
+        return true;
+    }
+
+    std::filesystem::path pathManifest = LocalPath(m_wstrRoot + MANIFEST_PATH);
+    std::filesystem::path pathTemp = pathManifest;
+    pathTemp += ".tmp";
+    std::error_code ec;
+    std::filesystem::create_directories(pathManifest.parent_path(), ec);
+    {
+        std::ofstream objFile(pathTemp, std::ios::binary | std::ios::trunc);
+        if (!objFile) {
+            strError = "无法创建驱动清单文件";
+            return false;
+        }
+        objFile << strContent;
+        if (!objFile.flush()) {
+            strError = "写入驱动清单文件失败";
+            return false;
+        }
+    }
+
+    return ReplaceLocalFile(pathTemp, pathManifest, strError);
+}
+
+/********************************************************************************
+* 函数实现：取根路径
+*********************************************************************************/
+std::string DriverManifest::Root() const {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    return Utils::WStringToString(m_wstrRoot);
+}
+
+/********************************************************************************
+* 函数实现：生成条目键
+*********************************************************************************/
+bool DriverManifest::MakeKey(const std::wstring& wstrPath, std::wstring& wstrKey) const {
+    if (m_wstrRoot.empty()) {
+        return false;
+    }
+    std::wstring wstrNormalized = NormalizePath(wstrPath);
+    if (wstrNormalized.size() <= m_wstrRoot.size() || !StartsWithNoCase(wstrNormalized, m_wstrRoot)) {
+        return false;
+    }
+    wstrKey = wstrNormalized.substr(m_wstrRoot.size());
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：查询条目
+*********************************************************************************/
+bool DriverManifest::Lookup(const std::wstring& wstrKey, ManifestEntry& stcEntry) const {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    auto it = m_mapEntries.find(wstrKey);
+    if (it == m_mapEntries.end()) {
+        return false;
+    }
+    stcEntry = it->second;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：记录条目
+*********************************************************************************/
+void DriverManifest::Record(const std::wstring& wstrKey, const ManifestEntry& stcEntry) {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    ManifestEntry& stcTarget = m_mapEntries[wstrKey];
+    bool bWritten = stcEntry.bWritten || (stcTarget.bSeen && stcTarget.bWritten);
+    stcTarget = stcEntry;
+    stcTarget.bSeen = true;
+    stcTarget.bWritten = bWritten;
+}
+
+/********************************************************************************
+* 函数实现：删除过期文件
+*********************************************************************************/
+void DriverManifest::RemoveStale(size_t& nFiles, uint64_t& ui64Bytes) {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    nFiles = 0;
+    ui64Bytes = 0;
+
+    for (auto it = m_mapEntries.begin(); it != m_mapEntries.end();) {
+        if (it->second.bSeen) {
+            ++it;
+            continue;
+        }
+
+        // 1. 删除文件（只读文件先清除属性），文件已不存在也视为删除成功
+        std::wstring wstrPath = m_wstrRoot + it->first;
+        bool bExists = false;
+        bool bDeleted = false;
+        if (m_pImage) {
+            NtfsFileInfo stcInfo;
+            std::string strIgnored;
+            bExists = m_pImage->Stat(Utils::WStringToString(it->first), stcInfo, strIgnored);
+            bDeleted = !bExists || m_pImage->RemoveFile(Utils::WStringToString(it->first), strIgnored);
+        } else {
+            bDeleted = DeleteLocalFile(LocalPath(wstrPath), bExists);
+        }
+        if (!bDeleted) {
+            ++it;
+            continue;
+        }
+        if (bExists) {
+            nFiles++;
+            ui64Bytes += it->second.ui64Size;
+        }
+
+        // 2. 向上删除随之变空的目录（对非空目录失败即停止）
+        if (m_pImage) {
+            // 键以'\'分隔，按字符串取上级目录（std::filesystem在其他平台上不识别'\'）
+            std::string strIgnored;
+            size_t nSeparator = it->first.find_last_of(L'\\');
+            std::wstring wstrParent = it->first.substr(0, nSeparator == std::wstring::npos ? 0 : nSeparator);
+            while (!wstrParent.empty() &&
+                   m_pImage->RemoveEmptyDirectory(Utils::WStringToString(wstrParent), strIgnored)) {
+                nSeparator = wstrParent.find_last_of(L'\\');
+                wstrParent.resize(nSeparator == std::wstring::npos ? 0 : nSeparator);
+            }
+        } else {
+            std::filesystem::path pathRoot = LocalPath(m_wstrRoot);
+            std::filesystem::path pathParent = LocalPath(wstrPath).parent_path();
+            while (pathParent.native().size() > pathRoot.native().size() && RemoveLocalDirectory(pathParent)) {
+                pathParent = pathParent.parent_path();
+            }
+        }
+        it = m_mapEntries.erase(it);
+    }
+}
+
+/********************************************************************************
+* 函数实现：取本次同步涉及的条目
+*********************************************************************************/
+std::vector<std::pair<std::wstring, ManifestEntry>> DriverManifest::SeenEntries() const {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    std::vector<std::pair<std::wstring, ManifestEntry>> vecEntries;
+    for (const auto& [wstrKey, stcEntry] : m_mapEntries) {
+        if (stcEntry.bSeen) {
+            vecEntries.emplace_back(wstrKey, stcEntry);
+        }
+    }
+    return vecEntries;
+}
+
+/********************************************************************************
+* 函数实现：取条目数
+*********************************************************************************/
+size_t DriverManifest::Size() const {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    return m_mapEntries.size();
+}
@@ -0,0 +1,179 @@
+﻿/********************************************************************************
+* 文件名称：DriverManifest.h
+* 文件功能：虚拟机镜像中驱动文件的内容清单，用于增量同步
+*
+* 类说明：
+*    重新配置时，过去只要驱动包目录存在就整体跳过（主机驱动已更新也不会
+*    同步），而关键DLL每次都重新复制。DriverManifest记录上次同步写入虚拟机
+*    的每个文件（路径、大小、修改时间、xxHash64），保存在虚拟机的
+*    HostDriverStore目录中，下次同步时：
+*    - 源文件的大小和修改时间与清单一致，且目标文件仍在：不复制
+*    - 大小一致但时间不同：计算源文件哈希，与清单一致则不复制
+*    - 清单中有、本次同步没有涉及的文件：视为过期，删除
+*    设置镜像写入器后，清单文件的读写和过期文件的删除都在镜像中进行（不挂载）
+*
+* 清单文件格式（UTF-8文本，每个文件一行，字段以空格分隔）：
+*    <xxHash64（16位十六进制）> <大小> <修改时间（FILETIME）> <相对于卷根目录的路径>
+*    第一行为版本标记MANIFEST_HEADER；路径可以含空格（最后一个字段），保留大小写，
+*    比较时不区分大小写
+*
+* 线程安全：
+*    Lookup/Record/MarkSeen可以由复制引擎的多个工作线程同时调用
+*
+* 依赖项：
+*    - Utils（UTF-8/宽字符转换）
+*    - NtfsWriter（镜像中的清单）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <cstdint>
+
+class NtfsWriter;
+
+/********************************************************************************
+* 结构体名称：清单条目
+*********************************************************************************/
+struct ManifestEntry {
+    uint64_t ui64Size = 0;          // 文件大小（字节）
+    uint64_t ui64WriteTime = 0;     // 源文件的修改时间（FILETIME）
+    uint64_t ui64Hash = 0;          // 内容的xxHash64
+    bool     bSeen = false;         // 本次同步涉及了该文件（不保存）
+    bool     bWritten = false;      // 本次同步写入了该文件（不保存）
+    std::wstring wstrSource;        // 本次同步的源文件路径（不保存）
+};
+
+/********************************************************************************
+* 结构体名称：不区分大小写的路径哈希与比较（NTFS路径不区分大小写）
+*********************************************************************************/
+struct ManifestPathHash {
+    size_t operator()(const std::wstring& wstrPath) const;
+};
+
+struct ManifestPathEqual {
+    bool operator()(const std::wstring& wstrLeft, const std::wstring& wstrRight) const;
+};
+
+/********************************************************************************
+* 类名称：驱动同步清单
+* 类功能：加载、查询、更新和保存虚拟机镜像中的驱动文件清单
+*
+* 调用示例：
+*    DriverManifest objManifest;
+*    objManifest.Load("E:", strError);
+*    objEngine.SetManifest(&objManifest);
+*    ... 执行复制 ...
+*    objManifest.RemoveStale(nFiles, ui64Bytes);
+*    objManifest.Save(strError);
+*********************************************************************************/
+class DriverManifest {
+public:
+    /********************************************************************************
+    * 函数名称：加载清单
+    * 函数参数：
+    *    [IN]  const std::string& strVolumeRoot：虚拟机系统卷的根目录（挂载点目录或"E:"）
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    清单不存在时得到空清单并返回true；格式错误时返回false（清单为空，
+    *    本次同步按全量处理）
+    *********************************************************************************/
+    bool Load(const std::string& strVolumeRoot, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：设置镜像
+    * 函数功能：之后的加载、保存和删除过期文件通过写入器在镜像中进行
+    * 函数参数：
+    *    [IN]  NtfsWriter* pImage：已开始会话的写入器（nullptr表示使用已挂载的卷）
+    * 注意事项：
+    *    - 在Load之前调用；Load的参数是镜像根（与复制作业的目标路径前缀一致）
+    *********************************************************************************/
+    void SetImage(NtfsWriter* pImage) { m_pImage = pImage; }
+    NtfsWriter* Image() const { return m_pImage; }
+
+    /********************************************************************************
+    * 函数名称：取根路径
+    * 返回类型：std::string
+    *    Load时指定的卷根目录或镜像根（UTF-8，以'\'结尾）
+    *********************************************************************************/
+    std::string Root() const;
+
+    /********************************************************************************
+    * 函数名称：保存清单
+    * 函数功能：写入临时文件后替换，中途失败不会留下不完整的清单
+    * 函数参数：
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *********************************************************************************/
+    bool Save(std::string& strError) const;
+
+    /********************************************************************************
+    * 函数名称：生成条目键
+    * 函数参数：
+    *    [IN]  const std::wstring& wstrPath：目标文件的完整路径
+    *    [OUT] std::wstring& wstrKey：相对于卷根目录的路径
+    * 返回类型：bool
+    *    路径不在清单所属的卷根目录下时返回false（不纳入清单）
+    *********************************************************************************/
+    bool MakeKey(const std::wstring& wstrPath, std::wstring& wstrKey) const;
+
+    /********************************************************************************
+    * 函数名称：查询条目
+    * 函数参数：
+    *    [IN]  const std::wstring& wstrKey：条目键
+    *    [OUT] ManifestEntry& stcEntry：条目
+    * 返回类型：bool
+    *    清单中有该文件返回true
+    *********************************************************************************/
+    bool Lookup(const std::wstring& wstrKey, ManifestEntry& stcEntry) const;
+
+    /********************************************************************************
+    * 函数名称：记录条目
+    * 函数功能：新增或更新条目，并标记为本次同步涉及
+    * 注意事项：
+    *    - 同一文件在本次同步中被记录多次时，只要有一次写入，bWritten就保持为true
+    *********************************************************************************/
+    void Record(const std::wstring& wstrKey, const ManifestEntry& stcEntry);
+
+    /********************************************************************************
+    * 函数名称：删除过期文件
+    * 函数功能：删除清单中本次同步没有涉及的文件及随之变空的目录，并移出清单
+    * 函数参数：
+    *    [OUT] size_t& nFiles：删除的文件数
+    *    [OUT] uint64_t& ui64Bytes：删除的字节数
+    * 注意事项：
+    *    - 只能在本次同步完整执行后调用，否则未执行的部分会被当作过期文件
+    *    - 删除失败的文件保留在清单中，下次再试
+    *********************************************************************************/
+    void RemoveStale(size_t& nFiles, uint64_t& ui64Bytes);
+
+    /********************************************************************************
+    * 函数名称：取本次同步涉及的条目
+    * 返回类型：std::vector<std::pair<std::wstring, ManifestEntry>>
+    *    条目键（相对路径）和条目
+    *********************************************************************************/
+    std::vector<std::pair<std::wstring, ManifestEntry>> SeenEntries() const;
+
+    /********************************************************************************
+    * 函数名称：取条目数
+    *********************************************************************************/
+    size_t Size() const;
+
+    // 清单文件路径（相对于卷根目录）
+    static const wchar_t* const MANIFEST_PATH;
+    // 清单文件版本标记
+    static const char* const MANIFEST_HEADER;
+
+private:
+    std::wstring        m_wstrRoot;      // 卷根目录（如"E:\"或挂载点目录）
+    NtfsWriter*         m_pImage = nullptr;  // 镜像写入器
+    mutable std::mutex  m_mtxEntries;    // 保护m_mapEntries
+    std::unordered_map<std::wstring, ManifestEntry, ManifestPathHash, ManifestPathEqual> m_mapEntries;  // 键为相对路径
+};
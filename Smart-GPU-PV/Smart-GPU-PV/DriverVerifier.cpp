@@ -0,0 +1,375 @@
+﻿/********************************************************************************
+* 文件名称：DriverVerifier.cpp
+* 文件功能：实现驱动文件并行校验
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "DriverVerifier.h"
+#include "ContentHash.h"
+#include "DriverManifest.h"
+#include "NtfsVolume.h"
+#include "Utils.h"
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#ifndef _WIN32
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//==============================================================================
+// 平台相关的本地文件操作（内部辅助）：校验项路径以'\'分隔，
+// 其他平台上访问本地文件时转换为'/'
+//==============================================================================
+
+#ifdef _WIN32
+static std::filesystem::path LocalPath(const std::string& strPath) { return Utils::StringToWString(strPath); }
+
+static bool StatLocalFile(const std::string& strPath, uint64_t& ui64Size, uint64_t& ui64WriteTime) {
+    WIN32_FILE_ATTRIBUTE_DATA stcData = { 0 };
+    if (!GetFileAttributesExW(Utils::StringToWString(strPath).c_str(), GetFileExInfoStandard, &stcData)) {
+        return false;
+    }
+    ui64Size = (static_cast<uint64_t>(stcData.nFileSizeHigh) << 32) | stcData.nFileSizeLow;
+    ui64WriteTime = (static_cast<uint64_t>(stcData.ftLastWriteTime.dwHighDateTime) << 32) |
+                    stcData.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+static bool HashLocalFile(const std::string& strPath, char* pBuffer, uint64_t& ui64Hash, std::string& strReason) {
+    HANDLE hFile = CreateFileW(Utils::StringToWString(strPath).c_str(), GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        strReason = "无法打开文件（错误码 " + std::to_string(GetLastError()) + "）";
+        return false;
+    }
+    bool bRead = XXHash64::HashFile(hFile, pBuffer, DriverVerifier::BUFFER_SIZE, ui64Hash);
+    DWORD dwError = GetLastError();
+    CloseHandle(hFile);
+    if (!bRead) {
+        strReason = "读取失败（错误码 " + std::to_string(dwError) + "）";
+    }
+    return bRead;
+}
+
+static char* AllocateBuffer(size_t nBytes) {
+    return static_cast<char*>(VirtualAlloc(nullptr, nBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+}
+
+static void FreeBuffer(char* pBuffer) { VirtualFree(pBuffer, 0, MEM_RELEASE); }
+#else
+static std::filesystem::path LocalPath(const std::string& strPath) {
+    std::string strLocal(strPath);
+    std::replace(strLocal.begin(), strLocal.end(), '\\', '/');
+    return std::filesystem::path(strLocal);
+}
+
+static bool StatLocalFile(const std::string& strPath, uint64_t& ui64Size, uint64_t& ui64WriteTime) {
+    struct stat stcStat;
+    if (stat(LocalPath(strPath).c_str(), &stcStat) != 0 || S_ISDIR(stcStat.st_mode)) {
+        return false;
+    }
+    // FILETIME起点（1601-01-01）到Unix时间起点的100ns间隔数
+    const uint64_t ui64UnixEpoch = 116444736000000000ULL;
+    ui64Size = static_cast<uint64_t>(stcStat.st_size);
+    ui64WriteTime = ui64UnixEpoch + static_cast<uint64_t>(stcStat.st_mtim.tv_sec) * 10000000ULL +
+                    static_cast<uint64_t>(stcStat.st_mtim.tv_nsec) / 100;
+    return true;
+}
+
+static bool HashLocalFile(const std::string& strPath, char* pBuffer, uint64_t& ui64Hash, std::string& strReason) {
+    int nFd = open(LocalPath(strPath).c_str(), O_RDONLY | O_CLOEXEC);
+    if (nFd < 0) {
+        strReason = "无法打开文件（错误码 " + std::to_string(errno) + "）";
+        return false;
+    }
+    bool bRead = XXHash64::HashFile(nFd, pBuffer, DriverVerifier::BUFFER_SIZE, ui64Hash);
+    int nError = errno;
+    close(nFd);
+    if (!bRead) {
+        strReason = "读取失败（错误码 " + std::to_string(nError) + "）";
+    }
+    return bRead;
+}
+
+static char* AllocateBuffer(size_t nBytes) { return static_cast<char*>(std::aligned_alloc(4096, nBytes)); }
+
+static void FreeBuffer(char* pBuffer) { std::free(pBuffer); }
+#endif
+
+/********************************************************************************
+* 函数实现：路径是否在镜像根之下（内部辅助，ASCII不区分大小写）
+*********************************************************************************/
+static bool IsUnderRoot(const std::string& strPath, const std::string& strRoot) {
+    const size_t nRoot = strRoot.size();
+    if (nRoot == 0 || strPath.size() <= nRoot || (strPath[nRoot] != '\\' && strPath[nRoot] != '/')) {
+        return false;
+    }
+    for (size_t i = 0; i < nRoot; i++) {
+        unsigned char c1 = static_cast<unsigned char>(strPath[i]);
+        unsigned char c2 = static_cast<unsigned char>(strRoot[i]);
+        if (c1 != c2 && std::tolower(c1) != std::tolower(c2)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：构造函数
+*********************************************************************************/
+DriverVerifier::DriverVerifier(unsigned int nWorkers) : m_nWorkers(nWorkers) {
+    if (m_nWorkers == 0) {
+        m_nWorkers = std::thread::hardware_concurrency();
+        if (m_nWorkers < 2) m_nWorkers = 2;
+        if (m_nWorkers > 8) m_nWorkers = 8;
+    }
+}
+
+/********************************************************************************
+* 函数实现：设置镜像
+*********************************************************************************/
+void DriverVerifier::SetImage(NtfsVolume* pVolume, const std::string& strImageRoot) {
+    m_pVolume = pVolume;
+    m_strImageRoot = strImageRoot;
+    while (!m_strImageRoot.empty() && (m_strImageRoot.back() == '\\' || m_strImageRoot.back() == '/')) {
+        m_strImageRoot.pop_back();
+    }
+}
+
+/********************************************************************************
+* 函数实现：记录不一致的文件（内部辅助）
+*********************************************************************************/
+void DriverVerifier::AddMismatch(const VerifyItem& stcItem, const std::string& strReason) {
+    std::lock_guard<std::mutex> lock(m_mtxMismatches);
+    m_vecMismatches.push_back({ stcItem.strPath, strReason, stcItem.bFullCheck });
+}
+
+/********************************************************************************
+* 函数实现：校验单个文件（内部辅助）
+*********************************************************************************/
+void DriverVerifier::VerifyOne(const VerifyItem& stcItem, char* pBuffer) {
+    if (m_pVolume && IsUnderRoot(stcItem.strPath, m_strImageRoot)) {
+        VerifyImageFile(stcItem, stcItem.strPath.substr(m_strImageRoot.size()), pBuffer);
+        return;
+    }
+
+    // 1. 存在性和大小：大小不一致说明复制被截断，不需要读文件
+    uint64_t ui64Size = 0;
+    uint64_t ui64WriteTime = 0;
+    if (!StatLocalFile(stcItem.strPath, ui64Size, ui64WriteTime)) {
+        AddMismatch(stcItem, "文件不存在");
+        return;
+    }
+    if (ui64Size != stcItem.ui64Size) {
+        AddMismatch(stcItem, "大小不一致（期望 " + std::to_string(stcItem.ui64Size) +
+                             " 字节，实际 " + std::to_string(ui64Size) + " 字节）");
+        return;
+    }
+
+    // 2. 快速路径：修改时间一致且不要求完整校验
+    if (!stcItem.bFullCheck && ui64WriteTime == stcItem.ui64WriteTime) {
+        m_ui64FastPath++;
+        return;
+    }
+
+    // 3. 计算内容哈希
+    uint64_t ui64Hash = 0;
+    std::string strReason;
+    if (!HashLocalFile(stcItem.strPath, pBuffer, ui64Hash, strReason)) {
+        AddMismatch(stcItem, strReason);
+        return;
+    }
+    m_ui64Hashed++;
+    m_ui64BytesHashed += ui64Size;
+    if (ui64Hash != stcItem.ui64Hash) {
+        AddMismatch(stcItem, "内容与源文件不一致");
+    }
+}
+
+/********************************************************************************
+* 函数实现：校验镜像中的文件（内部辅助）
+* 说明：步骤与VerifyOne相同，文件从NtfsVolume读取（NtfsVolume打开后可以多线程读取）
+*********************************************************************************/
+void DriverVerifier::VerifyImageFile(const VerifyItem& stcItem, const std::string& strImagePath, char* pBuffer) {
+    // 1. 存在性和大小
+    NtfsFile objFile;
+    std::string strError;
+    if (!m_pVolume->OpenFile(strImagePath, objFile, strError)) {
+        AddMismatch(stcItem, "文件不存在（" + strError + "）");
+        return;
+    }
+    if (objFile.Size() != stcItem.ui64Size) {
+        AddMismatch(stcItem, "大小不一致（期望 " + std::to_string(stcItem.ui64Size) +
+                             " 字节，实际 " + std::to_string(objFile.Size()) + " 字节）");
+        return;
+    }
+
+    // 2. 快速路径
+    if (!stcItem.bFullCheck && objFile.Info().ui64ModifiedTime == stcItem.ui64WriteTime) {
+        m_ui64FastPath++;
+        return;
+    }
+
+    // 3. 计算内容哈希
+    XXHash64 objHash;
+    for (uint64_t ui64Offset = 0; ui64Offset < objFile.Size();) {
+        size_t nRead = 0;
+        if (!objFile.Read(ui64Offset, pBuffer, BUFFER_SIZE, nRead, strError) || nRead == 0) {
+            AddMismatch(stcItem, "读取失败（" + strError + "）");
+            return;
+        }
+        objHash.Update(pBuffer, nRead);
+        ui64Offset += nRead;
+    }
+    m_ui64Hashed++;
+    m_ui64BytesHashed += objFile.Size();
+    if (objHash.Digest() != stcItem.ui64Hash) {
+        AddMismatch(stcItem, "内容与源文件不一致");
+    }
+}
+
+/********************************************************************************
+* 函数实现：工作线程主循环（内部辅助）
+*********************************************************************************/
+void DriverVerifier::WorkerLoop() {
+    char* pBuffer = AllocateBuffer(BUFFER_SIZE);
+    if (!pBuffer) {
+        return;
+    }
+    // 校验项之间没有依赖，按下标依次领取即可均衡负载
+    for (size_t i = m_nNext++; i < m_vecItems.size(); i = m_nNext++) {
+        VerifyOne(m_vecItems[i], pBuffer);
+    }
+    FreeBuffer(pBuffer);
+}
+
+/********************************************************************************
+* 函数实现：执行校验
+*********************************************************************************/
+bool DriverVerifier::Run(VerifyReport& stcReport) {
+    stcReport = VerifyReport();
+    auto tpStart = std::chrono::steady_clock::now();
+
+    // 1. 重置状态并启动工作线程（线程数不超过校验项数）
+    m_nNext = 0;
+    m_ui64Hashed = 0;
+    m_ui64FastPath = 0;
+    m_ui64BytesHashed = 0;
+    m_vecMismatches.clear();
+    unsigned int nThreads = m_nWorkers;
+    if (m_vecItems.size() < nThreads) {
+        nThreads = static_cast<unsigned int>(m_vecItems.size());
+    }
+    std::vector<std::thread> vecThreads;
+    for (unsigned int i = 0; i < nThreads; i++) {
+        vecThreads.emplace_back(&DriverVerifier::WorkerLoop, this);
+    }
+    for (auto& objThread : vecThreads) {
+        objThread.join();
+    }
+
+    // 2. 缓冲区分配失败时没有线程领取过的项不能算作通过
+    if (m_nNext < m_vecItems.size()) {
+        for (size_t i = m_nNext; i < m_vecItems.size(); i++) {
+            AddMismatch(m_vecItems[i], "无法分配校验缓冲区");
+        }
+    }
+
+    // 3. 汇总结果
+    stcReport.ui64Files = m_vecItems.size();
+    stcReport.ui64Hashed = m_ui64Hashed;
+    stcReport.ui64FastPath = m_ui64FastPath;
+    stcReport.ui64BytesHashed = m_ui64BytesHashed;
+    stcReport.ui64ElapsedMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - tpStart).count());
+    stcReport.vecMismatches = std::move(m_vecMismatches);
+    m_vecMismatches.clear();
+    m_vecItems.clear();
+    return stcReport.vecMismatches.empty();
+}
+
+/********************************************************************************
+* 函数实现：检查关键驱动文件
+*********************************************************************************/
+bool DriverVerifier::CheckKeyFiles(const std::string& strVolumeRoot, const std::string& strGPUName, NtfsVolume* pVolume,
+                                   std::vector<std::string>& vecFound, std::vector<std::string>& vecMissing) {
+    vecFound.clear();
+    vecMissing.clear();
+
+    // 1. NVIDIA核心文件
+    if (strGPUName.find("NVIDIA") != std::string::npos) {
+        for (const char* pszFile : { "\\Windows\\System32\\drivers\\nvlddmkm.sys",
+                                     "\\Windows\\System32\\nvapi64.dll",
+                                     "\\Windows\\System32\\nvoglv64.dll" }) {
+            std::string strPath = strVolumeRoot + pszFile;
+            NtfsFileInfo stcInfo;
+            std::string strIgnored;
+            uint64_t ui64Size = 0, ui64WriteTime = 0;
+            bool bExists = pVolume ? pVolume->Stat(pszFile, stcInfo, strIgnored) && !stcInfo.bDirectory :
+                                     StatLocalFile(strPath, ui64Size, ui64WriteTime);
+            (bExists ? vecFound : vecMissing).push_back(strPath);
+        }
+    }
+
+    // 2. HostDriverStore中至少有一个驱动包
+    const std::string strRepository = "\\Windows\\System32\\HostDriverStore\\FileRepository";
+    size_t nPackages = 0;
+    if (pVolume) {
+        std::vector<NtfsFileInfo> vecEntries;
+        std::string strIgnored;
+        if (pVolume->ListDirectory(strRepository, vecEntries, strIgnored)) {
+            nPackages = std::count_if(vecEntries.begin(), vecEntries.end(),
+                                      [](const NtfsFileInfo& stcEntry) { return stcEntry.bDirectory; });
+        }
+    } else {
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(LocalPath(strVolumeRoot + strRepository), ec), itEnd;
+             !ec && it != itEnd; it.increment(ec)) {
+            std::error_code ecEntry;
+            if (it->is_directory(ecEntry)) {
+                nPackages++;
+            }
+        }
+    }
+    if (nPackages > 0) {
+        vecFound.push_back("HostDriverStore: " + std::to_string(nPackages) + " packages");
+    } else {
+        vecMissing.push_back("HostDriverStore: No driver packages found");
+    }
+    return vecMissing.empty();
+}
+
+/********************************************************************************
+* 函数实现：验证复制结果
+*********************************************************************************/
+bool DriverVerifier::VerifyCopy(const std::string& strVolumeRoot, const std::string& strGPUName,
+                                const DriverManifest& objManifest, NtfsVolume* pVolume, DriverCheckResult& stcResult) {
+    stcResult = DriverCheckResult();
+
+    // 1. 逐个校验清单中本次涉及的文件：本次写入的文件计算哈希，其余检查大小和修改时间
+    DriverVerifier objVerifier;
+    objVerifier.SetImage(pVolume, strVolumeRoot);
+    for (const auto& [wstrKey, stcEntry] : objManifest.SeenEntries()) {
+        objVerifier.Add({ strVolumeRoot + "\\" + Utils::WStringToString(wstrKey), stcEntry.ui64Size,
+                          stcEntry.ui64WriteTime, stcEntry.ui64Hash, stcEntry.bWritten });
+    }
+    objVerifier.Run(stcResult.stcReport);
+    for (const auto& stcMismatch : stcResult.stcReport.vecMismatches) {
+        if (stcMismatch.bWritten) stcResult.nWrittenMismatches++;
+    }
+
+    // 2. 关键文件
+    bool bKeyFiles = CheckKeyFiles(strVolumeRoot, strGPUName, pVolume, stcResult.vecFound, stcResult.vecMissing);
+    return bKeyFiles && stcResult.nWrittenMismatches == 0;
+}
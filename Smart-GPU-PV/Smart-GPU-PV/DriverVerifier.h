@@ -0,0 +1,177 @@
+﻿/********************************************************************************
+* 文件名称：DriverVerifier.h
+* 文件功能：并行校验写入虚拟机磁盘的驱动文件
+*
+* 类说明：
+*    过去的验证脚本只检查三个NVIDIA文件和至少一个驱动包目录是否存在，截断
+*    或损坏的复制要到虚拟机启动后才会发现。DriverVerifier逐个校验同步清单
+*    中的文件：
+*    - 大小不一致：直接判定失败（截断的复制），不读文件
+*    - 快速路径：本次没有写入、修改时间与清单一致的文件只检查大小和时间
+*    - 完整校验：本次写入的文件由多个线程并行计算xxHash64，与复制时从源
+*      文件算出的哈希比较
+*    - 报告每个不一致的文件及原因，以及校验的文件数、字节数和吞吐量
+*    - 离线写入镜像时通过提交后重新打开的NtfsVolume回读镜像中的文件
+*    VerifyCopy在此基础上检查关键驱动文件，决定复制步骤是否成功
+*
+* 依赖项：
+*    - XXHash64（内容哈希）
+*    - Windows API或POSIX（文件读取）
+*    - NtfsVolume（读取镜像中的文件）
+*    - DriverManifest（同步清单）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+class NtfsVolume;
+class DriverManifest;
+
+/********************************************************************************
+* 结构体名称：校验项
+*********************************************************************************/
+struct VerifyItem {
+    std::string strPath;                // 虚拟机磁盘上的文件（UTF-8完整路径）
+    uint64_t    ui64Size = 0;           // 期望大小
+    uint64_t    ui64WriteTime = 0;      // 期望修改时间（FILETIME）
+    uint64_t    ui64Hash = 0;           // 期望的xxHash64（源文件内容）
+    bool        bFullCheck = false;     // 必须计算哈希（本次写入的文件）
+};
+
+/********************************************************************************
+* 结构体名称：校验失败项
+*********************************************************************************/
+struct VerifyMismatch {
+    std::string strPath;                // 文件路径（UTF-8）
+    std::string strReason;              // 原因
+    bool        bWritten = false;       // 本次写入的文件（复制不完整，而不是虚拟机中的文件被修改）
+};
+
+/********************************************************************************
+* 结构体名称：校验报告
+*********************************************************************************/
+struct VerifyReport {
+    uint64_t                    ui64Files = 0;          // 校验的文件数
+    uint64_t                    ui64Hashed = 0;         // 计算了哈希的文件数
+    uint64_t                    ui64FastPath = 0;       // 只检查大小和时间的文件数
+    uint64_t                    ui64BytesHashed = 0;    // 计算哈希的字节数
+    uint64_t                    ui64ElapsedMs = 0;      // 总耗时（毫秒）
+    std::vector<VerifyMismatch> vecMismatches;          // 不一致的文件
+};
+
+/********************************************************************************
+* 结构体名称：复制结果验证
+*********************************************************************************/
+struct DriverCheckResult {
+    VerifyReport             stcReport;                 // 清单中文件的校验结果
+    size_t                   nWrittenMismatches = 0;    // 不一致的文件中本次写入的文件数
+    std::vector<std::string> vecFound;                  // 存在的关键文件
+    std::vector<std::string> vecMissing;                // 缺失的关键文件
+};
+
+/********************************************************************************
+* 类名称：驱动文件校验器
+* 类功能：多线程校验文件的大小、修改时间和内容哈希
+*
+* 调用示例：
+*    DriverVerifier objVerifier;
+*    objVerifier.Add({ "E:\\Windows\\System32\\nvapi64.dll", ui64Size, ui64Time, ui64Hash, true });
+*    VerifyReport stcReport;
+*    if (!objVerifier.Run(stcReport)) {
+*        for (const auto& stcMismatch : stcReport.vecMismatches) { ... }
+*    }
+*********************************************************************************/
+class DriverVerifier {
+public:
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  unsigned int nWorkers：工作线程数（0表示按CPU核数选择，2~8个）
+    *********************************************************************************/
+    explicit DriverVerifier(unsigned int nWorkers = 0);
+
+    /********************************************************************************
+    * 函数名称：添加校验项
+    *********************************************************************************/
+    void Add(VerifyItem stcItem) { m_vecItems.push_back(std::move(stcItem)); }
+
+    /********************************************************************************
+    * 函数名称：设置镜像
+    * 函数功能：路径在镜像根之下的校验项从镜像中的NTFS卷读取
+    * 函数参数：
+    *    [IN]  NtfsVolume* pVolume：已打开的卷（nullptr表示不使用）
+    *    [IN]  const std::string& strImageRoot：镜像根（UTF-8，与校验项路径的前缀一致）
+    *********************************************************************************/
+    void SetImage(NtfsVolume* pVolume, const std::string& strImageRoot);
+
+    /********************************************************************************
+    * 函数名称：执行校验
+    * 函数参数：
+    *    [OUT] VerifyReport& stcReport：校验结果
+    * 返回类型：bool
+    *    所有文件一致返回true
+    * 注意事项：
+    *    - 执行后校验项被清空
+    *********************************************************************************/
+    bool Run(VerifyReport& stcReport);
+
+    /********************************************************************************
+    * 函数名称：检查关键驱动文件
+    * 函数功能：NVIDIA GPU检查三个核心文件，所有GPU检查HostDriverStore中至少有一个驱动包
+    * 函数参数：
+    *    [IN]  const std::string& strVolumeRoot：虚拟机系统卷的根目录（离线写入时为镜像根）
+    *    [IN]  const std::string& strGPUName：GPU名称
+    *    [IN]  NtfsVolume* pVolume：镜像中的卷（nullptr表示读取已挂载的卷）
+    *    [OUT] std::vector<std::string>& vecFound：存在的关键文件
+    *    [OUT] std::vector<std::string>& vecMissing：缺失的关键文件
+    * 返回类型：bool
+    *    关键文件齐全返回true
+    *********************************************************************************/
+    static bool CheckKeyFiles(const std::string& strVolumeRoot, const std::string& strGPUName, NtfsVolume* pVolume,
+                              std::vector<std::string>& vecFound, std::vector<std::string>& vecMissing);
+
+    /********************************************************************************
+    * 函数名称：验证复制结果
+    * 函数功能：校验同步清单中本次涉及的每个文件，再检查关键驱动文件
+    * 函数参数：
+    *    [IN]  const std::string& strVolumeRoot：虚拟机系统卷的根目录（离线写入时为镜像根）
+    *    [IN]  const std::string& strGPUName：GPU名称
+    *    [IN]  const DriverManifest& objManifest：本次同步的清单
+    *    [IN]  NtfsVolume* pVolume：镜像中的卷（nullptr表示读取已挂载的卷）
+    *    [OUT] DriverCheckResult& stcResult：验证结果
+    * 返回类型：bool
+    *    本次写入的文件不一致（复制不完整）或关键文件缺失时返回false，复制步骤失败；
+    *    只有本次没有写入的文件不一致（虚拟机中被修改）时仍返回true
+    *********************************************************************************/
+    static bool VerifyCopy(const std::string& strVolumeRoot, const std::string& strGPUName,
+                           const DriverManifest& objManifest, NtfsVolume* pVolume, DriverCheckResult& stcResult);
+
+    // 每个工作线程的读缓冲区大小（字节）
+    static const DWORD BUFFER_SIZE = 1024 * 1024;
+
+private:
+    unsigned int             m_nWorkers;                 // 工作线程数
+    std::vector<VerifyItem>  m_vecItems;                 // 校验项
+    NtfsVolume*              m_pVolume = nullptr;        // 镜像中的卷
+    std::string              m_strImageRoot;             // 镜像根（不含末尾的分隔符）
+    std::atomic<size_t>      m_nNext{ 0 };               // 下一个待校验项的下标
+    std::atomic<uint64_t>    m_ui64Hashed{ 0 };
+    std::atomic<uint64_t>    m_ui64FastPath{ 0 };
+    std::atomic<uint64_t>    m_ui64BytesHashed{ 0 };
+    std::mutex               m_mtxMismatches;            // 保护m_vecMismatches
+    std::vector<VerifyMismatch> m_vecMismatches;
+
+    void WorkerLoop();
+    void VerifyOne(const VerifyItem& stcItem, char* pBuffer);
+    void VerifyImageFile(const VerifyItem& stcItem, const std::string& strImagePath, char* pBuffer);
+    void AddMismatch(const VerifyItem& stcItem, const std::string& strReason);
+};
@@ -0,0 +1,284 @@
+﻿/********************************************************************************
+* 文件名称：ExecutorTrace.cpp
+* 文件功能：实现执行器调用记录的环形缓冲区和导出
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "ExecutorTrace.h"
+#include "Utils.h"
+#include <mutex>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
+#ifndef _WIN32
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <unistd.h>
+#endif
+
+// 环形缓冲区（g_vecRing未满时按顺序追加，满后从g_nNext开始覆盖）
+static std::mutex               g_mtxTrace;
+static std::vector<TraceRecord> g_vecRing;
+static size_t                   g_nCapacity = ExecutorTrace::DEFAULT_CAPACITY;
+static size_t                   g_nNext = 0;
+
+// 当前线程的操作标签
+static thread_local std::string t_strLabel;
+
+/********************************************************************************
+* 函数名称：取当前线程/进程编号（内部辅助函数）
+* 函数功能：trace-event中的tid/pid；其他平台上线程编号取线程ID的哈希
+*********************************************************************************/
+static DWORD CurrentThreadId() {
+#ifdef _WIN32
+    return GetCurrentThreadId();
+#else
+    return static_cast<DWORD>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+#endif
+}
+
+static DWORD CurrentProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<DWORD>(getpid());
+#endif
+}
+
+/********************************************************************************
+* 函数名称：JSON字符串转义（内部辅助函数）
+*********************************************************************************/
+static void AppendJsonString(std::string& strJson, const std::string& strValue) {
+    strJson += '"';
+    for (char c : strValue) {
+        switch (c) {
+            case '"':  strJson += "\\\""; break;
+            case '\\': strJson += "\\\\"; break;
+            case '\n': strJson += "\\n"; break;
+            case '\r': strJson += "\\r"; break;
+            case '\t': strJson += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char szEscape[8];
+                    snprintf(szEscape, sizeof(szEscape), "\\u%04x", c);
+                    strJson += szEscape;
+                } else {
+                    strJson += c;
+                }
+                break;
+        }
+    }
+    strJson += '"';
+}
+
+/********************************************************************************
+* 函数名称：取百分位数（内部辅助函数）
+* 函数参数：
+*    [IN]  const std::vector<uint64_t>& vecSorted：已排序的非空数组
+*    [IN]  size_t nPercent：百分位（0~100，最近秩法）
+*********************************************************************************/
+static uint64_t Percentile(const std::vector<uint64_t>& vecSorted, size_t nPercent) {
+    size_t nRank = (vecSorted.size() * nPercent + 99) / 100;
+    return vecSorted[nRank == 0 ? 0 : nRank - 1];
+}
+
+/********************************************************************************
+* 函数实现：操作标签作用域
+*********************************************************************************/
+ExecutorTrace::Scope::Scope(const std::string& strLabel) : m_nPrevLength(t_strLabel.size()) {
+    if (!t_strLabel.empty()) {
+        t_strLabel += '/';
+    }
+    t_strLabel += strLabel;
+}
+
+ExecutorTrace::Scope::~Scope() {
+    t_strLabel.resize(m_nPrevLength);
+}
+
+/********************************************************************************
+* 函数实现：获取当前时刻
+*********************************************************************************/
+uint64_t ExecutorTrace::NowUs() {
+#ifndef _WIN32
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#else
+    static const uint64_t s_ui64Frequency = []() {
+        LARGE_INTEGER liFrequency;
+        QueryPerformanceFrequency(&liFrequency);
+        return static_cast<uint64_t>(liFrequency.QuadPart);
+    }();
+    LARGE_INTEGER liCounter;
+    QueryPerformanceCounter(&liCounter);
+    // 分两段计算，避免计数乘以1000000后溢出
+    uint64_t ui64Counter = static_cast<uint64_t>(liCounter.QuadPart);
+    return (ui64Counter / s_ui64Frequency) * 1000000 + (ui64Counter % s_ui64Frequency) * 1000000 / s_ui64Frequency;
+#endif
+}
+
+/********************************************************************************
+* 函数实现：获取当前线程的操作标签
+*********************************************************************************/
+std::string ExecutorTrace::CurrentLabel() {
+    return t_strLabel;
+}
+
+/********************************************************************************
+* 函数实现：保存调用记录
+*********************************************************************************/
+void ExecutorTrace::Record(TraceRecord stcRecord) {
+    // 1. 截断命令摘要（只保留首行）；截断点退到UTF-8字符边界（跳过10xxxxxx后续字节），
+    //    路径或虚拟机名称中的中文不会被切成半个字符
+    size_t nNewLine = stcRecord.strCommand.find('\n');
+    if (nNewLine != std::string::npos) {
+        stcRecord.strCommand.resize(nNewLine);
+    }
+    if (stcRecord.strCommand.size() > MAX_COMMAND_LENGTH) {
+        size_t nCut = MAX_COMMAND_LENGTH;
+        while (nCut > 0 && (static_cast<unsigned char>(stcRecord.strCommand[nCut]) & 0xC0) == 0x80) {
+            nCut--;
+        }
+        stcRecord.strCommand.resize(nCut);
+        stcRecord.strCommand += "...";
+    }
+    if (stcRecord.dwThreadId == 0) {
+        stcRecord.dwThreadId = CurrentThreadId();
+    }
+
+    // 2. 写入环形缓冲区
+    std::lock_guard<std::mutex> lock(g_mtxTrace);
+    if (g_nCapacity == 0) {
+        return;
+    }
+    if (g_vecRing.size() < g_nCapacity) {
+        g_vecRing.push_back(std::move(stcRecord));
+    } else {
+        g_vecRing[g_nNext] = std::move(stcRecord);
+        g_nNext = (g_nNext + 1) % g_nCapacity;
+    }
+}
+
+/********************************************************************************
+* 函数实现：设置缓冲区容量
+*********************************************************************************/
+void ExecutorTrace::SetCapacity(size_t nCapacity) {
+    std::lock_guard<std::mutex> lock(g_mtxTrace);
+    g_nCapacity = nCapacity;
+    g_vecRing.clear();
+    g_vecRing.shrink_to_fit();
+    g_nNext = 0;
+}
+
+/********************************************************************************
+* 函数实现：清空记录
+*********************************************************************************/
+void ExecutorTrace::Clear() {
+    std::lock_guard<std::mutex> lock(g_mtxTrace);
+    g_vecRing.clear();
+    g_nNext = 0;
+}
+
+/********************************************************************************
+* 函数实现：获取记录快照
+*********************************************************************************/
+std::vector<TraceRecord> ExecutorTrace::Snapshot() {
+    std::lock_guard<std::mutex> lock(g_mtxTrace);
+    std::vector<TraceRecord> vecRecords;
+    vecRecords.reserve(g_vecRing.size());
+    // 缓冲区已满时g_nNext指向最早的记录
+    for (size_t i = 0; i < g_vecRing.size(); i++) {
+        vecRecords.push_back(g_vecRing[(g_nNext + i) % g_vecRing.size()]);
+    }
+    return vecRecords;
+}
+
+/********************************************************************************
+* 函数实现：导出Chrome trace-event JSON
+*********************************************************************************/
+std::string ExecutorTrace::ToChromeTrace() {
+    std::vector<TraceRecord> vecRecords = Snapshot();
+
+    std::string strJson = "{\"traceEvents\":[";
+    for (size_t i = 0; i < vecRecords.size(); i++) {
+        const TraceRecord& stcRecord = vecRecords[i];
+        if (i > 0) strJson += ',';
+
+        // 完整事件：名称为标签（没有标签时使用命令摘要），类别为执行方式
+        strJson += "\n{\"name\":";
+        AppendJsonString(strJson, stcRecord.strLabel.empty() ? stcRecord.strCommand : stcRecord.strLabel);
+        strJson += ",\"cat\":";
+        AppendJsonString(strJson, stcRecord.strKind);
+        strJson += ",\"ph\":\"X\",\"pid\":" + std::to_string(CurrentProcessId()) +
+                   ",\"tid\":" + std::to_string(stcRecord.dwThreadId) +
+                   ",\"ts\":" + std::to_string(stcRecord.ui64StartUs) +
+                   ",\"dur\":" + std::to_string(stcRecord.ui64WallUs) +
+                   ",\"args\":{\"command\":";
+        AppendJsonString(strJson, stcRecord.strCommand);
+        strJson += ",\"spawn_us\":" + std::to_string(stcRecord.ui64SpawnUs) +
+                   ",\"first_byte_us\":" + std::to_string(stcRecord.ui64FirstByteUs) +
+                   ",\"exit_code\":" + std::to_string(stcRecord.nExitCode) +
+                   ",\"timed_out\":" + (stcRecord.bTimedOut ? "true" : "false") +
+                   ",\"stdout_bytes\":" + std::to_string(stcRecord.ui64StdoutBytes) +
+                   ",\"stderr_bytes\":" + std::to_string(stcRecord.ui64StderrBytes) + "}}";
+    }
+    strJson += "\n]}\n";
+    return strJson;
+}
+
+/********************************************************************************
+* 函数实现：写入Chrome trace-event文件
+*********************************************************************************/
+bool ExecutorTrace::WriteChromeTrace(const std::string& strPath, std::string& strError) {
+    std::ofstream objFile(std::filesystem::path(Utils::StringToWString(strPath)), std::ios::binary);
+    if (!objFile) {
+        strError = "无法创建跟踪文件: " + strPath;
+        return false;
+    }
+    std::string strJson = ToChromeTrace();
+    objFile.write(strJson.data(), static_cast<std::streamsize>(strJson.size()));
+    if (!objFile) {
+        strError = "写入跟踪文件失败: " + strPath;
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：按标签汇总
+*********************************************************************************/
+std::string ExecutorTrace::Summary() {
+    // 1. 按标签分组收集总耗时和输出字节数
+    struct LabelStats {
+        std::vector<uint64_t> vecWallUs;
+        uint64_t              ui64Bytes = 0;
+    };
+    std::map<std::string, LabelStats> mapStats;
+    for (const auto& stcRecord : Snapshot()) {
+        LabelStats& stcStats = mapStats[stcRecord.strLabel.empty() ? "(无标签)" : stcRecord.strLabel];
+        stcStats.vecWallUs.push_back(stcRecord.ui64WallUs);
+        stcStats.ui64Bytes += stcRecord.ui64StdoutBytes + stcRecord.ui64StderrBytes;
+    }
+
+    // 2. 每个标签一行：次数、p50/p95/最大耗时（毫秒）、输出字节数
+    std::string strSummary;
+    for (auto& objEntry : mapStats) {
+        std::vector<uint64_t>& vecWall = objEntry.second.vecWallUs;
+        std::sort(vecWall.begin(), vecWall.end());
+        char szLine[160];
+        snprintf(szLine, sizeof(szLine), " n=%zu p50=%.1fms p95=%.1fms max=%.1fms bytes=%llu\n",
+                 vecWall.size(),
+                 Percentile(vecWall, 50) / 1000.0,
+                 Percentile(vecWall, 95) / 1000.0,
+                 vecWall.back() / 1000.0,
+                 static_cast<unsigned long long>(objEntry.second.ui64Bytes));
+        strSummary += objEntry.first + ":" + szLine;
+    }
+    return strSummary;
+}
@@ -0,0 +1,152 @@
+﻿/********************************************************************************
+* 文件名称：ExecutorTrace.h
+* 文件功能：记录PowerShellExecutor每次调用的耗时和I/O统计
+*
+* 类说明：
+*    一次GPU-PV配置的时间花在哪里过去只能靠附加调试器猜测。ExecutorTrace
+*    为执行器的每次调用保存一条记录（启动耗时、首字节耗时、总耗时、退出码、
+*    标准输出/错误输出字节数），并打上调用者设置的操作标签。记录保存在
+*    固定容量的内存环形缓冲区中，可以导出为：
+*        - Chrome trace-event JSON（在chrome://tracing或Perfetto中打开）
+*        - 按标签汇总的文本（次数、p50/p95/最大耗时）
+*
+* 操作标签：
+*    ExecutorTrace::Scope在当前线程上压入一段标签，嵌套时以"/"连接，
+*    例如"ConfigureGPUPV/CopyDriverFiles/MountVMDisk"。异步命令使用
+*    发起调用时的标签。
+*
+* 时间字段（微秒）：
+*    - 启动耗时：创建powershell.exe进程，或从进程池借用宿主（含按需启动）
+*    - 首字节耗时：从调用开始到收到第一个标准输出字节；宿主一次返回整帧，
+*      因此首字节耗时即收到响应帧的时间；没有输出时为0
+*    - 总耗时：从调用开始到结果整理完毕
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Platform.h"
+
+/********************************************************************************
+* 结构体名称：调用记录
+*********************************************************************************/
+struct TraceRecord {
+    std::string strLabel;               // 操作标签（可为空）
+    std::string strKind;                // 执行方式：host / oneshot / stream / async / batch / cache
+    std::string strCommand;             // 命令摘要（截断）
+    uint64_t    ui64StartUs = 0;        // 开始时刻（微秒，ExecutorTrace::NowUs）
+    uint64_t    ui64SpawnUs = 0;        // 启动耗时（微秒）
+    uint64_t    ui64FirstByteUs = 0;    // 首字节耗时（微秒，0表示没有输出）
+    uint64_t    ui64WallUs = 0;         // 总耗时（微秒）
+    int         nExitCode = -1;         // 退出码
+    bool        bTimedOut = false;      // 是否超时
+    uint64_t    ui64StdoutBytes = 0;    // 标准输出字节数
+    uint64_t    ui64StderrBytes = 0;    // 错误输出字节数
+    DWORD       dwThreadId = 0;         // 发起调用的线程
+};
+
+/********************************************************************************
+* 类名称：执行器跟踪
+* 类功能：线程安全的调用记录环形缓冲区及其导出
+*
+* 调用示例：
+*    {
+*        ExecutorTrace::Scope objTrace("CopyDriverFiles");
+*        PowerShellExecutor::Execute(cmd);     // 记录标签为"CopyDriverFiles"
+*    }
+*    std::string strError;
+*    ExecutorTrace::WriteChromeTrace("C:\\Temp\\trace.json", strError);
+*    std::string strSummary = ExecutorTrace::Summary();
+*********************************************************************************/
+class ExecutorTrace {
+public:
+    // 默认保留的记录条数（超出后覆盖最早的记录）
+    static const size_t DEFAULT_CAPACITY = 4096;
+    // 命令摘要的最大长度（字节，截断时退到UTF-8字符边界）
+    static const size_t MAX_COMMAND_LENGTH = 160;
+
+    /********************************************************************************
+    * 类名称：操作标签作用域（RAII）
+    * 类功能：构造时在当前线程压入标签，析构时弹出
+    *********************************************************************************/
+    class Scope {
+    public:
+        explicit Scope(const std::string& strLabel);
+        ~Scope();
+
+    private:
+        size_t m_nPrevLength;   // 压入前的标签长度
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    /********************************************************************************
+    * 函数名称：获取当前时刻
+    * 返回类型：uint64_t
+    *    单调递增的微秒计数（QueryPerformanceCounter）
+    *********************************************************************************/
+    static uint64_t NowUs();
+
+    /********************************************************************************
+    * 函数名称：获取当前线程的操作标签
+    * 返回类型：std::string
+    *********************************************************************************/
+    static std::string CurrentLabel();
+
+    /********************************************************************************
+    * 函数名称：保存调用记录
+    * 函数参数：
+    *    [IN]  TraceRecord stcRecord：调用记录（命令过长时截断）
+    *********************************************************************************/
+    static void Record(TraceRecord stcRecord);
+
+    /********************************************************************************
+    * 函数名称：设置缓冲区容量
+    * 函数参数：
+    *    [IN]  size_t nCapacity：保留的记录条数，0表示停止记录
+    * 注意事项：
+    *    - 会清空已有记录
+    *********************************************************************************/
+    static void SetCapacity(size_t nCapacity);
+
+    /********************************************************************************
+    * 函数名称：清空记录
+    *********************************************************************************/
+    static void Clear();
+
+    /********************************************************************************
+    * 函数名称：获取记录快照
+    * 返回类型：std::vector<TraceRecord>
+    *    按时间顺序（最早在前）的全部记录
+    *********************************************************************************/
+    static std::vector<TraceRecord> Snapshot();
+
+    /********************************************************************************
+    * 函数名称：导出Chrome trace-event JSON
+    * 返回类型：std::string
+    *    {"traceEvents":[...]}，每条记录是一个完整事件（ph="X"）
+    *********************************************************************************/
+    static std::string ToChromeTrace();
+
+    /********************************************************************************
+    * 函数名称：写入Chrome trace-event文件
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径（UTF-8）
+    *    [OUT] std::string& strError：失败时的错误信息
+    * 返回类型：bool
+    *    写入成功返回true
+    *********************************************************************************/
+    static bool WriteChromeTrace(const std::string& strPath, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：按标签汇总
+    * 返回类型：std::string
+    *    每个标签一行：次数、总耗时的p50/p95/最大值（毫秒）、输出字节数
+    *********************************************************************************/
+    static std::string Summary();
+};
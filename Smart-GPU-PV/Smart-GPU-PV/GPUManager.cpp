@@ -3,6 +3,9 @@
 #include "WmiHelper.h"
 #include "HyperVException.h"
 #include "Utils.h"
+#include "QueryCache.h"
+#include "ExecutorTrace.h"
+#include "JsonReader.h"
 #include <algorithm>
 #include <dxgi.h>
 #include <vector>
@@ -13,8 +16,12 @@
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "wbemuuid.lib")
 
+// 可分区GPU查询结果的缓存有效期（主机GPU在程序运行期间基本不变）
+static const DWORD GPU_QUERY_TTL_MS = 60 * 1000;
+
 // 获取所有支持分区的GPU
 std::vector<GPUInfo> GPUManager::GetPartitionableGPUs() {
+    ExecutorTrace::Scope traceScope("GetPartitionableGPUs");
     try {
         return GetPartitionableGPUsViaWMI();
     } catch (...) {
@@ -31,8 +38,8 @@ std::vector<GPUInfo> GPUManager::GetPartitionableGPUsViaWMI() {
         WmiHelper::Session session(L"root\\virtualization\\v2");
         
         // 查询所有可分区GPU
-        auto result = WmiHelper::Query(session,
-            L"SELECT * FROM Msvm_PartitionableGpu");
+        auto result = WmiHelper::QueryCached(session,
+            L"SELECT * FROM Msvm_PartitionableGpu", QueryCache::SCOPE_HOST, GPU_QUERY_TTL_MS);
         
         // 获取DXGI GPU详细信息（显存等）
         std::vector<GPUInfo> dxgiGpus = GetGPUDetails();
@@ -93,15 +100,15 @@ std::vector<GPUInfo> GPUManager::GetPartitionableGPUsViaWMI() {
 std::vector<GPUInfo> GPUManager::GetPartitionableGPUsViaPowerShell() {
     std::vector<GPUInfo> gpus;
     
-    // 1. 获取可分区GPU的实例路径
-    std::vector<std::string> paths = GetPartitionableGPUPaths();
-    if (paths.empty()) {
-        return gpus;
-    }
+    // 1. 异步查询可分区GPU的实例路径（PowerShell启动期间同时进行DXGI枚举）
+    auto pathsFuture = PowerShellExecutor::ExecuteAsync(
+        "Get-VMHostPartitionableGpu | Select-Object -ExpandProperty Name");
     
     // 2. 获取GPU详细信息（使用DXGI获取准确显存）
     std::vector<GPUInfo> details = GetGPUDetails();
-    if (details.empty()) {
+    
+    std::vector<std::string> paths = ParseGPUPaths(pathsFuture.get().strOutput);
+    if (paths.empty() || details.empty()) {
         return gpus;
     }
     
@@ -124,17 +131,23 @@ GPUInfo GPUManager::FindGPUByName(const std::vector<GPUInfo>& gpus, const std::s
 // 检查系统是否支持GPU-PV
 bool GPUManager::IsGPUPVSupported() {
     std::string command = "Get-VMHostPartitionableGpu -ErrorAction SilentlyContinue";
-    std::string output = PowerShellExecutor::Execute(command);
-    return !output.empty();
+    CommandResult result;
+    PowerShellExecutor::ExecuteCached(command, QueryCache::SCOPE_HOST, GPU_QUERY_TTL_MS, result);
+    return !result.strOutput.empty();
 }
 
 // 获取可分区GPU的实例路径
 std::vector<std::string> GPUManager::GetPartitionableGPUPaths() {
-    std::vector<std::string> paths;
-    
     // 使用Get-VMHostPartitionableGpu获取可分区GPU
     std::string command = "Get-VMHostPartitionableGpu | Select-Object -ExpandProperty Name";
-    std::string output = PowerShellExecutor::Execute(command);
+    CommandResult result;
+    PowerShellExecutor::ExecuteCached(command, QueryCache::SCOPE_HOST, GPU_QUERY_TTL_MS, result);
+    return ParseGPUPaths(result.strOutput);
+}
+
+// 解析可分区GPU的实例路径
+std::vector<std::string> GPUManager::ParseGPUPaths(const std::string& output) {
+    std::vector<std::string> paths;
     
     if (!output.empty()) {
         // 按行分割
@@ -157,6 +170,9 @@ std::vector<GPUInfo> GPUManager::GetGPUDetails() {
     
     // 1. 先通过WMI获取所有显卡的驱动信息和PNP ID
     std::map<std::string, std::string> wmiDrivers = GetWmiGPUDrivers();
+    if (wmiDrivers.empty()) {
+        wmiDrivers = GetGPUDriversViaPowerShell();
+    }
 
     IDXGIFactory* pFactory = nullptr;
     if (FAILED(CreateDXGIFactory(__uuidof(IDXGIFactory), (void**)&pFactory))) {
@@ -398,3 +414,36 @@ std::map<std::string, std::string> GPUManager::GetWmiGPUDrivers() {
     
     return result;
 }
+
+// 通过PowerShell获取显卡驱动信息（WMI连接失败时使用）
+std::map<std::string, std::string> GPUManager::GetGPUDriversViaPowerShell() {
+    std::map<std::string, std::string> result;
+    
+    // 与GetWmiGPUDrivers相同：驱动路径取InstalledDisplayDrivers中第一个文件所在的目录
+    std::string command =
+        "Get-CimInstance Win32_VideoController | ForEach-Object { "
+        "$d = ($_.InstalledDisplayDrivers -split ',')[0]; "
+        "[PSCustomObject]@{ "
+        "Name = $_.Name; "
+        "PNPDeviceID = $_.PNPDeviceID; "
+        "DriverPath = $(if ($d) { Split-Path $d } else { '' }) "
+        "} } | ConvertTo-Json";
+    CommandResult output;
+    if (!PowerShellExecutor::ExecuteCached(command, QueryCache::SCOPE_HOST, GPU_QUERY_TTL_MS, output)) {
+        return result;
+    }
+    
+    // 单块显卡时输出为对象，多块时为数组
+    JsonDocument document;
+    std::string error;
+    std::vector<GPUInfo> adapters;
+    if (document.Parse(output.strOutput, error)) {
+        document.MapList(adapters);
+    }
+    for (const auto& adapter : adapters) {
+        if (!adapter.strPnpDeviceID.empty()) {
+            result[adapter.strPnpDeviceID] = adapter.strDriverPath;
+        }
+    }
+    return result;
+}
@@ -38,6 +38,7 @@
 *********************************************************************************/
 
 #pragma once
+#include "JsonReader.h"
 #include <string>
 #include <vector>
 #include <map>
@@ -64,6 +65,15 @@ struct GPUInfo {
     std::string strDisplayText;     // 显示文本
 };
 
+// GetGPUDriversViaPowerShell输出对象（Win32_VideoController）的JSON字段
+template <>
+struct JsonFields<GPUInfo> {
+    static constexpr auto Fields = std::make_tuple(
+        MakeJsonField("Name", &GPUInfo::strFriendlyName),
+        MakeJsonField("PNPDeviceID", &GPUInfo::strPnpDeviceID),
+        MakeJsonField("DriverPath", &GPUInfo::strDriverPath));
+};
+
 /********************************************************************************
 * 类名称：GPU管理器
 * 类功能：提供GPU设备的查询和信息获取功能
@@ -152,6 +162,14 @@ private:
     *********************************************************************************/
     static std::map<std::string, std::string> GetWmiGPUDrivers();
     
+    /********************************************************************************
+    * 函数名称：通过PowerShell获取GPU驱动信息（内部方法）
+    * 函数功能：WMI连接失败时查询Win32_VideoController的JSON输出并映射到GPUInfo
+    * 返回类型：std::map<std::string, std::string>
+    *    PNP设备ID到驱动路径的映射
+    *********************************************************************************/
+    static std::map<std::string, std::string> GetGPUDriversViaPowerShell();
+    
     //==============================================================================
     // 内部实现（PowerShell方式）
     //==============================================================================
@@ -172,6 +190,16 @@ private:
     *********************************************************************************/
     static std::vector<std::string> GetPartitionableGPUPaths();
     
+    /********************************************************************************
+    * 函数名称：解析可分区GPU路径（内部方法）
+    * 函数功能：从Get-VMHostPartitionableGpu的输出中提取GPU实例路径
+    * 函数参数：
+    *    [IN]  const std::string& strOutput：PowerShell命令输出
+    * 返回类型：std::vector<std::string>
+    *    GPU实例路径数组
+    *********************************************************************************/
+    static std::vector<std::string> ParseGPUPaths(const std::string& strOutput);
+    
     /********************************************************************************
     * 函数名称：获取GPU详细信息（内部方法）
     * 函数功能：查询GPU的名称、显存等详细信息
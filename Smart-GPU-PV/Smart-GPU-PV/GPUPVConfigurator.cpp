@@ -7,6 +7,58 @@
 #include "VhdHelper.h"
 #include "HyperVException.h"
 #include "Utils.h"
+#include "QueryCache.h"
+#include "ScriptRecord.h"
+#include "ScriptRegistry.h"
+#include "ExecutorTrace.h"
+#include "StepScheduler.h"
+#include "JsonReader.h"
+#include "CopyEngine.h"
+#include "DriverManifest.h"
+#include "DriverCache.h"
+#include "DriverVerifier.h"
+#include "VhdxFile.h"
+#include "VhdFile.h"
+#include "PartitionTable.h"
+#include "NtfsVolume.h"
+#include "NtfsWriter.h"
+#include "ReadinessWaiter.h"
+#include "MountRegistry.h"
+#include <future>
+#include <memory>
+
+// 只读查询（适配器、GPU名称）的缓存有效期：覆盖一次完整的配置流程
+static const DWORD QUERY_CACHE_TTL_MS = 30 * 1000;
+
+// 回调中列出的复制错误或校验失败的最大条数
+static const size_t MAX_REPORTED_COPY_ERRORS = 10;
+
+// 离线写入目标：直接打开的虚拟机磁盘镜像、其中的系统分区和NTFS写入器
+// （按声明顺序构造，析构时写入器先于分区和镜像销毁）
+struct ImageTarget {
+    VhdxFile                          objVhdx;
+    VhdFile                           objVhd;
+    BlockDevice*                      pDisk = nullptr;  // objVhdx或objVhd中打开的一个
+    std::unique_ptr<PartitionDevice>  pPartition;
+    NtfsWriter                        objWriter;
+    std::string                       strRoot;      // 复制目标的路径前缀（虚拟机磁盘文件路径）
+};
+static bool OpenImageTarget(const std::string& vmName, ImageTarget& image, std::string& error);
+static bool CloseImageTarget(ImageTarget& image, std::string& error);
+
+// 离线写入默认关闭（挂载方式经过Windows的NTFS驱动，更稳妥），设置环境变量
+// SMARTGPUPV_OFFLINE_INJECT=1时启用
+static bool OfflineInjectEnabled() {
+    wchar_t value[8] = { 0 };
+    DWORD length = GetEnvironmentVariableW(L"SMARTGPUPV_OFFLINE_INJECT", value, 8);
+    return length > 0 && length < 8 && wcscmp(value, L"1") == 0;
+}
+
+// 脚本记录输出函数：供下面注册的脚本函数调用
+static const ScriptDefinition EMIT_RECORD("Emit-Record", ScriptRecordDecoder::PS_EMIT_RECORD_BODY);
+
+// 就绪等待函数：挂载/卸载脚本轮询实际条件，不再使用固定的Start-Sleep
+static const ScriptDefinition WAIT_READY("Wait-SgpReady", ReadinessWaiter::PS_WAIT_READY_BODY);
 
 // 辅助宏：用于在C++20中处理UTF-8字符串字面量
 // C++20中u8""类型为char8_t[]，需要转换为char*以便std::string使用
@@ -14,40 +66,50 @@
 
 // 备份状态
 GPUPVBackup GPUPVConfigurator::BackupState(const std::string& vmName) {
+    ExecutorTrace::Scope traceScope("BackupState");
     GPUPVBackup backup;
     
-    // 获取适配器信息
-    std::string command = 
-        "Get-VMGpuPartitionAdapter -VMName '" + vmName + "' -ErrorAction SilentlyContinue | "
-        "Select-Object InstancePath, MinPartitionVRAM | ConvertTo-Json";
+    // 获取适配器信息和CacheTypes状态（一次往返）；备份必须反映当前状态，不使用缓存
+    std::vector<CommandResult> results;
+    PowerShellExecutor::Batch()
+        .Add("Get-VMGpuPartitionAdapter -VMName '" + vmName + "' -ErrorAction SilentlyContinue | "
+             "Select-Object InstancePath, MinPartitionVRAM | ConvertTo-Json")
+        .Add("(Get-VM -VMName '" + vmName + "').GuestControlledCacheTypes")
+        .Run(results);
     
-    std::string output = PowerShellExecutor::Execute(command);
+    const std::string& output = results[0].strOutput;
     if (!output.empty()) {
         backup.bHasAdapter = true;
-        backup.strInstancePath = Utils::ExtractJsonValue(output, "InstancePath");
-        std::string vramStr = Utils::ExtractJsonValue(output, "MinPartitionVRAM");
-        try {
-            backup.ui64VramBytes = std::stoull(vramStr);
-        } catch (...) {
-            backup.ui64VramBytes = 0;
+        // 单个适配器输出为对象，多个时为数组，取第一个
+        JsonDocument document;
+        std::string parseError;
+        std::vector<GPUPVBackup> adapters;
+        if (document.Parse(output, parseError)) {
+            document.MapList(adapters);
+        }
+        if (!adapters.empty()) {
+            backup.strInstancePath = adapters[0].strInstancePath;
+            backup.ui64VramBytes = adapters[0].ui64VramBytes;
         }
     }
     
-    // 获取CacheTypes状态
-    command = "(Get-VM -VMName '" + vmName + "').GuestControlledCacheTypes";
-    output = PowerShellExecutor::Execute(command);
-    backup.bGuestControlledCacheTypes = (Utils::Trim(output) == "True");
+    backup.bGuestControlledCacheTypes = (Utils::Trim(results[1].strOutput) == "True");
     
     return backup;
 }
 
 // 恢复状态
 void GPUPVConfigurator::RestoreState(const std::string& vmName, const GPUPVBackup& backup, ProgressCallback callback) {
+    ExecutorTrace::Scope traceScope("RestoreState");
     std::string error;
     
-    // 清理当前可能的半成品
-    std::string cleanCmd = "Remove-VMGpuPartitionAdapter -VMName '" + vmName + "' -ErrorAction SilentlyContinue";
-    PowerShellExecutor::Execute(cleanCmd);
+    // 清理当前可能的半成品，同时恢复CacheTypes设置（一次往返）
+    callback(UTF8("正在回滚：恢复GuestControlledCacheTypes设置...\n"));
+    std::vector<CommandResult> results;
+    PowerShellExecutor::Batch()
+        .Add("Remove-VMGpuPartitionAdapter -VMName '" + vmName + "' -ErrorAction SilentlyContinue")
+        .Add("Set-VM -VMName '" + vmName + "' -GuestControlledCacheTypes $" + (backup.bGuestControlledCacheTypes ? "true" : "false"))
+        .Run(results);
     
     if (backup.bHasAdapter && !backup.strInstancePath.empty()) {
         callback(UTF8("正在回滚：恢复GPU分区适配器...\n"));
@@ -59,10 +121,6 @@ void GPUPVConfigurator::RestoreState(const std::string& vmName, const GPUPVBacku
             callback(UTF8("回滚警告：无法恢复适配器 - ") + error + "\n");
         }
     }
-    
-    callback(UTF8("正在回滚：恢复GuestControlledCacheTypes设置...\n"));
-    std::string cacheCmd = "Set-VM -VMName '" + vmName + "' -GuestControlledCacheTypes $" + (backup.bGuestControlledCacheTypes ? "true" : "false");
-    PowerShellExecutor::Execute(cacheCmd);
 }
 
 // 配置GPU-PV（完整流程）
@@ -73,109 +131,233 @@ bool GPUPVConfigurator::ConfigureGPUPV(
     const std::string& driverPath,
     int vramMB,
     ProgressCallback callback) {
+    ExecutorTrace::Scope traceScope("ConfigureGPUPV");
+    
+    // 配置流程按依赖关系组成步骤图，独立的步骤并发执行：
+    //   StopVM ─┬─ Prepare ─┬─ AddGPUPartitionAdapter ─┬─ ConfigureGPUResources
+    //   Backup ─┘           │                          └─ ResolveGPUName ─┐
+    //                       ├─ EnableGuestControlledCacheTypes             │
+    //                       └─ ConfigureMMIOSpace                          │
+    //   StopVM ─── MountVMDisk ──────────────────────────── CopyDriverFiles ─ DismountVMDisk
+    // 修改虚拟机设置的步骤持有"vm:"锁（Hyper-V不支持同时修改同一虚拟机），
+    // 磁盘操作持有"vhd:"锁。步骤在工作线程上执行，进度消息通过Post交回本线程。
+    // 设置SMARTGPUPV_OFFLINE_INJECT=1时VHDX/VHD磁盘不挂载：MountVMDisk直接打开镜像中的
+    // 系统分区，驱动文件由NtfsWriter写入，DismountVMDisk只关闭镜像；镜像不能离线写入，
+    // 或复制中途遇到写入器不支持的目录和文件时退回挂载
+    StepScheduler scheduler;
+    ProgressCallback stepCallback = [&scheduler, callback](const std::string& message) {
+        scheduler.Post([callback, message]() { callback(message); });
+    };
+    const std::string vmLock = "vm:" + vmName;
+    const std::string vhdLock = "vhd:" + vmName;
     
-    std::string error;
+    GPUPVBackup backup;
+    std::string volumeRoot;
+    std::string targetGpuName;
+    bool diskMounted = false;
+    ImageTarget image;
+    bool imageOpen = false;
     
     // 步骤1：停止虚拟机
-    callback(UTF8("正在停止虚拟机...\n"));
-    if (!VMManager::StopVM(vmName, error)) {
-        callback(UTF8("错误: ") + error + "\n");
-        return false;
-    }
-    callback(UTF8("虚拟机已停止\n"));
-
-    // 步骤1.2：关闭安全启动 (GPU-PV 必要条件)
-    callback(UTF8("正在关闭安全启动...\n"));
-    std::string secureBootCmd = "Set-VMFirmware -VMName '" + vmName + "' -EnableSecureBoot Off";
-    PowerShellExecutor::Execute(secureBootCmd);
-
-    // 步骤1.5：备份当前状态
-    callback(UTF8("正在备份当前配置...\n"));
-    GPUPVBackup backup = BackupState(vmName);
-
-    // 步骤2：清理旧的GPU分区适配器（无论开启还是关闭，都先清理旧配置）
-    callback(UTF8("正在清理旧的GPU分区适配器...\n"));
-    // 使用 ExecuteWithCheck 并忽略可能的错误（如果不存在适配器）
-    // 但是如果是关闭操作，我们需要确保清理成功，除非它本来就不存在
-    std::string cleanCmd = "Remove-VMGpuPartitionAdapter -VMName '" + vmName + "' -ErrorAction SilentlyContinue";
-    PowerShellExecutor::Execute(cleanCmd); // 暂时保持 Execute，因为SilentlyContinue会抑制错误
-
-    // 判断是开启还是关闭
-    if (vramMB < 64) {
-        callback(UTF8("检测到显存设置小于 64MB，执行关闭 GPU-PV 操作...\n"));
-        
-        // 禁用 GuestControlledCacheTypes
-        callback(UTF8("正在重置 GuestControlledCacheTypes...\n"));
-        std::string resetCacheCmd = "Set-VM -VMName '" + vmName + "' -GuestControlledCacheTypes $false";
-        if (!PowerShellExecutor::ExecuteWithCheck(resetCacheCmd, resetCacheCmd, error)) { // 这里借用output参数接收
-             // 关闭操作如果失败，尝试回滚
-             callback(UTF8("错误：重置CacheTypes失败，正在尝试回滚...\n"));
-             RestoreState(vmName, backup, callback);
-             return false;
+    scheduler.AddStep("StopVM", {}, { vmLock }, [&](std::string& error) {
+        stepCallback(UTF8("正在停止虚拟机...\n"));
+        if (!VMManager::StopVM(vmName, error)) {
+            return false;
         }
-        
-        callback(UTF8("GPU-PV 已成功关闭！\n"));
+        stepCallback(UTF8("虚拟机已停止\n"));
         return true;
-    }
+    });
     
-    // 步骤3：添加GPU分区适配器
-    callback(UTF8("正在添加GPU分区适配器...\n"));
-    if (!AddGPUPartitionAdapter(vmName, gpuInstancePath, error)) {
-        callback(UTF8("错误: ") + error + "\n");
-        callback(UTF8("正在回滚配置...\n"));
+    // 步骤1.5：备份当前配置（只读查询，与停止虚拟机同时进行）
+    scheduler.AddStep("BackupState", {}, {}, [&](std::string&) {
+        stepCallback(UTF8("正在备份当前配置...\n"));
+        backup = BackupState(vmName);
+        return true;
+    });
+    
+    // 步骤2：关闭安全启动 (GPU-PV 必要条件)，并清理旧的GPU分区适配器
+    // （无论开启还是关闭，都先清理旧配置）。两条命令合并为一次往返，结果均忽略：
+    // SilentlyContinue会抑制"适配器不存在"的错误。
+    // 从这一步开始修改了虚拟机配置，之后任一步骤失败都恢复备份
+    scheduler.AddStep("Prepare", { "StopVM", "BackupState" }, { vmLock }, [&](std::string&) {
+        stepCallback(UTF8("正在关闭安全启动...\n"));
+        stepCallback(UTF8("正在清理旧的GPU分区适配器...\n"));
+        std::vector<CommandResult> prepareResults;
+        PowerShellExecutor::Batch()
+            .Add("Set-VMFirmware -VMName '" + vmName + "' -EnableSecureBoot Off")
+            .Add("Remove-VMGpuPartitionAdapter -VMName '" + vmName + "' -ErrorAction SilentlyContinue")
+            .Run(prepareResults);
+        return true;
+    }, [&]() {
         RestoreState(vmName, backup, callback);
-        return false;
-    }
-    callback(UTF8("GPU分区适配器添加成功\n"));
+    });
     
-    // 步骤4：配置GPU资源分配
-    callback(UTF8("正在配置GPU资源分配...\n"));
-    uint64_t vramBytes = static_cast<uint64_t>(vramMB) * 1024 * 1024;
-    if (!ConfigureGPUResources(vmName, vramBytes, error)) {
-        callback(UTF8("错误: ") + error + "\n");
-        callback(UTF8("正在回滚配置...\n"));
-        RestoreState(vmName, backup, callback);
-        return false;
+    if (vramMB < 64) {
+        // 关闭GPU-PV：只需重置 GuestControlledCacheTypes
+        scheduler.AddStep("ResetCacheTypes", { "Prepare" }, { vmLock }, [&](std::string& error) {
+            stepCallback(UTF8("检测到显存设置小于 64MB，执行关闭 GPU-PV 操作...\n"));
+            stepCallback(UTF8("正在重置 GuestControlledCacheTypes...\n"));
+            std::string output;
+            return PowerShellExecutor::ExecuteWithCheck(
+                "Set-VM -VMName '" + vmName + "' -GuestControlledCacheTypes $false", output, error);
+        });
+    } else {
+        // 步骤3：添加GPU分区适配器
+        scheduler.AddStep("AddGPUPartitionAdapter", { "Prepare" }, { vmLock }, [&](std::string& error) {
+            stepCallback(UTF8("正在添加GPU分区适配器...\n"));
+            if (!AddGPUPartitionAdapter(vmName, gpuInstancePath, error)) {
+                return false;
+            }
+            stepCallback(UTF8("GPU分区适配器添加成功\n"));
+            return true;
+        });
+        
+        // 步骤4：配置GPU资源分配
+        scheduler.AddStep("ConfigureGPUResources", { "AddGPUPartitionAdapter" }, { vmLock }, [&](std::string& error) {
+            stepCallback(UTF8("正在配置GPU资源分配...\n"));
+            uint64_t vramBytes = static_cast<uint64_t>(vramMB) * 1024 * 1024;
+            if (!ConfigureGPUResources(vmName, vramBytes, error)) {
+                return false;
+            }
+            stepCallback(UTF8("GPU资源配置完成\n"));
+            return true;
+        });
+        
+        // 步骤5：启用GuestControlledCacheTypes
+        scheduler.AddStep("EnableGuestControlledCacheTypes", { "Prepare" }, { vmLock }, [&](std::string& error) {
+            stepCallback(UTF8("正在启用GuestControlledCacheTypes...\n"));
+            if (!EnableGuestControlledCacheTypes(vmName, error)) {
+                return false;
+            }
+            stepCallback(UTF8("GuestControlledCacheTypes已启用\n"));
+            return true;
+        });
+        
+        // 步骤5.5：配置MMIO空间（GPU-PV关键配置）
+        scheduler.AddStep("ConfigureMMIOSpace", { "Prepare" }, { vmLock }, [&](std::string& error) {
+            stepCallback(UTF8("正在配置内存映射I/O空间...\n"));
+            if (!ConfigureMMIOSpace(vmName, error)) {
+                return false;
+            }
+            stepCallback(UTF8("MMIO空间配置完成\n"));
+            return true;
+        });
+        
+        // 步骤6：复制驱动文件。挂载只要求虚拟机已停止，与修改虚拟机设置同时进行；
+        // 失败时回滚会先卸载磁盘（逆序），再恢复虚拟机配置
+        scheduler.AddStep("MountVMDisk", { "StopVM" }, { vhdLock }, [&](std::string& error) {
+            if (OfflineInjectEnabled()) {
+                std::string imageError;
+                if (OpenImageTarget(vmName, image, imageError)) {
+                    imageOpen = true;
+                    volumeRoot = image.strRoot;
+                    stepCallback(UTF8("不挂载，直接写入虚拟机磁盘镜像: ") + volumeRoot + "\n");
+                    if (image.objVhdx.ParentCount() > 0) {
+                        stepCallback(UTF8("差异磁盘链共 ") + std::to_string(image.objVhdx.ParentCount() + 1) +
+                                     UTF8(" 层，只写入当前检查点的磁盘\n"));
+                    }
+                    return true;
+                }
+                stepCallback(UTF8("无法直接写入虚拟机磁盘镜像（") + imageError + UTF8("），改为挂载\n"));
+            }
+            
+            stepCallback(UTF8("正在挂载虚拟机磁盘...\n"));
+            volumeRoot = MountVMDisk(vmName, error);
+            if (volumeRoot.empty()) {
+                return false;
+            }
+            diskMounted = true;
+            stepCallback(UTF8("虚拟机磁盘已挂载到: ") + volumeRoot + "\n");
+            return true;
+        }, [&]() {
+            // 镜像中已写入的文件保留（与挂载方式一致），提交后关闭以清除"需要检查"标记
+            if (imageOpen) {
+                std::string closeError;
+                if (!CloseImageTarget(image, closeError)) {
+                    callback(UTF8("回滚警告：") + closeError + "\n");
+                }
+                imageOpen = false;
+            }
+            if (diskMounted) {
+                std::string dismountError;
+                DismountVMDisk(vmName, dismountError);
+                diskMounted = false;
+            }
+        });
+        
+        // GPU名称查询依赖新添加的适配器
+        scheduler.AddStep("ResolveGPUName", { "AddGPUPartitionAdapter" }, {}, [&](std::string& error) {
+            return ResolveTargetGPUName(vmName, stepCallback, targetGpuName, error);
+        });
+        
+        scheduler.AddStep("CopyDriverFiles", { "MountVMDisk", "ResolveGPUName" }, { vhdLock }, [&](std::string& error) {
+            stepCallback(UTF8("正在复制GPU驱动文件...\n"));
+            bool copied = CopyDriversToVolume(vmName, targetGpuName, volumeRoot,
+                                              imageOpen ? &image.objWriter : nullptr, stepCallback, error);
+            if (!imageOpen || !image.objWriter.HasUnsupported()) {
+                return copied;
+            }
+            
+            // 写入器拒绝了有属性列表的目录或重解析点：已写入的文件提交后关闭镜像，
+            // 挂载后按清单再同步一次，补上被拒绝的部分
+            stepCallback(UTF8("虚拟机磁盘中有不能离线修改的目录或文件，改为挂载后复制\n"));
+            std::string closeError;
+            bool closed = CloseImageTarget(image, closeError);
+            imageOpen = false;
+            if (!closed) {
+                error = closeError;
+                return false;
+            }
+            error.clear();
+            volumeRoot = MountVMDisk(vmName, error);
+            if (volumeRoot.empty()) {
+                return false;
+            }
+            diskMounted = true;
+            stepCallback(UTF8("虚拟机磁盘已挂载到: ") + volumeRoot + "\n");
+            return CopyDriversToVolume(vmName, targetGpuName, volumeRoot, nullptr, stepCallback, error);
+        });
+        
+        scheduler.AddStep("DismountVMDisk", { "CopyDriverFiles" }, { vhdLock }, [&](std::string& error) {
+            if (imageOpen) {
+                // 写入已在复制步骤中提交，只需关闭镜像
+                if (!CloseImageTarget(image, error)) {
+                    return false;
+                }
+                imageOpen = false;
+                stepCallback(UTF8("驱动文件复制完成\n"));
+                return true;
+            }
+            stepCallback(UTF8("正在卸载虚拟机磁盘...\n"));
+            if (!DismountVMDisk(vmName, error)) {
+                return false;
+            }
+            diskMounted = false;
+            stepCallback(UTF8("驱动文件复制完成\n"));
+            return true;
+        });
     }
-    callback(UTF8("GPU资源配置完成\n"));
     
-    // 步骤5：启用GuestControlledCacheTypes
-    callback(UTF8("正在启用GuestControlledCacheTypes...\n"));
-    if (!EnableGuestControlledCacheTypes(vmName, error)) {
-        callback(UTF8("错误: ") + error + "\n");
-        callback(UTF8("正在回滚配置...\n"));
-        RestoreState(vmName, backup, callback);
-        return false;
+    // 执行步骤图，失败时按完成顺序的逆序回滚
+    std::string failedStep;
+    std::string error;
+    bool success = scheduler.Run(failedStep, error);
+    if (!success) {
+        callback(UTF8("错误: ") + failedStep + " - " + error + "\n");
+        if (failedStep != "StopVM") {
+            callback(UTF8("正在回滚配置...\n"));
+        }
+        scheduler.Rollback();
     }
-    callback(UTF8("GuestControlledCacheTypes已启用\n"));
-    
-    // 步骤5.5：配置MMIO空间（GPU-PV关键配置）
-    callback(UTF8("正在配置内存映射I/O空间...\n"));
-    if (!ConfigureMMIOSpace(vmName, error)) {
-        callback(UTF8("错误: ") + error + "\n");
-        callback(UTF8("正在回滚配置...\n"));
-        RestoreState(vmName, backup, callback);
+    callback(UTF8("关键路径: ") + scheduler.CriticalPathReport() + "\n");
+    if (!success) {
         return false;
     }
-    callback(UTF8("MMIO空间配置完成\n"));
-    
-    // 步骤6：复制驱动文件
-    callback(UTF8("正在复制GPU驱动文件...\n"));
-    if (!CopyDriverFiles(vmName, driverPath, callback, error)) {
-        callback(UTF8("错误: ") + error + "\n");
-        // 注意：驱动文件复制失败通常不影响VM启动，但可能影响GPU使用
-        // 这里可以选择不回滚，或者提示用户手动处理
-        // 用户要求“保证虚拟机的正常运行”，如果驱动复制失败，VM还是能开机的，只是没驱动
-        // 回滚意义不大，因为适配器已经加上了。如果不回滚，用户可以手动装驱动？
-        // 但如果要求严苛，可以回滚。
-        // 这里选择回滚，以确保“配置未成功”
-        callback(UTF8("正在回滚配置...\n"));
-        RestoreState(vmName, backup, callback);
-        
-        // 尝试清理已复制的驱动文件（可选，比较复杂，暂略）
-        return false;
+    
+    if (vramMB < 64) {
+        callback(UTF8("GPU-PV 已成功关闭！\n"));
+        return true;
     }
-    callback(UTF8("驱动文件复制完成\n"));
     
     // 7. 可选：如果虚拟机正在运行，尝试通过Enter-PSSession验证设备状态
     callback(UTF8("正在检查虚拟机状态...\n"));
@@ -200,6 +382,7 @@ bool GPUPVConfigurator::AddGPUPartitionAdapter(
     const std::string& vmName,
     const std::string& gpuInstancePath,
     std::string& error) {
+    ExecutorTrace::Scope traceScope("AddGPUPartitionAdapter");
     
     std::string command = "Add-VMGpuPartitionAdapter -VMName '" + vmName + 
                          "' -InstancePath '" + gpuInstancePath + "'";
@@ -220,33 +403,44 @@ bool GPUPVConfigurator::ConfigureGPUResources(
     const std::string& vmName,
     uint64_t vramBytes,
     std::string& error) {
+    ExecutorTrace::Scope traceScope("ConfigureGPUResources");
     
-    // 配置四个资源类型：VRAM、Encode、Decode、Compute
+    // 配置四个资源类型：VRAM、Encode、Decode、Compute（一次往返，失败即停止）
     std::string resourceTypes[] = {"VRAM", "Encode", "Decode", "Compute"};
     
+    PowerShellExecutor::Batch batch;
+    batch.StopOnError();
     for (const auto& resType : resourceTypes) {
-        std::string command = 
+        batch.Add(
             "Set-VMGpuPartitionAdapter -VMName '" + vmName + 
             "' -MinPartition" + resType + " 1" +
             " -MaxPartition" + resType + " " + std::to_string(vramBytes) +
-            " -OptimalPartition" + resType + " " + std::to_string(vramBytes);
-        
-        std::string output;
-        if (!PowerShellExecutor::ExecuteWithCheck(command, output, error)) {
+            " -OptimalPartition" + resType + " " + std::to_string(vramBytes));
+    }
+    
+    std::vector<CommandResult> results;
+    if (batch.Run(results)) {
+        return true;
+    }
+    
+    // 报告第一条失败的资源类型
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i].nExitCode != 0) {
+            error = results[i].strError;
             if (error.empty()) {
-                error = UTF8("配置GPU资源失败: ") + resType; 
+                error = UTF8("配置GPU资源失败: ") + resourceTypes[i]; 
             }
-            return false;
+            break;
         }
     }
-    
-    return true;
+    return false;
 }
 
 // 启用GuestControlledCacheTypes
 bool GPUPVConfigurator::EnableGuestControlledCacheTypes(
     const std::string& vmName,
     std::string& error) {
+    ExecutorTrace::Scope traceScope("EnableGuestControlledCacheTypes");
     
     std::string command = "Set-VM -VMName '" + vmName + "' -GuestControlledCacheTypes $true";
     std::string output;
@@ -265,62 +459,52 @@ bool GPUPVConfigurator::EnableGuestControlledCacheTypes(
 bool GPUPVConfigurator::ConfigureMMIOSpace(
     const std::string& vmName,
     std::string& error) {
+    ExecutorTrace::Scope traceScope("ConfigureMMIOSpace");
+    
+    // 设置LowMemoryMappedIoSpace (1GB) 和 HighMemoryMappedIoSpace (32GB)
+    std::vector<CommandResult> results;
+    bool ok = PowerShellExecutor::Batch()
+        .Add("Set-VM -VMName '" + vmName + "' -LowMemoryMappedIoSpace 1GB")
+        .Add("Set-VM -VMName '" + vmName + "' -HighMemoryMappedIoSpace 32GB")
+        .StopOnError()
+        .Run(results);
+    if (ok) {
+        return true;
+    }
     
-    // 设置LowMemoryMappedIoSpace (1GB)
-    std::string cmd1 = "Set-VM -VMName '" + vmName + "' -LowMemoryMappedIoSpace 1GB";
-    std::string output;
-    if (!PowerShellExecutor::ExecuteWithCheck(cmd1, output, error)) {
+    if (results[0].nExitCode != 0) {
+        error = results[0].strError;
         if (error.empty()) {
             error = UTF8("设置LowMemoryMappedIoSpace失败");
         }
-        return false;
-    }
-    
-    // 设置HighMemoryMappedIoSpace (32GB)
-    std::string cmd2 = "Set-VM -VMName '" + vmName + "' -HighMemoryMappedIoSpace 32GB";
-    if (!PowerShellExecutor::ExecuteWithCheck(cmd2, output, error)) {
+    } else {
+        error = results[1].strError;
         if (error.empty()) {
             error = UTF8("设置HighMemoryMappedIoSpace失败");
         }
-        return false;
     }
-    
-    return true;
+    return false;
 }
 
-// 复制驱动文件
-bool GPUPVConfigurator::CopyDriverFiles(
+// 确定目标GPU名称（三种查询同时执行，按优先级取结果）
+bool GPUPVConfigurator::ResolveTargetGPUName(
     const std::string& vmName,
-    const std::string& driverPath, // 此参数现在作为参考，主要依赖WMI重新查询
     ProgressCallback callback,
+    std::string& gpuName,
     std::string& error) {
-    
-    // 1. 挂载虚拟机磁盘
-    callback(UTF8("正在挂载虚拟机磁盘...\n"));
-    std::string driveLetter = MountVMDisk(vmName, error);
-    if (driveLetter.empty()) {
-        return false;
-    }
-    callback(UTF8("虚拟机磁盘已挂载到: ") + driveLetter + "\n");
-    
-    // 2. 准备GPU名称（改进版：支持多种获取方式，增强容错性）
-    // 优先从VM配置中获取，如果失败则从主机GPU列表获取
-    std::string gpuName;
+    ExecutorTrace::Scope traceScope("ResolveTargetGPUName");
     
     // 方法1：从VM的GPU分区适配器获取（最准确）
-    std::string cmd = "$adapters = Get-VMGpuPartitionAdapter -VMName '" + vmName + "' -ErrorAction SilentlyContinue; "
+    std::string cmdAdapter = "$adapters = Get-VMGpuPartitionAdapter -VMName '" + vmName + "' -ErrorAction SilentlyContinue; "
                      "if ($adapters) { "
                      "    $instancePath = $adapters[0].InstancePath; "
                      "    $hwId = $instancePath.Substring(8, 16); "
                      "    $pnpDevice = Get-PnpDevice | Where-Object { $_.InstanceId -like ('*' + $hwId + '*') -and $_.Status -eq 'OK' } | Select-Object -First 1; "
                      "    if ($pnpDevice) { $pnpDevice.Name } "
                      "}";
-    gpuName = Utils::Trim(PowerShellExecutor::Execute(cmd));
     
-    // 方法2：如果方法1失败，从主机上匹配的GPU获取
-    if (gpuName.empty()) {
-        callback(UTF8("警告：无法从VM配置获取GPU名称，尝试从主机GPU列表获取...\n"));
-        cmd = "$vmAdapter = Get-VMGpuPartitionAdapter -VMName '" + vmName + "' -ErrorAction SilentlyContinue; "
+    // 方法2：从主机上匹配的可分区GPU获取
+    std::string cmdHostGpu = "$vmAdapter = Get-VMGpuPartitionAdapter -VMName '" + vmName + "' -ErrorAction SilentlyContinue; "
               "if ($vmAdapter) { "
               "    $instancePath = $vmAdapter[0].InstancePath; "
               "    $partitionableGpus = Get-WmiObject -Class Msvm_PartitionableGpu -Namespace ROOT\\virtualization\\v2; "
@@ -331,15 +515,37 @@ bool GPUPVConfigurator::CopyDriverFiles(
               "        if ($pnpDevice) { $pnpDevice.Name } "
               "    } "
               "}";
-        gpuName = Utils::Trim(PowerShellExecutor::Execute(cmd));
-    }
     
-    // 方法3：如果前两种方法都失败，尝试从所有NVIDIA GPU中查找（最后的回退）
+    // 方法3：从所有NVIDIA GPU中查找（最后的回退）
+    std::string cmdAnyNvidia = "$nvidiaGpus = Get-PnpDevice | Where-Object { $_.Name -like '*NVIDIA*' -and $_.Status -eq 'OK' } | Select-Object -First 1; "
+              "if ($nvidiaGpus) { $nvidiaGpus.Name }";
+    
+    // 三条查询都是只读的，同时执行：方法1失败时不必再依次等待后两种方法。
+    // 结果均可缓存，重复配置同一虚拟机时直接使用缓存
+    auto runQuery = [](std::string cmd, std::string scope) {
+        CommandResult queryResult;
+        PowerShellExecutor::ExecuteCached(cmd, scope, QUERY_CACHE_TTL_MS, queryResult);
+        return Utils::Trim(queryResult.strOutput);
+    };
+    std::string label = ExecutorTrace::CurrentLabel();
+    auto runLabeled = [&runQuery, label](std::string cmd, std::string scope) {
+        ExecutorTrace::Scope queryScope(label);
+        return runQuery(std::move(cmd), std::move(scope));
+    };
+    auto futHostGpu = std::async(std::launch::async, runLabeled, cmdHostGpu, vmName);
+    auto futAnyNvidia = std::async(std::launch::async, runLabeled, cmdAnyNvidia, std::string(QueryCache::SCOPE_HOST));
+    std::string nameAdapter = runQuery(cmdAdapter, vmName);
+    std::string nameHostGpu = futHostGpu.get();
+    std::string nameAnyNvidia = futAnyNvidia.get();
+    
+    gpuName = nameAdapter;
+    if (gpuName.empty()) {
+        callback(UTF8("警告：无法从VM配置获取GPU名称，尝试从主机GPU列表获取...\n"));
+        gpuName = nameHostGpu;
+    }
     if (gpuName.empty()) {
         callback(UTF8("警告：无法精确匹配GPU，尝试查找所有NVIDIA GPU...\n"));
-        cmd = "$nvidiaGpus = Get-PnpDevice | Where-Object { $_.Name -like '*NVIDIA*' -and $_.Status -eq 'OK' } | Select-Object -First 1; "
-              "if ($nvidiaGpus) { $nvidiaGpus.Name }";
-        gpuName = Utils::Trim(PowerShellExecutor::Execute(cmd));
+        gpuName = nameAnyNvidia;
     }
     
     if (gpuName.empty()) {
@@ -348,379 +554,504 @@ bool GPUPVConfigurator::CopyDriverFiles(
                      "1. 虚拟机已配置GPU分区适配器\n"
                      "2. 主机上GPU驱动已正确安装\n"
                      "3. GPU设备在设备管理器中显示正常");
-        DismountVMDisk(vmName, error);
+        return false;
+    }
+    return true;
+}
+
+// 验证复制结果并报告：逐个校验同步清单中的文件，再检查关键驱动文件；
+// 本次写入的文件不一致（复制不完整）或关键文件缺失时返回false
+static bool VerifyDriverFiles(const std::string& volumeRoot, const std::string& gpuName, const DriverManifest& manifest,
+                              NtfsVolume* volume, ProgressCallback callback, std::string& error) {
+    DriverCheckResult result;
+    bool passed = DriverVerifier::VerifyCopy(volumeRoot, gpuName, manifest, volume, result);
+    const VerifyReport& report = result.stcReport;
+    double seconds = report.ui64ElapsedMs / 1000.0;
+    char rate[32] = { 0 };
+    sprintf_s(rate, "%.1f MB/s", seconds > 0 ? report.ui64BytesHashed / (1024.0 * 1024) / seconds : 0.0);
+    callback(UTF8("校验完成: ") + std::to_string(report.ui64Files) + UTF8(" 个文件（哈希 ") +
+             std::to_string(report.ui64Hashed) + UTF8(" 个, 快速检查 ") + std::to_string(report.ui64FastPath) +
+             UTF8(" 个）, ") + std::to_string(report.ui64BytesHashed / (1024 * 1024)) + " MB, " + rate + "\n");
+    
+    // 1. 与清单不一致的文件
+    if (!report.vecMismatches.empty()) {
+        for (size_t i = 0; i < report.vecMismatches.size() && i < MAX_REPORTED_COPY_ERRORS; i++) {
+            callback(UTF8("✗ ") + report.vecMismatches[i].strPath + ": " + report.vecMismatches[i].strReason + "\n");
+        }
+        if (report.vecMismatches.size() > MAX_REPORTED_COPY_ERRORS) {
+            callback(UTF8("... 另有 ") + std::to_string(report.vecMismatches.size() - MAX_REPORTED_COPY_ERRORS) +
+                     UTF8(" 个文件不一致\n"));
+        }
+        error = std::to_string(report.vecMismatches.size()) + UTF8(" 个驱动文件与源文件不一致（其中本次写入 ") +
+                std::to_string(result.nWrittenMismatches) + UTF8(" 个，复制不完整）");
+        callback(UTF8("错误：") + error + "\n");
+    }
+    
+    // 2. 关键文件
+    for (const auto& f : result.vecFound) callback(UTF8("✓ ") + f + "\n");
+    for (const auto& f : result.vecMissing) callback(UTF8("✗ ") + f + "\n");
+    if (result.vecMissing.empty()) {
+        callback(UTF8("验证通过：所有关键驱动文件已存在\n"));
+    } else {
+        callback(UTF8("错误：验证失败，关键驱动文件缺失\n"));
+        if (!error.empty()) error += "\n";
+        error += UTF8("关键驱动文件缺失，请检查HostDriverStore目录");
+    }
+    return passed;
+}
+
+// 执行复制引擎：按清单增量同步，进度转发到回调，失败时列出前几条错误
+static bool RunCopyEngine(CopyEngine& engine, DriverManifest& manifest, ProgressCallback callback, std::string& error) {
+    CopyReport report;
+    engine.SetManifest(&manifest);
+    engine.SetImageTarget(manifest.Image(), manifest.Root());
+    bool success = engine.Run([&](const std::string& message) { callback(message + "\n"); }, report);
+    if (success) {
+        return true;
+    }
+
+    for (size_t i = 0; i < report.vecErrors.size() && i < MAX_REPORTED_COPY_ERRORS; i++) {
+        callback("[ERROR] " + report.vecErrors[i].strPath + ": " + report.vecErrors[i].strMessage + "\n");
+    }
+    if (report.vecErrors.size() > MAX_REPORTED_COPY_ERRORS) {
+        callback(UTF8("... 另有 ") + std::to_string(report.vecErrors.size() - MAX_REPORTED_COPY_ERRORS) +
+                 UTF8(" 个文件复制失败\n"));
+    }
+    error = std::to_string(report.vecErrors.size()) + UTF8(" 个文件复制失败");
+    return false;
+}
+
+// GPU驱动版本查询脚本：输出与设备名完全匹配的驱动版本号，用作驱动缓存的版本键
+static const ScriptFunction<std::string> GET_DRIVER_VERSION(
+    "Get-SgpGpuDriverVersion", { "gpuName" },
+    "$d = Get-WmiObject Win32_PNPSignedDriver -Filter \"DeviceClass='DISPLAY'\" | "
+    "     Where-Object { $_.DeviceName -eq $gpuName } | Select-Object -First 1; "
+    "if ($d) { $d.DriverVersion } ");
+
+// 从主机驱动缓存复制：返回false表示未命中或复制失败，由调用者改为完整枚举
+static bool CopyFromDriverCache(
+    DriverCache& cache,
+    const std::string& versionKey,
+    const std::string& volumeRoot,
+    DriverManifest& manifest,
+    ProgressCallback callback) {
+    std::vector<CacheEntry> entries;
+    if (versionKey.empty() || !cache.LoadVersion(versionKey, entries)) {
         return false;
     }
     
+    callback(UTF8("从驱动缓存复制（") + versionKey + ", " + std::to_string(entries.size()) + UTF8(" 个文件）...\n"));
+    CopyEngine engine;
+    for (const auto& entry : entries) {
+        engine.Add(cache.ObjectPath(entry), volumeRoot + "\\" + entry.strRelativePath);
+    }
+    std::string cacheError;
+    if (!RunCopyEngine(engine, manifest, callback, cacheError)) {
+        callback(UTF8("警告：驱动缓存复制失败，改为从主机驱动目录复制 - ") + cacheError + "\n");
+        return false;
+    }
+    return true;
+}
+
+// 复制驱动到已挂载的虚拟机磁盘
+bool GPUPVConfigurator::CopyDriversToVolume(
+    const std::string& vmName,
+    const std::string& gpuName,
+    const std::string& volumeRoot,
+    NtfsWriter* pImage,
+    ProgressCallback callback,
+    std::string& error) {
+    ExecutorTrace::Scope traceScope("CopyDriversToVolume");
+    
     callback(UTF8("目标GPU: ") + gpuName + "\n");
     
     bool overallSuccess = true;
     std::string tempError;
 
-    // 3. 拷贝GPU服务驱动目录
+    // 0. 加载上次同步的清单（不存在或损坏时全量同步）
+    DriverManifest manifest;
+    manifest.SetImage(pImage);
+    if (!manifest.Load(volumeRoot, tempError)) {
+        callback(UTF8("警告：") + tempError + "\n");
+    } else if (manifest.Size() > 0) {
+        callback(UTF8("增量同步：清单中有 ") + std::to_string(manifest.Size()) + UTF8(" 个文件\n"));
+    }
+    tempError.clear();
+
+    // 1. 同一驱动版本已缓存时直接从缓存复制（驱动版本查询不到则不使用缓存）
+    DriverCache cache;
+    std::string driverVersion = Utils::Trim(PowerShellExecutor::Execute(GET_DRIVER_VERSION.Invoke(gpuName)));
+    std::string versionKey = DriverCache::MakeVersionKey(gpuName, driverVersion);
+    bool fromCache = CopyFromDriverCache(cache, versionKey, volumeRoot, manifest, callback);
+    if (!fromCache) {
+        overallSuccess = CopyFromHostDriverStore(gpuName, volumeRoot, manifest, callback, error);
+        
+        // 完整枚举成功后，把本次写入的文件存入缓存（哈希已在复制时算出）
+        if (overallSuccess && !versionKey.empty()) {
+            std::vector<CacheEntry> entries;
+            for (const auto& [key, entry] : manifest.SeenEntries()) {
+                entries.push_back({ Utils::WStringToString(key), entry.ui64Size, entry.ui64WriteTime, entry.ui64Hash,
+                                    Utils::WStringToString(entry.wstrSource) });
+            }
+            if (cache.StoreVersion(versionKey, volumeRoot, entries, tempError)) {
+                callback(UTF8("已存入驱动缓存: ") + versionKey + "\n");
+            } else {
+                callback(UTF8("警告：") + tempError + "\n");
+            }
+        }
+    }
+    
+    // 2. 记录虚拟机使用的驱动版本，回收不再使用的旧版本
+    if (overallSuccess && !versionKey.empty()) {
+        size_t versions = 0, objects = 0;
+        uint64_t bytes = 0;
+        cache.AddReference(versionKey, vmName);
+        cache.CollectGarbage(versions, objects, bytes);
+        if (versions > 0 || objects > 0) {
+            callback(UTF8("驱动缓存回收: ") + std::to_string(versions) + UTF8(" 个旧版本, ") +
+                     std::to_string(objects) + UTF8(" 个文件 (") + std::to_string(bytes / (1024 * 1024)) + " MB)\n");
+        }
+    }
+
+    // 3. 删除过期文件（只有全部步骤成功时才能确定哪些文件不再需要），保存清单
+    if (overallSuccess) {
+        size_t staleFiles = 0;
+        uint64_t staleBytes = 0;
+        manifest.RemoveStale(staleFiles, staleBytes);
+        if (staleFiles > 0) {
+            callback(UTF8("已删除过期驱动文件 ") + std::to_string(staleFiles) + UTF8(" 个 (") +
+                     std::to_string(staleBytes / (1024 * 1024)) + " MB)\n");
+        }
+    }
+    if (!manifest.Save(tempError)) {
+        callback(UTF8("警告：") + tempError + "\n");
+    }
+    
+    // 4. 离线写入：提交写入器（重建目录索引、释放旧空间、回读校验目录），
+    //    之后的验证从重新打开的卷读取落盘后的内容
+    NtfsVolume imageVolume;
+    NtfsVolume* volume = nullptr;
+    if (pImage) {
+        if (!pImage->Commit(tempError)) {
+            error = UTF8("提交虚拟机磁盘镜像的写入失败: ") + tempError;
+            return false;
+        }
+        const NtfsWriteStats& stats = pImage->Stats();
+        callback(UTF8("镜像写入已提交: ") + std::to_string(stats.ui64FilesWritten) + UTF8(" 个文件, ") +
+                 std::to_string(stats.ui64BytesWritten / (1024 * 1024)) + " MB, " +
+                 std::to_string(stats.ui64DirectoriesCreated) + UTF8(" 个新目录, 删除 ") +
+                 std::to_string(stats.ui64FilesDeleted) + UTF8(" 个文件, 重建 ") +
+                 std::to_string(stats.ui64IndexesRebuilt) + UTF8(" 个目录索引\n"));
+        if (!imageVolume.Open(*pImage->Device(), tempError)) {
+            error = UTF8("重新打开虚拟机磁盘镜像失败: ") + tempError;
+            return false;
+        }
+        volume = &imageVolume;
+    }
+    
+    // 5. 验证：逐个校验清单中的文件，再检查关键文件是否齐全；
+    //    本次写入的文件不一致（复制不完整）或关键文件缺失时步骤失败，
+    //    其余问题（部分文件复制失败、虚拟机中的文件被修改）只作为警告
+    callback(UTF8("正在验证驱动文件...\n"));
+    tempError.clear();
+    bool verified = VerifyDriverFiles(volumeRoot, gpuName, manifest, volume, callback, tempError);
+    if (!tempError.empty()) {
+        if (!error.empty()) error += "\n";
+        error += tempError;
+    }
+    return verified;
+}
+
+// 从主机驱动目录枚举并复制：GPU服务驱动、PnP驱动文件、NVIDIA特殊文件
+bool GPUPVConfigurator::CopyFromHostDriverStore(
+    const std::string& gpuName,
+    const std::string& volumeRoot,
+    DriverManifest& manifest,
+    ProgressCallback callback,
+    std::string& error) {
+    bool overallSuccess = true;
+    std::string tempError;
+
+    // 1. 拷贝GPU服务驱动目录
     callback(UTF8("正在拷贝GPU服务驱动...\n"));
-    if (!CopyGPUServiceDriver(gpuName, driveLetter, callback, tempError)) {
+    if (!CopyGPUServiceDriver(gpuName, volumeRoot, manifest, callback, tempError)) {
         callback(UTF8("警告：GPU服务驱动拷贝失败 - ") + tempError + "\n");
         // 服务驱动失败通常是致命的，但我们尝试继续
         overallSuccess = false;
         if (error.empty()) error = tempError;
     }
 
-    // 4. 拷贝PnP驱动文件
+    // 2. 拷贝PnP驱动文件
     callback(UTF8("正在拷贝PnP驱动文件...\n"));
-    if (!CopyPnPDriverFiles(gpuName, driveLetter, callback, tempError)) {
+    if (!CopyPnPDriverFiles(gpuName, volumeRoot, manifest, callback, tempError)) {
         callback(UTF8("警告：PnP驱动文件拷贝不完整 - ") + tempError + "\n");
         overallSuccess = false; 
     }
 
-    // 5. 拷贝NVIDIA特殊文件（如果是NVIDIA卡）
+    // 3. 拷贝NVIDIA特殊文件（如果是NVIDIA卡）
     if (gpuName.find("NVIDIA") != std::string::npos) {
         callback(UTF8("正在处理NVIDIA特殊文件...\n"));
-        if (!CopyNvidiaSpecialFiles(gpuName, driveLetter, callback, tempError)) {
+        if (!CopyNvidiaSpecialFiles(gpuName, volumeRoot, manifest, callback, tempError)) {
              callback(UTF8("警告：NVIDIA特殊文件拷贝失败 - ") + tempError + "\n");
+             overallSuccess = false;
         }
     }
-    
-    // 6. 验证安装结果 (增强版：检查更多关键文件)
-    callback(UTF8("正在验证驱动文件...\n"));
-    std::string verifyCmd = 
-        "$driveLetter = '" + driveLetter + "'; "
-        "$gpuName = '" + gpuName + "'; "
-        "$isNvidia = $gpuName -like '*NVIDIA*'; "
-        "$isAMD = $gpuName -like '*AMD*' -or $gpuName -like '*Radeon*'; "
-        "$isIntel = $gpuName -like '*Intel*'; "
-        
-        "$filesFound = @(); "
-        "$filesMissing = @(); "
-        
-        "<# NVIDIA关键文件 #>"
-        "if ($isNvidia) { "
-        "    $nvidiaFiles = @( "
-        "        (Join-Path $driveLetter 'Windows\\System32\\drivers\\nvlddmkm.sys'), "
-        "        (Join-Path $driveLetter 'Windows\\System32\\nvapi64.dll'), "
-        "        (Join-Path $driveLetter 'Windows\\System32\\nvoglv64.dll') "
-        "    ); "
-        "    foreach ($file in $nvidiaFiles) { "
-        "        if (Test-Path $file) { "
-        "            $filesFound += $file; "
-        "        } else { "
-        "            $filesMissing += $file; "
-        "        } "
-        "    } "
-        "} "
-        
-        "<# 检查HostDriverStore目录 #>"
-        "$hostDriverStore = Join-Path $driveLetter 'Windows\\System32\\HostDriverStore\\FileRepository'; "
-        "if (Test-Path $hostDriverStore) { "
-        "    $driverPackages = Get-ChildItem -Path $hostDriverStore -Directory -ErrorAction SilentlyContinue | Measure-Object; "
-        "    if ($driverPackages.Count -gt 0) { "
-        "        $filesFound += ('HostDriverStore: ' + $driverPackages.Count + ' packages'); "
-        "    } else { "
-        "        $filesMissing += 'HostDriverStore: No driver packages found'; "
-        "    } "
-        "} else { "
-        "    $filesMissing += 'HostDriverStore directory does not exist'; "
-        "} "
-        
-        "<# 输出验证结果 #>"
-        "Write-Output '[VERIFY_RESULT]'; "
-        "Write-Output ('Files Found: ' + $filesFound.Count); "
-        "foreach ($f in $filesFound) { Write-Output ('[FOUND] ' + $f); } "
-        "Write-Output ('Files Missing: ' + $filesMissing.Count); "
-        "foreach ($f in $filesMissing) { Write-Output ('[MISSING] ' + $f); } "
-        
-        "<# 判断整体验证结果 #>"
-        "if ($filesFound.Count -gt 0 -and $filesMissing.Count -eq 0) { "
-        "    Write-Output 'VERIFY_OK'; "
-        "} elseif ($filesFound.Count -gt 0) { "
-        "    Write-Output 'VERIFY_PARTIAL'; "
-        "} else { "
-        "    Write-Output 'VERIFY_FAIL'; "
-        "} ";
-        
-    std::string verifyOutput = PowerShellExecutor::Execute(verifyCmd);
-    
-    // 解析验证结果
-    std::vector<std::string> lines = Utils::Split(verifyOutput, '\n');
-    bool hasFound = false, hasMissing = false;
-    for (const auto& line : lines) {
-        std::string trimmed = Utils::Trim(line);
-        if (trimmed.find("[FOUND]") == 0) {
-            callback(UTF8("✓ ") + trimmed.substr(7) + "\n");
-            hasFound = true;
-        } else if (trimmed.find("[MISSING]") == 0) {
-            callback(UTF8("✗ ") + trimmed.substr(9) + "\n");
-            hasMissing = true;
-        }
-    }
-    
-    if (verifyOutput.find("VERIFY_OK") != std::string::npos) {
-        callback(UTF8("验证通过：所有关键驱动文件已存在\n"));
-    } else if (verifyOutput.find("VERIFY_PARTIAL") != std::string::npos) {
-        callback(UTF8("警告：部分驱动文件缺失，但关键文件已存在\n"));
-    } else {
-        callback(UTF8("错误：验证失败，关键驱动文件缺失\n"));
-        if (!error.empty()) error += "\n";
-        error += UTF8("驱动文件验证失败，请检查HostDriverStore目录");
-    }
 
-    // 7. 卸载虚拟机磁盘
-    callback(UTF8("正在卸载虚拟机磁盘...\n"));
-    std::string dismountError;
-    if (!DismountVMDisk(vmName, dismountError)) {
-        error = dismountError;
-        return false;
-    }
-    
-    // 如果虽然有部分失败但关键文件可能已复制，我们可以返回true
-    // 或者严格返回overallSuccess。
-    // 这里我们稍微宽松一点，只要没有严重错误就返回true
-    return true; 
+    return overallSuccess;
 }
 
+// GPU服务驱动目录计划脚本：按GPU名称找到服务驱动，输出其DriverStore目录（PACKAGE），
+// 复制由CopyEngine完成；参数以引号转义后传入，名称中的单引号不会破坏脚本
+static const ScriptFunction<std::string, std::string> COPY_GPU_SERVICE_DRIVER(
+    "Get-SgpServiceDriverCopyPlan", { "gpuName", "volumeRoot" },
+    "$ErrorActionPreference = 'Stop'; "
+    
+    "$gpu = Get-PnpDevice | Where-Object { $_.Name -like ('*' + $gpuName + '*') -and $_.Status -eq 'OK' } | Select-Object -First 1; "
+    "if (-not $gpu) { throw 'GPU not found'; } "
+    "$serviceName = $gpu.Service; "
+    "Emit-Record 'INFO' ('GPU Service Name: ' + $serviceName); "
+    
+    "$sysDriver = Get-WmiObject Win32_SystemDriver | Where-Object { $_.Name -eq $serviceName }; "
+    "if (-not $sysDriver) { throw 'Service driver not found'; } "
+    "$sysPath = $sysDriver.Pathname; "
+    "Emit-Record 'INFO' ('Service Driver Path: ' + $sysPath); "
+    
+    "$ServiceDriverDir = $sysPath.split('\\')[0..5] -join('\\'); "
+    "$ServicedriverDest = ($volumeRoot + '\\' + ($sysPath.split('\\')[1..5] -join('\\'))).Replace('DriverStore','HostDriverStore'); "
+    
+    "Emit-Record 'PACKAGE' $ServiceDriverDir $ServicedriverDest; ");
+
 // 拷贝GPU服务驱动目录
 bool GPUPVConfigurator::CopyGPUServiceDriver(
     const std::string& gpuName,
-    const std::string& driveLetter,
+    const std::string& volumeRoot,
+    DriverManifest& manifest,
     ProgressCallback callback,
     std::string& error) {
+    ExecutorTrace::Scope traceScope("CopyGPUServiceDriver");
     
-    std::string command = 
-        "$ErrorActionPreference = 'Stop'; "
-        "$gpuName = '" + gpuName + "'; "
-        "$driveLetter = '" + driveLetter + "'; "
-        
-        "$gpu = Get-PnpDevice | Where-Object { $_.Name -like ('*' + $gpuName + '*') -and $_.Status -eq 'OK' } | Select-Object -First 1; "
-        "if (-not $gpu) { throw 'GPU not found'; } "
-        "$serviceName = $gpu.Service; "
-        "Write-Output ('[DEBUG] GPU Service Name: ' + $serviceName); "
-        
-        "$sysDriver = Get-WmiObject Win32_SystemDriver | Where-Object { $_.Name -eq $serviceName }; "
-        "if (-not $sysDriver) { throw 'Service driver not found'; } "
-        "$sysPath = $sysDriver.Pathname; "
-        "Write-Output ('[DEBUG] Service Driver Path: ' + $sysPath); "
-        
-        "$ServiceDriverDir = $sysPath.split('\\')[0..5] -join('\\'); "
-        "$ServicedriverDest = ($driveLetter + '\\' + ($sysPath.split('\\')[1..5] -join('\\'))).Replace('DriverStore','HostDriverStore'); "
-        
-        "Write-Output ('[INFO] Copying service driver directory...'); "
-        "Write-Output ('[INFO] Source: ' + $ServiceDriverDir); "
-        "Write-Output ('[INFO] Dest: ' + $ServicedriverDest); "
-        
-        "if (!(Test-Path $ServicedriverDest)) { "
-        "    Copy-Item -Path $ServiceDriverDir -Destination $ServicedriverDest -Recurse -Force; "
-        "    Write-Output '[SUCCESS] Service driver directory copied'; "
-        "} else { "
-        "    Write-Output '[INFO] Service driver directory already exists'; "
-        "} ";
+    std::string command = COPY_GPU_SERVICE_DRIVER.Invoke(gpuName, volumeRoot);
 
-    std::string output;
-    if (PowerShellExecutor::ExecuteWithCheck(command, output, error)) {
-        std::vector<std::string> lines = Utils::Split(output, '\n');
-        for (const auto& line : lines) {
-            std::string trimmed = Utils::Trim(line);
-            if (!trimmed.empty()) {
-                callback(trimmed + "\n");
-            }
+    // 脚本只定位驱动目录，复制由CopyEngine按清单增量完成
+    CopyEngine engine;
+    auto onLine = [&](std::string_view line) {
+        ScriptRecord record;
+        if (!ScriptRecordDecoder::DecodeLine(line, record)) {
+            return;
         }
-    } else {
+        if (record.eType == RecordType::Package) {
+            callback("[PACKAGE] " + record.strValue + " -> " + record.strDetail + "\n");
+            engine.Add(record.strValue, record.strDetail);
+        } else if (record.eType == RecordType::Info) {
+            callback("[INFO] " + record.strValue + "\n");
+        }
+    };
+    if (!PowerShellExecutor::ExecuteStreaming(command, onLine, error)) {
         callback(UTF8("警告：服务驱动目录复制失败 - ") + error + "\n");
         return false;
     }
-    return true;
+    return RunCopyEngine(engine, manifest, callback, error);
 }
 
+// PnP驱动文件计划脚本：按设备名逐级放宽匹配，输出需要复制的驱动包（PACKAGE）
+// 和运行时DLL（FILE），复制由CopyEngine完成；$planned避免同一目标重复输出
+static const ScriptFunction<std::string, std::string> COPY_PNP_DRIVER_FILES(
+    "Get-SgpPnpDriverCopyPlan", { "gpuName", "volumeRoot" },
+    "$ErrorActionPreference = 'SilentlyContinue'; "
+    "$hostname = $env:COMPUTERNAME; "
+    "$planned = @{}; "
+    
+    "$gpuCoreName = $gpuName; "
+    "$gpuCoreName = $gpuCoreName -replace ' Laptop GPU$', ''; "
+    "$gpuCoreName = $gpuCoreName -replace ' Laptop$', ''; "
+    "$gpuCoreName = $gpuCoreName -replace ' Mobile$', ''; "
+    "$gpuCoreName = $gpuCoreName -replace ' GPU$', ''; "
+    "$gpuCoreName = $gpuCoreName.Trim(); "
+    "$Drivers = $null; "
+    "$Drivers = Get-WmiObject Win32_PNPSignedDriver | Where-Object { $_.DeviceName -eq $gpuName }; "
+    "if (-not $Drivers) { "
+    "    $Drivers = Get-WmiObject Win32_PNPSignedDriver | Where-Object { $_.DeviceName -like ('*' + $gpuName + '*') }; "
+    "} "
+    "if (-not $Drivers) { "
+    "    $Drivers = Get-WmiObject Win32_PNPSignedDriver | Where-Object { $_.DeviceName -like ('*' + $gpuCoreName + '*') }; "
+    "} "
+    "if (-not $Drivers) { "
+    "    $gpuWithoutLaptop = $gpuCoreName -replace ' Laptop', ''; "
+    "    $Drivers = Get-WmiObject Win32_PNPSignedDriver | Where-Object { $_.DeviceName -like ('*' + $gpuWithoutLaptop + '*') }; "
+    "} "
+    "if (-not $Drivers) { "
+    "    if ($gpuCoreName -match '(RTX|GTX|GT)\\s*(\\d+)') { "
+    "        $modelNum = $matches[2]; "
+    "        $Drivers = Get-WmiObject Win32_PNPSignedDriver | Where-Object { $_.DeviceName -like ('*NVIDIA*' + $modelNum + '*') }; "
+    "    } "
+    "} "
+    "$DriverArray = @($Drivers); "
+    "$DriverCount = $DriverArray.Count; "
+    "Emit-Record 'INFO' ('Found ' + $DriverCount + ' driver records for: ' + $gpuName); "
+    
+    "if ($DriverCount -eq 0) { "
+    "    Emit-Record 'ERROR' ('No drivers found for GPU: ' + $gpuName); "
+    "    exit 1; "
+    "} "
+    
+    "foreach ($d in $DriverArray) { "
+        "Emit-Record 'INFO' ('Processing driver: ' + $d.DeviceName); "
+    "    $DriverFiles = @(); "
+    "    $ModifiedDeviceID = $d.DeviceID -replace '\\\\', '\\\\\\\\'; "
+    "    $Antecedent = '\\\\\\\\' + $hostname + '\\\\ROOT\\\\cimv2:Win32_PNPSignedDriver.DeviceID=\"\"' + $ModifiedDeviceID + '\"\"'; "
+    "    $DriverFiles = Get-WmiObject Win32_PNPSignedDriverCIMDataFile | Where-Object { $_.Antecedent -eq $Antecedent }; "
+    
+    "    foreach ($file in $DriverFiles) { "
+    "        $path = $file.Dependent.Split('=')[1] -replace '\\\\\\\\', '\\\\'; "
+    "        $sourcePath = $path.Substring(1, $path.Length - 2); "
+    
+    "        if ($sourcePath -match '(?i)\\\\driverstore\\\\') { "
+    "            $DriverDir = ($sourcePath.Split('\\\\'))[0..5] -join('\\\\'); "
+    "            $relativePath = ($sourcePath.Split('\\\\'))[1..5] -join('\\\\'); "
+    "            $driverDest = $volumeRoot + '\\\\' + ($relativePath -ireplace 'driverstore', 'HostDriverStore'); "
+    
+    "            if (!$planned.ContainsKey($driverDest)) { "
+    "                $planned[$driverDest] = $true; "
+    "                Emit-Record 'PACKAGE' $DriverDir $driverDest; "
+    "            } "
+    "        } "
+    "        else { "
+    "            $destPath = $sourcePath -replace 'C:', $volumeRoot; "
+    "            if (!$planned.ContainsKey($destPath)) { "
+    "                $planned[$destPath] = $true; "
+    "                Emit-Record 'FILE' $sourcePath $destPath; "
+    "            } "
+    "        } "
+    "    } "
+    "} "
+    
+    "Emit-Record 'INFO' 'Planning critical NVIDIA runtime DLLs...'; "
+    "$criticalDLLs = @( "
+    "    'nvapi64.dll', "
+    "    'nvoglv64.dll', "
+    "    'nvcuda.dll', "
+    "    'nvwgf2umx.dll', "
+    "    'nvd3dumx.dll', "
+    "    'nvcuvid.dll', "
+    "    'nvencodeapi64.dll', "
+    "    'nvfatbinaryLoader.dll', "
+    "    'nvcompiler.dll' "
+    "); "
+    
+    "foreach ($dll in $criticalDLLs) { "
+    "    $source = 'C:\\Windows\\System32\\' + $dll; "
+    "    $dest = $volumeRoot + '\\Windows\\System32\\' + $dll; "
+    "    if (Test-Path $source) { "
+    "        if (!$planned.ContainsKey($dest)) { "
+    "            $planned[$dest] = $true; "
+    "            Emit-Record 'FILE' $source $dest; "
+    "        } "
+    "    } else { "
+    "        Emit-Record 'INFO' ($dll + ' not found on host'); "
+    "    } "
+    "} "
+    
+    "Emit-Record 'INFO' 'Planning DLLs from driver package to System32...'; "
+    "$driverStoreRepo = 'C:\\Windows\\System32\\DriverStore\\FileRepository'; "
+    "$nvPackage = Get-ChildItem $driverStoreRepo -Directory -ErrorAction SilentlyContinue | "
+    "             Where-Object { $_.Name -like '*nvltsi*' -or $_.Name -like '*nvlt.inf*' } | "
+    "             Select-Object -First 1; "
+    
+    "if ($nvPackage) { "
+    "    Emit-Record 'INFO' ('Found driver package: ' + $nvPackage.Name); "
+    "    $keyDLLs = @( "
+    "        'nvwgf2umx.dll', "
+    "        'nvoglv64.dll', "
+    "        'nvd3dumx.dll', "
+    "        'nvcuda64.dll', "
+    "        'nvwgf2um.dll', "
+    "        'nvopencl64.dll', "
+    "        'nvEncodeAPI64.dll', "
+    "        'nvofapi64.dll', "
+    "        'nvml.dll', "
+    "        'nvcuvid64.dll', "
+    "        'nvoptix.dll', "
+    "        'nvrtum64.dll' "
+    "    ); "
+    "    foreach ($dll in $keyDLLs) { "
+    "        $sourcePath = Join-Path $nvPackage.FullName $dll; "
+    "        $destPath = $volumeRoot + '\\Windows\\System32\\' + $dll; "
+    "        if (Test-Path $sourcePath) { "
+    "            if (!$planned.ContainsKey($destPath)) { "
+    "                $planned[$destPath] = $true; "
+    "                Emit-Record 'FILE' $sourcePath $destPath; "
+    "            } "
+    "        } "
+    "    } "
+    "} else { "
+    "    Emit-Record 'WARN' 'NVIDIA driver package not found in DriverStore'; "
+    "} "
+    
+    "Emit-Record 'DONE'; ");
+
 // 拷贝PnP驱动文件
 bool GPUPVConfigurator::CopyPnPDriverFiles(
     const std::string& gpuName,
-    const std::string& driveLetter,
+    const std::string& volumeRoot,
+    DriverManifest& manifest,
     ProgressCallback callback,
     std::string& error) {
-    
-    // 转义GPU名称中的单引号，防止PowerShell命令注入
-    std::string escapedGpuName = gpuName;
-    size_t pos = 0;
-    while ((pos = escapedGpuName.find("'", pos)) != std::string::npos) {
-        escapedGpuName.replace(pos, 1, "''");
-        pos += 2;
-    }
-    
-    std::string command = 
-        "$ErrorActionPreference = 'SilentlyContinue'; "
-        "$hostname = $env:COMPUTERNAME; "
-        "$gpuName = '" + escapedGpuName + "'; "
-        "$driveLetter = '" + driveLetter + "'; "
-        
-        "New-Item -ItemType Directory -Path (Join-Path $driveLetter 'Windows\\System32\\HostDriverStore') -Force | Out-Null; "
-        "$gpuCoreName = $gpuName; "
-        "$gpuCoreName = $gpuCoreName -replace ' Laptop GPU$', ''; "
-        "$gpuCoreName = $gpuCoreName -replace ' Laptop$', ''; "
-        "$gpuCoreName = $gpuCoreName -replace ' Mobile$', ''; "
-        "$gpuCoreName = $gpuCoreName -replace ' GPU$', ''; "
-        "$gpuCoreName = $gpuCoreName.Trim(); "
-        "$Drivers = $null; "
-        "$Drivers = Get-WmiObject Win32_PNPSignedDriver | Where-Object { $_.DeviceName -eq $gpuName }; "
-        "if (-not $Drivers) { "
-        "    $Drivers = Get-WmiObject Win32_PNPSignedDriver | Where-Object { $_.DeviceName -like ('*' + $gpuName + '*') }; "
-        "} "
-        "if (-not $Drivers) { "
-        "    $Drivers = Get-WmiObject Win32_PNPSignedDriver | Where-Object { $_.DeviceName -like ('*' + $gpuCoreName + '*') }; "
-        "} "
-        "if (-not $Drivers) { "
-        "    $gpuWithoutLaptop = $gpuCoreName -replace ' Laptop', ''; "
-        "    $Drivers = Get-WmiObject Win32_PNPSignedDriver | Where-Object { $_.DeviceName -like ('*' + $gpuWithoutLaptop + '*') }; "
-        "} "
-        "if (-not $Drivers) { "
-        "    if ($gpuCoreName -match '(RTX|GTX|GT)\\s*(\\d+)') { "
-        "        $modelNum = $matches[2]; "
-        "        $Drivers = Get-WmiObject Win32_PNPSignedDriver | Where-Object { $_.DeviceName -like ('*NVIDIA*' + $modelNum + '*') }; "
-        "    } "
-        "} "
-        "$DriverArray = @($Drivers); "
-        "$DriverCount = $DriverArray.Count; "
-        "Write-Output ('[INFO] Found ' + $DriverCount + ' driver records for: ' + $gpuName); "
-        
-        "if ($DriverCount -eq 0) { "
-        "    Write-Output ('ERROR: No drivers found for GPU: ' + $gpuName); "
-        "    exit 1; "
-        "} "
-        
-        "foreach ($d in $DriverArray) { "
-            "Write-Output ('[DEBUG] Processing driver: ' + $d.DeviceName); "
-        "    $DriverFiles = @(); "
-        "    $ModifiedDeviceID = $d.DeviceID -replace '\\\\', '\\\\\\\\'; "
-        "    $Antecedent = '\\\\\\\\' + $hostname + '\\\\ROOT\\\\cimv2:Win32_PNPSignedDriver.DeviceID=\"\"' + $ModifiedDeviceID + '\"\"'; "
-        "    $DriverFiles = Get-WmiObject Win32_PNPSignedDriverCIMDataFile | Where-Object { $_.Antecedent -eq $Antecedent }; "
-        
-        "    foreach ($file in $DriverFiles) { "
-        "        $path = $file.Dependent.Split('=')[1] -replace '\\\\\\\\', '\\\\'; "
-        "        $sourcePath = $path.Substring(1, $path.Length - 2); "
-        
-        "        if ($sourcePath -match '(?i)\\\\driverstore\\\\') { "
-        "            $DriverDir = ($sourcePath.Split('\\\\'))[0..5] -join('\\\\'); "
-        "            $relativePath = ($sourcePath.Split('\\\\'))[1..5] -join('\\\\'); "
-        "            $driverDest = $driveLetter + '\\\\' + ($relativePath -ireplace 'driverstore', 'HostDriverStore'); "
-        
-        "            if (!(Test-Path $driverDest)) { "
-        "                Copy-Item -Path $DriverDir -Destination $driverDest -Recurse -Force -ErrorAction SilentlyContinue; "
-        "                Write-Output ('[PACKAGE] ' + $DriverDir + ' -> ' + $driverDest); "
-        "            } "
-        "        } "
-        "        else { "
-        "            $destPath = $sourcePath -replace 'C:', $driveLetter; "
-        "            $destDir = Split-Path -Parent $destPath; "
-        
-        "            if (!(Test-Path $destDir)) { "
-        "                New-Item -ItemType Directory -Path $destDir -Force | Out-Null; "
-        "            } "
-        
-        "            Copy-Item -Path $sourcePath -Destination $destPath -Force -ErrorAction SilentlyContinue; "
-        "            Write-Output ('[FILE] ' + $sourcePath + ' -> ' + $destPath); "
-        "        } "
-        "    } "
-        "} "
-        
-        "Write-Output '[INFO] Copying critical NVIDIA runtime DLLs...'; "
-        "$criticalDLLs = @( "
-        "    'nvapi64.dll', "
-        "    'nvoglv64.dll', "
-        "    'nvcuda.dll', "
-        "    'nvwgf2umx.dll', "
-        "    'nvd3dumx.dll', "
-        "    'nvcuvid.dll', "
-        "    'nvencodeapi64.dll', "
-        "    'nvfatbinaryLoader.dll', "
-        "    'nvcompiler.dll' "
-        "); "
-        
-        "foreach ($dll in $criticalDLLs) { "
-        "    $source = 'C:\\Windows\\System32\\' + $dll; "
-        "    $dest = $driveLetter + '\\Windows\\System32\\' + $dll; "
-        "    if (Test-Path $source) { "
-        "        try { "
-        "            Copy-Item -Path $source -Destination $dest -Force -ErrorAction Stop; "
-        "            Write-Output ('[DLL] ' + $source + ' -> ' + $dest); "
-        "        } catch { "
-        "            Write-Output ('[WARN] Failed to copy ' + $dll + ': ' + $_.Exception.Message); "
-        "        } "
-        "    } else { "
-        "        Write-Output ('[SKIP] ' + $dll + ' not found on host'); "
-        "    } "
-        "} "
-        
-        "Write-Output '[INFO] Copying DLLs from HostDriverStore to System32...'; "
-        "$hostDriverStoreRepo = Join-Path $driveLetter 'Windows\\System32\\HostDriverStore\\FileRepository'; "
-        "$nvPackage = Get-ChildItem $hostDriverStoreRepo -Directory -ErrorAction SilentlyContinue | "
-        "             Where-Object { $_.Name -like '*nvltsi*' -or $_.Name -like '*nvlt.inf*' } | "
-        "             Select-Object -First 1; "
-        
-        "if ($nvPackage) { "
-        "    Write-Output ('[INFO] Found driver package: ' + $nvPackage.Name); "
-        "    $keyDLLs = @( "
-        "        'nvwgf2umx.dll', "
-        "        'nvoglv64.dll', "
-        "        'nvd3dumx.dll', "
-        "        'nvcuda64.dll', "
-        "        'nvwgf2um.dll', "
-        "        'nvopencl64.dll', "
-        "        'nvEncodeAPI64.dll', "
-        "        'nvofapi64.dll', "
-        "        'nvml.dll', "
-        "        'nvcuvid64.dll', "
-        "        'nvoptix.dll', "
-        "        'nvrtum64.dll' "
-        "    ); "
-        "    foreach ($dll in $keyDLLs) { "
-        "        $sourcePath = Join-Path $nvPackage.FullName $dll; "
-        "        $destPath = Join-Path ($driveLetter + '\\Windows\\System32') $dll; "
-        "        if (Test-Path $sourcePath) { "
-        "            if (!(Test-Path $destPath)) { "
-        "                try { "
-        "                    Copy-Item -Path $sourcePath -Destination $destPath -Force -ErrorAction Stop; "
-        "                    Write-Output ('[DLL_STORE] ' + $dll + ' -> System32'); "
-        "                } catch { "
-        "                    Write-Output ('[WARN] Failed to copy ' + $dll + ': ' + $_.Exception.Message); "
-        "                } "
-        "            } else { "
-        "                Write-Output ('[SKIP] ' + $dll + ' already exists'); "
-        "            } "
-        "        } "
-        "    } "
-        "} else { "
-        "    Write-Output '[WARN] NVIDIA driver package not found in HostDriverStore'; "
-        "} "
-        
-        "Write-Output 'SUCCESS'; ";
-    
-    callback(UTF8("正在枚举和复制所有驱动文件...\n"));
-    
-    std::string output;
-    if (!PowerShellExecutor::ExecuteWithCheck(command, output, error)) {
-        if (error.empty()) error = UTF8("驱动文件复制失败");
-        return false;
-    }
-    
-    // 解析输出并显示进度
-    std::vector<std::string> lines = Utils::Split(output, '\n');
-    for (const auto& line : lines) {
-        std::string trimmed = Utils::Trim(line);
-        if (trimmed.find("[PACKAGE]") == 0 || trimmed.find("[FILE]") == 0) {
-            callback(trimmed + "\n");
+    ExecutorTrace::Scope traceScope("CopyPnPDriverFiles");
+    
+    std::string command = COPY_PNP_DRIVER_FILES.Invoke(gpuName, volumeRoot);
+    
+    callback(UTF8("正在枚举所有驱动文件...\n"));
+    
+    // 流式执行并实时显示计划（不保留完整输出，只记录结束标记），
+    // 是否需要复制由CopyEngine按清单逐个文件判断
+    CopyEngine engine;
+    bool hasOutput = false;
+    bool hasSuccess = false;
+    bool hasError = false;
+    auto onLine = [&](std::string_view line) {
+        ScriptRecord record;
+        if (!ScriptRecordDecoder::DecodeLine(line, record)) {
+            return;
+        }
+        hasOutput = true;
+        switch (record.eType) {
+            case RecordType::Done:  hasSuccess = true; break;
+            case RecordType::Error: hasError = true; break;
+            case RecordType::Package:
+                callback("[PACKAGE] " + record.strValue + " -> " + record.strDetail + "\n");
+                engine.Add(record.strValue, record.strDetail);
+                break;
+            case RecordType::File:
+                callback("[FILE] " + record.strValue + " -> " + record.strDetail + "\n");
+                engine.Add(record.strValue, record.strDetail);
+                break;
+            case RecordType::Warning:
+                callback("[WARN] " + record.strValue + "\n");
+                break;
+            default: break;
         }
+    };
+    if (!PowerShellExecutor::ExecuteStreaming(command, onLine, error)) {
+        if (error.empty()) error = UTF8("驱动文件枚举失败");
+        return false;
     }
     
-    if (output.find("SUCCESS") == std::string::npos) {
-        if (output.find("ERROR") != std::string::npos) {
+    if (!hasSuccess) {
+        if (hasError) {
             error = UTF8("驱动复制过程中断，未找到所有文件");
             return false;
         }
         
-        if (output.empty()) {
+        if (!hasOutput) {
             error = UTF8("未找到相关驱动文件");
             return false;
         }
     }
     
+    callback(UTF8("正在复制驱动文件...\n"));
+    if (!RunCopyEngine(engine, manifest, callback, error)) {
+        return false;
+    }
     callback(UTF8("所有驱动文件复制完成\n"));
     return true;
 }
@@ -728,32 +1059,100 @@ bool GPUPVConfigurator::CopyPnPDriverFiles(
 // 拷贝NVIDIA特殊文件
 bool GPUPVConfigurator::CopyNvidiaSpecialFiles(
     const std::string& gpuName,
-    const std::string& driveLetter,
+    const std::string& volumeRoot,
+    DriverManifest& manifest,
     ProgressCallback callback,
     std::string& error) {
+    ExecutorTrace::Scope traceScope("CopyNvidiaSpecialFiles");
     
-    std::string command = 
-        "$ErrorActionPreference = 'SilentlyContinue'; "
-        "$driveLetter = '" + driveLetter + "'; "
-        "$destNvDir = Join-Path $driveLetter 'Windows\\System32\\drivers\\Nvidia Corporation'; "
-        "if (-not (Test-Path $destNvDir)) { New-Item -ItemType Directory -Path $destNvDir -Force | Out-Null; } "
-        "$srcNvDir = 'C:\\Windows\\System32\\drivers\\Nvidia Corporation'; "
-        "if (Test-Path $srcNvDir) { "
-        "    Write-Output 'Copying Nvidia Corporation folder content...'; "
-        "    Copy-Item -Path \"$srcNvDir\\*\" -Destination $destNvDir -Recurse -Force; "
-        "} else { "
-        "    Write-Output 'Host Nvidia Corporation folder not found, skipping copy.'; "
-        "} ";
-        
-    PowerShellExecutor::Execute(command);
-    return true;
+    const std::string sourceDir = "C:\\Windows\\System32\\drivers\\Nvidia Corporation";
+    const std::string destDir = volumeRoot + "\\Windows\\System32\\drivers\\Nvidia Corporation";
+    
+    DWORD attributes = GetFileAttributesW(Utils::StringToWString(sourceDir).c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        callback(UTF8("主机上没有Nvidia Corporation目录，跳过\n"));
+        return true;
+    }
+    
+    CopyEngine engine;
+    engine.Add(sourceDir, destDir);
+    return RunCopyEngine(engine, manifest, callback, error);
 }
 
+// 虚拟机GPU设备检查脚本：输出第一条DEVICE记录后返回
+// 注意：脚本拼接为单行，注释必须使用<# #>，#行注释会吞掉其后的全部代码
+static const ScriptFunction<std::string, std::string> TEST_GPU_IN_VM(
+    "Test-SgpGpuInVM", { "vmName", "gpuName" },
+    "$ErrorActionPreference = 'SilentlyContinue'; "
+    
+    "<# 尝试通过Enter-PSSession连接虚拟机 #>"
+    "try { "
+    "    $vm = Get-VM -Name $vmName -ErrorAction Stop; "
+    "    if ($vm.State -ne 'Running') { "
+    "        Emit-Record 'DEVICE' 'VM_NOT_RUNNING'; "
+    "        return; "
+    "    } "
+    
+    "    <# 获取VM的IP地址（如果可能） #>"
+    "    $vmIp = $null; "
+    "    try { "
+    "        $vmNetwork = $vm | Get-VMNetworkAdapter | Where-Object { $_.IPAddresses.Count -gt 0 } | Select-Object -First 1; "
+    "        if ($vmNetwork -and $vmNetwork.IPAddresses.Count -gt 0) { "
+    "            $vmIp = $vmNetwork.IPAddresses[0]; "
+    "        } "
+    "    } catch { } "
+    
+    "    <# 方法1：如果VM有IP且启用了PowerShell远程，尝试Enter-PSSession #>"
+    "    <# 远程脚本块中没有Emit-Record，返回状态和名称后在本地输出记录 #>"
+    "    if ($vmIp) { "
+    "        try { "
+    "            $session = New-PSSession -ComputerName $vmIp -ErrorAction Stop; "
+    "            $deviceStatus = Invoke-Command -Session $session -ScriptBlock { "
+    "                $gpu = Get-PnpDevice | Where-Object { $_.Name -like '*NVIDIA*' -or $_.Name -like '*AMD*' } | Select-Object -First 1; "
+    "                if ($gpu) { ,@([string]$gpu.Status, [string]$gpu.Name) } else { ,@('', '') } "
+    "            }; "
+    "            Remove-PSSession -Session $session; "
+    "            if (-not $deviceStatus[1]) { "
+    "                Emit-Record 'DEVICE' 'NOT_FOUND'; "
+    "            } elseif ($deviceStatus[0] -eq 'OK') { "
+    "                Emit-Record 'DEVICE' 'OK' $deviceStatus[1]; "
+    "            } else { "
+    "                Emit-Record 'DEVICE' 'ERROR' ($deviceStatus[0] + ':' + $deviceStatus[1]); "
+    "            } "
+    "            return; "
+    "        } catch { "
+    "            Emit-Record 'WARN' ('PSSession failed: ' + $_.Exception.Message); "
+    "        } "
+    "    } "
+    
+    "    <# 方法2：通过WMI查询VM中的设备（如果VM启用了WMI） #>"
+    "    if ($vmIp) { "
+    "        try { "
+    "            $wmiDevices = Get-WmiObject -ComputerName $vmIp -Class Win32_PnPEntity -ErrorAction Stop | "
+    "                Where-Object { $_.Name -like '*NVIDIA*' -or $_.Name -like '*AMD*' } | Select-Object -First 1; "
+    "            if ($wmiDevices) { "
+    "                Emit-Record 'DEVICE' 'WMI_FOUND' $wmiDevices.Name; "
+    "            } else { "
+    "                Emit-Record 'DEVICE' 'WMI_NOT_FOUND'; "
+    "            } "
+    "            return; "
+    "        } catch { "
+    "            Emit-Record 'WARN' ('WMI query failed: ' + $_.Exception.Message); "
+    "        } "
+    "    } "
+    
+    "    <# 如果以上方法都失败，返回提示信息 #>"
+    "    Emit-Record 'DEVICE' 'SKIPPED' 'Cannot connect to VM (may need manual check)'; "
+    "} catch { "
+    "    Emit-Record 'ERROR' $_.Exception.Message; "
+    "}");
+
 // 验证虚拟机中的GPU设备状态（通过Enter-PSSession）
 bool GPUPVConfigurator::VerifyGPUDeviceInVM(
     const std::string& vmName,
     const std::string& gpuName,
     ProgressCallback callback) {
+    ExecutorTrace::Scope traceScope("VerifyGPUDeviceInVM");
     
     // 提取GPU核心名称（用于匹配）
     std::string gpuCoreName = gpuName;
@@ -763,93 +1162,29 @@ bool GPUPVConfigurator::VerifyGPUDeviceInVM(
     pos = gpuCoreName.find(" Mobile");
     if (pos != std::string::npos) gpuCoreName = gpuCoreName.substr(0, pos);
     
-    std::string command = 
-        "$ErrorActionPreference = 'SilentlyContinue'; "
-        "$vmName = '" + vmName + "'; "
-        "$gpuName = '" + gpuCoreName + "'; "
-        
-        "# 尝试通过Enter-PSSession连接虚拟机"
-        "try { "
-        "    $vm = Get-VM -Name $vmName -ErrorAction Stop; "
-        "    if ($vm.State -ne 'Running') { "
-        "        Write-Output 'VM_NOT_RUNNING'; "
-        "        exit 0; "
-        "    } "
-        
-        "    # 获取VM的IP地址（如果可能）"
-        "    $vmIp = $null; "
-        "    try { "
-        "        $vmNetwork = $vm | Get-VMNetworkAdapter | Where-Object { $_.IPAddresses.Count -gt 0 } | Select-Object -First 1; "
-        "        if ($vmNetwork -and $vmNetwork.IPAddresses.Count -gt 0) { "
-        "            $vmIp = $vmNetwork.IPAddresses[0]; "
-        "        } "
-        "    } catch { } "
-        
-        "    # 方法1：如果VM有IP且启用了PowerShell远程，尝试Enter-PSSession"
-        "    if ($vmIp) { "
-        "        try { "
-        "            $session = New-PSSession -ComputerName $vmIp -ErrorAction Stop; "
-        "            $deviceStatus = Invoke-Command -Session $session -ScriptBlock { "
-        "                $gpu = Get-PnpDevice | Where-Object { $_.Name -like '*NVIDIA*' -or $_.Name -like '*AMD*' } | Select-Object -First 1; "
-        "                if ($gpu) { "
-        "                    if ($gpu.Status -eq 'OK') { "
-        "                        Write-Output ('DEVICE_OK:' + $gpu.Name); "
-        "                    } else { "
-        "                        Write-Output ('DEVICE_ERROR:' + $gpu.Status + ':' + $gpu.Name); "
-        "                    } "
-        "                } else { "
-        "                    Write-Output 'DEVICE_NOT_FOUND'; "
-        "                } "
-        "            }; "
-        "            Remove-PSSession -Session $session; "
-        "            Write-Output $deviceStatus; "
-        "            exit 0; "
-        "        } catch { "
-        "            Write-Output ('PSSession failed: ' + $_.Exception.Message); "
-        "        } "
-        "    } "
-        
-        "    # 方法2：通过WMI查询VM中的设备（如果VM启用了WMI）"
-        "    if ($vmIp) { "
-        "        try { "
-        "            $wmiDevices = Get-WmiObject -ComputerName $vmIp -Class Win32_PnPEntity -ErrorAction Stop | "
-        "                Where-Object { $_.Name -like '*NVIDIA*' -or $_.Name -like '*AMD*' } | Select-Object -First 1; "
-        "            if ($wmiDevices) { "
-        "                Write-Output ('WMI_DEVICE_FOUND:' + $wmiDevices.Name); "
-        "            } else { "
-        "                Write-Output 'WMI_DEVICE_NOT_FOUND'; "
-        "            } "
-        "            exit 0; "
-        "        } catch { "
-        "            Write-Output ('WMI query failed: ' + $_.Exception.Message); "
-        "        } "
-        "    } "
-        
-        "    # 如果以上方法都失败，返回提示信息"
-        "    Write-Output 'VERIFY_SKIPPED: Cannot connect to VM (may need manual check)'; "
-        "} catch { "
-        "    Write-Output ('VERIFY_ERROR: ' + $_.Exception.Message); "
-        "}";
+    std::string command = TEST_GPU_IN_VM.Invoke(vmName, gpuCoreName);
     
-    std::string output = PowerShellExecutor::Execute(command);
+    // 解析结果：取第一条设备记录
+    ScriptRecord device;
+    ScriptRecordDecoder decoder;
+    auto onRecord = [&](const ScriptRecord& record) {
+        if (record.eType == RecordType::Device && device.eType != RecordType::Device) {
+            device = record;
+        }
+    };
+    decoder.Feed(PowerShellExecutor::Execute(command), onRecord);
+    decoder.Finish(onRecord);
     
-    // 解析结果
-    if (output.find("DEVICE_OK:") != std::string::npos) {
-        size_t pos = output.find("DEVICE_OK:");
-        std::string deviceName = output.substr(pos + 10);
-        deviceName = Utils::Trim(deviceName);
-        callback(UTF8("设备状态正常: ") + deviceName + "\n");
+    if (device.strValue == "OK") {
+        callback(UTF8("设备状态正常: ") + device.strDetail + "\n");
         return true;
-    } else if (output.find("DEVICE_ERROR:") != std::string::npos) {
-        size_t pos = output.find("DEVICE_ERROR:");
-        std::string errorInfo = output.substr(pos + 14);
-        errorInfo = Utils::Trim(errorInfo);
-        callback(UTF8("设备状态异常: ") + errorInfo + "\n");
+    } else if (device.strValue == "ERROR") {
+        callback(UTF8("设备状态异常: ") + device.strDetail + "\n");
         return false;
-    } else if (output.find("DEVICE_NOT_FOUND") != std::string::npos) {
+    } else if (device.strValue == "NOT_FOUND") {
         callback(UTF8("警告：在虚拟机中未找到GPU设备\n"));
         return false;
-    } else if (output.find("VERIFY_SKIPPED") != std::string::npos) {
+    } else if (device.strValue == "SKIPPED") {
         // 无法连接VM，这是正常的（VM可能未启用远程或网络未配置）
         return true; // 不算错误，只是跳过验证
     }
@@ -857,59 +1192,188 @@ bool GPUPVConfigurator::VerifyGPUDeviceInVM(
     return true; // 默认返回true，避免阻塞配置流程
 }
 
+// 虚拟机系统盘路径
+static const ScriptFunction<std::string> GET_VM_DISK_PATH(
+    "Get-SgpVMDiskPath", { "vmName" },
+    "(Get-VM $vmName).HardDrives[0].Path; ");
+
+// 按扩展名直接打开虚拟机磁盘文件，返回打开的一个（nullptr表示失败，error说明原因）
+// VHDX和检查点的差异磁盘（.avhdx，沿父磁盘链读取）由VhdxFile解析，固定和动态VHD由VhdFile解析；
+// 其他格式由挂载脚本逐个分区检查
+static BlockDevice* OpenDiskFile(const std::string& vhdPath, bool readOnly, VhdxFile& vhdx, VhdFile& vhd,
+                                 std::string& error) {
+    std::string lowerPath = vhdPath;
+    std::transform(lowerPath.begin(), lowerPath.end(), lowerPath.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    auto endsWith = [&](const std::string& extension) {
+        return lowerPath.size() > extension.size() &&
+               lowerPath.compare(lowerPath.size() - extension.size(), extension.size(), extension) == 0;
+    };
+    if (endsWith(".vhdx") || endsWith(".avhdx")) {
+        return vhdx.Open(vhdPath, readOnly, error) ? static_cast<BlockDevice*>(&vhdx) : nullptr;
+    }
+    if (endsWith(".vhd")) {
+        return vhd.Open(vhdPath, readOnly, error) ? static_cast<BlockDevice*>(&vhd) : nullptr;
+    }
+    error = UTF8("虚拟机磁盘不是VHDX或VHD格式");
+    return nullptr;
+}
+
+// 不挂载直接解析虚拟机磁盘的分区表，定位Windows系统分区（读取NTFS确认存在Windows\System32）
+// 返回分区起始偏移（与Get-Partition的Offset一致），0表示未能定位
+static uint64_t LocateWindowsPartition(const std::string& vmName) {
+    std::string output, error;
+    if (!PowerShellExecutor::ExecuteWithCheck(GET_VM_DISK_PATH.Invoke(vmName), output, error)) {
+        return 0;
+    }
+    std::string vhdPath = Utils::Trim(output);
+
+    VhdxFile vhdx(1024 * 1024);
+    VhdFile vhd(1024 * 1024);
+    BlockDevice* disk = OpenDiskFile(vhdPath, true, vhdx, vhd, error);
+    PartitionInfo partition;
+    if (!disk || !PartitionTable::FindWindowsPartition(*disk, NtfsVolume::IsWindowsSystemVolume, partition, error)) {
+        return 0;
+    }
+    return partition.ui64Offset;
+}
+
+// 打开离线写入目标：以读写方式打开虚拟机磁盘文件，定位系统分区并开始NTFS写入会话
+// 失败时镜像已关闭（调用者可以改为挂载），error说明原因
+static bool OpenImageTarget(const std::string& vmName, ImageTarget& image, std::string& error) {
+    std::string output;
+    if (!PowerShellExecutor::ExecuteWithCheck(GET_VM_DISK_PATH.Invoke(vmName), output, error)) {
+        return false;
+    }
+    std::string vhdPath = Utils::Trim(output);
+    
+    PartitionInfo partition;
+    image.pDisk = OpenDiskFile(vhdPath, false, image.objVhdx, image.objVhd, error);
+    if (!image.pDisk ||
+        !PartitionTable::FindWindowsPartition(*image.pDisk, NtfsVolume::IsWindowsSystemVolume, partition, error)) {
+        image.objVhdx.Close();
+        image.objVhd.Close();
+        image.pDisk = nullptr;
+        return false;
+    }
+    image.pPartition = std::make_unique<PartitionDevice>(*image.pDisk, partition.ui64Offset, partition.ui64Length);
+    if (!image.objWriter.Begin(*image.pPartition, error)) {
+        image.pPartition.reset();
+        image.objVhdx.Close();
+        image.objVhd.Close();
+        image.pDisk = nullptr;
+        return false;
+    }
+    image.strRoot = vhdPath;
+    return true;
+}
+
+// 关闭离线写入目标：未提交的会话先提交（清除"需要检查"标记），再刷新并关闭镜像
+static bool CloseImageTarget(ImageTarget& image, std::string& error) {
+    bool success = true;
+    if (image.objWriter.IsActive() && !image.objWriter.Commit(error)) {
+        success = false;
+    }
+    std::string flushError;
+    if (image.pDisk && !image.pDisk->Flush(flushError) && success) {
+        error = UTF8("刷新虚拟机磁盘镜像失败: ") + flushError;
+        success = false;
+    }
+    image.pPartition.reset();
+    image.objVhdx.Close();
+    image.objVhd.Close();
+    image.pDisk = nullptr;
+    return success;
+}
+
+// 虚拟机磁盘挂载脚本：成功时最后输出挂载点目录
+// 挂载但不分配驱动器号，然后寻找包含 Windows\System32 的分区，挂载到MountRegistry分配的空目录
+// （不占用盘符，同时挂载的虚拟机数量不受盘符限制）
+// 已知系统分区偏移时只检查该分区（不匹配时退回逐个检查）
+// 每一步等待的都是实际条件（残留挂载已卸载、磁盘联机且分区到达、卷已挂载），条件满足立即继续
+// 注意：构建 PowerShell 脚本时，每行末尾必须加空格或分号，防止拼接错误
+static const ScriptFunction<std::string, uint64_t, std::string> MOUNT_VM_DISK(
+    "Mount-SgpVMDisk", { "vmName", "partitionOffset", "mountPath" },
+    "$ErrorActionPreference = 'Stop'; "
+    "$vhd = (Get-VM $vmName).HardDrives[0].Path; "
+    
+    "if ((Get-VHD -Path $vhd -ErrorAction SilentlyContinue).Attached) { "
+    "    Wait-SgpReady -what 'previous mount to detach' -timeoutMs 15000 -maxIntervalMs 2000 -test { "
+    "        if ((Get-VHD -Path $vhd -ErrorAction SilentlyContinue).Attached) { "
+    "            Dismount-VHD -Path $vhd -ErrorAction SilentlyContinue; "
+    "        } "
+    "        -not (Get-VHD -Path $vhd -ErrorAction SilentlyContinue).Attached "
+    "    }; "
+    "} "
+
+    "$disk = Mount-VHD -Path $vhd -NoDriveLetter -Passthru | Get-Disk; "
+    "if (-not $disk) { throw 'Failed to mount VHD'; } "
+    
+    "$diskNumber = $disk.Number; "
+    "try { "
+    "    Wait-SgpReady -what 'disk to come online' -timeoutMs 30000 -test { "
+    "        $d = Get-Disk -Number $diskNumber -ErrorAction SilentlyContinue; "
+    "        [bool]($d -and $d.OperationalStatus -eq 'Online' -and "
+    "               @(Get-Partition -DiskNumber $diskNumber -ErrorAction SilentlyContinue).Count -gt 0) "
+    "    }; "
+    "} catch { "
+    "    Dismount-VHD -Path $vhd -ErrorAction SilentlyContinue; "
+    "    throw; "
+    "} "
+    "$disk = Get-Disk -Number $diskNumber; "
+    
+    "$accessPath = $mountPath.TrimEnd('\\') + '\\'; "
+    
+    "$partitions = $disk | Get-Partition; "
+    "if ($partitionOffset -gt 0) { "
+    "    $matched = @($partitions | Where-Object { $_.Offset -eq $partitionOffset }); "
+    "    if ($matched.Count -gt 0) { $partitions = $matched; } "
+    "} "
+    "$targetPartition = $null; "
+    
+    "Write-Output ('Scanning ' + $partitions.Count + ' partitions...'); "
+    
+    "foreach ($p in $partitions) { "
+    "    try { "
+    "        if ($p.Type -eq 'Reserved') { continue; } "
+    "        Add-PartitionAccessPath -InputObject $p -AccessPath $accessPath -ErrorAction Stop; "
+    "        Wait-SgpReady -what 'volume to mount' -timeoutMs 5000 -test { "
+    "            @(Get-ChildItem -LiteralPath $accessPath -Force -ErrorAction SilentlyContinue).Count -gt 0 "
+    "        }; "
+    "        if (Test-Path -LiteralPath ($accessPath + 'Windows\\System32')) { "
+    "            $targetPartition = $p; "
+    "            Write-Output $mountPath; "
+    "            break; "
+    "        } "
+    "        Remove-PartitionAccessPath -InputObject $p -AccessPath $accessPath -ErrorAction SilentlyContinue; "
+    "    } catch { "
+    "        Write-Output ('Failed to check partition ' + $p.PartitionNumber + ': ' + $_.Exception.Message); "
+    "        Remove-PartitionAccessPath -InputObject $p -AccessPath $accessPath -ErrorAction SilentlyContinue; "
+    "    } "
+    "} "
+    
+    "if (-not $targetPartition) { "
+    "    Dismount-VHD -Path $vhd -ErrorAction SilentlyContinue; "
+    "    throw 'Could not find system partition with Windows directory'; "
+    "}");
+
 // 挂载虚拟机磁盘
 std::string GPUPVConfigurator::MountVMDisk(const std::string& vmName, std::string& error) {
-    // 挂载但不分配驱动器号，然后寻找包含 Windows\System32 的分区并手动分配临时驱动器号
-    // 注意：构建 PowerShell 脚本时，每行末尾必须加空格或分号，防止拼接错误
-    std::string command = 
-        "$ErrorActionPreference = 'Stop'; "
-        "$vhd = (Get-VM '" + vmName + "').HardDrives[0].Path; "
-        
-        "if ((Get-VHD -Path $vhd -ErrorAction SilentlyContinue).Attached) { "
-        "    Dismount-VHD -Path $vhd -ErrorAction SilentlyContinue; "
-        "    Start-Sleep -Seconds 2; "
-        "} "
-        
-        "if ((Get-VHD -Path $vhd -ErrorAction SilentlyContinue).Attached) { "
-        "    Dismount-VHD -Path $vhd -ErrorAction Stop; "
-        "    Start-Sleep -Seconds 2; "
-        "} "
+    ExecutorTrace::Scope traceScope("MountVMDisk");
 
-        "$disk = Mount-VHD -Path $vhd -NoDriveLetter -Passthru | Get-Disk; "
-        "if (-not $disk) { throw 'Failed to mount VHD'; } "
-        
-        "Start-Sleep -Seconds 3; " 
-        
-        "$driveLetter = 90..68 | ForEach-Object { [char]$_ } | Where-Object { -not (Get-PSDrive -Name $_ -ErrorAction SilentlyContinue) } | Select-Object -First 1; "
-        "if (-not $driveLetter) { throw 'No free drive letters available'; }; "
-        
-        "$partitions = $disk | Get-Partition; "
-        "$targetPartition = $null; "
-        
-        "Write-Output ('Scanning ' + $partitions.Count + ' partitions...'); "
-        
-        "foreach ($p in $partitions) { "
-        "    try { "
-        "        if ($p.Type -eq 'Reserved') { continue; } "
-        "        Add-PartitionAccessPath -InputObject $p -AccessPath ($driveLetter + ':') -ErrorAction Stop; "
-        "        if (Test-Path ($driveLetter + ':\\Windows\\System32')) { "
-        "            $targetPartition = $p; "
-        "            Write-Output $driveLetter; "
-        "            break; "
-        "        } "
-        "        Remove-PartitionAccessPath -InputObject $p -AccessPath ($driveLetter + ':') -ErrorAction SilentlyContinue; "
-        "    } catch { "
-        "        Write-Output ('Failed to check partition ' + $p.PartitionNumber + ': ' + $_.Exception.Message); "
-        "    } "
-        "} "
-        
-        "if (-not $targetPartition) { "
-        "    Dismount-VHD -Path $vhd -ErrorAction SilentlyContinue; "
-        "    throw 'Could not find system partition with Windows directory'; "
-        "}";
+    // 分配挂载点目录（替代盘符），挂载失败时释放
+    std::string mountPath;
+    if (!MountRegistry::Instance().Acquire(vmName, mountPath, error)) {
+        return "";
+    }
     
+    // 挂载前先从磁盘文件读出系统分区的位置，挂载后只挂载该分区
+    uint64_t partitionOffset = LocateWindowsPartition(vmName);
+    std::string command = MOUNT_VM_DISK.Invoke(vmName, partitionOffset, mountPath);
+    
+    // 挂载过程包含多次重试和等待，给予比默认更宽裕的截止时间
     std::string output;
-    if (!PowerShellExecutor::ExecuteWithCheck(command, output, error)) {
+    if (!PowerShellExecutor::ExecuteWithCheck(command, output, error, 5 * 60 * 1000)) {
         if (error.empty()) {
             error = UTF8("挂载虚拟机磁盘失败");
         }
@@ -917,84 +1381,99 @@ std::string GPUPVConfigurator::MountVMDisk(const std::string& vmName, std::strin
         if (!output.empty()) {
              error += " (" + Utils::Trim(output) + ")";
         }
+        std::string releaseError;
+        MountRegistry::Instance().Release(mountPath, releaseError);
         return "";
     }
     
-    std::string driveLetter = Utils::Trim(output);
-    // 清理可能的空白字符或换行
-    if (driveLetter.length() > 1) {
-        // 尝试从输出中提取单个字母
-        size_t lastAlpha = std::string::npos;
-        for (size_t i = 0; i < driveLetter.length(); ++i) {
-            if (isalpha(driveLetter[i])) lastAlpha = i;
-        }
-        if (lastAlpha != std::string::npos) {
-            driveLetter = driveLetter.substr(lastAlpha, 1);
-        }
+    // 脚本成功时最后一行是挂载点目录（之前的行是扫描分区的进度）
+    std::string lastLine = Utils::Trim(output);
+    size_t lineStart = lastLine.find_last_of('\n');
+    if (lineStart != std::string::npos) {
+        lastLine = Utils::Trim(lastLine.substr(lineStart + 1));
     }
-
-    if (driveLetter.empty() || driveLetter.length() != 1) {
-        error = UTF8("无法获取有效系统盘符");
+    if (lastLine != mountPath) {
+        error = UTF8("无法确认系统分区已挂载到: ") + mountPath;
         DismountVMDisk(vmName, output);
         return "";
     }
     
-    return driveLetter + ":";
+    return mountPath;
 }
 
 // 卸载虚拟机磁盘
 bool GPUPVConfigurator::DismountVMDisk(const std::string& vmName, std::string& error) {
-    // 增加短暂延时，并尝试多次卸载（因为文件句柄释放可能有延迟）
+    ExecutorTrace::Scope traceScope("DismountVMDisk");
+    // 先卸载虚拟磁盘，成功后再删除挂载点目录；卸载失败时挂载点仍被跟踪，
+    // 磁盘仍能通过该目录访问，再次卸载时释放
+    
+    // 立即尝试卸载，失败时按指数退避重试（文件句柄释放可能有延迟），Attached变为false即完成
+    // 条件脚本块只能输出布尔值，重试原因保存在$retry中，超时时附加到错误信息
     std::string command = 
         "$vhd = (Get-VM '" + vmName + "').HardDrives[0].Path; "
-        "for ($i=0; $i -lt 5; $i++) { "
-        "    Start-Sleep -Seconds 1; "
-        "    try { "
-        "        if ((Get-VHD -Path $vhd).Attached) { "
-        "            Dismount-VHD -Path $vhd -ErrorAction Stop; "
+        "$retry = @{ error = '' }; "
+        "try { "
+        "    Wait-SgpReady -what 'VHD to detach' -timeoutMs 15000 -maxIntervalMs 2000 -test { "
+        "        try { "
+        "            if ((Get-VHD -Path $vhd).Attached) { "
+        "                Dismount-VHD -Path $vhd -ErrorAction Stop; "
+        "            } "
+        "            -not (Get-VHD -Path $vhd).Attached "
+        "        } catch { "
+        "            $retry.error = $_.Exception.Message; "
+        "            $false "
         "        } "
-        "        break; "
-        "    } catch { "
-        "        Write-Output \"Retrying dismount... $($_.Exception.Message)\"; "
-        "    } "
-        "} "
-        "if ((Get-VHD -Path $vhd).Attached) { throw 'Failed to dismount VHD after multiple attempts' }";
+        "    }; "
+        "} catch { "
+        "    throw ('Failed to dismount VHD after multiple attempts: ' + $retry.error); "
+        "}";
     
-    std::string output;
-    if (!PowerShellExecutor::ExecuteWithCheck(command, output, error)) {
-        if (error.empty()) {
+    CommandResult result;
+    if (!PowerShellExecutor::ExecuteWithResult(command, result)) {
+        if (result.bTimedOut) {
+            // Dismount-VHD挂起（通常是磁盘仍被占用），进程树已被结束
+            error = UTF8("卸载虚拟机磁盘超时（磁盘可能仍被占用，请手动在磁盘管理中卸载）");
+        } else if (result.strError.empty()) {
             // 如果只有空白错误，尝试获取更多信息或手动指定
             error = UTF8("卸载虚拟机磁盘失败（可能被占用，请手动在磁盘管理中卸载）");
+        } else {
+            error = result.strError;
         }
         return false;
     }
     
+    // 目录删除失败时挂载点仍被跟踪，同一虚拟机下次挂载时重试删除
+    std::string mountPath = MountRegistry::Instance().Find(vmName);
+    if (!mountPath.empty()) {
+        std::string releaseError;
+        MountRegistry::Instance().Release(mountPath, releaseError);
+    }
+    
     return true;
 }
 
 // 复制驱动文件夹
 bool GPUPVConfigurator::CopyDriverFolder(
     const std::string& sourcePath,
-    const std::string& driveLetter,
+    const std::string& volumeRoot,
     std::string& error) {
     
-    // 目标路径：虚拟机的HostDriverStore目录
-    std::string destPath = driveLetter + "\\Windows\\System32\\HostDriverStore\\FileRepository";
-    
-    // 创建目标目录
-    std::string createDirCmd = "New-Item -ItemType Directory -Path '" + destPath + "' -Force | Out-Null";
-    PowerShellExecutor::Execute(createDirCmd);
-    
-    // 复制驱动文件夹
-    std::string copyCmd = 
-        "Copy-Item -Path '" + sourcePath + "' -Destination '" + destPath + 
-        "' -Recurse -Force -ErrorAction Stop";
-    
-    std::string output;
-    if (!PowerShellExecutor::ExecuteWithCheck(copyCmd, output, error)) {
-        if (error.empty()) {
-            error = UTF8("复制驱动文件失败");
-        }
+    // 目标路径：虚拟机的HostDriverStore目录下的同名文件夹
+    std::string destPath = volumeRoot + "\\Windows\\System32\\HostDriverStore\\FileRepository";
+    std::string folderPath = sourcePath;
+    while (!folderPath.empty() && (folderPath.back() == '\\' || folderPath.back() == '/')) {
+        folderPath.pop_back();
+    }
+    size_t nameStart = folderPath.find_last_of("\\/");
+    std::string folderName = (nameStart == std::string::npos) ? folderPath : folderPath.substr(nameStart + 1);
+    
+    // 复制驱动文件夹（不需要进度，只收集错误）
+    CopyEngine engine;
+    engine.Add(folderPath, destPath + "\\" + folderName);
+    CopyReport report;
+    if (!engine.Run(nullptr, report)) {
+        error = UTF8("复制驱动文件失败: ") + report.vecErrors.front().strPath + " - " +
+                report.vecErrors.front().strMessage;
         return false;
     }
     
@@ -27,14 +27,16 @@
 *    3. 添加GPU分区适配器
 *    4. 配置GPU资源分配
 *    5. 启用缓存控制
-*    6. 挂载虚拟机磁盘
+*    6. 挂载虚拟机磁盘（设置SMARTGPUPV_OFFLINE_INJECT=1时VHDX/VHD不挂载，
+*       直接打开镜像中的系统分区）
 *    7. 复制GPU驱动文件
-*    8. 卸载虚拟机磁盘
+*    8. 卸载虚拟机磁盘（离线写入时关闭镜像）
 *    9. 失败时恢复原始配置
 * 
 * 依赖项：
 *    - PowerShellExecutor（执行Hyper-V cmdlet）
 *    - VhdHelper（VHD挂载操作）
+*    - MountRegistry（挂载点目录）
 *    - VMManager（虚拟机控制）
 * 
 * 使用注意：
@@ -49,9 +51,13 @@
 *********************************************************************************/
 
 #pragma once
+#include "JsonReader.h"
 #include <string>
 #include <functional>
 
+class DriverManifest;
+class NtfsWriter;
+
 /********************************************************************************
 * 类型定义：进度回调函数
 * 功能说明：用于向调用者报告配置进度的回调函数类型
@@ -83,6 +89,14 @@ struct GPUPVBackup {
     bool        bGuestControlledCacheTypes = false; // 缓存控制标志
 };
 
+// 备份查询中适配器对象的JSON字段
+template <>
+struct JsonFields<GPUPVBackup> {
+    static constexpr auto Fields = std::make_tuple(
+        MakeJsonField("InstancePath", &GPUPVBackup::strInstancePath),
+        MakeJsonField("MinPartitionVRAM", &GPUPVBackup::ui64VramBytes));
+};
+
 /********************************************************************************
 * 类名称：GPU-PV配置器
 * 类功能：提供GPU分区虚拟化的完整配置流程
@@ -222,22 +236,50 @@ private:
     );
     
     /********************************************************************************
-    * 函数名称：复制驱动文件（内部方法）
-    * 函数功能：将GPU驱动文件复制到虚拟机系统分区
+    * 函数名称：确定目标GPU名称（内部方法）
+    * 函数功能：同时执行三种查询（虚拟机适配器、主机可分区GPU、任意NVIDIA GPU），
+    *           按优先级取第一个非空结果
     * 函数参数：
     *    [IN]  const std::string& strVMName：虚拟机名称
-    *    [IN]  const std::string& strDriverPath：驱动源路径
     *    [IN]  ProgressCallback callback：进度回调函数
+    *    [OUT] std::string& strGPUName：GPU名称（PnP设备名）
     *    [OUT] std::string& strError：错误信息
     * 返回类型：bool
-    *    成功返回true，失败返回false
+    *    找到GPU名称返回true，否则返回false
     * 注意事项：
-    *    - 需要挂载虚拟机磁盘
-    *    - 复制到C:\Windows\System32\HostDriverStore\FileRepository
+    *    - 虚拟机必须已添加GPU分区适配器，前两种查询才有结果
     *********************************************************************************/
-    static bool CopyDriverFiles(
+    static bool ResolveTargetGPUName(
         const std::string& strVMName,
-        const std::string& strDriverPath,
+        ProgressCallback callback,
+        std::string& strGPUName,
+        std::string& strError
+    );
+    
+    /********************************************************************************
+    * 函数名称：复制驱动到已挂载的磁盘（内部方法）
+    * 函数功能：按虚拟机中的驱动清单增量同步GPU服务驱动、PnP驱动文件和NVIDIA
+    *           特殊文件（只复制变化的文件，删除过期文件），并验证结果；
+    *           同一驱动版本已在主机驱动缓存中时直接从缓存复制，不再枚举驱动文件
+    * 函数参数：
+    *    [IN]  const std::string& strVMName：虚拟机名称（驱动缓存的引用）
+    *    [IN]  const std::string& strGPUName：GPU名称
+    *    [IN]  const std::string& strVolumeRoot：虚拟机系统卷的挂载点目录，离线写入时为虚拟机磁盘文件路径
+    *    [IN]  NtfsWriter* pImage：离线写入镜像的写入器（nullptr表示写入已挂载的卷）
+    *    [IN]  ProgressCallback callback：进度回调函数
+    *    [OUT] std::string& strError：复制或验证的警告信息
+    * 返回类型：bool
+    *    部分文件复制失败或虚拟机中的文件被修改只作为警告，返回true；
+    *    本次写入的文件校验不一致（复制不完整）、关键驱动文件缺失或离线写入的
+    *    提交失败（卷保持"需要检查"标记）时返回false
+    * 注意事项：
+    *    - 离线写入时在验证前提交写入器，验证通过重新打开的NtfsVolume回读镜像
+    *********************************************************************************/
+    static bool CopyDriversToVolume(
+        const std::string& strVMName,
+        const std::string& strGPUName,
+        const std::string& strVolumeRoot,
+        NtfsWriter* pImage,
         ProgressCallback callback,
         std::string& strError
     );
@@ -248,12 +290,12 @@ private:
     
     /********************************************************************************
     * 函数名称：挂载虚拟机磁盘（内部方法）
-    * 函数功能：挂载虚拟机的虚拟磁盘并返回系统盘符
+    * 函数功能：挂载虚拟机的虚拟磁盘，系统分区挂载到MountRegistry分配的目录
     * 函数参数：
     *    [IN]  const std::string& strVMName：虚拟机名称
     *    [OUT] std::string& strError：错误信息
     * 返回类型：std::string
-    *    系统盘符（如"C:"），失败返回空字符串
+    *    挂载点目录（如"C:\ProgramData\Smart-GPU-PV\Mounts\Win11-1234-0"），失败返回空字符串
     *********************************************************************************/
     static std::string MountVMDisk(const std::string& strVMName, std::string& strError);
     
@@ -273,14 +315,35 @@ private:
     * 函数功能：递归复制驱动文件夹到虚拟机
     * 函数参数：
     *    [IN]  const std::string& strSourcePath：源文件夹路径
-    *    [IN]  const std::string& strDriveLetter：目标驱动器号
+    *    [IN]  const std::string& strVolumeRoot：虚拟机系统卷的根目录
     *    [OUT] std::string& strError：错误信息
     * 返回类型：bool
     *    成功返回true，失败返回false
     *********************************************************************************/
     static bool CopyDriverFolder(
         const std::string& strSourcePath,
-        const std::string& strDriveLetter,
+        const std::string& strVolumeRoot,
+        std::string& strError
+    );
+
+    /********************************************************************************
+    * 函数名称：从主机驱动目录复制（内部方法）
+    * 函数功能：枚举并复制GPU服务驱动、PnP驱动文件和NVIDIA特殊文件（驱动缓存
+    *           未命中时使用）
+    * 函数参数：
+    *    [IN]  const std::string& strGPUName：GPU名称
+    *    [IN]  const std::string& strVolumeRoot：虚拟机系统卷的根目录
+    *    [IN]  DriverManifest& objManifest：增量同步清单
+    *    [IN]  ProgressCallback callback：进度回调
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    所有步骤成功返回true
+    *********************************************************************************/
+    static bool CopyFromHostDriverStore(
+        const std::string& strGPUName,
+        const std::string& strVolumeRoot,
+        DriverManifest& objManifest,
+        ProgressCallback callback,
         std::string& strError
     );
 
@@ -289,7 +352,8 @@ private:
     * 函数功能：获取GPU服务关联的驱动目录并拷贝到虚拟机
     * 函数参数：
     *    [IN]  const std::string& strGPUName：GPU名称
-    *    [IN]  const std::string& strDriveLetter：目标驱动器号
+    *    [IN]  const std::string& strVolumeRoot：虚拟机系统卷的根目录
+    *    [IN]  DriverManifest& objManifest：增量同步清单
     *    [IN]  ProgressCallback callback：进度回调
     *    [OUT] std::string& strError：错误信息
     * 返回类型：bool
@@ -297,7 +361,8 @@ private:
     *********************************************************************************/
     static bool CopyGPUServiceDriver(
         const std::string& strGPUName,
-        const std::string& strDriveLetter,
+        const std::string& strVolumeRoot,
+        DriverManifest& objManifest,
         ProgressCallback callback,
         std::string& strError
     );
@@ -307,7 +372,8 @@ private:
     * 函数功能：遍历并拷贝所有与GPU关联的PnP驱动文件
     * 函数参数：
     *    [IN]  const std::string& strGPUName：GPU名称
-    *    [IN]  const std::string& strDriveLetter：目标驱动器号
+    *    [IN]  const std::string& strVolumeRoot：虚拟机系统卷的根目录
+    *    [IN]  DriverManifest& objManifest：增量同步清单
     *    [IN]  ProgressCallback callback：进度回调
     *    [OUT] std::string& strError：错误信息
     * 返回类型：bool
@@ -315,7 +381,8 @@ private:
     *********************************************************************************/
     static bool CopyPnPDriverFiles(
         const std::string& strGPUName,
-        const std::string& strDriveLetter,
+        const std::string& strVolumeRoot,
+        DriverManifest& objManifest,
         ProgressCallback callback,
         std::string& strError
     );
@@ -325,7 +392,8 @@ private:
     * 函数功能：为NVIDIA显卡拷贝特殊的Corporation目录
     * 函数参数：
     *    [IN]  const std::string& strGPUName：GPU名称
-    *    [IN]  const std::string& strDriveLetter：目标驱动器号
+    *    [IN]  const std::string& strVolumeRoot：虚拟机系统卷的根目录
+    *    [IN]  DriverManifest& objManifest：增量同步清单
     *    [IN]  ProgressCallback callback：进度回调
     *    [OUT] std::string& strError：错误信息
     * 返回类型：bool
@@ -333,7 +401,8 @@ private:
     *********************************************************************************/
     static bool CopyNvidiaSpecialFiles(
         const std::string& strGPUName,
-        const std::string& strDriveLetter,
+        const std::string& strVolumeRoot,
+        DriverManifest& objManifest,
         ProgressCallback callback,
         std::string& strError
     );
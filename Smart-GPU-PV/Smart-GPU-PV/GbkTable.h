@@ -0,0 +1,26 @@
+﻿/********************************************************************************
+* 文件名称：GbkTable.h
+* 文件功能：GBK双字节编码到Unicode的映射表
+*
+* 说明：
+*    Utils::RepairString用这张表把PowerShell输出中的GBK片段转换为UTF-8，
+*    不依赖Windows的代码页936，在各平台上行为一致。
+*    表按首字节0x81~0xFE、尾字节0x40~0xFE排列（尾字节0x7F的位置为0），
+*    值为0表示该组合没有映射。单字节0x80按代码页936映射为U+20AC。
+*    GbkTable.cpp由tools/gen_gbk_table.py生成。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <cstdint>
+
+constexpr unsigned GBK_LEAD_FIRST = 0x81;     // 首字节下界
+constexpr unsigned GBK_LEAD_COUNT = 0xFE - 0x81 + 1;
+constexpr unsigned GBK_TRAIL_FIRST = 0x40;    // 尾字节下界
+constexpr unsigned GBK_TRAIL_COUNT = 0xFE - 0x40 + 1;
+
+// GBK_TO_UNICODE[(首字节 - 0x81) * GBK_TRAIL_COUNT + (尾字节 - 0x40)]
+extern const uint16_t GBK_TO_UNICODE[GBK_LEAD_COUNT * GBK_TRAIL_COUNT];
@@ -0,0 +1,460 @@
+﻿/********************************************************************************
+* 文件名称：JsonReader.cpp
+* 文件功能：实现单遍JSON解析器及到结构体的类型化映射
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "JsonReader.h"
+#include <charconv>
+#include <new>
+
+/********************************************************************************
+* 函数实现：分配内存
+*********************************************************************************/
+void* JsonArena::Allocate(size_t nBytes, size_t nAlign) {
+    // 1. 当前块中按对齐要求取出空间
+    size_t nPadding = m_pCurrent ? (nAlign - reinterpret_cast<uintptr_t>(m_pCurrent) % nAlign) % nAlign : 0;
+    if (!m_pCurrent || nPadding + nBytes > m_nRemaining) {
+        // 2. 空间不足时分配新块（超大请求单独成块）
+        size_t nBlockSize = (nBytes + nAlign > BLOCK_SIZE) ? nBytes + nAlign : BLOCK_SIZE;
+        m_vecBlocks.push_back(std::make_unique<char[]>(nBlockSize));
+        m_pCurrent = m_vecBlocks.back().get();
+        m_nRemaining = nBlockSize;
+        nPadding = (nAlign - reinterpret_cast<uintptr_t>(m_pCurrent) % nAlign) % nAlign;
+    }
+    void* pResult = m_pCurrent + nPadding;
+    m_pCurrent += nPadding + nBytes;
+    m_nRemaining -= nPadding + nBytes;
+    return pResult;
+}
+
+/********************************************************************************
+* 函数实现：释放全部内存
+*********************************************************************************/
+void JsonArena::Reset() {
+    m_vecBlocks.clear();
+    m_pCurrent = nullptr;
+    m_nRemaining = 0;
+}
+
+/********************************************************************************
+* 函数实现：码点编码为UTF-8（内部辅助）
+*********************************************************************************/
+static void AppendUtf8(std::string& strOut, uint32_t uCode) {
+    if (uCode < 0x80) {
+        strOut += static_cast<char>(uCode);
+    } else if (uCode < 0x800) {
+        strOut += static_cast<char>(0xC0 | (uCode >> 6));
+        strOut += static_cast<char>(0x80 | (uCode & 0x3F));
+    } else if (uCode < 0x10000) {
+        strOut += static_cast<char>(0xE0 | (uCode >> 12));
+        strOut += static_cast<char>(0x80 | ((uCode >> 6) & 0x3F));
+        strOut += static_cast<char>(0x80 | (uCode & 0x3F));
+    } else {
+        strOut += static_cast<char>(0xF0 | (uCode >> 18));
+        strOut += static_cast<char>(0x80 | ((uCode >> 12) & 0x3F));
+        strOut += static_cast<char>(0x80 | ((uCode >> 6) & 0x3F));
+        strOut += static_cast<char>(0x80 | (uCode & 0x3F));
+    }
+}
+
+/********************************************************************************
+* 函数实现：解析4位十六进制数（内部辅助）
+*********************************************************************************/
+static bool ParseHex4(std::string_view svText, size_t nPos, uint32_t& uValue) {
+    if (nPos + 4 > svText.size()) {
+        return false;
+    }
+    uValue = 0;
+    for (size_t i = nPos; i < nPos + 4; i++) {
+        char c = svText[i];
+        uValue <<= 4;
+        if (c >= '0' && c <= '9')      uValue |= c - '0';
+        else if (c >= 'a' && c <= 'f') uValue |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') uValue |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：JSON字符串反转义（内部辅助，输入已通过解析器检查）
+*********************************************************************************/
+static std::string Unescape(std::string_view svText) {
+    std::string strResult;
+    strResult.reserve(svText.size());
+    for (size_t i = 0; i < svText.size(); i++) {
+        // 转义序列之间的普通字符整段复制
+        size_t nEscape = svText.find('\\', i);
+        if (nEscape == std::string_view::npos || nEscape + 1 >= svText.size()) {
+            strResult.append(svText.data() + i, svText.size() - i);
+            break;
+        }
+        strResult.append(svText.data() + i, nEscape - i);
+        i = nEscape + 1;
+        char cNext = svText[i];
+        switch (cNext) {
+            case 'b': strResult += '\b'; break;
+            case 'f': strResult += '\f'; break;
+            case 'n': strResult += '\n'; break;
+            case 'r': strResult += '\r'; break;
+            case 't': strResult += '\t'; break;
+            case 'u': {
+                // \uXXXX，代理对组合为一个码点，孤立的代理替换为U+FFFD
+                uint32_t uCode = 0;
+                if (!ParseHex4(svText, i + 1, uCode)) {
+                    break;
+                }
+                i += 4;
+                if (uCode >= 0xD800 && uCode <= 0xDBFF) {
+                    uint32_t uLow = 0;
+                    if (i + 2 < svText.size() && svText[i + 1] == '\\' && svText[i + 2] == 'u' &&
+                        ParseHex4(svText, i + 3, uLow) && uLow >= 0xDC00 && uLow <= 0xDFFF) {
+                        uCode = 0x10000 + ((uCode - 0xD800) << 10) + (uLow - 0xDC00);
+                        i += 6;
+                    } else {
+                        uCode = 0xFFFD;
+                    }
+                } else if (uCode >= 0xDC00 && uCode <= 0xDFFF) {
+                    uCode = 0xFFFD;
+                }
+                AppendUtf8(strResult, uCode);
+                break;
+            }
+            default: strResult += cNext; break;   // \" \\ \/
+        }
+    }
+    return strResult;
+}
+
+/********************************************************************************
+* 类名称：JSON解析器（内部辅助）
+* 类功能：递归下降，节点从分配器中取得，字符串和数字引用源文本
+*********************************************************************************/
+class JsonParser {
+public:
+    JsonParser(std::string_view svJson, JsonArena& objArena)
+        : m_svJson(svJson), m_objArena(objArena) {}
+
+    JsonValue* ParseRoot(std::string& strError) {
+        SkipWhitespace();
+        JsonValue* pRoot = ParseValue(0);
+        if (!pRoot) {
+            strError = m_strError + "（位置 " + std::to_string(m_nPos) + "）";
+        }
+        return pRoot;
+    }
+
+private:
+    std::string_view  m_svJson;
+    JsonArena&        m_objArena;
+    size_t            m_nPos = 0;
+    std::string       m_strError;
+
+    JsonValue* NewValue(JsonType eType) {
+        JsonValue* pValue = new (m_objArena.Allocate(sizeof(JsonValue), alignof(JsonValue))) JsonValue();
+        pValue->eType = eType;
+        return pValue;
+    }
+
+    JsonValue* Fail(const char* pszMessage) {
+        m_strError = pszMessage;
+        return nullptr;
+    }
+
+    void SkipWhitespace() {
+        while (m_nPos < m_svJson.size()) {
+            char c = m_svJson[m_nPos];
+            if (c != ' ' && c != '\t' && c != '\r' && c != '\n') break;
+            m_nPos++;
+        }
+    }
+
+    bool ConsumeLiteral(std::string_view svLiteral) {
+        if (m_svJson.substr(m_nPos, svLiteral.size()) != svLiteral) {
+            return false;
+        }
+        m_nPos += svLiteral.size();
+        return true;
+    }
+
+    // 扫描字符串（m_nPos指向开头的引号），返回不含引号的源文本
+    bool ScanString(std::string_view& svText, bool& bEscaped) {
+        size_t nStart = ++m_nPos;
+        bEscaped = false;
+        while (m_nPos < m_svJson.size()) {
+            unsigned char c = static_cast<unsigned char>(m_svJson[m_nPos]);
+            if (c == '"') {
+                svText = m_svJson.substr(nStart, m_nPos - nStart);
+                m_nPos++;
+                return true;
+            }
+            if (c == '\\') {
+                bEscaped = true;
+                if (m_nPos + 1 >= m_svJson.size()) break;
+                char cNext = m_svJson[m_nPos + 1];
+                if (cNext == 'u') {
+                    uint32_t uCode = 0;
+                    if (!ParseHex4(m_svJson, m_nPos + 2, uCode)) {
+                        m_strError = "无效的\\u转义";
+                        return false;
+                    }
+                    m_nPos += 6;
+                    continue;
+                }
+                if (std::string_view("\"\\/bfnrt").find(cNext) == std::string_view::npos) {
+                    m_strError = "无效的转义字符";
+                    return false;
+                }
+                m_nPos += 2;
+                continue;
+            }
+            if (c < 0x20) {
+                m_strError = "字符串中含有控制字符";
+                return false;
+            }
+            m_nPos++;
+        }
+        m_strError = "字符串未结束";
+        return false;
+    }
+
+    JsonValue* ParseNumber() {
+        size_t nStart = m_nPos;
+        auto skipDigits = [&]() {
+            size_t nBegin = m_nPos;
+            while (m_nPos < m_svJson.size() && m_svJson[m_nPos] >= '0' && m_svJson[m_nPos] <= '9') m_nPos++;
+            return m_nPos > nBegin;
+        };
+        if (m_svJson[m_nPos] == '-') m_nPos++;
+        size_t nIntStart = m_nPos;
+        if (!skipDigits()) return Fail("无效的数字");
+        if (m_svJson[nIntStart] == '0' && m_nPos - nIntStart > 1) return Fail("数字不能以0开头");
+        if (m_nPos < m_svJson.size() && m_svJson[m_nPos] == '.') {
+            m_nPos++;
+            if (!skipDigits()) return Fail("无效的数字");
+        }
+        if (m_nPos < m_svJson.size() && (m_svJson[m_nPos] == 'e' || m_svJson[m_nPos] == 'E')) {
+            m_nPos++;
+            if (m_nPos < m_svJson.size() && (m_svJson[m_nPos] == '+' || m_svJson[m_nPos] == '-')) m_nPos++;
+            if (!skipDigits()) return Fail("无效的数字");
+        }
+        JsonValue* pValue = NewValue(JsonType::Number);
+        pValue->svText = m_svJson.substr(nStart, m_nPos - nStart);
+        return pValue;
+    }
+
+    JsonValue* ParseValue(int nDepth) {
+        if (m_nPos >= m_svJson.size()) {
+            return Fail("意外的输入结束");
+        }
+        char c = m_svJson[m_nPos];
+        switch (c) {
+            case '{':
+            case '[':
+                if (nDepth >= JsonDocument::MAX_DEPTH) {
+                    return Fail("嵌套层数过深");
+                }
+                return (c == '{') ? ParseObject(nDepth + 1) : ParseArray(nDepth + 1);
+            case '"': {
+                JsonValue* pValue = NewValue(JsonType::String);
+                if (!ScanString(pValue->svText, pValue->bEscaped)) return nullptr;
+                return pValue;
+            }
+            case 't':
+            case 'f': {
+                size_t nStart = m_nPos;
+                if (!ConsumeLiteral("true") && !ConsumeLiteral("false")) return Fail("无效的字面量");
+                JsonValue* pValue = NewValue(JsonType::Bool);
+                pValue->svText = m_svJson.substr(nStart, m_nPos - nStart);
+                return pValue;
+            }
+            case 'n':
+                if (!ConsumeLiteral("null")) return Fail("无效的字面量");
+                return NewValue(JsonType::Null);
+            default:
+                if (c == '-' || (c >= '0' && c <= '9')) {
+                    return ParseNumber();
+                }
+                return Fail("意外的字符");
+        }
+    }
+
+    JsonValue* ParseArray(int nDepth) {
+        JsonValue* pArray = NewValue(JsonType::Array);
+        JsonValue** ppTail = &pArray->pFirstChild;
+        m_nPos++;
+        SkipWhitespace();
+        if (m_nPos < m_svJson.size() && m_svJson[m_nPos] == ']') {
+            m_nPos++;
+            return pArray;
+        }
+        while (true) {
+            SkipWhitespace();
+            JsonValue* pItem = ParseValue(nDepth);
+            if (!pItem) return nullptr;
+            *ppTail = pItem;
+            ppTail = &pItem->pNext;
+            pArray->nChildren++;
+
+            SkipWhitespace();
+            if (m_nPos >= m_svJson.size()) return Fail("数组未结束");
+            if (m_svJson[m_nPos] == ',') { m_nPos++; continue; }
+            if (m_svJson[m_nPos] == ']') { m_nPos++; return pArray; }
+            return Fail("数组中缺少','或']'");
+        }
+    }
+
+    JsonValue* ParseObject(int nDepth) {
+        JsonValue* pObject = NewValue(JsonType::Object);
+        JsonValue** ppTail = &pObject->pFirstChild;
+        m_nPos++;
+        SkipWhitespace();
+        if (m_nPos < m_svJson.size() && m_svJson[m_nPos] == '}') {
+            m_nPos++;
+            return pObject;
+        }
+        while (true) {
+            // 1. 键
+            SkipWhitespace();
+            if (m_nPos >= m_svJson.size() || m_svJson[m_nPos] != '"') return Fail("对象中缺少键");
+            std::string_view svKey;
+            bool bKeyEscaped = false;
+            if (!ScanString(svKey, bKeyEscaped)) return nullptr;
+
+            // 2. 冒号和值
+            SkipWhitespace();
+            if (m_nPos >= m_svJson.size() || m_svJson[m_nPos] != ':') return Fail("对象中缺少':'");
+            m_nPos++;
+            SkipWhitespace();
+            JsonValue* pMember = ParseValue(nDepth);
+            if (!pMember) return nullptr;
+            pMember->svKey = svKey;
+            pMember->bKeyEscaped = bKeyEscaped;
+            *ppTail = pMember;
+            ppTail = &pMember->pNext;
+            pObject->nChildren++;
+
+            // 3. 分隔符
+            SkipWhitespace();
+            if (m_nPos >= m_svJson.size()) return Fail("对象未结束");
+            if (m_svJson[m_nPos] == ',') { m_nPos++; continue; }
+            if (m_svJson[m_nPos] == '}') { m_nPos++; return pObject; }
+            return Fail("对象中缺少','或'}'");
+        }
+    }
+};
+
+/********************************************************************************
+* 函数实现：取字符串值
+*********************************************************************************/
+std::string JsonValue::AsString() const {
+    switch (eType) {
+        case JsonType::String:
+            return bEscaped ? Unescape(svText) : std::string(svText);
+        case JsonType::Number:
+        case JsonType::Bool:
+            return std::string(svText);
+        default:
+            return std::string();
+    }
+}
+
+/********************************************************************************
+* 函数实现：取无符号整数值
+*********************************************************************************/
+bool JsonValue::AsUInt64(uint64_t& ui64Value) const {
+    if (eType != JsonType::Number && eType != JsonType::String) {
+        return false;
+    }
+    const char* pBegin = svText.data();
+    const char* pEnd = svText.data() + svText.size();
+    uint64_t ui64Parsed = 0;
+    auto stcResult = std::from_chars(pBegin, pEnd, ui64Parsed);
+    if (stcResult.ec != std::errc() || stcResult.ptr != pEnd) {
+        return false;
+    }
+    ui64Value = ui64Parsed;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：取布尔值
+*********************************************************************************/
+bool JsonValue::AsBool(bool& bValue) const {
+    if (eType != JsonType::Bool && eType != JsonType::String) {
+        return false;
+    }
+    if (svText == "true" || svText == "True") {
+        bValue = true;
+        return true;
+    }
+    if (svText == "false" || svText == "False") {
+        bValue = false;
+        return true;
+    }
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：比较键名
+*********************************************************************************/
+bool JsonValue::KeyEquals(std::string_view svName) const {
+    return bKeyEscaped ? Unescape(svKey) == svName : svKey == svName;
+}
+
+/********************************************************************************
+* 函数实现：查找对象成员
+*********************************************************************************/
+const JsonValue* JsonValue::Find(std::string_view svName) const {
+    if (eType != JsonType::Object) {
+        return nullptr;
+    }
+    for (const JsonValue* pMember = pFirstChild; pMember; pMember = pMember->pNext) {
+        if (pMember->KeyEquals(svName)) {
+            return pMember;
+        }
+    }
+    return nullptr;
+}
+
+/********************************************************************************
+* 函数实现：解析
+*********************************************************************************/
+bool JsonDocument::Parse(std::string_view svJson, std::string& strError) {
+    // 1. 重新解析时释放之前的节点
+    m_pRoot = nullptr;
+    m_objArena.Reset();
+
+    // 2. 跳过可能存在的UTF-8 BOM
+    if (svJson.size() >= 3 && svJson.substr(0, 3) == "\xEF\xBB\xBF") {
+        svJson.remove_prefix(3);
+    }
+
+    // 3. 单遍解析
+    JsonParser objParser(svJson, m_objArena);
+    m_pRoot = objParser.ParseRoot(strError);
+    return m_pRoot != nullptr;
+}
+
+/********************************************************************************
+* 函数实现：字段赋值（内部辅助）
+*********************************************************************************/
+void JsonDocument::AssignField(const JsonValue& stcValue, std::string& strTarget) {
+    strTarget = stcValue.AsString();
+}
+
+void JsonDocument::AssignField(const JsonValue& stcValue, uint64_t& ui64Target) {
+    if (!stcValue.AsUInt64(ui64Target)) {
+        ui64Target = 0;
+    }
+}
+
+void JsonDocument::AssignField(const JsonValue& stcValue, bool& bTarget) {
+    if (!stcValue.AsBool(bTarget)) {
+        bTarget = false;
+    }
+}
@@ -0,0 +1,267 @@
+﻿/********************************************************************************
+* 文件名称：JsonReader.h
+* 文件功能：单遍JSON解析器及到结构体的类型化映射
+*
+* 类说明：
+*    Utils::ExtractJsonValue每提取一个键都要重新扫描整个字符串，
+*    VMManager过去按下一个'}'切分对象，遇到嵌套对象即出错，复杂度为
+*    O(对象数 × 键数 × 长度)。JsonDocument对输入只扫描一遍：
+*    - 节点从JsonArena中按块分配，整个文档一次释放
+*    - 字符串和数字以std::string_view引用源文本，只有取值时才反转义
+*    - JsonFields<T>以编译期字段描述（键名 + 成员指针）把对象直接映射到
+*      结构体，每个对象成员只比较一次键名
+*
+* 使用说明：
+*    - JsonDocument引用源文本，源字符串必须比文档（及其节点）存活更久
+*    - PowerShell的ConvertTo-Json对单个对象不输出数组，MapList对根为对象
+*      或数组的情况统一处理
+*
+* 依赖项：
+*    - 标准C++库（string_view、charconv、tuple）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <tuple>
+#include <cstdint>
+
+/********************************************************************************
+* 类名称：JSON节点分配器
+* 类功能：按块分配节点，文档销毁时整体释放（节点不单独析构）
+*********************************************************************************/
+class JsonArena {
+public:
+    JsonArena() = default;
+    JsonArena(const JsonArena&) = delete;
+    JsonArena& operator=(const JsonArena&) = delete;
+
+    /********************************************************************************
+    * 函数名称：分配内存
+    * 函数参数：
+    *    [IN]  size_t nBytes：字节数
+    *    [IN]  size_t nAlign：对齐（2的幂）
+    * 返回类型：void*
+    *    分配的内存，生命周期与分配器相同
+    *********************************************************************************/
+    void* Allocate(size_t nBytes, size_t nAlign);
+
+    /********************************************************************************
+    * 函数名称：释放全部内存
+    *********************************************************************************/
+    void Reset();
+
+    // 每块的默认大小（字节）
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+private:
+    std::vector<std::unique_ptr<char[]>> m_vecBlocks;     // 已分配的块
+    char*                                m_pCurrent = nullptr;  // 当前块的空闲位置
+    size_t                               m_nRemaining = 0;      // 当前块的剩余字节数
+};
+
+/********************************************************************************
+* 枚举名称：JSON值类型
+*********************************************************************************/
+enum class JsonType {
+    Null,
+    Bool,
+    Number,
+    String,
+    Array,
+    Object
+};
+
+/********************************************************************************
+* 结构体名称：JSON值
+* 结构体功能：文档树中的一个节点，数组元素和对象成员以单向链表连接
+*********************************************************************************/
+struct JsonValue {
+    JsonType          eType = JsonType::Null;
+    std::string_view  svKey;                  // 对象成员的键（源文本，不含引号）
+    std::string_view  svText;                 // 字符串（不含引号，未反转义）、数字或true/false的源文本
+    bool              bKeyEscaped = false;    // 键中含有转义序列
+    bool              bEscaped = false;       // 字符串中含有转义序列
+    uint32_t          nChildren = 0;          // 数组元素或对象成员的个数
+    JsonValue*        pFirstChild = nullptr;  // 第一个元素或成员
+    JsonValue*        pNext = nullptr;        // 下一个兄弟节点
+
+    /********************************************************************************
+    * 函数名称：取字符串值
+    * 返回类型：std::string
+    *    字符串反转义后的UTF-8文本；数字和布尔值返回源文本；null、数组和
+    *    对象返回空字符串
+    *********************************************************************************/
+    std::string AsString() const;
+
+    /********************************************************************************
+    * 函数名称：取无符号整数值
+    * 函数参数：
+    *    [OUT] uint64_t& ui64Value：解析结果
+    * 返回类型：bool
+    *    值为非负整数（或内容为非负整数的字符串）时返回true
+    *********************************************************************************/
+    bool AsUInt64(uint64_t& ui64Value) const;
+
+    /********************************************************************************
+    * 函数名称：取布尔值
+    * 函数参数：
+    *    [OUT] bool& bValue：解析结果
+    * 返回类型：bool
+    *    值为true/false（或内容为"True"/"False"的字符串）时返回true
+    *********************************************************************************/
+    bool AsBool(bool& bValue) const;
+
+    /********************************************************************************
+    * 函数名称：比较键名
+    * 函数参数：
+    *    [IN]  std::string_view svName：键名（不含转义）
+    * 返回类型：bool
+    *********************************************************************************/
+    bool KeyEquals(std::string_view svName) const;
+
+    /********************************************************************************
+    * 函数名称：查找对象成员
+    * 函数参数：
+    *    [IN]  std::string_view svName：键名
+    * 返回类型：const JsonValue*
+    *    找到的成员，不是对象或没有该键时返回nullptr
+    *********************************************************************************/
+    const JsonValue* Find(std::string_view svName) const;
+};
+
+/********************************************************************************
+* 结构体名称：字段描述
+* 结构体功能：JSON键名与结构体成员的对应关系，由MakeJsonField生成
+*********************************************************************************/
+template <typename T, typename TMember>
+struct JsonField {
+    std::string_view  svKey;     // JSON键名
+    TMember T::*      pMember;   // 结构体成员
+};
+
+template <typename T, typename TMember>
+constexpr JsonField<T, TMember> MakeJsonField(std::string_view svKey, TMember T::* pMember) {
+    return JsonField<T, TMember>{ svKey, pMember };
+}
+
+/********************************************************************************
+* 结构体名称：结构体字段表
+* 结构体功能：为需要从JSON映射的结构体特化，提供Fields元组
+*
+* 调用示例：
+*    template <>
+*    struct JsonFields<VMInfo> {
+*        static constexpr auto Fields = std::make_tuple(
+*            MakeJsonField("Name", &VMInfo::strName),
+*            MakeJsonField("VRAM", &VMInfo::ui64VramBytes));
+*    };
+* 注意事项：
+*    - 成员类型支持std::string、uint64_t、bool，其他类型无法编译
+*    - 特化放在结构体所在的头文件中，基准测试和调用者使用同一份字段表
+*********************************************************************************/
+template <typename T>
+struct JsonFields;
+
+/********************************************************************************
+* 类名称：JSON文档
+* 类功能：解析JSON文本并映射到结构体
+*
+* 调用示例：
+*    JsonDocument objDocument;
+*    std::vector<VMInfo> vecVMs;
+*    std::string strError;
+*    if (objDocument.Parse(strOutput, strError)) {
+*        objDocument.MapList(vecVMs);
+*    }
+*********************************************************************************/
+class JsonDocument {
+public:
+    JsonDocument() = default;
+    JsonDocument(const JsonDocument&) = delete;
+    JsonDocument& operator=(const JsonDocument&) = delete;
+
+    /********************************************************************************
+    * 函数名称：解析
+    * 函数参数：
+    *    [IN]  std::string_view svJson：JSON文本（必须比文档存活更久）
+    *    [OUT] std::string& strError：失败时的错误信息（含出错位置）
+    * 返回类型：bool
+    *    解析成功返回true
+    * 注意事项：
+    *    - 解析第一个完整的JSON值，其后的空白以外的内容被忽略
+    *    - 嵌套深度超过MAX_DEPTH时失败
+    *********************************************************************************/
+    bool Parse(std::string_view svJson, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：取根节点
+    * 返回类型：const JsonValue*
+    *    解析成功后的根节点；未解析或解析失败时返回nullptr
+    *********************************************************************************/
+    const JsonValue* Root() const { return m_pRoot; }
+
+    /********************************************************************************
+    * 函数名称：映射对象
+    * 函数功能：按JsonFields<T>把对象的成员写入结构体（不认识的键被忽略）
+    * 函数参数：
+    *    [IN]  const JsonValue& stcObject：对象节点（不是对象时不做任何事）
+    *    [OUT] T& objTarget：目标结构体
+    *********************************************************************************/
+    template <typename T>
+    static void MapObject(const JsonValue& stcObject, T& objTarget) {
+        if (stcObject.eType != JsonType::Object) {
+            return;
+        }
+        for (const JsonValue* pMember = stcObject.pFirstChild; pMember; pMember = pMember->pNext) {
+            std::apply([&](const auto&... stcFields) {
+                (void)((pMember->KeyEquals(stcFields.svKey) &&
+                        (AssignField(*pMember, objTarget.*(stcFields.pMember)), true)) || ...);
+            }, JsonFields<T>::Fields);
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：映射列表
+    * 函数功能：根为数组时映射其中的每个对象，根为对象时映射为单个元素
+    * 函数参数：
+    *    [OUT] std::vector<T>& vecTargets：追加映射结果
+    *********************************************************************************/
+    template <typename T>
+    void MapList(std::vector<T>& vecTargets) const {
+        if (!m_pRoot) {
+            return;
+        }
+        if (m_pRoot->eType == JsonType::Object) {
+            vecTargets.emplace_back();
+            MapObject(*m_pRoot, vecTargets.back());
+            return;
+        }
+        if (m_pRoot->eType == JsonType::Array) {
+            vecTargets.reserve(vecTargets.size() + m_pRoot->nChildren);
+            for (const JsonValue* pItem = m_pRoot->pFirstChild; pItem; pItem = pItem->pNext) {
+                if (pItem->eType == JsonType::Object) {
+                    vecTargets.emplace_back();
+                    MapObject(*pItem, vecTargets.back());
+                }
+            }
+        }
+    }
+
+    // 最大嵌套深度
+    static const int MAX_DEPTH = 128;
+
+private:
+    JsonArena         m_objArena;           // 节点分配器
+    const JsonValue*  m_pRoot = nullptr;    // 根节点
+
+    static void AssignField(const JsonValue& stcValue, std::string& strTarget);
+    static void AssignField(const JsonValue& stcValue, uint64_t& ui64Target);
+    static void AssignField(const JsonValue& stcValue, bool& bTarget);
+};
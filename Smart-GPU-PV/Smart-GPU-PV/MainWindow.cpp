@@ -2,6 +2,8 @@
 #include "resource.h"
 #include "Utils.h"
 #include "GPUPVConfigurator.h"
+#include "QueryCache.h"
+#include "ExecutorTrace.h"
 #include <commctrl.h>
 
 // 构造函数
@@ -76,6 +78,7 @@ void MainWindow::OnInitDialog(HWND hDlg) {
 }
 
 void MainWindow::OnRefresh() {
+    ExecutorTrace::Scope traceScope("Refresh");
     AppendLog(L"正在刷新虚拟机和GPU列表...");
 
     // 获取虚拟机列表
@@ -98,6 +101,7 @@ void MainWindow::OnRefresh() {
     PopulateGPUComboBox();
 
     AppendLog(L"刷新完成");
+    LogQueryCacheStats();
     AppendLog(L"------------------------------------");
 }
 
@@ -221,6 +225,8 @@ void MainWindow::OnConfigure() {
 
     // 重新启用按钮
     EnableWindow(GetControl(IDC_BUTTON_CONFIGURE), TRUE);
+    LogQueryCacheStats();
+    LogExecutorTrace();
 
     if (success) {
         AppendLog(L"====================================");
@@ -282,6 +288,38 @@ void MainWindow::AppendLog(const std::wstring& message) {
     Utils::AppendLog(hLog, message);
 }
 
+// 输出查询缓存统计（命中次数即省去的PowerShell/WMI查询次数）
+void MainWindow::LogQueryCacheStats() {
+    QueryCache::Stats stats = QueryCache::Instance().GetStats();
+    AppendLog(L"查询缓存：命中 " + std::to_wstring(stats.ui64Hits) +
+              L" 次，未命中 " + std::to_wstring(stats.ui64Misses) + L" 次");
+}
+
+// 输出执行器耗时汇总（每个操作标签一行），完整记录写入%TEMP%下的Chrome trace文件
+void MainWindow::LogExecutorTrace() {
+    AppendLog(L"PowerShell调用耗时：");
+    std::string summary = ExecutorTrace::Summary();
+    size_t start = 0;
+    while (start < summary.size()) {
+        size_t end = summary.find('\n', start);
+        if (end == std::string::npos) end = summary.size();
+        AppendLog(L"  " + Utils::StringToWString(summary.substr(start, end - start)));
+        start = end + 1;
+    }
+
+    wchar_t tempPath[MAX_PATH] = { 0 };
+    if (GetTempPathW(MAX_PATH, tempPath) == 0) {
+        return;
+    }
+    std::string tracePath = Utils::WStringToString(tempPath) + "SmartGPUPV-trace.json";
+    std::string error;
+    if (ExecutorTrace::WriteChromeTrace(tracePath, error)) {
+        AppendLog(L"跟踪文件已写入: " + Utils::StringToWString(tracePath));
+    } else {
+        AppendLog(L"警告: " + Utils::StringToWString(error));
+    }
+}
+
 // 获取控件句柄
 HWND MainWindow::GetControl(int controlId) {
     return GetDlgItem(m_hDlg, controlId);
@@ -42,6 +42,12 @@ private:
     // 追加日志
     void AppendLog(const std::wstring& message);
     
+    // 输出查询缓存统计
+    void LogQueryCacheStats();
+    
+    // 输出执行器耗时汇总并写入Chrome trace文件
+    void LogExecutorTrace();
+    
     // 获取控件句柄
     HWND GetControl(int controlId);
     
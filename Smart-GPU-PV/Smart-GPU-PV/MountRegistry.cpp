@@ -0,0 +1,368 @@
+﻿/********************************************************************************
+* 文件名称：MountRegistry.cpp
+* 文件功能：实现目录挂载点的分配、释放和残留清理
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "MountRegistry.h"
+#include "Utils.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 挂载点目录名中虚拟机名称部分的最大长度
+static const size_t MAX_NAME_LENGTH = 32;
+
+// 分配挂载点时尝试的目录数（序号与残留目录冲突时换下一个）
+static const uint32_t MAX_ACQUIRE_ATTEMPTS = 64;
+
+//==============================================================================
+// 平台相关的进程和目录操作（内部辅助）
+//==============================================================================
+
+#ifdef _WIN32
+static std::filesystem::path LocalPath(const std::string& strPath) { return Utils::StringToWString(strPath); }
+static std::string FromPath(const std::filesystem::path& path) { return Utils::WStringToString(path.wstring()); }
+static uint32_t CurrentProcessId() { return GetCurrentProcessId(); }
+static int LastError() { return static_cast<int>(GetLastError()); }
+
+static std::filesystem::path DefaultRoot() {
+    wchar_t szProgramData[MAX_PATH] = { 0 };
+    DWORD dwLength = GetEnvironmentVariableW(L"ProgramData", szProgramData, MAX_PATH);
+    std::filesystem::path pathRoot = (dwLength > 0 && dwLength < MAX_PATH) ? szProgramData : L"C:\\ProgramData";
+    return pathRoot / L"Smart-GPU-PV" / L"Mounts";
+}
+
+// 进程创建时间（FILETIME）
+static uint64_t ProcessStartTime(HANDLE hProcess) {
+    FILETIME ftCreation = { 0 }, ftExit = { 0 }, ftKernel = { 0 }, ftUser = { 0 };
+    if (!GetProcessTimes(hProcess, &ftCreation, &ftExit, &ftKernel, &ftUser)) {
+        return 0;
+    }
+    return (static_cast<uint64_t>(ftCreation.dwHighDateTime) << 32) | ftCreation.dwLowDateTime;
+}
+
+static uint64_t CurrentProcessStartTime() { return ProcessStartTime(GetCurrentProcess()); }
+
+static bool IsProcessAlive(uint32_t ui32ProcessId, uint64_t ui64Started) {
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, ui32ProcessId);
+    if (hProcess == NULL) {
+        return GetLastError() == ERROR_ACCESS_DENIED;
+    }
+    DWORD dwExitCode = 0;
+    bool bAlive = GetExitCodeProcess(hProcess, &dwExitCode) && dwExitCode == STILL_ACTIVE &&
+                  ProcessStartTime(hProcess) == ui64Started;
+    CloseHandle(hProcess);
+    return bAlive;
+}
+
+// 创建目录：已存在时bExists为true
+static bool CreateMountDirectory(const std::filesystem::path& path, bool& bExists) {
+    bExists = false;
+    if (CreateDirectoryW(path.c_str(), NULL)) {
+        return true;
+    }
+    bExists = GetLastError() == ERROR_ALREADY_EXISTS;
+    return false;
+}
+
+static void DeleteLocalFile(const std::filesystem::path& path) { DeleteFileW(path.c_str()); }
+#else
+static std::filesystem::path LocalPath(const std::string& strPath) {
+    std::string strLocal(strPath);
+    std::replace(strLocal.begin(), strLocal.end(), '\\', '/');
+    return std::filesystem::path(strLocal);
+}
+
+static std::string FromPath(const std::filesystem::path& path) { return path.string(); }
+static uint32_t CurrentProcessId() { return static_cast<uint32_t>(getpid()); }
+static int LastError() { return errno; }
+
+static std::filesystem::path DefaultRoot() {
+    std::error_code ec;
+    return std::filesystem::temp_directory_path(ec) / "Smart-GPU-PV" / "Mounts";
+}
+
+// 进程启动时间（/proc/<pid>/stat的第22个字段，开机后的时钟滴答数），读取失败返回0
+static uint64_t ProcessStartTime(uint32_t ui32ProcessId) {
+    std::ifstream objFile("/proc/" + std::to_string(ui32ProcessId) + "/stat");
+    std::string strStat;
+    if (!std::getline(objFile, strStat)) {
+        return 0;
+    }
+    // 进程名可能含空格和括号，从最后一个')'之后按空格分隔（第3个字段开始）
+    size_t nPos = strStat.rfind(')');
+    if (nPos == std::string::npos) {
+        return 0;
+    }
+    std::string_view svRest = std::string_view(strStat).substr(nPos + 1);
+    for (int nField = 3; nField <= 22; nField++) {
+        svRest = Utils::TrimView(svRest);
+        size_t nSpace = svRest.find(' ');
+        std::string_view svField = svRest.substr(0, nSpace);
+        if (nField == 22) {
+            return std::strtoull(std::string(svField).c_str(), nullptr, 10);
+        }
+        if (nSpace == std::string_view::npos) {
+            return 0;
+        }
+        svRest.remove_prefix(nSpace + 1);
+    }
+    return 0;
+}
+
+static uint64_t CurrentProcessStartTime() { return ProcessStartTime(CurrentProcessId()); }
+
+static bool IsProcessAlive(uint32_t ui32ProcessId, uint64_t ui64Started) {
+    if (ui32ProcessId == 0 || (kill(static_cast<pid_t>(ui32ProcessId), 0) != 0 && errno != EPERM)) {
+        return false;
+    }
+    return ProcessStartTime(ui32ProcessId) == ui64Started;
+}
+
+static bool CreateMountDirectory(const std::filesystem::path& path, bool& bExists) {
+    bExists = false;
+    if (mkdir(path.c_str(), 0755) == 0) {
+        return true;
+    }
+    bExists = errno == EEXIST;
+    return false;
+}
+
+static void DeleteLocalFile(const std::filesystem::path& path) { unlink(path.c_str()); }
+#endif
+
+/********************************************************************************
+* 函数实现：所有者文件路径（内部辅助）
+*********************************************************************************/
+static std::filesystem::path OwnerPath(const std::filesystem::path& pathDirectory) {
+    std::filesystem::path pathOwner = pathDirectory;
+    pathOwner += ".owner";
+    return pathOwner;
+}
+
+/********************************************************************************
+* 函数实现：目录名中使用的虚拟机名称（内部辅助，只保留文件名安全的字符）
+*********************************************************************************/
+static std::string SafeName(const std::string& strVMName) {
+    std::string strName = strVMName.substr(0, MAX_NAME_LENGTH);
+    for (auto& ch : strName) {
+        bool bSafe = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+                     ch == '.' || ch == '-' || ch == '_';
+        if (!bSafe) {
+            ch = '_';
+        }
+    }
+    return strName.empty() ? "vm" : strName;
+}
+
+/********************************************************************************
+* 函数实现：获取全局实例
+*********************************************************************************/
+MountRegistry& MountRegistry::Instance() {
+    static MountRegistry s_objInstance;
+    return s_objInstance;
+}
+
+/********************************************************************************
+* 函数实现：构造函数
+*********************************************************************************/
+MountRegistry::MountRegistry(const std::string& strRoot)
+    : m_pathRoot(strRoot.empty() ? DefaultRoot() : LocalPath(strRoot)),
+      m_ui64Started(CurrentProcessStartTime()) {
+}
+
+/********************************************************************************
+* 函数实现：工作目录
+*********************************************************************************/
+std::string MountRegistry::Root() const {
+    return FromPath(m_pathRoot);
+}
+
+/********************************************************************************
+* 函数实现：分配挂载点
+*********************************************************************************/
+bool MountRegistry::Acquire(const std::string& strVMName, std::string& strMountPath, std::string& strError) {
+    std::lock_guard<std::mutex> lock(m_mtxMounts);
+    auto it = m_mapMounts.find(strVMName);
+    if (it != m_mapMounts.end()) {
+        // 上次释放时删除失败的挂载点：磁盘已不再使用，重试删除后再分配
+        if (!it->second.bReleasing) {
+            strError = "虚拟机磁盘已挂载到: " + FromPath(it->second.pathDirectory);
+            return false;
+        }
+        if (!RemoveMountPoint(it->second.pathDirectory)) {
+            strError = "上次的挂载点目录仍无法删除（错误码 " + std::to_string(LastError()) + "）: " +
+                       FromPath(it->second.pathDirectory);
+            return false;
+        }
+        DeleteLocalFile(OwnerPath(it->second.pathDirectory));
+        m_mapMounts.erase(it);
+    }
+
+    // 1. 确保工作目录存在
+    std::error_code ec;
+    std::filesystem::create_directories(m_pathRoot, ec);
+    if (ec) {
+        strError = "无法创建挂载工作目录: " + FromPath(m_pathRoot);
+        return false;
+    }
+
+    // 2. 依次尝试<名称>-<进程号>-<序号>，先写所有者文件，再创建目录
+    //    （任何时刻存在的挂载点目录都有所有者文件，启动清理不会误删正在使用的目录）
+    std::string strPrefix = SafeName(strVMName) + "-" + std::to_string(CurrentProcessId()) + "-";
+    for (uint32_t i = 0; i < MAX_ACQUIRE_ATTEMPTS; i++) {
+        std::filesystem::path pathDirectory = m_pathRoot / (strPrefix + std::to_string(m_ui32Next++));
+        std::filesystem::path pathOwner = OwnerPath(pathDirectory);
+        {
+            std::ofstream objFile{ pathOwner, std::ios::binary | std::ios::trunc };
+            objFile << CurrentProcessId() << " " << m_ui64Started << " " << strVMName << "\n";
+            if (!objFile.flush()) {
+                strError = "无法写入挂载点所有者文件: " + FromPath(pathOwner);
+                return false;
+            }
+        }
+        bool bExists = false;
+        if (CreateMountDirectory(pathDirectory, bExists)) {
+            m_mapMounts[strVMName] = { pathDirectory, false };
+            strMountPath = FromPath(pathDirectory);
+            return true;
+        }
+        if (!bExists) {
+            int nError = LastError();
+            DeleteLocalFile(pathOwner);
+            strError = "无法创建挂载点目录（错误码 " + std::to_string(nError) + "）: " + FromPath(pathDirectory);
+            return false;
+        }
+        // 进程号被复用且上次的目录未清理：保留它的所有者文件，换下一个序号
+    }
+    strError = "无法分配挂载点目录: " + FromPath(m_pathRoot);
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：释放挂载点
+*********************************************************************************/
+bool MountRegistry::Release(const std::string& strMountPath, std::string& strError) {
+    std::lock_guard<std::mutex> lock(m_mtxMounts);
+    std::filesystem::path pathDirectory = LocalPath(strMountPath);
+    auto it = m_mapMounts.begin();
+    while (it != m_mapMounts.end() && it->second.pathDirectory != pathDirectory) {
+        ++it;
+    }
+    if (it == m_mapMounts.end()) {
+        strError = "不是本程序分配的挂载点: " + strMountPath;
+        return false;
+    }
+
+    // 删除成功后才移出记录；失败时保留记录和所有者文件，再次释放或下次分配时重试
+    it->second.bReleasing = true;
+    if (!RemoveMountPoint(pathDirectory)) {
+        strError = "无法删除挂载点目录（错误码 " + std::to_string(LastError()) + "）: " + strMountPath;
+        return false;
+    }
+    DeleteLocalFile(OwnerPath(pathDirectory));
+    m_mapMounts.erase(it);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：查找挂载点
+*********************************************************************************/
+std::string MountRegistry::Find(const std::string& strVMName) const {
+    std::lock_guard<std::mutex> lock(m_mtxMounts);
+    auto it = m_mapMounts.find(strVMName);
+    return it == m_mapMounts.end() ? "" : FromPath(it->second.pathDirectory);
+}
+
+/********************************************************************************
+* 函数实现：清理残留挂载点
+*********************************************************************************/
+void MountRegistry::CleanupStale(size_t& nRemoved) {
+    std::lock_guard<std::mutex> lock(m_mtxMounts);
+    nRemoved = 0;
+
+    // 1. 列出工作目录中的挂载点目录和所有者文件（挂载点本身不跟随）
+    std::vector<std::filesystem::path> vecDirectories;
+    std::vector<std::filesystem::path> vecOwners;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(m_pathRoot, ec), itEnd; !ec && it != itEnd; it.increment(ec)) {
+        std::error_code ecEntry;
+        if (it->is_directory(ecEntry)) {
+            vecDirectories.push_back(it->path());
+        } else if (it->path().extension() == ".owner") {
+            vecOwners.push_back(it->path());
+        }
+    }
+
+    // 2. 所有者仍在运行的目录保留；其余（包括没有所有者文件的）删除挂载点和目录
+    for (const auto& pathDirectory : vecDirectories) {
+        std::filesystem::path pathOwner = OwnerPath(pathDirectory);
+        if (IsOwnerAlive(FromPath(pathOwner))) {
+            continue;
+        }
+        if (RemoveMountPoint(pathDirectory)) {
+            DeleteLocalFile(pathOwner);
+            nRemoved++;
+        }
+    }
+
+    // 3. 创建目录前中断留下的所有者文件
+    for (const auto& pathOwner : vecOwners) {
+        std::filesystem::path pathDirectory = pathOwner;
+        pathDirectory.replace_extension();
+        std::error_code ecExists;
+        if (!std::filesystem::exists(pathDirectory, ecExists) && !IsOwnerAlive(FromPath(pathOwner))) {
+            DeleteLocalFile(pathOwner);
+        }
+    }
+}
+
+/********************************************************************************
+* 函数实现：删除卷挂载点和目录（内部辅助）
+*********************************************************************************/
+bool MountRegistry::RemoveMountPoint(const std::filesystem::path& pathDirectory) {
+#ifdef _WIN32
+    // 1. 目录仍是挂载点时先删除挂载点（卷不会被卸载，只是不再能通过该目录访问）
+    DWORD dwAttributes = GetFileAttributesW(pathDirectory.c_str());
+    if (dwAttributes == INVALID_FILE_ATTRIBUTES) {
+        return true;
+    }
+    if (dwAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+        DeleteVolumeMountPointW((pathDirectory.wstring() + L"\\").c_str());
+    }
+
+    // 2. 删除空目录（卷已卸载的挂载点也可以直接删除）
+    return RemoveDirectoryW(pathDirectory.c_str()) != FALSE;
+#else
+    // 没有卷挂载点，只删除空目录
+    return rmdir(pathDirectory.c_str()) == 0 || errno == ENOENT;
+#endif
+}
+
+/********************************************************************************
+* 函数实现：所有者进程是否仍在运行
+*********************************************************************************/
+bool MountRegistry::IsOwnerAlive(const std::string& strOwnerFile) {
+    // 1. 读取进程号和进程创建时间，文件不存在或格式错误视为已退出
+    std::ifstream objFile{ LocalPath(strOwnerFile), std::ios::binary };
+    uint32_t ui32ProcessId = 0;
+    uint64_t ui64Started = 0;
+    if (!objFile || !(objFile >> ui32ProcessId >> ui64Started)) {
+        return false;
+    }
+
+    // 2. 进程号相同且创建时间相同才是同一个进程（进程号可能被复用）
+    return IsProcessAlive(ui32ProcessId, ui64Started);
+}
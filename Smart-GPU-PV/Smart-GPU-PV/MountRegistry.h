@@ -0,0 +1,141 @@
+﻿/********************************************************************************
+* 文件名称：MountRegistry.h
+* 文件功能：为挂载的虚拟机系统卷分配目录挂载点，记录所有者并清理残留挂载
+*
+* 类说明：
+*    MountVMDisk过去从Z到D扫描空闲盘符，同时最多挂载约20个卷，与其他工具
+*    争用盘符，多台虚拟机只能依次配置。现在系统卷挂载到工作目录下的唯一
+*    目录（NTFS挂载点），所有复制路径以该目录为根，不再受盘符数量限制：
+*    - Acquire：为虚拟机创建唯一的空目录，先写所有者文件再创建目录
+*    - Release：删除卷挂载点、目录和所有者文件（只释放本进程分配的挂载点）；
+*      删除失败时挂载点仍被跟踪，再次Release或同一虚拟机下次Acquire时重试
+*    - CleanupStale：启动时删除所有者进程已不存在的挂载点（上次异常退出时
+*      残留），残留的虚拟磁盘由下次挂载脚本卸载
+*
+* 目录结构（默认位于%ProgramData%\Smart-GPU-PV\Mounts）：
+*    <虚拟机名>-<进程号>-<序号>\          挂载点目录
+*    <虚拟机名>-<进程号>-<序号>.owner     所有者：进程号 进程创建时间 虚拟机名称
+*
+* 线程安全：
+*    所有方法都持有内部锁，可以从多个配置线程同时调用
+*
+* 依赖项：
+*    - Windows API（目录、卷挂载点、进程信息）；其他平台上以目录和/proc
+*      中的进程信息代替，只删除目录，用于测试分配、释放和清理的记录
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "Platform.h"
+#include <string>
+#include <map>
+#include <mutex>
+#include <filesystem>
+#include <cstdint>
+
+/********************************************************************************
+* 类名称：挂载点注册表
+* 类功能：分配、跟踪和清理虚拟机系统卷的目录挂载点
+*
+* 调用示例：
+*    std::string strMountPath, strError;
+*    if (MountRegistry::Instance().Acquire("Win11", strMountPath, strError)) {
+*        // 把系统卷挂载到strMountPath，复制到strMountPath + "\\Windows\\..."
+*        MountRegistry::Instance().Release(strMountPath, strError);
+*    }
+*********************************************************************************/
+class MountRegistry {
+public:
+    /********************************************************************************
+    * 函数名称：获取全局实例
+    * 返回类型：MountRegistry&
+    *    工作目录为默认位置的实例
+    *********************************************************************************/
+    static MountRegistry& Instance();
+
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  const std::string& strRoot：工作目录（UTF-8，空表示默认位置）
+    *********************************************************************************/
+    explicit MountRegistry(const std::string& strRoot = "");
+    MountRegistry(const MountRegistry&) = delete;
+    MountRegistry& operator=(const MountRegistry&) = delete;
+
+    /********************************************************************************
+    * 函数名称：分配挂载点
+    * 函数参数：
+    *    [IN]  const std::string& strVMName：虚拟机名称
+    *    [OUT] std::string& strMountPath：挂载点目录（UTF-8，不以'\'结尾）
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    * 注意事项：
+    *    - 同一虚拟机已有挂载点时返回失败（同一磁盘不能同时挂载两次）；
+    *      已有的挂载点是释放失败留下的时先重试删除，成功后再分配
+    *    - 目录必须为空才能作为挂载点，每次分配都创建新目录
+    *********************************************************************************/
+    bool Acquire(const std::string& strVMName, std::string& strMountPath, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：释放挂载点
+    * 函数功能：删除卷挂载点（卷本身不卸载），再删除目录和所有者文件
+    * 函数参数：
+    *    [IN]  const std::string& strMountPath：Acquire返回的挂载点目录
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    不是本进程分配的挂载点或目录删除失败返回false
+    * 注意事项：
+    *    - 删除失败时挂载点和所有者文件保留，Find仍返回该目录，可以再次释放
+    *********************************************************************************/
+    bool Release(const std::string& strMountPath, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：查找挂载点
+    * 返回类型：std::string
+    *    虚拟机当前的挂载点目录，没有时返回空字符串
+    *********************************************************************************/
+    std::string Find(const std::string& strVMName) const;
+
+    /********************************************************************************
+    * 函数名称：清理残留挂载点
+    * 函数功能：删除所有者进程已经退出的挂载点目录（以及没有所有者文件的目录）
+    * 函数参数：
+    *    [OUT] size_t& nRemoved：删除的挂载点数
+    * 注意事项：
+    *    - 程序启动时调用；其他正在运行的实例分配的挂载点保留
+    *********************************************************************************/
+    void CleanupStale(size_t& nRemoved);
+
+    /********************************************************************************
+    * 函数名称：所有者进程是否仍在运行
+    * 函数参数：
+    *    [IN]  const std::string& strOwnerFile：所有者文件（UTF-8）
+    * 返回类型：bool
+    *    进程号和进程创建时间都与文件中的记录一致返回true；文件不存在、
+    *    格式错误或进程号已被其他进程复用返回false
+    *********************************************************************************/
+    static bool IsOwnerAlive(const std::string& strOwnerFile);
+
+    // 工作目录（UTF-8）
+    std::string Root() const;
+
+private:
+    /********************************************************************************
+    * 结构体名称：本进程分配的挂载点
+    *********************************************************************************/
+    struct MountEntry {
+        std::filesystem::path pathDirectory;        // 挂载点目录
+        bool                  bReleasing = false;   // 已请求释放但删除失败
+    };
+
+    std::filesystem::path               m_pathRoot;     // 工作目录
+    uint64_t                            m_ui64Started;  // 本进程的创建时间（识别进程号复用）
+    uint32_t                            m_ui32Next = 0; // 下一个目录序号
+    mutable std::mutex                  m_mtxMounts;    // 保护以下状态
+    std::map<std::string, MountEntry>   m_mapMounts;    // 虚拟机名称 -> 本进程分配的挂载点
+
+    static bool RemoveMountPoint(const std::filesystem::path& pathDirectory);
+};
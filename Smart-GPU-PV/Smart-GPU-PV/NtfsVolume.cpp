@@ -0,0 +1,1143 @@
+﻿/********************************************************************************
+* 文件名称：NtfsVolume.cpp
+* 文件功能：实现只读的NTFS文件系统解析
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "NtfsVolume.h"
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <functional>
+#include <set>
+
+// 属性类型
+static const uint32_t ATTR_STANDARD_INFORMATION = 0x10;
+static const uint32_t ATTR_ATTRIBUTE_LIST = 0x20;
+static const uint32_t ATTR_FILE_NAME = 0x30;
+static const uint32_t ATTR_DATA = 0x80;
+static const uint32_t ATTR_INDEX_ROOT = 0x90;
+static const uint32_t ATTR_INDEX_ALLOCATION = 0xA0;
+static const uint32_t ATTR_REPARSE_POINT = 0xC0;
+static const uint32_t ATTR_END = 0xFFFFFFFF;
+
+// 属性标志
+static const uint16_t ATTR_FLAG_COMPRESSED = 0x0001;
+static const uint16_t ATTR_FLAG_ENCRYPTED = 0x4000;
+
+// MFT记录标志
+static const uint16_t RECORD_FLAG_IN_USE = 0x0001;
+static const uint16_t RECORD_FLAG_DIRECTORY = 0x0002;
+
+// 索引项标志
+static const uint16_t INDEX_ENTRY_SUBNODE = 0x0001;
+static const uint16_t INDEX_ENTRY_LAST = 0x0002;
+
+// 文件属性
+static const uint32_t FILE_ATTR_DIRECTORY = 0x00000010;
+static const uint32_t FILE_ATTR_REPARSE_POINT = 0x00000400;
+static const uint32_t FILE_ATTR_ENCRYPTED = 0x00004000;
+static const uint32_t FILE_ATTR_DUP_INDEX_PRESENT = 0x10000000;     // $FILE_NAME中表示目录
+static const uint32_t IO_REPARSE_TAG_WOF = 0x80000017;
+
+static const uint8_t FILE_NAME_DOS = 2;
+static const uint64_t MFT_REFERENCE_MASK = 0x0000FFFFFFFFFFFFULL;
+static const uint64_t FIRST_USER_RECORD = 16;           // 0~15为元数据文件
+static const size_t FIXUP_STRIDE = 512;                 // 更新序列按512字节分段
+static const size_t LZNT1_CHUNK_SIZE = 4096;
+static const int MAX_INDEX_DEPTH = 32;
+static const uint64_t MAX_READ_FILE_BYTES = 1ULL << 31;
+static const std::u16string INDEX_NAME_I30 = u"$I30";
+
+static inline uint16_t Read16(const uint8_t* p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint32_t Read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint64_t Read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+/********************************************************************************
+* 函数实现：UTF-16与UTF-8互相转换（内部辅助）
+*********************************************************************************/
+std::string NtfsVolume::Utf16ToUtf8(const std::u16string& str) {
+    std::string strResult;
+    for (size_t i = 0; i < str.size(); i++) {
+        uint32_t ui32Code = str[i];
+        if (ui32Code >= 0xD800 && ui32Code <= 0xDBFF && i + 1 < str.size() &&
+            str[i + 1] >= 0xDC00 && str[i + 1] <= 0xDFFF) {
+            ui32Code = 0x10000 + ((ui32Code - 0xD800) << 10) + (str[i + 1] - 0xDC00);
+            i++;
+        }
+        if (ui32Code < 0x80) {
+            strResult += static_cast<char>(ui32Code);
+        } else if (ui32Code < 0x800) {
+            strResult += static_cast<char>(0xC0 | (ui32Code >> 6));
+            strResult += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        } else if (ui32Code < 0x10000) {
+            strResult += static_cast<char>(0xE0 | (ui32Code >> 12));
+            strResult += static_cast<char>(0x80 | ((ui32Code >> 6) & 0x3F));
+            strResult += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        } else {
+            strResult += static_cast<char>(0xF0 | (ui32Code >> 18));
+            strResult += static_cast<char>(0x80 | ((ui32Code >> 12) & 0x3F));
+            strResult += static_cast<char>(0x80 | ((ui32Code >> 6) & 0x3F));
+            strResult += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        }
+    }
+    return strResult;
+}
+
+std::u16string NtfsVolume::Utf8ToUtf16(const std::string& str) {
+    std::u16string strResult;
+    for (size_t i = 0; i < str.size();) {
+        uint8_t ui8Lead = static_cast<uint8_t>(str[i]);
+        uint32_t ui32Code = ui8Lead;
+        size_t nExtra = 0;
+        if (ui8Lead >= 0xF0) { ui32Code = ui8Lead & 0x07; nExtra = 3; }
+        else if (ui8Lead >= 0xE0) { ui32Code = ui8Lead & 0x0F; nExtra = 2; }
+        else if (ui8Lead >= 0xC0) { ui32Code = ui8Lead & 0x1F; nExtra = 1; }
+        i++;
+        for (size_t k = 0; k < nExtra && i < str.size(); k++, i++) {
+            ui32Code = (ui32Code << 6) | (static_cast<uint8_t>(str[i]) & 0x3F);
+        }
+        if (ui32Code >= 0x10000) {
+            ui32Code -= 0x10000;
+            strResult += static_cast<char16_t>(0xD800 + (ui32Code >> 10));
+            strResult += static_cast<char16_t>(0xDC00 + (ui32Code & 0x3FF));
+        } else {
+            strResult += static_cast<char16_t>(ui32Code);
+        }
+    }
+    return strResult;
+}
+
+/********************************************************************************
+* 函数实现：应用更新序列（内部辅助）
+* 说明：每个512字节段的最后两个字节被替换为更新序列号，原值保存在更新序列
+*       数组中；序列号不一致说明写入没有完成（撕裂写）
+*********************************************************************************/
+bool NtfsVolume::ApplyFixups(uint8_t* p, size_t nBytes) {
+    uint16_t ui16Offset = Read16(p + 4);
+    uint16_t ui16Count = Read16(p + 6);
+    if (ui16Count < 2 || (ui16Count - 1) * FIXUP_STRIDE != nBytes ||
+        static_cast<size_t>(ui16Offset) + ui16Count * 2 > FIXUP_STRIDE - 2) {
+        return false;
+    }
+    uint16_t ui16Sequence = Read16(p + ui16Offset);
+    for (uint16_t i = 1; i < ui16Count; i++) {
+        uint8_t* pTail = p + i * FIXUP_STRIDE - 2;
+        if (Read16(pTail) != ui16Sequence) {
+            return false;
+        }
+        memcpy(pTail, p + ui16Offset + 2 * i, 2);
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：列出记录中的属性（内部辅助）
+* 说明：长度、名称、常驻值越界的属性视为记录结束
+*********************************************************************************/
+std::vector<const uint8_t*> NtfsVolume::ListAttributes(const std::vector<uint8_t>& vecRecord) {
+    std::vector<const uint8_t*> vecAttributes;
+    const uint8_t* p = vecRecord.data();
+    size_t nUsed = Read32(p + 0x18);
+    if (nUsed > vecRecord.size()) nUsed = vecRecord.size();
+    size_t nPos = Read16(p + 0x14);
+    while (nPos + 16 <= nUsed) {
+        const uint8_t* pAttr = p + nPos;
+        uint32_t ui32Length = Read32(pAttr + 4);
+        if (Read32(pAttr) == ATTR_END || ui32Length < 0x18 || ui32Length > nUsed - nPos) {
+            break;
+        }
+        bool bNonResident = pAttr[8] != 0;
+        size_t nNameEnd = Read16(pAttr + 10) + 2 * static_cast<size_t>(pAttr[9]);
+        size_t nValueEnd = bNonResident ? 0x40 : static_cast<size_t>(Read16(pAttr + 0x14)) + Read32(pAttr + 0x10);
+        if (nNameEnd > ui32Length || nValueEnd > ui32Length) {
+            break;
+        }
+        vecAttributes.push_back(pAttr);
+        nPos += ui32Length;
+    }
+    return vecAttributes;
+}
+
+std::u16string NtfsVolume::AttributeName(const uint8_t* pAttr) {
+    std::u16string strName(pAttr[9], u'\0');
+    memcpy(&strName[0], pAttr + Read16(pAttr + 10), strName.size() * 2);
+    return strName;
+}
+
+const uint8_t* NtfsVolume::FindAttribute(const std::vector<uint8_t>& vecRecord, uint32_t ui32Type,
+                                         const std::u16string& strName) {
+    for (const uint8_t* pAttr : ListAttributes(vecRecord)) {
+        if (Read32(pAttr) == ui32Type && AttributeName(pAttr) == strName) {
+            return pAttr;
+        }
+    }
+    return nullptr;
+}
+
+/********************************************************************************
+* 函数实现：解码运行列表（内部辅助）
+* 说明：每个运行以一个字节开头，低4位是长度字段的字节数，高4位是偏移字段的
+*       字节数；偏移是相对上一个运行的有符号LCN差值，偏移字段为空表示稀疏
+*********************************************************************************/
+static bool DecodeRuns(const uint8_t* pAttr, uint64_t ui64TotalClusters, std::vector<NtfsStream::Run>& vecRuns) {
+    uint32_t ui32Length = Read32(pAttr + 4);
+    uint64_t ui64Vcn = Read64(pAttr + 0x10);
+    uint64_t ui64LastVcn = Read64(pAttr + 0x18);
+    size_t nPos = Read16(pAttr + 0x20);
+    uint64_t ui64Lcn = 0;
+    while (nPos < ui32Length && pAttr[nPos] != 0) {
+        size_t nLengthBytes = pAttr[nPos] & 0x0F;
+        size_t nOffsetBytes = pAttr[nPos] >> 4;
+        if (nLengthBytes == 0 || nLengthBytes > 8 || nOffsetBytes > 8 ||
+            nPos + 1 + nLengthBytes + nOffsetBytes > ui32Length) {
+            return false;
+        }
+        const uint8_t* pField = pAttr + nPos + 1;
+        uint64_t ui64Count = 0;
+        for (size_t i = 0; i < nLengthBytes; i++) {
+            ui64Count |= static_cast<uint64_t>(pField[i]) << (8 * i);
+        }
+        uint64_t ui64Delta = 0;
+        for (size_t i = 0; i < nOffsetBytes; i++) {
+            ui64Delta |= static_cast<uint64_t>(pField[nLengthBytes + i]) << (8 * i);
+        }
+        if (nOffsetBytes > 0 && nOffsetBytes < 8 && (pField[nLengthBytes + nOffsetBytes - 1] & 0x80)) {
+            ui64Delta |= ~0ULL << (8 * nOffsetBytes);       // 符号扩展
+        }
+        nPos += 1 + nLengthBytes + nOffsetBytes;
+        if (ui64Count == 0 || ui64Count > ui64TotalClusters) {
+            return false;
+        }
+
+        NtfsStream::Run stcRun = { ui64Vcn, NtfsStream::SPARSE_LCN, ui64Count };
+        if (nOffsetBytes > 0) {
+            ui64Lcn += ui64Delta;
+            if (ui64Lcn >= ui64TotalClusters || ui64Count > ui64TotalClusters - ui64Lcn) {
+                return false;
+            }
+            stcRun.ui64Lcn = ui64Lcn;
+        }
+        vecRuns.push_back(stcRun);
+        ui64Vcn += ui64Count;
+    }
+    return ui64Vcn == ui64LastVcn + 1;
+}
+
+/********************************************************************************
+* 函数实现：把属性的一个片段加入属性流（内部辅助）
+* 说明：第一个片段（VCN 0）给出大小、标志和压缩单元，后续片段必须紧接上一个
+*********************************************************************************/
+static bool AppendExtent(const uint8_t* pAttr, bool bFirst, uint64_t ui64TotalClusters,
+                         NtfsStream& stcStream, std::string& strError) {
+    if (pAttr[8] == 0) {
+        if (!bFirst) {
+            strError = "常驻属性不能分为多个片段";
+            return false;
+        }
+        uint32_t ui32ValueLength = Read32(pAttr + 0x10);
+        const uint8_t* pValue = pAttr + Read16(pAttr + 0x14);
+        stcStream.bResident = true;
+        stcStream.ui16Flags = Read16(pAttr + 0x0C);
+        stcStream.vecResident.assign(pValue, pValue + ui32ValueLength);
+        stcStream.ui64DataSize = ui32ValueLength;
+        stcStream.ui64InitializedSize = ui32ValueLength;
+        stcStream.ui64AllocatedSize = ui32ValueLength;
+        return true;
+    }
+
+    uint64_t ui64StartVcn = Read64(pAttr + 0x10);
+    uint64_t ui64Expected = stcStream.vecRuns.empty() ? 0 :
+        stcStream.vecRuns.back().ui64Vcn + stcStream.vecRuns.back().ui64Length;
+    if (ui64StartVcn != ui64Expected) {
+        strError = "属性片段不连续（VCN " + std::to_string(ui64StartVcn) + "）";
+        return false;
+    }
+    if (bFirst) {
+        stcStream.ui16Flags = Read16(pAttr + 0x0C);
+        stcStream.ui64AllocatedSize = Read64(pAttr + 0x28);
+        stcStream.ui64DataSize = Read64(pAttr + 0x30);
+        stcStream.ui64InitializedSize = Read64(pAttr + 0x38);
+        if (stcStream.ui64InitializedSize > stcStream.ui64DataSize) {
+            stcStream.ui64InitializedSize = stcStream.ui64DataSize;
+        }
+        uint16_t ui16UnitShift = Read16(pAttr + 0x22);
+        if ((stcStream.ui16Flags & ATTR_FLAG_COMPRESSED) && ui16UnitShift != 0) {
+            if (ui16UnitShift > 8) {
+                strError = "压缩单元大小无效";
+                return false;
+            }
+            stcStream.ui32CompressionUnit = 1u << ui16UnitShift;
+        }
+    }
+    if (!DecodeRuns(pAttr, ui64TotalClusters, stcStream.vecRuns)) {
+        strError = "运行列表已损坏";
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：LZNT1解压一个压缩单元（内部辅助）
+* 说明：数据分为若干块，每块解压后4096字节；块头低12位为块长度-3，最高位
+*       表示已压缩。压缩块中每个标志字节控制后续8项：0为原样字节，1为两字节
+*       的回溯引用，偏移和长度的位数随块内已输出的字节数变化
+*********************************************************************************/
+static bool Lznt1Decompress(const uint8_t* pSource, size_t nSource, uint8_t* pDest, size_t nDest) {
+    memset(pDest, 0, nDest);
+    size_t nIn = 0;
+    for (size_t nChunkStart = 0; nChunkStart < nDest && nIn + 2 <= nSource; nChunkStart += LZNT1_CHUNK_SIZE) {
+        uint16_t ui16Header = Read16(pSource + nIn);
+        if (ui16Header == 0) {
+            break;
+        }
+        nIn += 2;
+        size_t nChunkBytes = (ui16Header & 0x0FFF) + 1;
+        if (nChunkBytes > nSource - nIn) {
+            return false;
+        }
+        const uint8_t* pIn = pSource + nIn;
+        const uint8_t* pInEnd = pIn + nChunkBytes;
+        uint8_t* pOut = pDest + nChunkStart;
+        size_t nOutCapacity = nDest - nChunkStart;
+        if (nOutCapacity > LZNT1_CHUNK_SIZE) nOutCapacity = LZNT1_CHUNK_SIZE;
+        nIn += nChunkBytes;
+
+        if (!(ui16Header & 0x8000)) {
+            memcpy(pOut, pIn, nChunkBytes < nOutCapacity ? nChunkBytes : nOutCapacity);
+            continue;
+        }
+        size_t nPos = 0;
+        while (pIn < pInEnd) {
+            uint8_t ui8Flags = *pIn++;
+            for (int nBit = 0; nBit < 8 && pIn < pInEnd; nBit++) {
+                if (!(ui8Flags & (1 << nBit))) {
+                    if (nPos >= nOutCapacity) return false;
+                    pOut[nPos++] = *pIn++;
+                    continue;
+                }
+                if (pInEnd - pIn < 2 || nPos == 0) {
+                    return false;
+                }
+                uint16_t ui16Token = Read16(pIn);
+                pIn += 2;
+                int nLengthShift = 0;
+                for (size_t i = nPos - 1; i >= 0x10; i >>= 1) nLengthShift++;
+                size_t nDistance = (ui16Token >> (12 - nLengthShift)) + 1;
+                size_t nLength = (ui16Token & (0x0FFF >> nLengthShift)) + 3;
+                if (nDistance > nPos || nLength > nOutCapacity - nPos) {
+                    return false;
+                }
+                for (size_t i = 0; i < nLength; i++, nPos++) {
+                    pOut[nPos] = pOut[nPos - nDistance];
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：查找包含指定VCN的运行（内部辅助）
+*********************************************************************************/
+static size_t FindRun(const NtfsStream& stcStream, uint64_t ui64Vcn) {
+    auto it = std::upper_bound(stcStream.vecRuns.begin(), stcStream.vecRuns.end(), ui64Vcn,
+        [](uint64_t ui64Value, const NtfsStream::Run& stcRun) { return ui64Value < stcRun.ui64Vcn; });
+    return it == stcStream.vecRuns.begin() ? stcStream.vecRuns.size() : (it - stcStream.vecRuns.begin()) - 1;
+}
+
+/********************************************************************************
+* 函数实现：打开卷
+*********************************************************************************/
+bool NtfsVolume::Open(BlockDevice& objVolume, std::string& strError) {
+    m_pDevice = nullptr;
+    m_stcMft = NtfsStream();
+    m_vecUpcase.clear();
+
+    // 1. 引导扇区：簇大小、MFT位置、MFT记录和索引块大小（负值表示2^-值字节）
+    uint8_t ui8Boot[512];
+    if (objVolume.Size() < sizeof(ui8Boot) || !objVolume.Read(0, ui8Boot, sizeof(ui8Boot), strError)) {
+        strError = "无法读取NTFS引导扇区" + (strError.empty() ? "" : "：" + strError);
+        return false;
+    }
+    if (memcmp(ui8Boot + 3, "NTFS    ", 8) != 0 || ui8Boot[510] != 0x55 || ui8Boot[511] != 0xAA) {
+        strError = "不是NTFS卷";
+        return false;
+    }
+    uint32_t ui32BytesPerSector = Read16(ui8Boot + 0x0B);
+    uint32_t ui32SectorsPerCluster = ui8Boot[0x0D] > 0x80 ? 1u << (256 - ui8Boot[0x0D]) : ui8Boot[0x0D];
+    m_ui32ClusterSize = ui32BytesPerSector * ui32SectorsPerCluster;
+    auto SizeFromBoot = [&](int8_t i8Value) -> uint32_t {
+        if (i8Value > 0) return static_cast<uint32_t>(i8Value) * m_ui32ClusterSize;
+        return i8Value > -31 ? 1u << -i8Value : 0;
+    };
+    m_ui32RecordSize = SizeFromBoot(static_cast<int8_t>(ui8Boot[0x40]));
+    m_ui32IndexBlockSize = SizeFromBoot(static_cast<int8_t>(ui8Boot[0x44]));
+    uint64_t ui64TotalSectors = Read64(ui8Boot + 0x28);
+    uint64_t ui64MftLcn = Read64(ui8Boot + 0x30);
+    auto IsPowerOfTwo = [](uint32_t v) { return v != 0 && (v & (v - 1)) == 0; };
+    if (ui32BytesPerSector < 256 || ui32BytesPerSector > 4096 || !IsPowerOfTwo(ui32BytesPerSector) ||
+        ui32SectorsPerCluster == 0 || !IsPowerOfTwo(ui32SectorsPerCluster) || m_ui32ClusterSize > 2 * 1024 * 1024 ||
+        m_ui32RecordSize < 1024 || m_ui32RecordSize > 65536 || !IsPowerOfTwo(m_ui32RecordSize) ||
+        m_ui32IndexBlockSize < 1024 || m_ui32IndexBlockSize > 65536 || !IsPowerOfTwo(m_ui32IndexBlockSize) ||
+        ui64TotalSectors == 0 || ui64TotalSectors > objVolume.Size() / ui32BytesPerSector) {
+        strError = "NTFS引导扇区参数无效";
+        return false;
+    }
+    m_ui64TotalClusters = ui64TotalSectors / ui32SectorsPerCluster;
+    if (ui64MftLcn >= m_ui64TotalClusters) {
+        strError = "NTFS引导扇区中的MFT位置无效";
+        return false;
+    }
+    m_pDevice = &objVolume;
+
+    // 2. 直接按引导扇区读取$MFT自身的记录，用其中$DATA的第一个片段读取其他记录
+    std::vector<uint8_t> vecRecord(m_ui32RecordSize);
+    if (!objVolume.Read(ui64MftLcn * m_ui32ClusterSize, vecRecord.data(), vecRecord.size(), strError)) {
+        m_pDevice = nullptr;
+        return false;
+    }
+    const uint8_t* pMftData = nullptr;
+    if (memcmp(vecRecord.data(), "FILE", 4) == 0 && ApplyFixups(vecRecord.data(), vecRecord.size())) {
+        pMftData = FindAttribute(vecRecord, ATTR_DATA, u"");
+    }
+    if (!pMftData || pMftData[8] == 0 || !AppendExtent(pMftData, true, m_ui64TotalClusters, m_stcMft, strError)) {
+        strError = "$MFT记录已损坏" + (strError.empty() ? "" : "：" + strError);
+        m_pDevice = nullptr;
+        return false;
+    }
+
+    // 3. $MFT很碎时其余片段在扩展记录中（通过属性列表找到），重新完整加载
+    NtfsStream stcFullMft;
+    if (!LoadStream(MFT_RECORD_MFT, ATTR_DATA, u"", stcFullMft, strError)) {
+        strError = "无法加载$MFT：" + strError;
+        m_pDevice = nullptr;
+        return false;
+    }
+    m_stcMft = std::move(stcFullMft);
+
+    // 4. $UpCase：文件名比较使用的大写映射表
+    NtfsStream stcUpcase;
+    if (!LoadStream(MFT_RECORD_UPCASE, ATTR_DATA, u"", stcUpcase, strError) ||
+        stcUpcase.ui64DataSize < 65536 * sizeof(char16_t)) {
+        strError = "无法加载$UpCase" + (strError.empty() ? "" : "：" + strError);
+        m_pDevice = nullptr;
+        return false;
+    }
+    m_vecUpcase.resize(65536);
+    if (!ReadStream(stcUpcase, 0, m_vecUpcase.data(), 65536 * sizeof(char16_t), strError)) {
+        m_vecUpcase.clear();
+        m_pDevice = nullptr;
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取MFT记录（内部辅助）
+*********************************************************************************/
+bool NtfsVolume::ReadRecord(uint64_t ui64Record, std::vector<uint8_t>& vecRecord, std::string& strError) {
+    if (ui64Record >= m_stcMft.ui64DataSize / m_ui32RecordSize) {
+        strError = "MFT记录号超出范围（" + std::to_string(ui64Record) + "）";
+        return false;
+    }
+    vecRecord.resize(m_ui32RecordSize);
+    if (!ReadStream(m_stcMft, ui64Record * m_ui32RecordSize, vecRecord.data(), vecRecord.size(), strError)) {
+        return false;
+    }
+    if (memcmp(vecRecord.data(), "FILE", 4) != 0 || !ApplyFixups(vecRecord.data(), vecRecord.size())) {
+        strError = "MFT记录 " + std::to_string(ui64Record) + " 已损坏";
+        return false;
+    }
+    if (!(Read16(vecRecord.data() + 0x16) & RECORD_FLAG_IN_USE)) {
+        strError = "MFT记录 " + std::to_string(ui64Record) + " 未使用";
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：加载属性流（内部辅助）
+*********************************************************************************/
+bool NtfsVolume::LoadStream(uint64_t ui64Record, uint32_t ui32Type, const std::u16string& strName,
+                            NtfsStream& stcStream, std::string& strError) {
+    std::vector<uint8_t> vecBase;
+    if (!ReadRecord(ui64Record, vecBase, strError)) {
+        stcStream = NtfsStream();
+        return false;
+    }
+    return LoadStream(ui64Record, vecBase, ui32Type, strName, stcStream, strError);
+}
+
+/********************************************************************************
+* 函数实现：从已读取的基本记录加载属性流（内部辅助）
+* 说明：vecBase是ui64Record的内容（已应用更新序列），扩展记录从卷上读取
+*********************************************************************************/
+bool NtfsVolume::LoadStream(uint64_t ui64Record, const std::vector<uint8_t>& vecBase, uint32_t ui32Type,
+                            const std::u16string& strName, NtfsStream& stcStream, std::string& strError) {
+    stcStream = NtfsStream();
+    char szType[16];
+    snprintf(szType, sizeof(szType), "0x%X", ui32Type);
+    std::string strNotFound = "MFT记录 " + std::to_string(ui64Record) + " 中没有所需的属性（类型 " + szType + "）";
+
+    // 1. 没有属性列表：属性的全部片段都在基本记录中
+    const uint8_t* pList = FindAttribute(vecBase, ATTR_ATTRIBUTE_LIST, u"");
+    if (!pList) {
+        bool bFound = false;
+        for (const uint8_t* pAttr : ListAttributes(vecBase)) {
+            if (Read32(pAttr) == ui32Type && AttributeName(pAttr) == strName) {
+                if (!AppendExtent(pAttr, !bFound, m_ui64TotalClusters, stcStream, strError)) return false;
+                bFound = true;
+            }
+        }
+        if (!bFound) strError = strNotFound;
+        return bFound;
+    }
+
+    // 2. 读取属性列表（本身可能是非常驻的）
+    NtfsStream stcList;
+    if (!AppendExtent(pList, true, m_ui64TotalClusters, stcList, strError)) {
+        return false;
+    }
+    std::vector<uint8_t> vecList(static_cast<size_t>(stcList.ui64DataSize));
+    if (!ReadStream(stcList, 0, vecList.data(), vecList.size(), strError)) {
+        return false;
+    }
+
+    // 3. 列表项：类型、名称、起始VCN、所在记录、属性实例号；按起始VCN排序逐个加载
+    struct ListEntry {
+        uint64_t ui64Vcn;
+        uint64_t ui64Record;
+        uint16_t ui16Instance;
+    };
+    std::vector<ListEntry> vecEntries;
+    for (size_t nPos = 0; nPos + 0x1A <= vecList.size();) {
+        const uint8_t* pEntry = vecList.data() + nPos;
+        uint16_t ui16Length = Read16(pEntry + 4);
+        size_t nNameEnd = pEntry[7] + 2 * static_cast<size_t>(pEntry[6]);
+        if (ui16Length < 0x1A || ui16Length > vecList.size() - nPos || nNameEnd > ui16Length) {
+            break;
+        }
+        std::u16string strEntryName(pEntry[6], u'\0');
+        memcpy(&strEntryName[0], pEntry + pEntry[7], strEntryName.size() * 2);
+        if (Read32(pEntry) == ui32Type && strEntryName == strName) {
+            vecEntries.push_back({ Read64(pEntry + 8), Read64(pEntry + 0x10) & MFT_REFERENCE_MASK, Read16(pEntry + 0x18) });
+        }
+        nPos += ui16Length;
+    }
+    if (vecEntries.empty()) {
+        strError = strNotFound;
+        return false;
+    }
+    std::stable_sort(vecEntries.begin(), vecEntries.end(),
+        [](const ListEntry& a, const ListEntry& b) { return a.ui64Vcn < b.ui64Vcn; });
+
+    std::vector<uint8_t> vecExtension;
+    for (size_t i = 0; i < vecEntries.size(); i++) {
+        const std::vector<uint8_t>* pRecord = &vecBase;
+        if (vecEntries[i].ui64Record != ui64Record) {
+            if (!ReadRecord(vecEntries[i].ui64Record, vecExtension, strError)) {
+                return false;
+            }
+            if ((Read64(vecExtension.data() + 0x20) & MFT_REFERENCE_MASK) != ui64Record) {
+                strError = "扩展记录 " + std::to_string(vecEntries[i].ui64Record) + " 不属于记录 " +
+                           std::to_string(ui64Record);
+                return false;
+            }
+            pRecord = &vecExtension;
+        }
+        const uint8_t* pExtent = nullptr;
+        for (const uint8_t* pAttr : ListAttributes(*pRecord)) {
+            if (Read32(pAttr) == ui32Type && Read16(pAttr + 0x0E) == vecEntries[i].ui16Instance &&
+                AttributeName(pAttr) == strName) {
+                pExtent = pAttr;
+                break;
+            }
+        }
+        if (!pExtent) {
+            strError = "属性列表指向的属性不存在（记录 " + std::to_string(vecEntries[i].ui64Record) + "）";
+            return false;
+        }
+        if (!AppendExtent(pExtent, i == 0, m_ui64TotalClusters, stcStream, strError)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取属性流（内部辅助）
+* 说明：范围必须在数据大小之内；超出已初始化大小的部分读出为0
+*********************************************************************************/
+bool NtfsVolume::ReadStream(const NtfsStream& stcStream, uint64_t ui64Offset, void* pBuffer, size_t nBytes,
+                            std::string& strError) {
+    char* pDest = static_cast<char*>(pBuffer);
+    if (ui64Offset > stcStream.ui64DataSize || nBytes > stcStream.ui64DataSize - ui64Offset) {
+        strError = "读取超出属性范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+    if (nBytes == 0) {
+        return true;
+    }
+    if (stcStream.bResident) {
+        memcpy(pDest, stcStream.vecResident.data() + ui64Offset, nBytes);
+        return true;
+    }
+    if (stcStream.ui16Flags & ATTR_FLAG_ENCRYPTED) {
+        strError = "不支持读取EFS加密的数据";
+        return false;
+    }
+    if (stcStream.ui32CompressionUnit != 0) {
+        return ReadCompressed(stcStream, ui64Offset, pDest, nBytes, strError);
+    }
+
+    size_t nInitialized = 0;
+    if (ui64Offset < stcStream.ui64InitializedSize) {
+        uint64_t ui64Available = stcStream.ui64InitializedSize - ui64Offset;
+        nInitialized = ui64Available < nBytes ? static_cast<size_t>(ui64Available) : nBytes;
+    }
+    if (nInitialized > 0 && !ReadRuns(stcStream, ui64Offset, pDest, nInitialized, strError)) {
+        return false;
+    }
+    memset(pDest + nInitialized, 0, nBytes - nInitialized);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：按运行列表读取原始字节（内部辅助）
+* 说明：同一个运行内的数据一次读取，稀疏运行填0
+*********************************************************************************/
+bool NtfsVolume::ReadRuns(const NtfsStream& stcStream, uint64_t ui64Offset, char* pBuffer, size_t nBytes,
+                          std::string& strError) {
+    const uint64_t ui64ClusterSize = m_ui32ClusterSize;
+    size_t nRun = FindRun(stcStream, ui64Offset / ui64ClusterSize);
+    while (nBytes > 0) {
+        if (nRun >= stcStream.vecRuns.size() || ui64Offset < stcStream.vecRuns[nRun].ui64Vcn * ui64ClusterSize) {
+            strError = "数据超出运行列表范围（偏移 " + std::to_string(ui64Offset) + "）";
+            return false;
+        }
+        const NtfsStream::Run& stcRun = stcStream.vecRuns[nRun];
+        uint64_t ui64InRun = ui64Offset - stcRun.ui64Vcn * ui64ClusterSize;
+        uint64_t ui64Available = stcRun.ui64Length * ui64ClusterSize - ui64InRun;
+        size_t nChunk = ui64Available < nBytes ? static_cast<size_t>(ui64Available) : nBytes;
+        if (stcRun.ui64Lcn == NtfsStream::SPARSE_LCN) {
+            memset(pBuffer, 0, nChunk);
+        } else if (!m_pDevice->Read(stcRun.ui64Lcn * ui64ClusterSize + ui64InRun, pBuffer, nChunk, strError)) {
+            return false;
+        }
+        ui64Offset += nChunk;
+        pBuffer += nChunk;
+        nBytes -= nChunk;
+        nRun++;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取压缩流（内部辅助）
+* 说明：按压缩单元（通常16簇）处理：全部稀疏为0；全部分配为未压缩数据；
+*       部分分配时分配的簇是LZNT1压缩数据
+*********************************************************************************/
+bool NtfsVolume::ReadCompressed(const NtfsStream& stcStream, uint64_t ui64Offset, char* pBuffer, size_t nBytes,
+                                std::string& strError) {
+    const uint64_t ui64UnitClusters = stcStream.ui32CompressionUnit;
+    const uint64_t ui64UnitBytes = ui64UnitClusters * m_ui32ClusterSize;
+    std::vector<uint8_t> vecRaw;
+    std::vector<uint8_t> vecUnit;
+    while (nBytes > 0) {
+        uint64_t ui64Unit = ui64Offset / ui64UnitBytes;
+        uint64_t ui64InUnit = ui64Offset - ui64Unit * ui64UnitBytes;
+        size_t nChunk = ui64UnitBytes - ui64InUnit < nBytes ? static_cast<size_t>(ui64UnitBytes - ui64InUnit) : nBytes;
+
+        // 统计压缩单元内已分配的簇数
+        uint64_t ui64UnitVcn = ui64Unit * ui64UnitClusters;
+        uint64_t ui64Allocated = 0;
+        for (size_t nRun = FindRun(stcStream, ui64UnitVcn); nRun < stcStream.vecRuns.size(); nRun++) {
+            const NtfsStream::Run& stcRun = stcStream.vecRuns[nRun];
+            if (stcRun.ui64Vcn >= ui64UnitVcn + ui64UnitClusters) break;
+            if (stcRun.ui64Lcn == NtfsStream::SPARSE_LCN) continue;
+            uint64_t ui64Begin = stcRun.ui64Vcn > ui64UnitVcn ? stcRun.ui64Vcn : ui64UnitVcn;
+            uint64_t ui64End = stcRun.ui64Vcn + stcRun.ui64Length;
+            if (ui64End > ui64UnitVcn + ui64UnitClusters) ui64End = ui64UnitVcn + ui64UnitClusters;
+            if (ui64End > ui64Begin) ui64Allocated += ui64End - ui64Begin;
+        }
+
+        if (ui64Allocated == 0) {
+            memset(pBuffer, 0, nChunk);
+        } else if (ui64Allocated == ui64UnitClusters) {
+            if (!ReadRuns(stcStream, ui64Offset, pBuffer, nChunk, strError)) return false;
+        } else {
+            vecRaw.resize(static_cast<size_t>(ui64Allocated * m_ui32ClusterSize));
+            vecUnit.resize(static_cast<size_t>(ui64UnitBytes));
+            if (!ReadRuns(stcStream, ui64Unit * ui64UnitBytes, reinterpret_cast<char*>(vecRaw.data()),
+                          vecRaw.size(), strError)) {
+                return false;
+            }
+            if (!Lznt1Decompress(vecRaw.data(), vecRaw.size(), vecUnit.data(), vecUnit.size())) {
+                strError = "压缩数据已损坏（偏移 " + std::to_string(ui64Unit * ui64UnitBytes) + "）";
+                return false;
+            }
+            memcpy(pBuffer, vecUnit.data() + ui64InUnit, nChunk);
+        }
+        ui64Offset += nChunk;
+        pBuffer += nChunk;
+        nBytes -= nChunk;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取索引块（内部辅助）
+* 说明：索引块不小于簇时VCN以簇为单位，否则以512字节为单位
+*********************************************************************************/
+bool NtfsVolume::ReadIndexBlock(const NtfsStream& stcAllocation, uint32_t ui32BlockSize, uint64_t ui64Vcn,
+                                std::vector<uint8_t>& vecBlock, std::string& strError) {
+    uint64_t ui64Unit = ui32BlockSize >= m_ui32ClusterSize ? m_ui32ClusterSize : FIXUP_STRIDE;
+    uint64_t ui64Offset = ui64Vcn * ui64Unit;
+    if (ui64Vcn > stcAllocation.ui64DataSize / ui64Unit || ui64Offset + ui32BlockSize > stcAllocation.ui64DataSize) {
+        strError = "索引块位置无效（VCN " + std::to_string(ui64Vcn) + "）";
+        return false;
+    }
+    vecBlock.resize(ui32BlockSize);
+    if (!ReadStream(stcAllocation, ui64Offset, vecBlock.data(), vecBlock.size(), strError)) {
+        return false;
+    }
+    if (memcmp(vecBlock.data(), "INDX", 4) != 0 || !ApplyFixups(vecBlock.data(), vecBlock.size()) ||
+        Read64(vecBlock.data() + 0x10) != ui64Vcn) {
+        strError = "索引块已损坏（VCN " + std::to_string(ui64Vcn) + "）";
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：解析索引节点（内部辅助）
+* 说明：pHeader指向索引头（项偏移和已用大小都相对索引头），节点必须以
+*       "最后一项"结束；每一项的键是$FILE_NAME
+*********************************************************************************/
+struct IndexNodeEntry {
+    const uint8_t* pEntry;          // 索引项
+    bool           bLast;           // 是否节点的最后一项（没有键）
+    bool           bSubnode;        // 是否有子节点
+    uint64_t       ui64SubnodeVcn;  // 子节点VCN
+};
+
+static bool ParseIndexNode(const uint8_t* pHeader, size_t nAvailable, std::vector<IndexNodeEntry>& vecEntries) {
+    vecEntries.clear();
+    if (nAvailable < 16) return false;
+    size_t nPos = Read32(pHeader);
+    size_t nEnd = Read32(pHeader + 4);
+    if (nEnd > nAvailable) nEnd = nAvailable;
+    while (nPos + 16 <= nEnd) {
+        const uint8_t* pEntry = pHeader + nPos;
+        size_t nLength = Read16(pEntry + 8);
+        size_t nKeyLength = Read16(pEntry + 10);
+        uint16_t ui16Flags = Read16(pEntry + 12);
+        if (nLength < 16 || nLength > nEnd - nPos) {
+            return false;
+        }
+        IndexNodeEntry stcEntry = { pEntry, (ui16Flags & INDEX_ENTRY_LAST) != 0, (ui16Flags & INDEX_ENTRY_SUBNODE) != 0, 0 };
+        if (!stcEntry.bLast) {
+            if (nKeyLength < 0x42 || 0x10 + nKeyLength > nLength ||
+                0x42 + 2 * static_cast<size_t>(pEntry[0x10 + 0x40]) > nKeyLength) {
+                return false;
+            }
+        }
+        if (stcEntry.bSubnode) {
+            if (nLength < 24) return false;
+            stcEntry.ui64SubnodeVcn = Read64(pEntry + nLength - 8);
+        }
+        vecEntries.push_back(stcEntry);
+        if (stcEntry.bLast) return true;
+        nPos += nLength;
+    }
+    return false;
+}
+
+static std::u16string IndexKeyName(const uint8_t* pEntry) {
+    const uint8_t* pKey = pEntry + 0x10;
+    std::u16string strName(pKey[0x40], u'\0');
+    memcpy(&strName[0], pKey + 0x42, strName.size() * 2);
+    return strName;
+}
+
+/********************************************************************************
+* 函数实现：按$UpCase表比较文件名（内部辅助）
+*********************************************************************************/
+int NtfsVolume::CompareNames(const std::u16string& strA, const std::u16string& strB) const {
+    size_t nCommon = strA.size() < strB.size() ? strA.size() : strB.size();
+    for (size_t i = 0; i < nCommon; i++) {
+        char16_t chA = m_vecUpcase[strA[i]];
+        char16_t chB = m_vecUpcase[strB[i]];
+        if (chA != chB) return chA < chB ? -1 : 1;
+    }
+    if (strA.size() == strB.size()) return 0;
+    return strA.size() < strB.size() ? -1 : 1;
+}
+
+/********************************************************************************
+* 函数实现：在目录索引中查找文件名（内部辅助）
+* 说明：节点内的项按文件名排序；目标小于某项时进入该项的子节点，
+*       大于全部项时进入最后一项的子节点
+*********************************************************************************/
+bool NtfsVolume::FindInDirectory(uint64_t ui64Directory, const std::u16string& strName, IndexEntry& stcEntry,
+                                 std::string& strError) {
+    NtfsStream stcRoot;
+    if (!LoadStream(ui64Directory, ATTR_INDEX_ROOT, INDEX_NAME_I30, stcRoot, strError)) {
+        return false;
+    }
+    if (!stcRoot.bResident || stcRoot.vecResident.size() < 0x20) {
+        strError = "目录索引根已损坏（记录 " + std::to_string(ui64Directory) + "）";
+        return false;
+    }
+    uint32_t ui32BlockSize = Read32(stcRoot.vecResident.data() + 8);
+    std::vector<IndexNodeEntry> vecNode;
+    if (!ParseIndexNode(stcRoot.vecResident.data() + 0x10, stcRoot.vecResident.size() - 0x10, vecNode)) {
+        strError = "目录索引根已损坏（记录 " + std::to_string(ui64Directory) + "）";
+        return false;
+    }
+
+    NtfsStream stcAllocation;
+    bool bAllocationLoaded = false;
+    std::vector<uint8_t> vecBlock;
+    for (int nDepth = 0; nDepth < MAX_INDEX_DEPTH; nDepth++) {
+        const IndexNodeEntry* pDescend = nullptr;
+        for (const IndexNodeEntry& stcNode : vecNode) {
+            if (!stcNode.bLast) {
+                int nCompare = CompareNames(strName, IndexKeyName(stcNode.pEntry));
+                if (nCompare > 0) continue;
+                if (nCompare == 0) {
+                    const uint8_t* pKey = stcNode.pEntry + 0x10;
+                    stcEntry.ui64Reference = Read64(stcNode.pEntry);
+                    stcEntry.ui64Record = stcEntry.ui64Reference & MFT_REFERENCE_MASK;
+                    stcEntry.vecKey.assign(pKey, pKey + Read16(stcNode.pEntry + 10));
+                    stcEntry.strName = IndexKeyName(stcNode.pEntry);
+                    stcEntry.ui8Namespace = pKey[0x41];
+                    stcEntry.ui32Flags = Read32(pKey + 0x38);
+                    stcEntry.ui64Size = Read64(pKey + 0x30);
+                    stcEntry.ui64ModifiedTime = Read64(pKey + 0x10);
+                    return true;
+                }
+            }
+            pDescend = stcNode.bSubnode ? &stcNode : nullptr;
+            break;
+        }
+        if (!pDescend) {
+            strError = "找不到 " + Utf16ToUtf8(strName);
+            return false;
+        }
+
+        uint64_t ui64Vcn = pDescend->ui64SubnodeVcn;
+        if (!bAllocationLoaded) {
+            if (!LoadStream(ui64Directory, ATTR_INDEX_ALLOCATION, INDEX_NAME_I30, stcAllocation, strError)) {
+                return false;
+            }
+            bAllocationLoaded = true;
+        }
+        if (!ReadIndexBlock(stcAllocation, ui32BlockSize, ui64Vcn, vecBlock, strError)) {
+            return false;
+        }
+        if (!ParseIndexNode(vecBlock.data() + 0x18, vecBlock.size() - 0x18, vecNode)) {
+            strError = "索引块已损坏（VCN " + std::to_string(ui64Vcn) + "）";
+            return false;
+        }
+    }
+    strError = "目录索引层数过多（记录 " + std::to_string(ui64Directory) + "）";
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：按顺序遍历目录索引（内部辅助）
+* 说明：中序遍历（先子节点、再本项），结果按文件名排序；记录访问过的索引块，
+*       损坏的索引出现环时返回错误
+*********************************************************************************/
+bool NtfsVolume::EnumerateDirectory(uint64_t ui64Directory, std::vector<IndexEntry>& vecEntries,
+                                    std::string& strError) {
+    vecEntries.clear();
+    NtfsStream stcRoot;
+    if (!LoadStream(ui64Directory, ATTR_INDEX_ROOT, INDEX_NAME_I30, stcRoot, strError)) {
+        return false;
+    }
+    if (!stcRoot.bResident || stcRoot.vecResident.size() < 0x20) {
+        strError = "目录索引根已损坏（记录 " + std::to_string(ui64Directory) + "）";
+        return false;
+    }
+    uint32_t ui32BlockSize = Read32(stcRoot.vecResident.data() + 8);
+
+    NtfsStream stcAllocation;
+    bool bAllocationLoaded = false;
+    std::set<uint64_t> setVisited;
+    std::function<bool(const uint8_t*, size_t, int)> fnWalk =
+        [&](const uint8_t* pHeader, size_t nAvailable, int nDepth) -> bool {
+        std::vector<IndexNodeEntry> vecNode;
+        if (nDepth >= MAX_INDEX_DEPTH || !ParseIndexNode(pHeader, nAvailable, vecNode)) {
+            strError = "目录索引已损坏（记录 " + std::to_string(ui64Directory) + "）";
+            return false;
+        }
+        for (const IndexNodeEntry& stcNode : vecNode) {
+            if (stcNode.bSubnode) {
+                if (!bAllocationLoaded) {
+                    if (!LoadStream(ui64Directory, ATTR_INDEX_ALLOCATION, INDEX_NAME_I30, stcAllocation, strError)) {
+                        return false;
+                    }
+                    bAllocationLoaded = true;
+                }
+                if (!setVisited.insert(stcNode.ui64SubnodeVcn).second) {
+                    strError = "目录索引已损坏（记录 " + std::to_string(ui64Directory) + "）";
+                    return false;
+                }
+                std::vector<uint8_t> vecBlock;
+                if (!ReadIndexBlock(stcAllocation, ui32BlockSize, stcNode.ui64SubnodeVcn, vecBlock, strError) ||
+                    !fnWalk(vecBlock.data() + 0x18, vecBlock.size() - 0x18, nDepth + 1)) {
+                    return false;
+                }
+            }
+            if (stcNode.bLast) {
+                break;
+            }
+            const uint8_t* pKey = stcNode.pEntry + 0x10;
+            IndexEntry stcEntry;
+            stcEntry.ui64Reference = Read64(stcNode.pEntry);
+            stcEntry.ui64Record = stcEntry.ui64Reference & MFT_REFERENCE_MASK;
+            stcEntry.vecKey.assign(pKey, pKey + Read16(stcNode.pEntry + 10));
+            stcEntry.strName = IndexKeyName(stcNode.pEntry);
+            stcEntry.ui8Namespace = pKey[0x41];
+            stcEntry.ui32Flags = Read32(pKey + 0x38);
+            stcEntry.ui64Size = Read64(pKey + 0x30);
+            stcEntry.ui64ModifiedTime = Read64(pKey + 0x10);
+            vecEntries.push_back(std::move(stcEntry));
+        }
+        return true;
+    };
+    return fnWalk(stcRoot.vecResident.data() + 0x10, stcRoot.vecResident.size() - 0x10, 0);
+}
+
+/********************************************************************************
+* 函数实现：按路径查找记录（内部辅助）
+*********************************************************************************/
+bool NtfsVolume::ResolvePath(const std::string& strPath, uint64_t& ui64Record, std::string& strName,
+                             std::string& strError) {
+    if (!m_pDevice) {
+        strError = "NTFS卷未打开";
+        return false;
+    }
+    ui64Record = MFT_RECORD_ROOT;
+    strName.clear();
+    size_t nPos = 0;
+    while (nPos <= strPath.size()) {
+        size_t nEnd = strPath.find_first_of("\\/", nPos);
+        if (nEnd == std::string::npos) nEnd = strPath.size();
+        std::string strComponent = strPath.substr(nPos, nEnd - nPos);
+        nPos = nEnd + 1;
+        if (strComponent.empty() || strComponent == ".") {
+            continue;
+        }
+        if (strComponent == "..") {
+            strError = "路径中不支持\"..\"：" + strPath;
+            return false;
+        }
+        IndexEntry stcEntry;
+        if (!FindInDirectory(ui64Record, Utf8ToUtf16(strComponent), stcEntry, strError)) {
+            strError = strPath + "：" + strError;
+            return false;
+        }
+        ui64Record = stcEntry.ui64Record;
+        strName = stcEntry.ui8Namespace == FILE_NAME_DOS ? strComponent : Utf16ToUtf8(stcEntry.strName);
+        if (nEnd < strPath.size() && strPath.find_first_not_of("\\/", nEnd) != std::string::npos &&
+            !(stcEntry.ui32Flags & FILE_ATTR_DUP_INDEX_PRESENT)) {
+            strError = strPath + "：" + strName + " 不是目录";
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取记录的文件信息（内部辅助）
+*********************************************************************************/
+bool NtfsVolume::StatRecord(uint64_t ui64Record, NtfsFileInfo& stcInfo, NtfsStream* pData, std::string& strError) {
+    std::vector<uint8_t> vecRecord;
+    if (!ReadRecord(ui64Record, vecRecord, strError)) {
+        return false;
+    }
+    return StatRecord(ui64Record, vecRecord, stcInfo, pData, strError);
+}
+
+bool NtfsVolume::StatRecord(uint64_t ui64Record, const std::vector<uint8_t>& vecRecord, NtfsFileInfo& stcInfo,
+                            NtfsStream* pData, std::string& strError) {
+    stcInfo = NtfsFileInfo();
+    stcInfo.ui64Record = ui64Record;
+    stcInfo.bDirectory = (Read16(vecRecord.data() + 0x16) & RECORD_FLAG_DIRECTORY) != 0;
+    for (const uint8_t* pAttr : ListAttributes(vecRecord)) {
+        if (pAttr[8] != 0) continue;
+        const uint8_t* pValue = pAttr + Read16(pAttr + 0x14);
+        uint32_t ui32ValueLength = Read32(pAttr + 0x10);
+        if (Read32(pAttr) == ATTR_STANDARD_INFORMATION && ui32ValueLength >= 0x24) {
+            stcInfo.ui64ModifiedTime = Read64(pValue + 0x08);
+            stcInfo.ui32Attributes = Read32(pValue + 0x20);
+        } else if (Read32(pAttr) == ATTR_FILE_NAME && ui32ValueLength >= 0x42 && stcInfo.strName.empty() &&
+                   pValue[0x41] != FILE_NAME_DOS && 0x42 + 2 * static_cast<size_t>(pValue[0x40]) <= ui32ValueLength) {
+            std::u16string strName(pValue[0x40], u'\0');
+            memcpy(&strName[0], pValue + 0x42, strName.size() * 2);
+            stcInfo.strName = Utf16ToUtf8(strName);
+        }
+    }
+    if (stcInfo.bDirectory) {
+        stcInfo.ui32Attributes |= FILE_ATTR_DIRECTORY;
+        return true;
+    }
+
+    NtfsStream stcData;
+    if (!LoadStream(ui64Record, vecRecord, ATTR_DATA, u"", stcData, strError)) {
+        return false;
+    }
+    stcInfo.ui64Size = stcData.ui64DataSize;
+    if (pData) {
+        *pData = std::move(stcData);
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：查询文件信息
+*********************************************************************************/
+bool NtfsVolume::Stat(const std::string& strPath, NtfsFileInfo& stcInfo, std::string& strError) {
+    uint64_t ui64Record = 0;
+    std::string strName;
+    if (!ResolvePath(strPath, ui64Record, strName, strError) || !StatRecord(ui64Record, stcInfo, nullptr, strError)) {
+        return false;
+    }
+    if (!strName.empty()) {
+        stcInfo.strName = strName;      // 硬链接时使用路径中的名称
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：列出目录
+*********************************************************************************/
+bool NtfsVolume::ListDirectory(const std::string& strPath, std::vector<NtfsFileInfo>& vecEntries,
+                               std::string& strError) {
+    vecEntries.clear();
+    uint64_t ui64Record = 0;
+    std::string strName;
+    if (!ResolvePath(strPath, ui64Record, strName, strError)) {
+        return false;
+    }
+    std::vector<IndexEntry> vecIndex;
+    if (!EnumerateDirectory(ui64Record, vecIndex, strError)) {
+        strError = strPath + "：" + strError;
+        return false;
+    }
+
+    // 跳过8.3短文件名项和元数据文件（根目录中的$MFT等以及"."）
+    for (const IndexEntry& stcEntry : vecIndex) {
+        if (stcEntry.ui8Namespace == FILE_NAME_DOS || stcEntry.ui64Record < FIRST_USER_RECORD) {
+            continue;
+        }
+        NtfsFileInfo stcInfo;
+        stcInfo.ui64Record = stcEntry.ui64Record;
+        stcInfo.strName = Utf16ToUtf8(stcEntry.strName);
+        stcInfo.bDirectory = (stcEntry.ui32Flags & FILE_ATTR_DUP_INDEX_PRESENT) != 0;
+        stcInfo.ui64Size = stcInfo.bDirectory ? 0 : stcEntry.ui64Size;
+        stcInfo.ui64ModifiedTime = stcEntry.ui64ModifiedTime;
+        stcInfo.ui32Attributes = stcEntry.ui32Flags & ~FILE_ATTR_DUP_INDEX_PRESENT;
+        if (stcInfo.bDirectory) stcInfo.ui32Attributes |= FILE_ATTR_DIRECTORY;
+        vecEntries.push_back(std::move(stcInfo));
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：打开文件
+*********************************************************************************/
+bool NtfsVolume::OpenFile(const std::string& strPath, NtfsFile& objFile, std::string& strError) {
+    objFile = NtfsFile();
+    uint64_t ui64Record = 0;
+    std::string strName;
+    if (!ResolvePath(strPath, ui64Record, strName, strError)) {
+        return false;
+    }
+    NtfsFileInfo stcInfo;
+    NtfsStream stcData;
+    if (!StatRecord(ui64Record, stcInfo, &stcData, strError)) {
+        strError = strPath + "：" + strError;
+        return false;
+    }
+    if (!strName.empty()) stcInfo.strName = strName;
+    if (stcInfo.bDirectory) {
+        strError = strPath + " 是目录";
+        return false;
+    }
+    if ((stcInfo.ui32Attributes & FILE_ATTR_ENCRYPTED) || (stcData.ui16Flags & ATTR_FLAG_ENCRYPTED)) {
+        strError = strPath + " 已使用EFS加密，无法读取";
+        return false;
+    }
+
+    // WOF压缩（CompactOS）的文件内容在备用数据流中，未命名$DATA是空的稀疏流
+    NtfsStream stcReparse;
+    if ((stcInfo.ui32Attributes & FILE_ATTR_REPARSE_POINT) &&
+        LoadStream(ui64Record, ATTR_REPARSE_POINT, u"", stcReparse, strError) &&
+        stcReparse.bResident && stcReparse.vecResident.size() >= 4 &&
+        Read32(stcReparse.vecResident.data()) == IO_REPARSE_TAG_WOF) {
+        strError = strPath + " 使用WOF压缩（CompactOS），暂不支持读取";
+        return false;
+    }
+
+    objFile.m_pVolume = this;
+    objFile.m_stcInfo = std::move(stcInfo);
+    objFile.m_stcStream = std::move(stcData);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取整个文件
+*********************************************************************************/
+bool NtfsVolume::ReadFile(const std::string& strPath, std::vector<char>& vecData, std::string& strError) {
+    NtfsFile objFile;
+    if (!OpenFile(strPath, objFile, strError)) {
+        return false;
+    }
+    if (objFile.Size() > MAX_READ_FILE_BYTES) {
+        strError = strPath + " 太大（" + std::to_string(objFile.Size()) + " 字节），请使用OpenFile分段读取";
+        return false;
+    }
+    vecData.resize(static_cast<size_t>(objFile.Size()));
+    size_t nRead = 0;
+    return objFile.Read(0, vecData.data(), vecData.size(), nRead, strError);
+}
+
+/********************************************************************************
+* 函数实现：是否Windows系统卷
+*********************************************************************************/
+bool NtfsVolume::IsWindowsSystemVolume(BlockDevice& objVolume) {
+    NtfsVolume objNtfs;
+    NtfsFileInfo stcInfo;
+    std::string strIgnored;
+    return objNtfs.Open(objVolume, strIgnored) &&
+           objNtfs.Stat("Windows\\System32", stcInfo, strIgnored) && stcInfo.bDirectory;
+}
+
+/********************************************************************************
+* 函数实现：读取文件数据
+*********************************************************************************/
+bool NtfsFile::Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, size_t& nRead, std::string& strError) {
+    nRead = 0;
+    if (!m_pVolume) {
+        strError = "文件未打开";
+        return false;
+    }
+    if (ui64Offset >= m_stcStream.ui64DataSize) {
+        return true;
+    }
+    uint64_t ui64Available = m_stcStream.ui64DataSize - ui64Offset;
+    size_t nBytesToRead = ui64Available < nBytes ? static_cast<size_t>(ui64Available) : nBytes;
+    if (!m_pVolume->ReadStream(m_stcStream, ui64Offset, pBuffer, nBytesToRead, strError)) {
+        return false;
+    }
+    nRead = nBytesToRead;
+    return true;
+}
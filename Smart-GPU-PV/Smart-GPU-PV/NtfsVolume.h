@@ -0,0 +1,249 @@
+﻿/********************************************************************************
+* 文件名称：NtfsVolume.h
+* 文件功能：不挂载直接读取NTFS卷（虚拟机磁盘镜像中的文件系统）
+*
+* 类说明：
+*    查看虚拟机的Windows\System32\HostDriverStore过去必须先挂载VHDX，再
+*    通过主机文件系统遍历。NtfsVolume在块设备接口之上实现只读的NTFS解析，
+*    工具代码可以直接从镜像文件列出目录、读取文件：
+*    - 引导扇区：簇大小、MFT位置、MFT记录大小、索引块大小
+*    - MFT记录：更新序列（fixup）校验、属性遍历、属性列表（$ATTRIBUTE_LIST）
+*      把属性分散到多个扩展记录的情况
+*    - 运行列表（runlist）：非常驻属性的簇映射，包括稀疏运行
+*    - 常驻和非常驻数据：超出已初始化大小的部分读出为0
+*    - LZNT1压缩流：按压缩单元解压
+*    - 目录索引（$I30）：在B+树中按$UpCase表大小写不敏感地查找文件名，
+*      或按顺序遍历全部项
+*
+* 限制：
+*    - 只读；EFS加密文件、WOF压缩文件（CompactOS）返回错误
+*    - 只读取未命名的$DATA流（不支持备用数据流）
+*
+* 依赖项：
+*    - BlockDevice（块设备接口）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "BlockDevice.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/********************************************************************************
+* 结构体名称：NTFS文件信息
+*********************************************************************************/
+struct NtfsFileInfo {
+    uint64_t    ui64Record = 0;             // MFT记录号
+    std::string strName;                    // 文件名（UTF-8，长文件名）
+    bool        bDirectory = false;         // 是否目录
+    uint64_t    ui64Size = 0;               // 文件大小（目录为0）
+    uint64_t    ui64ModifiedTime = 0;       // 修改时间（FILETIME，UTC）
+    uint32_t    ui32Attributes = 0;         // 文件属性（FILE_ATTRIBUTE_*）
+};
+
+/********************************************************************************
+* 结构体名称：NTFS属性流
+* 结构体功能：一个属性（$DATA、$INDEX_ALLOCATION等）的全部数据位置
+*********************************************************************************/
+struct NtfsStream {
+    struct Run {
+        uint64_t ui64Vcn;                   // 起始虚拟簇号
+        uint64_t ui64Lcn;                   // 起始逻辑簇号（SPARSE_LCN表示稀疏）
+        uint64_t ui64Length;                // 簇数
+    };
+    static const uint64_t SPARSE_LCN = ~0ULL;
+
+    bool                 bResident = false;         // 是否常驻属性
+    std::vector<uint8_t> vecResident;               // 常驻属性的值
+    std::vector<Run>     vecRuns;                   // 非常驻属性的运行（按VCN排序）
+    uint64_t             ui64DataSize = 0;          // 数据大小
+    uint64_t             ui64InitializedSize = 0;   // 已初始化大小
+    uint64_t             ui64AllocatedSize = 0;     // 分配大小
+    uint32_t             ui32CompressionUnit = 0;   // 压缩单元的簇数（0表示未压缩）
+    uint16_t             ui16Flags = 0;             // 属性标志（压缩/加密/稀疏）
+};
+
+class NtfsVolume;
+
+/********************************************************************************
+* 类名称：NTFS文件
+* 类功能：已打开的文件数据流，按偏移读取
+*********************************************************************************/
+class NtfsFile {
+public:
+    const NtfsFileInfo& Info() const { return m_stcInfo; }
+    uint64_t Size() const { return m_stcStream.ui64DataSize; }
+
+    /********************************************************************************
+    * 函数名称：读取
+    * 函数参数：
+    *    [IN]  uint64_t ui64Offset：文件偏移
+    *    [OUT] void* pBuffer：缓冲区
+    *    [IN]  size_t nBytes：最多读取的字节数
+    *    [OUT] size_t& nRead：实际读取的字节数（到达文件末尾时小于nBytes）
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *********************************************************************************/
+    bool Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, size_t& nRead, std::string& strError);
+
+private:
+    friend class NtfsVolume;
+    NtfsVolume*  m_pVolume = nullptr;   // 所属卷
+    NtfsFileInfo m_stcInfo;             // 文件信息
+    NtfsStream   m_stcStream;           // 未命名$DATA流
+};
+
+/********************************************************************************
+* 类名称：NTFS卷
+* 类功能：解析NTFS文件系统，按路径查找、列出目录、读取文件
+*
+* 调用示例：
+*    PartitionDevice objPartition(objDisk, stcPartition.ui64Offset, stcPartition.ui64Length);
+*    NtfsVolume objVolume;
+*    std::vector<NtfsFileInfo> vecEntries;
+*    if (objVolume.Open(objPartition, strError) &&
+*        objVolume.ListDirectory("Windows\\System32\\HostDriverStore", vecEntries, strError)) {
+*        // vecEntries 为目录中的文件和子目录
+*    }
+*
+* 注意事项：
+*    - 路径使用UTF-8，分隔符可以是'\'或'/'，相对于卷根目录，大小写不敏感
+*    - Open之后对象的状态不再改变，多个线程可以同时查找和读取
+*      （块设备本身保证并发安全）
+*********************************************************************************/
+class NtfsVolume {
+public:
+    /********************************************************************************
+    * 函数名称：打开卷
+    * 函数参数：
+    *    [IN]  BlockDevice& objVolume：卷所在的块设备（分区视图），在本对象之后销毁
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    引导扇区无效、$MFT或$UpCase无法读取时返回false
+    *********************************************************************************/
+    bool Open(BlockDevice& objVolume, std::string& strError);
+
+    uint32_t ClusterSize() const { return m_ui32ClusterSize; }
+    uint64_t TotalClusters() const { return m_ui64TotalClusters; }
+
+    /********************************************************************************
+    * 函数名称：查询文件信息
+    * 函数参数：
+    *    [IN]  const std::string& strPath：路径（空字符串表示根目录）
+    *    [OUT] NtfsFileInfo& stcInfo：文件信息（大小和时间取自文件本身的记录）
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    路径不存在时返回false
+    *********************************************************************************/
+    bool Stat(const std::string& strPath, NtfsFileInfo& stcInfo, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：列出目录
+    * 函数参数：
+    *    [IN]  const std::string& strPath：目录路径
+    *    [OUT] std::vector<NtfsFileInfo>& vecEntries：目录项（按文件名排序）
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    * 注意事项：
+    *    - 只返回长文件名（跳过8.3短文件名项），一个文件的多个硬链接分别返回
+    *    - 跳过NTFS元数据文件（根目录中的$MFT、$Bitmap等）
+    *    - 大小和时间取自目录索引，Windows延迟更新这些值，可能与Stat结果不同
+    *********************************************************************************/
+    bool ListDirectory(const std::string& strPath, std::vector<NtfsFileInfo>& vecEntries, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：打开文件
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径
+    *    [OUT] NtfsFile& objFile：文件
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    路径是目录、文件已加密或使用WOF压缩时返回false
+    *********************************************************************************/
+    bool OpenFile(const std::string& strPath, NtfsFile& objFile, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：读取整个文件
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径
+    *    [OUT] std::vector<char>& vecData：文件内容
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *********************************************************************************/
+    bool ReadFile(const std::string& strPath, std::vector<char>& vecData, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：是否Windows系统卷
+    * 函数参数：
+    *    [IN]  BlockDevice& objVolume：卷
+    * 返回类型：bool
+    *    卷是NTFS且存在Windows\System32目录时返回true
+    * 注意事项：
+    *    - 签名与PartitionTable::VolumeProbe一致，可直接作为探测函数使用
+    *********************************************************************************/
+    static bool IsWindowsSystemVolume(BlockDevice& objVolume);
+
+    // 特殊MFT记录
+    static const uint64_t MFT_RECORD_MFT = 0;
+    static const uint64_t MFT_RECORD_ROOT = 5;
+    static const uint64_t MFT_RECORD_UPCASE = 10;
+
+private:
+    friend class NtfsFile;
+    friend class NtfsWriter;
+
+    // 一条目录索引项（键为$FILE_NAME）
+    struct IndexEntry {
+        uint64_t       ui64Record;          // 文件记录号
+        uint64_t       ui64Reference;       // 文件引用（记录号和序列号）
+        std::vector<uint8_t> vecKey;        // 原始键（$FILE_NAME的值）
+        std::u16string strName;             // 文件名
+        uint8_t        ui8Namespace;        // 命名空间（0 POSIX，1 Win32，2 DOS，3 Win32&DOS）
+        uint32_t       ui32Flags;           // 文件属性
+        uint64_t       ui64Size;            // 文件大小
+        uint64_t       ui64ModifiedTime;    // 修改时间
+    };
+
+    BlockDevice*          m_pDevice = nullptr;      // 卷所在块设备
+    uint32_t              m_ui32ClusterSize = 0;    // 簇大小
+    uint64_t              m_ui64TotalClusters = 0;  // 簇总数
+    uint32_t              m_ui32RecordSize = 0;     // MFT记录大小
+    uint32_t              m_ui32IndexBlockSize = 0; // 默认索引块大小
+    NtfsStream            m_stcMft;                 // $MFT的数据流
+    std::vector<char16_t> m_vecUpcase;              // $UpCase表（65536项）
+
+    bool ReadRecord(uint64_t ui64Record, std::vector<uint8_t>& vecRecord, std::string& strError);
+    bool LoadStream(uint64_t ui64Record, uint32_t ui32Type, const std::u16string& strName,
+                    NtfsStream& stcStream, std::string& strError);
+    bool LoadStream(uint64_t ui64Record, const std::vector<uint8_t>& vecBase, uint32_t ui32Type,
+                    const std::u16string& strName, NtfsStream& stcStream, std::string& strError);
+    bool ReadStream(const NtfsStream& stcStream, uint64_t ui64Offset, void* pBuffer, size_t nBytes,
+                    std::string& strError);
+    bool ReadCompressed(const NtfsStream& stcStream, uint64_t ui64Offset, char* pBuffer, size_t nBytes,
+                        std::string& strError);
+    bool ReadRuns(const NtfsStream& stcStream, uint64_t ui64Offset, char* pBuffer, size_t nBytes,
+                  std::string& strError);
+    bool ReadIndexBlock(const NtfsStream& stcAllocation, uint32_t ui32BlockSize, uint64_t ui64Vcn,
+                        std::vector<uint8_t>& vecBlock, std::string& strError);
+    bool FindInDirectory(uint64_t ui64Directory, const std::u16string& strName, IndexEntry& stcEntry,
+                         std::string& strError);
+    bool EnumerateDirectory(uint64_t ui64Directory, std::vector<IndexEntry>& vecEntries, std::string& strError);
+    bool ResolvePath(const std::string& strPath, uint64_t& ui64Record, std::string& strName, std::string& strError);
+    bool StatRecord(uint64_t ui64Record, NtfsFileInfo& stcInfo, NtfsStream* pData, std::string& strError);
+    bool StatRecord(uint64_t ui64Record, const std::vector<uint8_t>& vecRecord, NtfsFileInfo& stcInfo,
+                    NtfsStream* pData, std::string& strError);
+    int CompareNames(const std::u16string& strA, const std::u16string& strB) const;
+
+    // 记录格式辅助（NtfsWriter共用）
+    static bool ApplyFixups(uint8_t* p, size_t nBytes);
+    static std::vector<const uint8_t*> ListAttributes(const std::vector<uint8_t>& vecRecord);
+    static std::u16string AttributeName(const uint8_t* pAttr);
+    static const uint8_t* FindAttribute(const std::vector<uint8_t>& vecRecord, uint32_t ui32Type,
+                                        const std::u16string& strName);
+    static std::string Utf16ToUtf8(const std::u16string& str);
+    static std::u16string Utf8ToUtf16(const std::string& str);
+};
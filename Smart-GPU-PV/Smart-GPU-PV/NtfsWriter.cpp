@@ -0,0 +1,1992 @@
+﻿/********************************************************************************
+* 文件名称：NtfsWriter.cpp
+* 文件功能：实现不挂载写入NTFS卷（文件、目录、MFT记录、位图和目录索引）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "NtfsWriter.h"
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+
+// 属性类型
+static const uint32_t ATTR_STANDARD_INFORMATION = 0x10;
+static const uint32_t ATTR_ATTRIBUTE_LIST = 0x20;
+static const uint32_t ATTR_FILE_NAME = 0x30;
+static const uint32_t ATTR_OBJECT_ID = 0x40;
+static const uint32_t ATTR_VOLUME_INFORMATION = 0x70;
+static const uint32_t ATTR_DATA = 0x80;
+static const uint32_t ATTR_INDEX_ROOT = 0x90;
+static const uint32_t ATTR_INDEX_ALLOCATION = 0xA0;
+static const uint32_t ATTR_BITMAP = 0xB0;
+static const uint32_t ATTR_REPARSE_POINT = 0xC0;
+static const uint32_t ATTR_LOGGED_UTILITY_STREAM = 0x100;
+static const uint32_t ATTR_END = 0xFFFFFFFF;
+
+// MFT记录标志
+static const uint16_t RECORD_FLAG_IN_USE = 0x0001;
+static const uint16_t RECORD_FLAG_DIRECTORY = 0x0002;
+
+// 索引项和索引头标志
+static const uint16_t INDEX_ENTRY_SUBNODE = 0x0001;
+static const uint16_t INDEX_ENTRY_LAST = 0x0002;
+static const uint8_t INDEX_HEADER_LARGE = 0x01;
+
+// 文件属性
+static const uint32_t FILE_ATTR_SETTABLE = 0x000021A7;      // 只读、隐藏、系统、存档、普通、临时、不索引
+static const uint32_t FILE_ATTR_SPARSE = 0x00000200;
+static const uint32_t FILE_ATTR_COMPRESSED = 0x00000800;
+static const uint32_t FILE_ATTR_ENCRYPTED = 0x00004000;
+static const uint32_t FILE_ATTR_DUP_INDEX_PRESENT = 0x10000000;
+
+// 卷标志
+static const uint16_t VOLUME_IS_DIRTY = 0x0001;
+static const uint16_t RESTART_AREA_CLEAN = 0x0002;
+static const uint16_t LOGFILE_NO_CLIENT = 0xFFFF;
+
+static const uint8_t FILE_NAME_WIN32 = 1;
+static const uint8_t FILE_NAME_DOS = 2;
+static const uint64_t MFT_REFERENCE_MASK = 0x0000FFFFFFFFFFFFULL;
+static const uint64_t MFT_RECORD_MIRROR = 1;
+static const uint64_t MFT_RECORD_LOGFILE = 2;
+static const uint64_t MFT_RECORD_VOLUME = 3;
+static const uint64_t MFT_RECORD_BITMAP = 6;
+static const uint64_t FIRST_USER_RECORD = 16;           // 0~15为元数据文件
+static const uint64_t FIRST_FREE_RECORD = 24;           // 16~23保留给元数据文件
+static const uint64_t MFT_EXTEND_RECORDS = 256;         // 每次扩展$MFT增加的记录数
+static const size_t FIXUP_STRIDE = 512;
+static const size_t SI_VALUE_SIZE = 0x48;
+static const size_t MAX_NAME_LENGTH = 255;
+static const size_t DATA_BUFFER_SIZE = 1024 * 1024;
+static const size_t MAX_PENDING_RECORDS = 1024;
+static const uint64_t MAX_PENDING_BYTES = 256ULL * 1024 * 1024;
+static const uint64_t MAX_READ_FILE_BYTES = 1ULL << 31;
+static const std::u16string INDEX_NAME_I30 = u"$I30";
+
+static inline uint16_t Read16(const uint8_t* p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint32_t Read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint64_t Read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline void Write16(uint8_t* p, uint16_t v) { memcpy(p, &v, sizeof(v)); }
+static inline void Write32(uint8_t* p, uint32_t v) { memcpy(p, &v, sizeof(v)); }
+static inline void Write64(uint8_t* p, uint64_t v) { memcpy(p, &v, sizeof(v)); }
+static inline size_t Align8(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
+
+/********************************************************************************
+* 函数实现：当前时间（FILETIME，内部辅助）
+*********************************************************************************/
+static uint64_t CurrentFileTime() {
+    using namespace std::chrono;
+    uint64_t ui64Ticks = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count() / 100;
+    return ui64Ticks + 116444736000000000ULL;           // 1601-01-01到1970-01-01
+}
+
+/********************************************************************************
+* 函数实现：保护记录（内部辅助）
+* 说明：ApplyFixups的逆操作；先递增更新序列号（跳过0和0xFFFF），再把每个
+*       512字节段的最后两个字节保存到更新序列数组并替换为序列号
+*********************************************************************************/
+static bool ProtectRecord(uint8_t* p, size_t nBytes) {
+    uint16_t ui16Offset = Read16(p + 4);
+    uint16_t ui16Count = Read16(p + 6);
+    if (ui16Count < 2 || (ui16Count - 1) * FIXUP_STRIDE != nBytes ||
+        static_cast<size_t>(ui16Offset) + ui16Count * 2 > FIXUP_STRIDE - 2) {
+        return false;
+    }
+    uint16_t ui16Sequence = static_cast<uint16_t>(Read16(p + ui16Offset) + 1);
+    if (ui16Sequence == 0 || ui16Sequence == 0xFFFF) ui16Sequence = 1;
+    Write16(p + ui16Offset, ui16Sequence);
+    for (uint16_t i = 1; i < ui16Count; i++) {
+        uint8_t* pTail = p + i * FIXUP_STRIDE - 2;
+        memcpy(p + ui16Offset + 2 * i, pTail, 2);
+        Write16(pTail, ui16Sequence);
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：编码运行列表（内部辅助）
+* 说明：与NtfsVolume中的解码对应；长度和偏移都用最少的字节数，偏移是相对
+*       上一个运行的有符号差值
+*********************************************************************************/
+static std::vector<uint8_t> EncodeRuns(const std::vector<NtfsStream::Run>& vecRuns) {
+    std::vector<uint8_t> vecBytes;
+    int64_t i64PreviousLcn = 0;
+    for (const NtfsStream::Run& stcRun : vecRuns) {
+        uint8_t ui8Length[8];
+        size_t nLengthBytes = 0;
+        for (uint64_t v = stcRun.ui64Length; v != 0 || nLengthBytes == 0; v >>= 8) {
+            ui8Length[nLengthBytes++] = static_cast<uint8_t>(v);
+        }
+        uint8_t ui8Offset[8];
+        size_t nOffsetBytes = 0;
+        if (stcRun.ui64Lcn != NtfsStream::SPARSE_LCN) {
+            int64_t i64Delta = static_cast<int64_t>(stcRun.ui64Lcn) - i64PreviousLcn;
+            i64PreviousLcn = static_cast<int64_t>(stcRun.ui64Lcn);
+            // 写入字节直到剩余值只是符号扩展，且已写入的最高位与符号一致
+            do {
+                ui8Offset[nOffsetBytes++] = static_cast<uint8_t>(i64Delta);
+                i64Delta >>= 8;
+            } while (nOffsetBytes < 8 && !((i64Delta == 0 && !(ui8Offset[nOffsetBytes - 1] & 0x80)) ||
+                                           (i64Delta == -1 && (ui8Offset[nOffsetBytes - 1] & 0x80))));
+        }
+        vecBytes.push_back(static_cast<uint8_t>(nLengthBytes | (nOffsetBytes << 4)));
+        vecBytes.insert(vecBytes.end(), ui8Length, ui8Length + nLengthBytes);
+        vecBytes.insert(vecBytes.end(), ui8Offset, ui8Offset + nOffsetBytes);
+    }
+    vecBytes.push_back(0);
+    return vecBytes;
+}
+
+/********************************************************************************
+* 函数实现：构造常驻属性（内部辅助）
+*********************************************************************************/
+static std::vector<uint8_t> MakeResident(uint32_t ui32Type, const std::u16string& strName,
+                                         const std::vector<uint8_t>& vecValue, uint16_t ui16Instance,
+                                         bool bIndexed) {
+    size_t nValueOffset = Align8(0x18 + strName.size() * 2);
+    std::vector<uint8_t> vecAttr(Align8(nValueOffset + vecValue.size()), 0);
+    uint8_t* p = vecAttr.data();
+    Write32(p, ui32Type);
+    Write32(p + 4, static_cast<uint32_t>(vecAttr.size()));
+    p[9] = static_cast<uint8_t>(strName.size());
+    Write16(p + 0x0A, 0x18);
+    Write16(p + 0x0E, ui16Instance);
+    Write32(p + 0x10, static_cast<uint32_t>(vecValue.size()));
+    Write16(p + 0x14, static_cast<uint16_t>(nValueOffset));
+    p[0x16] = bIndexed ? 1 : 0;
+    if (!strName.empty()) memcpy(p + 0x18, strName.data(), strName.size() * 2);
+    if (!vecValue.empty()) memcpy(p + nValueOffset, vecValue.data(), vecValue.size());
+    return vecAttr;
+}
+
+/********************************************************************************
+* 函数实现：构造非常驻属性（内部辅助）
+*********************************************************************************/
+static std::vector<uint8_t> MakeNonResident(uint32_t ui32Type, const std::u16string& strName,
+                                            const std::vector<NtfsStream::Run>& vecRuns, uint64_t ui64AllocatedSize,
+                                            uint64_t ui64DataSize, uint16_t ui16Instance) {
+    std::vector<uint8_t> vecRunBytes = EncodeRuns(vecRuns);
+    size_t nRunsOffset = Align8(0x40 + strName.size() * 2);
+    std::vector<uint8_t> vecAttr(Align8(nRunsOffset + vecRunBytes.size()), 0);
+    uint8_t* p = vecAttr.data();
+    uint64_t ui64Clusters = 0;
+    for (const NtfsStream::Run& stcRun : vecRuns) ui64Clusters += stcRun.ui64Length;
+    Write32(p, ui32Type);
+    Write32(p + 4, static_cast<uint32_t>(vecAttr.size()));
+    p[8] = 1;
+    p[9] = static_cast<uint8_t>(strName.size());
+    Write16(p + 0x0A, 0x40);
+    Write16(p + 0x0E, ui16Instance);
+    Write64(p + 0x10, 0);
+    Write64(p + 0x18, ui64Clusters - 1);
+    Write16(p + 0x20, static_cast<uint16_t>(nRunsOffset));
+    Write64(p + 0x28, ui64AllocatedSize);
+    Write64(p + 0x30, ui64DataSize);
+    Write64(p + 0x38, ui64DataSize);
+    if (!strName.empty()) memcpy(p + 0x40, strName.data(), strName.size() * 2);
+    memcpy(p + nRunsOffset, vecRunBytes.data(), vecRunBytes.size());
+    return vecAttr;
+}
+
+/********************************************************************************
+* 函数实现：在位图中查找下一个空闲位或已用位（内部辅助）
+* 说明：整字节为0xFF（查找空闲）或0x00（查找已用）时跳过整个字节；
+*       没有找到时返回ui64Limit
+*********************************************************************************/
+static uint64_t NextBit(const std::vector<uint8_t>& vecBits, uint64_t ui64Start, uint64_t ui64Limit, bool bUsed) {
+    const uint8_t ui8Skip = bUsed ? 0x00 : 0xFF;
+    uint64_t i = ui64Start;
+    while (i < ui64Limit) {
+        uint8_t ui8Byte = vecBits[static_cast<size_t>(i >> 3)];
+        if ((i & 7) == 0 && ui8Byte == ui8Skip) {
+            i += 8;
+            continue;
+        }
+        if (((ui8Byte >> (i & 7)) & 1) == (bUsed ? 1 : 0)) {
+            return i;
+        }
+        i++;
+    }
+    return ui64Limit;
+}
+
+/********************************************************************************
+* 函数实现：开始会话
+*********************************************************************************/
+bool NtfsWriter::Begin(BlockDevice& objVolume, std::string& strError) {
+    if (m_bActive) {
+        strError = "NTFS写入会话已经开始";
+        return false;
+    }
+    m_pDevice = nullptr;
+    m_bFailed = false;
+    m_bUnsupported = false;
+    m_mapDirectories.clear();
+    m_mapPendingRecords.clear();
+    m_ui64PendingBytes = 0;
+    m_vecFreeClusters.clear();
+    m_vecFreeRecords.clear();
+    m_mapWrittenSizes.clear();
+    m_stcStats = NtfsWriteStats();
+
+    // 1. 打开卷
+    if (objVolume.IsReadOnly()) {
+        strError = "卷以只读方式打开，无法写入";
+        return false;
+    }
+    if (!m_objVolume.Open(objVolume, strError)) {
+        return false;
+    }
+    m_pDevice = &objVolume;
+
+    // 2. 虚拟机必须已完全关机：$LogFile干净，且没有休眠（快速启动也会写入休眠文件）
+    if (!CheckLogFile(strError)) {
+        return false;
+    }
+    std::vector<char> vecHiber;
+    NtfsFile objHiber;
+    std::string strIgnored;
+    char szSignature[4] = {};
+    size_t nRead = 0;
+    if (m_objVolume.OpenFile("hiberfil.sys", objHiber, strIgnored) &&
+        objHiber.Read(0, szSignature, sizeof(szSignature), nRead, strIgnored) && nRead == sizeof(szSignature)) {
+        for (char& ch : szSignature) ch = static_cast<char>(ch | 0x20);
+        if (memcmp(szSignature, "hibr", 4) == 0) {
+            strError = "虚拟机中的Windows处于休眠状态（可能是快速启动），请在虚拟机中完全关机后重试";
+            return false;
+        }
+    }
+
+    // 3. $Volume：已标记为需要检查的卷不修改
+    std::vector<uint8_t> vecRecord;
+    if (!m_objVolume.ReadRecord(MFT_RECORD_VOLUME, vecRecord, strError)) {
+        return false;
+    }
+    const uint8_t* pInfo = NtfsVolume::FindAttribute(vecRecord, ATTR_VOLUME_INFORMATION, u"");
+    if (!pInfo || pInfo[8] != 0 || Read32(pInfo + 0x10) < 0x0C) {
+        strError = "$Volume记录已损坏";
+        return false;
+    }
+    const uint8_t* pInfoValue = pInfo + Read16(pInfo + 0x14);
+    if (pInfoValue[8] != 3) {
+        strError = "不支持的NTFS版本 " + std::to_string(pInfoValue[8]) + "." + std::to_string(pInfoValue[9]);
+        return false;
+    }
+    m_ui16VolumeFlags = Read16(pInfoValue + 0x0A);
+    if (m_ui16VolumeFlags & VOLUME_IS_DIRTY) {
+        strError = "卷已标记为需要检查，请先在虚拟机中运行chkdsk";
+        return false;
+    }
+
+    // 4. $MFTMirr、$Bitmap和$MFT的$BITMAP
+    if (!m_objVolume.LoadStream(MFT_RECORD_MIRROR, ATTR_DATA, u"", m_stcMirror, strError) ||
+        m_stcMirror.bResident) {
+        strError = "无法加载$MFTMirr" + (strError.empty() ? "" : "：" + strError);
+        return false;
+    }
+    m_ui64MirrorRecords = m_stcMirror.ui64InitializedSize / m_objVolume.m_ui32RecordSize;
+    if (!LoadBitmap(MFT_RECORD_BITMAP, ATTR_DATA, m_objClusters, strError) ||
+        !LoadBitmap(NtfsVolume::MFT_RECORD_MFT, ATTR_BITMAP, m_objRecords, strError)) {
+        return false;
+    }
+    if (m_objClusters.vecBits.size() * 8 < m_objVolume.m_ui64TotalClusters) {
+        strError = "$Bitmap小于卷的簇数";
+        return false;
+    }
+    if (!m_objVolume.ReadRecord(NtfsVolume::MFT_RECORD_ROOT, vecRecord, strError)) {
+        return false;
+    }
+    m_ui64RootReference = NtfsVolume::MFT_RECORD_ROOT | (static_cast<uint64_t>(Read16(vecRecord.data() + 0x10)) << 48);
+
+    // 5. 簇分配从MFT保留区之后开始（与Windows一致，避免把MFT挤得更碎）
+    const NtfsStream::Run& stcLastMft = m_objVolume.m_stcMft.vecRuns.back();
+    m_ui64NextCluster = stcLastMft.ui64Lcn + stcLastMft.ui64Length + m_objVolume.m_ui64TotalClusters / 8;
+    if (m_ui64NextCluster >= m_objVolume.m_ui64TotalClusters) m_ui64NextCluster = 0;
+    m_ui64NextRecord = FIRST_FREE_RECORD;
+
+    // 6. 设置"需要检查"标记并落盘，之后的修改即使中途失败也会由chkdsk修复
+    if (!SetVolumeFlags(m_ui16VolumeFlags | VOLUME_IS_DIRTY, strError) || !Barrier(strError)) {
+        return false;
+    }
+    m_bActive = true;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：检查$LogFile（内部辅助）
+* 说明：重启页（"RSTR"，chkdsk处理过的为"CHKD"）在$LogFile开头，另有一份
+*       副本紧随其后；重启区中没有活动的日志客户端或带有"干净"标志时，
+*       卷上没有需要重做的事务。全为0xFF表示日志已被重置
+*********************************************************************************/
+bool NtfsWriter::CheckLogFile(std::string& strError) {
+    NtfsStream stcLog;
+    if (!m_objVolume.LoadStream(MFT_RECORD_LOGFILE, ATTR_DATA, u"", stcLog, strError)) {
+        strError = "无法加载$LogFile：" + strError;
+        return false;
+    }
+    std::vector<uint8_t> vecPage(4096);
+    if (stcLog.ui64DataSize < vecPage.size() ||
+        !m_objVolume.ReadStream(stcLog, 0, vecPage.data(), vecPage.size(), strError)) {
+        strError = "无法读取$LogFile" + (strError.empty() ? "" : "：" + strError);
+        return false;
+    }
+    if (std::all_of(vecPage.begin(), vecPage.end(), [](uint8_t b) { return b == 0xFF; })) {
+        return true;
+    }
+
+    uint64_t ui64Offset = 0;
+    for (int nCopy = 0; nCopy < 2; nCopy++) {
+        if (nCopy == 1) {
+            vecPage.assign(4096, 0);
+            if (ui64Offset + vecPage.size() > stcLog.ui64DataSize ||
+                !m_objVolume.ReadStream(stcLog, ui64Offset, vecPage.data(), vecPage.size(), strError)) {
+                break;
+            }
+        }
+        uint32_t ui32PageSize = Read32(vecPage.data() + 0x10);
+        bool bPageSize = ui32PageSize >= FIXUP_STRIDE && ui32PageSize <= 65536 &&
+                         (ui32PageSize & (ui32PageSize - 1)) == 0;
+        bool bValid = bPageSize && ui64Offset + ui32PageSize <= stcLog.ui64DataSize &&
+                      (memcmp(vecPage.data(), "RSTR", 4) == 0 || memcmp(vecPage.data(), "CHKD", 4) == 0);
+        if (bValid) {
+            vecPage.resize(ui32PageSize);
+            bValid = m_objVolume.ReadStream(stcLog, ui64Offset, vecPage.data(), vecPage.size(), strError) &&
+                     NtfsVolume::ApplyFixups(vecPage.data(), vecPage.size()) &&
+                     Read16(vecPage.data() + 0x18) + 0x10u <= vecPage.size();
+        }
+        if (bValid) {
+            const uint8_t* pArea = vecPage.data() + Read16(vecPage.data() + 0x18);
+            if (Read16(pArea + 0x0C) == LOGFILE_NO_CLIENT || (Read16(pArea + 0x0E) & RESTART_AREA_CLEAN)) {
+                return true;
+            }
+            strError = "卷的日志中有未完成的事务（虚拟机没有正常关机，或处于休眠/快速启动），"
+                       "请启动虚拟机后在其中完全关机再重试";
+            return false;
+        }
+        // 第一份重启页无效时检查副本（位于一个系统页之后）
+        ui64Offset = bPageSize ? ui32PageSize : 4096;
+    }
+    strError = "$LogFile的重启页已损坏，请在虚拟机中运行chkdsk";
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：修改卷标志（内部辅助）
+*********************************************************************************/
+bool NtfsWriter::SetVolumeFlags(uint16_t ui16Flags, std::string& strError) {
+    std::vector<uint8_t> vecRecord;
+    bool bValid = false;
+    if (!ReadRecordRaw(MFT_RECORD_VOLUME, vecRecord, bValid, strError)) {
+        return false;
+    }
+    const uint8_t* pInfo = bValid ? NtfsVolume::FindAttribute(vecRecord, ATTR_VOLUME_INFORMATION, u"") : nullptr;
+    if (!pInfo || pInfo[8] != 0 || Read32(pInfo + 0x10) < 0x0C) {
+        strError = "$Volume记录已损坏";
+        return false;
+    }
+    size_t nValue = (pInfo - vecRecord.data()) + Read16(pInfo + 0x14);
+    Write16(vecRecord.data() + nValue + 0x0A, ui16Flags);
+    return StoreRecord(MFT_RECORD_VOLUME, vecRecord, strError);
+}
+
+/********************************************************************************
+* 函数实现：刷新屏障和失败处理（内部辅助）
+* 说明：块设备写入或刷新失败后不知道哪些数据已经落盘，会话不再继续，
+*       卷保持"需要检查"标记
+*********************************************************************************/
+bool NtfsWriter::Barrier(std::string& strError) {
+    if (!m_pDevice->Flush(strError)) {
+        return Fail(strError);
+    }
+    return true;
+}
+
+bool NtfsWriter::Fail(std::string& strError) {
+    m_bFailed = true;
+    strError = "写入虚拟磁盘失败，卷已标记为需要检查：" + strError;
+    return false;
+}
+
+bool NtfsWriter::CheckActive(std::string& strError) {
+    if (!m_bActive) {
+        strError = "NTFS写入会话未开始";
+        return false;
+    }
+    if (m_bFailed) {
+        strError = "之前的写入失败，NTFS写入会话不能继续";
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：加载位图（内部辅助）
+* 说明：位图必须是非常驻的且已全部初始化，写回时按字节范围写入原位置
+*********************************************************************************/
+bool NtfsWriter::LoadBitmap(uint64_t ui64Record, uint32_t ui32Type, Bitmap& objBitmap, std::string& strError) {
+    objBitmap = Bitmap();
+    const char* pszName = ui64Record == MFT_RECORD_BITMAP ? "$Bitmap" : "$MFT的位图";
+    if (!m_objVolume.LoadStream(ui64Record, ui32Type, u"", objBitmap.stcStream, strError)) {
+        strError = std::string("无法加载") + pszName + "：" + strError;
+        return false;
+    }
+    const NtfsStream& stcStream = objBitmap.stcStream;
+    if (stcStream.bResident || stcStream.ui32CompressionUnit != 0 ||
+        stcStream.ui64InitializedSize != stcStream.ui64DataSize || stcStream.ui64DataSize > (1ULL << 31)) {
+        strError = std::string(pszName) + "的存储方式不受支持";
+        return false;
+    }
+    objBitmap.vecBits.resize(static_cast<size_t>(stcStream.ui64DataSize));
+    return m_objVolume.ReadStream(stcStream, 0, objBitmap.vecBits.data(), objBitmap.vecBits.size(), strError);
+}
+
+bool NtfsWriter::FlushBitmap(Bitmap& objBitmap, std::string& strError) {
+    if (objBitmap.ui64DirtyBegin >= objBitmap.ui64DirtyEnd) {
+        return true;
+    }
+    uint64_t ui64Begin = objBitmap.ui64DirtyBegin;
+    uint64_t ui64End = objBitmap.ui64DirtyEnd;
+    if (ui64End > objBitmap.vecBits.size()) ui64End = objBitmap.vecBits.size();
+    objBitmap.ui64DirtyBegin = ~0ULL;
+    objBitmap.ui64DirtyEnd = 0;
+    return WriteStream(objBitmap.stcStream, ui64Begin, objBitmap.vecBits.data() + ui64Begin,
+                       static_cast<size_t>(ui64End - ui64Begin), strError);
+}
+
+void NtfsWriter::SetBits(Bitmap& objBitmap, uint64_t ui64First, uint64_t ui64Count, bool bValue) {
+    for (uint64_t i = ui64First; i < ui64First + ui64Count; i++) {
+        uint8_t& ui8Byte = objBitmap.vecBits[static_cast<size_t>(i >> 3)];
+        if (bValue) ui8Byte |= static_cast<uint8_t>(1 << (i & 7));
+        else ui8Byte &= static_cast<uint8_t>(~(1 << (i & 7)));
+    }
+    if (ui64Count == 0) return;
+    if ((ui64First >> 3) < objBitmap.ui64DirtyBegin) objBitmap.ui64DirtyBegin = ui64First >> 3;
+    if (((ui64First + ui64Count - 1) >> 3) + 1 > objBitmap.ui64DirtyEnd) {
+        objBitmap.ui64DirtyEnd = ((ui64First + ui64Count - 1) >> 3) + 1;
+    }
+}
+
+/********************************************************************************
+* 函数实现：写入属性流或运行（内部辅助）
+* 说明：只写入已分配、已初始化的范围，不改变属性大小
+*********************************************************************************/
+bool NtfsWriter::WriteStream(const NtfsStream& stcStream, uint64_t ui64Offset, const void* pBuffer, size_t nBytes,
+                             std::string& strError) {
+    if (stcStream.bResident || stcStream.ui32CompressionUnit != 0 ||
+        ui64Offset > stcStream.ui64InitializedSize || nBytes > stcStream.ui64InitializedSize - ui64Offset) {
+        strError = "写入超出属性范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+    return WriteRuns(stcStream.vecRuns, ui64Offset, pBuffer, nBytes, strError);
+}
+
+bool NtfsWriter::WriteRuns(const std::vector<NtfsStream::Run>& vecRuns, uint64_t ui64Offset, const void* pBuffer,
+                           size_t nBytes, std::string& strError) {
+    const uint64_t ui64ClusterSize = m_objVolume.m_ui32ClusterSize;
+    const char* pSource = static_cast<const char*>(pBuffer);
+    for (const NtfsStream::Run& stcRun : vecRuns) {
+        if (nBytes == 0) break;
+        uint64_t ui64RunBegin = stcRun.ui64Vcn * ui64ClusterSize;
+        uint64_t ui64RunEnd = ui64RunBegin + stcRun.ui64Length * ui64ClusterSize;
+        if (ui64Offset >= ui64RunEnd) continue;
+        if (ui64Offset < ui64RunBegin || stcRun.ui64Lcn == NtfsStream::SPARSE_LCN) {
+            strError = "写入位置不在已分配的簇中（偏移 " + std::to_string(ui64Offset) + "）";
+            return false;
+        }
+        uint64_t ui64Available = ui64RunEnd - ui64Offset;
+        size_t nChunk = ui64Available < nBytes ? static_cast<size_t>(ui64Available) : nBytes;
+        if (!m_pDevice->Write(stcRun.ui64Lcn * ui64ClusterSize + (ui64Offset - ui64RunBegin), pSource, nChunk,
+                              strError)) {
+            return Fail(strError);
+        }
+        ui64Offset += nChunk;
+        pSource += nChunk;
+        nBytes -= nChunk;
+    }
+    if (nBytes != 0) {
+        strError = "写入超出运行列表范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取MFT记录（内部辅助）
+* 说明：先查找等待写入的记录；空闲记录也会读出，bValid表示签名和更新序列有效
+*********************************************************************************/
+bool NtfsWriter::ReadRecordRaw(uint64_t ui64Record, std::vector<uint8_t>& vecRecord, bool& bValid,
+                               std::string& strError) {
+    auto it = m_mapPendingRecords.find(ui64Record);
+    if (it != m_mapPendingRecords.end()) {
+        vecRecord = it->second;
+        bValid = true;
+        return true;
+    }
+    const uint32_t ui32RecordSize = m_objVolume.m_ui32RecordSize;
+    if (ui64Record >= m_objVolume.m_stcMft.ui64DataSize / ui32RecordSize) {
+        strError = "MFT记录号超出范围（" + std::to_string(ui64Record) + "）";
+        return false;
+    }
+    vecRecord.resize(ui32RecordSize);
+    if (!m_objVolume.ReadStream(m_objVolume.m_stcMft, ui64Record * ui32RecordSize, vecRecord.data(),
+                                vecRecord.size(), strError)) {
+        return false;
+    }
+    bValid = memcmp(vecRecord.data(), "FILE", 4) == 0 && NtfsVolume::ApplyFixups(vecRecord.data(), vecRecord.size());
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：写入MFT记录（内部辅助）
+* 说明：WriteRecord把记录放入待写队列，引用的新数据落盘之后再由
+*       FlushPendingRecords写入；StoreRecord立即写入，前4个记录同时写入$MFTMirr
+*********************************************************************************/
+bool NtfsWriter::WriteRecord(uint64_t ui64Record, const std::vector<uint8_t>& vecRecord, std::string& strError) {
+    m_mapPendingRecords[ui64Record] = vecRecord;
+    if (m_mapPendingRecords.size() >= MAX_PENDING_RECORDS || m_ui64PendingBytes >= MAX_PENDING_BYTES) {
+        return FlushPendingRecords(strError);
+    }
+    return true;
+}
+
+bool NtfsWriter::StoreRecord(uint64_t ui64Record, const std::vector<uint8_t>& vecRecord, std::string& strError) {
+    std::vector<uint8_t> vecImage = vecRecord;
+    if (!ProtectRecord(vecImage.data(), vecImage.size())) {
+        strError = "MFT记录 " + std::to_string(ui64Record) + " 的更新序列无效";
+        return false;
+    }
+    const uint64_t ui64Offset = ui64Record * m_objVolume.m_ui32RecordSize;
+    if (!WriteStream(m_objVolume.m_stcMft, ui64Offset, vecImage.data(), vecImage.size(), strError)) {
+        return false;
+    }
+    if (ui64Record < m_ui64MirrorRecords &&
+        !WriteStream(m_stcMirror, ui64Offset, vecImage.data(), vecImage.size(), strError)) {
+        return false;
+    }
+    m_mapPendingRecords.erase(ui64Record);
+    return true;
+}
+
+bool NtfsWriter::FlushPendingRecords(std::string& strError) {
+    if (m_mapPendingRecords.empty()) {
+        return true;
+    }
+    // 先让新分配的簇和记录在位图中落盘，崩溃时最多泄漏空间，不会出现引用空闲簇的记录
+    if (!FlushBitmap(m_objClusters, strError) || !FlushBitmap(m_objRecords, strError) || !Barrier(strError)) {
+        return false;
+    }
+    std::map<uint64_t, std::vector<uint8_t>> mapRecords;
+    mapRecords.swap(m_mapPendingRecords);
+    for (const auto& pairRecord : mapRecords) {
+        if (!StoreRecord(pairRecord.first, pairRecord.second, strError)) {
+            return false;
+        }
+    }
+    m_ui64PendingBytes = 0;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：拆分和重组MFT记录（内部辅助）
+* 说明：重组时属性按类型和名称排序，记录末尾写入结束标记
+*********************************************************************************/
+bool NtfsWriter::ParseRecord(const std::vector<uint8_t>& vecRecord, RecordImage& objImage, std::string& strError) {
+    uint16_t ui16First = Read16(vecRecord.data() + 0x14);
+    if (ui16First < 0x30 || ui16First >= vecRecord.size()) {
+        strError = "MFT记录 " + std::to_string(Read32(vecRecord.data() + 0x2C)) + " 已损坏";
+        return false;
+    }
+    objImage.vecHeader.assign(vecRecord.begin(), vecRecord.begin() + ui16First);
+    objImage.vecAttributes.clear();
+    for (const uint8_t* pAttr : NtfsVolume::ListAttributes(vecRecord)) {
+        objImage.vecAttributes.emplace_back(pAttr, pAttr + Read32(pAttr + 4));
+    }
+    return true;
+}
+
+bool NtfsWriter::ComposeRecord(const RecordImage& objImage, std::vector<uint8_t>& vecRecord, std::string& strError) {
+    const uint32_t ui32RecordSize = m_objVolume.m_ui32RecordSize;
+    std::vector<const std::vector<uint8_t>*> vecSorted;
+    for (const std::vector<uint8_t>& vecAttr : objImage.vecAttributes) vecSorted.push_back(&vecAttr);
+    std::stable_sort(vecSorted.begin(), vecSorted.end(),
+        [](const std::vector<uint8_t>* a, const std::vector<uint8_t>* b) {
+            uint32_t ui32TypeA = Read32(a->data());
+            uint32_t ui32TypeB = Read32(b->data());
+            if (ui32TypeA != ui32TypeB) return ui32TypeA < ui32TypeB;
+            return NtfsVolume::AttributeName(a->data()) < NtfsVolume::AttributeName(b->data());
+        });
+
+    size_t nPos = Align8(objImage.vecHeader.size());
+    size_t nUsed = nPos + 8;
+    for (const std::vector<uint8_t>* pAttr : vecSorted) nUsed += pAttr->size();
+    if (nUsed > ui32RecordSize) {
+        strError = "MFT记录空间不足";
+        return false;
+    }
+    vecRecord.assign(ui32RecordSize, 0);
+    memcpy(vecRecord.data(), objImage.vecHeader.data(), objImage.vecHeader.size());
+    Write16(vecRecord.data() + 0x14, static_cast<uint16_t>(nPos));
+    for (const std::vector<uint8_t>* pAttr : vecSorted) {
+        memcpy(vecRecord.data() + nPos, pAttr->data(), pAttr->size());
+        nPos += pAttr->size();
+    }
+    Write32(vecRecord.data() + nPos, ATTR_END);
+    Write32(vecRecord.data() + 0x18, static_cast<uint32_t>(nUsed));
+    Write32(vecRecord.data() + 0x1C, ui32RecordSize);
+    return true;
+}
+
+uint16_t NtfsWriter::NextInstance(RecordImage& objImage) {
+    uint16_t ui16Instance = Read16(objImage.vecHeader.data() + 0x28);
+    Write16(objImage.vecHeader.data() + 0x28, static_cast<uint16_t>(ui16Instance + 1));
+    return ui16Instance;
+}
+
+/********************************************************************************
+* 函数实现：属性列表操作（内部辅助）
+*********************************************************************************/
+static bool HasAttribute(const std::vector<std::vector<uint8_t>>& vecAttributes, uint32_t ui32Type) {
+    for (const std::vector<uint8_t>& vecAttr : vecAttributes) {
+        if (Read32(vecAttr.data()) == ui32Type) return true;
+    }
+    return false;
+}
+
+void NtfsWriter::RemoveAttributes(std::vector<std::vector<uint8_t>>& vecAttributes, uint32_t ui32Type,
+                             const std::u16string& strName) {
+    vecAttributes.erase(std::remove_if(vecAttributes.begin(), vecAttributes.end(),
+        [&](const std::vector<uint8_t>& vecAttr) {
+            return Read32(vecAttr.data()) == ui32Type && NtfsVolume::AttributeName(vecAttr.data()) == strName;
+        }), vecAttributes.end());
+}
+
+/********************************************************************************
+* 函数实现：分配簇（内部辅助）
+* 说明：先从上次分配的位置向后查找足够长的连续空闲空间（到末尾后从头开始），
+*       找不到时按同样顺序拼接多个空闲段；返回的运行VCN从0开始。
+*       本次会话中释放的簇在提交时才清除位图，不会被重新分配
+*********************************************************************************/
+bool NtfsWriter::AllocateClusters(uint64_t ui64Count, std::vector<NtfsStream::Run>& vecRuns, std::string& strError) {
+    vecRuns.clear();
+    const std::vector<uint8_t>& vecBits = m_objClusters.vecBits;
+    const uint64_t ui64Total = m_objVolume.m_ui64TotalClusters;
+    uint64_t ui64Hint = m_ui64NextCluster < ui64Total ? m_ui64NextCluster : 0;
+    if (ui64Count == 0) {
+        return true;
+    }
+
+    // 1. 连续空间
+    bool bFound = false;
+    for (int nPass = 0; nPass < 2 && !bFound; nPass++) {
+        uint64_t ui64End = nPass == 0 ? ui64Total : ui64Hint;
+        uint64_t ui64Free = NextBit(vecBits, nPass == 0 ? ui64Hint : 0, ui64End, false);
+        while (ui64Free < ui64End) {
+            uint64_t ui64Used = NextBit(vecBits, ui64Free, ui64End, true);
+            if (ui64Used - ui64Free >= ui64Count) {
+                vecRuns.push_back({ 0, ui64Free, ui64Count });
+                bFound = true;
+                break;
+            }
+            ui64Free = NextBit(vecBits, ui64Used, ui64End, false);
+        }
+    }
+
+    // 2. 多个空闲段
+    uint64_t ui64Remaining = ui64Count;
+    for (int nPass = 0; nPass < 2 && !bFound; nPass++) {
+        uint64_t ui64End = nPass == 0 ? ui64Total : ui64Hint;
+        uint64_t ui64Free = NextBit(vecBits, nPass == 0 ? ui64Hint : 0, ui64End, false);
+        while (ui64Free < ui64End && ui64Remaining > 0) {
+            uint64_t ui64Used = NextBit(vecBits, ui64Free, ui64End, true);
+            uint64_t ui64Length = ui64Used - ui64Free;
+            if (ui64Length > ui64Remaining) ui64Length = ui64Remaining;
+            vecRuns.push_back({ ui64Count - ui64Remaining, ui64Free, ui64Length });
+            ui64Remaining -= ui64Length;
+            ui64Free = NextBit(vecBits, ui64Used, ui64End, false);
+        }
+        bFound = ui64Remaining == 0;
+    }
+    if (!bFound) {
+        vecRuns.clear();
+        strError = "虚拟磁盘的空闲空间不足（需要 " + std::to_string(ui64Count) + " 簇）";
+        return false;
+    }
+    for (const NtfsStream::Run& stcRun : vecRuns) {
+        SetBits(m_objClusters, stcRun.ui64Lcn, stcRun.ui64Length, true);
+    }
+    m_ui64NextCluster = vecRuns.back().ui64Lcn + vecRuns.back().ui64Length;
+    return true;
+}
+
+void NtfsWriter::ReleaseClusters(const std::vector<NtfsStream::Run>& vecRuns) {
+    for (const NtfsStream::Run& stcRun : vecRuns) {
+        if (stcRun.ui64Lcn != NtfsStream::SPARSE_LCN) {
+            SetBits(m_objClusters, stcRun.ui64Lcn, stcRun.ui64Length, false);
+        }
+    }
+}
+
+/********************************************************************************
+* 函数实现：分配MFT记录（内部辅助）
+* 说明：在$MFT的位图中查找空闲记录；位图为空闲但记录头仍标记为使用中的
+*       （位图与记录不一致）跳过。沿用空闲记录的序列号，删除文件时Windows
+*       已经递增过序列号，旧的文件引用不会指向新文件
+*********************************************************************************/
+bool NtfsWriter::AllocateRecord(uint64_t& ui64Record, RecordImage& objImage, std::string& strError) {
+    const uint32_t ui32RecordSize = m_objVolume.m_ui32RecordSize;
+    for (int nPass = 0; nPass < 2; nPass++) {
+        uint64_t ui64Limit = m_objVolume.m_stcMft.ui64InitializedSize / ui32RecordSize;
+        if (ui64Limit > m_objRecords.vecBits.size() * 8) ui64Limit = m_objRecords.vecBits.size() * 8;
+        std::vector<uint8_t> vecOld;
+        for (uint64_t i = NextBit(m_objRecords.vecBits, m_ui64NextRecord, ui64Limit, false); i < ui64Limit;
+             i = NextBit(m_objRecords.vecBits, i + 1, ui64Limit, false)) {
+            bool bValid = false;
+            if (!ReadRecordRaw(i, vecOld, bValid, strError)) {
+                return false;
+            }
+            if (bValid && (Read16(vecOld.data() + 0x16) & RECORD_FLAG_IN_USE)) {
+                continue;
+            }
+            uint16_t ui16Sequence = bValid ? Read16(vecOld.data() + 0x10) : 0;
+            uint16_t ui16Count = static_cast<uint16_t>(ui32RecordSize / FIXUP_STRIDE + 1);
+            objImage.vecHeader.assign(Align8(0x30 + 2 * ui16Count), 0);
+            objImage.vecAttributes.clear();
+            uint8_t* p = objImage.vecHeader.data();
+            memcpy(p, "FILE", 4);
+            Write16(p + 4, 0x30);
+            Write16(p + 6, ui16Count);
+            if (bValid) Write16(p + 0x30, Read16(vecOld.data() + Read16(vecOld.data() + 4)));
+            Write16(p + 0x10, ui16Sequence == 0 ? 1 : ui16Sequence);
+            Write32(p + 0x2C, static_cast<uint32_t>(i));
+            SetBits(m_objRecords, i, 1, true);
+            m_ui64NextRecord = i + 1;
+            ui64Record = i;
+            return true;
+        }
+        if (nPass == 0 && !ExtendMft(strError)) {
+            return false;
+        }
+    }
+    strError = "没有可用的MFT记录";
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：扩展$MFT（内部辅助）
+* 说明：1. 优先在$MFT最后一个运行之后分配簇，写入空白记录并刷新
+*       2. 扩大$MFT位图的有效大小（只使用已分配的空间）
+*       3. 写入新的$MFT记录0（含镜像），之后新记录才可以使用
+*********************************************************************************/
+bool NtfsWriter::ExtendMft(std::string& strError) {
+    const uint32_t ui32RecordSize = m_objVolume.m_ui32RecordSize;
+    const uint32_t ui32ClusterSize = m_objVolume.m_ui32ClusterSize;
+    const NtfsStream& stcMft = m_objVolume.m_stcMft;
+    std::vector<uint8_t> vecRecord;
+    bool bValid = false;
+    RecordImage objImage;
+    if (!ReadRecordRaw(NtfsVolume::MFT_RECORD_MFT, vecRecord, bValid, strError) || !bValid ||
+        !ParseRecord(vecRecord, objImage, strError)) {
+        strError = "无法读取$MFT记录" + (strError.empty() ? "" : "：" + strError);
+        return false;
+    }
+    if (HasAttribute(objImage.vecAttributes, ATTR_ATTRIBUTE_LIST) ||
+        stcMft.ui64DataSize != stcMft.ui64AllocatedSize || stcMft.ui64InitializedSize != stcMft.ui64DataSize) {
+        strError = "MFT记录已用完，且$MFT的结构不支持扩展";
+        return false;
+    }
+
+    // 1. 分配并初始化新记录所在的簇
+    uint64_t ui64Clusters = (MFT_EXTEND_RECORDS * ui32RecordSize + ui32ClusterSize - 1) / ui32ClusterSize;
+    uint64_t ui64Added = ui64Clusters * ui32ClusterSize / ui32RecordSize;
+    uint64_t ui64OldRecords = stcMft.ui64DataSize / ui32RecordSize;
+    uint64_t ui64BitmapBytes = Align8(static_cast<size_t>((ui64OldRecords + ui64Added + 7) / 8));
+    if (ui64BitmapBytes > m_objRecords.stcStream.ui64AllocatedSize) {
+        strError = "MFT记录已用完，且$MFT的位图没有扩展空间";
+        return false;
+    }
+    std::vector<NtfsStream::Run> vecRuns;
+    const NtfsStream::Run& stcLast = stcMft.vecRuns.back();
+    uint64_t ui64Adjacent = stcLast.ui64Lcn + stcLast.ui64Length;
+    if (ui64Adjacent + ui64Clusters <= m_objVolume.m_ui64TotalClusters &&
+        NextBit(m_objClusters.vecBits, ui64Adjacent, ui64Adjacent + ui64Clusters, true) == ui64Adjacent + ui64Clusters) {
+        vecRuns.push_back({ 0, ui64Adjacent, ui64Clusters });
+        SetBits(m_objClusters, ui64Adjacent, ui64Clusters, true);
+    } else if (!AllocateClusters(ui64Clusters, vecRuns, strError)) {
+        return false;
+    }
+
+    uint16_t ui16Count = static_cast<uint16_t>(ui32RecordSize / FIXUP_STRIDE + 1);
+    size_t nHeader = Align8(0x30 + 2 * ui16Count);
+    std::vector<uint8_t> vecBlank(static_cast<size_t>(ui64Clusters * ui32ClusterSize), 0);
+    for (uint64_t i = 0; i < ui64Added; i++) {
+        uint8_t* p = vecBlank.data() + i * ui32RecordSize;
+        memcpy(p, "FILE", 4);
+        Write16(p + 4, 0x30);
+        Write16(p + 6, ui16Count);
+        Write16(p + 0x10, 1);
+        Write16(p + 0x14, static_cast<uint16_t>(nHeader));
+        Write32(p + nHeader, ATTR_END);
+        Write32(p + 0x18, static_cast<uint32_t>(nHeader + 8));
+        Write32(p + 0x1C, ui32RecordSize);
+        Write32(p + 0x2C, static_cast<uint32_t>(ui64OldRecords + i));
+        ProtectRecord(p, ui32RecordSize);
+    }
+    if (!WriteRuns(vecRuns, 0, vecBlank.data(), vecBlank.size(), strError) || !Barrier(strError)) {
+        return false;
+    }
+
+    // 2. 新的$DATA运行列表（与最后一个运行相邻时合并）和$BITMAP大小
+    NtfsStream stcNewMft = stcMft;
+    uint64_t ui64Vcn = stcMft.ui64AllocatedSize / ui32ClusterSize;
+    for (const NtfsStream::Run& stcRun : vecRuns) {
+        NtfsStream::Run& stcTail = stcNewMft.vecRuns.back();
+        if (stcTail.ui64Lcn + stcTail.ui64Length == stcRun.ui64Lcn) {
+            stcTail.ui64Length += stcRun.ui64Length;
+        } else {
+            stcNewMft.vecRuns.push_back({ ui64Vcn + stcRun.ui64Vcn, stcRun.ui64Lcn, stcRun.ui64Length });
+        }
+    }
+    stcNewMft.ui64AllocatedSize += ui64Clusters * ui32ClusterSize;
+    stcNewMft.ui64DataSize = stcNewMft.ui64AllocatedSize;
+    stcNewMft.ui64InitializedSize = stcNewMft.ui64AllocatedSize;
+
+    for (std::vector<uint8_t>& vecAttr : objImage.vecAttributes) {
+        uint32_t ui32Type = Read32(vecAttr.data());
+        if (ui32Type == ATTR_DATA && vecAttr[9] == 0) {
+            vecAttr = MakeNonResident(ATTR_DATA, u"", stcNewMft.vecRuns, stcNewMft.ui64AllocatedSize,
+                                      stcNewMft.ui64DataSize, Read16(vecAttr.data() + 0x0E));
+        } else if (ui32Type == ATTR_BITMAP && vecAttr[9] == 0 && vecAttr[8] != 0 &&
+                   ui64BitmapBytes > Read64(vecAttr.data() + 0x30)) {
+            Write64(vecAttr.data() + 0x30, ui64BitmapBytes);
+            Write64(vecAttr.data() + 0x38, ui64BitmapBytes);
+        }
+    }
+    if (!ComposeRecord(objImage, vecRecord, strError)) {
+        ReleaseClusters(vecRuns);
+        strError = "$MFT记录空间不足，无法扩展$MFT";
+        return false;
+    }
+
+    // 3. 先写入位图的新范围，再切换$MFT记录
+    if (ui64BitmapBytes > m_objRecords.vecBits.size()) {
+        uint64_t ui64OldBytes = m_objRecords.vecBits.size();
+        m_objRecords.vecBits.resize(static_cast<size_t>(ui64BitmapBytes), 0);
+        m_objRecords.stcStream.ui64DataSize = ui64BitmapBytes;
+        m_objRecords.stcStream.ui64InitializedSize = ui64BitmapBytes;
+        if (ui64OldBytes < m_objRecords.ui64DirtyBegin) m_objRecords.ui64DirtyBegin = ui64OldBytes;
+        m_objRecords.ui64DirtyEnd = ui64BitmapBytes;
+    }
+    if (!FlushBitmap(m_objRecords, strError) || !FlushBitmap(m_objClusters, strError) || !Barrier(strError) ||
+        !StoreRecord(NtfsVolume::MFT_RECORD_MFT, vecRecord, strError) || !Barrier(strError)) {
+        return false;
+    }
+    m_objVolume.m_stcMft = std::move(stcNewMft);
+    m_stcStats.ui64MftRecordsAdded += ui64Added;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：构造$STANDARD_INFORMATION和$FILE_NAME的值（内部辅助）
+*********************************************************************************/
+static std::vector<uint8_t> MakeStandardInformation(uint64_t ui64Created, uint64_t ui64Modified, uint64_t ui64Accessed,
+                                                    uint32_t ui32Attributes, uint32_t ui32SecurityId) {
+    std::vector<uint8_t> vecValue(SI_VALUE_SIZE, 0);
+    Write64(vecValue.data(), ui64Created);
+    Write64(vecValue.data() + 0x08, ui64Modified);
+    Write64(vecValue.data() + 0x10, ui64Modified);     // MFT记录修改时间
+    Write64(vecValue.data() + 0x18, ui64Accessed);
+    Write32(vecValue.data() + 0x20, ui32Attributes);
+    Write32(vecValue.data() + 0x34, ui32SecurityId);
+    return vecValue;
+}
+
+static std::vector<uint8_t> MakeFileName(uint64_t ui64ParentReference, uint64_t ui64Created, uint64_t ui64Modified,
+                                         uint64_t ui64Accessed, uint64_t ui64AllocatedSize, uint64_t ui64Size,
+                                         uint32_t ui32Flags, const std::u16string& strName) {
+    std::vector<uint8_t> vecValue(0x42 + strName.size() * 2, 0);
+    Write64(vecValue.data(), ui64ParentReference);
+    Write64(vecValue.data() + 0x08, ui64Created);
+    Write64(vecValue.data() + 0x10, ui64Modified);
+    Write64(vecValue.data() + 0x18, ui64Modified);
+    Write64(vecValue.data() + 0x20, ui64Accessed);
+    Write64(vecValue.data() + 0x28, ui64AllocatedSize);
+    Write64(vecValue.data() + 0x30, ui64Size);
+    Write32(vecValue.data() + 0x38, ui32Flags);
+    vecValue[0x40] = static_cast<uint8_t>(strName.size());
+    vecValue[0x41] = FILE_NAME_WIN32;
+    memcpy(vecValue.data() + 0x42, strName.data(), strName.size() * 2);
+    return vecValue;
+}
+
+/********************************************************************************
+* 函数实现：拆分路径（内部辅助）
+* 说明：文件名按Win32规则检查（长度、保留字符），新建的文件只有Win32名称
+*********************************************************************************/
+bool NtfsWriter::SplitPath(const std::string& strPath, std::vector<std::u16string>& vecComponents,
+                           std::string& strError) {
+    vecComponents.clear();
+    size_t nPos = 0;
+    while (nPos <= strPath.size()) {
+        size_t nEnd = strPath.find_first_of("\\/", nPos);
+        if (nEnd == std::string::npos) nEnd = strPath.size();
+        std::string strComponent = strPath.substr(nPos, nEnd - nPos);
+        nPos = nEnd + 1;
+        if (strComponent.empty() || strComponent == ".") {
+            continue;
+        }
+        if (strComponent == "..") {
+            strError = "路径中不支持\"..\"：" + strPath;
+            return false;
+        }
+        std::u16string strName = NtfsVolume::Utf8ToUtf16(strComponent);
+        bool bValid = strName.size() <= MAX_NAME_LENGTH;
+        for (char16_t ch : strName) {
+            if (ch < 0x20 || std::u16string(u"\"*/:<>?\\|").find(ch) != std::u16string::npos) bValid = false;
+        }
+        if (!bValid) {
+            strError = "文件名无效：" + strComponent;
+            return false;
+        }
+        vecComponents.push_back(std::move(strName));
+    }
+    return true;
+}
+
+std::u16string NtfsWriter::SortKey(const std::u16string& strName) const {
+    std::u16string strKey;
+    strKey.reserve(strName.size() * 2 + 1);
+    for (char16_t ch : strName) strKey += m_objVolume.m_vecUpcase[ch];
+    strKey += u'\0';
+    strKey += strName;
+    return strKey;
+}
+
+std::u16string NtfsWriter::KeyName(const std::vector<uint8_t>& vecKey) {
+    std::u16string strName(vecKey[0x40], u'\0');
+    memcpy(&strName[0], vecKey.data() + 0x42, strName.size() * 2);
+    return strName;
+}
+
+/********************************************************************************
+* 函数实现：加载目录索引（内部辅助）
+* 说明：第一次访问时读取全部索引项，之后的查找和修改都在内存中进行；
+*       有属性列表的目录只能读取
+*********************************************************************************/
+bool NtfsWriter::LoadDirectory(uint64_t ui64Directory, Directory*& pDirectory, std::string& strError) {
+    auto it = m_mapDirectories.find(ui64Directory);
+    if (it != m_mapDirectories.end()) {
+        pDirectory = &it->second;
+        return true;
+    }
+    std::vector<uint8_t> vecRecord;
+    bool bValid = false;
+    if (!ReadRecordRaw(ui64Directory, vecRecord, bValid, strError)) {
+        return false;
+    }
+    std::vector<NtfsVolume::IndexEntry> vecEntries;
+    if (!bValid || !m_objVolume.EnumerateDirectory(ui64Directory, vecEntries, strError)) {
+        strError = "无法读取目录（记录 " + std::to_string(ui64Directory) + "）" +
+                   (strError.empty() ? "" : "：" + strError);
+        return false;
+    }
+    Directory objDirectory;
+    objDirectory.bReadOnly = NtfsVolume::FindAttribute(vecRecord, ATTR_ATTRIBUTE_LIST, u"") != nullptr;
+    for (NtfsVolume::IndexEntry& stcEntry : vecEntries) {
+        objDirectory.mapEntries[SortKey(stcEntry.strName)] = { stcEntry.ui64Reference, std::move(stcEntry.vecKey) };
+    }
+    pDirectory = &(m_mapDirectories[ui64Directory] = std::move(objDirectory));
+    return true;
+}
+
+bool NtfsWriter::ModifyDirectory(uint64_t ui64Directory, Directory*& pDirectory, std::string& strError) {
+    if (!LoadDirectory(ui64Directory, pDirectory, strError)) {
+        return false;
+    }
+    if (pDirectory->bReadOnly) {
+        strError = "目录的属性分布在多个MFT记录中（记录 " + std::to_string(ui64Directory) + "），不能离线修改";
+        m_bUnsupported = true;
+        return false;
+    }
+    pDirectory->bDirty = true;
+    return true;
+}
+
+bool NtfsWriter::LookupEntry(uint64_t ui64Directory, const std::u16string& strName, DirectoryEntry& stcEntry,
+                             bool& bFound, std::string& strError) {
+    Directory* pDirectory = nullptr;
+    if (!LoadDirectory(ui64Directory, pDirectory, strError)) {
+        return false;
+    }
+    std::u16string strPrefix = SortKey(strName).substr(0, strName.size() + 1);
+    auto it = pDirectory->mapEntries.lower_bound(strPrefix);
+    bFound = it != pDirectory->mapEntries.end() && it->first.compare(0, strPrefix.size(), strPrefix) == 0;
+    if (bFound) {
+        stcEntry = it->second;
+    }
+    return true;
+}
+
+void NtfsWriter::InsertEntry(Directory& objDirectory, uint64_t ui64Reference, const std::vector<uint8_t>& vecKey) {
+    objDirectory.mapEntries[SortKey(KeyName(vecKey))] = { ui64Reference, vecKey };
+    objDirectory.bDirty = true;
+}
+
+/********************************************************************************
+* 函数实现：逐级解析目录（内部辅助）
+* 说明：解析vecComponents的前nCount级，bCreate为true时创建不存在的目录
+*********************************************************************************/
+bool NtfsWriter::ResolveDirectory(const std::vector<std::u16string>& vecComponents, size_t nCount, bool bCreate,
+                                  uint32_t ui32Attributes, uint64_t& ui64Directory, uint64_t& ui64Reference,
+                                  std::string& strError) {
+    ui64Directory = NtfsVolume::MFT_RECORD_ROOT;
+    ui64Reference = m_ui64RootReference;
+    for (size_t i = 0; i < nCount; i++) {
+        DirectoryEntry stcEntry;
+        bool bFound = false;
+        if (!LookupEntry(ui64Directory, vecComponents[i], stcEntry, bFound, strError)) {
+            return false;
+        }
+        std::string strName = NtfsVolume::Utf16ToUtf8(vecComponents[i]);
+        if (bFound) {
+            if (!(Read32(stcEntry.vecKey.data() + 0x38) & FILE_ATTR_DUP_INDEX_PRESENT)) {
+                strError = strName + " 不是目录";
+                return false;
+            }
+            ui64Reference = stcEntry.ui64Reference;
+        } else if (!bCreate) {
+            strError = "找不到 " + strName;
+            return false;
+        } else if (!MakeDirectory(ui64Directory, ui64Reference, vecComponents[i], ui32Attributes, ui64Reference,
+                                    strError)) {
+            strError = "无法创建目录 " + strName + "：" + strError;
+            return false;
+        }
+        ui64Directory = ui64Reference & MFT_REFERENCE_MASK;
+    }
+    return true;
+}
+
+bool NtfsWriter::ResolveParent(const std::string& strPath, bool bCreate, uint64_t& ui64Parent,
+                               uint64_t& ui64ParentReference, std::u16string& strName, std::string& strError) {
+    std::vector<std::u16string> vecComponents;
+    if (!SplitPath(strPath, vecComponents, strError)) {
+        return false;
+    }
+    if (vecComponents.empty()) {
+        strError = "路径为空";
+        return false;
+    }
+    strName = vecComponents.back();
+    if (!ResolveDirectory(vecComponents, vecComponents.size() - 1, bCreate, 0, ui64Parent, ui64ParentReference,
+                          strError)) {
+        strError = strPath + "：" + strError;
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：按路径查找记录（内部辅助，包含本次会话中的修改）
+*********************************************************************************/
+bool NtfsWriter::LocatePath(const std::string& strPath, uint64_t& ui64Record, std::u16string& strName,
+                            std::string& strError) {
+    std::vector<std::u16string> vecComponents;
+    if (!SplitPath(strPath, vecComponents, strError)) {
+        return false;
+    }
+    uint64_t ui64Reference = 0;
+    if (!ResolveDirectory(vecComponents, vecComponents.empty() ? 0 : vecComponents.size() - 1, false, 0, ui64Record,
+                          ui64Reference, strError)) {
+        strError = strPath + "：" + strError;
+        return false;
+    }
+    strName.clear();
+    if (vecComponents.empty()) {
+        return true;
+    }
+    DirectoryEntry stcEntry;
+    bool bFound = false;
+    if (!LookupEntry(ui64Record, vecComponents.back(), stcEntry, bFound, strError)) {
+        return false;
+    }
+    if (!bFound) {
+        strError = strPath + "：找不到 " + NtfsVolume::Utf16ToUtf8(vecComponents.back());
+        return false;
+    }
+    ui64Record = stcEntry.ui64Reference & MFT_REFERENCE_MASK;
+    strName = stcEntry.vecKey[0x41] == FILE_NAME_DOS ? vecComponents.back() : KeyName(stcEntry.vecKey);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取使用中的记录并拆分（内部辅助）
+*********************************************************************************/
+bool NtfsWriter::ReadImage(uint64_t ui64Record, std::vector<uint8_t>& vecRecord, RecordImage& objImage,
+                           std::string& strError) {
+    bool bValid = false;
+    if (!ReadRecordRaw(ui64Record, vecRecord, bValid, strError)) {
+        return false;
+    }
+    if (!bValid || !(Read16(vecRecord.data() + 0x16) & RECORD_FLAG_IN_USE)) {
+        strError = "MFT记录 " + std::to_string(ui64Record) + " 已损坏或未使用";
+        return false;
+    }
+    return ParseRecord(vecRecord, objImage, strError);
+}
+
+/********************************************************************************
+* 函数实现：父目录的安全ID（内部辅助）
+* 说明：新文件和目录使用父目录的安全描述符（$Secure中已有），其中只对
+*       子对象生效的继承项不影响新对象本身的访问权限
+*********************************************************************************/
+bool NtfsWriter::ParentSecurityId(uint64_t ui64Parent, uint32_t& ui32SecurityId, std::string& strError) {
+    std::vector<uint8_t> vecRecord;
+    RecordImage objImage;
+    if (!ReadImage(ui64Parent, vecRecord, objImage, strError)) {
+        return false;
+    }
+    ui32SecurityId = 0;
+    const uint8_t* pInfo = NtfsVolume::FindAttribute(vecRecord, ATTR_STANDARD_INFORMATION, u"");
+    if (pInfo && pInfo[8] == 0 && Read32(pInfo + 0x10) >= SI_VALUE_SIZE) {
+        ui32SecurityId = Read32(pInfo + Read16(pInfo + 0x14) + 0x34);
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：创建一个目录（内部辅助）
+* 说明：新目录的索引根为空，索引参数（索引块大小等）与父目录相同
+*********************************************************************************/
+bool NtfsWriter::MakeDirectory(uint64_t ui64Parent, uint64_t ui64ParentReference, const std::u16string& strName,
+                                 uint32_t ui32Attributes, uint64_t& ui64Reference, std::string& strError) {
+    Directory* pParent = nullptr;
+    uint32_t ui32SecurityId = 0;
+    std::vector<uint8_t> vecParent;
+    RecordImage objParent;
+    if (!ModifyDirectory(ui64Parent, pParent, strError) || !ParentSecurityId(ui64Parent, ui32SecurityId, strError) ||
+        !ReadImage(ui64Parent, vecParent, objParent, strError)) {
+        return false;
+    }
+    const uint8_t* pParentRoot = NtfsVolume::FindAttribute(vecParent, ATTR_INDEX_ROOT, INDEX_NAME_I30);
+    if (!pParentRoot || pParentRoot[8] != 0 || Read32(pParentRoot + 0x10) < 0x20) {
+        strError = "父目录的索引根已损坏";
+        return false;
+    }
+
+    uint64_t ui64Record = 0;
+    RecordImage objImage;
+    if (!AllocateRecord(ui64Record, objImage, strError)) {
+        return false;
+    }
+    uint8_t* pHeader = objImage.vecHeader.data();
+    Write16(pHeader + 0x12, 1);
+    Write16(pHeader + 0x16, RECORD_FLAG_IN_USE | RECORD_FLAG_DIRECTORY);
+    uint64_t ui64Now = CurrentFileTime();
+    uint32_t ui32Flags = ui32Attributes & FILE_ATTR_SETTABLE;
+    std::vector<uint8_t> vecFileName = MakeFileName(ui64ParentReference, ui64Now, ui64Now, ui64Now, 0, 0,
+                                                    ui32Flags | FILE_ATTR_DUP_INDEX_PRESENT, strName);
+
+    // 索引根：参数（索引的属性类型、排序规则、索引块大小）+ 空节点（只有结束项）
+    std::vector<uint8_t> vecRoot(0x30, 0);
+    memcpy(vecRoot.data(), pParentRoot + Read16(pParentRoot + 0x14), 0x10);
+    Write32(vecRoot.data() + 0x10, 0x10);
+    Write32(vecRoot.data() + 0x14, 0x20);
+    Write32(vecRoot.data() + 0x18, 0x20);
+    Write16(vecRoot.data() + 0x28, 0x10);
+    Write16(vecRoot.data() + 0x2C, INDEX_ENTRY_LAST);
+
+    objImage.vecAttributes.push_back(MakeResident(ATTR_STANDARD_INFORMATION, u"",
+        MakeStandardInformation(ui64Now, ui64Now, ui64Now, ui32Flags, ui32SecurityId), NextInstance(objImage), false));
+    objImage.vecAttributes.push_back(MakeResident(ATTR_FILE_NAME, u"", vecFileName, NextInstance(objImage), true));
+    objImage.vecAttributes.push_back(MakeResident(ATTR_INDEX_ROOT, INDEX_NAME_I30, vecRoot, NextInstance(objImage), false));
+    std::vector<uint8_t> vecRecord;
+    if (!ComposeRecord(objImage, vecRecord, strError)) {
+        SetBits(m_objRecords, ui64Record, 1, false);
+        return false;
+    }
+    if (!WriteRecord(ui64Record, vecRecord, strError)) {
+        return false;
+    }
+    ui64Reference = ui64Record | (static_cast<uint64_t>(Read16(pHeader + 0x10)) << 48);
+    InsertEntry(*pParent, ui64Reference, vecFileName);
+    m_mapDirectories[ui64Record] = Directory();
+    m_stcStats.ui64DirectoriesCreated++;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：创建目录
+*********************************************************************************/
+bool NtfsWriter::CreateDirectories(const std::string& strPath, uint32_t ui32Attributes, std::string& strError) {
+    std::vector<std::u16string> vecComponents;
+    uint64_t ui64Directory = 0;
+    uint64_t ui64Reference = 0;
+    if (!CheckActive(strError) || !SplitPath(strPath, vecComponents, strError)) {
+        return false;
+    }
+    if (!ResolveDirectory(vecComponents, vecComponents.size(), true, ui32Attributes, ui64Directory, ui64Reference,
+                          strError)) {
+        strError = strPath + "：" + strError;
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：查询文件信息
+*********************************************************************************/
+bool NtfsWriter::Stat(const std::string& strPath, NtfsFileInfo& stcInfo, std::string& strError) {
+    uint64_t ui64Record = 0;
+    std::u16string strName;
+    std::vector<uint8_t> vecRecord;
+    RecordImage objImage;
+    if (!CheckActive(strError) || !LocatePath(strPath, ui64Record, strName, strError) ||
+        !ReadImage(ui64Record, vecRecord, objImage, strError) ||
+        !m_objVolume.StatRecord(ui64Record, vecRecord, stcInfo, nullptr, strError)) {
+        return false;
+    }
+    if (!strName.empty()) {
+        stcInfo.strName = NtfsVolume::Utf16ToUtf8(strName);
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取整个文件
+*********************************************************************************/
+bool NtfsWriter::ReadFile(const std::string& strPath, std::vector<char>& vecData, std::string& strError) {
+    uint64_t ui64Record = 0;
+    std::u16string strName;
+    std::vector<uint8_t> vecRecord;
+    RecordImage objImage;
+    NtfsFileInfo stcInfo;
+    NtfsStream stcData;
+    if (!CheckActive(strError) || !LocatePath(strPath, ui64Record, strName, strError) ||
+        !ReadImage(ui64Record, vecRecord, objImage, strError) ||
+        !m_objVolume.StatRecord(ui64Record, vecRecord, stcInfo, &stcData, strError)) {
+        return false;
+    }
+    if (stcInfo.bDirectory) {
+        strError = strPath + " 是目录";
+        return false;
+    }
+    if ((stcInfo.ui32Attributes & FILE_ATTR_ENCRYPTED) || HasAttribute(objImage.vecAttributes, ATTR_REPARSE_POINT)) {
+        strError = strPath + " 已加密或是重解析点，无法读取";
+        return false;
+    }
+    if (stcData.ui64DataSize > MAX_READ_FILE_BYTES) {
+        strError = strPath + " 太大（" + std::to_string(stcData.ui64DataSize) + " 字节）";
+        return false;
+    }
+    vecData.resize(static_cast<size_t>(stcData.ui64DataSize));
+    return m_objVolume.ReadStream(stcData, 0, vecData.data(), vecData.size(), strError);
+}
+
+/********************************************************************************
+* 函数实现：写入文件数据（内部辅助）
+* 说明：不超过nResidentLimit的数据直接放在MFT记录中（常驻），否则分配新簇
+*       并按顺序写入，最后一个簇的剩余部分填0；失败时释放已分配的簇
+*********************************************************************************/
+bool NtfsWriter::WriteData(const NtfsFileProperties& stcProperties, const DataSource& fnRead, size_t nResidentLimit,
+                           bool& bResident, std::vector<uint8_t>& vecValue, std::vector<NtfsStream::Run>& vecRuns,
+                           std::string& strError) {
+    const uint64_t ui64Size = stcProperties.ui64Size;
+    const uint64_t ui64ClusterSize = m_objVolume.m_ui32ClusterSize;
+    vecRuns.clear();
+    vecValue.clear();
+    bResident = ui64Size <= nResidentLimit;
+    if (bResident) {
+        vecValue.resize(static_cast<size_t>(ui64Size));
+        return ui64Size == 0 || fnRead(reinterpret_cast<char*>(vecValue.data()), vecValue.size(), strError);
+    }
+
+    if (!AllocateClusters((ui64Size + ui64ClusterSize - 1) / ui64ClusterSize, vecRuns, strError)) {
+        return false;
+    }
+    size_t nChunk = DATA_BUFFER_SIZE;
+    if (nChunk < ui64ClusterSize) nChunk = static_cast<size_t>(ui64ClusterSize);
+    std::vector<char> vecBuffer(nChunk);
+    for (uint64_t ui64Offset = 0; ui64Offset < ui64Size;) {
+        size_t nBytes = ui64Size - ui64Offset < nChunk ? static_cast<size_t>(ui64Size - ui64Offset) : nChunk;
+        size_t nPadded = static_cast<size_t>((nBytes + ui64ClusterSize - 1) / ui64ClusterSize * ui64ClusterSize);
+        if (!fnRead(vecBuffer.data(), nBytes, strError)) {
+            ReleaseClusters(vecRuns);
+            return false;
+        }
+        memset(vecBuffer.data() + nBytes, 0, nPadded - nBytes);
+        if (!WriteRuns(vecRuns, ui64Offset, vecBuffer.data(), nPadded, strError)) {
+            ReleaseClusters(vecRuns);
+            return false;
+        }
+        ui64Offset += nBytes;
+    }
+    m_ui64PendingBytes += ui64Size;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：把记录中非常驻属性占用的簇加入待释放列表（内部辅助）
+*********************************************************************************/
+bool NtfsWriter::QueueAttributeFrees(uint64_t ui64Record, const std::vector<uint8_t>& vecRecord,
+                                     std::string& strError) {
+    std::vector<std::pair<uint32_t, std::u16string>> vecDone;
+    for (const uint8_t* pAttr : NtfsVolume::ListAttributes(vecRecord)) {
+        std::pair<uint32_t, std::u16string> pairKey(Read32(pAttr), NtfsVolume::AttributeName(pAttr));
+        if (pAttr[8] == 0 || std::find(vecDone.begin(), vecDone.end(), pairKey) != vecDone.end()) {
+            continue;
+        }
+        vecDone.push_back(pairKey);
+        NtfsStream stcStream;
+        if (!m_objVolume.LoadStream(ui64Record, vecRecord, pairKey.first, pairKey.second, stcStream, strError)) {
+            return false;
+        }
+        for (const NtfsStream::Run& stcRun : stcStream.vecRuns) {
+            if (stcRun.ui64Lcn != NtfsStream::SPARSE_LCN) m_vecFreeClusters.push_back(stcRun);
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：检查记录能否离线修改（内部辅助）
+*********************************************************************************/
+bool NtfsWriter::CheckModifiable(const std::vector<std::vector<uint8_t>>& vecAttributes, const std::string& strPath,
+                                 std::string& strError) {
+    if (HasAttribute(vecAttributes, ATTR_ATTRIBUTE_LIST)) {
+        strError = strPath + " 的属性分布在多个MFT记录中，不能离线修改";
+        m_bUnsupported = true;
+        return false;
+    }
+    bool bEncrypted = false;
+    for (const std::vector<uint8_t>& vecAttr : vecAttributes) {
+        if (Read32(vecAttr.data()) == ATTR_LOGGED_UTILITY_STREAM && NtfsVolume::AttributeName(vecAttr.data()) == u"$EFS") {
+            bEncrypted = true;
+        }
+    }
+    if (HasAttribute(vecAttributes, ATTR_REPARSE_POINT) || bEncrypted) {
+        strError = strPath + " 是重解析点（如WOF压缩）或已加密，不能离线修改";
+        m_bUnsupported = true;
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：写入文件
+*********************************************************************************/
+bool NtfsWriter::WriteFile(const std::string& strPath, const NtfsFileProperties& stcProperties,
+                           const DataSource& fnRead, std::string& strError) {
+    uint64_t ui64Parent = 0;
+    uint64_t ui64ParentReference = 0;
+    std::u16string strName;
+    Directory* pParent = nullptr;
+    DirectoryEntry stcExisting;
+    bool bFound = false;
+    uint32_t ui32SecurityId = 0;
+    if (!CheckActive(strError) || !ResolveParent(strPath, true, ui64Parent, ui64ParentReference, strName, strError) ||
+        !ModifyDirectory(ui64Parent, pParent, strError) ||
+        !LookupEntry(ui64Parent, strName, stcExisting, bFound, strError)) {
+        return false;
+    }
+    if (bFound) {
+        if (Read32(stcExisting.vecKey.data() + 0x38) & FILE_ATTR_DUP_INDEX_PRESENT) {
+            strError = strPath + " 是目录";
+            return false;
+        }
+        return OverwriteFile(strPath, ui64Parent, *pParent, stcExisting.ui64Reference, stcProperties, fnRead, strError);
+    }
+    if (!ParentSecurityId(ui64Parent, ui32SecurityId, strError)) {
+        return false;
+    }
+
+    // 1. 分配记录，数据能放进记录时使用常驻$DATA（最多占用半个记录）
+    const uint32_t ui32RecordSize = m_objVolume.m_ui32RecordSize;
+    uint64_t ui64Record = 0;
+    RecordImage objImage;
+    if (!AllocateRecord(ui64Record, objImage, strError)) {
+        return false;
+    }
+    uint8_t* pHeader = objImage.vecHeader.data();
+    Write16(pHeader + 0x12, 1);
+    Write16(pHeader + 0x16, RECORD_FLAG_IN_USE);
+    size_t nUsed = Align8(objImage.vecHeader.size()) + 8 + Align8(0x18 + SI_VALUE_SIZE) +
+                   Align8(0x18 + 0x42 + strName.size() * 2) + 0x18;
+    size_t nResidentLimit = ui32RecordSize > nUsed ? ((ui32RecordSize - nUsed) & ~static_cast<size_t>(7)) : 0;
+    if (nResidentLimit > ui32RecordSize / 2) nResidentLimit = ui32RecordSize / 2;
+
+    // 2. 先写数据，再构造记录
+    bool bResident = false;
+    std::vector<uint8_t> vecValue;
+    std::vector<NtfsStream::Run> vecRuns;
+    if (!WriteData(stcProperties, fnRead, nResidentLimit, bResident, vecValue, vecRuns, strError)) {
+        SetBits(m_objRecords, ui64Record, 1, false);
+        strError = strPath + "：" + strError;
+        return false;
+    }
+    uint64_t ui64Allocated = bResident ? Align8(vecValue.size()) :
+        (stcProperties.ui64Size + m_objVolume.m_ui32ClusterSize - 1) / m_objVolume.m_ui32ClusterSize *
+        m_objVolume.m_ui32ClusterSize;
+    uint32_t ui32Flags = stcProperties.ui32Attributes & FILE_ATTR_SETTABLE;
+    std::vector<uint8_t> vecFileName = MakeFileName(ui64ParentReference, stcProperties.ui64CreationTime,
+        stcProperties.ui64ModifiedTime, stcProperties.ui64AccessTime, ui64Allocated, stcProperties.ui64Size,
+        ui32Flags, strName);
+    objImage.vecAttributes.push_back(MakeResident(ATTR_STANDARD_INFORMATION, u"",
+        MakeStandardInformation(stcProperties.ui64CreationTime, stcProperties.ui64ModifiedTime,
+                                stcProperties.ui64AccessTime, ui32Flags, ui32SecurityId), NextInstance(objImage), false));
+    objImage.vecAttributes.push_back(MakeResident(ATTR_FILE_NAME, u"", vecFileName, NextInstance(objImage), true));
+    objImage.vecAttributes.push_back(bResident ?
+        MakeResident(ATTR_DATA, u"", vecValue, NextInstance(objImage), false) :
+        MakeNonResident(ATTR_DATA, u"", vecRuns, ui64Allocated, stcProperties.ui64Size, NextInstance(objImage)));
+
+    // 3. 记录进入待写队列，目录索引在提交时重建
+    std::vector<uint8_t> vecRecord;
+    if (!ComposeRecord(objImage, vecRecord, strError)) {
+        ReleaseClusters(vecRuns);
+        SetBits(m_objRecords, ui64Record, 1, false);
+        strError = strPath + "：" + strError;
+        return false;
+    }
+    uint64_t ui64Reference = ui64Record | (static_cast<uint64_t>(Read16(pHeader + 0x10)) << 48);
+    InsertEntry(*pParent, ui64Reference, vecFileName);
+    m_mapWrittenSizes[ui64Record] = stcProperties.ui64Size;
+    m_stcStats.ui64FilesWritten++;
+    m_stcStats.ui64BytesWritten += stcProperties.ui64Size;
+    return WriteRecord(ui64Record, vecRecord, strError);
+}
+
+/********************************************************************************
+* 函数实现：覆盖已有文件（内部辅助）
+* 说明：新内容写入新分配的簇，记录切换后旧的簇在提交时释放；
+*       同时更新记录和父目录索引中的$FILE_NAME（大小、时间、属性）
+*********************************************************************************/
+bool NtfsWriter::OverwriteFile(const std::string& strPath, uint64_t ui64Parent, Directory& objParent,
+                               uint64_t ui64Reference, const NtfsFileProperties& stcProperties,
+                               const DataSource& fnRead, std::string& strError) {
+    const uint64_t ui64Record = ui64Reference & MFT_REFERENCE_MASK;
+    const uint32_t ui32RecordSize = m_objVolume.m_ui32RecordSize;
+    std::vector<uint8_t> vecRecord;
+    RecordImage objImage;
+    if (!ReadImage(ui64Record, vecRecord, objImage, strError) ||
+        !CheckModifiable(objImage.vecAttributes, strPath, strError)) {
+        return false;
+    }
+    if (Read16(vecRecord.data() + 0x16) & RECORD_FLAG_DIRECTORY) {
+        strError = strPath + " 是目录";
+        return false;
+    }
+    NtfsStream stcOldData;
+    std::string strIgnored;
+    bool bHasData = m_objVolume.LoadStream(ui64Record, vecRecord, ATTR_DATA, u"", stcOldData, strIgnored);
+
+    // 1. 去掉旧的$DATA后计算记录剩余空间
+    RemoveAttributes(objImage.vecAttributes, ATTR_DATA, u"");
+    std::vector<uint8_t> vecComposed;
+    if (!ComposeRecord(objImage, vecComposed, strError)) {
+        return false;
+    }
+    size_t nUsed = Read32(vecComposed.data() + 0x18) + 0x18;
+    size_t nResidentLimit = ui32RecordSize > nUsed ? ((ui32RecordSize - nUsed) & ~static_cast<size_t>(7)) : 0;
+    if (nResidentLimit > ui32RecordSize / 2) nResidentLimit = ui32RecordSize / 2;
+
+    bool bResident = false;
+    std::vector<uint8_t> vecValue;
+    std::vector<NtfsStream::Run> vecRuns;
+    if (!WriteData(stcProperties, fnRead, nResidentLimit, bResident, vecValue, vecRuns, strError)) {
+        strError = strPath + "：" + strError;
+        return false;
+    }
+    uint64_t ui64Allocated = bResident ? Align8(vecValue.size()) :
+        (stcProperties.ui64Size + m_objVolume.m_ui32ClusterSize - 1) / m_objVolume.m_ui32ClusterSize *
+        m_objVolume.m_ui32ClusterSize;
+
+    // 2. 更新$STANDARD_INFORMATION和全部$FILE_NAME；新数据不再是压缩或稀疏的
+    uint32_t ui32Flags = stcProperties.ui32Attributes & FILE_ATTR_SETTABLE;
+    for (std::vector<uint8_t>& vecAttr : objImage.vecAttributes) {
+        uint32_t ui32Type = Read32(vecAttr.data());
+        if (vecAttr[8] != 0 || (ui32Type != ATTR_STANDARD_INFORMATION && ui32Type != ATTR_FILE_NAME)) {
+            continue;
+        }
+        uint8_t* pValue = vecAttr.data() + Read16(vecAttr.data() + 0x14);
+        uint32_t ui32Length = Read32(vecAttr.data() + 0x10);
+        if (ui32Type == ATTR_STANDARD_INFORMATION && ui32Length >= 0x24) {
+            uint32_t ui32Old = Read32(pValue + 0x20);
+            ui32Flags |= ui32Old & ~(FILE_ATTR_SETTABLE | FILE_ATTR_SPARSE | FILE_ATTR_COMPRESSED);
+            Write64(pValue, stcProperties.ui64CreationTime);
+            Write64(pValue + 0x08, stcProperties.ui64ModifiedTime);
+            Write64(pValue + 0x10, stcProperties.ui64ModifiedTime);
+            Write64(pValue + 0x18, stcProperties.ui64AccessTime);
+            Write32(pValue + 0x20, ui32Flags);
+        }
+    }
+    std::vector<std::vector<uint8_t>> vecNames;
+    for (std::vector<uint8_t>& vecAttr : objImage.vecAttributes) {
+        if (vecAttr[8] != 0 || Read32(vecAttr.data()) != ATTR_FILE_NAME || Read32(vecAttr.data() + 0x10) < 0x42) {
+            continue;
+        }
+        uint8_t* pValue = vecAttr.data() + Read16(vecAttr.data() + 0x14);
+        Write64(pValue + 0x08, stcProperties.ui64CreationTime);
+        Write64(pValue + 0x10, stcProperties.ui64ModifiedTime);
+        Write64(pValue + 0x18, stcProperties.ui64ModifiedTime);
+        Write64(pValue + 0x20, stcProperties.ui64AccessTime);
+        Write64(pValue + 0x28, ui64Allocated);
+        Write64(pValue + 0x30, stcProperties.ui64Size);
+        Write32(pValue + 0x38, ui32Flags);
+        vecNames.emplace_back(pValue, pValue + Read32(vecAttr.data() + 0x10));
+    }
+    objImage.vecAttributes.push_back(bResident ?
+        MakeResident(ATTR_DATA, u"", vecValue, NextInstance(objImage), false) :
+        MakeNonResident(ATTR_DATA, u"", vecRuns, ui64Allocated, stcProperties.ui64Size, NextInstance(objImage)));
+    if (!ComposeRecord(objImage, vecComposed, strError)) {
+        ReleaseClusters(vecRuns);
+        strError = strPath + "：" + strError;
+        return false;
+    }
+
+    // 3. 旧数据在提交时释放；父目录中指向本文件的项（含8.3短文件名）使用新的键
+    if (bHasData) {
+        for (const NtfsStream::Run& stcRun : stcOldData.vecRuns) {
+            if (stcRun.ui64Lcn != NtfsStream::SPARSE_LCN) m_vecFreeClusters.push_back(stcRun);
+        }
+    }
+    for (const std::vector<uint8_t>& vecKey : vecNames) {
+        if ((Read64(vecKey.data()) & MFT_REFERENCE_MASK) != ui64Parent) continue;
+        auto it = objParent.mapEntries.find(SortKey(KeyName(vecKey)));
+        if (it != objParent.mapEntries.end() && it->second.ui64Reference == ui64Reference) {
+            it->second.vecKey = vecKey;
+        }
+    }
+    m_mapWrittenSizes[ui64Record] = stcProperties.ui64Size;
+    m_stcStats.ui64FilesWritten++;
+    m_stcStats.ui64BytesWritten += stcProperties.ui64Size;
+    return WriteRecord(ui64Record, vecComposed, strError);
+}
+
+/********************************************************************************
+* 函数实现：删除文件或空目录的公共部分（内部辅助）
+* 说明：文件的全部名称（长文件名和8.3短文件名）都必须在同一个父目录中，
+*       否则是多个硬链接，不能只删除一个名称；记录和簇在提交时释放
+*********************************************************************************/
+bool NtfsWriter::RemoveEntry(const std::string& strPath, bool bDirectory, std::string& strError) {
+    uint64_t ui64Parent = 0;
+    uint64_t ui64ParentReference = 0;
+    std::u16string strName;
+    Directory* pParent = nullptr;
+    DirectoryEntry stcEntry;
+    bool bFound = false;
+    if (!CheckActive(strError) || !ResolveParent(strPath, false, ui64Parent, ui64ParentReference, strName, strError) ||
+        !ModifyDirectory(ui64Parent, pParent, strError) ||
+        !LookupEntry(ui64Parent, strName, stcEntry, bFound, strError)) {
+        return false;
+    }
+    if (!bFound) {
+        strError = strPath + "：找不到 " + NtfsVolume::Utf16ToUtf8(strName);
+        return false;
+    }
+    const uint64_t ui64Record = stcEntry.ui64Reference & MFT_REFERENCE_MASK;
+    std::vector<uint8_t> vecRecord;
+    RecordImage objImage;
+    if (!ReadImage(ui64Record, vecRecord, objImage, strError) ||
+        !CheckModifiable(objImage.vecAttributes, strPath, strError)) {
+        return false;
+    }
+    bool bIsDirectory = (Read16(vecRecord.data() + 0x16) & RECORD_FLAG_DIRECTORY) != 0;
+    if (bIsDirectory != bDirectory) {
+        strError = strPath + (bIsDirectory ? " 是目录" : " 不是目录");
+        return false;
+    }
+    if (HasAttribute(objImage.vecAttributes, ATTR_OBJECT_ID)) {
+        strError = strPath + " 有对象ID（$ObjId索引），不能离线删除";
+        return false;
+    }
+    if (ui64Record < FIRST_USER_RECORD) {
+        strError = strPath + " 是NTFS元数据文件";
+        return false;
+    }
+
+    std::vector<std::u16string> vecKeys;
+    size_t nLongNames = 0;
+    for (const std::vector<uint8_t>& vecAttr : objImage.vecAttributes) {
+        if (vecAttr[8] != 0 || Read32(vecAttr.data()) != ATTR_FILE_NAME || Read32(vecAttr.data() + 0x10) < 0x42) {
+            continue;
+        }
+        std::vector<uint8_t> vecKey(vecAttr.data() + Read16(vecAttr.data() + 0x14),
+                                    vecAttr.data() + Read16(vecAttr.data() + 0x14) + Read32(vecAttr.data() + 0x10));
+        if ((Read64(vecKey.data()) & MFT_REFERENCE_MASK) != ui64Parent) nLongNames = 2;
+        if (vecKey[0x41] != FILE_NAME_DOS) nLongNames++;
+        vecKeys.push_back(SortKey(KeyName(vecKey)));
+    }
+    if (nLongNames != 1) {
+        strError = strPath + " 有多个硬链接，不能离线删除";
+        return false;
+    }
+    if (bDirectory) {
+        Directory* pDirectory = nullptr;
+        if (!LoadDirectory(ui64Record, pDirectory, strError)) {
+            return false;
+        }
+        if (!pDirectory->mapEntries.empty()) {
+            strError = strPath + " 不是空目录";
+            return false;
+        }
+    }
+
+    if (!QueueAttributeFrees(ui64Record, vecRecord, strError)) {
+        return false;
+    }
+    for (const std::u16string& strKey : vecKeys) {
+        auto it = pParent->mapEntries.find(strKey);
+        if (it != pParent->mapEntries.end() && it->second.ui64Reference == stcEntry.ui64Reference) {
+            pParent->mapEntries.erase(it);
+        }
+    }
+    m_vecFreeRecords.push_back(ui64Record);
+    m_mapWrittenSizes.erase(ui64Record);
+    m_mapDirectories.erase(ui64Record);
+    m_stcStats.ui64FilesDeleted++;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：删除文件
+*********************************************************************************/
+bool NtfsWriter::RemoveFile(const std::string& strPath, std::string& strError) {
+    return RemoveEntry(strPath, false, strError);
+}
+
+/********************************************************************************
+* 函数实现：删除空目录
+*********************************************************************************/
+bool NtfsWriter::RemoveEmptyDirectory(const std::string& strPath, std::string& strError) {
+    return RemoveEntry(strPath, true, strError);
+}
+
+/********************************************************************************
+* 函数实现：追加一个索引项（内部辅助）
+*********************************************************************************/
+static void AppendIndexEntry(std::vector<uint8_t>& vecOut, uint64_t ui64Reference, const std::vector<uint8_t>* pKey,
+                             bool bSubnode, uint64_t ui64SubnodeVcn) {
+    size_t nKey = pKey ? pKey->size() : 0;
+    size_t nLength = Align8(0x10 + nKey) + (bSubnode ? 8 : 0);
+    size_t nPos = vecOut.size();
+    vecOut.resize(nPos + nLength, 0);
+    uint8_t* p = vecOut.data() + nPos;
+    if (pKey) {
+        Write64(p, ui64Reference);
+        memcpy(p + 0x10, pKey->data(), nKey);
+    }
+    Write16(p + 8, static_cast<uint16_t>(nLength));
+    Write16(p + 10, static_cast<uint16_t>(nKey));
+    Write16(p + 12, static_cast<uint16_t>((pKey ? 0 : INDEX_ENTRY_LAST) | (bSubnode ? INDEX_ENTRY_SUBNODE : 0)));
+    if (bSubnode) {
+        Write64(p + nLength - 8, ui64SubnodeVcn);
+    }
+}
+
+/********************************************************************************
+* 函数实现：重建目录索引（内部辅助）
+* 说明：1. 全部项能放进MFT记录时只使用索引根
+*       2. 否则自底向上批量构建B+树：每层按顺序把项装入索引块，装不下的
+*          项提升到上一层作为分隔项（左子节点是刚装满的块），直到一层只有
+*          一个块；索引根只有一个结束项，指向这个块
+*       3. 索引块写入新分配的簇，旧的$INDEX_ALLOCATION在提交时释放；
+*          返回的新目录记录由调用者在索引块落盘后写入
+*********************************************************************************/
+bool NtfsWriter::RebuildIndex(uint64_t ui64Directory, Directory& objDirectory, std::vector<uint8_t>& vecRecord,
+                              std::string& strError) {
+    std::vector<uint8_t> vecOld;
+    RecordImage objImage;
+    if (!ReadImage(ui64Directory, vecOld, objImage, strError)) {
+        return false;
+    }
+    std::string strDirectory = "目录（记录 " + std::to_string(ui64Directory) + "）";
+    if (HasAttribute(objImage.vecAttributes, ATTR_ATTRIBUTE_LIST)) {
+        strError = strDirectory + "的属性分布在多个MFT记录中，不能离线修改";
+        m_bUnsupported = true;
+        return false;
+    }
+    const uint8_t* pRoot = NtfsVolume::FindAttribute(vecOld, ATTR_INDEX_ROOT, INDEX_NAME_I30);
+    if (!pRoot || pRoot[8] != 0 || Read32(pRoot + 0x10) < 0x20) {
+        strError = strDirectory + "的索引根已损坏";
+        return false;
+    }
+    std::vector<uint8_t> vecParameters(pRoot + Read16(pRoot + 0x14), pRoot + Read16(pRoot + 0x14) + 0x10);
+    const uint32_t ui32BlockSize = Read32(vecParameters.data() + 8);
+    const uint32_t ui32ClusterSize = m_objVolume.m_ui32ClusterSize;
+    if (ui32BlockSize < 1024 || ui32BlockSize > 65536 || (ui32BlockSize & (ui32BlockSize - 1)) != 0) {
+        strError = strDirectory + "的索引块大小无效";
+        return false;
+    }
+
+    // 旧的索引分配和位图（非常驻时）
+    std::vector<NtfsStream::Run> vecOldRuns;
+    for (uint32_t ui32Type : { ATTR_INDEX_ALLOCATION, ATTR_BITMAP }) {
+        const uint8_t* pAttr = NtfsVolume::FindAttribute(vecOld, ui32Type, INDEX_NAME_I30);
+        NtfsStream stcStream;
+        if (!pAttr || pAttr[8] == 0) continue;
+        if (!m_objVolume.LoadStream(ui64Directory, vecOld, ui32Type, INDEX_NAME_I30, stcStream, strError)) {
+            return false;
+        }
+        for (const NtfsStream::Run& stcRun : stcStream.vecRuns) {
+            if (stcRun.ui64Lcn != NtfsStream::SPARSE_LCN) vecOldRuns.push_back(stcRun);
+        }
+    }
+    RemoveAttributes(objImage.vecAttributes, ATTR_INDEX_ROOT, INDEX_NAME_I30);
+    RemoveAttributes(objImage.vecAttributes, ATTR_INDEX_ALLOCATION, INDEX_NAME_I30);
+    RemoveAttributes(objImage.vecAttributes, ATTR_BITMAP, INDEX_NAME_I30);
+
+    std::vector<const DirectoryEntry*> vecItems;
+    for (const auto& pairEntry : objDirectory.mapEntries) vecItems.push_back(&pairEntry.second);
+    auto MakeRoot = [&](const std::vector<uint8_t>& vecEntries, uint8_t ui8Flags) {
+        std::vector<uint8_t> vecValue = vecParameters;
+        vecValue.resize(0x20, 0);
+        Write32(vecValue.data() + 0x10, 0x10);
+        Write32(vecValue.data() + 0x14, static_cast<uint32_t>(0x10 + vecEntries.size()));
+        Write32(vecValue.data() + 0x18, static_cast<uint32_t>(0x10 + vecEntries.size()));
+        vecValue[0x1C] = ui8Flags;
+        vecValue.insert(vecValue.end(), vecEntries.begin(), vecEntries.end());
+        return vecValue;
+    };
+
+    // 1. 只使用索引根
+    std::vector<uint8_t> vecEntries;
+    for (const DirectoryEntry* pItem : vecItems) AppendIndexEntry(vecEntries, pItem->ui64Reference, &pItem->vecKey, false, 0);
+    AppendIndexEntry(vecEntries, 0, nullptr, false, 0);
+    RecordImage objSmall = objImage;
+    objSmall.vecAttributes.push_back(MakeResident(ATTR_INDEX_ROOT, INDEX_NAME_I30, MakeRoot(vecEntries, 0),
+                                                  NextInstance(objSmall), false));
+    std::string strIgnored;
+    if (ComposeRecord(objSmall, vecRecord, strIgnored)) {
+        m_vecFreeClusters.insert(m_vecFreeClusters.end(), vecOldRuns.begin(), vecOldRuns.end());
+        return true;
+    }
+
+    // 2. 自底向上构建各层索引块
+    struct LevelItem {
+        size_t  nItem;          // vecItems中的序号
+        int64_t i64Child;       // 左子节点（索引块序号，-1表示没有）
+    };
+    struct IndexNode {
+        std::vector<LevelItem> vecItems;
+        int64_t                i64EndChild;
+        bool                   bChildren;
+    };
+    const uint16_t ui16Count = static_cast<uint16_t>(ui32BlockSize / FIXUP_STRIDE + 1);
+    const size_t nEntriesOffset = Align8(0x28 + 2 * ui16Count);
+    const size_t nCapacity = ui32BlockSize - nEntriesOffset;
+    std::vector<IndexNode> vecNodes;
+    std::vector<LevelItem> vecLevel;
+    for (size_t i = 0; i < vecItems.size(); i++) vecLevel.push_back({ i, -1 });
+    int64_t i64Trailing = -1;
+    bool bChildren = false;
+    while (true) {
+        auto EntrySize = [&](const LevelItem& stcItem) {
+            return Align8(0x10 + vecItems[stcItem.nItem]->vecKey.size()) + (bChildren ? 8 : 0);
+        };
+        std::vector<LevelItem> vecParent;
+        size_t nFirstNode = vecNodes.size();
+        size_t i = 0;
+        while (true) {
+            IndexNode objNode = { {}, -1, bChildren };
+            size_t nUsed = 0x10 + (bChildren ? 8 : 0);
+            while (i < vecLevel.size() && nUsed + EntrySize(vecLevel[i]) <= nCapacity) {
+                nUsed += EntrySize(vecLevel[i]);
+                objNode.vecItems.push_back(vecLevel[i++]);
+            }
+            if (i == vecLevel.size()) {
+                objNode.i64EndChild = i64Trailing;
+                vecNodes.push_back(std::move(objNode));
+                break;
+            }
+            // 分隔项是最后一项时，最后一个块会是空的：改用本块的最后一项作为分隔项
+            if (i + 1 == vecLevel.size() && objNode.vecItems.size() >= 2) {
+                objNode.vecItems.pop_back();
+                i--;
+            }
+            if (objNode.vecItems.empty()) {
+                strError = strDirectory + "的索引项太大";
+                return false;
+            }
+            objNode.i64EndChild = vecLevel[i].i64Child;
+            vecParent.push_back({ vecLevel[i].nItem, static_cast<int64_t>(vecNodes.size()) });
+            vecNodes.push_back(std::move(objNode));
+            i++;
+        }
+        i64Trailing = static_cast<int64_t>(vecNodes.size()) - 1;
+        if (vecNodes.size() - nFirstNode == 1) {
+            break;
+        }
+        vecLevel = std::move(vecParent);
+        bChildren = true;
+    }
+
+    // 3. 写入索引块（VCN单位：索引块不小于簇时为簇，否则为512字节）
+    const uint64_t ui64Unit = ui32BlockSize >= ui32ClusterSize ? ui32ClusterSize : FIXUP_STRIDE;
+    auto BlockVcn = [&](int64_t i64Node) { return static_cast<uint64_t>(i64Node) * ui32BlockSize / ui64Unit; };
+    uint64_t ui64DataSize = static_cast<uint64_t>(vecNodes.size()) * ui32BlockSize;
+    uint64_t ui64Clusters = (ui64DataSize + ui32ClusterSize - 1) / ui32ClusterSize;
+    std::vector<uint8_t> vecBlocks(static_cast<size_t>(ui64Clusters * ui32ClusterSize), 0);
+    for (size_t n = 0; n < vecNodes.size(); n++) {
+        const IndexNode& objNode = vecNodes[n];
+        std::vector<uint8_t> vecNodeEntries;
+        for (const LevelItem& stcItem : objNode.vecItems) {
+            AppendIndexEntry(vecNodeEntries, vecItems[stcItem.nItem]->ui64Reference, &vecItems[stcItem.nItem]->vecKey,
+                             objNode.bChildren, objNode.bChildren ? BlockVcn(stcItem.i64Child) : 0);
+        }
+        AppendIndexEntry(vecNodeEntries, 0, nullptr, objNode.bChildren,
+                         objNode.bChildren ? BlockVcn(objNode.i64EndChild) : 0);
+        uint8_t* p = vecBlocks.data() + n * ui32BlockSize;
+        memcpy(p, "INDX", 4);
+        Write16(p + 4, 0x28);
+        Write16(p + 6, ui16Count);
+        Write64(p + 0x10, BlockVcn(static_cast<int64_t>(n)));
+        Write32(p + 0x18, static_cast<uint32_t>(nEntriesOffset - 0x18));
+        Write32(p + 0x1C, static_cast<uint32_t>(nEntriesOffset - 0x18 + vecNodeEntries.size()));
+        Write32(p + 0x20, ui32BlockSize - 0x18);
+        p[0x24] = objNode.bChildren ? INDEX_HEADER_LARGE : 0;
+        memcpy(p + nEntriesOffset, vecNodeEntries.data(), vecNodeEntries.size());
+        ProtectRecord(p, ui32BlockSize);
+    }
+    std::vector<NtfsStream::Run> vecRuns;
+    if (!AllocateClusters(ui64Clusters, vecRuns, strError)) {
+        return false;
+    }
+    if (!WriteRuns(vecRuns, 0, vecBlocks.data(), vecBlocks.size(), strError)) {
+        ReleaseClusters(vecRuns);
+        return false;
+    }
+
+    // 4. 索引根指向最上层的块，位图标记全部块为使用中
+    std::vector<uint8_t> vecRootEntries;
+    AppendIndexEntry(vecRootEntries, 0, nullptr, true, BlockVcn(i64Trailing));
+    std::vector<uint8_t> vecBitmap(Align8((vecNodes.size() + 7) / 8), 0);
+    for (size_t n = 0; n < vecNodes.size(); n++) vecBitmap[n >> 3] |= static_cast<uint8_t>(1 << (n & 7));
+    objImage.vecAttributes.push_back(MakeResident(ATTR_INDEX_ROOT, INDEX_NAME_I30,
+        MakeRoot(vecRootEntries, INDEX_HEADER_LARGE), NextInstance(objImage), false));
+    objImage.vecAttributes.push_back(MakeNonResident(ATTR_INDEX_ALLOCATION, INDEX_NAME_I30, vecRuns,
+        ui64Clusters * ui32ClusterSize, ui64DataSize, NextInstance(objImage)));
+    objImage.vecAttributes.push_back(MakeResident(ATTR_BITMAP, INDEX_NAME_I30, vecBitmap, NextInstance(objImage), false));
+    if (!ComposeRecord(objImage, vecRecord, strError)) {
+        ReleaseClusters(vecRuns);
+        strError = strDirectory + "：" + strError;
+        return false;
+    }
+    m_vecFreeClusters.insert(m_vecFreeClusters.end(), vecOldRuns.begin(), vecOldRuns.end());
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：提交
+*********************************************************************************/
+bool NtfsWriter::Commit(std::string& strError) {
+    if (!CheckActive(strError)) {
+        return false;
+    }
+    m_bFailed = true;           // 中途失败时会话不再继续
+
+    // 1. 文件数据落盘后写入文件记录
+    if (!FlushPendingRecords(strError)) {
+        return false;
+    }
+
+    // 2. 重建修改过的目录索引（写入新的索引块），连同位图中新分配的簇一起落盘
+    std::vector<std::pair<uint64_t, std::vector<uint8_t>>> vecSwitch;
+    for (auto& pairDirectory : m_mapDirectories) {
+        if (!pairDirectory.second.bDirty) continue;
+        std::vector<uint8_t> vecRecord;
+        if (!RebuildIndex(pairDirectory.first, pairDirectory.second, vecRecord, strError)) {
+            return false;
+        }
+        vecSwitch.emplace_back(pairDirectory.first, std::move(vecRecord));
+        m_stcStats.ui64IndexesRebuilt++;
+    }
+    if (!FlushBitmap(m_objClusters, strError) || !FlushBitmap(m_objRecords, strError) || !Barrier(strError)) {
+        return false;
+    }
+
+    // 3. 写入目录记录，新的索引从此生效
+    for (const auto& pairSwitch : vecSwitch) {
+        if (!StoreRecord(pairSwitch.first, pairSwitch.second, strError)) {
+            return false;
+        }
+    }
+    if (!Barrier(strError)) {
+        return false;
+    }
+
+    // 4. 释放被替换和删除的记录及簇（记录的序列号递增，旧的文件引用失效）
+    std::vector<uint8_t> vecRecord;
+    for (uint64_t ui64Record : m_vecFreeRecords) {
+        bool bValid = false;
+        if (!ReadRecordRaw(ui64Record, vecRecord, bValid, strError)) {
+            return false;
+        }
+        if (bValid) {
+            uint16_t ui16Sequence = static_cast<uint16_t>(Read16(vecRecord.data() + 0x10) + 1);
+            Write16(vecRecord.data() + 0x10, ui16Sequence == 0 ? 1 : ui16Sequence);
+            Write16(vecRecord.data() + 0x16, Read16(vecRecord.data() + 0x16) & ~RECORD_FLAG_IN_USE);
+            if (!StoreRecord(ui64Record, vecRecord, strError)) {
+                return false;
+            }
+        }
+        SetBits(m_objRecords, ui64Record, 1, false);
+    }
+    ReleaseClusters(m_vecFreeClusters);
+    m_vecFreeRecords.clear();
+    m_vecFreeClusters.clear();
+    if (!FlushBitmap(m_objClusters, strError) || !FlushBitmap(m_objRecords, strError) || !Barrier(strError)) {
+        return false;
+    }
+
+    // 5. 回读校验后清除"需要检查"标记
+    if (!VerifyDirectories(strError) || !SetVolumeFlags(m_ui16VolumeFlags, strError) || !Barrier(strError)) {
+        return false;
+    }
+    m_bFailed = false;
+    m_bActive = false;
+    m_mapDirectories.clear();
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：回读校验（内部辅助）
+* 说明：用新打开的NtfsVolume遍历重建过的目录，逐项比较文件引用和键；
+*       本次写入的文件比较大小
+*********************************************************************************/
+bool NtfsWriter::VerifyDirectories(std::string& strError) {
+    NtfsVolume objCheck;
+    if (!objCheck.Open(*m_pDevice, strError)) {
+        strError = "回读校验失败：" + strError;
+        return false;
+    }
+    std::vector<NtfsVolume::IndexEntry> vecEntries;
+    for (const auto& pairDirectory : m_mapDirectories) {
+        if (!pairDirectory.second.bDirty) continue;
+        if (!objCheck.EnumerateDirectory(pairDirectory.first, vecEntries, strError)) {
+            strError = "回读校验失败：" + strError;
+            return false;
+        }
+        bool bMatch = vecEntries.size() == pairDirectory.second.mapEntries.size();
+        size_t i = 0;
+        for (auto it = pairDirectory.second.mapEntries.begin(); bMatch && it != pairDirectory.second.mapEntries.end();
+             ++it, ++i) {
+            bMatch = vecEntries[i].ui64Reference == it->second.ui64Reference && vecEntries[i].vecKey == it->second.vecKey;
+        }
+        if (!bMatch) {
+            strError = "回读校验失败：目录（记录 " + std::to_string(pairDirectory.first) + "）的索引与写入的内容不一致";
+            return false;
+        }
+    }
+    for (const auto& pairFile : m_mapWrittenSizes) {
+        NtfsFileInfo stcInfo;
+        if (!objCheck.StatRecord(pairFile.first, stcInfo, nullptr, strError) || stcInfo.ui64Size != pairFile.second) {
+            strError = "回读校验失败：文件（记录 " + std::to_string(pairFile.first) + "）" +
+                       (strError.empty() ? "大小不一致" : "：" + strError);
+            return false;
+        }
+    }
+    return true;
+}
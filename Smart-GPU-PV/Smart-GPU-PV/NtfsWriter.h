@@ -0,0 +1,315 @@
+﻿/********************************************************************************
+* 文件名称：NtfsWriter.h
+* 文件功能：不挂载直接向NTFS卷（虚拟机磁盘镜像中的文件系统）写入驱动文件
+*
+* 类说明：
+*    每次配置都要Mount-VHD/Dismount-VHD，还有卸载重试和挂载后的等待。
+*    NtfsWriter在NtfsVolume（只读解析）之上实现离线注入需要的写操作：
+*    - 创建目录、写入或覆盖文件（未命名$DATA流）、删除文件和空目录
+*    - MFT记录分配（$MFT的$BITMAP），没有空闲记录时扩展$MFT
+*    - 簇分配（$Bitmap）：优先分配连续空间，不足时分为多个运行
+*    - 目录索引（$I30）：修改过的目录在提交时整体重建B树
+*
+* 崩溃一致性：
+*    - 开始前要求$LogFile干净（虚拟机已完全关机，不是休眠或快速启动），
+*      并在$Volume中设置"需要检查"标记，提交完成后清除；中途崩溃时Windows
+*      启动会运行chkdsk回收泄漏的簇和孤立的记录
+*    - 写时复制：新数据写入新分配的簇，目录索引写入新的索引块，再用一次
+*      MFT记录写入切换；旧的簇和记录在新索引落盘后才释放，本次会话中不会
+*      重用，任何时刻崩溃都只能看到旧内容或完整的新内容
+*    - 刷新屏障：文件数据 → 文件记录和新索引块 → 目录记录 → 释放 → 清除标记，
+*      每一步之前先刷新块设备
+*    - 提交后用新打开的NtfsVolume回读校验重建过的目录
+*
+* 限制：
+*    - 不处理有属性列表（$ATTRIBUTE_LIST）的文件和目录、有多个硬链接的文件的
+*      删除、重解析点（WOF压缩等）和EFS加密文件，遇到时返回错误
+*    - 新文件只有Win32命名空间的长文件名，不生成8.3短文件名；安全描述符
+*      沿用父目录的安全ID（$Secure中已有的描述符），不新建描述符
+*    - 不写入$LogFile和$UsnJrnl
+*    - 不是线程安全的，多个线程使用时由调用者加锁
+*
+* 依赖项：
+*    - NtfsVolume（读取和解析）
+*    - BlockDevice（块设备接口）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "NtfsVolume.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <cstdint>
+
+/********************************************************************************
+* 结构体名称：写入文件的属性
+*********************************************************************************/
+struct NtfsFileProperties {
+    uint64_t ui64Size = 0;              // 文件大小
+    uint64_t ui64CreationTime = 0;      // 创建时间（FILETIME，UTC）
+    uint64_t ui64ModifiedTime = 0;      // 修改时间
+    uint64_t ui64AccessTime = 0;        // 访问时间
+    uint32_t ui32Attributes = 0;        // 文件属性（只读、隐藏、系统、存档等）
+};
+
+/********************************************************************************
+* 结构体名称：写入统计
+*********************************************************************************/
+struct NtfsWriteStats {
+    uint64_t ui64FilesWritten = 0;          // 写入的文件数
+    uint64_t ui64BytesWritten = 0;          // 写入的文件数据字节数
+    uint64_t ui64DirectoriesCreated = 0;    // 创建的目录数
+    uint64_t ui64FilesDeleted = 0;          // 删除的文件和目录数
+    uint64_t ui64IndexesRebuilt = 0;        // 重建索引的目录数
+    uint64_t ui64MftRecordsAdded = 0;       // 扩展$MFT增加的记录数
+};
+
+/********************************************************************************
+* 类名称：NTFS写入器
+* 类功能：在一次会话中修改NTFS卷，提交后卷恢复一致
+*
+* 调用示例：
+*    PartitionDevice objVolume(objDisk, stcPartition.ui64Offset, stcPartition.ui64Length);
+*    NtfsWriter objWriter;
+*    if (objWriter.Begin(objVolume, strError) &&
+*        objWriter.CreateDirectories("Windows\\System32\\HostDriverStore", 0, strError) &&
+*        objWriter.WriteFile("Windows\\System32\\HostDriverStore\\a.dll", stcProperties, fnRead, strError)) {
+*        objWriter.Commit(strError);
+*    }
+*
+* 注意事项：
+*    - 路径规则与NtfsVolume相同（UTF-8，'\'或'/'分隔，相对于卷根目录）
+*    - 任一写操作失败后仍应调用Commit，使已完成的修改落盘并清除检查标记；
+*      块设备写入失败后会话不可继续，Commit返回错误，卷保持"需要检查"
+*    - 未调用Commit就销毁时卷保持"需要检查"标记，目录索引的修改丢失
+*********************************************************************************/
+class NtfsWriter {
+public:
+    // 文件数据来源：按顺序被调用，每次必须填满nBytes字节
+    using DataSource = std::function<bool(char* pBuffer, size_t nBytes, std::string& strError)>;
+
+    NtfsWriter() = default;
+    NtfsWriter(const NtfsWriter&) = delete;
+    NtfsWriter& operator=(const NtfsWriter&) = delete;
+
+    /********************************************************************************
+    * 函数名称：开始会话
+    * 函数参数：
+    *    [IN]  BlockDevice& objVolume：卷所在的块设备（可写），在本对象之后销毁
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    卷不是NTFS、只读、$LogFile不干净、Windows处于休眠（含快速启动）、
+    *    卷已标记为需要检查时返回false，卷不做任何修改
+    *********************************************************************************/
+    bool Begin(BlockDevice& objVolume, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：查询文件信息
+    * 函数参数：
+    *    [IN]  const std::string& strPath：路径
+    *    [OUT] NtfsFileInfo& stcInfo：文件信息（包含本次会话中的修改）
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    路径不存在时返回false
+    *********************************************************************************/
+    bool Stat(const std::string& strPath, NtfsFileInfo& stcInfo, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：读取整个文件
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径
+    *    [OUT] std::vector<char>& vecData：文件内容（包含本次会话中的修改）
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *********************************************************************************/
+    bool ReadFile(const std::string& strPath, std::vector<char>& vecData, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：创建目录
+    * 函数功能：逐级创建路径中不存在的目录
+    * 函数参数：
+    *    [IN]  const std::string& strPath：目录路径
+    *    [IN]  uint32_t ui32Attributes：新目录的文件属性
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    路径中某一级是文件时返回false
+    *********************************************************************************/
+    bool CreateDirectories(const std::string& strPath, uint32_t ui32Attributes, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：写入文件
+    * 函数功能：创建文件或替换已有文件的内容，父目录不存在时自动创建
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径
+    *    [IN]  const NtfsFileProperties& stcProperties：大小、时间和属性
+    *    [IN]  const DataSource& fnRead：数据来源（共读取stcProperties.ui64Size字节）
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    失败时已有文件保持原内容
+    *********************************************************************************/
+    bool WriteFile(const std::string& strPath, const NtfsFileProperties& stcProperties,
+                   const DataSource& fnRead, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：删除文件
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    文件不存在、是目录或有多个硬链接时返回false
+    *********************************************************************************/
+    bool RemoveFile(const std::string& strPath, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：删除空目录
+    * 函数参数：
+    *    [IN]  const std::string& strPath：目录路径
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    目录不存在、不为空或是根目录时返回false
+    *********************************************************************************/
+    bool RemoveEmptyDirectory(const std::string& strPath, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：提交
+    * 函数功能：写入待写的记录和重建的目录索引，释放旧的簇和记录，写回位图，
+    *           回读校验重建过的目录后清除"需要检查"标记
+    * 函数参数：
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    * 注意事项：
+    *    - 提交后会话结束，再次写入需要重新Begin
+    *********************************************************************************/
+    bool Commit(std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：是否遇到不能离线修改的对象
+    * 返回类型：bool
+    *    本次会话（从Begin起，提交后仍保留）中有写入因目标或其目录有属性列表、
+    *    是重解析点或已加密而被拒绝；调用者应改用挂载的方式完成剩余写入
+    *********************************************************************************/
+    bool HasUnsupported() const { return m_bUnsupported; }
+
+    bool IsActive() const { return m_bActive; }
+    BlockDevice* Device() const { return m_pDevice; }
+    const NtfsWriteStats& Stats() const { return m_stcStats; }
+
+private:
+    // 目录中的一项
+    struct DirectoryEntry {
+        uint64_t             ui64Reference;     // 文件引用
+        std::vector<uint8_t> vecKey;            // 键（$FILE_NAME的值）
+    };
+
+    // 已加载到内存的目录索引，键为大写文件名 + '\0' + 原文件名（排序与NTFS一致）
+    struct Directory {
+        std::map<std::u16string, DirectoryEntry> mapEntries;
+        bool bDirty = false;                    // 提交时需要重建
+        bool bReadOnly = false;                 // 有属性列表，不能修改
+    };
+
+    // 可编辑的MFT记录：记录头（到第一个属性为止）和属性
+    struct RecordImage {
+        std::vector<uint8_t>              vecHeader;
+        std::vector<std::vector<uint8_t>> vecAttributes;
+    };
+
+    // 内存中的位图及其需要写回的字节范围
+    struct Bitmap {
+        NtfsStream           stcStream;         // 位图所在的属性流
+        std::vector<uint8_t> vecBits;
+        uint64_t             ui64DirtyBegin = ~0ULL;
+        uint64_t             ui64DirtyEnd = 0;
+    };
+
+    BlockDevice*  m_pDevice = nullptr;          // 卷所在块设备
+    NtfsVolume    m_objVolume;                  // 读取和解析
+    bool          m_bActive = false;            // 会话进行中
+    bool          m_bFailed = false;            // 写入失败，会话不可继续
+    bool          m_bUnsupported = false;       // 遇到不能离线修改的文件或目录
+    uint16_t      m_ui16VolumeFlags = 0;        // 开始前的卷标志
+    uint64_t      m_ui64RootReference = 0;      // 根目录的文件引用
+    NtfsStream    m_stcMirror;                  // $MFTMirr的数据流
+    uint64_t      m_ui64MirrorRecords = 0;      // $MFTMirr中的记录数
+    Bitmap        m_objClusters;                // $Bitmap
+    Bitmap        m_objRecords;                 // $MFT的$BITMAP
+    uint64_t      m_ui64NextCluster = 0;        // 簇分配的起始提示
+    uint64_t      m_ui64NextRecord = 0;         // 记录分配的起始提示
+    std::map<uint64_t, Directory>             m_mapDirectories;     // 已加载的目录（键为记录号）
+    std::map<uint64_t, std::vector<uint8_t>>  m_mapPendingRecords;  // 等待数据落盘后写入的记录
+    uint64_t      m_ui64PendingBytes = 0;       // 待写记录引用的新数据字节数
+    std::vector<NtfsStream::Run>              m_vecFreeClusters;    // 提交时释放的簇
+    std::vector<uint64_t>                     m_vecFreeRecords;     // 提交时释放的记录
+    std::map<uint64_t, uint64_t>              m_mapWrittenSizes;    // 本次写入的文件记录及大小（回读校验）
+    NtfsWriteStats m_stcStats;
+
+    // 路径和目录
+    bool SplitPath(const std::string& strPath, std::vector<std::u16string>& vecComponents, std::string& strError);
+    bool ResolveDirectory(const std::vector<std::u16string>& vecComponents, size_t nCount, bool bCreate,
+                          uint32_t ui32Attributes, uint64_t& ui64Directory, uint64_t& ui64Reference,
+                          std::string& strError);
+    bool ResolveParent(const std::string& strPath, bool bCreate, uint64_t& ui64Parent, uint64_t& ui64ParentReference,
+                       std::u16string& strName, std::string& strError);
+    bool LocatePath(const std::string& strPath, uint64_t& ui64Record, std::u16string& strName, std::string& strError);
+    bool LoadDirectory(uint64_t ui64Directory, Directory*& pDirectory, std::string& strError);
+    bool ModifyDirectory(uint64_t ui64Directory, Directory*& pDirectory, std::string& strError);
+    bool LookupEntry(uint64_t ui64Directory, const std::u16string& strName, DirectoryEntry& stcEntry,
+                     bool& bFound, std::string& strError);
+    void InsertEntry(Directory& objDirectory, uint64_t ui64Reference, const std::vector<uint8_t>& vecKey);
+    std::u16string SortKey(const std::u16string& strName) const;
+    static std::u16string KeyName(const std::vector<uint8_t>& vecKey);
+
+    // MFT记录
+    bool ReadRecordRaw(uint64_t ui64Record, std::vector<uint8_t>& vecRecord, bool& bValid, std::string& strError);
+    bool ReadImage(uint64_t ui64Record, std::vector<uint8_t>& vecRecord, RecordImage& objImage, std::string& strError);
+    bool WriteRecord(uint64_t ui64Record, const std::vector<uint8_t>& vecRecord, std::string& strError);
+    bool StoreRecord(uint64_t ui64Record, const std::vector<uint8_t>& vecRecord, std::string& strError);
+    bool FlushPendingRecords(std::string& strError);
+    bool ParseRecord(const std::vector<uint8_t>& vecRecord, RecordImage& objImage, std::string& strError);
+    bool ComposeRecord(const RecordImage& objImage, std::vector<uint8_t>& vecRecord, std::string& strError);
+    uint16_t NextInstance(RecordImage& objImage);
+    static void RemoveAttributes(std::vector<std::vector<uint8_t>>& vecAttributes, uint32_t ui32Type,
+                                 const std::u16string& strName);
+    bool CheckModifiable(const std::vector<std::vector<uint8_t>>& vecAttributes, const std::string& strPath,
+                         std::string& strError);
+    bool AllocateRecord(uint64_t& ui64Record, RecordImage& objImage, std::string& strError);
+    bool ExtendMft(std::string& strError);
+
+    // 簇和位图
+    bool AllocateClusters(uint64_t ui64Count, std::vector<NtfsStream::Run>& vecRuns, std::string& strError);
+    void ReleaseClusters(const std::vector<NtfsStream::Run>& vecRuns);
+    bool QueueAttributeFrees(uint64_t ui64Record, const std::vector<uint8_t>& vecRecord, std::string& strError);
+    static void SetBits(Bitmap& objBitmap, uint64_t ui64First, uint64_t ui64Count, bool bValue);
+    bool LoadBitmap(uint64_t ui64Record, uint32_t ui32Type, Bitmap& objBitmap, std::string& strError);
+    bool FlushBitmap(Bitmap& objBitmap, std::string& strError);
+    bool WriteStream(const NtfsStream& stcStream, uint64_t ui64Offset, const void* pBuffer, size_t nBytes,
+                     std::string& strError);
+    bool WriteRuns(const std::vector<NtfsStream::Run>& vecRuns, uint64_t ui64Offset, const void* pBuffer,
+                   size_t nBytes, std::string& strError);
+
+    // 会话
+    bool CheckActive(std::string& strError);
+    bool CheckLogFile(std::string& strError);
+    bool SetVolumeFlags(uint16_t ui16Flags, std::string& strError);
+    bool Barrier(std::string& strError);
+    bool Fail(std::string& strError);
+
+    // 文件和目录
+    bool MakeDirectory(uint64_t ui64Parent, uint64_t ui64ParentReference, const std::u16string& strName,
+                         uint32_t ui32Attributes, uint64_t& ui64Reference, std::string& strError);
+    bool ParentSecurityId(uint64_t ui64Parent, uint32_t& ui32SecurityId, std::string& strError);
+    bool WriteData(const NtfsFileProperties& stcProperties, const DataSource& fnRead, size_t nResidentLimit,
+                   bool& bResident, std::vector<uint8_t>& vecValue, std::vector<NtfsStream::Run>& vecRuns,
+                   std::string& strError);
+    bool OverwriteFile(const std::string& strPath, uint64_t ui64Parent, Directory& objParent, uint64_t ui64Reference,
+                       const NtfsFileProperties& stcProperties, const DataSource& fnRead, std::string& strError);
+    bool RemoveEntry(const std::string& strPath, bool bDirectory, std::string& strError);
+    bool RebuildIndex(uint64_t ui64Directory, Directory& objDirectory, std::vector<uint8_t>& vecRecord,
+                      std::string& strError);
+    bool VerifyDirectories(std::string& strError);
+};
@@ -0,0 +1,386 @@
+﻿/********************************************************************************
+* 文件名称：PartitionTable.cpp
+* 文件功能：实现GPT/MBR分区表解析和Windows系统分区定位
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "PartitionTable.h"
+#include "ContentHash.h"
+#include <cstring>
+#include <cstdio>
+
+// 分区表限制（UEFI规范至少128项，这里为损坏的表设置上限）
+static const uint32_t MAX_GPT_ENTRIES = 16384;
+static const size_t MAX_GPT_ARRAY_BYTES = 4 * 1024 * 1024;
+static const int MAX_EBR_CHAIN = 128;
+
+// 常见分区类型
+static const DiskGuid GPT_TYPE_BASIC_DATA = DiskGuid::Make(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C068B6B72699C7ULL);
+static const DiskGuid GPT_TYPE_EFI_SYSTEM = DiskGuid::Make(0xC12A7328, 0xF81F, 0x11D2, 0xBA4B00A0C93EC93BULL);
+static const DiskGuid GPT_TYPE_MSR        = DiskGuid::Make(0xE3C9E316, 0x0B5C, 0x4DB8, 0x817DF92DF00215AEULL);
+static const DiskGuid GPT_TYPE_RECOVERY   = DiskGuid::Make(0xDE94BBA4, 0x06D1, 0x4D40, 0xA16ABFD50179D6ACULL);
+static const uint8_t MBR_TYPE_NTFS = 0x07;
+static const uint8_t MBR_TYPE_GPT_PROTECTIVE = 0xEE;
+
+static inline uint16_t Read16(const uint8_t* p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint32_t Read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint64_t Read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+static bool IsExtendedType(uint8_t ui8Type) {
+    return ui8Type == 0x05 || ui8Type == 0x0F || ui8Type == 0x85;
+}
+
+static bool HasBootSignature(const uint8_t* pSector) {
+    return pSector[510] == 0x55 && pSector[511] == 0xAA;
+}
+
+/********************************************************************************
+* 函数实现：UTF-16LE转UTF-8（内部辅助，遇到0结束）
+*********************************************************************************/
+static std::string Utf16LeToUtf8(const uint8_t* p, size_t nChars) {
+    std::string strResult;
+    for (size_t i = 0; i < nChars; i++) {
+        uint32_t ui32Code = Read16(p + 2 * i);
+        if (ui32Code == 0) break;
+        if (ui32Code >= 0xD800 && ui32Code <= 0xDBFF && i + 1 < nChars) {
+            uint32_t ui32Low = Read16(p + 2 * (i + 1));
+            if (ui32Low >= 0xDC00 && ui32Low <= 0xDFFF) {
+                ui32Code = 0x10000 + ((ui32Code - 0xD800) << 10) + (ui32Low - 0xDC00);
+                i++;
+            }
+        }
+        if (ui32Code < 0x80) {
+            strResult += static_cast<char>(ui32Code);
+        } else if (ui32Code < 0x800) {
+            strResult += static_cast<char>(0xC0 | (ui32Code >> 6));
+            strResult += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        } else if (ui32Code < 0x10000) {
+            strResult += static_cast<char>(0xE0 | (ui32Code >> 12));
+            strResult += static_cast<char>(0x80 | ((ui32Code >> 6) & 0x3F));
+            strResult += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        } else {
+            strResult += static_cast<char>(0xF0 | (ui32Code >> 18));
+            strResult += static_cast<char>(0x80 | ((ui32Code >> 12) & 0x3F));
+            strResult += static_cast<char>(0x80 | ((ui32Code >> 6) & 0x3F));
+            strResult += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        }
+    }
+    return strResult;
+}
+
+/********************************************************************************
+* 函数实现：PartitionInfo成员
+*********************************************************************************/
+bool PartitionInfo::IsBasicData() const {
+    return bGpt ? objTypeGuid == GPT_TYPE_BASIC_DATA : ui8MbrType == MBR_TYPE_NTFS;
+}
+
+std::string PartitionInfo::TypeName() const {
+    if (bGpt) {
+        if (objTypeGuid == GPT_TYPE_BASIC_DATA) return "基本数据分区";
+        if (objTypeGuid == GPT_TYPE_EFI_SYSTEM) return "EFI系统分区";
+        if (objTypeGuid == GPT_TYPE_MSR) return "Microsoft保留分区";
+        if (objTypeGuid == GPT_TYPE_RECOVERY) return "Windows恢复分区";
+        return objTypeGuid.ToString();
+    }
+    switch (ui8MbrType) {
+    case 0x07: return "NTFS/exFAT";
+    case 0x0B:
+    case 0x0C: return "FAT32";
+    case 0x27: return "Windows恢复分区";
+    case 0xEF: return "EFI系统分区";
+    default: {
+        char szType[16];
+        snprintf(szType, sizeof(szType), "MBR 0x%02X", ui8MbrType);
+        return szType;
+    }
+    }
+}
+
+/********************************************************************************
+* 函数实现：分区视图读写
+*********************************************************************************/
+bool PartitionDevice::Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) {
+    if (ui64Offset > m_ui64Length || nBytes > m_ui64Length - ui64Offset) {
+        strError = "读取超出分区范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+    return m_objDisk.Read(m_ui64Offset + ui64Offset, pBuffer, nBytes, strError);
+}
+
+bool PartitionDevice::Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) {
+    if (ui64Offset > m_ui64Length || nBytes > m_ui64Length - ui64Offset) {
+        strError = "写入超出分区范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+    return m_objDisk.Write(m_ui64Offset + ui64Offset, pBuffer, nBytes, strError);
+}
+
+/********************************************************************************
+* 函数实现：读取一份GPT（内部辅助）
+*********************************************************************************/
+bool PartitionTable::ReadGpt(BlockDevice& objDisk, uint64_t ui64HeaderLba, std::vector<PartitionInfo>& vecPartitions,
+                             uint64_t& ui64AlternateLba, std::string& strError) {
+    const uint32_t ui32SectorSize = objDisk.SectorSize();
+    const uint64_t ui64LastLba = objDisk.Size() / ui32SectorSize - 1;
+    if (ui64HeaderLba == 0 || ui64HeaderLba > ui64LastLba) {
+        strError = "GPT头部位置无效";
+        return false;
+    }
+
+    // 1. 头部：签名、长度、CRC-32（计算时CRC字段按0处理）、自身LBA
+    std::vector<uint8_t> vecHeader(ui32SectorSize);
+    if (!objDisk.Read(ui64HeaderLba * ui32SectorSize, vecHeader.data(), ui32SectorSize, strError)) {
+        return false;
+    }
+    uint8_t* p = vecHeader.data();
+    uint32_t ui32HeaderSize = Read32(p + 12);
+    if (memcmp(p, "EFI PART", 8) != 0 || ui32HeaderSize < 92 || ui32HeaderSize > ui32SectorSize) {
+        strError = "GPT头部签名无效（LBA " + std::to_string(ui64HeaderLba) + "）";
+        return false;
+    }
+    uint32_t ui32HeaderCrc = Read32(p + 16);
+    memset(p + 16, 0, 4);
+    if (Crc32::Ieee(p, ui32HeaderSize) != ui32HeaderCrc || Read64(p + 24) != ui64HeaderLba) {
+        strError = "GPT头部校验失败（LBA " + std::to_string(ui64HeaderLba) + "）";
+        return false;
+    }
+    ui64AlternateLba = Read64(p + 32);
+
+    // 2. 分区项数组
+    uint64_t ui64FirstUsable = Read64(p + 40);
+    uint64_t ui64LastUsable = Read64(p + 48);
+    uint64_t ui64EntryLba = Read64(p + 72);
+    uint32_t ui32Entries = Read32(p + 80);
+    uint32_t ui32EntrySize = Read32(p + 84);
+    uint32_t ui32ArrayCrc = Read32(p + 88);
+    uint64_t ui64ArrayBytes = static_cast<uint64_t>(ui32Entries) * ui32EntrySize;
+    if (ui32Entries > MAX_GPT_ENTRIES || ui32EntrySize < 128 || ui32EntrySize % 8 != 0 ||
+        ui64ArrayBytes > MAX_GPT_ARRAY_BYTES || ui64EntryLba > ui64LastLba ||
+        ui64ArrayBytes > (ui64LastLba + 1 - ui64EntryLba) * ui32SectorSize) {
+        strError = "GPT分区项数组无效";
+        return false;
+    }
+    std::vector<uint8_t> vecArray(static_cast<size_t>(ui64ArrayBytes));
+    if (!objDisk.Read(ui64EntryLba * ui32SectorSize, vecArray.data(), vecArray.size(), strError)) {
+        return false;
+    }
+    if (Crc32::Ieee(vecArray.data(), vecArray.size()) != ui32ArrayCrc) {
+        strError = "GPT分区项数组校验失败";
+        return false;
+    }
+
+    // 3. 类型GUID非零的项为分区；范围不在可用区域内的项忽略
+    vecPartitions.clear();
+    for (uint32_t i = 0; i < ui32Entries; i++) {
+        const uint8_t* pEntry = vecArray.data() + static_cast<size_t>(i) * ui32EntrySize;
+        PartitionInfo stcPartition;
+        memcpy(stcPartition.objTypeGuid.ui8Bytes, pEntry, 16);
+        if (stcPartition.objTypeGuid.IsZero()) continue;
+        uint64_t ui64Start = Read64(pEntry + 32);
+        uint64_t ui64End = Read64(pEntry + 40);
+        if (ui64Start > ui64End || ui64Start < ui64FirstUsable || ui64End > ui64LastUsable || ui64End > ui64LastLba) {
+            continue;
+        }
+        memcpy(stcPartition.objPartitionGuid.ui8Bytes, pEntry + 16, 16);
+        stcPartition.bGpt = true;
+        stcPartition.nNumber = static_cast<uint32_t>(vecPartitions.size() + 1);
+        stcPartition.ui64Offset = ui64Start * ui32SectorSize;
+        stcPartition.ui64Length = (ui64End - ui64Start + 1) * ui32SectorSize;
+        stcPartition.ui64Attributes = Read64(pEntry + 48);
+        stcPartition.strName = Utf16LeToUtf8(pEntry + 56, 36);
+        vecPartitions.push_back(std::move(stcPartition));
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取MBR主分区及逻辑分区（内部辅助）
+*********************************************************************************/
+bool PartitionTable::ReadMbr(BlockDevice& objDisk, const uint8_t* pMbr, std::vector<PartitionInfo>& vecPartitions,
+                             std::string& strError) {
+    const uint32_t ui32SectorSize = objDisk.SectorSize();
+    const uint64_t ui64Sectors = objDisk.Size() / ui32SectorSize;
+    auto AddPartition = [&](std::vector<PartitionInfo>& vecTarget, const uint8_t* pEntry, uint64_t ui64BaseLba) {
+        uint64_t ui64Start = ui64BaseLba + Read32(pEntry + 8);
+        uint64_t ui64Count = Read32(pEntry + 12);
+        if (pEntry[4] == 0 || ui64Count == 0 || ui64Start == 0 || ui64Start + ui64Count > ui64Sectors) {
+            return;
+        }
+        PartitionInfo stcPartition;
+        stcPartition.ui8MbrType = pEntry[4];
+        stcPartition.bActive = pEntry[0] == 0x80;
+        stcPartition.ui64Offset = ui64Start * ui32SectorSize;
+        stcPartition.ui64Length = ui64Count * ui32SectorSize;
+        vecTarget.push_back(stcPartition);
+    };
+
+    // 主分区在前、逻辑分区在后编号
+    std::vector<PartitionInfo> vecLogical;
+    vecPartitions.clear();
+    std::vector<uint8_t> vecEbr(ui32SectorSize);
+    for (int i = 0; i < 4; i++) {
+        const uint8_t* pEntry = pMbr + 446 + 16 * i;
+        if (!IsExtendedType(pEntry[4])) {
+            AddPartition(vecPartitions, pEntry, 0);
+            continue;
+        }
+
+        // 扩展分区：EBR链，第一项是逻辑分区（相对当前EBR），第二项指向下一个EBR（相对扩展分区起点）
+        uint64_t ui64ExtendedLba = Read32(pEntry + 8);
+        uint64_t ui64EbrLba = ui64ExtendedLba;
+        for (int nGuard = 0; nGuard < MAX_EBR_CHAIN && ui64EbrLba != 0 && ui64EbrLba < ui64Sectors; nGuard++) {
+            if (!objDisk.Read(ui64EbrLba * ui32SectorSize, vecEbr.data(), ui32SectorSize, strError)) {
+                return false;
+            }
+            if (!HasBootSignature(vecEbr.data())) break;
+            AddPartition(vecLogical, vecEbr.data() + 446, ui64EbrLba);
+            const uint8_t* pNext = vecEbr.data() + 462;
+            if (!IsExtendedType(pNext[4]) || Read32(pNext + 8) == 0) break;
+            ui64EbrLba = ui64ExtendedLba + Read32(pNext + 8);
+        }
+    }
+    vecPartitions.insert(vecPartitions.end(), vecLogical.begin(), vecLogical.end());
+    for (size_t i = 0; i < vecPartitions.size(); i++) {
+        vecPartitions[i].nNumber = static_cast<uint32_t>(i + 1);
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取分区表
+*********************************************************************************/
+bool PartitionTable::Read(BlockDevice& objDisk, PartitionScheme& eScheme,
+                          std::vector<PartitionInfo>& vecPartitions, std::string& strError) {
+    eScheme = PartitionScheme::None;
+    vecPartitions.clear();
+    const uint32_t ui32SectorSize = objDisk.SectorSize();
+    if (ui32SectorSize < 512 || objDisk.Size() < 2ULL * ui32SectorSize) {
+        strError = "磁盘太小，没有分区表";
+        return false;
+    }
+
+    // 1. LBA 0：MBR（或保护性MBR）
+    std::vector<uint8_t> vecMbr(ui32SectorSize);
+    if (!objDisk.Read(0, vecMbr.data(), ui32SectorSize, strError)) {
+        return false;
+    }
+    if (!HasBootSignature(vecMbr.data())) {
+        return true;
+    }
+
+    // 2. 保护性MBR：先读主GPT，损坏时读备份GPT（主头部给出的位置，否则为最后一个LBA）
+    bool bProtective = false;
+    for (int i = 0; i < 4; i++) {
+        if (vecMbr[446 + 16 * i + 4] == MBR_TYPE_GPT_PROTECTIVE) bProtective = true;
+    }
+    if (bProtective) {
+        uint64_t ui64AlternateLba = objDisk.Size() / ui32SectorSize - 1;
+        std::string strPrimaryError;
+        if (!ReadGpt(objDisk, 1, vecPartitions, ui64AlternateLba, strPrimaryError)) {
+            uint64_t ui64Ignored = 0;
+            std::string strBackupError;
+            if (!ReadGpt(objDisk, ui64AlternateLba, vecPartitions, ui64Ignored, strBackupError)) {
+                strError = "GPT主分区表和备份分区表都已损坏（" + strPrimaryError + "；" + strBackupError + "）";
+                return false;
+            }
+        }
+        eScheme = PartitionScheme::Gpt;
+        return true;
+    }
+
+    // 3. 整个磁盘就是NTFS卷（引导扇区也带0x55AA签名，必须在解析MBR之前判断）
+    if (memcmp(vecMbr.data() + 3, "NTFS    ", 8) == 0) {
+        PartitionInfo stcWhole;
+        stcWhole.nNumber = 1;
+        stcWhole.ui8MbrType = MBR_TYPE_NTFS;
+        stcWhole.ui64Length = objDisk.Size();
+        vecPartitions.push_back(stcWhole);
+        return true;
+    }
+
+    // 4. 传统MBR
+    if (!ReadMbr(objDisk, vecMbr.data(), vecPartitions, strError)) {
+        return false;
+    }
+    eScheme = PartitionScheme::Mbr;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：检查NTFS引导扇区
+*********************************************************************************/
+bool PartitionTable::IsNtfsVolume(BlockDevice& objDisk, const PartitionInfo& stcPartition) {
+    uint8_t ui8Boot[512];
+    std::string strIgnored;
+    if (stcPartition.ui64Length < sizeof(ui8Boot) ||
+        !objDisk.Read(stcPartition.ui64Offset, ui8Boot, sizeof(ui8Boot), strIgnored)) {
+        return false;
+    }
+    if (memcmp(ui8Boot + 3, "NTFS    ", 8) != 0 || !HasBootSignature(ui8Boot)) {
+        return false;
+    }
+
+    // BPB：扇区大小256~4096且为2的幂；每簇扇区数大于0x80时表示2^(256-值)
+    uint32_t ui32BytesPerSector = Read16(ui8Boot + 11);
+    if (ui32BytesPerSector < 256 || ui32BytesPerSector > 4096 || (ui32BytesPerSector & (ui32BytesPerSector - 1)) != 0) {
+        return false;
+    }
+    uint8_t ui8SectorsPerCluster = ui8Boot[13];
+    uint64_t ui64ClusterSize;
+    if (ui8SectorsPerCluster == 0) {
+        return false;
+    } else if (ui8SectorsPerCluster <= 0x80) {
+        if ((ui8SectorsPerCluster & (ui8SectorsPerCluster - 1)) != 0) return false;
+        ui64ClusterSize = static_cast<uint64_t>(ui8SectorsPerCluster) * ui32BytesPerSector;
+    } else {
+        int nShift = 256 - ui8SectorsPerCluster;
+        if (nShift > 31) return false;
+        ui64ClusterSize = static_cast<uint64_t>(1) << nShift;
+    }
+
+    // 卷大小不超过分区，$MFT位于卷内
+    uint64_t ui64TotalSectors = Read64(ui8Boot + 40);
+    uint64_t ui64MftLcn = Read64(ui8Boot + 48);
+    if (ui64TotalSectors == 0 || ui64TotalSectors > stcPartition.ui64Length / ui32BytesPerSector) {
+        return false;
+    }
+    return ui64MftLcn != 0 && ui64MftLcn < ui64TotalSectors * ui32BytesPerSector / ui64ClusterSize;
+}
+
+/********************************************************************************
+* 函数实现：定位Windows系统分区
+*********************************************************************************/
+bool PartitionTable::FindWindowsPartition(BlockDevice& objDisk, const VolumeProbe& fnProbe,
+                                          PartitionInfo& stcPartition, std::string& strError) {
+    PartitionScheme eScheme;
+    std::vector<PartitionInfo> vecPartitions;
+    if (!Read(objDisk, eScheme, vecPartitions, strError)) {
+        return false;
+    }
+
+    const PartitionInfo* pLargest = nullptr;
+    for (const auto& stcCandidate : vecPartitions) {
+        if (!stcCandidate.IsBasicData() || !IsNtfsVolume(objDisk, stcCandidate)) {
+            continue;
+        }
+        if (fnProbe) {
+            PartitionDevice objVolume(objDisk, stcCandidate.ui64Offset, stcCandidate.ui64Length);
+            if (fnProbe(objVolume)) {
+                stcPartition = stcCandidate;
+                return true;
+            }
+        } else if (!pLargest || stcCandidate.ui64Length > pLargest->ui64Length) {
+            pLargest = &stcCandidate;
+        }
+    }
+    if (pLargest) {
+        stcPartition = *pLargest;
+        return true;
+    }
+    strError = fnProbe ? "没有找到包含Windows系统的分区" : "没有找到NTFS基本数据分区";
+    return false;
+}
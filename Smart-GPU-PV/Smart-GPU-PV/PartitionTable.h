@@ -0,0 +1,154 @@
+﻿/********************************************************************************
+* 文件名称：PartitionTable.h
+* 文件功能：解析GPT/MBR分区表，不挂载定位虚拟机的Windows系统分区
+*
+* 类说明：
+*    过去挂载虚拟磁盘后用Get-Partition枚举分区，逐个分配临时盘符再检查
+*    Windows\System32；VhdHelper甚至遍历主机的C~Z盘符，可能选中主机
+*    自己的C盘。PartitionTable直接读取任意块设备上的分区表：
+*    - 保护性MBR + GPT：校验头部和分区项数组的CRC-32，主GPT损坏时使用
+*      磁盘末尾的备份GPT
+*    - 传统MBR：4个主分区及扩展分区中的逻辑分区（EBR链）
+*    - 无分区表、整个磁盘就是NTFS卷（superfloppy）时视为一个分区
+*    FindWindowsPartition在基本数据分区中按NTFS引导扇区筛选，再由调用者
+*    提供的探测函数检查卷内容，整个过程只读取少量扇区，不分配盘符。
+*
+* 依赖项：
+*    - BlockDevice（块设备接口）
+*    - ContentHash（CRC-32）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "BlockDevice.h"
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+/********************************************************************************
+* 枚举名称：分区表类型
+*********************************************************************************/
+enum class PartitionScheme {
+    None,       // 没有分区表
+    Mbr,        // 传统MBR
+    Gpt         // GUID分区表
+};
+
+/********************************************************************************
+* 结构体名称：分区信息
+*********************************************************************************/
+struct PartitionInfo {
+    uint32_t    nNumber = 0;            // 分区序号（从1开始，按分区表顺序）
+    uint64_t    ui64Offset = 0;         // 起始偏移（字节，与Get-Partition的Offset一致）
+    uint64_t    ui64Length = 0;         // 长度（字节）
+    bool        bGpt = false;           // 是否GPT分区
+    uint8_t     ui8MbrType = 0;         // MBR分区类型（GPT分区为0）
+    bool        bActive = false;        // MBR活动分区标志
+    DiskGuid    objTypeGuid;            // GPT分区类型
+    DiskGuid    objPartitionGuid;       // GPT分区唯一ID
+    uint64_t    ui64Attributes = 0;     // GPT分区属性
+    std::string strName;                // GPT分区名称（UTF-8）
+
+    /********************************************************************************
+    * 函数名称：是否基本数据分区
+    * 返回类型：bool
+    *    GPT基本数据分区，或MBR的NTFS/exFAT（0x07）分区
+    *********************************************************************************/
+    bool IsBasicData() const;
+
+    /********************************************************************************
+    * 函数名称：取类型名称
+    * 返回类型：std::string
+    *    常见类型的名称（如"EFI系统分区"），其他类型返回GUID或十六进制类型值
+    *********************************************************************************/
+    std::string TypeName() const;
+};
+
+/********************************************************************************
+* 类名称：分区视图
+* 类功能：把块设备中的一段范围当作独立的块设备（偏移从分区起点算起）
+*********************************************************************************/
+class PartitionDevice : public BlockDevice {
+public:
+    PartitionDevice(BlockDevice& objDisk, uint64_t ui64Offset, uint64_t ui64Length)
+        : m_objDisk(objDisk), m_ui64Offset(ui64Offset), m_ui64Length(ui64Length) {}
+
+    uint64_t Size() const override { return m_ui64Length; }
+    uint32_t SectorSize() const override { return m_objDisk.SectorSize(); }
+    bool IsReadOnly() const override { return m_objDisk.IsReadOnly(); }
+    bool Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) override;
+    bool Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) override;
+    bool Flush(std::string& strError) override { return m_objDisk.Flush(strError); }
+
+private:
+    BlockDevice& m_objDisk;         // 所在磁盘
+    uint64_t     m_ui64Offset;      // 分区起始偏移
+    uint64_t     m_ui64Length;      // 分区长度
+};
+
+/********************************************************************************
+* 类名称：分区表
+* 类功能：读取分区表并定位Windows系统分区
+*
+* 调用示例：
+*    VhdxFile objDisk;
+*    objDisk.Open(strVhdxPath, true, strError);
+*    PartitionInfo stcPartition;
+*    // NtfsVolume::IsWindowsSystemVolume检查卷中是否有Windows\System32
+*    if (PartitionTable::FindWindowsPartition(objDisk, NtfsVolume::IsWindowsSystemVolume, stcPartition, strError)) {
+*        // stcPartition.ui64Offset 为系统分区的起始偏移
+*    }
+*********************************************************************************/
+class PartitionTable {
+public:
+    // 卷内容探测函数：参数为分区视图，确认是Windows系统卷时返回true
+    using VolumeProbe = std::function<bool(BlockDevice& objVolume)>;
+
+    /********************************************************************************
+    * 函数名称：读取分区表
+    * 函数参数：
+    *    [IN]  BlockDevice& objDisk：磁盘
+    *    [OUT] PartitionScheme& eScheme：分区表类型
+    *    [OUT] std::vector<PartitionInfo>& vecPartitions：分区（按分区表顺序）
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    *    读取失败或分区表损坏（GPT主备都无效）返回false
+    *********************************************************************************/
+    static bool Read(BlockDevice& objDisk, PartitionScheme& eScheme,
+                     std::vector<PartitionInfo>& vecPartitions, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：检查NTFS引导扇区
+    * 函数参数：
+    *    [IN]  BlockDevice& objDisk：磁盘
+    *    [IN]  const PartitionInfo& stcPartition：分区
+    * 返回类型：bool
+    *    引导扇区是有效的NTFS引导扇区（OEM ID、BPB取值范围、卷大小不超过分区）
+    *********************************************************************************/
+    static bool IsNtfsVolume(BlockDevice& objDisk, const PartitionInfo& stcPartition);
+
+    /********************************************************************************
+    * 函数名称：定位Windows系统分区
+    * 函数参数：
+    *    [IN]  BlockDevice& objDisk：磁盘
+    *    [IN]  const VolumeProbe& fnProbe：卷内容探测函数（可为空）
+    *    [OUT] PartitionInfo& stcPartition：系统分区
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    * 注意事项：
+    *    - 只考虑基本数据分区中的NTFS卷（EFI、MSR、恢复分区被排除）
+    *    - 有探测函数时返回第一个探测成功的卷；没有探测函数时返回最大的NTFS卷
+    *********************************************************************************/
+    static bool FindWindowsPartition(BlockDevice& objDisk, const VolumeProbe& fnProbe,
+                                     PartitionInfo& stcPartition, std::string& strError);
+
+private:
+    static bool ReadGpt(BlockDevice& objDisk, uint64_t ui64HeaderLba, std::vector<PartitionInfo>& vecPartitions,
+                        uint64_t& ui64AlternateLba, std::string& strError);
+    static bool ReadMbr(BlockDevice& objDisk, const uint8_t* pMbr, std::vector<PartitionInfo>& vecPartitions,
+                        std::string& strError);
+};
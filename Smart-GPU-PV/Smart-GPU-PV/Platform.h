@@ -0,0 +1,58 @@
+﻿/********************************************************************************
+* 文件名称：Platform.h
+* 文件功能：执行器接口使用的Windows基本类型及其在其他平台上的等价定义
+*
+* 说明：
+*    ProcessBackend、PowerShellHost、PowerShellExecutor、QueryCache等接口以
+*    DWORD表示超时、以ERROR_TIMEOUT/ERROR_CANCELLED表示超时和取消的退出码。
+*    在Windows上直接包含windows.h；在其他平台上提供同名的最小定义，
+*    帧协议、宿主进程池、查询缓存等纯逻辑代码因此可以在Linux上编译，
+*    配合替身进程后端进行测试和基准测试。
+*    复制引擎和驱动清单写入镜像的文件属性也使用FILE_ATTRIBUTE_*的取值。
+*
+* 依赖项：
+*    - Windows API（仅Windows）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdint>
+#include <chrono>
+
+typedef uint32_t           DWORD;
+typedef unsigned long long ULONGLONG;
+typedef unsigned int       UINT;
+
+#ifndef INFINITE
+#define INFINITE 0xFFFFFFFF
+#endif
+
+// 与winerror.h中的取值相同，退出码在各平台上含义一致
+#define ERROR_TIMEOUT   1460L
+#define ERROR_CANCELLED 1223L
+
+// 与winnt.h中的取值相同：写入镜像的属性和清单在各平台上含义一致
+#define FILE_ATTRIBUTE_READONLY            0x00000001
+#define FILE_ATTRIBUTE_HIDDEN              0x00000002
+#define FILE_ATTRIBUTE_SYSTEM              0x00000004
+#define FILE_ATTRIBUTE_DIRECTORY           0x00000010
+#define FILE_ATTRIBUTE_ARCHIVE             0x00000020
+#define FILE_ATTRIBUTE_NOT_CONTENT_INDEXED 0x00002000
+#define INVALID_FILE_ATTRIBUTES            0xFFFFFFFF
+
+/********************************************************************************
+* 函数名称：取单调时间
+* 返回类型：ULONGLONG
+*    单调递增的毫秒计数（起点任意），与Windows的GetTickCount64用法相同
+*********************************************************************************/
+inline ULONGLONG GetTickCount64() {
+    return static_cast<ULONGLONG>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+#endif
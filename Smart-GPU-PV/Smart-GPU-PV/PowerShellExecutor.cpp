@@ -3,14 +3,19 @@
 * 文件功能：实现PowerShell命令执行功能
 * 
 * 实现说明：
-*    本文件通过CreateProcess API创建PowerShell进程，使用匿名管道捕获
-*    标准输出和标准错误。支持长时间运行的命令，并自动处理编码问题。
+*    命令优先交给常驻PowerShell宿主进程池执行；宿主不可用时，通过
+*    ProcessBackend启动独立的PowerShell进程执行。两种方式的输出都经过
+*    相同的编码处理，调用者无需区分。
 * 
 * 技术要点：
 *    1. 命令行转义：正确处理双引号和反斜杠的转义
-*    2. 管道操作：使用两个独立线程并行读取stdout和stderr，防止死锁
+*    2. 宿主降级：只有命令尚未发送给宿主时才降级重试，避免重复执行
 *    3. 编码处理：设置UTF-8输出编码，并自动修复GBK乱码
 *    4. BOM处理：自动移除UTF-8 BOM标记
+*    5. 超时处理：每次调用都有截止时间，超时后由进程后端结束整个进程树，
+*       结果中bTimedOut为true、退出码为ERROR_TIMEOUT
+*    6. 录制/回放：启用Transcript时，每条命令整理后的结果交给录制器；
+*       回放模式下命令不执行，结果来自记录文件（调用记录的方式为replay）
 * 
 * 作者：Smart-GPU-PV Team
 * 日期：2026-01-26
@@ -18,10 +23,28 @@
 *********************************************************************************/
 
 #include "PowerShellExecutor.h"
+#include "PowerShellHost.h"
+#include "QueryCache.h"
+#include "ExecutorTrace.h"
+#include "ScriptRegistry.h"
+#include "TranscriptBackend.h"
 #include "Utils.h"
 #include <vector>
-#include <thread>
 #include <string>
+#include <mutex>
+#include <future>
+#include <thread>
+
+// 执行器全局状态（进程后端、宿主进程池）
+static std::mutex                          g_mtxExecutor;
+#ifdef _WIN32
+static std::shared_ptr<ProcessBackend>     g_pBackend = std::make_shared<Win32ProcessBackend>();
+#else
+static std::shared_ptr<ProcessBackend>     g_pBackend = std::make_shared<PosixProcessBackend>();
+#endif
+static std::shared_ptr<PowerShellHostPool> g_pHostPool;
+static bool                                g_bUseHost = true;
+static size_t                              g_nHostPoolSize = 2;
 
 /********************************************************************************
 * 函数名称：移除UTF-8 BOM（内部辅助函数）
@@ -41,13 +64,128 @@ void RemoveBOM(std::string& str) {
     }
 }
 
+/********************************************************************************
+* 函数名称：整理命令输出（内部辅助函数）
+* 函数功能：移除BOM、修复GBK乱码并修剪首尾空白
+* 函数参数：
+*    [IN]  std::string strRaw：原始输出
+* 返回类型：std::string
+*    整理后的输出
+*********************************************************************************/
+static std::string NormalizeOutput(std::string strRaw) {
+    // 1. 移除BOM标记
+    RemoveBOM(strRaw);
+    
+    // 2. 修复可能的GBK乱码
+    strRaw = Utils::RepairString(strRaw);
+    
+    // 3. 修剪首尾空白
+    return Utils::Trim(strRaw);
+}
+
+/********************************************************************************
+* 函数名称：完成命令结果（内部辅助函数）
+* 函数功能：整理输出编码；超时或取消时补充可识别的错误信息
+* 函数参数：
+*    [IN/OUT] CommandResult& stcResult：原始命令结果
+* 返回类型：bool
+*    命令成功（未超时且退出码为0）返回true
+*********************************************************************************/
+static bool FinishResult(CommandResult& stcResult) {
+    // 1. 整理输出
+    stcResult.strOutput = NormalizeOutput(stcResult.strOutput);
+    stcResult.strError = NormalizeOutput(stcResult.strError);
+    
+    // 2. 超时：在错误信息前加上明确的提示
+    if (stcResult.bTimedOut) {
+        std::string strTimeout = "命令执行超时，已结束PowerShell进程";
+        stcResult.strError = stcResult.strError.empty() ? strTimeout : strTimeout + ": " + stcResult.strError;
+        return false;
+    }
+    
+    // 3. 取消：同样补充提示
+    if (stcResult.bCancelled) {
+        std::string strCancelled = "命令已取消，已结束PowerShell进程";
+        stcResult.strError = stcResult.strError.empty() ? strCancelled : strCancelled + ": " + stcResult.strError;
+        return false;
+    }
+    return (stcResult.nExitCode == 0);
+}
+
+/********************************************************************************
+* 函数名称：计算剩余时间（内部辅助函数）
+* 函数参数：
+*    [IN]  ULONGLONG ui64Deadline：截止时刻（GetTickCount64），0表示不限
+* 返回类型：DWORD
+*    剩余毫秒数（INFINITE表示不限，已过期返回0）
+*********************************************************************************/
+static DWORD RemainingMs(ULONGLONG ui64Deadline) {
+    if (ui64Deadline == 0) return INFINITE;
+    ULONGLONG ui64Now = GetTickCount64();
+    return (ui64Now >= ui64Deadline) ? 0 : static_cast<DWORD>(ui64Deadline - ui64Now);
+}
+
+/********************************************************************************
+* 函数名称：保存调用记录（内部辅助函数）
+* 函数参数：
+*    [IN]  const char* pszKind：执行方式（host / oneshot / stream / async / batch / cache）
+*    [IN]  const std::string& strCommand：命令文本
+*    [IN]  const std::string& strLabel：操作标签
+*    [IN]  uint64_t ui64StartUs：调用开始时刻（ExecutorTrace::NowUs）
+*    [IN]  const CommandResult& stcResult：整理后的命令结果
+*    [IN]  uint64_t ui64StdoutBytes：标准输出字节数
+*********************************************************************************/
+static void TraceCommand(const char* pszKind, 
+                         const std::string& strCommand, 
+                         const std::string& strLabel, 
+                         uint64_t ui64StartUs, 
+                         const CommandResult& stcResult, 
+                         uint64_t ui64StdoutBytes) {
+    TraceRecord stcRecord;
+    stcRecord.strLabel = strLabel;
+    stcRecord.strKind = pszKind;
+    stcRecord.strCommand = strCommand;
+    stcRecord.ui64StartUs = ui64StartUs;
+    stcRecord.ui64SpawnUs = stcResult.ui64SpawnUs;
+    stcRecord.ui64FirstByteUs = stcResult.ui64FirstByteUs;
+    stcRecord.ui64WallUs = ExecutorTrace::NowUs() - ui64StartUs;
+    stcRecord.nExitCode = stcResult.nExitCode;
+    stcRecord.bTimedOut = stcResult.bTimedOut;
+    stcRecord.ui64StdoutBytes = ui64StdoutBytes;
+    stcRecord.ui64StderrBytes = stcResult.strError.size();
+    ExecutorTrace::Record(std::move(stcRecord));
+}
+
+/********************************************************************************
+* 函数名称：回放一条命令（内部辅助函数）
+* 函数参数：
+*    [IN]  CommandRecorder& objRecorder：回放器
+*    [IN]  const char* pszKind：录制方式（run / stream / async）
+*    [IN]  const std::string& strCommand：命令文本
+*    [IN]  const std::string& strLabel：操作标签
+*    [OUT] CommandResult& stcResult：录制的结果（未命中时为失败结果）
+* 返回类型：bool
+*    找到记录且录制时命令成功返回true
+*********************************************************************************/
+static bool ReplayCommand(CommandRecorder& objRecorder, 
+                          const char* pszKind, 
+                          const std::string& strCommand, 
+                          const std::string& strLabel, 
+                          CommandResult& stcResult) {
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    bool bResult = objRecorder.Replay(pszKind, strCommand, stcResult) &&
+                   stcResult.nExitCode == 0 && !stcResult.bTimedOut && !stcResult.bCancelled;
+    TraceCommand("replay", strCommand, strLabel, ui64StartUs, stcResult, stcResult.strOutput.size());
+    return bResult;
+}
+
 /********************************************************************************
 * 函数实现：执行PowerShell命令
 *********************************************************************************/
-std::string PowerShellExecutor::Execute(const std::string& strCommand) {
+std::string PowerShellExecutor::Execute(const std::string& strCommand, DWORD dwTimeoutMs) {
     // 1. 调用带错误检查的执行函数
     std::string strOutput, strError;
-    ExecuteWithCheck(strCommand, strOutput, strError);
+    ExecuteWithCheck(strCommand, strOutput, strError, dwTimeoutMs);
     
     // 2. 返回标准输出（忽略错误输出）
     return strOutput;
@@ -58,9 +196,238 @@ std::string PowerShellExecutor::Execute(const std::string& strCommand) {
 *********************************************************************************/
 bool PowerShellExecutor::ExecuteWithCheck(const std::string& strCommand, 
                                           std::string& strOutput, 
-                                          std::string& strError) {
-    // 1. 构造完整的PowerShell命令（设置UTF-8输出编码）
-    std::string strFullCommand = "[Console]::OutputEncoding = [System.Text.Encoding]::UTF8; " + strCommand;
+                                          std::string& strError, 
+                                          DWORD dwTimeoutMs) {
+    CommandResult stcResult;
+    bool bResult = ExecuteWithResult(strCommand, stcResult, dwTimeoutMs);
+    strOutput = std::move(stcResult.strOutput);
+    strError = std::move(stcResult.strError);
+    return bResult;
+}
+
+/********************************************************************************
+* 函数实现：执行PowerShell命令并返回完整结果
+*********************************************************************************/
+bool PowerShellExecutor::ExecuteWithResult(const std::string& strCommand, 
+                                           CommandResult& stcResult, 
+                                           DWORD dwTimeoutMs) {
+    // 未经缓存的命令视为修改性命令，执行后清除其涉及的虚拟机的缓存
+    bool bResult = ExecuteUncached(strCommand, stcResult, dwTimeoutMs);
+    QueryCache::Instance().InvalidateMatching(strCommand);
+    return bResult;
+}
+
+/********************************************************************************
+* 函数实现：执行只读查询（带缓存）
+*********************************************************************************/
+bool PowerShellExecutor::ExecuteCached(const std::string& strCommand, 
+                                       const std::string& strScope, 
+                                       DWORD dwTtlMs, 
+                                       CommandResult& stcResult, 
+                                       DWORD dwTimeoutMs) {
+    // 1. 查找缓存（只缓存成功的结果，命中即成功）
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    std::string strKey = "ps:" + QueryCache::NormalizeKey(strCommand);
+    uint64_t ui64Generation = QueryCache::Instance().Generation(strScope);
+    std::shared_ptr<const CommandResult> pCached;
+    if (QueryCache::Instance().Lookup(strKey, pCached)) {
+        stcResult = *pCached;
+        stcResult.ui64SpawnUs = 0;
+        stcResult.ui64FirstByteUs = 0;
+        TraceCommand("cache", strCommand, ExecutorTrace::CurrentLabel(), ui64StartUs, stcResult, stcResult.strOutput.size());
+        return true;
+    }
+    
+    // 2. 未命中：执行查询，成功时保存结果（执行期间作用域被清除过时由缓存丢弃）
+    if (!ExecuteUncached(strCommand, stcResult, dwTimeoutMs)) {
+        return false;
+    }
+    QueryCache::Instance().Store(strKey, strScope, std::make_shared<const CommandResult>(stcResult), dwTtlMs,
+                                 ui64Generation);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：执行命令（不经过缓存）
+*********************************************************************************/
+bool PowerShellExecutor::ExecuteUncached(const std::string& strCommand, 
+                                         CommandResult& stcResult, 
+                                         DWORD dwTimeoutMs) {
+    // 1. 回放模式：结果来自记录文件
+    std::shared_ptr<CommandRecorder> pRecorder = Transcript::Active();
+    if (pRecorder && pRecorder->IsReplaying()) {
+        return ReplayCommand(*pRecorder, "run", strCommand, ExecutorTrace::CurrentLabel(), stcResult);
+    }
+    
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    const char* pszKind = "host";
+    bool bResult = false;
+    
+    // 2. 优先使用常驻宿主执行
+    std::vector<CommandResult> vecHostResults;
+    bool bRequestSent = false;
+    if (ExecuteViaHost({ strCommand }, false, dwTimeoutMs, vecHostResults, bRequestSent)) {
+        stcResult = std::move(vecHostResults[0]);
+        bResult = FinishResult(stcResult);
+    } else if (bRequestSent) {
+        // 2.1 命令可能已部分执行，不能重试（例如Mount-VHD、Copy-Item）
+        if (!vecHostResults.empty() && vecHostResults[0].bTimedOut) {
+            stcResult = std::move(vecHostResults[0]);
+            bResult = FinishResult(stcResult);
+        } else {
+            stcResult = CommandResult();
+            stcResult.strError = "PowerShell宿主进程意外退出";
+        }
+    } else {
+        // 2.2 宿主不可用，降级为独立进程执行
+        pszKind = "oneshot";
+        bResult = ExecuteOneShot(strCommand, dwTimeoutMs, stcResult);
+    }
+    
+    // 3. 记录调用（录制模式下同时录制整理后的结果）
+    TraceCommand(pszKind, strCommand, ExecutorTrace::CurrentLabel(), ui64StartUs, stcResult, stcResult.strOutput.size());
+    if (pRecorder) {
+        pRecorder->Record("run", strCommand, stcResult, ExecutorTrace::NowUs() - ui64StartUs);
+    }
+    return bResult;
+}
+
+/********************************************************************************
+* 函数实现：以独立进程执行PowerShell命令
+*********************************************************************************/
+bool PowerShellExecutor::ExecuteOneShot(const std::string& strCommand, 
+                                        DWORD dwTimeoutMs, 
+                                        CommandResult& stcResult) {
+    return ExecuteCommand(BuildCommandLine(strCommand), dwTimeoutMs, stcResult);
+}
+
+/********************************************************************************
+* 函数实现：流式执行PowerShell命令
+*********************************************************************************/
+bool PowerShellExecutor::ExecuteStreaming(const std::string& strCommand, 
+                                          const LineSink& fnSink, 
+                                          std::string& strError, 
+                                          DWORD dwTimeoutMs) {
+    // 1. 回放模式：录制的输出按行推送
+    std::shared_ptr<CommandRecorder> pRecorder = Transcript::Active();
+    if (pRecorder && pRecorder->IsReplaying()) {
+        CommandResult stcResult;
+        bool bResult = ReplayCommand(*pRecorder, "stream", strCommand, ExecutorTrace::CurrentLabel(), stcResult);
+        std::string_view svOutput = stcResult.strOutput, svLine;
+        while (Utils::NextLine(svOutput, svLine)) {
+            fnSink(svLine);
+        }
+        strError = std::move(stcResult.strError);
+        return bResult;
+    }
+    
+    // 2. 取得当前进程后端
+    std::shared_ptr<ProcessBackend> pBackend;
+    {
+        std::lock_guard<std::mutex> lock(g_mtxExecutor);
+        pBackend = g_pBackend;
+    }
+    
+    // 3. 包装回调：移除首行BOM，只有非UTF-8的行才复制并修复编码；
+    //    录制模式下同时保存推送的每一行
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    uint64_t ui64StdoutBytes = 0;
+    bool bFirstLine = true;
+    std::string strRecorded;
+    auto fnDeliver = [&](std::string_view svLine) {
+        if (pRecorder) {
+            strRecorded.append(svLine);
+            strRecorded += '\n';
+        }
+        fnSink(svLine);
+    };
+    auto fnRepairSink = [&](std::string_view svLine) {
+        ui64StdoutBytes += svLine.size() + 1;
+        if (bFirstLine) {
+            bFirstLine = false;
+            if (svLine.size() >= 3 && svLine.substr(0, 3) == "\xEF\xBB\xBF") {
+                svLine.remove_prefix(3);
+            }
+        }
+        if (Utils::IsValidUTF8(svLine)) {
+            fnDeliver(svLine);
+        } else {
+            std::string strRepaired = Utils::RepairString(std::string(svLine));
+            fnDeliver(strRepaired);
+        }
+    };
+    
+    // 4. 启动进程，输出在当前线程上逐行推送
+    CommandResult stcResult;
+    if (!pBackend->RunStreaming(BuildCommandLine(strCommand), dwTimeoutMs, fnRepairSink, stcResult)) {
+        strError = stcResult.strError;
+        TraceCommand("stream", strCommand, ExecutorTrace::CurrentLabel(), ui64StartUs, stcResult, ui64StdoutBytes);
+        return false;
+    }
+    
+    // 5. 处理错误输出并返回执行结果
+    bool bResult = FinishResult(stcResult);
+    TraceCommand("stream", strCommand, ExecutorTrace::CurrentLabel(), ui64StartUs, stcResult, ui64StdoutBytes);
+    if (pRecorder) {
+        stcResult.strOutput = std::move(strRecorded);
+        pRecorder->Record("stream", strCommand, stcResult, ExecutorTrace::NowUs() - ui64StartUs);
+    }
+    strError = std::move(stcResult.strError);
+    QueryCache::Instance().InvalidateMatching(strCommand);
+    return bResult;
+}
+
+/********************************************************************************
+* 函数实现：异步执行PowerShell命令
+*********************************************************************************/
+std::future<CommandResult> PowerShellExecutor::ExecuteAsync(const std::string& strCommand, 
+                                                            const CancellationToken& objCancel, 
+                                                            DWORD dwTimeoutMs) {
+    auto pPromise = std::make_shared<std::promise<CommandResult>>();
+    std::future<CommandResult> futResult = pPromise->get_future();
+    std::string strLabel = ExecutorTrace::CurrentLabel();
+    
+    // 1. 回放模式：在单独的线程上按录制耗时等待后完成
+    std::shared_ptr<CommandRecorder> pRecorder = Transcript::Active();
+    if (pRecorder && pRecorder->IsReplaying()) {
+        std::thread([pRecorder, pPromise, strCommand, strLabel]() {
+            CommandResult stcResult;
+            ReplayCommand(*pRecorder, "async", strCommand, strLabel, stcResult);
+            pPromise->set_value(std::move(stcResult));
+        }).detach();
+        return futResult;
+    }
+    
+    // 2. 取得当前进程后端
+    std::shared_ptr<ProcessBackend> pBackend;
+    {
+        std::lock_guard<std::mutex> lock(g_mtxExecutor);
+        pBackend = g_pBackend;
+    }
+    
+    // 3. 结果通过promise交给调用者，整理输出在完成回调中进行
+    //    （回调在完成循环线程上执行，标签在发起时取得）
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    pBackend->RunAsync(BuildCommandLine(strCommand), dwTimeoutMs, objCancel,
+                       [pPromise, pRecorder, strCommand, strLabel, ui64StartUs](CommandResult& stcResult) {
+        FinishResult(stcResult);
+        TraceCommand("async", strCommand, strLabel, ui64StartUs, stcResult, stcResult.strOutput.size());
+        if (pRecorder) {
+            pRecorder->Record("async", strCommand, stcResult, ExecutorTrace::NowUs() - ui64StartUs);
+        }
+        QueryCache::Instance().InvalidateMatching(strCommand);
+        pPromise->set_value(std::move(stcResult));
+    });
+    return futResult;
+}
+
+/********************************************************************************
+* 函数实现：构造PowerShell命令行
+*********************************************************************************/
+std::string PowerShellExecutor::BuildCommandLine(const std::string& strCommand) {
+    // 1. 构造完整的PowerShell命令（设置UTF-8输出编码，附加命令引用的注册脚本函数）
+    std::string strFullCommand = "[Console]::OutputEncoding = [System.Text.Encoding]::UTF8; " +
+                                 ScriptRegistry::Instance().WithDefinitions(strCommand);
     
     // 2. 转义命令行参数（处理双引号和反斜杠）
     // 2.1 初始化转义后的命令字符串
@@ -93,169 +460,342 @@ bool PowerShellExecutor::ExecuteWithCheck(const std::string& strCommand,
     strCmdLine += strEscapedCommand;
     strCmdLine += "\"";
     
-    // 4. 执行命令
-    return ExecuteCommand(strCmdLine, strOutput, strError);
+    return strCmdLine;
 }
 
 /********************************************************************************
 * 函数实现：执行PowerShell脚本文件
 *********************************************************************************/
-std::string PowerShellExecutor::ExecuteScript(const std::string& strScriptPath) {
+std::string PowerShellExecutor::ExecuteScript(const std::string& strScriptPath, DWORD dwTimeoutMs) {
     // 1. 构建脚本执行命令行
     std::string strCmdLine = "powershell.exe -NoProfile -ExecutionPolicy Bypass -File \"" + strScriptPath + "\"";
     
     // 2. 执行脚本
-    std::string strOutput, strError;
-    ExecuteCommand(strCmdLine, strOutput, strError);
+    CommandResult stcResult;
+    ExecuteCommand(strCmdLine, dwTimeoutMs, stcResult);
     
-    return strOutput;
+    return stcResult.strOutput;
 }
 
 /********************************************************************************
-* 函数实现：创建管道并执行命令
+* 函数实现：创建进程并执行命令
 *********************************************************************************/
 bool PowerShellExecutor::ExecuteCommand(const std::string& strCmdLine, 
-                                        std::string& strOutput, 
-                                        std::string& strError) {
-    // 1. 初始化安全属性（允许句柄继承）
-    SECURITY_ATTRIBUTES stcSA = {0};
-    stcSA.nLength = sizeof(SECURITY_ATTRIBUTES);
-    stcSA.bInheritHandle = TRUE;
-    stcSA.lpSecurityDescriptor = nullptr;
-    
-    // 2. 创建标准输出管道
-    HANDLE hStdoutRead = nullptr;
-    HANDLE hStdoutWrite = nullptr;
-    if (!CreatePipe(&hStdoutRead, &hStdoutWrite, &stcSA, 0)) {
-        strError = "无法创建输出管道";
-        return false;
+                                        DWORD dwTimeoutMs, 
+                                        CommandResult& stcResult) {
+    // 1. 取得当前进程后端
+    std::shared_ptr<ProcessBackend> pBackend;
+    {
+        std::lock_guard<std::mutex> lock(g_mtxExecutor);
+        pBackend = g_pBackend;
     }
     
-    // 3. 创建标准错误管道
-    HANDLE hStderrRead = nullptr;
-    HANDLE hStderrWrite = nullptr;
-    if (!CreatePipe(&hStderrRead, &hStderrWrite, &stcSA, 0)) {
-        CloseHandle(hStdoutRead);
-        CloseHandle(hStdoutWrite);
-        strError = "无法创建错误管道";
+    // 2. 启动进程并等待结束（超过截止时间时后端结束整个进程树）
+    if (!pBackend->Run(strCmdLine, dwTimeoutMs, stcResult)) {
         return false;
     }
     
-    // 4. 确保读取端不被子进程继承
-    SetHandleInformation(hStdoutRead, HANDLE_FLAG_INHERIT, 0);
-    SetHandleInformation(hStderrRead, HANDLE_FLAG_INHERIT, 0);
-    
-    // 5. 配置进程启动信息
-    STARTUPINFOA stcSI = {0};
-    stcSI.cb = sizeof(STARTUPINFOA);
-    stcSI.hStdOutput = hStdoutWrite;
-    stcSI.hStdError = hStderrWrite;
-    stcSI.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
-    stcSI.wShowWindow = SW_HIDE;  // 隐藏PowerShell窗口
-    
-    PROCESS_INFORMATION stcPI = {0};
-    
-    // 6. 准备可修改的命令行缓冲区（CreateProcessA要求）
-    std::vector<char> vecCmdLineBuf(strCmdLine.begin(), strCmdLine.end());
-    vecCmdLineBuf.push_back(0);  // 添加空终止符
-    
-    // 7. 创建PowerShell进程
-    BOOL bSuccess = CreateProcessA(
-        nullptr,                    // 应用程序名称（使用命令行中的）
-        vecCmdLineBuf.data(),      // 命令行
-        nullptr,                    // 进程安全属性
-        nullptr,                    // 线程安全属性
-        TRUE,                       // 继承句柄
-        CREATE_NO_WINDOW,          // 创建标志（无窗口）
-        nullptr,                    // 环境变量
-        nullptr,                    // 当前目录
-        &stcSI,                    // 启动信息
-        &stcPI                     // 进程信息
-    );
-    
-    // 8. 父进程不需要写入端，立即关闭
-    CloseHandle(hStdoutWrite);
-    CloseHandle(hStderrWrite);
-    
-    // 9. 检查进程创建是否成功
-    if (!bSuccess) {
-        CloseHandle(hStdoutRead);
-        CloseHandle(hStderrRead);
-        strError = "无法启动PowerShell进程";
-        return false;
+    // 3. 处理输出数据并返回执行结果（退出码0表示成功）
+    return FinishResult(stcResult);
+}
+
+/********************************************************************************
+* 函数实现：通过常驻宿主执行命令
+*********************************************************************************/
+bool PowerShellExecutor::ExecuteViaHost(const std::vector<std::string>& vecCommands, 
+                                        bool bStopOnError, 
+                                        DWORD dwTimeoutMs, 
+                                        std::vector<CommandResult>& vecResults, 
+                                        bool& bRequestSent) {
+    bRequestSent = false;
+    
+    // 1. 取得（或按需创建）宿主进程池
+    std::shared_ptr<PowerShellHostPool> pPool;
+    {
+        std::lock_guard<std::mutex> lock(g_mtxExecutor);
+        if (!g_bUseHost) {
+            return false;
+        }
+        if (!g_pHostPool) {
+            g_pHostPool = std::make_shared<PowerShellHostPool>(g_pBackend, g_nHostPoolSize);
+        }
+        pPool = g_pHostPool;
     }
     
-    // 10. 使用两个线程并行读取输出和错误（防止管道缓冲区满导致死锁）
-    std::string strRawOutput, strRawError;
+    // 2. 借用宿主（宿主无法启动时由调用者降级）
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    std::string strError;
+    auto objLease = pPool->Acquire(strError);
+    if (!objLease) {
+        return false;
+    }
+    uint64_t ui64SpawnUs = ExecutorTrace::NowUs() - ui64StartUs;
     
-    // 10.1 创建标准输出读取线程
-    std::thread objStdoutThread([&]() {
-        strRawOutput = ReadFromPipe(hStdoutRead);
-    });
+    // 3. 执行命令，失败或超时时丢弃该宿主
+    bool bOk = objLease->ExecuteBatch(vecCommands, bStopOnError, dwTimeoutMs, vecResults, bRequestSent);
+    if (!bOk) {
+        objLease.MarkBroken();
+    }
     
-    // 10.2 创建标准错误读取线程
-    std::thread objStderrThread([&]() {
-        strRawError = ReadFromPipe(hStderrRead);
-    });
+    // 4. 宿主一次返回整帧：启动耗时为借用宿主的时间，首字节耗时为收到响应的时间
+    uint64_t ui64ResponseUs = ExecutorTrace::NowUs() - ui64StartUs;
+    for (auto& stcResult : vecResults) {
+        stcResult.ui64SpawnUs = ui64SpawnUs;
+        stcResult.ui64FirstByteUs = stcResult.strOutput.empty() ? 0 : ui64ResponseUs;
+    }
+    return bOk;
+}
+
+/********************************************************************************
+* 函数实现：批次添加命令
+*********************************************************************************/
+PowerShellExecutor::Batch& PowerShellExecutor::Batch::Add(const std::string& strCommand) {
+    m_vecCommands.push_back(strCommand);
+    m_vecRules.push_back(CacheRule());
+    return *this;
+}
+
+/********************************************************************************
+* 函数实现：批次添加只读查询（带缓存）
+*********************************************************************************/
+PowerShellExecutor::Batch& PowerShellExecutor::Batch::AddCached(const std::string& strCommand, 
+                                                                const std::string& strScope, 
+                                                                DWORD dwTtlMs) {
+    m_vecCommands.push_back(strCommand);
+    CacheRule stcRule;
+    stcRule.bCacheable = true;
+    stcRule.strScope = strScope;
+    stcRule.dwTtlMs = dwTtlMs;
+    m_vecRules.push_back(std::move(stcRule));
+    return *this;
+}
+
+/********************************************************************************
+* 函数实现：批次设置失败即停止
+*********************************************************************************/
+PowerShellExecutor::Batch& PowerShellExecutor::Batch::StopOnError(bool bStop) {
+    m_bStopOnError = bStop;
+    return *this;
+}
+
+/********************************************************************************
+* 函数实现：批次设置截止时间
+*********************************************************************************/
+PowerShellExecutor::Batch& PowerShellExecutor::Batch::Timeout(DWORD dwTimeoutMs) {
+    m_dwTimeoutMs = dwTimeoutMs;
+    return *this;
+}
+
+/********************************************************************************
+* 函数实现：执行批次
+*********************************************************************************/
+bool PowerShellExecutor::Batch::Run(std::vector<CommandResult>& vecResults) const {
+    vecResults.clear();
+    vecResults.resize(m_vecCommands.size());
     
-    // 11. 等待进程结束（最多60秒超时）
-    WaitForSingleObject(stcPI.hProcess, 60000);
+    // 1. 只读查询先查缓存（批次中的修改性命令涉及同一作用域时不使用缓存）
+    std::vector<std::string> vecPending;
+    std::vector<size_t> vecPendingIndex;
+    std::vector<uint64_t> vecGenerations(m_vecCommands.size(), 0);
+    for (size_t i = 0; i < m_vecCommands.size(); i++) {
+        const CacheRule& stcRule = m_vecRules[i];
+        if (stcRule.bCacheable) {
+            vecGenerations[i] = QueryCache::Instance().Generation(stcRule.strScope);
+        }
+        std::shared_ptr<const CommandResult> pCached;
+        if (stcRule.bCacheable && !TouchesScope(stcRule.strScope) &&
+            QueryCache::Instance().Lookup("ps:" + QueryCache::NormalizeKey(m_vecCommands[i]), pCached)) {
+            vecResults[i] = *pCached;
+            continue;
+        }
+        vecPending.push_back(m_vecCommands[i]);
+        vecPendingIndex.push_back(i);
+    }
+    if (vecPending.empty()) {
+        return true;
+    }
     
-    // 12. 等待读取线程完成
-    if (objStdoutThread.joinable()) objStdoutThread.join();
-    if (objStderrThread.joinable()) objStderrThread.join();
+    // 2. 执行未命中的命令
+    std::vector<CommandResult> vecPendingResults;
+    bool bAllOk = RunCommands(vecPending, vecPendingResults);
     
-    // 13. 获取进程退出码
-    DWORD dwExitCode = 0;
-    GetExitCodeProcess(stcPI.hProcess, &dwExitCode);
+    // 3. 放回原位置；成功的只读查询写入缓存，修改性命令清除相关缓存
+    for (size_t i = 0; i < vecPending.size(); i++) {
+        size_t nIndex = vecPendingIndex[i];
+        const CacheRule& stcRule = m_vecRules[nIndex];
+        vecResults[nIndex] = std::move(vecPendingResults[i]);
+        if (!stcRule.bCacheable) {
+            QueryCache::Instance().InvalidateMatching(m_vecCommands[nIndex]);
+        } else if (vecResults[nIndex].nExitCode == 0 && !vecResults[nIndex].bTimedOut) {
+            QueryCache::Instance().Store("ps:" + QueryCache::NormalizeKey(m_vecCommands[nIndex]), stcRule.strScope,
+                                         std::make_shared<const CommandResult>(vecResults[nIndex]), stcRule.dwTtlMs,
+                                         vecGenerations[nIndex]);
+        }
+    }
+    return bAllOk;
+}
+
+/********************************************************************************
+* 函数实现：检查批次中的修改性命令是否涉及作用域
+*********************************************************************************/
+bool PowerShellExecutor::Batch::TouchesScope(const std::string& strScope) const {
+    for (size_t i = 0; i < m_vecCommands.size(); i++) {
+        if (m_vecRules[i].bCacheable) continue;
+        if (strScope == QueryCache::SCOPE_ALL_VMS ||
+            (!strScope.empty() && m_vecCommands[i].find("'" + strScope + "'") != std::string::npos)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：执行批次中的命令（不经过缓存）
+*********************************************************************************/
+bool PowerShellExecutor::Batch::RunCommands(const std::vector<std::string>& vecCommands, 
+                                            std::vector<CommandResult>& vecResults) const {
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    bool bAllOk = RunCommandsUntraced(vecCommands, vecResults);
     
-    // 14. 清理进程和管道句柄
-    CloseHandle(stcPI.hProcess);
-    CloseHandle(stcPI.hThread);
-    CloseHandle(hStdoutRead);
-    CloseHandle(hStderrRead);
+    // 整个批次保存一条记录：退出码取第一个失败的命令，字节数为所有命令之和
+    CommandResult stcSummary;
+    stcSummary.nExitCode = 0;
+    uint64_t ui64StdoutBytes = 0;
+    for (const auto& stcResult : vecResults) {
+        if (stcSummary.nExitCode == 0 && stcResult.nExitCode != 0) {
+            stcSummary.nExitCode = stcResult.nExitCode;
+        }
+        stcSummary.bTimedOut = stcSummary.bTimedOut || stcResult.bTimedOut;
+        stcSummary.strError += stcResult.strError;
+        ui64StdoutBytes += stcResult.strOutput.size();
+    }
+    if (!vecResults.empty()) {
+        stcSummary.ui64SpawnUs = vecResults[0].ui64SpawnUs;
+        stcSummary.ui64FirstByteUs = vecResults[0].ui64FirstByteUs;
+    }
+    std::string strCommand = vecCommands[0];
+    if (vecCommands.size() > 1) {
+        strCommand += " (+" + std::to_string(vecCommands.size() - 1) + ")";
+    }
+    TraceCommand("batch", strCommand, ExecutorTrace::CurrentLabel(), ui64StartUs, stcSummary, ui64StdoutBytes);
+    return bAllOk;
+}
+
+/********************************************************************************
+* 函数实现：执行批次中的命令（不记录）
+*********************************************************************************/
+bool PowerShellExecutor::Batch::RunCommandsUntraced(const std::vector<std::string>& vecCommands, 
+                                                    std::vector<CommandResult>& vecResults) const {
+    // 1. 回放模式：逐条取得录制的结果（与执行时一样遵守StopOnError）
+    std::shared_ptr<CommandRecorder> pRecorder = Transcript::Active();
+    if (pRecorder && pRecorder->IsReplaying()) {
+        vecResults.clear();
+        bool bFailed = false;
+        for (const auto& strCommand : vecCommands) {
+            CommandResult stcResult;
+            if (!(bFailed && m_bStopOnError)) {
+                bool bOk = ReplayCommand(*pRecorder, "run", strCommand, ExecutorTrace::CurrentLabel(), stcResult);
+                bFailed = bFailed || !bOk;
+            }
+            vecResults.push_back(std::move(stcResult));
+        }
+        return !bFailed;
+    }
     
-    // 15. 处理输出数据
-    // 15.1 移除BOM标记
-    RemoveBOM(strRawOutput);
-    RemoveBOM(strRawError);
+    // 2. 优先在常驻宿主中一次往返执行全部命令
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    bool bRequestSent = false;
+    bool bHostOk = ExecuteViaHost(vecCommands, m_bStopOnError, m_dwTimeoutMs, vecResults, bRequestSent);
     
-    // 15.2 修复可能的GBK乱码
-    strRawOutput = Utils::RepairString(strRawOutput);
-    strRawError = Utils::RepairString(strRawError);
+    if (!bHostOk && bRequestSent) {
+        // 2.1 宿主中途崩溃：已完成的命令保留结果，其余命令标记为失败且不重试
+        while (vecResults.size() < vecCommands.size()) {
+            CommandResult stcLost;
+            stcLost.strError = "PowerShell宿主进程意外退出";
+            vecResults.push_back(std::move(stcLost));
+        }
+    } else if (!bHostOk) {
+        // 2.2 宿主不可用：逐条独立执行，所有命令共享同一个截止时间
+        vecResults.clear();
+        ULONGLONG ui64Deadline = (m_dwTimeoutMs == INFINITE) ? 0 : GetTickCount64() + m_dwTimeoutMs;
+        bool bFailed = false;
+        for (const auto& strCommand : vecCommands) {
+            CommandResult stcResult;
+            if (!(bFailed && m_bStopOnError)) {
+                uint64_t ui64CommandStartUs = ExecutorTrace::NowUs();
+                bool bOk = ExecuteOneShot(strCommand, RemainingMs(ui64Deadline), stcResult);
+                if (pRecorder) {
+                    pRecorder->Record("run", strCommand, stcResult, ExecutorTrace::NowUs() - ui64CommandStartUs);
+                }
+                bFailed = bFailed || !bOk;
+            }
+            vecResults.push_back(std::move(stcResult));
+        }
+        return !bFailed;
+    }
     
-    // 15.3 修剪首尾空白
-    strOutput = Utils::Trim(strRawOutput);
-    strError = Utils::Trim(strRawError);
+    // 3. 整理输出并汇总执行结果
+    bool bAllOk = true;
+    for (auto& stcResult : vecResults) {
+        bool bOk = FinishResult(stcResult);
+        bAllOk = bAllOk && bOk;
+    }
     
-    // 16. 返回执行结果（退出码0表示成功）
-    return (dwExitCode == 0);
+    // 4. 录制模式下逐条录制（一次往返的耗时平均分给各条命令；StopOnError跳过的命令不录制）
+    if (pRecorder && !vecResults.empty()) {
+        uint64_t ui64EachUs = (ExecutorTrace::NowUs() - ui64StartUs) / vecResults.size();
+        bool bFailed = false;
+        for (size_t i = 0; i < vecResults.size() && i < vecCommands.size() && !(bFailed && m_bStopOnError); i++) {
+            pRecorder->Record("run", vecCommands[i], vecResults[i], ui64EachUs);
+            bFailed = bFailed || vecResults[i].nExitCode != 0 || vecResults[i].bTimedOut;
+        }
+    }
+    return bAllOk;
+}
+
+/********************************************************************************
+* 函数实现：设置进程后端
+*********************************************************************************/
+void PowerShellExecutor::SetProcessBackend(std::shared_ptr<ProcessBackend> pBackend) {
+    std::shared_ptr<PowerShellHostPool> pOldPool;
+    {
+        std::lock_guard<std::mutex> lock(g_mtxExecutor);
+        g_pBackend = std::move(pBackend);
+        pOldPool = std::move(g_pHostPool);
+    }
+    if (pOldPool) {
+        pOldPool->Shutdown();
+    }
 }
 
 /********************************************************************************
-* 函数实现：从管道读取数据
+* 函数实现：启用/禁用常驻宿主
 *********************************************************************************/
-std::string PowerShellExecutor::ReadFromPipe(HANDLE hPipe) {
-    // 1. 初始化结果字符串和缓冲区
-    std::string strResult;
-    char szBuffer[4096] = {0};
-    DWORD dwBytesRead = 0;
-    
-    // 2. 循环读取管道数据直到管道关闭
-    while (true) {
-        // 2.1 从管道读取数据
-        BOOL bSuccess = ReadFile(hPipe, szBuffer, sizeof(szBuffer) - 1, &dwBytesRead, nullptr);
-        
-        // 2.2 检查读取是否成功或已到达数据末尾
-        if (!bSuccess || dwBytesRead == 0) {
-            break;
+void PowerShellExecutor::EnablePersistentHost(bool bEnable, size_t nPoolSize) {
+    std::shared_ptr<PowerShellHostPool> pOldPool;
+    {
+        std::lock_guard<std::mutex> lock(g_mtxExecutor);
+        g_bUseHost = bEnable;
+        if (nPoolSize != g_nHostPoolSize || !bEnable) {
+            g_nHostPoolSize = nPoolSize;
+            pOldPool = std::move(g_pHostPool);
         }
-        
-        // 2.3 添加空终止符并追加到结果
-        szBuffer[dwBytesRead] = '\0';
-        strResult += szBuffer;
     }
-    
-    // 3. 返回原始数据（不在此处处理，由ExecuteCommand统一处理）
-    return strResult;
+    if (pOldPool) {
+        pOldPool->Shutdown();
+    }
+}
+
+/********************************************************************************
+* 函数实现：关闭执行器
+*********************************************************************************/
+void PowerShellExecutor::Shutdown() {
+    std::shared_ptr<PowerShellHostPool> pOldPool;
+    {
+        std::lock_guard<std::mutex> lock(g_mtxExecutor);
+        pOldPool = std::move(g_pHostPool);
+    }
+    if (pOldPool) {
+        pOldPool->Shutdown();
+    }
 }
@@ -11,12 +11,20 @@
 *    1. 执行PowerShell命令并获取标准输出
 *    2. 执行PowerShell命令并分别获取标准输出和错误输出
 *    3. 执行PowerShell脚本文件
+*    4. 批量执行多条命令（一次往返，逐条返回结果）
+*    5. 流式执行命令（输出逐行推送，适合长时间运行的复制脚本）
+*    6. 异步执行命令（返回std::future，支持取消，多条命令可同时进行）
 * 
 * 技术实现：
-*    - 使用CreateProcess创建PowerShell.exe进程
-*    - 通过匿名管道捕获标准输出和标准错误
+*    - 默认通过常驻PowerShell宿主进程池执行命令（见PowerShellHost），
+*      只在首次使用时支付powershell.exe的启动开销
+*    - 宿主不可用时降级为每条命令启动一个PowerShell.exe进程
+*    - 进程创建通过ProcessBackend接口完成，可在启动时替换
 *    - 自动处理UTF-8和GBK编码
-*    - 支持长时间运行的命令
+*    - 每次调用都有截止时间（默认DEFAULT_TIMEOUT_MS），超时后通过作业对象
+*      结束PowerShell及其创建的全部子进程，避免挂起的cmdlet冻结界面
+*    - 流式执行的默认截止时间更长（STREAMING_TIMEOUT_MS），适合复制驱动文件
+*    - 异步执行共享一个I/O完成循环线程，不为每条命令创建读取线程
 * 
 * 使用注意：
 *    - PowerShell命令需要在当前用户权限下可执行
@@ -33,7 +41,10 @@
 
 #pragma once
 #include <string>
-#include <windows.h>
+#include <vector>
+#include <memory>
+#include <future>
+#include "ProcessBackend.h"
 
 /********************************************************************************
 * 类名称：PowerShell命令执行器
@@ -41,11 +52,109 @@
 *********************************************************************************/
 class PowerShellExecutor {
 public:
+    // 普通命令的默认截止时间（毫秒）
+    static const DWORD DEFAULT_TIMEOUT_MS = 2 * 60 * 1000;
+    // 流式命令（长时间复制脚本）的默认截止时间（毫秒）
+    static const DWORD STREAMING_TIMEOUT_MS = 30 * 60 * 1000;
+
+    /********************************************************************************
+    * 类名称：命令批次
+    * 类功能：收集多条PowerShell命令，一次往返执行，并逐条返回退出码和输出
+    *
+    * 调用示例：
+    *    std::vector<CommandResult> vecResults;
+    *    bool bOk = PowerShellExecutor::Batch()
+    *        .Add("Set-VM -VMName 'vm1' -LowMemoryMappedIoSpace 1GB")
+    *        .Add("Set-VM -VMName 'vm1' -HighMemoryMappedIoSpace 32GB")
+    *        .StopOnError()
+    *        .Run(vecResults);
+    *
+    * 注意事项：
+    *    - 命令按添加顺序执行，各命令之间的变量互不影响
+    *    - StopOnError时，失败命令之后的命令不会执行，其退出码为-1
+    *    - 常驻宿主不可用时降级为逐条独立执行，结果格式不变
+    *    - 截止时间作用于整个批次；超时的命令bTimedOut为true
+    *********************************************************************************/
+    class Batch {
+    public:
+        /********************************************************************************
+        * 函数名称：添加命令
+        * 函数参数：
+        *    [IN]  const std::string& strCommand：PowerShell命令
+        * 返回类型：Batch&（支持链式调用）
+        *********************************************************************************/
+        Batch& Add(const std::string& strCommand);
+
+        /********************************************************************************
+        * 函数名称：添加只读查询
+        * 函数功能：添加一条可缓存的只读查询，命中缓存时不发送给PowerShell
+        * 函数参数：
+        *    [IN]  const std::string& strCommand：只读的PowerShell命令
+        *    [IN]  const std::string& strScope：缓存作用域（虚拟机名称或QueryCache::SCOPE_*）
+        *    [IN]  DWORD dwTtlMs：缓存有效期（毫秒）
+        * 返回类型：Batch&（支持链式调用）
+        * 注意事项：
+        *    - 批次中的修改性命令涉及同一作用域时，本批次不使用该作用域的缓存
+        *********************************************************************************/
+        Batch& AddCached(const std::string& strCommand, const std::string& strScope, DWORD dwTtlMs);
+
+        /********************************************************************************
+        * 函数名称：设置失败即停止
+        * 函数参数：
+        *    [IN]  bool bStop：true时某条命令失败后跳过其余命令（默认不跳过）
+        * 返回类型：Batch&（支持链式调用）
+        *********************************************************************************/
+        Batch& StopOnError(bool bStop = true);
+
+        /********************************************************************************
+        * 函数名称：设置截止时间
+        * 函数参数：
+        *    [IN]  DWORD dwTimeoutMs：整个批次的截止时间（毫秒，默认DEFAULT_TIMEOUT_MS）
+        * 返回类型：Batch&（支持链式调用）
+        *********************************************************************************/
+        Batch& Timeout(DWORD dwTimeoutMs);
+
+        /********************************************************************************
+        * 函数名称：获取命令数量
+        * 返回类型：size_t
+        *********************************************************************************/
+        size_t Size() const { return m_vecCommands.size(); }
+
+        /********************************************************************************
+        * 函数名称：执行批次
+        * 函数参数：
+        *    [OUT] std::vector<CommandResult>& vecResults：每条命令的结果（与添加顺序一致，
+        *          输出已做编码处理和首尾空白修剪）
+        * 返回类型：bool
+        *    全部命令退出码为0返回true，否则返回false
+        *********************************************************************************/
+        bool Run(std::vector<CommandResult>& vecResults) const;
+
+    private:
+        // 命令的缓存规则（Add添加的命令不缓存，执行后清除相关缓存）
+        struct CacheRule {
+            bool        bCacheable = false;   // 是否为可缓存的只读查询
+            std::string strScope;             // 缓存作用域
+            DWORD       dwTtlMs = 0;          // 缓存有效期（毫秒）
+        };
+
+        std::vector<std::string> m_vecCommands;          // 命令列表
+        std::vector<CacheRule>   m_vecRules;             // 与命令一一对应的缓存规则
+        bool                     m_bStopOnError = false; // 失败即停止
+        DWORD                    m_dwTimeoutMs = DEFAULT_TIMEOUT_MS; // 截止时间
+
+        bool TouchesScope(const std::string& strScope) const;
+        bool RunCommands(const std::vector<std::string>& vecCommands, std::vector<CommandResult>& vecResults) const;
+        bool RunCommandsUntraced(const std::vector<std::string>& vecCommands,
+                                 std::vector<CommandResult>& vecResults) const;
+    };
+
     /********************************************************************************
     * 函数名称：执行PowerShell命令
     * 函数功能：执行指定的PowerShell命令并返回标准输出
     * 函数参数：
     *    [IN]  const std::string& strCommand：要执行的PowerShell命令
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
     * 返回类型：std::string
     *    命令的标准输出内容，若执行失败返回空字符串
     * 调用示例：
@@ -54,7 +163,7 @@ public:
     *    - 此函数不捕获错误输出
     *    - 建议使用ExecuteWithCheck以获取更详细的错误信息
     *********************************************************************************/
-    static std::string Execute(const std::string& strCommand);
+    static std::string Execute(const std::string& strCommand, DWORD dwTimeoutMs = DEFAULT_TIMEOUT_MS);
     
     /********************************************************************************
     * 函数名称：执行PowerShell命令并检查
@@ -63,22 +172,66 @@ public:
     *    [IN]  const std::string& strCommand：要执行的PowerShell命令
     *    [OUT] std::string& strOutput：返回的标准输出内容
     *    [OUT] std::string& strError：返回的错误输出内容
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
     * 返回类型：bool
     *    执行成功：true
-    *    执行失败：false
+    *    执行失败（包括超时）：false
     * 调用示例：
     *    std::string strOutput, strError;
     *    if (!PowerShellExecutor::ExecuteWithCheck(cmd, strOutput, strError)) {
     *        std::cout << "错误: " << strError << std::endl;
     *    }
     *********************************************************************************/
-    static bool ExecuteWithCheck(const std::string& strCommand, std::string& strOutput, std::string& strError);
+    static bool ExecuteWithCheck(const std::string& strCommand, std::string& strOutput, std::string& strError,
+                                 DWORD dwTimeoutMs = DEFAULT_TIMEOUT_MS);
+
+    /********************************************************************************
+    * 函数名称：执行PowerShell命令并返回完整结果
+    * 函数功能：与ExecuteWithCheck相同，但返回退出码和超时标记，
+    *           调用者可以区分"命令失败"和"命令超时"
+    * 函数参数：
+    *    [IN]  const std::string& strCommand：要执行的PowerShell命令
+    *    [OUT] CommandResult& stcResult：退出码、输出和超时标记
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
+    * 返回类型：bool
+    *    退出码为0且未超时返回true
+    * 调用示例：
+    *    CommandResult stcResult;
+    *    if (!PowerShellExecutor::ExecuteWithResult(cmd, stcResult, 60000) && stcResult.bTimedOut) {
+    *        // 超时：进程树已被结束
+    *    }
+    *********************************************************************************/
+    static bool ExecuteWithResult(const std::string& strCommand, CommandResult& stcResult,
+                                  DWORD dwTimeoutMs = DEFAULT_TIMEOUT_MS);
+
+    /********************************************************************************
+    * 函数名称：执行只读查询（带缓存）
+    * 函数功能：与ExecuteWithResult相同，但在有效期内重复执行同一查询时直接返回
+    *           缓存的结果，不再启动PowerShell
+    * 函数参数：
+    *    [IN]  const std::string& strCommand：只读的PowerShell命令
+    *    [IN]  const std::string& strScope：缓存作用域（虚拟机名称或QueryCache::SCOPE_*）
+    *    [IN]  DWORD dwTtlMs：缓存有效期（毫秒）
+    *    [OUT] CommandResult& stcResult：退出码、输出和超时标记
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
+    * 返回类型：bool
+    *    退出码为0且未超时返回true
+    * 调用示例：
+    *    CommandResult stcResult;
+    *    PowerShellExecutor::ExecuteCached("(Get-VM -Name 'vm1').State.ToString()", "vm1", 10000, stcResult);
+    * 注意事项：
+    *    - 只缓存成功的结果；失败和超时每次都会重新执行
+    *    - 其他执行函数执行的命令视为修改性命令，执行后按命令文本清除相关缓存
+    *********************************************************************************/
+    static bool ExecuteCached(const std::string& strCommand, const std::string& strScope, DWORD dwTtlMs,
+                              CommandResult& stcResult, DWORD dwTimeoutMs = DEFAULT_TIMEOUT_MS);
     
     /********************************************************************************
     * 函数名称：执行PowerShell脚本文件
     * 函数功能：执行指定路径的PowerShell脚本文件(.ps1)
     * 函数参数：
     *    [IN]  const std::string& strScriptPath：脚本文件的完整路径
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
     * 返回类型：std::string
     *    脚本的输出内容
     * 调用示例：
@@ -87,28 +240,140 @@ public:
     *    - 需要确保PowerShell执行策略允许运行脚本
     *    - 脚本路径中如有空格需要正确处理
     *********************************************************************************/
-    static std::string ExecuteScript(const std::string& strScriptPath);
+    static std::string ExecuteScript(const std::string& strScriptPath, DWORD dwTimeoutMs = DEFAULT_TIMEOUT_MS);
+
+    /********************************************************************************
+    * 函数名称：流式执行PowerShell命令
+    * 函数功能：执行PowerShell命令，标准输出每形成一行就立即推送给回调
+    * 函数参数：
+    *    [IN]  const std::string& strCommand：要执行的PowerShell命令
+    *    [IN]  const LineSink& fnSink：行输出回调（不含行尾的\r\n，已修复编码）
+    *    [OUT] std::string& strError：返回的错误输出内容
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
+    * 返回类型：bool
+    *    执行成功（退出码为0）：true
+    *    执行失败：false
+    * 调用示例：
+    *    PowerShellExecutor::ExecuteStreaming(cmd, [&](std::string_view svLine) {
+    *        callback(std::string(svLine) + "\n");
+    *    }, strError);
+    * 注意事项：
+    *    - 回调在调用线程上执行，可以直接更新界面
+    *    - 视图只在回调期间有效；执行器不保留完整输出，内存占用有上限
+    *    - 始终使用独立进程执行（宿主只能在命令结束后返回输出）
+    *********************************************************************************/
+    static bool ExecuteStreaming(const std::string& strCommand, const LineSink& fnSink, std::string& strError,
+                                 DWORD dwTimeoutMs = STREAMING_TIMEOUT_MS);
+
+    /********************************************************************************
+    * 函数名称：异步执行PowerShell命令
+    * 函数功能：启动PowerShell进程后立即返回，结果通过future取得
+    * 函数参数：
+    *    [IN]  const std::string& strCommand：要执行的PowerShell命令
+    *    [IN]  const CancellationToken& objCancel：取消令牌（取消后结束进程树）
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
+    * 返回类型：std::future<CommandResult>
+    *    命令结果（输出已做编码处理和首尾空白修剪，超时/取消时带有错误提示）
+    * 调用示例：
+    *    auto futVMs = PowerShellExecutor::ExecuteAsync("Get-VM | ConvertTo-Json");
+    *    auto futGPUs = PowerShellExecutor::ExecuteAsync("Get-VMHostPartitionableGpu");
+    *    CommandResult stcVMs = futVMs.get();    // 两条命令同时执行
+    * 注意事项：
+    *    - 始终使用独立进程执行（常驻宿主是同步的，数量有限）
+    *    - 所有进行中的命令由一个I/O完成循环线程处理，不会为每条命令创建线程
+    *********************************************************************************/
+    static std::future<CommandResult> ExecuteAsync(const std::string& strCommand,
+                                                   const CancellationToken& objCancel = CancellationToken(),
+                                                   DWORD dwTimeoutMs = DEFAULT_TIMEOUT_MS);
+    
+    /********************************************************************************
+    * 函数名称：设置进程后端
+    * 函数功能：替换用于创建PowerShell进程的后端，同时重建宿主进程池
+    * 函数参数：
+    *    [IN]  std::shared_ptr<ProcessBackend> pBackend：新的进程后端
+    * 注意事项：
+    *    - 应在执行任何命令之前调用（通常在程序启动时）
+    *********************************************************************************/
+    static void SetProcessBackend(std::shared_ptr<ProcessBackend> pBackend);
+
+    /********************************************************************************
+    * 函数名称：启用/禁用常驻宿主
+    * 函数功能：控制ExecuteWithCheck是否通过常驻宿主进程池执行命令
+    * 函数参数：
+    *    [IN]  bool bEnable：true启用（默认），false每条命令独立启动进程
+    *    [IN]  size_t nPoolSize：宿主进程数上限（默认2）
+    *********************************************************************************/
+    static void EnablePersistentHost(bool bEnable, size_t nPoolSize = 2);
+
+    /********************************************************************************
+    * 函数名称：关闭执行器
+    * 函数功能：停止所有常驻宿主进程
+    * 注意事项：
+    *    - 程序退出前调用；之后再执行命令会按需重新启动宿主
+    *********************************************************************************/
+    static void Shutdown();
     
 private:
     /********************************************************************************
-    * 函数名称：创建管道并执行命令（内部辅助）
-    * 函数功能：创建匿名管道，启动进程并捕获输出
+    * 函数名称：执行命令（内部辅助，不经过缓存）
+    * 函数功能：优先使用常驻宿主执行，宿主不可用时以独立进程执行
     * 函数参数：
-    *    [IN]  const std::string& strCmdLine：完整的命令行字符串
-    *    [OUT] std::string& strOutput：捕获的标准输出
-    *    [OUT] std::string& strError：捕获的错误输出
+    *    [IN]  const std::string& strCommand：PowerShell命令
+    *    [OUT] CommandResult& stcResult：整理后的命令结果
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
     * 返回类型：bool
-    *    成功返回true，失败返回false
+    *    退出码为0且未超时返回true，否则返回false
     *********************************************************************************/
-    static bool ExecuteCommand(const std::string& strCmdLine, std::string& strOutput, std::string& strError);
-    
+    static bool ExecuteUncached(const std::string& strCommand, CommandResult& stcResult, DWORD dwTimeoutMs);
+
+    /********************************************************************************
+    * 函数名称：以独立进程执行命令（内部辅助）
+    * 函数功能：转义命令并启动一个新的PowerShell.exe进程执行
+    * 函数参数：
+    *    [IN]  const std::string& strCommand：PowerShell命令
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
+    *    [OUT] CommandResult& stcResult：整理后的命令结果
+    * 返回类型：bool
+    *    退出码为0且未超时返回true，否则返回false
+    *********************************************************************************/
+    static bool ExecuteOneShot(const std::string& strCommand, DWORD dwTimeoutMs, CommandResult& stcResult);
+
     /********************************************************************************
-    * 函数名称：从管道读取数据（内部辅助）
-    * 函数功能：从指定管道句柄读取所有可用数据
+    * 函数名称：构造PowerShell命令行（内部辅助）
+    * 函数功能：设置UTF-8输出编码，转义命令并拼接powershell.exe命令行
     * 函数参数：
-    *    [IN]  HANDLE hPipe：管道句柄
+    *    [IN]  const std::string& strCommand：PowerShell命令
     * 返回类型：std::string
-    *    读取到的数据
+    *    可直接传给CreateProcess的命令行
+    *********************************************************************************/
+    static std::string BuildCommandLine(const std::string& strCommand);
+
+    /********************************************************************************
+    * 函数名称：创建进程并执行命令（内部辅助）
+    * 函数功能：通过进程后端启动进程，捕获输出并做编码处理
+    * 函数参数：
+    *    [IN]  const std::string& strCmdLine：完整的命令行字符串
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
+    *    [OUT] CommandResult& stcResult：整理后的命令结果
+    * 返回类型：bool
+    *    成功返回true，失败或超时返回false
+    *********************************************************************************/
+    static bool ExecuteCommand(const std::string& strCmdLine, DWORD dwTimeoutMs, CommandResult& stcResult);
+
+    /********************************************************************************
+    * 函数名称：通过常驻宿主执行命令（内部辅助）
+    * 函数功能：从宿主进程池借用宿主，在一次请求中执行一条或多条命令
+    * 函数参数：
+    *    [IN]  const std::vector<std::string>& vecCommands：PowerShell命令列表
+    *    [IN]  bool bStopOnError：某条命令失败后是否跳过其余命令
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
+    *    [OUT] std::vector<CommandResult>& vecResults：每条命令的原始结果
+    *    [OUT] bool& bRequestSent：命令是否已发送给宿主
+    * 返回类型：bool
+    *    收到宿主全部响应返回true；宿主不可用或中途崩溃返回false
+    * 注意事项：
+    *    - 返回false且bRequestSent为false时可以安全地降级为独立进程执行
     *********************************************************************************/
-    static std::string ReadFromPipe(HANDLE hPipe);
+    static bool ExecuteViaHost(const std::vector<std::string>& vecCommands, bool bStopOnError, DWORD dwTimeoutMs,
+                               std::vector<CommandResult>& vecResults, bool& bRequestSent);
 };
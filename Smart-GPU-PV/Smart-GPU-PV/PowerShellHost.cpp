@@ -0,0 +1,446 @@
+﻿/********************************************************************************
+* 文件名称：PowerShellHost.cpp
+* 文件功能：实现常驻PowerShell宿主进程和宿主进程池
+*
+* 实现说明：
+*    宿主进程以-EncodedCommand方式运行一段引导脚本。引导脚本创建一个
+*    Runspace，然后循环读取stdin中的请求行，执行命令并将结果编码为
+*    响应帧写回stdout。C++侧按行读取stdout，忽略非帧行，直到读到序号
+*    匹配的响应帧。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "PowerShellHost.h"
+#include "ScriptRegistry.h"
+#include "Utils.h"
+#include <cstring>
+#include <stdexcept>
+
+// 帧标记
+static const char* const HOST_READY_MARKER = "##SGP-READY##";
+static const char* const HOST_FRAME_MARKER = "##SGP-FRAME## ";
+
+// 宿主引导脚本（仅包含ASCII字符，以UTF-16LE + Base64形式通过-EncodedCommand传入）
+// 退出码与powershell -Command相同：非终止错误只写入错误输出，最后一条语句失败（$?为假）
+// 或出现终止错误时才为1，否则同一脚本会因宿主是否启动成功而得到不同的退出码
+static const char* const HOST_BOOTSTRAP_SCRIPT = R"PS(
+$enc = New-Object System.Text.UTF8Encoding $false
+$rs = [runspacefactory]::CreateRunspace()
+$rs.Open()
+$in = [Console]::In
+$out = [Console]::Out
+$out.WriteLine('##SGP-READY##')
+$out.Flush()
+while ($true) {
+    $line = $in.ReadLine()
+    if ($line -eq $null) { break }
+    $parts = $line.Split(' ')
+    if ($parts.Count -lt 3) { continue }
+    $seq = $parts[0]
+    $stop = ($parts[1] -eq '1')
+    $failed = $false
+    foreach ($b64 in $parts[2].Split(',')) {
+        $code = 0; $o = ''; $e = ''
+        if ($failed -and $stop) {
+            $code = -1
+        } else {
+            $ps = [PowerShell]::Create()
+            $ps.Runspace = $rs
+            try {
+                $cmd = $enc.GetString([Convert]::FromBase64String($b64))
+                $rs.SessionStateProxy.SetVariable('LASTEXITCODE', 0)
+                $rs.SessionStateProxy.SetVariable('__sgpOk', $true)
+                [void]$ps.AddScript($cmd + "`n" + '$global:__sgpOk = $?', $true).AddCommand('Out-String').AddParameter('Width', 4096)
+                $o = -join $ps.Invoke()
+                if ($ps.Streams.Error.Count -gt 0) {
+                    $e = ($ps.Streams.Error | Out-String -Width 4096)
+                }
+                if (-not $rs.SessionStateProxy.GetVariable('__sgpOk')) { $code = 1 }
+                $last = $rs.SessionStateProxy.GetVariable('LASTEXITCODE')
+                if ($last -is [int] -and $last -ne 0) { $code = $last }
+            } catch {
+                $ex = $_.Exception
+                while ($ex.InnerException -and $ex -is [System.Management.Automation.MethodInvocationException]) { $ex = $ex.InnerException }
+                if ($ex -is [System.Management.Automation.ExitException]) {
+                    $code = [int]$ex.Argument
+                } else {
+                    $e += $ex.Message
+                    $code = 1
+                }
+            } finally {
+                $ps.Dispose()
+            }
+            if ($code -ne 0) { $failed = $true }
+        }
+        $out.WriteLine('##SGP-FRAME## ' + $seq + ' ' + $code + ' ' +
+            [Convert]::ToBase64String($enc.GetBytes([string]$o)) + ' ' +
+            [Convert]::ToBase64String($enc.GetBytes([string]$e)))
+        $out.Flush()
+    }
+}
+)PS";
+
+/********************************************************************************
+* 函数实现：构造函数
+*********************************************************************************/
+PowerShellHost::PowerShellHost(std::shared_ptr<ProcessBackend> pBackend)
+    : m_pBackend(std::move(pBackend)), m_ui64Seq(0), m_bBroken(false) {
+}
+
+/********************************************************************************
+* 函数实现：构造宿主启动命令行
+*********************************************************************************/
+std::string PowerShellHost::BuildHostCommandLine() {
+    // 1. -EncodedCommand要求UTF-16LE编码，引导脚本为纯ASCII，逐字节扩展即可
+    std::string strUtf16;
+    for (const char* p = HOST_BOOTSTRAP_SCRIPT; *p; ++p) {
+        strUtf16 += *p;
+        strUtf16 += '\0';
+    }
+
+    // 2. 拼接完整命令行
+    return "powershell.exe -NoProfile -NonInteractive -ExecutionPolicy Bypass -EncodedCommand " +
+           Utils::Base64Encode(strUtf16);
+}
+
+/********************************************************************************
+* 函数实现：启动宿主进程
+*********************************************************************************/
+bool PowerShellHost::Start(std::string& strError) {
+    // 1. 启动子进程
+    m_pProcess = m_pBackend->Spawn(BuildHostCommandLine(), strError);
+    if (!m_pProcess) {
+        m_bBroken = true;
+        return false;
+    }
+
+    // 2. 等待就绪标记（忽略之前的任何输出），启动卡住时由截止时间结束进程
+    m_pProcess->SetDeadline(HOST_START_TIMEOUT_MS);
+    std::string strLine;
+    while (m_pProcess->ReadOutputLine(strLine)) {
+        if (strLine.find(HOST_READY_MARKER) != std::string::npos) {
+            m_pProcess->SetDeadline(INFINITE);
+            m_bBroken = false;
+            return LoadScriptFunctions(strError);
+        }
+    }
+
+    // 3. 进程在就绪前退出
+    strError = m_pProcess->DeadlineExpired() ? "PowerShell宿主进程启动超时" : "PowerShell宿主进程启动失败";
+    m_pProcess->Terminate();
+    m_pProcess.reset();
+    m_bBroken = true;
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：加载脚本函数（内部辅助）
+*********************************************************************************/
+bool PowerShellHost::LoadScriptFunctions(std::string& strError) {
+    // 注册表中的函数在会话中只定义一次，之后的命令按名称调用
+    std::string strScript = ScriptRegistry::Instance().BuildSessionScript();
+    if (strScript.empty()) {
+        return true;
+    }
+
+    std::vector<CommandResult> vecResults;
+    bool bRequestSent = false;
+    if (!ExecuteBatch({ strScript }, false, HOST_START_TIMEOUT_MS, vecResults, bRequestSent) ||
+        vecResults.empty() || vecResults[0].nExitCode != 0) {
+        strError = "PowerShell宿主进程加载脚本函数失败";
+        if (!vecResults.empty() && !vecResults[0].strError.empty()) {
+            strError += ": " + vecResults[0].strError;
+        }
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：执行命令
+*********************************************************************************/
+bool PowerShellHost::Execute(const std::string& strCommand, DWORD dwTimeoutMs, 
+                             CommandResult& stcResult, bool& bRequestSent) {
+    std::vector<CommandResult> vecResults;
+    bool bResult = ExecuteBatch({ strCommand }, false, dwTimeoutMs, vecResults, bRequestSent);
+    if (!vecResults.empty()) {
+        stcResult = std::move(vecResults[0]);
+    }
+    return bResult;
+}
+
+/********************************************************************************
+* 函数实现：批量执行命令
+*********************************************************************************/
+bool PowerShellHost::ExecuteBatch(const std::vector<std::string>& vecCommands, 
+                                  bool bStopOnError, 
+                                  DWORD dwTimeoutMs, 
+                                  std::vector<CommandResult>& vecResults, 
+                                  bool& bRequestSent) {
+    bRequestSent = false;
+    vecResults.clear();
+    if (!IsHealthy()) {
+        return false;
+    }
+
+    // 1. 构造请求行：<序号> <模式> <Base64命令1>,<Base64命令2>,...
+    uint64_t ui64Seq = ++m_ui64Seq;
+    std::string strRequest = std::to_string(ui64Seq) + (bStopOnError ? " 1 " : " 0 ");
+    for (size_t i = 0; i < vecCommands.size(); i++) {
+        if (i > 0) {
+            strRequest += ',';
+        }
+        strRequest += Utils::Base64Encode(vecCommands[i]);
+    }
+    strRequest += '\n';
+
+    // 2. 设置截止时间后再发送请求行：宿主卡住不读stdin时管道写满、写入阻塞，
+    //    截止时间到达后宿主进程树被结束，写入随之失败
+    m_pProcess->SetDeadline(dwTimeoutMs);
+    if (!m_pProcess->WriteInput(strRequest)) {
+        m_pProcess->SetDeadline(INFINITE);
+        m_bBroken = true;
+        if (m_pProcess->DeadlineExpired()) {
+            // 请求可能已部分写入，按已发送处理（不再降级重试），全部命令标记为超时
+            bRequestSent = true;
+            FillTimedOut(vecResults, vecCommands.size());
+        }
+        return false;
+    }
+    bRequestSent = true;
+
+    // 3. 按顺序读取每条命令的响应帧（宿主对每条命令都输出一帧）
+    //    超过截止时间时宿主进程树被结束，ReadOutputLine随之返回false
+    std::string strLine;
+    while (vecResults.size() < vecCommands.size() && m_pProcess->ReadOutputLine(strLine)) {
+        CommandResult stcResult;
+        if (ParseFrame(strLine, ui64Seq, stcResult)) {
+            vecResults.push_back(std::move(stcResult));
+        }
+    }
+    m_pProcess->SetDeadline(INFINITE);
+    if (vecResults.size() == vecCommands.size()) {
+        return true;
+    }
+
+    // 4. 管道断开：宿主进程已崩溃或因超时被结束（已收到的结果保留在vecResults中）
+    m_bBroken = true;
+    if (m_pProcess->DeadlineExpired()) {
+        FillTimedOut(vecResults, vecCommands.size());
+    }
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：将未完成的命令标记为超时
+*********************************************************************************/
+void PowerShellHost::FillTimedOut(std::vector<CommandResult>& vecResults, size_t nCommands) {
+    while (vecResults.size() < nCommands) {
+        CommandResult stcTimeout;
+        stcTimeout.nExitCode = static_cast<int>(ERROR_TIMEOUT);
+        stcTimeout.bTimedOut = true;
+        vecResults.push_back(std::move(stcTimeout));
+    }
+}
+
+/********************************************************************************
+* 函数实现：检查宿主是否可用
+*********************************************************************************/
+bool PowerShellHost::IsHealthy() {
+    return !m_bBroken && m_pProcess && m_pProcess->IsAlive();
+}
+
+/********************************************************************************
+* 函数实现：停止宿主进程
+*********************************************************************************/
+void PowerShellHost::Stop() {
+    if (m_pProcess) {
+        m_pProcess->Terminate();
+        m_pProcess.reset();
+    }
+    m_bBroken = true;
+}
+
+/********************************************************************************
+* 函数实现：解析响应帧
+*********************************************************************************/
+bool PowerShellHost::ParseFrame(const std::string& strLine, uint64_t ui64Seq, CommandResult& stcResult) {
+    // 1. 检查帧标记
+    size_t nMarkerLen = strlen(HOST_FRAME_MARKER);
+    if (strLine.compare(0, nMarkerLen, HOST_FRAME_MARKER) != 0) {
+        return false;
+    }
+
+    // 2. 拆分字段：序号、退出码、输出、错误
+    //    字段之间恰好一个空格；输出为空时Base64字段为空串（两个空格相连），
+    //    不能按空白跳过，否则错误输出会被当作标准输出
+    std::vector<std::string> vecFields = Utils::Split(strLine.substr(nMarkerLen), ' ');
+    if (vecFields.size() < 2 || vecFields[0].empty() || vecFields[1].empty()) {
+        return false;
+    }
+    uint64_t ui64FrameSeq = 0;
+    int nExitCode = 0;
+    try {
+        size_t nParsed = 0;
+        ui64FrameSeq = std::stoull(vecFields[0], &nParsed);
+        if (nParsed != vecFields[0].size()) {
+            return false;
+        }
+        nExitCode = std::stoi(vecFields[1], &nParsed);
+        if (nParsed != vecFields[1].size()) {
+            return false;
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    // 3. 丢弃过期帧（例如上一条命令超时后迟到的响应）
+    if (ui64FrameSeq != ui64Seq) {
+        return false;
+    }
+
+    // 4. 解码输出
+    stcResult.nExitCode = nExitCode;
+    stcResult.strOutput.clear();
+    stcResult.strError.clear();
+    if (vecFields.size() > 2) {
+        Utils::Base64Decode(vecFields[2], stcResult.strOutput);
+    }
+    if (vecFields.size() > 3) {
+        Utils::Base64Decode(vecFields[3], stcResult.strError);
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：租约移动赋值
+*********************************************************************************/
+PowerShellHostPool::Lease& PowerShellHostPool::Lease::operator=(Lease&& objOther) noexcept {
+    if (this != &objOther) {
+        if (m_pPool && m_pHost) {
+            m_pPool->Release(std::move(m_pHost), m_bBroken);
+        }
+        m_pPool = objOther.m_pPool;
+        m_pHost = std::move(objOther.m_pHost);
+        m_bBroken = objOther.m_bBroken;
+        objOther.m_pPool = nullptr;
+    }
+    return *this;
+}
+
+/********************************************************************************
+* 函数实现：租约析构（归还宿主）
+*********************************************************************************/
+PowerShellHostPool::Lease::~Lease() {
+    if (m_pPool && m_pHost) {
+        m_pPool->Release(std::move(m_pHost), m_bBroken);
+    }
+}
+
+/********************************************************************************
+* 函数实现：标记损坏
+*********************************************************************************/
+void PowerShellHostPool::Lease::MarkBroken() {
+    m_bBroken = true;
+}
+
+/********************************************************************************
+* 函数实现：进程池构造函数
+*********************************************************************************/
+PowerShellHostPool::PowerShellHostPool(std::shared_ptr<ProcessBackend> pBackend, size_t nMaxHosts)
+    : m_pBackend(std::move(pBackend)),
+      m_nMaxHosts(nMaxHosts == 0 ? 1 : nMaxHosts),
+      m_nLiveHosts(0),
+      m_nRespawns(0),
+      m_nStartFailures(0) {
+}
+
+/********************************************************************************
+* 函数实现：进程池析构函数
+*********************************************************************************/
+PowerShellHostPool::~PowerShellHostPool() {
+    Shutdown();
+}
+
+/********************************************************************************
+* 函数实现：借用宿主
+*********************************************************************************/
+PowerShellHostPool::Lease PowerShellHostPool::Acquire(std::string& strError) {
+    std::unique_lock<std::mutex> lock(m_mtx);
+
+    while (true) {
+        // 1. 优先复用空闲宿主，顺便丢弃已崩溃的宿主
+        while (!m_vecIdle.empty()) {
+            std::unique_ptr<PowerShellHost> pHost = std::move(m_vecIdle.back());
+            m_vecIdle.pop_back();
+            if (pHost->IsHealthy()) {
+                return Lease(this, std::move(pHost));
+            }
+            pHost->Stop();
+            m_nLiveHosts--;
+            m_nRespawns++;
+        }
+
+        // 2. 宿主多次启动失败：不再尝试（每次尝试可能等待HOST_START_TIMEOUT_MS），由调用者降级
+        if (m_nStartFailures >= MAX_START_FAILURES) {
+            strError = "PowerShell宿主进程连续" + std::to_string(m_nStartFailures) + "次启动失败，已停用";
+            return Lease();
+        }
+
+        // 3. 未达上限：启动新的宿主（启动过程较慢，在锁外进行）
+        if (m_nLiveHosts < m_nMaxHosts) {
+            m_nLiveHosts++;
+            lock.unlock();
+
+            auto pHost = std::make_unique<PowerShellHost>(m_pBackend);
+            bool bStarted = pHost->Start(strError);
+
+            lock.lock();
+            if (bStarted) {
+                m_nStartFailures = 0;
+                return Lease(this, std::move(pHost));
+            }
+            m_nLiveHosts--;
+            m_nStartFailures++;
+            m_cvAvailable.notify_all();
+            return Lease();
+        }
+
+        // 4. 已达上限：等待其他调用者归还
+        m_cvAvailable.wait(lock);
+    }
+}
+
+/********************************************************************************
+* 函数实现：归还宿主
+*********************************************************************************/
+void PowerShellHostPool::Release(std::unique_ptr<PowerShellHost> pHost, bool bBroken) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    if (bBroken || !pHost->IsHealthy()) {
+        // 丢弃损坏的宿主，下次借用时会重新启动
+        pHost->Stop();
+        m_nLiveHosts--;
+        m_nRespawns++;
+    } else {
+        m_vecIdle.push_back(std::move(pHost));
+    }
+    m_cvAvailable.notify_one();
+}
+
+/********************************************************************************
+* 函数实现：关闭进程池
+*********************************************************************************/
+void PowerShellHostPool::Shutdown() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (auto& pHost : m_vecIdle) {
+        pHost->Stop();
+        m_nLiveHosts--;
+    }
+    m_vecIdle.clear();
+    m_nStartFailures = 0;
+}
@@ -0,0 +1,264 @@
+﻿/********************************************************************************
+* 文件名称：PowerShellHost.h
+* 文件功能：提供常驻PowerShell宿主进程及其进程池
+*
+* 类说明：
+*    每次启动powershell.exe都要付出数百毫秒的解释器启动开销，一次GPU-PV
+*    配置会执行十几条命令。PowerShellHost启动一个长期运行的powershell.exe，
+*    通过stdin逐条接收命令、通过stdout以帧的形式返回结果，从而只支付一次
+*    启动开销。PowerShellHostPool管理少量宿主进程，负责崩溃检测和自动重建。
+*
+* 帧协议：
+*    请求（C++ -> 宿主，单行，可包含多条命令）：
+*        <序号> <模式> <Base64(UTF-8命令1)>,<Base64(UTF-8命令2)>,...\n
+*        模式为1时，某条命令失败后跳过其余命令（跳过的命令退出码为-1）
+*    响应（宿主 -> C++，每条命令一行，按请求中的顺序）：
+*        ##SGP-FRAME## <序号> <退出码> <Base64(UTF-8标准输出)> <Base64(UTF-8错误输出)>\n
+*    宿主启动完成后输出一行 ##SGP-READY##。输出内容经过Base64编码，
+*    因此命令输出中的任何文本都不会与帧标记冲突；非帧行会被忽略。
+*
+* 执行语义：
+*    - 宿主在独立的Runspace中以局部作用域执行每条命令，命令之间的变量和
+*      $ErrorActionPreference互不影响，但已加载的模块（如Hyper-V）可复用
+*    - 启动时加载ScriptRegistry中注册的全部脚本函数（全局作用域），之后的
+*      命令可以直接按名称调用
+*    - 退出码与独立进程（powershell -Command）一致：脚本执行exit N时为N；
+*      出现终止错误或最后一条语句失败（$?为假）时为1；否则为0。非终止错误
+*      （如Write-Error）只作为错误输出返回，不改变退出码
+*    - 超时：截止时间从写入请求之前开始计算，请求超过截止时间仍未完成
+*      （包括宿主不读stdin导致写入阻塞）时结束宿主进程树，未完成的命令
+*      标记为超时（bTimedOut），宿主由进程池丢弃并在下次使用时重建
+*
+* 依赖项：
+*    - ProcessBackend（子进程创建）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "ProcessBackend.h"
+
+/********************************************************************************
+* 类名称：PowerShell宿主进程
+* 类功能：封装一个常驻powershell.exe进程和帧协议的收发
+*********************************************************************************/
+class PowerShellHost {
+public:
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  std::shared_ptr<ProcessBackend> pBackend：用于启动宿主进程的后端
+    *********************************************************************************/
+    explicit PowerShellHost(std::shared_ptr<ProcessBackend> pBackend);
+
+    /********************************************************************************
+    * 函数名称：启动宿主进程
+    * 函数功能：启动powershell.exe并等待其输出就绪标记（最多HOST_START_TIMEOUT_MS）
+    * 函数参数：
+    *    [OUT] std::string& strError：失败时的错误信息
+    * 返回类型：bool
+    *    启动成功返回true，失败返回false
+    * 注意事项：
+    *    - 就绪后加载注册的脚本函数，加载失败时结束宿主进程并返回false
+    *********************************************************************************/
+    bool Start(std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：执行命令
+    * 函数功能：将命令发送给宿主进程并等待对应的响应帧
+    * 函数参数：
+    *    [IN]  const std::string& strCommand：PowerShell命令文本
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
+    *    [OUT] CommandResult& stcResult：命令的退出码和输出
+    *    [OUT] bool& bRequestSent：请求是否已写入宿主（用于判断能否安全重试）
+    * 返回类型：bool
+    *    收到响应帧返回true；宿主进程崩溃或协议错误返回false
+    * 注意事项：
+    *    - 返回false后宿主进入损坏状态，应由进程池丢弃并重建
+    *********************************************************************************/
+    bool Execute(const std::string& strCommand, DWORD dwTimeoutMs, CommandResult& stcResult, bool& bRequestSent);
+
+    /********************************************************************************
+    * 函数名称：批量执行命令
+    * 函数功能：在一次请求中发送多条命令，按顺序取回每条命令的结果
+    * 函数参数：
+    *    [IN]  const std::vector<std::string>& vecCommands：PowerShell命令列表
+    *    [IN]  bool bStopOnError：某条命令失败后是否跳过其余命令
+    *    [IN]  DWORD dwTimeoutMs：整个请求的截止时间（毫秒）
+    *    [OUT] std::vector<CommandResult>& vecResults：每条命令的结果（与命令一一对应）
+    *    [OUT] bool& bRequestSent：请求是否已写入宿主（写入因截止时间到达而失败时也为true）
+    * 返回类型：bool
+    *    收到全部响应帧返回true；宿主崩溃或超时返回false（已收到的结果保留，
+    *    超时时未完成的命令也会填入vecResults并标记bTimedOut）
+    *********************************************************************************/
+    bool ExecuteBatch(const std::vector<std::string>& vecCommands, bool bStopOnError, DWORD dwTimeoutMs,
+                      std::vector<CommandResult>& vecResults, bool& bRequestSent);
+
+    /********************************************************************************
+    * 函数名称：检查宿主是否可用
+    * 返回类型：bool
+    *    进程存活且协议状态正常返回true
+    *********************************************************************************/
+    bool IsHealthy();
+
+    /********************************************************************************
+    * 函数名称：停止宿主进程
+    *********************************************************************************/
+    void Stop();
+
+    /********************************************************************************
+    * 函数名称：构造宿主启动命令行
+    * 函数功能：生成带有-EncodedCommand引导脚本的powershell.exe命令行
+    * 返回类型：std::string
+    *********************************************************************************/
+    static std::string BuildHostCommandLine();
+
+    // 等待宿主就绪的最长时间（毫秒）
+    static const DWORD HOST_START_TIMEOUT_MS = 30000;
+
+private:
+    std::shared_ptr<ProcessBackend> m_pBackend;   // 进程后端
+    std::unique_ptr<ChildProcess>   m_pProcess;   // 宿主子进程
+    uint64_t                        m_ui64Seq;    // 请求序号
+    bool                            m_bBroken;    // 协议是否已损坏
+
+    /********************************************************************************
+    * 函数名称：解析响应帧（内部辅助）
+    * 函数功能：解析一行响应，序号匹配时填充结果
+    * 返回类型：bool
+    *    是有效且序号匹配的帧返回true
+    *********************************************************************************/
+    static bool ParseFrame(const std::string& strLine, uint64_t ui64Seq, CommandResult& stcResult);
+
+    /********************************************************************************
+    * 函数名称：将未完成的命令标记为超时（内部辅助）
+    * 函数功能：为尚无结果的命令补充bTimedOut、退出码为ERROR_TIMEOUT的结果
+    *********************************************************************************/
+    static void FillTimedOut(std::vector<CommandResult>& vecResults, size_t nCommands);
+
+    /********************************************************************************
+    * 函数名称：加载脚本函数（内部辅助）
+    * 函数功能：在宿主会话中定义ScriptRegistry中注册的全部函数
+    * 返回类型：bool
+    *    加载成功（或没有注册的函数）返回true
+    *********************************************************************************/
+    bool LoadScriptFunctions(std::string& strError);
+};
+
+/********************************************************************************
+* 类名称：PowerShell宿主进程池
+* 类功能：管理少量常驻宿主进程，按需创建、借出、归还，并在崩溃时重建
+*
+* 调用示例：
+*    PowerShellHostPool objPool(pBackend, 2);
+*    std::string strError;
+*    auto objLease = objPool.Acquire(strError);
+*    if (objLease) {
+*        CommandResult stcResult;
+*        bool bSent = false;
+*        if (!objLease->Execute("Get-VM", 60000, stcResult, bSent)) {
+*            objLease.MarkBroken();
+*        }
+*    }   // 离开作用域时自动归还
+*********************************************************************************/
+class PowerShellHostPool {
+public:
+    /********************************************************************************
+    * 类名称：宿主租约（RAII）
+    * 类功能：持有借出的宿主进程，析构时自动归还到进程池
+    *********************************************************************************/
+    class Lease {
+    public:
+        Lease() : m_pPool(nullptr), m_bBroken(false) {}
+        Lease(PowerShellHostPool* pPool, std::unique_ptr<PowerShellHost> pHost)
+            : m_pPool(pPool), m_pHost(std::move(pHost)), m_bBroken(false) {}
+        Lease(Lease&& objOther) noexcept
+            : m_pPool(objOther.m_pPool), m_pHost(std::move(objOther.m_pHost)), m_bBroken(objOther.m_bBroken) {
+            objOther.m_pPool = nullptr;
+        }
+        Lease& operator=(Lease&& objOther) noexcept;
+        ~Lease();
+
+        explicit operator bool() const { return m_pHost != nullptr; }
+        PowerShellHost* operator->() const { return m_pHost.get(); }
+
+        /********************************************************************************
+        * 函数名称：标记损坏
+        * 函数功能：归还时丢弃此宿主（进程池会在下次借用时重建）
+        *********************************************************************************/
+        void MarkBroken();
+
+    private:
+        PowerShellHostPool*             m_pPool;   // 所属进程池
+        std::unique_ptr<PowerShellHost> m_pHost;   // 借出的宿主
+        bool                            m_bBroken; // 是否需要丢弃
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+    };
+
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  std::shared_ptr<ProcessBackend> pBackend：进程后端
+    *    [IN]  size_t nMaxHosts：最多同时存在的宿主进程数
+    *********************************************************************************/
+    PowerShellHostPool(std::shared_ptr<ProcessBackend> pBackend, size_t nMaxHosts);
+    ~PowerShellHostPool();
+
+    /********************************************************************************
+    * 函数名称：借用宿主
+    * 函数功能：取得一个可用的宿主进程；没有空闲宿主时按需启动，
+    *           已达上限时等待其他调用者归还
+    * 函数参数：
+    *    [OUT] std::string& strError：无法启动宿主时的错误信息
+    * 返回类型：Lease
+    *    失败时返回空租约
+    * 注意事项：
+    *    - 连续MAX_START_FAILURES次启动失败后不再尝试启动（每次尝试最多等待
+    *      HOST_START_TIMEOUT_MS），直接返回空租约由调用者降级为独立进程；
+    *      启动成功时清零，Shutdown后重新允许启动
+    *********************************************************************************/
+    Lease Acquire(std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：关闭进程池
+    * 函数功能：停止所有空闲宿主进程，清除启动失败计数
+    *********************************************************************************/
+    void Shutdown();
+
+    /********************************************************************************
+    * 函数名称：获取重建次数
+    * 返回类型：size_t
+    *    因崩溃或协议错误而丢弃的宿主数量
+    *********************************************************************************/
+    size_t GetRespawnCount() const { return m_nRespawns; }
+
+    /********************************************************************************
+    * 函数名称：获取连续启动失败次数
+    * 返回类型：size_t
+    *    达到MAX_START_FAILURES时Acquire不再启动宿主
+    *********************************************************************************/
+    size_t GetStartFailures() const { return m_nStartFailures; }
+
+    // 连续启动失败多少次后停止尝试启动宿主
+    static const size_t MAX_START_FAILURES = 2;
+
+private:
+    std::shared_ptr<ProcessBackend>               m_pBackend;   // 进程后端
+    size_t                                        m_nMaxHosts;  // 宿主上限
+    size_t                                        m_nLiveHosts; // 已创建（含借出）的宿主数
+    size_t                                        m_nRespawns;  // 重建次数
+    size_t                                        m_nStartFailures; // 连续启动失败次数
+    std::vector<std::unique_ptr<PowerShellHost>>  m_vecIdle;    // 空闲宿主
+    std::mutex                                    m_mtx;
+    std::condition_variable                       m_cvAvailable;
+
+    void Release(std::unique_ptr<PowerShellHost> pHost, bool bBroken);
+};
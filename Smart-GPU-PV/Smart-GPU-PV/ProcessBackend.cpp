@@ -0,0 +1,2230 @@
+﻿/********************************************************************************
+* 文件名称：ProcessBackend.cpp
+* 文件功能：实现取消令牌、基于Win32 API的默认进程后端和用于测试的POSIX进程后端
+*
+* 实现说明：
+*    Run()沿用原PowerShellExecutor::ExecuteCommand的实现：创建匿名管道，
+*    使用两个线程并行读取stdout和stderr，防止管道缓冲区满导致死锁。
+*    RunStreaming()在调用线程上读取stdout，使用池化的固定大小缓冲区组装
+*    行并直接以string_view推送给回调，不保留完整输出。
+*    Spawn()创建stdin/stdout均重定向的子进程，stderr合并到stdout，
+*    供长期运行的PowerShell宿主进程使用。
+*    RunAsync()使用重叠I/O命名管道，由CompletionLoop在一个线程上通过
+*    I/O完成端口处理所有进行中的命令：管道读取完成、作业对象的进程退出
+*    通知、截止时间和取消请求都在同一个循环中处理。
+*
+* 超时处理：
+*    所有子进程都以挂起状态创建，放入作业对象后再恢复运行，保证子进程
+*    启动的任何进程都属于同一作业。超时时结束整个作业；读取线程在宽限期
+*    内没有结束时，反复取消其同步I/O直到退出，不会无限期join。
+*    POSIX后端以进程组代替作业对象，在调用线程上用poll读取两个管道，
+*    超时和宽限期的处理与Win32后端相同；RunAsync()由基于epoll的CompletionLoop
+*    处理，进程退出通过pidfd通知（内核不支持时轮询）。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "ProcessBackend.h"
+#include "Utils.h"
+#include "ExecutorTrace.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <cstring>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/********************************************************************************
+* 结构体名称：取消令牌的共享状态（内部实现）
+*********************************************************************************/
+struct CancellationToken::State {
+    std::mutex                              mtx;
+    bool                                    bCancelled = false;  // 是否已取消
+    size_t                                  nNextId = 1;         // 下一个注册编号
+    std::map<size_t, std::function<void()>> mapCallbacks;        // 已注册的回调
+};
+
+/********************************************************************************
+* 函数实现：取消令牌构造函数
+*********************************************************************************/
+CancellationToken::CancellationToken() : m_pState(std::make_shared<State>()) {
+}
+
+/********************************************************************************
+* 函数实现：请求取消
+*********************************************************************************/
+void CancellationToken::Cancel() const {
+    // 在锁内执行回调，保证Unregister返回后回调不会再运行
+    std::lock_guard<std::mutex> lock(m_pState->mtx);
+    if (m_pState->bCancelled) {
+        return;
+    }
+    m_pState->bCancelled = true;
+    for (auto& objEntry : m_pState->mapCallbacks) {
+        objEntry.second();
+    }
+}
+
+/********************************************************************************
+* 函数实现：检查是否已取消
+*********************************************************************************/
+bool CancellationToken::IsCancelled() const {
+    std::lock_guard<std::mutex> lock(m_pState->mtx);
+    return m_pState->bCancelled;
+}
+
+/********************************************************************************
+* 函数实现：注册取消回调
+*********************************************************************************/
+size_t CancellationToken::Register(std::function<void()> fnCallback) const {
+    std::lock_guard<std::mutex> lock(m_pState->mtx);
+    if (m_pState->bCancelled) {
+        fnCallback();
+        return 0;
+    }
+    size_t nId = m_pState->nNextId++;
+    m_pState->mapCallbacks.emplace(nId, std::move(fnCallback));
+    return nId;
+}
+
+/********************************************************************************
+* 函数实现：注销取消回调
+*********************************************************************************/
+void CancellationToken::Unregister(size_t nId) const {
+    std::lock_guard<std::mutex> lock(m_pState->mtx);
+    m_pState->mapCallbacks.erase(nId);
+}
+
+/********************************************************************************
+* 函数实现：异步运行命令行（默认实现）
+*********************************************************************************/
+void ProcessBackend::RunAsync(const std::string& strCmdLine, 
+                              DWORD dwTimeoutMs, 
+                              const CancellationToken& objCancel, 
+                              CompletionHandler fnComplete) {
+    // 默认在调用线程上同步执行，已取消的命令不再启动
+    CommandResult stcResult;
+    if (objCancel.IsCancelled()) {
+        stcResult.bCancelled = true;
+        stcResult.nExitCode = static_cast<int>(ERROR_CANCELLED);
+    } else {
+        Run(strCmdLine, dwTimeoutMs, stcResult);
+    }
+    fnComplete(stcResult);
+}
+
+// 进程退出后等待读取线程自然结束的宽限期（毫秒）
+static const DWORD READER_GRACE_MS = 2000;
+// 管道已关闭但进程尚未报告退出时的轮询间隔（毫秒）
+static const DWORD EXIT_POLL_MS = 50;
+
+/********************************************************************************
+* 类名称：超时看门狗（内部实现）
+* 类功能：在后台等待指定时间，未被取消则执行超时动作；析构时取消并回收线程
+*********************************************************************************/
+class Watchdog {
+public:
+    Watchdog(DWORD dwTimeoutMs, std::function<void()> fnExpire)
+        : m_bCancelled(false), m_bExpired(false) {
+        if (dwTimeoutMs == INFINITE) {
+            return;
+        }
+        m_objThread = std::thread([this, dwTimeoutMs, fnExpire]() {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            if (!m_cv.wait_for(lock, std::chrono::milliseconds(dwTimeoutMs), [this] { return m_bCancelled; })) {
+                m_bExpired = true;
+                fnExpire();
+            }
+        });
+    }
+
+    ~Watchdog() {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_bCancelled = true;
+        }
+        m_cv.notify_all();
+        if (m_objThread.joinable()) {
+            m_objThread.join();
+        }
+    }
+
+    bool Expired() const { return m_bExpired; }
+
+private:
+    std::mutex              m_mtx;
+    std::condition_variable m_cv;
+    bool                    m_bCancelled;   // 是否已取消
+    std::atomic<bool>       m_bExpired;     // 是否已触发超时动作
+    std::thread             m_objThread;
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+};
+
+/********************************************************************************
+* 类名称：读取缓冲区池（内部实现）
+* 类功能：复用流式读取使用的大块缓冲区，避免每条命令重新分配
+*********************************************************************************/
+class ReadBufferPool {
+public:
+    static const size_t BUFFER_SIZE = 64 * 1024;   // 单个缓冲区大小（也是单行长度上限）
+    static const size_t MAX_POOLED = 4;            // 池中最多保留的空闲缓冲区
+
+    static std::unique_ptr<char[]> Acquire() {
+        std::lock_guard<std::mutex> lock(s_mtx);
+        if (s_vecFree.empty()) {
+            return std::make_unique<char[]>(BUFFER_SIZE);
+        }
+        std::unique_ptr<char[]> pBuffer = std::move(s_vecFree.back());
+        s_vecFree.pop_back();
+        return pBuffer;
+    }
+
+    static void Release(std::unique_ptr<char[]> pBuffer) {
+        std::lock_guard<std::mutex> lock(s_mtx);
+        if (s_vecFree.size() < MAX_POOLED) {
+            s_vecFree.push_back(std::move(pBuffer));
+        }
+    }
+
+private:
+    static std::mutex                          s_mtx;
+    static std::vector<std::unique_ptr<char[]>> s_vecFree;
+};
+
+std::mutex                           ReadBufferPool::s_mtx;
+std::vector<std::unique_ptr<char[]>> ReadBufferPool::s_vecFree;
+
+/********************************************************************************
+* 类名称：池化缓冲区（RAII，内部实现）
+* 类功能：构造时从缓冲区池借出，析构时归还
+*********************************************************************************/
+class PooledBuffer {
+public:
+    PooledBuffer() : m_pBuffer(ReadBufferPool::Acquire()) {}
+    ~PooledBuffer() { ReadBufferPool::Release(std::move(m_pBuffer)); }
+
+    char* Data() { return m_pBuffer.get(); }
+    static size_t Size() { return ReadBufferPool::BUFFER_SIZE; }
+
+private:
+    std::unique_ptr<char[]> m_pBuffer;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+};
+
+// 流式执行时错误输出的保留上限
+static const size_t MAX_STREAMING_STDERR = 256 * 1024;
+
+#ifdef _WIN32
+/********************************************************************************
+* 函数名称：创建作业对象（内部辅助函数）
+* 函数功能：创建关闭句柄时自动结束所有成员进程的作业对象
+* 返回类型：HANDLE
+*    作业对象句柄，失败返回nullptr
+*********************************************************************************/
+static HANDLE CreateKillOnCloseJob() {
+    HANDLE hJob = CreateJobObjectW(nullptr, nullptr);
+    if (!hJob) {
+        return nullptr;
+    }
+
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION stcLimit = {0};
+    stcLimit.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+    if (!SetInformationJobObject(hJob, JobObjectExtendedLimitInformation, &stcLimit, sizeof(stcLimit))) {
+        CloseHandle(hJob);
+        return nullptr;
+    }
+    return hJob;
+}
+
+/********************************************************************************
+* 函数名称：创建重叠I/O管道（内部辅助函数）
+* 函数功能：匿名管道不支持重叠I/O，改用唯一命名的单实例命名管道
+* 函数参数：
+*    [OUT] HANDLE& hRead：读取端（重叠I/O，不可继承）
+*    [OUT] HANDLE& hWrite：写入端（按pSA决定是否可继承）
+*    [IN]  SECURITY_ATTRIBUTES* pSA：写入端的安全属性
+* 返回类型：bool
+*    成功返回true
+*********************************************************************************/
+static bool CreateOverlappedPipe(HANDLE& hRead, HANDLE& hWrite, SECURITY_ATTRIBUTES* pSA) {
+    static std::atomic<unsigned long> s_nPipeSerial(0);
+    std::string strName = "\\\\.\\pipe\\SmartGPUPV-" + std::to_string(GetCurrentProcessId()) + "-" +
+                          std::to_string(++s_nPipeSerial);
+
+    // 1. 创建服务端（读取端），只允许一个实例，防止被其他进程抢先连接
+    hRead = CreateNamedPipeA(strName.c_str(),
+                             PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                             PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                             1, 0, 4096, 0, nullptr);
+    if (hRead == INVALID_HANDLE_VALUE) {
+        hRead = nullptr;
+        return false;
+    }
+
+    // 2. 打开客户端（写入端），交给子进程作为标准输出
+    hWrite = CreateFileA(strName.c_str(), GENERIC_WRITE, 0, pSA, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hWrite == INVALID_HANDLE_VALUE) {
+        CloseHandle(hRead);
+        hRead = nullptr;
+        hWrite = nullptr;
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数名称：在作业中启动进程（内部辅助函数）
+* 函数功能：将以CREATE_SUSPENDED创建的进程加入作业对象，然后恢复主线程
+* 函数参数：
+*    [IN]  HANDLE hJob：作业对象
+*    [IN]  const PROCESS_INFORMATION& stcPI：进程信息
+* 返回类型：bool
+*    成功返回true；失败时进程已被结束
+*********************************************************************************/
+static bool StartInJob(HANDLE hJob, const PROCESS_INFORMATION& stcPI) {
+    if (!AssignProcessToJobObject(hJob, stcPI.hProcess)) {
+        TerminateProcess(stcPI.hProcess, 1);
+        return false;
+    }
+    ResumeThread(stcPI.hThread);
+    return true;
+}
+
+/********************************************************************************
+* 函数名称：回收读取线程（内部辅助函数）
+* 函数功能：等待读取线程结束；超过宽限期则反复取消其同步I/O，直到线程退出
+* 函数参数：
+*    [IN]  std::thread& objThread：读取线程
+*    [IN]  HANDLE hJob：作业对象（宽限期到达时先结束残留的子进程）
+*********************************************************************************/
+static void JoinReader(std::thread& objThread, HANDLE hJob) {
+    if (!objThread.joinable()) {
+        return;
+    }
+
+    // 1. 正常情况：管道写入端全部关闭，线程很快读到EOF
+    HANDLE hThread = (HANDLE)objThread.native_handle();
+    if (WaitForSingleObject(hThread, READER_GRACE_MS) == WAIT_TIMEOUT) {
+        // 2. 仍有进程持有管道写入端：结束整个作业
+        TerminateJobObject(hJob, 1);
+
+        // 3. 反复取消线程的同步读取（取消可能恰好落在两次ReadFile之间）
+        while (WaitForSingleObject(hThread, 50) == WAIT_TIMEOUT) {
+            CancelSynchronousIo(hThread);
+        }
+    }
+    objThread.join();
+}
+
+/********************************************************************************
+* 类名称：Win32交互式子进程（内部实现）
+* 类功能：持有子进程句柄、作业对象和stdin/stdout管道，提供按行读取
+*********************************************************************************/
+class Win32ChildProcess : public ChildProcess {
+public:
+    Win32ChildProcess(HANDLE hJob, HANDLE hProcess, HANDLE hStdinWrite, HANDLE hStdoutRead)
+        : m_hJob(hJob), m_hProcess(hProcess), m_hStdinWrite(hStdinWrite), m_hStdoutRead(hStdoutRead) {
+    }
+
+    ~Win32ChildProcess() override {
+        // 1. 关闭stdin，宿主进程读到EOF后会自行退出
+        if (m_hStdinWrite) {
+            CloseHandle(m_hStdinWrite);
+            m_hStdinWrite = nullptr;
+        }
+
+        // 2. 给子进程短暂的退出时间，超时则强制结束
+        if (m_hProcess && WaitForSingleObject(m_hProcess, 500) == WAIT_TIMEOUT) {
+            TerminateJobObject(m_hJob, 1);
+        }
+
+        Terminate();
+    }
+
+    bool WriteInput(const std::string& strData) override {
+        if (!m_hStdinWrite) return false;
+
+        // 循环写入直到全部数据写完
+        size_t nOffset = 0;
+        while (nOffset < strData.size()) {
+            DWORD dwWritten = 0;
+            DWORD dwChunk = static_cast<DWORD>(strData.size() - nOffset);
+            if (!WriteFile(m_hStdinWrite, strData.data() + nOffset, dwChunk, &dwWritten, nullptr) || dwWritten == 0) {
+                return false;
+            }
+            nOffset += dwWritten;
+        }
+        return true;
+    }
+
+    bool ReadOutputLine(std::string& strLine) override {
+        while (true) {
+            // 1. 缓冲区中已有完整的一行，直接返回
+            size_t nNewLine = m_strPending.find('\n');
+            if (nNewLine != std::string::npos) {
+                strLine.assign(m_strPending, 0, nNewLine);
+                m_strPending.erase(0, nNewLine + 1);
+                if (!strLine.empty() && strLine.back() == '\r') {
+                    strLine.pop_back();
+                }
+                return true;
+            }
+
+            // 2. 继续从管道读取（超时后进程树被结束，ReadFile随之失败）
+            if (!m_hStdoutRead) return false;
+            char szBuffer[4096];
+            DWORD dwBytesRead = 0;
+            if (!ReadFile(m_hStdoutRead, szBuffer, sizeof(szBuffer), &dwBytesRead, nullptr) || dwBytesRead == 0) {
+                return false;
+            }
+            m_strPending.append(szBuffer, dwBytesRead);
+        }
+    }
+
+    bool IsAlive() override {
+        return m_hProcess && WaitForSingleObject(m_hProcess, 0) == WAIT_TIMEOUT;
+    }
+
+    void Terminate() override {
+        m_bExpired = DeadlineExpired();
+        m_pWatchdog.reset();
+        if (m_hJob) {
+            // 关闭作业句柄会结束宿主及其启动的所有进程（KILL_ON_JOB_CLOSE）
+            TerminateJobObject(m_hJob, 1);
+            CloseHandle(m_hJob);
+            m_hJob = nullptr;
+        }
+        if (m_hProcess) {
+            CloseHandle(m_hProcess);
+            m_hProcess = nullptr;
+        }
+        if (m_hStdinWrite) {
+            CloseHandle(m_hStdinWrite);
+            m_hStdinWrite = nullptr;
+        }
+        if (m_hStdoutRead) {
+            CloseHandle(m_hStdoutRead);
+            m_hStdoutRead = nullptr;
+        }
+    }
+
+    void SetDeadline(DWORD dwTimeoutMs) override {
+        // 先取消旧的截止时间，再按需设置新的
+        m_bExpired = m_bExpired || (m_pWatchdog && m_pWatchdog->Expired());
+        m_pWatchdog.reset();
+        if (dwTimeoutMs == INFINITE || !m_hJob) {
+            return;
+        }
+        m_bExpired = false;
+        HANDLE hJob = m_hJob;
+        m_pWatchdog = std::make_unique<Watchdog>(dwTimeoutMs, [hJob]() {
+            TerminateJobObject(hJob, ERROR_TIMEOUT);
+        });
+    }
+
+    bool DeadlineExpired() override {
+        return m_bExpired || (m_pWatchdog && m_pWatchdog->Expired());
+    }
+
+private:
+    HANDLE                    m_hJob;          // 作业对象（包含宿主进程树）
+    HANDLE                    m_hProcess;      // 子进程句柄
+    HANDLE                    m_hStdinWrite;   // stdin写入端
+    HANDLE                    m_hStdoutRead;   // stdout读取端（含合并的stderr）
+    std::string               m_strPending;    // 尚未组成完整行的数据
+    std::unique_ptr<Watchdog> m_pWatchdog;     // 当前截止时间的看门狗
+    bool                      m_bExpired = false;  // 最近一次截止时间是否已触发
+};
+
+// 完成端口上用于唤醒完成循环的键（提交新命令、取消、停止）
+static const ULONG_PTR WAKE_KEY = 0;
+// 异步读取的单次缓冲区大小
+static const DWORD ASYNC_READ_SIZE = 4096;
+
+/********************************************************************************
+* 结构体名称：异步管道（内部实现）
+* 结构体功能：一个重叠读取的管道及其缓冲区；同一时间最多一个未完成的读取
+*********************************************************************************/
+struct AsyncPipe {
+    OVERLAPPED  stcOverlapped = {0};          // 重叠结构（读取完成前必须保持有效）
+    HANDLE      hPipe = nullptr;              // 读取端
+    bool        bOpen = false;                // 是否有未完成的读取
+    char        szBuffer[ASYNC_READ_SIZE];    // 读取缓冲区
+    std::string strData;                      // 已读取的数据
+};
+
+/********************************************************************************
+* 结构体名称：异步命令（内部实现）
+* 结构体功能：一条进行中的异步命令的全部状态，只由完成循环线程访问
+*********************************************************************************/
+struct AsyncOperation {
+    ULONG_PTR         nKey = 0;               // 完成键（同时用于管道和作业对象通知）
+    HANDLE            hJob = nullptr;         // 作业对象
+    HANDLE            hProcess = nullptr;     // 进程句柄
+    DWORD             dwProcessId = 0;        // 进程ID
+    AsyncPipe         stcStdout;              // 标准输出
+    AsyncPipe         stcStderr;              // 错误输出
+    uint64_t          ui64StartUs = 0;        // 开始时刻（ExecutorTrace::NowUs）
+    ULONGLONG         ui64Deadline = 0;       // 截止时刻（GetTickCount64，0表示不限）
+    ULONGLONG         ui64DrainDeadline = 0;  // 进程退出后等待管道关闭的时限（0表示未开始）
+    bool              bKilled = false;        // 是否已结束进程树
+    CancellationToken objCancel;              // 取消令牌
+    size_t            nCancelId = 0;          // 取消回调的注册编号
+    CommandResult     stcResult;              // 命令结果
+    CompletionHandler fnComplete;             // 完成回调
+};
+
+/********************************************************************************
+* 类名称：I/O完成循环（内部实现）
+* 类功能：一个线程通过I/O完成端口同时处理所有异步命令的读取、退出、
+*         超时和取消
+*********************************************************************************/
+class CompletionLoop {
+public:
+    CompletionLoop() : m_hPort(nullptr), m_bStopping(false), m_nNextKey(1) {}
+
+    ~CompletionLoop() {
+        if (!m_hPort) {
+            return;
+        }
+        // 取消所有进行中的命令，等待它们的回调执行完毕后再关闭端口
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            m_bStopping = true;
+        }
+        PostQueuedCompletionStatus(m_hPort, 0, WAKE_KEY, nullptr);
+        if (m_objThread.joinable()) {
+            m_objThread.join();
+        }
+        CloseHandle(m_hPort);
+    }
+
+    bool Start() {
+        m_hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+        if (!m_hPort) {
+            return false;
+        }
+        m_objThread = std::thread([this]() { Loop(); });
+        return true;
+    }
+
+    void Submit(std::unique_ptr<AsyncOperation> pOp) {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            pOp->nKey = m_nNextKey++;
+            m_vecSubmitted.push_back(std::move(pOp));
+        }
+        PostQueuedCompletionStatus(m_hPort, 0, WAKE_KEY, nullptr);
+    }
+
+private:
+    HANDLE                                                m_hPort;         // I/O完成端口
+    std::thread                                           m_objThread;     // 完成循环线程
+    std::mutex                                            m_mtx;           // 保护提交队列
+    bool                                                  m_bStopping;     // 是否正在停止
+    ULONG_PTR                                             m_nNextKey;      // 下一个完成键
+    std::vector<std::unique_ptr<AsyncOperation>>          m_vecSubmitted;  // 待接管的命令
+    std::map<ULONG_PTR, std::unique_ptr<AsyncOperation>>  m_mapOps;        // 进行中的命令（仅循环线程访问）
+
+    /********************************************************************************
+    * 函数名称：完成循环主体
+    *********************************************************************************/
+    void Loop() {
+        OVERLAPPED_ENTRY arrEntries[16];
+        while (true) {
+            // 1. 接管新提交的命令
+            bool bStopping = false;
+            std::vector<std::unique_ptr<AsyncOperation>> vecSubmitted;
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                bStopping = m_bStopping;
+                vecSubmitted.swap(m_vecSubmitted);
+            }
+            for (auto& pOp : vecSubmitted) {
+                Adopt(std::move(pOp));
+            }
+
+            // 2. 处理取消、超时和已结束的命令
+            Sweep(bStopping);
+            if (bStopping && m_mapOps.empty()) {
+                break;
+            }
+
+            // 3. 等待下一批完成通知（或最近的截止时间）
+            ULONG nCount = 0;
+            if (GetQueuedCompletionStatusEx(m_hPort, arrEntries, 16, &nCount, NextWaitMs(), FALSE)) {
+                for (ULONG i = 0; i < nCount; ++i) {
+                    Dispatch(arrEntries[i]);
+                }
+            }
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：接管命令
+    * 函数功能：将管道和作业对象关联到完成端口，发起首次读取
+    *********************************************************************************/
+    void Adopt(std::unique_ptr<AsyncOperation> pOp) {
+        AsyncOperation& stcOp = *pOp;
+
+        // 1. 管道读取完成和作业对象通知都使用命令的完成键
+        bool bAssociated = CreateIoCompletionPort(stcOp.stcStdout.hPipe, m_hPort, stcOp.nKey, 0) &&
+                           CreateIoCompletionPort(stcOp.stcStderr.hPipe, m_hPort, stcOp.nKey, 0);
+        JOBOBJECT_ASSOCIATE_COMPLETION_PORT stcPort = {0};
+        stcPort.CompletionKey = reinterpret_cast<PVOID>(stcOp.nKey);
+        stcPort.CompletionPort = m_hPort;
+        SetInformationJobObject(stcOp.hJob, JobObjectAssociateCompletionPortInformation, &stcPort, sizeof(stcPort));
+
+        // 2. 取消时唤醒完成循环
+        HANDLE hPort = m_hPort;
+        stcOp.nCancelId = stcOp.objCancel.Register([hPort]() {
+            PostQueuedCompletionStatus(hPort, 0, WAKE_KEY, nullptr);
+        });
+
+        // 3. 发起读取（无法关联完成端口时直接结束进程，按失败返回）
+        if (bAssociated) {
+            StartRead(stcOp.stcStdout);
+            StartRead(stcOp.stcStderr);
+        } else {
+            stcOp.stcResult.strError = "无法关联I/O完成端口";
+            Kill(stcOp, 1);
+        }
+        m_mapOps.emplace(stcOp.nKey, std::move(pOp));
+    }
+
+    /********************************************************************************
+    * 函数名称：发起一次重叠读取
+    *********************************************************************************/
+    static void StartRead(AsyncPipe& stcPipe) {
+        ZeroMemory(&stcPipe.stcOverlapped, sizeof(OVERLAPPED));
+        // 同步完成也会向完成端口投递通知，因此只需区分"已断开"
+        if (!ReadFile(stcPipe.hPipe, stcPipe.szBuffer, ASYNC_READ_SIZE, nullptr, &stcPipe.stcOverlapped) &&
+            GetLastError() != ERROR_IO_PENDING) {
+            stcPipe.bOpen = false;
+            return;
+        }
+        stcPipe.bOpen = true;
+    }
+
+    /********************************************************************************
+    * 函数名称：处理一次读取完成
+    *********************************************************************************/
+    static void OnReadComplete(AsyncPipe& stcPipe) {
+        DWORD dwBytesRead = 0;
+        if (GetOverlappedResult(stcPipe.hPipe, &stcPipe.stcOverlapped, &dwBytesRead, FALSE) && dwBytesRead > 0) {
+            stcPipe.strData.append(stcPipe.szBuffer, dwBytesRead);
+            StartRead(stcPipe);
+        } else {
+            // 写入端全部关闭、或读取被取消
+            stcPipe.bOpen = false;
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：分发完成通知
+    *********************************************************************************/
+    void Dispatch(const OVERLAPPED_ENTRY& stcEntry) {
+        if (stcEntry.lpCompletionKey == WAKE_KEY) {
+            return;
+        }
+        // 已完成命令的迟到通知（例如作业对象消息）直接忽略
+        auto it = m_mapOps.find(stcEntry.lpCompletionKey);
+        if (it == m_mapOps.end()) {
+            return;
+        }
+        AsyncOperation& stcOp = *it->second;
+
+        if (stcEntry.lpOverlapped == &stcOp.stcStdout.stcOverlapped) {
+            OnReadComplete(stcOp.stcStdout);
+            if (stcOp.stcResult.ui64FirstByteUs == 0 && !stcOp.stcStdout.strData.empty()) {
+                stcOp.stcResult.ui64FirstByteUs = ExecutorTrace::NowUs() - stcOp.ui64StartUs;
+            }
+        } else if (stcEntry.lpOverlapped == &stcOp.stcStderr.stcOverlapped) {
+            OnReadComplete(stcOp.stcStderr);
+        } else {
+            // 作业对象通知：字节数为消息类型，lpOverlapped为进程ID
+            DWORD dwMessage = stcEntry.dwNumberOfBytesTransferred;
+            DWORD dwProcessId = static_cast<DWORD>(reinterpret_cast<ULONG_PTR>(stcEntry.lpOverlapped));
+            if ((dwMessage == JOB_OBJECT_MSG_EXIT_PROCESS || dwMessage == JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS) &&
+                dwProcessId == stcOp.dwProcessId && stcOp.ui64DrainDeadline == 0) {
+                // 主进程已退出，残留进程持有管道时最多再等待宽限期
+                stcOp.ui64DrainDeadline = GetTickCount64() + READER_GRACE_MS;
+            }
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：结束命令的进程树
+    *********************************************************************************/
+    static void Kill(AsyncOperation& stcOp, UINT uExitCode) {
+        if (stcOp.bKilled) {
+            return;
+        }
+        TerminateJobObject(stcOp.hJob, uExitCode);
+        stcOp.bKilled = true;
+        if (stcOp.ui64DrainDeadline == 0) {
+            stcOp.ui64DrainDeadline = GetTickCount64() + READER_GRACE_MS;
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：检查所有命令
+    * 函数功能：处理取消、超时、宽限期到达，并完成已结束的命令
+    *********************************************************************************/
+    void Sweep(bool bStopping) {
+        ULONGLONG ui64Now = GetTickCount64();
+        std::vector<std::unique_ptr<AsyncOperation>> vecFinished;
+
+        for (auto it = m_mapOps.begin(); it != m_mapOps.end();) {
+            AsyncOperation& stcOp = *it->second;
+
+            // 1. 取消（包括后端析构）和超时：结束进程树
+            if (!stcOp.bKilled && (bStopping || stcOp.objCancel.IsCancelled())) {
+                stcOp.stcResult.bCancelled = true;
+                Kill(stcOp, ERROR_CANCELLED);
+            } else if (!stcOp.bKilled && stcOp.ui64Deadline != 0 && ui64Now >= stcOp.ui64Deadline) {
+                stcOp.stcResult.bTimedOut = true;
+                Kill(stcOp, ERROR_TIMEOUT);
+            }
+
+            // 2. 宽限期已到仍有管道未关闭：结束残留进程并取消读取
+            if (stcOp.ui64DrainDeadline != 0 && ui64Now >= stcOp.ui64DrainDeadline &&
+                (stcOp.stcStdout.bOpen || stcOp.stcStderr.bOpen)) {
+                TerminateJobObject(stcOp.hJob, 1);
+                CancelIoEx(stcOp.stcStdout.hPipe, nullptr);
+                CancelIoEx(stcOp.stcStderr.hPipe, nullptr);
+                stcOp.ui64DrainDeadline = ui64Now + EXIT_POLL_MS;
+            }
+
+            // 3. 两个管道都已关闭且进程已退出：命令完成
+            if (!stcOp.stcStdout.bOpen && !stcOp.stcStderr.bOpen &&
+                WaitForSingleObject(stcOp.hProcess, 0) == WAIT_OBJECT_0) {
+                vecFinished.push_back(std::move(it->second));
+                it = m_mapOps.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // 4. 在遍历结束后执行回调（回调中可以提交新命令）
+        for (auto& pOp : vecFinished) {
+            Finish(*pOp);
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：计算下一次等待时间
+    * 返回类型：DWORD
+    *    到最近的截止时间或宽限期的毫秒数，没有则为INFINITE
+    *********************************************************************************/
+    DWORD NextWaitMs() const {
+        ULONGLONG ui64Now = GetTickCount64();
+        DWORD dwWait = INFINITE;
+        for (const auto& objEntry : m_mapOps) {
+            const AsyncOperation& stcOp = *objEntry.second;
+            ULONGLONG arrTimes[2] = { stcOp.bKilled ? 0 : stcOp.ui64Deadline, stcOp.ui64DrainDeadline };
+            for (ULONGLONG ui64Time : arrTimes) {
+                if (ui64Time == 0) continue;
+                DWORD dwRemain = (ui64Time > ui64Now) ? static_cast<DWORD>(ui64Time - ui64Now) : 0;
+                dwWait = (dwRemain < dwWait) ? dwRemain : dwWait;
+            }
+            // 管道已关闭但还没有收到退出通知（通知不保证送达）：轮询进程状态
+            if (!stcOp.stcStdout.bOpen && !stcOp.stcStderr.bOpen) {
+                dwWait = (EXIT_POLL_MS < dwWait) ? EXIT_POLL_MS : dwWait;
+            }
+        }
+        return dwWait;
+    }
+
+    /********************************************************************************
+    * 函数名称：完成命令
+    * 函数功能：填充结果、释放句柄并执行完成回调
+    *********************************************************************************/
+    static void Finish(AsyncOperation& stcOp) {
+        stcOp.objCancel.Unregister(stcOp.nCancelId);
+
+        DWORD dwExitCode = 0;
+        GetExitCodeProcess(stcOp.hProcess, &dwExitCode);
+        CloseHandle(stcOp.hProcess);
+        CloseHandle(stcOp.stcStdout.hPipe);
+        CloseHandle(stcOp.stcStderr.hPipe);
+        CloseHandle(stcOp.hJob);
+
+        CommandResult& stcResult = stcOp.stcResult;
+        if (stcResult.bTimedOut) {
+            stcResult.nExitCode = static_cast<int>(ERROR_TIMEOUT);
+        } else if (stcResult.bCancelled) {
+            stcResult.nExitCode = static_cast<int>(ERROR_CANCELLED);
+        } else {
+            stcResult.nExitCode = static_cast<int>(dwExitCode);
+        }
+        stcResult.strOutput = std::move(stcOp.stcStdout.strData);
+        stcResult.strError += stcOp.stcStderr.strData;
+        stcOp.fnComplete(stcResult);
+    }
+};
+
+/********************************************************************************
+* 函数实现：Win32进程后端构造函数/析构函数
+*********************************************************************************/
+Win32ProcessBackend::Win32ProcessBackend() {
+}
+
+Win32ProcessBackend::~Win32ProcessBackend() {
+    // 完成循环析构时取消所有进行中的异步命令
+}
+
+/********************************************************************************
+* 函数实现：创建重定向的子进程
+*********************************************************************************/
+bool Win32ProcessBackend::CreateRedirectedProcess(const std::string& strCmdLine, 
+                                                  bool bOverlapped, 
+                                                  HANDLE& hJob, 
+                                                  HANDLE& hProcess, 
+                                                  DWORD& dwProcessId, 
+                                                  HANDLE& hStdoutRead, 
+                                                  HANDLE& hStderrRead, 
+                                                  std::string& strError) {
+    // 1. 初始化安全属性（允许句柄继承）
+    SECURITY_ATTRIBUTES stcSA = {0};
+    stcSA.nLength = sizeof(SECURITY_ATTRIBUTES);
+    stcSA.bInheritHandle = TRUE;
+    stcSA.lpSecurityDescriptor = nullptr;
+
+    // 2. 创建作业对象（用于超时时结束整个进程树）
+    hJob = CreateKillOnCloseJob();
+    if (!hJob) {
+        strError = "无法创建作业对象";
+        return false;
+    }
+
+    // 3. 创建标准输出管道（异步执行时使用重叠I/O管道）
+    auto fnCreatePipe = [&](HANDLE& hRead, HANDLE& hWrite) {
+        return bOverlapped ? CreateOverlappedPipe(hRead, hWrite, &stcSA)
+                           : (CreatePipe(&hRead, &hWrite, &stcSA, 0) != FALSE);
+    };
+    HANDLE hStdoutWrite = nullptr;
+    if (!fnCreatePipe(hStdoutRead, hStdoutWrite)) {
+        CloseHandle(hJob);
+        strError = "无法创建输出管道";
+        return false;
+    }
+
+    // 4. 创建标准错误管道
+    HANDLE hStderrWrite = nullptr;
+    if (!fnCreatePipe(hStderrRead, hStderrWrite)) {
+        CloseHandle(hStdoutRead);
+        CloseHandle(hStdoutWrite);
+        CloseHandle(hJob);
+        strError = "无法创建错误管道";
+        return false;
+    }
+
+    // 5. 确保读取端不被子进程继承
+    SetHandleInformation(hStdoutRead, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(hStderrRead, HANDLE_FLAG_INHERIT, 0);
+
+    // 6. 配置进程启动信息
+    STARTUPINFOA stcSI = {0};
+    stcSI.cb = sizeof(STARTUPINFOA);
+    stcSI.hStdOutput = hStdoutWrite;
+    stcSI.hStdError = hStderrWrite;
+    stcSI.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+    stcSI.wShowWindow = SW_HIDE;  // 隐藏PowerShell窗口
+
+    PROCESS_INFORMATION stcPI = {0};
+
+    // 7. 准备可修改的命令行缓冲区（CreateProcessA要求）
+    std::vector<char> vecCmdLineBuf(strCmdLine.begin(), strCmdLine.end());
+    vecCmdLineBuf.push_back(0);  // 添加空终止符
+
+    // 8. 以挂起状态创建进程（加入作业后再运行，确保其子进程也属于作业）
+    BOOL bSuccess = CreateProcessA(
+        nullptr,                    // 应用程序名称（使用命令行中的）
+        vecCmdLineBuf.data(),      // 命令行
+        nullptr,                    // 进程安全属性
+        nullptr,                    // 线程安全属性
+        TRUE,                       // 继承句柄
+        CREATE_NO_WINDOW | CREATE_SUSPENDED,  // 创建标志（无窗口、挂起）
+        nullptr,                    // 环境变量
+        nullptr,                    // 当前目录
+        &stcSI,                    // 启动信息
+        &stcPI                     // 进程信息
+    );
+
+    // 9. 父进程不需要写入端，立即关闭
+    CloseHandle(hStdoutWrite);
+    CloseHandle(hStderrWrite);
+
+    // 10. 检查进程创建是否成功，并加入作业对象
+    if (!bSuccess || !StartInJob(hJob, stcPI)) {
+        if (bSuccess) {
+            CloseHandle(stcPI.hProcess);
+            CloseHandle(stcPI.hThread);
+        }
+        CloseHandle(hStdoutRead);
+        CloseHandle(hStderrRead);
+        CloseHandle(hJob);
+        strError = "无法启动PowerShell进程";
+        return false;
+    }
+
+    CloseHandle(stcPI.hThread);
+    hProcess = stcPI.hProcess;
+    dwProcessId = stcPI.dwProcessId;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：运行命令行
+*********************************************************************************/
+bool Win32ProcessBackend::Run(const std::string& strCmdLine, DWORD dwTimeoutMs, CommandResult& stcResult) {
+    // 1. 创建进程和输出管道
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    HANDLE hJob = nullptr;
+    HANDLE hProcess = nullptr;
+    HANDLE hStdoutRead = nullptr;
+    HANDLE hStderrRead = nullptr;
+    DWORD dwProcessId = 0;
+    if (!CreateRedirectedProcess(strCmdLine, false, hJob, hProcess, dwProcessId, hStdoutRead, hStderrRead,
+                                 stcResult.strError)) {
+        return false;
+    }
+    stcResult.ui64SpawnUs = ExecutorTrace::NowUs() - ui64StartUs;
+
+    // 2. 使用两个线程并行读取输出和错误（防止管道缓冲区满导致死锁）
+    std::string strRawOutput, strRawError;
+    uint64_t ui64StdoutFirstByte = 0, ui64StderrFirstByte = 0;
+
+    // 2.1 创建标准输出读取线程
+    std::thread objStdoutThread([&]() {
+        strRawOutput = ReadFromPipe(hStdoutRead, ui64StdoutFirstByte);
+    });
+
+    // 2.2 创建标准错误读取线程
+    std::thread objStderrThread([&]() {
+        strRawError = ReadFromPipe(hStderrRead, ui64StderrFirstByte);
+    });
+
+    // 3. 等待进程结束，超过截止时间则结束整个进程树
+    bool bTimedOut = (WaitForSingleObject(hProcess, dwTimeoutMs) == WAIT_TIMEOUT);
+    if (bTimedOut) {
+        TerminateJobObject(hJob, ERROR_TIMEOUT);
+        WaitForSingleObject(hProcess, READER_GRACE_MS);
+    }
+
+    // 4. 回收读取线程（不会因残留进程持有管道而无限等待）
+    JoinReader(objStdoutThread, hJob);
+    JoinReader(objStderrThread, hJob);
+
+    // 5. 获取进程退出码
+    DWORD dwExitCode = 0;
+    GetExitCodeProcess(hProcess, &dwExitCode);
+
+    // 6. 清理进程、管道和作业句柄（关闭作业会结束残留的子进程）
+    CloseHandle(hProcess);
+    CloseHandle(hStdoutRead);
+    CloseHandle(hStderrRead);
+    CloseHandle(hJob);
+
+    // 7. 返回原始数据（编码修复由PowerShellExecutor统一处理）
+    stcResult.bTimedOut = bTimedOut;
+    stcResult.nExitCode = bTimedOut ? static_cast<int>(ERROR_TIMEOUT) : static_cast<int>(dwExitCode);
+    stcResult.ui64FirstByteUs = (ui64StdoutFirstByte != 0) ? ui64StdoutFirstByte - ui64StartUs : 0;
+    stcResult.strOutput = std::move(strRawOutput);
+    stcResult.strError = std::move(strRawError);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：流式运行命令行
+*********************************************************************************/
+bool Win32ProcessBackend::RunStreaming(const std::string& strCmdLine, 
+                                       DWORD dwTimeoutMs, 
+                                       const LineSink& fnSink, 
+                                       CommandResult& stcResult) {
+    // 1. 创建进程和输出管道
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    HANDLE hJob = nullptr;
+    HANDLE hProcess = nullptr;
+    HANDLE hStdoutRead = nullptr;
+    HANDLE hStderrRead = nullptr;
+    DWORD dwProcessId = 0;
+    if (!CreateRedirectedProcess(strCmdLine, false, hJob, hProcess, dwProcessId, hStdoutRead, hStderrRead,
+                                 stcResult.strError)) {
+        return false;
+    }
+    stcResult.ui64SpawnUs = ExecutorTrace::NowUs() - ui64StartUs;
+
+    // 2. 错误输出在后台线程读取（只保留前MAX_STREAMING_STDERR字节）
+    std::string strRawError;
+    std::thread objStderrThread([&]() {
+        char szBuffer[4096];
+        DWORD dwBytesRead = 0;
+        while (ReadFile(hStderrRead, szBuffer, sizeof(szBuffer), &dwBytesRead, nullptr) && dwBytesRead > 0) {
+            if (strRawError.size() < MAX_STREAMING_STDERR) {
+                size_t nRoom = MAX_STREAMING_STDERR - strRawError.size();
+                strRawError.append(szBuffer, dwBytesRead < nRoom ? dwBytesRead : nRoom);
+            }
+        }
+    });
+
+    // 3. 标准输出在调用线程上读取，每形成完整的一行就推送给回调
+    HANDLE hCallerThread = nullptr;
+    DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(),
+                    &hCallerThread, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    {
+        // 3.1 截止时间到达时结束进程树，并取消调用线程上阻塞的读取
+        Watchdog objWatchdog(dwTimeoutMs, [hJob, hCallerThread]() {
+            TerminateJobObject(hJob, ERROR_TIMEOUT);
+            if (hCallerThread) CancelSynchronousIo(hCallerThread);
+        });
+
+        PooledBuffer objBuffer;
+        char* pBuffer = objBuffer.Data();
+        size_t nUsed = 0;
+
+        while (!objWatchdog.Expired()) {
+            // 3.2 缓冲区已满仍没有换行：将已有内容作为一行推送（限制单行内存）
+            if (nUsed == PooledBuffer::Size()) {
+                fnSink(std::string_view(pBuffer, nUsed));
+                nUsed = 0;
+            }
+
+            // 3.3 读取到缓冲区剩余空间
+            DWORD dwBytesRead = 0;
+            if (!ReadFile(hStdoutRead, pBuffer + nUsed, static_cast<DWORD>(PooledBuffer::Size() - nUsed),
+                          &dwBytesRead, nullptr) || dwBytesRead == 0) {
+                break;
+            }
+            if (stcResult.ui64FirstByteUs == 0) {
+                stcResult.ui64FirstByteUs = ExecutorTrace::NowUs() - ui64StartUs;
+            }
+            nUsed += dwBytesRead;
+
+            // 3.4 推送所有完整的行（零拷贝，直接引用缓冲区）
+            std::string_view svBuffered(pBuffer, nUsed);
+            size_t nLastNewLine = svBuffered.rfind('\n');
+            if (nLastNewLine == std::string_view::npos) {
+                continue;
+            }
+            std::string_view svComplete = svBuffered.substr(0, nLastNewLine + 1);
+            std::string_view svLine;
+            while (Utils::NextLine(svComplete, svLine)) {
+                fnSink(svLine);
+            }
+
+            // 3.5 将未完成的行移到缓冲区开头
+            nUsed -= nLastNewLine + 1;
+            memmove(pBuffer, pBuffer + nLastNewLine + 1, nUsed);
+        }
+
+        // 3.6 最后一行没有换行符
+        std::string_view svRest(pBuffer, nUsed), svLine;
+        while (Utils::NextLine(svRest, svLine)) {
+            fnSink(svLine);
+        }
+
+        stcResult.bTimedOut = objWatchdog.Expired();
+    }
+    // 看门狗析构后才能关闭它引用的线程句柄
+    if (hCallerThread) CloseHandle(hCallerThread);
+
+    // 4. 标准输出已关闭或已超时，等待进程结束并回收错误读取线程
+    if (WaitForSingleObject(hProcess, READER_GRACE_MS) == WAIT_TIMEOUT) {
+        TerminateJobObject(hJob, 1);
+        WaitForSingleObject(hProcess, READER_GRACE_MS);
+    }
+    JoinReader(objStderrThread, hJob);
+
+    // 5. 获取进程退出码
+    DWORD dwExitCode = 0;
+    GetExitCodeProcess(hProcess, &dwExitCode);
+
+    // 6. 清理进程、管道和作业句柄
+    CloseHandle(hProcess);
+    CloseHandle(hStdoutRead);
+    CloseHandle(hStderrRead);
+    CloseHandle(hJob);
+
+    stcResult.nExitCode = stcResult.bTimedOut ? static_cast<int>(ERROR_TIMEOUT) : static_cast<int>(dwExitCode);
+    stcResult.strError = std::move(strRawError);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：异步运行命令行
+*********************************************************************************/
+void Win32ProcessBackend::RunAsync(const std::string& strCmdLine, 
+                                   DWORD dwTimeoutMs, 
+                                   const CancellationToken& objCancel, 
+                                   CompletionHandler fnComplete) {
+    // 1. 取得（或按需启动）完成循环；完成端口不可用时同步执行
+    CompletionLoop* pLoop = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mtxLoop);
+        if (!m_pLoop) {
+            auto pNewLoop = std::make_unique<CompletionLoop>();
+            if (pNewLoop->Start()) {
+                m_pLoop = std::move(pNewLoop);
+            }
+        }
+        pLoop = m_pLoop.get();
+    }
+    if (!pLoop) {
+        ProcessBackend::RunAsync(strCmdLine, dwTimeoutMs, objCancel, std::move(fnComplete));
+        return;
+    }
+
+    // 2. 已取消的命令不再启动
+    auto pOp = std::make_unique<AsyncOperation>();
+    if (objCancel.IsCancelled()) {
+        pOp->stcResult.bCancelled = true;
+        pOp->stcResult.nExitCode = static_cast<int>(ERROR_CANCELLED);
+        fnComplete(pOp->stcResult);
+        return;
+    }
+
+    // 3. 创建进程（重叠I/O管道），无法启动时立即回调
+    pOp->ui64StartUs = ExecutorTrace::NowUs();
+    if (!CreateRedirectedProcess(strCmdLine, true, pOp->hJob, pOp->hProcess, pOp->dwProcessId,
+                                 pOp->stcStdout.hPipe, pOp->stcStderr.hPipe, pOp->stcResult.strError)) {
+        fnComplete(pOp->stcResult);
+        return;
+    }
+    pOp->stcResult.ui64SpawnUs = ExecutorTrace::NowUs() - pOp->ui64StartUs;
+
+    // 4. 交给完成循环（截止时间从进程启动时开始计算）
+    pOp->ui64Deadline = (dwTimeoutMs == INFINITE) ? 0 : GetTickCount64() + dwTimeoutMs;
+    pOp->objCancel = objCancel;
+    pOp->fnComplete = std::move(fnComplete);
+    pLoop->Submit(std::move(pOp));
+}
+
+/********************************************************************************
+* 函数实现：启动交互式子进程
+*********************************************************************************/
+std::unique_ptr<ChildProcess> Win32ProcessBackend::Spawn(const std::string& strCmdLine, std::string& strError) {
+    // 1. 初始化安全属性（允许句柄继承）
+    SECURITY_ATTRIBUTES stcSA = {0};
+    stcSA.nLength = sizeof(SECURITY_ATTRIBUTES);
+    stcSA.bInheritHandle = TRUE;
+    stcSA.lpSecurityDescriptor = nullptr;
+
+    // 2. 创建作业对象（本程序退出或宿主被丢弃时结束整个进程树）
+    HANDLE hJob = CreateKillOnCloseJob();
+    if (!hJob) {
+        strError = "无法创建作业对象";
+        return nullptr;
+    }
+
+    // 3. 创建标准输入管道
+    HANDLE hStdinRead = nullptr;
+    HANDLE hStdinWrite = nullptr;
+    if (!CreatePipe(&hStdinRead, &hStdinWrite, &stcSA, 0)) {
+        CloseHandle(hJob);
+        strError = "无法创建输入管道";
+        return nullptr;
+    }
+
+    // 4. 创建标准输出管道（错误输出合并到此管道）
+    HANDLE hStdoutRead = nullptr;
+    HANDLE hStdoutWrite = nullptr;
+    if (!CreatePipe(&hStdoutRead, &hStdoutWrite, &stcSA, 0)) {
+        CloseHandle(hStdinRead);
+        CloseHandle(hStdinWrite);
+        CloseHandle(hJob);
+        strError = "无法创建输出管道";
+        return nullptr;
+    }
+
+    // 5. 父进程持有的一端不被子进程继承
+    SetHandleInformation(hStdinWrite, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(hStdoutRead, HANDLE_FLAG_INHERIT, 0);
+
+    // 6. 配置进程启动信息
+    STARTUPINFOA stcSI = {0};
+    stcSI.cb = sizeof(STARTUPINFOA);
+    stcSI.hStdInput = hStdinRead;
+    stcSI.hStdOutput = hStdoutWrite;
+    stcSI.hStdError = hStdoutWrite;
+    stcSI.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+    stcSI.wShowWindow = SW_HIDE;
+
+    PROCESS_INFORMATION stcPI = {0};
+    std::vector<char> vecCmdLineBuf(strCmdLine.begin(), strCmdLine.end());
+    vecCmdLineBuf.push_back(0);
+
+    // 7. 以挂起状态创建进程，加入作业后再运行
+    BOOL bSuccess = CreateProcessA(nullptr, vecCmdLineBuf.data(), nullptr, nullptr, TRUE,
+                                   CREATE_NO_WINDOW | CREATE_SUSPENDED, nullptr, nullptr, &stcSI, &stcPI);
+
+    // 8. 关闭子进程使用的一端
+    CloseHandle(hStdinRead);
+    CloseHandle(hStdoutWrite);
+
+    if (!bSuccess || !StartInJob(hJob, stcPI)) {
+        if (bSuccess) {
+            CloseHandle(stcPI.hProcess);
+            CloseHandle(stcPI.hThread);
+        }
+        CloseHandle(hStdinWrite);
+        CloseHandle(hStdoutRead);
+        CloseHandle(hJob);
+        strError = "无法启动PowerShell宿主进程";
+        return nullptr;
+    }
+
+    CloseHandle(stcPI.hThread);
+    return std::make_unique<Win32ChildProcess>(hJob, stcPI.hProcess, hStdinWrite, hStdoutRead);
+}
+
+/********************************************************************************
+* 函数实现：从管道读取数据
+*********************************************************************************/
+std::string Win32ProcessBackend::ReadFromPipe(HANDLE hPipe, uint64_t& ui64FirstByteTime) {
+    // 1. 初始化结果字符串和缓冲区
+    std::string strResult;
+    char szBuffer[4096] = {0};
+    DWORD dwBytesRead = 0;
+
+    // 2. 循环读取管道数据直到管道关闭
+    while (true) {
+        // 2.1 从管道读取数据
+        BOOL bSuccess = ReadFile(hPipe, szBuffer, sizeof(szBuffer) - 1, &dwBytesRead, nullptr);
+
+        // 2.2 检查读取是否成功或已到达数据末尾
+        if (!bSuccess || dwBytesRead == 0) {
+            break;
+        }
+
+        // 2.3 添加空终止符并追加到结果
+        if (ui64FirstByteTime == 0) ui64FirstByteTime = ExecutorTrace::NowUs();
+        szBuffer[dwBytesRead] = '\0';
+        strResult += szBuffer;
+    }
+
+    return strResult;
+}
+#else
+/********************************************************************************
+* 函数名称：结束进程组（内部辅助函数）
+* 函数功能：向以pid为组长的整个进程组发送SIGKILL（相当于TerminateJobObject）
+*********************************************************************************/
+static void KillGroup(pid_t pid) {
+    if (pid > 0) {
+        kill(-pid, SIGKILL);
+    }
+}
+
+/********************************************************************************
+* 函数名称：转换等待状态（内部辅助函数）
+* 返回类型：int
+*    正常退出时为退出码，被信号结束时为128+信号编号（与shell相同）
+*********************************************************************************/
+static int ExitCodeFromStatus(int nStatus) {
+    if (WIFEXITED(nStatus)) {
+        return WEXITSTATUS(nStatus);
+    }
+    if (WIFSIGNALED(nStatus)) {
+        return 128 + WTERMSIG(nStatus);
+    }
+    return -1;
+}
+
+/********************************************************************************
+* 函数名称：等待进程退出（内部辅助函数）
+* 函数参数：
+*    [IN]  pid_t pid：子进程ID
+*    [IN]  DWORD dwTimeoutMs：最长等待时间（毫秒），INFINITE表示一直等待
+*    [OUT] int& nStatus：退出时的等待状态
+* 返回类型：bool
+*    进程已退出并被回收返回true，超时返回false
+*********************************************************************************/
+static bool WaitProcess(pid_t pid, DWORD dwTimeoutMs, int& nStatus) {
+    if (dwTimeoutMs == INFINITE) {
+        while (waitpid(pid, &nStatus, 0) < 0) {
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+        return true;
+    }
+    ULONGLONG ui64Deadline = GetTickCount64() + dwTimeoutMs;
+    while (true) {
+        pid_t nResult = waitpid(pid, &nStatus, WNOHANG);
+        if (nResult == pid || (nResult < 0 && errno != EINTR)) {
+            return nResult == pid;
+        }
+        if (GetTickCount64() >= ui64Deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+/********************************************************************************
+* 函数名称：在新进程组中启动命令（内部辅助函数）
+* 函数功能：fork后子进程成为新进程组的组长，重定向标准句柄并执行/bin/sh -c
+* 函数参数：
+*    [IN]  const std::string& strCmdLine：完整的命令行字符串
+*    [IN]  int nStdin：子进程的标准输入（-1表示/dev/null）
+*    [IN]  int nStdout：子进程的标准输出
+*    [IN]  int nStderr：子进程的标准错误
+* 返回类型：pid_t
+*    子进程ID，失败返回-1
+* 注意事项：
+*    - 所有管道都以O_CLOEXEC创建，其他线程同时启动的进程不会继承它们
+*********************************************************************************/
+static pid_t StartProcessGroup(const std::string& strCmdLine, int nStdin, int nStdout, int nStderr) {
+    int nNull = -1;
+    if (nStdin < 0) {
+        nNull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        nStdin = nNull;
+    }
+    const char* pszCmdLine = strCmdLine.c_str();
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // 子进程：只调用异步信号安全的函数
+        setpgid(0, 0);
+        signal(SIGPIPE, SIG_DFL);
+        dup2(nStdin, STDIN_FILENO);
+        dup2(nStdout, STDOUT_FILENO);
+        dup2(nStderr, STDERR_FILENO);
+        execl("/bin/sh", "sh", "-c", pszCmdLine, static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    if (pid > 0) {
+        // 父进程也设置一次，保证返回时进程组已经存在（子进程已exec时会失败，可忽略）
+        setpgid(pid, pid);
+    }
+    if (nNull >= 0) {
+        close(nNull);
+    }
+    return pid;
+}
+
+/********************************************************************************
+* 函数名称：写入管道（内部辅助函数）
+* 函数功能：写入数据；读取端已关闭时返回错误而不是让进程收到SIGPIPE
+* 返回类型：ssize_t
+*    写入的字节数，失败返回-1
+*********************************************************************************/
+static ssize_t WriteWithoutSigPipe(int nFd, const char* pData, size_t nSize) {
+    // 只在本线程屏蔽SIGPIPE，不修改进程全局的信号处理方式
+    sigset_t stcPipe, stcOld;
+    sigemptyset(&stcPipe);
+    sigaddset(&stcPipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &stcPipe, &stcOld);
+
+    ssize_t nWritten;
+    do {
+        nWritten = write(nFd, pData, nSize);
+    } while (nWritten < 0 && errno == EINTR);
+
+    // 读取端关闭时产生的SIGPIPE挂起在本线程上（部分写入后读取端关闭时也会产生），
+    // 恢复屏蔽字之前取走
+    int nSavedErrno = errno;
+    sigset_t stcPending;
+    if (!sigismember(&stcOld, SIGPIPE) && sigpending(&stcPending) == 0 && sigismember(&stcPending, SIGPIPE)) {
+        struct timespec stcZero = { 0, 0 };
+        sigtimedwait(&stcPipe, nullptr, &stcZero);
+    }
+    pthread_sigmask(SIG_SETMASK, &stcOld, nullptr);
+    errno = nSavedErrno;
+    return nWritten;
+}
+
+/********************************************************************************
+* 函数名称：读取进程输出直到结束（内部辅助函数）
+* 函数功能：在调用线程上用poll同时读取stdout和stderr，直到两个管道都关闭
+* 函数参数：
+*    [IN]  pid_t pid：子进程ID（同时是进程组ID）
+*    [IN]  int nStdout：标准输出读取端
+*    [IN]  int nStderr：标准错误读取端
+*    [IN]  DWORD dwTimeoutMs：截止时间（毫秒）
+*    [IN]  fnStdout / fnStderr：收到数据时的回调
+*    [OUT] bool& bTimedOut：是否因截止时间到达而结束了进程组
+* 返回类型：int
+*    进程的退出码
+* 注意事项：
+*    - 截止时间到达时结束整个进程组
+*    - 主进程退出后残留进程仍持有管道时，宽限期后结束进程组并停止读取
+*********************************************************************************/
+static int PumpProcess(pid_t pid, int nStdout, int nStderr, DWORD dwTimeoutMs,
+                       const std::function<void(const char*, size_t)>& fnStdout,
+                       const std::function<void(const char*, size_t)>& fnStderr,
+                       bool& bTimedOut) {
+    ULONGLONG ui64Deadline = (dwTimeoutMs == INFINITE) ? 0 : GetTickCount64() + dwTimeoutMs;
+    ULONGLONG ui64DrainDeadline = 0;   // 进程退出或被结束后等待管道关闭的时限
+    bool bExited = false;
+    bool bKilled = false;
+    int nStatus = 0;
+    bTimedOut = false;
+
+    struct pollfd arrFds[2] = { { nStdout, POLLIN, 0 }, { nStderr, POLLIN, 0 } };
+    const std::function<void(const char*, size_t)>* arrSinks[2] = { &fnStdout, &fnStderr };
+    char szBuffer[4096];
+
+    while (arrFds[0].fd >= 0 || arrFds[1].fd >= 0) {
+        // 1. 截止时间到达：结束整个进程组
+        ULONGLONG ui64Now = GetTickCount64();
+        if (!bKilled && ui64Deadline != 0 && ui64Now >= ui64Deadline) {
+            bTimedOut = true;
+            bKilled = true;
+            KillGroup(pid);
+            if (ui64DrainDeadline == 0) {
+                ui64DrainDeadline = ui64Now + READER_GRACE_MS;
+            }
+        }
+
+        // 2. 宽限期已到仍有管道未关闭：结束残留进程，不再读取
+        if (ui64DrainDeadline != 0 && ui64Now >= ui64DrainDeadline) {
+            KillGroup(pid);
+            break;
+        }
+
+        // 3. 等待数据；进程退出前按EXIT_POLL_MS轮询退出状态
+        ULONGLONG ui64Wait = bExited ? ui64DrainDeadline - ui64Now : EXIT_POLL_MS;
+        if (!bKilled && ui64Deadline != 0 && ui64Deadline - ui64Now < ui64Wait) {
+            ui64Wait = ui64Deadline - ui64Now;
+        }
+        int nReady = poll(arrFds, 2, static_cast<int>(ui64Wait));
+        if (nReady < 0 && errno != EINTR) {
+            KillGroup(pid);
+            break;
+        }
+
+        // 4. 读取可用数据，读到EOF的管道不再等待
+        for (int i = 0; i < 2 && nReady > 0; i++) {
+            if (arrFds[i].fd < 0 || (arrFds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+                continue;
+            }
+            ssize_t nRead = read(arrFds[i].fd, szBuffer, sizeof(szBuffer));
+            if (nRead > 0) {
+                (*arrSinks[i])(szBuffer, static_cast<size_t>(nRead));
+            } else if (nRead == 0 || errno != EINTR) {
+                arrFds[i].fd = -1;
+            }
+        }
+
+        // 5. 检查主进程是否已退出
+        if (!bExited && waitpid(pid, &nStatus, WNOHANG) == pid) {
+            bExited = true;
+            if (ui64DrainDeadline == 0) {
+                ui64DrainDeadline = GetTickCount64() + READER_GRACE_MS;
+            }
+        }
+    }
+
+    // 6. 回收主进程（管道已关闭但进程尚未退出时最多等待宽限期）
+    if (!bExited && !WaitProcess(pid, READER_GRACE_MS, nStatus)) {
+        KillGroup(pid);
+        WaitProcess(pid, INFINITE, nStatus);
+    }
+    return ExitCodeFromStatus(nStatus);
+}
+
+/********************************************************************************
+* 类名称：POSIX交互式子进程（内部实现）
+* 类功能：持有子进程（进程组组长）和stdin/stdout管道，提供按行读取
+*********************************************************************************/
+class PosixChildProcess : public ChildProcess {
+public:
+    PosixChildProcess(pid_t pid, int nStdinWrite, int nStdoutRead)
+        : m_pid(pid), m_nStdinWrite(nStdinWrite), m_nStdoutRead(nStdoutRead) {
+    }
+
+    ~PosixChildProcess() override {
+        // 1. 关闭stdin，宿主进程读到EOF后会自行退出
+        if (m_nStdinWrite >= 0) {
+            close(m_nStdinWrite);
+            m_nStdinWrite = -1;
+        }
+
+        // 2. 给子进程短暂的退出时间，超时则由Terminate结束进程组
+        if (!m_bReaped && m_pid > 0 && WaitProcess(m_pid, 500, m_nStatus)) {
+            m_bReaped = true;
+        }
+
+        Terminate();
+    }
+
+    bool WriteInput(const std::string& strData) override {
+        if (m_nStdinWrite < 0) return false;
+
+        // 循环写入直到全部数据写完（进程组被结束后读取端关闭，写入随之失败）
+        size_t nOffset = 0;
+        while (nOffset < strData.size()) {
+            ssize_t nWritten = WriteWithoutSigPipe(m_nStdinWrite, strData.data() + nOffset,
+                                                   strData.size() - nOffset);
+            if (nWritten <= 0) {
+                return false;
+            }
+            nOffset += static_cast<size_t>(nWritten);
+        }
+        return true;
+    }
+
+    bool ReadOutputLine(std::string& strLine) override {
+        while (true) {
+            // 1. 缓冲区中已有完整的一行，直接返回
+            size_t nNewLine = m_strPending.find('\n');
+            if (nNewLine != std::string::npos) {
+                strLine.assign(m_strPending, 0, nNewLine);
+                m_strPending.erase(0, nNewLine + 1);
+                if (!strLine.empty() && strLine.back() == '\r') {
+                    strLine.pop_back();
+                }
+                return true;
+            }
+
+            // 2. 继续从管道读取（超时后进程组被结束，读取随之返回EOF）
+            if (m_nStdoutRead < 0) return false;
+            char szBuffer[4096];
+            ssize_t nRead = read(m_nStdoutRead, szBuffer, sizeof(szBuffer));
+            if (nRead < 0 && errno == EINTR) {
+                continue;
+            }
+            if (nRead <= 0) {
+                return false;
+            }
+            m_strPending.append(szBuffer, static_cast<size_t>(nRead));
+        }
+    }
+
+    bool IsAlive() override {
+        if (m_bReaped || m_pid <= 0) {
+            return false;
+        }
+        if (waitpid(m_pid, &m_nStatus, WNOHANG) == m_pid) {
+            m_bReaped = true;
+            return false;
+        }
+        return true;
+    }
+
+    void Terminate() override {
+        m_bExpired = DeadlineExpired();
+        m_pWatchdog.reset();
+        if (m_pid > 0) {
+            // 结束宿主及其启动的所有进程（同一进程组）
+            KillGroup(m_pid);
+            if (!m_bReaped) {
+                WaitProcess(m_pid, INFINITE, m_nStatus);
+                m_bReaped = true;
+            }
+            m_pid = -1;
+        }
+        if (m_nStdinWrite >= 0) {
+            close(m_nStdinWrite);
+            m_nStdinWrite = -1;
+        }
+        if (m_nStdoutRead >= 0) {
+            close(m_nStdoutRead);
+            m_nStdoutRead = -1;
+        }
+    }
+
+    void SetDeadline(DWORD dwTimeoutMs) override {
+        // 先取消旧的截止时间，再按需设置新的
+        m_bExpired = m_bExpired || (m_pWatchdog && m_pWatchdog->Expired());
+        m_pWatchdog.reset();
+        if (dwTimeoutMs == INFINITE || m_pid <= 0) {
+            return;
+        }
+        m_bExpired = false;
+        pid_t pid = m_pid;
+        m_pWatchdog = std::make_unique<Watchdog>(dwTimeoutMs, [pid]() {
+            KillGroup(pid);
+        });
+    }
+
+    bool DeadlineExpired() override {
+        return m_bExpired || (m_pWatchdog && m_pWatchdog->Expired());
+    }
+
+private:
+    pid_t                     m_pid;                // 子进程ID（进程组ID）
+    int                       m_nStdinWrite;        // stdin写入端
+    int                       m_nStdoutRead;        // stdout读取端（含合并的stderr）
+    int                       m_nStatus = 0;        // 退出时的等待状态
+    bool                      m_bReaped = false;    // 是否已回收
+    std::string               m_strPending;         // 尚未组成完整行的数据
+    std::unique_ptr<Watchdog> m_pWatchdog;          // 当前截止时间的看门狗
+    bool                      m_bExpired = false;   // 最近一次截止时间是否已触发
+};
+
+// epoll上用于唤醒完成循环的数据值（提交新命令、取消、停止）
+static const uint64_t WAKE_KEY = 0;
+// 单次读取的缓冲区大小
+static const size_t ASYNC_READ_SIZE = 4096;
+// epoll数据值的低两位区分同一命令的文件描述符
+static const uint64_t SLOT_STDOUT = 0;
+static const uint64_t SLOT_STDERR = 1;
+static const uint64_t SLOT_PIDFD = 2;
+
+/********************************************************************************
+* 函数名称：打开进程描述符（内部辅助函数）
+* 返回类型：int
+*    进程退出时变为可读的pidfd；内核不支持时返回-1，由完成循环轮询退出状态
+*********************************************************************************/
+static int OpenPidFd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    int nFd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (nFd >= 0) {
+        fcntl(nFd, F_SETFD, FD_CLOEXEC);
+    }
+    return nFd;
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+/********************************************************************************
+* 结构体名称：异步管道（内部实现）
+*********************************************************************************/
+struct AsyncPipe {
+    int         nFd = -1;        // 读取端（非阻塞）
+    bool        bOpen = false;   // 是否仍在读取
+    std::string strData;         // 已读取的数据
+};
+
+/********************************************************************************
+* 结构体名称：异步命令（内部实现）
+* 结构体功能：一条进行中的异步命令的全部状态，只由完成循环线程访问
+*********************************************************************************/
+struct AsyncOperation {
+    uint64_t          nKey = 0;               // 命令编号（epoll数据值的高位）
+    pid_t             pid = -1;               // 子进程ID（进程组ID）
+    int               nPidFd = -1;            // 进程描述符（-1表示轮询退出状态）
+    AsyncPipe         stcStdout;              // 标准输出
+    AsyncPipe         stcStderr;              // 错误输出
+    uint64_t          ui64StartUs = 0;        // 开始时刻（ExecutorTrace::NowUs）
+    ULONGLONG         ui64Deadline = 0;       // 截止时刻（GetTickCount64，0表示不限）
+    ULONGLONG         ui64DrainDeadline = 0;  // 进程退出后等待管道关闭的时限（0表示未开始）
+    bool              bExited = false;        // 主进程是否已被回收
+    int               nStatus = 0;            // 主进程的等待状态
+    bool              bKilled = false;        // 是否已结束进程组
+    CancellationToken objCancel;              // 取消令牌
+    size_t            nCancelId = 0;          // 取消回调的注册编号
+    CommandResult     stcResult;              // 命令结果
+    CompletionHandler fnComplete;             // 完成回调
+};
+
+/********************************************************************************
+* 类名称：epoll完成循环（内部实现）
+* 类功能：一个线程通过epoll同时处理所有异步命令的读取、退出、超时和取消，
+*         结构与Win32的I/O完成循环相同：管道可读和pidfd可读代替重叠读取完成
+*         和作业对象通知，eventfd代替投递到完成端口的唤醒
+*********************************************************************************/
+class CompletionLoop {
+public:
+    CompletionLoop() : m_nEpoll(-1), m_nWake(-1), m_bStopping(false), m_nNextKey(1) {}
+
+    ~CompletionLoop() {
+        if (m_objThread.joinable()) {
+            // 取消所有进行中的命令，等待它们的回调执行完毕后再关闭描述符
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                m_bStopping = true;
+            }
+            Wake(m_nWake);
+            m_objThread.join();
+        }
+        if (m_nWake >= 0) close(m_nWake);
+        if (m_nEpoll >= 0) close(m_nEpoll);
+    }
+
+    bool Start() {
+        m_nEpoll = epoll_create1(EPOLL_CLOEXEC);
+        m_nWake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (m_nEpoll < 0 || m_nWake < 0) {
+            return false;
+        }
+        struct epoll_event stcEvent = {};
+        stcEvent.events = EPOLLIN;
+        stcEvent.data.u64 = WAKE_KEY;
+        if (epoll_ctl(m_nEpoll, EPOLL_CTL_ADD, m_nWake, &stcEvent) != 0) {
+            return false;
+        }
+        m_objThread = std::thread([this]() { Loop(); });
+        return true;
+    }
+
+    void Submit(std::unique_ptr<AsyncOperation> pOp) {
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            pOp->nKey = m_nNextKey++;
+            m_vecSubmitted.push_back(std::move(pOp));
+        }
+        Wake(m_nWake);
+    }
+
+private:
+    int                                                  m_nEpoll;        // epoll实例
+    int                                                  m_nWake;         // 唤醒用的eventfd
+    std::thread                                          m_objThread;     // 完成循环线程
+    std::mutex                                           m_mtx;           // 保护提交队列
+    bool                                                 m_bStopping;     // 是否正在停止
+    uint64_t                                             m_nNextKey;      // 下一个命令编号
+    std::vector<std::unique_ptr<AsyncOperation>>         m_vecSubmitted;  // 待接管的命令
+    std::map<uint64_t, std::unique_ptr<AsyncOperation>>  m_mapOps;        // 进行中的命令（仅循环线程访问）
+
+    static void Wake(int nWake) {
+        uint64_t ui64One = 1;
+        ssize_t nWritten = write(nWake, &ui64One, sizeof(ui64One));
+        (void)nWritten;
+    }
+
+    /********************************************************************************
+    * 函数名称：完成循环主体
+    *********************************************************************************/
+    void Loop() {
+        struct epoll_event arrEvents[16];
+        while (true) {
+            // 1. 接管新提交的命令
+            bool bStopping = false;
+            std::vector<std::unique_ptr<AsyncOperation>> vecSubmitted;
+            {
+                std::lock_guard<std::mutex> lock(m_mtx);
+                bStopping = m_bStopping;
+                vecSubmitted.swap(m_vecSubmitted);
+            }
+            for (auto& pOp : vecSubmitted) {
+                Adopt(std::move(pOp));
+            }
+
+            // 2. 处理取消、超时和已结束的命令
+            Sweep(bStopping);
+            if (bStopping && m_mapOps.empty()) {
+                break;
+            }
+
+            // 3. 等待下一批事件（或最近的截止时间）
+            int nCount = epoll_wait(m_nEpoll, arrEvents, 16, NextWaitMs());
+            for (int i = 0; i < nCount; ++i) {
+                Dispatch(arrEvents[i].data.u64);
+            }
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：注册文件描述符
+    *********************************************************************************/
+    bool Watch(int nFd, uint64_t nKey, uint64_t nSlot) {
+        struct epoll_event stcEvent = {};
+        stcEvent.events = EPOLLIN;
+        stcEvent.data.u64 = (nKey << 2) | nSlot;
+        return epoll_ctl(m_nEpoll, EPOLL_CTL_ADD, nFd, &stcEvent) == 0;
+    }
+
+    /********************************************************************************
+    * 函数名称：接管命令
+    * 函数功能：将管道和进程描述符注册到epoll，注册取消回调
+    *********************************************************************************/
+    void Adopt(std::unique_ptr<AsyncOperation> pOp) {
+        AsyncOperation& stcOp = *pOp;
+
+        // 1. 管道改为非阻塞，管道可读和进程退出都使用命令编号
+        fcntl(stcOp.stcStdout.nFd, F_SETFL, fcntl(stcOp.stcStdout.nFd, F_GETFL) | O_NONBLOCK);
+        fcntl(stcOp.stcStderr.nFd, F_SETFL, fcntl(stcOp.stcStderr.nFd, F_GETFL) | O_NONBLOCK);
+        bool bWatched = Watch(stcOp.stcStdout.nFd, stcOp.nKey, SLOT_STDOUT) &&
+                        Watch(stcOp.stcStderr.nFd, stcOp.nKey, SLOT_STDERR);
+        stcOp.stcStdout.bOpen = true;
+        stcOp.stcStderr.bOpen = true;
+        stcOp.nPidFd = OpenPidFd(stcOp.pid);
+        if (stcOp.nPidFd >= 0 && !Watch(stcOp.nPidFd, stcOp.nKey, SLOT_PIDFD)) {
+            close(stcOp.nPidFd);
+            stcOp.nPidFd = -1;
+        }
+
+        // 2. 取消时唤醒完成循环
+        int nWake = m_nWake;
+        stcOp.nCancelId = stcOp.objCancel.Register([nWake]() {
+            Wake(nWake);
+        });
+
+        // 3. 无法注册到epoll时直接结束进程组，按失败返回
+        if (!bWatched) {
+            stcOp.stcResult.strError = "无法注册到epoll";
+            Kill(stcOp);
+            ClosePipe(stcOp.stcStdout);
+            ClosePipe(stcOp.stcStderr);
+        }
+        m_mapOps.emplace(stcOp.nKey, std::move(pOp));
+    }
+
+    /********************************************************************************
+    * 函数名称：停止读取管道
+    *********************************************************************************/
+    void ClosePipe(AsyncPipe& stcPipe) {
+        if (stcPipe.bOpen) {
+            epoll_ctl(m_nEpoll, EPOLL_CTL_DEL, stcPipe.nFd, nullptr);
+            stcPipe.bOpen = false;
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：读取管道中的可用数据
+    *********************************************************************************/
+    void OnReadable(AsyncPipe& stcPipe) {
+        char szBuffer[ASYNC_READ_SIZE];
+        while (stcPipe.bOpen) {
+            ssize_t nRead = read(stcPipe.nFd, szBuffer, sizeof(szBuffer));
+            if (nRead > 0) {
+                stcPipe.strData.append(szBuffer, static_cast<size_t>(nRead));
+            } else if (nRead < 0 && errno == EINTR) {
+                continue;
+            } else {
+                // 写入端全部关闭（nRead == 0）时停止读取；EAGAIN表示暂无数据
+                if (nRead == 0 || errno != EAGAIN) {
+                    ClosePipe(stcPipe);
+                }
+                return;
+            }
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：分发事件
+    *********************************************************************************/
+    void Dispatch(uint64_t ui64Data) {
+        if (ui64Data == WAKE_KEY) {
+            uint64_t ui64Count = 0;
+            ssize_t nRead = read(m_nWake, &ui64Count, sizeof(ui64Count));
+            (void)nRead;
+            return;
+        }
+        auto it = m_mapOps.find(ui64Data >> 2);
+        if (it == m_mapOps.end()) {
+            return;
+        }
+        AsyncOperation& stcOp = *it->second;
+
+        switch (ui64Data & 3) {
+        case SLOT_STDOUT:
+            OnReadable(stcOp.stcStdout);
+            if (stcOp.stcResult.ui64FirstByteUs == 0 && !stcOp.stcStdout.strData.empty()) {
+                stcOp.stcResult.ui64FirstByteUs = ExecutorTrace::NowUs() - stcOp.ui64StartUs;
+            }
+            break;
+        case SLOT_STDERR:
+            OnReadable(stcOp.stcStderr);
+            break;
+        default:
+            // 进程描述符可读：主进程已退出；无法回收时改为轮询，避免描述符一直可读
+            Reap(stcOp);
+            if (!stcOp.bExited && stcOp.nPidFd >= 0) {
+                close(stcOp.nPidFd);
+                stcOp.nPidFd = -1;
+            }
+            break;
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：回收已退出的主进程
+    * 函数功能：主进程已退出时记录等待状态，残留进程持有管道时最多再等待宽限期
+    *********************************************************************************/
+    void Reap(AsyncOperation& stcOp) {
+        if (stcOp.bExited || waitpid(stcOp.pid, &stcOp.nStatus, WNOHANG) != stcOp.pid) {
+            return;
+        }
+        stcOp.bExited = true;
+        // 已退出进程的描述符一直可读，回收后不再监听
+        if (stcOp.nPidFd >= 0) {
+            epoll_ctl(m_nEpoll, EPOLL_CTL_DEL, stcOp.nPidFd, nullptr);
+        }
+        if (stcOp.ui64DrainDeadline == 0) {
+            stcOp.ui64DrainDeadline = GetTickCount64() + READER_GRACE_MS;
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：结束命令的进程组
+    *********************************************************************************/
+    static void Kill(AsyncOperation& stcOp) {
+        if (stcOp.bKilled) {
+            return;
+        }
+        KillGroup(stcOp.pid);
+        stcOp.bKilled = true;
+        if (stcOp.ui64DrainDeadline == 0) {
+            stcOp.ui64DrainDeadline = GetTickCount64() + READER_GRACE_MS;
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：检查所有命令
+    * 函数功能：处理取消、超时、宽限期到达，并完成已结束的命令
+    *********************************************************************************/
+    void Sweep(bool bStopping) {
+        ULONGLONG ui64Now = GetTickCount64();
+        std::vector<std::unique_ptr<AsyncOperation>> vecFinished;
+
+        for (auto it = m_mapOps.begin(); it != m_mapOps.end();) {
+            AsyncOperation& stcOp = *it->second;
+
+            // 1. 取消（包括后端析构）和超时：结束进程组
+            if (!stcOp.bKilled && (bStopping || stcOp.objCancel.IsCancelled())) {
+                stcOp.stcResult.bCancelled = true;
+                Kill(stcOp);
+            } else if (!stcOp.bKilled && stcOp.ui64Deadline != 0 && ui64Now >= stcOp.ui64Deadline) {
+                stcOp.stcResult.bTimedOut = true;
+                Kill(stcOp);
+            }
+
+            // 2. 轮询退出状态（没有进程描述符时只能在这里发现进程退出）
+            Reap(stcOp);
+            if (!stcOp.bExited && !stcOp.stcStdout.bOpen && !stcOp.stcStderr.bOpen &&
+                stcOp.ui64DrainDeadline == 0) {
+                // 管道已关闭但主进程仍在运行：与同步执行相同，最多等待宽限期
+                stcOp.ui64DrainDeadline = ui64Now + READER_GRACE_MS;
+            }
+
+            // 3. 宽限期已到仍未结束：结束残留进程，不再读取
+            if (stcOp.ui64DrainDeadline != 0 && ui64Now >= stcOp.ui64DrainDeadline &&
+                (stcOp.stcStdout.bOpen || stcOp.stcStderr.bOpen || !stcOp.bExited)) {
+                KillGroup(stcOp.pid);
+                ClosePipe(stcOp.stcStdout);
+                ClosePipe(stcOp.stcStderr);
+                stcOp.ui64DrainDeadline = ui64Now + EXIT_POLL_MS;
+            }
+
+            // 4. 两个管道都已关闭且主进程已回收：命令完成
+            if (!stcOp.stcStdout.bOpen && !stcOp.stcStderr.bOpen && stcOp.bExited) {
+                vecFinished.push_back(std::move(it->second));
+                it = m_mapOps.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // 5. 在遍历结束后执行回调（回调中可以提交新命令）
+        for (auto& pOp : vecFinished) {
+            Finish(*pOp);
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：计算下一次等待时间
+    * 返回类型：int
+    *    到最近的截止时间或宽限期的毫秒数，没有则为-1（一直等待）
+    *********************************************************************************/
+    int NextWaitMs() const {
+        ULONGLONG ui64Now = GetTickCount64();
+        DWORD dwWait = INFINITE;
+        for (const auto& objEntry : m_mapOps) {
+            const AsyncOperation& stcOp = *objEntry.second;
+            ULONGLONG arrTimes[2] = { stcOp.bKilled ? 0 : stcOp.ui64Deadline, stcOp.ui64DrainDeadline };
+            for (ULONGLONG ui64Time : arrTimes) {
+                if (ui64Time == 0) continue;
+                DWORD dwRemain = (ui64Time > ui64Now) ? static_cast<DWORD>(ui64Time - ui64Now) : 0;
+                dwWait = (dwRemain < dwWait) ? dwRemain : dwWait;
+            }
+            // 没有进程描述符、或已被结束等待回收：轮询进程状态
+            if (!stcOp.bExited && (stcOp.nPidFd < 0 || stcOp.bKilled)) {
+                dwWait = (EXIT_POLL_MS < dwWait) ? EXIT_POLL_MS : dwWait;
+            }
+        }
+        return (dwWait == INFINITE) ? -1 : static_cast<int>(dwWait);
+    }
+
+    /********************************************************************************
+    * 函数名称：完成命令
+    * 函数功能：填充结果、关闭描述符并执行完成回调
+    *********************************************************************************/
+    static void Finish(AsyncOperation& stcOp) {
+        stcOp.objCancel.Unregister(stcOp.nCancelId);
+
+        close(stcOp.stcStdout.nFd);
+        close(stcOp.stcStderr.nFd);
+        if (stcOp.nPidFd >= 0) {
+            close(stcOp.nPidFd);
+        }
+
+        CommandResult& stcResult = stcOp.stcResult;
+        if (stcResult.bTimedOut) {
+            stcResult.nExitCode = static_cast<int>(ERROR_TIMEOUT);
+        } else if (stcResult.bCancelled) {
+            stcResult.nExitCode = static_cast<int>(ERROR_CANCELLED);
+        } else {
+            stcResult.nExitCode = ExitCodeFromStatus(stcOp.nStatus);
+        }
+        stcResult.strOutput = std::move(stcOp.stcStdout.strData);
+        stcResult.strError += stcOp.stcStderr.strData;
+        stcOp.fnComplete(stcResult);
+    }
+};
+
+/********************************************************************************
+* 函数实现：POSIX进程后端构造函数/析构函数
+*********************************************************************************/
+PosixProcessBackend::PosixProcessBackend() {
+}
+
+PosixProcessBackend::~PosixProcessBackend() {
+    // 完成循环析构时取消所有进行中的异步命令
+}
+
+/********************************************************************************
+* 函数实现：创建重定向的子进程
+*********************************************************************************/
+bool PosixProcessBackend::CreateRedirectedProcess(const std::string& strCmdLine,
+                                                  pid_t& pid,
+                                                  int& nStdoutRead,
+                                                  int& nStderrRead,
+                                                  std::string& strError) {
+    // 1. 创建标准输出和标准错误管道
+    int arrStdout[2], arrStderr[2];
+    if (pipe2(arrStdout, O_CLOEXEC) != 0) {
+        strError = "无法创建输出管道";
+        return false;
+    }
+    if (pipe2(arrStderr, O_CLOEXEC) != 0) {
+        close(arrStdout[0]);
+        close(arrStdout[1]);
+        strError = "无法创建错误管道";
+        return false;
+    }
+
+    // 2. 在新进程组中启动，父进程不需要写入端
+    pid = StartProcessGroup(strCmdLine, -1, arrStdout[1], arrStderr[1]);
+    close(arrStdout[1]);
+    close(arrStderr[1]);
+    if (pid < 0) {
+        close(arrStdout[0]);
+        close(arrStderr[0]);
+        strError = "无法启动进程";
+        return false;
+    }
+
+    nStdoutRead = arrStdout[0];
+    nStderrRead = arrStderr[0];
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：运行命令行
+*********************************************************************************/
+bool PosixProcessBackend::Run(const std::string& strCmdLine, DWORD dwTimeoutMs, CommandResult& stcResult) {
+    // 1. 创建进程和输出管道
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    pid_t pid = -1;
+    int nStdoutRead = -1;
+    int nStderrRead = -1;
+    if (!CreateRedirectedProcess(strCmdLine, pid, nStdoutRead, nStderrRead, stcResult.strError)) {
+        return false;
+    }
+    stcResult.ui64SpawnUs = ExecutorTrace::NowUs() - ui64StartUs;
+
+    // 2. 同时读取输出和错误，直到进程结束或截止时间到达
+    std::string strRawOutput, strRawError;
+    bool bTimedOut = false;
+    int nExitCode = PumpProcess(pid, nStdoutRead, nStderrRead, dwTimeoutMs,
+        [&](const char* pData, size_t nSize) {
+            if (stcResult.ui64FirstByteUs == 0) {
+                stcResult.ui64FirstByteUs = ExecutorTrace::NowUs() - ui64StartUs;
+            }
+            strRawOutput.append(pData, nSize);
+        },
+        [&](const char* pData, size_t nSize) {
+            strRawError.append(pData, nSize);
+        },
+        bTimedOut);
+
+    // 3. 清理管道
+    close(nStdoutRead);
+    close(nStderrRead);
+
+    // 4. 返回原始数据
+    stcResult.bTimedOut = bTimedOut;
+    stcResult.nExitCode = bTimedOut ? static_cast<int>(ERROR_TIMEOUT) : nExitCode;
+    stcResult.strOutput = std::move(strRawOutput);
+    stcResult.strError = std::move(strRawError);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：流式运行命令行
+*********************************************************************************/
+bool PosixProcessBackend::RunStreaming(const std::string& strCmdLine,
+                                       DWORD dwTimeoutMs,
+                                       const LineSink& fnSink,
+                                       CommandResult& stcResult) {
+    // 1. 创建进程和输出管道
+    uint64_t ui64StartUs = ExecutorTrace::NowUs();
+    pid_t pid = -1;
+    int nStdoutRead = -1;
+    int nStderrRead = -1;
+    if (!CreateRedirectedProcess(strCmdLine, pid, nStdoutRead, nStderrRead, stcResult.strError)) {
+        return false;
+    }
+    stcResult.ui64SpawnUs = ExecutorTrace::NowUs() - ui64StartUs;
+
+    // 2. 标准输出在池化缓冲区中组装成行，每形成完整的一行就推送给回调
+    PooledBuffer objBuffer;
+    char* pBuffer = objBuffer.Data();
+    size_t nUsed = 0;
+    auto fnStdout = [&](const char* pData, size_t nSize) {
+        if (stcResult.ui64FirstByteUs == 0) {
+            stcResult.ui64FirstByteUs = ExecutorTrace::NowUs() - ui64StartUs;
+        }
+        while (nSize > 0) {
+            // 2.1 缓冲区已满仍没有换行：将已有内容作为一行推送（限制单行内存）
+            if (nUsed == PooledBuffer::Size()) {
+                fnSink(std::string_view(pBuffer, nUsed));
+                nUsed = 0;
+            }
+            size_t nCopy = (nSize < PooledBuffer::Size() - nUsed) ? nSize : PooledBuffer::Size() - nUsed;
+            memcpy(pBuffer + nUsed, pData, nCopy);
+            nUsed += nCopy;
+            pData += nCopy;
+            nSize -= nCopy;
+
+            // 2.2 推送所有完整的行，未完成的行移到缓冲区开头
+            std::string_view svBuffered(pBuffer, nUsed);
+            size_t nLastNewLine = svBuffered.rfind('\n');
+            if (nLastNewLine == std::string_view::npos) {
+                continue;
+            }
+            std::string_view svComplete = svBuffered.substr(0, nLastNewLine + 1);
+            std::string_view svLine;
+            while (Utils::NextLine(svComplete, svLine)) {
+                fnSink(svLine);
+            }
+            nUsed -= nLastNewLine + 1;
+            memmove(pBuffer, pBuffer + nLastNewLine + 1, nUsed);
+        }
+    };
+
+    // 3. 错误输出只保留前MAX_STREAMING_STDERR字节
+    std::string strRawError;
+    auto fnStderr = [&](const char* pData, size_t nSize) {
+        if (strRawError.size() < MAX_STREAMING_STDERR) {
+            size_t nRoom = MAX_STREAMING_STDERR - strRawError.size();
+            strRawError.append(pData, nSize < nRoom ? nSize : nRoom);
+        }
+    };
+
+    bool bTimedOut = false;
+    int nExitCode = PumpProcess(pid, nStdoutRead, nStderrRead, dwTimeoutMs, fnStdout, fnStderr, bTimedOut);
+
+    // 4. 最后一行没有换行符
+    std::string_view svRest(pBuffer, nUsed), svLine;
+    while (Utils::NextLine(svRest, svLine)) {
+        fnSink(svLine);
+    }
+
+    close(nStdoutRead);
+    close(nStderrRead);
+
+    stcResult.bTimedOut = bTimedOut;
+    stcResult.nExitCode = bTimedOut ? static_cast<int>(ERROR_TIMEOUT) : nExitCode;
+    stcResult.strError = std::move(strRawError);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：异步运行命令行
+*********************************************************************************/
+void PosixProcessBackend::RunAsync(const std::string& strCmdLine,
+                                   DWORD dwTimeoutMs,
+                                   const CancellationToken& objCancel,
+                                   CompletionHandler fnComplete) {
+    // 1. 取得（或按需启动）完成循环；epoll不可用时同步执行
+    CompletionLoop* pLoop = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mtxLoop);
+        if (!m_pLoop) {
+            auto pNewLoop = std::make_unique<CompletionLoop>();
+            if (pNewLoop->Start()) {
+                m_pLoop = std::move(pNewLoop);
+            }
+        }
+        pLoop = m_pLoop.get();
+    }
+    if (!pLoop) {
+        ProcessBackend::RunAsync(strCmdLine, dwTimeoutMs, objCancel, std::move(fnComplete));
+        return;
+    }
+
+    // 2. 已取消的命令不再启动
+    auto pOp = std::make_unique<AsyncOperation>();
+    if (objCancel.IsCancelled()) {
+        pOp->stcResult.bCancelled = true;
+        pOp->stcResult.nExitCode = static_cast<int>(ERROR_CANCELLED);
+        fnComplete(pOp->stcResult);
+        return;
+    }
+
+    // 3. 创建进程，无法启动时立即回调
+    pOp->ui64StartUs = ExecutorTrace::NowUs();
+    if (!CreateRedirectedProcess(strCmdLine, pOp->pid, pOp->stcStdout.nFd, pOp->stcStderr.nFd,
+                                 pOp->stcResult.strError)) {
+        fnComplete(pOp->stcResult);
+        return;
+    }
+    pOp->stcResult.ui64SpawnUs = ExecutorTrace::NowUs() - pOp->ui64StartUs;
+
+    // 4. 交给完成循环（截止时间从进程启动时开始计算）
+    pOp->ui64Deadline = (dwTimeoutMs == INFINITE) ? 0 : GetTickCount64() + dwTimeoutMs;
+    pOp->objCancel = objCancel;
+    pOp->fnComplete = std::move(fnComplete);
+    pLoop->Submit(std::move(pOp));
+}
+
+/********************************************************************************
+* 函数实现：启动交互式子进程
+*********************************************************************************/
+std::unique_ptr<ChildProcess> PosixProcessBackend::Spawn(const std::string& strCmdLine, std::string& strError) {
+    // 1. 创建标准输入管道
+    int arrStdin[2], arrStdout[2];
+    if (pipe2(arrStdin, O_CLOEXEC) != 0) {
+        strError = "无法创建输入管道";
+        return nullptr;
+    }
+
+    // 2. 创建标准输出管道（错误输出合并到此管道）
+    if (pipe2(arrStdout, O_CLOEXEC) != 0) {
+        close(arrStdin[0]);
+        close(arrStdin[1]);
+        strError = "无法创建输出管道";
+        return nullptr;
+    }
+
+    // 3. 在新进程组中启动，关闭子进程使用的一端
+    pid_t pid = StartProcessGroup(strCmdLine, arrStdin[0], arrStdout[1], arrStdout[1]);
+    close(arrStdin[0]);
+    close(arrStdout[1]);
+    if (pid < 0) {
+        close(arrStdin[1]);
+        close(arrStdout[0]);
+        strError = "无法启动宿主进程";
+        return nullptr;
+    }
+
+    return std::make_unique<PosixChildProcess>(pid, arrStdin[1], arrStdout[0]);
+}
+#endif
@@ -0,0 +1,377 @@
+﻿/********************************************************************************
+* 文件名称：ProcessBackend.h
+* 文件功能：定义子进程后端接口，隔离PowerShellExecutor与具体的进程创建方式
+*
+* 类说明：
+*    ProcessBackend是一个抽象接口，负责三类进程操作：
+*    1. Run：一次性运行命令行并捕获全部标准输出/错误输出和退出码
+*    2. RunStreaming：一次性运行命令行，标准输出逐行推送给调用者
+*    3. Spawn：启动一个长期运行的交互式子进程（通过stdin写入、按行读取stdout）
+*    4. RunAsync：异步运行命令行，完成、超时或取消时通过回调返回结果
+*    Win32ProcessBackend是默认实现，基于CreateProcess和匿名管道。
+*
+* 异步执行：
+*    Win32ProcessBackend的RunAsync不为每条命令创建读取线程：所有进行中的
+*    子进程的stdout/stderr（重叠I/O命名管道）和作业对象通知都关联到同一个
+*    I/O完成端口，由一个完成循环线程统一处理读取、退出、超时和取消。
+*    PosixProcessBackend以epoll实现同样的完成循环。
+*
+* 超时与进程树：
+*    - 每个子进程都放入一个作业对象（Job Object），超时或异常退出时通过
+*      TerminateJobObject结束整个进程树，包括PowerShell启动的子进程
+*    - 作业对象设置了KILL_ON_JOB_CLOSE，命令结束时残留的子进程也会被清理
+*    - 读取线程不会被无限期等待：超时后取消其同步I/O再回收
+*
+* 设计目的：
+*    - PowerShellExecutor及其宿主进程池只依赖此接口，不直接调用Windows API
+*    - 可以替换为其他后端（例如录制/回放、替身解释器），用于调试和性能分析
+*
+* 依赖项：
+*    - Windows API（CreateProcess、管道操作，仅Win32ProcessBackend）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <string_view>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "Platform.h"
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+/********************************************************************************
+* 结构体名称：命令执行结果
+* 结构体功能：保存单条命令的退出码、标准输出和错误输出
+*
+* 成员说明：
+*    nExitCode：进程（或宿主中命令）的退出码，0表示成功，-1表示未执行，
+*               超时被终止时为ERROR_TIMEOUT，被取消时为ERROR_CANCELLED
+*    bTimedOut：是否因超过截止时间而被终止
+*    bCancelled：是否因取消令牌而被终止
+*    strOutput：标准输出内容
+*    strError：错误输出内容
+*********************************************************************************/
+struct CommandResult {
+    int         nExitCode = -1;       // 退出码
+    bool        bTimedOut = false;    // 是否超时
+    bool        bCancelled = false;   // 是否被取消
+    std::string strOutput;            // 标准输出
+    std::string strError;             // 错误输出
+    uint64_t    ui64SpawnUs = 0;      // 启动耗时（微秒，由后端或执行器填写）
+    uint64_t    ui64FirstByteUs = 0;  // 从开始到第一个标准输出字节的耗时（微秒，0表示没有输出）
+};
+
+/********************************************************************************
+* 类型名称：行输出回调
+* 类型功能：接收流式输出中的一行（不含行尾的\r\n）
+* 注意事项：
+*    - 视图只在回调期间有效，需要保留时请复制
+*********************************************************************************/
+using LineSink = std::function<void(std::string_view)>;
+
+/********************************************************************************
+* 类型名称：异步完成回调
+* 类型功能：接收异步命令的结果（可以移走其中的数据）
+*********************************************************************************/
+using CompletionHandler = std::function<void(CommandResult&)>;
+
+/********************************************************************************
+* 类名称：取消令牌
+* 类功能：在多个异步命令之间共享的取消标记；复制令牌共享同一状态
+*
+* 调用示例：
+*    CancellationToken objCancel;
+*    auto futResult = PowerShellExecutor::ExecuteAsync("Get-VM", objCancel);
+*    objCancel.Cancel();   // 结束进程树，结果的bCancelled为true
+*
+* 注意事项：
+*    - 注册的回调在持有内部锁时执行，必须简短且不能再访问同一令牌
+*********************************************************************************/
+class CancellationToken {
+public:
+    CancellationToken();
+
+    /********************************************************************************
+    * 函数名称：请求取消
+    * 函数功能：设置取消标记并执行所有已注册的回调（重复调用无效果）
+    *********************************************************************************/
+    void Cancel() const;
+
+    /********************************************************************************
+    * 函数名称：检查是否已取消
+    * 返回类型：bool
+    *********************************************************************************/
+    bool IsCancelled() const;
+
+    /********************************************************************************
+    * 函数名称：注册取消回调
+    * 函数参数：
+    *    [IN]  std::function<void()> fnCallback：取消时执行的回调
+    * 返回类型：size_t
+    *    注册编号，用于Unregister；令牌已取消时回调立即执行
+    *********************************************************************************/
+    size_t Register(std::function<void()> fnCallback) const;
+
+    /********************************************************************************
+    * 函数名称：注销取消回调
+    * 函数功能：返回后回调保证不会再被执行
+    * 函数参数：
+    *    [IN]  size_t nId：Register返回的注册编号
+    *********************************************************************************/
+    void Unregister(size_t nId) const;
+
+private:
+    struct State;
+    std::shared_ptr<State> m_pState;   // 共享的取消状态
+};
+
+/********************************************************************************
+* 类名称：交互式子进程
+* 类功能：表示一个已启动的长期运行子进程，支持写入stdin和按行读取stdout
+*********************************************************************************/
+class ChildProcess {
+public:
+    virtual ~ChildProcess() = default;
+
+    /********************************************************************************
+    * 函数名称：写入标准输入
+    * 函数功能：将数据完整写入子进程的标准输入
+    * 函数参数：
+    *    [IN]  const std::string& strData：要写入的数据
+    * 返回类型：bool
+    *    写入成功返回true，管道已断开返回false
+    *********************************************************************************/
+    virtual bool WriteInput(const std::string& strData) = 0;
+
+    /********************************************************************************
+    * 函数名称：读取一行输出
+    * 函数功能：阻塞读取子进程标准输出的下一行（不含行尾的\r\n）
+    * 函数参数：
+    *    [OUT] std::string& strLine：读取到的行
+    * 返回类型：bool
+    *    读取成功返回true，子进程退出或管道断开返回false
+    *********************************************************************************/
+    virtual bool ReadOutputLine(std::string& strLine) = 0;
+
+    /********************************************************************************
+    * 函数名称：检查进程是否存活
+    * 返回类型：bool
+    *    进程仍在运行返回true，否则返回false
+    *********************************************************************************/
+    virtual bool IsAlive() = 0;
+
+    /********************************************************************************
+    * 函数名称：终止进程
+    * 函数功能：强制结束子进程并释放管道
+    *********************************************************************************/
+    virtual void Terminate() = 0;
+
+    /********************************************************************************
+    * 函数名称：设置截止时间
+    * 函数功能：从现在起超过指定时间仍未取消，则结束子进程树，阻塞中的
+    *           ReadOutputLine随之返回false
+    * 函数参数：
+    *    [IN]  DWORD dwTimeoutMs：超时时间（毫秒），INFINITE表示取消截止时间
+    *********************************************************************************/
+    virtual void SetDeadline(DWORD dwTimeoutMs) = 0;
+
+    /********************************************************************************
+    * 函数名称：检查是否已超时
+    * 返回类型：bool
+    *    最近一次设置的截止时间已到达并结束了进程返回true
+    *********************************************************************************/
+    virtual bool DeadlineExpired() = 0;
+};
+
+/********************************************************************************
+* 类名称：进程后端接口
+* 类功能：抽象一次性命令执行和交互式子进程创建
+*********************************************************************************/
+class ProcessBackend {
+public:
+    virtual ~ProcessBackend() = default;
+
+    /********************************************************************************
+    * 函数名称：运行命令行
+    * 函数功能：创建进程执行完整命令行，等待结束并捕获原始输出
+    * 函数参数：
+    *    [IN]  const std::string& strCmdLine：完整的命令行字符串
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒），超时后结束整个进程树
+    *    [OUT] CommandResult& stcResult：退出码和原始输出（未做编码修复）
+    * 返回类型：bool
+    *    进程成功启动返回true，无法启动返回false（错误信息写入stcResult.strError）
+    * 注意事项：
+    *    - 超时时返回true，stcResult.bTimedOut为true，已读取的输出保留
+    *********************************************************************************/
+    virtual bool Run(const std::string& strCmdLine, DWORD dwTimeoutMs, CommandResult& stcResult) = 0;
+
+    /********************************************************************************
+    * 函数名称：流式运行命令行
+    * 函数功能：创建进程执行完整命令行，标准输出每形成一行就推送给回调
+    * 函数参数：
+    *    [IN]  const std::string& strCmdLine：完整的命令行字符串
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒），超时后结束整个进程树
+    *    [IN]  const LineSink& fnSink：行输出回调（在调用线程上执行）
+    *    [OUT] CommandResult& stcResult：退出码和原始错误输出（strOutput保持为空）
+    * 返回类型：bool
+    *    进程成功启动返回true，无法启动返回false（错误信息写入stcResult.strError）
+    * 注意事项：
+    *    - 内存占用有上限：超长的行会被分段推送，错误输出超过上限的部分被丢弃
+    *********************************************************************************/
+    virtual bool RunStreaming(const std::string& strCmdLine, DWORD dwTimeoutMs, const LineSink& fnSink,
+                              CommandResult& stcResult) = 0;
+
+    /********************************************************************************
+    * 函数名称：启动交互式子进程
+    * 函数功能：创建一个标准输入/输出均被重定向的长期运行子进程
+    * 函数参数：
+    *    [IN]  const std::string& strCmdLine：完整的命令行字符串
+    *    [OUT] std::string& strError：失败时的错误信息
+    * 返回类型：std::unique_ptr<ChildProcess>
+    *    子进程对象，失败返回nullptr
+    * 注意事项：
+    *    - 子进程的错误输出合并到标准输出
+    *    - 子进程随返回的对象一起销毁（包括其启动的所有子进程）
+    *********************************************************************************/
+    virtual std::unique_ptr<ChildProcess> Spawn(const std::string& strCmdLine, std::string& strError) = 0;
+
+    /********************************************************************************
+    * 函数名称：异步运行命令行
+    * 函数功能：创建进程执行完整命令行后立即返回，进程结束、超时或被取消时
+    *           通过回调返回退出码和原始输出
+    * 函数参数：
+    *    [IN]  const std::string& strCmdLine：完整的命令行字符串
+    *    [IN]  DWORD dwTimeoutMs：截止时间（毫秒），超时后结束整个进程树
+    *    [IN]  const CancellationToken& objCancel：取消令牌，取消后结束整个进程树
+    *    [IN]  CompletionHandler fnComplete：完成回调（每条命令恰好调用一次）
+    * 注意事项：
+    *    - 默认实现在调用线程上同步执行Run，替身后端无需重写
+    *    - 进程无法启动时回调在调用线程上立即执行（错误信息写入strError）
+    *********************************************************************************/
+    virtual void RunAsync(const std::string& strCmdLine, DWORD dwTimeoutMs, const CancellationToken& objCancel,
+                          CompletionHandler fnComplete);
+};
+
+class CompletionLoop;
+
+#ifdef _WIN32
+
+/********************************************************************************
+* 类名称：Win32进程后端
+* 类功能：基于CreateProcessA和匿名管道的默认进程后端实现
+*********************************************************************************/
+class Win32ProcessBackend : public ProcessBackend {
+public:
+    Win32ProcessBackend();
+    ~Win32ProcessBackend() override;
+
+    bool Run(const std::string& strCmdLine, DWORD dwTimeoutMs, CommandResult& stcResult) override;
+    bool RunStreaming(const std::string& strCmdLine, DWORD dwTimeoutMs, const LineSink& fnSink,
+                      CommandResult& stcResult) override;
+    std::unique_ptr<ChildProcess> Spawn(const std::string& strCmdLine, std::string& strError) override;
+
+    /********************************************************************************
+    * 函数名称：异步运行命令行
+    * 函数功能：在共享的I/O完成循环中执行命令（首次调用时启动完成循环）
+    * 注意事项：
+    *    - 完成回调在完成循环线程上执行，应尽快返回（例如只设置promise）
+    *    - 后端析构时取消所有进行中的命令，并等待它们的回调执行完毕
+    *********************************************************************************/
+    void RunAsync(const std::string& strCmdLine, DWORD dwTimeoutMs, const CancellationToken& objCancel,
+                  CompletionHandler fnComplete) override;
+
+private:
+    std::mutex                      m_mtxLoop;   // 保护完成循环的创建
+    std::unique_ptr<CompletionLoop> m_pLoop;     // 异步执行的I/O完成循环（按需创建）
+
+    /********************************************************************************
+    * 函数名称：从管道读取数据（内部辅助）
+    * 函数功能：从指定管道句柄读取所有可用数据，直到管道关闭
+    * 函数参数：
+    *    [IN]  HANDLE hPipe：管道句柄
+    *    [OUT] uint64_t& ui64FirstByteTime：读到第一个字节的时刻（ExecutorTrace::NowUs，
+    *          没有数据时为0）
+    * 返回类型：std::string
+    *    读取到的数据
+    *********************************************************************************/
+    static std::string ReadFromPipe(HANDLE hPipe, uint64_t& ui64FirstByteTime);
+
+    /********************************************************************************
+    * 函数名称：创建重定向的子进程（内部辅助）
+    * 函数功能：创建stdout/stderr管道，在作业对象中启动进程
+    * 函数参数：
+    *    [IN]  const std::string& strCmdLine：完整的命令行字符串
+    *    [IN]  bool bOverlapped：读取端是否使用重叠I/O（用于I/O完成端口）
+    *    [OUT] HANDLE& hJob：作业对象句柄（关闭时结束整个进程树）
+    *    [OUT] HANDLE& hProcess：进程句柄
+    *    [OUT] DWORD& dwProcessId：进程ID（用于匹配作业对象通知）
+    *    [OUT] HANDLE& hStdoutRead：标准输出读取端
+    *    [OUT] HANDLE& hStderrRead：标准错误读取端
+    *    [OUT] std::string& strError：失败时的错误信息
+    * 返回类型：bool
+    *    成功返回true，失败返回false（已释放所有句柄）
+    *********************************************************************************/
+    static bool CreateRedirectedProcess(const std::string& strCmdLine, bool bOverlapped, HANDLE& hJob,
+                                        HANDLE& hProcess, DWORD& dwProcessId, HANDLE& hStdoutRead,
+                                        HANDLE& hStderrRead, std::string& strError);
+};
+#else
+/********************************************************************************
+* 类名称：POSIX进程后端
+* 类功能：以/bin/sh -c执行命令行的进程后端，用于在Linux上测试超时、进程树
+*         结束和宿主协议
+*
+* 实现说明：
+*    子进程是新进程组的组长，进程组在这里相当于Win32的作业对象：截止时间到达
+*    时向整个进程组发送SIGKILL；主进程退出后残留的子进程仍持有输出管道时，
+*    宽限期后同样结束整个进程组，不会无限期等待管道关闭。
+*    RunAsync与Win32后端结构相同：所有进行中的命令由一个基于epoll的完成循环
+*    线程处理，管道可读、进程退出（pidfd）、截止时间和取消都在同一个循环中。
+*********************************************************************************/
+class PosixProcessBackend : public ProcessBackend {
+public:
+    PosixProcessBackend();
+    ~PosixProcessBackend() override;
+
+    bool Run(const std::string& strCmdLine, DWORD dwTimeoutMs, CommandResult& stcResult) override;
+    bool RunStreaming(const std::string& strCmdLine, DWORD dwTimeoutMs, const LineSink& fnSink,
+                      CommandResult& stcResult) override;
+    std::unique_ptr<ChildProcess> Spawn(const std::string& strCmdLine, std::string& strError) override;
+
+    /********************************************************************************
+    * 函数名称：异步运行命令行
+    * 函数功能：在共享的epoll完成循环中执行命令（首次调用时启动完成循环）
+    * 注意事项：
+    *    - 完成回调在完成循环线程上执行，应尽快返回（例如只设置promise）
+    *    - 后端析构时取消所有进行中的命令，并等待它们的回调执行完毕
+    *********************************************************************************/
+    void RunAsync(const std::string& strCmdLine, DWORD dwTimeoutMs, const CancellationToken& objCancel,
+                  CompletionHandler fnComplete) override;
+
+private:
+    std::mutex                      m_mtxLoop;   // 保护完成循环的创建
+    std::unique_ptr<CompletionLoop> m_pLoop;     // 异步执行的epoll完成循环（按需创建）
+
+    /********************************************************************************
+    * 函数名称：创建重定向的子进程（内部辅助）
+    * 函数功能：创建stdout/stderr管道，在新的进程组中启动/bin/sh -c命令行
+    * 函数参数：
+    *    [IN]  const std::string& strCmdLine：完整的命令行字符串
+    *    [OUT] pid_t& pid：子进程ID（同时是进程组ID）
+    *    [OUT] int& nStdoutRead：标准输出读取端
+    *    [OUT] int& nStderrRead：标准错误读取端
+    *    [OUT] std::string& strError：失败时的错误信息
+    * 返回类型：bool
+    *    成功返回true，失败返回false（已关闭所有管道）
+    *********************************************************************************/
+    static bool CreateRedirectedProcess(const std::string& strCmdLine, pid_t& pid, int& nStdoutRead,
+                                        int& nStderrRead, std::string& strError);
+};
+#endif
@@ -0,0 +1,237 @@
+﻿/********************************************************************************
+* 文件名称：QueryCache.cpp
+* 文件功能：实现只读查询结果缓存
+*
+* 实现说明：
+*    条目保存在std::map中，查找时惰性清除过期条目；缓存的条目数量很少
+*    （每次配置十几条），失效操作直接遍历全部条目。
+*    作用域的代数同样保存在std::map中，登记的作用域数量不超过虚拟机数量。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "QueryCache.h"
+#include <cctype>
+
+const char* const QueryCache::SCOPE_HOST = "";
+const char* const QueryCache::SCOPE_ALL_VMS = "*";
+
+/********************************************************************************
+* 函数实现：获取全局缓存实例
+*********************************************************************************/
+QueryCache& QueryCache::Instance() {
+    static QueryCache s_objCache;
+    return s_objCache;
+}
+
+/********************************************************************************
+* 函数实现：规范化缓存键
+*********************************************************************************/
+std::string QueryCache::NormalizeKey(const std::string& strCommand) {
+    std::string strKey;
+    strKey.reserve(strCommand.size());
+
+    char chQuote = 0;          // 当前所在的引号（0表示不在引号内）
+    bool bPendingSpace = false;
+    for (char ch : strCommand) {
+        // 1. 引号内的内容（虚拟机名称、路径）保持原样
+        if (chQuote != 0) {
+            strKey += ch;
+            if (ch == chQuote) chQuote = 0;
+            continue;
+        }
+
+        // 2. 引号外的连续空白合并为一个空格（开头的空白直接丢弃）
+        if (isspace(static_cast<unsigned char>(ch))) {
+            bPendingSpace = !strKey.empty();
+            continue;
+        }
+        if (bPendingSpace) {
+            strKey += ' ';
+            bPendingSpace = false;
+        }
+
+        // 3. 引号外的内容不区分大小写（PowerShell cmdlet和参数名不区分大小写）
+        if (ch == '\'' || ch == '"') {
+            chQuote = ch;
+            strKey += ch;
+        } else {
+            strKey += static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+        }
+    }
+    return strKey;
+}
+
+/********************************************************************************
+* 函数实现：取得作用域的当前代数
+*********************************************************************************/
+uint64_t QueryCache::Generation(const std::string& strScope) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    // 登记作用域，之后的InvalidateMatching能按命令文本推进它的代数
+    m_mapScopeGenerations.emplace(strScope, 0);
+    return m_ui64Generation;
+}
+
+/********************************************************************************
+* 函数实现：推进作用域的代数（调用者持有锁）
+*********************************************************************************/
+void QueryCache::BumpScope(const std::string& strScope) {
+    m_mapScopeGenerations[strScope] = ++m_ui64Generation;
+}
+
+/********************************************************************************
+* 函数实现：查找缓存
+*********************************************************************************/
+bool QueryCache::LookupRaw(const std::string& strKey, std::shared_ptr<const void>& pValue) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (!m_bEnabled) {
+        return false;
+    }
+
+    auto it = m_mapEntries.find(strKey);
+    if (it == m_mapEntries.end()) {
+        m_stcStats.ui64Misses++;
+        return false;
+    }
+
+    // 已过期：清除并按未命中处理
+    if (GetTickCount64() >= it->second.ui64ExpireTick) {
+        m_mapEntries.erase(it);
+        m_stcStats.ui64Misses++;
+        return false;
+    }
+
+    m_stcStats.ui64Hits++;
+    pValue = it->second.pValue;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：保存缓存
+*********************************************************************************/
+void QueryCache::StoreRaw(const std::string& strKey,
+                          const std::string& strScope,
+                          std::shared_ptr<const void> pValue,
+                          DWORD dwTtlMs,
+                          uint64_t ui64Generation) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (!m_bEnabled || dwTtlMs == 0) {
+        return;
+    }
+
+    // 查询执行期间作用域被清除过：结果可能是修改前的状态，不保存
+    auto itGeneration = m_mapScopeGenerations.find(strScope);
+    if (m_ui64ClearGeneration > ui64Generation ||
+        (itGeneration != m_mapScopeGenerations.end() && itGeneration->second > ui64Generation)) {
+        m_stcStats.ui64StaleStores++;
+        return;
+    }
+
+    Entry stcEntry;
+    stcEntry.strScope = strScope;
+    stcEntry.pValue = std::move(pValue);
+    stcEntry.ui64ExpireTick = GetTickCount64() + dwTtlMs;
+    m_mapEntries[strKey] = std::move(stcEntry);
+}
+
+/********************************************************************************
+* 函数实现：按作用域失效
+*********************************************************************************/
+void QueryCache::InvalidateScope(const std::string& strScope) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (!strScope.empty()) {
+        BumpScope(strScope);
+    }
+    BumpScope(SCOPE_ALL_VMS);
+    for (auto it = m_mapEntries.begin(); it != m_mapEntries.end();) {
+        const std::string& strEntryScope = it->second.strScope;
+        if (strEntryScope == SCOPE_ALL_VMS || (!strScope.empty() && strEntryScope == strScope)) {
+            it = m_mapEntries.erase(it);
+            m_stcStats.ui64Invalidations++;
+        } else {
+            ++it;
+        }
+    }
+}
+
+/********************************************************************************
+* 函数实现：按命令失效
+*********************************************************************************/
+void QueryCache::InvalidateMatching(const std::string& strCommand) {
+    // 非Get的Hyper-V虚拟机cmdlet（Set-VM、Add-VMGpuPartitionAdapter等）可能改变虚拟机
+    // 列表或状态；-VMName等参数前是空格，不会被当作cmdlet
+    std::string strLower(strCommand);
+    for (char& ch : strLower) {
+        ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+    }
+    bool bTouchesVMs = false;
+    for (size_t nPos = strLower.find("-vm"); nPos != std::string::npos && !bTouchesVMs;
+         nPos = strLower.find("-vm", nPos + 1)) {
+        bool bIsCmdlet = nPos > 0 && isalpha(static_cast<unsigned char>(strLower[nPos - 1]));
+        bool bIsGet = nPos >= 3 && strLower.compare(nPos - 3, 3, "get") == 0;
+        bTouchesVMs = bIsCmdlet && !bIsGet;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    // 1. 推进命令涉及的已登记作用域的代数（包括还没有条目、查询正在执行的作用域）
+    for (auto& objEntry : m_mapScopeGenerations) {
+        const std::string& strScope = objEntry.first;
+        if ((strScope == SCOPE_ALL_VMS && bTouchesVMs) ||
+            (!strScope.empty() && strScope != SCOPE_ALL_VMS &&
+             strCommand.find("'" + strScope + "'") != std::string::npos)) {
+            objEntry.second = ++m_ui64Generation;
+        }
+    }
+
+    // 2. 清除涉及的条目
+    for (auto it = m_mapEntries.begin(); it != m_mapEntries.end();) {
+        const std::string& strEntryScope = it->second.strScope;
+        bool bDrop = false;
+        if (strEntryScope == SCOPE_ALL_VMS) {
+            bDrop = bTouchesVMs;
+        } else if (!strEntryScope.empty()) {
+            // 命令中以'名称'形式引用了该虚拟机
+            bDrop = strCommand.find("'" + strEntryScope + "'") != std::string::npos;
+        }
+
+        if (bDrop) {
+            it = m_mapEntries.erase(it);
+            m_stcStats.ui64Invalidations++;
+        } else {
+            ++it;
+        }
+    }
+}
+
+/********************************************************************************
+* 函数实现：清空缓存
+*********************************************************************************/
+void QueryCache::Clear() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_ui64ClearGeneration = ++m_ui64Generation;
+    m_stcStats.ui64Invalidations += m_mapEntries.size();
+    m_mapEntries.clear();
+}
+
+/********************************************************************************
+* 函数实现：启用/禁用缓存
+*********************************************************************************/
+void QueryCache::SetEnabled(bool bEnable) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_bEnabled = bEnable;
+    if (!bEnable) {
+        m_ui64ClearGeneration = ++m_ui64Generation;
+        m_mapEntries.clear();
+    }
+}
+
+/********************************************************************************
+* 函数实现：获取统计信息
+*********************************************************************************/
+QueryCache::Stats QueryCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_stcStats;
+}
@@ -0,0 +1,194 @@
+﻿/********************************************************************************
+* 文件名称：QueryCache.h
+* 文件功能：为只读查询（PowerShell命令、WMI查询）提供带有效期的结果缓存
+*
+* 类说明：
+*    一次GPU-PV配置中，Get-VM、Get-VMGpuPartitionAdapter、Get-PnpDevice等
+*    只读查询会被重复执行，每次都要启动PowerShell或访问WMI。QueryCache以
+*    规范化后的命令文本为键保存查询结果，每个条目有独立的有效期（TTL），
+*    并在修改性命令涉及同一虚拟机时主动失效。
+*
+* 作用域与失效：
+*    - 每个条目属于一个作用域：
+*        SCOPE_HOST（空字符串）：主机级信息（如可分区GPU），只按有效期过期
+*        SCOPE_ALL_VMS（"*"）：依赖所有虚拟机的信息（如虚拟机列表）
+*        虚拟机名称：只依赖该虚拟机的信息
+*    - InvalidateScope(vm)：清除该虚拟机的条目和SCOPE_ALL_VMS条目
+*    - InvalidateMatching(cmd)：修改性命令执行后调用，命令文本中出现
+*      '虚拟机名称'（带单引号）的作用域被清除；命令包含Get以外的Hyper-V
+*      虚拟机cmdlet（Set-VM、Stop-VM、Add-VMGpuPartitionAdapter等）时
+*      SCOPE_ALL_VMS条目也被清除
+*
+* 代数与并发：
+*    查找未命中到保存结果之间查询正在执行，这期间另一个线程可能修改了虚拟机
+*    并清除了缓存，迟到的保存会把修改前的结果重新放回缓存。每个作用域记录
+*    最近一次被清除时的代数：查询前用Generation()取得当前代数，Store()时
+*    作用域在此之后被清除过（或缓存被清空）则丢弃该结果。
+*
+* 统计：
+*    命中/未命中/失效计数可通过GetStats()读取，命中次数即省去的
+*    PowerShell进程或WMI往返次数
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "Platform.h"
+
+/********************************************************************************
+* 类名称：查询结果缓存
+* 类功能：线程安全的TTL缓存，值以共享指针保存（命中时不复制数据）
+*
+* 调用示例：
+*    std::shared_ptr<const CommandResult> pCached;
+*    std::string strKey = QueryCache::NormalizeKey(strCommand);
+*    uint64_t ui64Generation = QueryCache::Instance().Generation("vm1");
+*    if (!QueryCache::Instance().Lookup(strKey, pCached)) {
+*        auto pResult = std::make_shared<CommandResult>(...);
+*        QueryCache::Instance().Store(strKey, "vm1", pResult, 10000, ui64Generation);
+*    }
+*********************************************************************************/
+class QueryCache {
+public:
+    static const char* const SCOPE_HOST;       // 主机级作用域（只按有效期过期）
+    static const char* const SCOPE_ALL_VMS;    // 依赖所有虚拟机的作用域
+
+    /********************************************************************************
+    * 结构体名称：缓存统计
+    *********************************************************************************/
+    struct Stats {
+        uint64_t ui64Hits = 0;            // 命中次数（省去的查询次数）
+        uint64_t ui64Misses = 0;          // 未命中次数（包括已过期）
+        uint64_t ui64Invalidations = 0;   // 被主动清除的条目数
+        uint64_t ui64StaleStores = 0;     // 因作用域在查询期间被清除而丢弃的保存
+    };
+
+    /********************************************************************************
+    * 函数名称：获取全局缓存实例
+    * 返回类型：QueryCache&
+    *********************************************************************************/
+    static QueryCache& Instance();
+
+    /********************************************************************************
+    * 函数名称：规范化缓存键
+    * 函数功能：引号外的内容转为小写并合并连续空白，引号内的内容保持原样
+    * 函数参数：
+    *    [IN]  const std::string& strCommand：命令或查询文本
+    * 返回类型：std::string
+    *    规范化后的键（大小写或空白不同的同一查询得到相同的键）
+    *********************************************************************************/
+    static std::string NormalizeKey(const std::string& strCommand);
+
+    /********************************************************************************
+    * 函数名称：取得作用域的当前代数
+    * 函数功能：在执行查询之前调用，返回值交给Store()判断结果是否已过时
+    * 函数参数：
+    *    [IN]  const std::string& strScope：作用域（虚拟机名称或SCOPE_*）
+    * 返回类型：uint64_t
+    *    当前代数
+    * 注意事项：
+    *    - 作用域被登记后，InvalidateMatching()即使没有该作用域的条目也会推进其代数
+    *********************************************************************************/
+    uint64_t Generation(const std::string& strScope);
+
+    /********************************************************************************
+    * 函数名称：查找缓存
+    * 函数参数：
+    *    [IN]  const std::string& strKey：规范化后的键
+    *    [OUT] std::shared_ptr<const T>& pValue：命中时的缓存值
+    * 返回类型：bool
+    *    命中且未过期返回true
+    * 注意事项：
+    *    - 同一个键必须始终以同一类型T存取（PowerShell与WMI使用不同的键前缀）
+    *********************************************************************************/
+    template <typename T>
+    bool Lookup(const std::string& strKey, std::shared_ptr<const T>& pValue) {
+        std::shared_ptr<const void> pRaw;
+        if (!LookupRaw(strKey, pRaw)) {
+            return false;
+        }
+        pValue = std::static_pointer_cast<const T>(pRaw);
+        return true;
+    }
+
+    /********************************************************************************
+    * 函数名称：保存缓存
+    * 函数参数：
+    *    [IN]  const std::string& strKey：规范化后的键
+    *    [IN]  const std::string& strScope：作用域（虚拟机名称或SCOPE_*）
+    *    [IN]  std::shared_ptr<const T> pValue：缓存值
+    *    [IN]  DWORD dwTtlMs：有效期（毫秒）
+    *    [IN]  uint64_t ui64Generation：查询前由Generation(strScope)取得的代数
+    * 注意事项：
+    *    - 作用域在取得代数之后被清除过时不保存（结果可能是修改前的状态）
+    *********************************************************************************/
+    template <typename T>
+    void Store(const std::string& strKey, const std::string& strScope, std::shared_ptr<const T> pValue,
+               DWORD dwTtlMs, uint64_t ui64Generation) {
+        StoreRaw(strKey, strScope, std::static_pointer_cast<const void>(pValue), dwTtlMs, ui64Generation);
+    }
+
+    /********************************************************************************
+    * 函数名称：按作用域失效
+    * 函数功能：清除指定虚拟机的条目以及SCOPE_ALL_VMS条目
+    * 函数参数：
+    *    [IN]  const std::string& strScope：虚拟机名称
+    *********************************************************************************/
+    void InvalidateScope(const std::string& strScope);
+
+    /********************************************************************************
+    * 函数名称：按命令失效
+    * 函数功能：修改性命令执行后调用，清除命令涉及的虚拟机的条目
+    * 函数参数：
+    *    [IN]  const std::string& strCommand：已执行的命令文本
+    *********************************************************************************/
+    void InvalidateMatching(const std::string& strCommand);
+
+    /********************************************************************************
+    * 函数名称：清空缓存
+    *********************************************************************************/
+    void Clear();
+
+    /********************************************************************************
+    * 函数名称：启用/禁用缓存
+    * 函数参数：
+    *    [IN]  bool bEnable：false时所有查找都未命中且不保存（用于排查问题）
+    *********************************************************************************/
+    void SetEnabled(bool bEnable);
+
+    /********************************************************************************
+    * 函数名称：获取统计信息
+    * 返回类型：Stats
+    *********************************************************************************/
+    Stats GetStats() const;
+
+private:
+    /********************************************************************************
+    * 结构体名称：缓存条目
+    *********************************************************************************/
+    struct Entry {
+        std::string                 strScope;         // 作用域
+        std::shared_ptr<const void> pValue;           // 缓存值
+        ULONGLONG                   ui64ExpireTick;   // 过期时刻（GetTickCount64）
+    };
+
+    mutable std::mutex                m_mtx;
+    std::map<std::string, Entry>      m_mapEntries;               // 键 -> 条目
+    std::map<std::string, uint64_t>   m_mapScopeGenerations;      // 作用域 -> 最近一次被清除时的代数
+    uint64_t                          m_ui64Generation = 0;       // 当前代数（每次清除时递增）
+    uint64_t                          m_ui64ClearGeneration = 0;  // 最近一次清空全部缓存时的代数
+    Stats                             m_stcStats;                 // 统计信息
+    bool                              m_bEnabled = true;          // 是否启用
+
+    bool LookupRaw(const std::string& strKey, std::shared_ptr<const void>& pValue);
+    void StoreRaw(const std::string& strKey, const std::string& strScope, std::shared_ptr<const void> pValue,
+                  DWORD dwTtlMs, uint64_t ui64Generation);
+    void BumpScope(const std::string& strScope);
+};
@@ -0,0 +1,96 @@
+﻿/********************************************************************************
+* 文件名称：ReadinessWaiter.cpp
+* 文件功能：实现按条件轮询的就绪等待（指数退避 + 截止时间）和系统时钟
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "ReadinessWaiter.h"
+#include <chrono>
+#include <thread>
+
+const WaitPolicy ReadinessWaiter::DISK_ARRIVAL = { 50, 1000, 30000 };
+const WaitPolicy ReadinessWaiter::VOLUME_ARRIVAL = { 100, 1000, 30000 };
+const WaitPolicy ReadinessWaiter::DETACH = { 100, 2000, 15000 };
+
+// 与WaitUntil相同的算法：立即检查，之后间隔从50毫秒开始翻倍，最后一次休眠截短到截止时间
+// 变量使用sgp前缀，避免遮蔽调用者在条件脚本块中引用的变量
+const char* const ReadinessWaiter::PS_WAIT_READY_BODY =
+    "param([scriptblock]$test, [string]$what, [int]$timeoutMs = 30000, [int]$maxIntervalMs = 1000) "
+    "$sgpDelay = 50; "
+    "$sgpWatch = [Diagnostics.Stopwatch]::StartNew(); "
+    "while (-not [bool](& $test)) { "
+    "    $sgpLeft = $timeoutMs - $sgpWatch.ElapsedMilliseconds; "
+    "    if ($sgpLeft -le 0) { throw ('Timed out waiting for ' + $what + ' after ' + $timeoutMs + ' ms'); } "
+    "    Start-Sleep -Milliseconds ([Math]::Min($sgpDelay, $sgpLeft)); "
+    "    $sgpDelay = [Math]::Min($sgpDelay * 2, $maxIntervalMs); "
+    "} ";
+
+/********************************************************************************
+* 类名称：系统时钟（内部辅助）
+*********************************************************************************/
+class SteadyWaitClock : public WaitClock {
+public:
+    uint64_t NowMs() override {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void SleepMs(uint32_t ui32Ms) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ui32Ms));
+    }
+};
+
+/********************************************************************************
+* 函数实现：获取系统时钟
+*********************************************************************************/
+WaitClock& WaitClock::System() {
+    static SteadyWaitClock s_objClock;
+    return s_objClock;
+}
+
+/********************************************************************************
+* 函数实现：构造函数
+*********************************************************************************/
+ReadinessWaiter::ReadinessWaiter(WaitClock& objClock)
+    : m_objClock(objClock) {
+}
+
+/********************************************************************************
+* 函数实现：等待条件满足
+*********************************************************************************/
+bool ReadinessWaiter::WaitUntil(const std::string& strWhat, const Condition& fnReady,
+                                const WaitPolicy& stcPolicy, std::string& strError) {
+    const uint64_t ui64Start = m_objClock.NowMs();
+    const uint64_t ui64Deadline = ui64Start + stcPolicy.ui32TimeoutMs;
+    uint32_t ui32Interval = stcPolicy.ui32InitialMs > 0 ? stcPolicy.ui32InitialMs : 1;
+    m_ui32Attempts = 0;
+
+    while (true) {
+        // 1. 检查条件（第一次检查不等待）
+        m_ui32Attempts++;
+        if (fnReady()) {
+            m_ui64ElapsedMs = m_objClock.NowMs() - ui64Start;
+            return true;
+        }
+
+        // 2. 到达截止时间后不再重试
+        uint64_t ui64Now = m_objClock.NowMs();
+        if (ui64Now >= ui64Deadline) {
+            m_ui64ElapsedMs = ui64Now - ui64Start;
+            strError = "等待" + strWhat + "超时（" + std::to_string(stcPolicy.ui32TimeoutMs) + "毫秒，共检查" +
+                       std::to_string(m_ui32Attempts) + "次）";
+            return false;
+        }
+
+        // 3. 休眠当前间隔（不超过剩余时间），然后间隔翻倍
+        uint64_t ui64Left = ui64Deadline - ui64Now;
+        m_objClock.SleepMs(ui64Left < ui32Interval ? static_cast<uint32_t>(ui64Left) : ui32Interval);
+        if (ui32Interval < stcPolicy.ui32MaxIntervalMs) {
+            ui32Interval = (ui32Interval > stcPolicy.ui32MaxIntervalMs / 2) ? stcPolicy.ui32MaxIntervalMs
+                                                                            : ui32Interval * 2;
+        }
+    }
+}
@@ -0,0 +1,123 @@
+﻿/********************************************************************************
+* 文件名称：ReadinessWaiter.h
+* 文件功能：按实际条件轮询等待设备就绪（指数退避 + 截止时间），替代固定延时
+*
+* 类说明：
+*    挂载和卸载虚拟磁盘过去依靠固定延时：VhdHandle::Attach等待1秒，
+*    MountAndGetSystemDrive再等待2秒，挂载脚本中还有2/2/3秒的Start-Sleep，
+*    卸载每次重试前等待1秒。设备通常早已就绪，慢的时候固定延时又不够。
+*    ReadinessWaiter反复检查真正的条件（磁盘联机、分区到达、卷已挂载、
+*    卸载完成），条件满足立即返回：
+*    - 第一次检查不等待；之后的间隔从ui32InitialMs开始每次翻倍，
+*      不超过ui32MaxIntervalMs
+*    - 到达截止时间时再检查最后一次，仍不满足返回超时错误
+*    - 时间和休眠通过WaitClock接口获得，默认使用系统单调时钟；
+*      替换为假时钟后等待逻辑不依赖Windows，可以在任何平台上验证
+*    - PS_WAIT_READY_BODY是同一算法的PowerShell版本（Wait-SgpReady），
+*      供挂载/卸载脚本使用
+*
+* 依赖项：
+*    - C++标准库（steady_clock、this_thread）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <functional>
+#include <cstdint>
+
+/********************************************************************************
+* 类名称：等待时钟
+* 类功能：提供单调时间和休眠（可替换为测试用的假时钟）
+*********************************************************************************/
+class WaitClock {
+public:
+    virtual ~WaitClock() = default;
+
+    // 当前单调时间（毫秒，起点任意）
+    virtual uint64_t NowMs() = 0;
+
+    // 休眠指定毫秒数（假时钟直接推进时间）
+    virtual void SleepMs(uint32_t ui32Ms) = 0;
+
+    /********************************************************************************
+    * 函数名称：获取系统时钟
+    * 返回类型：WaitClock&
+    *    基于std::chrono::steady_clock的全局实例
+    *********************************************************************************/
+    static WaitClock& System();
+};
+
+/********************************************************************************
+* 结构体名称：等待策略
+*********************************************************************************/
+struct WaitPolicy {
+    uint32_t ui32InitialMs = 50;          // 第一次重试前的间隔（毫秒）
+    uint32_t ui32MaxIntervalMs = 1000;    // 间隔上限（毫秒）
+    uint32_t ui32TimeoutMs = 30000;       // 截止时间（毫秒，从开始等待算起）
+};
+
+/********************************************************************************
+* 类名称：就绪等待器
+* 类功能：按等待策略轮询条件，直到条件满足或超时
+*
+* 调用示例：
+*    ReadinessWaiter objWaiter;
+*    std::string strError;
+*    if (!objWaiter.WaitUntil("虚拟磁盘联机", [&]() { return IsDiskOnline(); },
+*                             ReadinessWaiter::DISK_ARRIVAL, strError)) {
+*        // strError："等待虚拟磁盘联机超时（30000毫秒，共检查12次）"
+*    }
+*********************************************************************************/
+class ReadinessWaiter {
+public:
+    // 就绪条件：返回true表示已就绪
+    using Condition = std::function<bool()>;
+
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  WaitClock& objClock：时钟（默认系统时钟，调用者保证生命周期）
+    *********************************************************************************/
+    explicit ReadinessWaiter(WaitClock& objClock = WaitClock::System());
+
+    /********************************************************************************
+    * 函数名称：等待条件满足
+    * 函数参数：
+    *    [IN]  const std::string& strWhat：等待的内容（用于错误信息）
+    *    [IN]  const Condition& fnReady：就绪条件
+    *    [IN]  const WaitPolicy& stcPolicy：间隔和截止时间
+    *    [OUT] std::string& strError：超时时的错误信息
+    * 返回类型：bool
+    *    条件满足返回true，到达截止时间仍不满足返回false
+    * 注意事项：
+    *    - 条件在调用线程上执行，可以有副作用（如每次检查时重试卸载）
+    *    - 最后一次休眠被截短到截止时间，截止时刻一定会再检查一次
+    *********************************************************************************/
+    bool WaitUntil(const std::string& strWhat, const Condition& fnReady, const WaitPolicy& stcPolicy,
+                   std::string& strError);
+
+    // 最近一次等待检查条件的次数
+    uint32_t Attempts() const { return m_ui32Attempts; }
+
+    // 最近一次等待的耗时（毫秒）
+    uint64_t ElapsedMs() const { return m_ui64ElapsedMs; }
+
+    // 常用策略：虚拟磁盘联机、卷挂载并出现在盘符中、卸载完成
+    static const WaitPolicy DISK_ARRIVAL;
+    static const WaitPolicy VOLUME_ARRIVAL;
+    static const WaitPolicy DETACH;
+
+    // Wait-SgpReady的函数体（含param块），用于注册到ScriptRegistry：
+    //    Wait-SgpReady -what <说明> -timeoutMs <毫秒> -test { <返回布尔值的条件> }
+    // 超时时抛出异常；条件脚本块只能输出一个布尔值
+    static const char* const PS_WAIT_READY_BODY;
+
+private:
+    WaitClock&  m_objClock;             // 时钟
+    uint32_t    m_ui32Attempts = 0;     // 最近一次等待的检查次数
+    uint64_t    m_ui64ElapsedMs = 0;    // 最近一次等待的耗时
+};
@@ -0,0 +1,130 @@
+﻿/********************************************************************************
+* 文件名称：ScriptRecord.cpp
+* 文件功能：实现脚本记录的解码
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "ScriptRecord.h"
+#include "Utils.h"
+
+// 记录行前缀
+static const std::string_view RECORD_MARKER = "##SGP-REC## ";
+
+// Emit-Record函数体：前导代码和脚本注册表共用同一份定义
+#define EMIT_RECORD_BODY \
+    "param([string]$t, [string]$v = '', [string]$d = '') " \
+    "    $e = [Text.Encoding]::UTF8; " \
+    "    Write-Output ('##SGP-REC## ' + $t + ' ' + [Convert]::ToBase64String($e.GetBytes($v)) + ' ' + " \
+    "                  [Convert]::ToBase64String($e.GetBytes($d))); "
+
+const char* const ScriptRecordDecoder::PS_PRELUDE = "function Emit-Record { " EMIT_RECORD_BODY "}; ";
+const char* const ScriptRecordDecoder::PS_EMIT_RECORD_BODY = EMIT_RECORD_BODY;
+
+/********************************************************************************
+* 函数实现：类型名转换为记录类型（内部辅助）
+*********************************************************************************/
+static RecordType ParseRecordType(std::string_view svTag) {
+    if (svTag == "INFO")    return RecordType::Info;
+    if (svTag == "WARN")    return RecordType::Warning;
+    if (svTag == "ERROR")   return RecordType::Error;
+    if (svTag == "FOUND")   return RecordType::Found;
+    if (svTag == "MISSING") return RecordType::Missing;
+    if (svTag == "PACKAGE") return RecordType::Package;
+    if (svTag == "FILE")    return RecordType::File;
+    if (svTag == "VERDICT") return RecordType::Verdict;
+    if (svTag == "DEVICE")  return RecordType::Device;
+    if (svTag == "DONE")    return RecordType::Done;
+    return RecordType::Unknown;
+}
+
+/********************************************************************************
+* 函数实现：取出下一个以空格分隔的字段（内部辅助，保留空字段）
+*********************************************************************************/
+static std::string_view NextField(std::string_view& svRest) {
+    size_t nSpace = svRest.find(' ');
+    std::string_view svField = svRest.substr(0, nSpace);
+    svRest = (nSpace == std::string_view::npos) ? std::string_view() : svRest.substr(nSpace + 1);
+    return svField;
+}
+
+/********************************************************************************
+* 函数实现：解码单行
+*********************************************************************************/
+bool ScriptRecordDecoder::DecodeLine(std::string_view svLine, ScriptRecord& stcRecord) {
+    // 1. 检查记录前缀（非记录行直接忽略）
+    svLine = Utils::TrimView(svLine);
+    if (!svLine.starts_with(RECORD_MARKER)) {
+        return false;
+    }
+    svLine.remove_prefix(RECORD_MARKER.size());
+
+    // 2. 依次取出类型、值、详情
+    std::string_view svTag = NextField(svLine);
+    std::string_view svValue = NextField(svLine);
+    std::string_view svDetail = NextField(svLine);
+    if (svTag.empty()) {
+        return false;
+    }
+
+    // 3. 解码Base64字段
+    ScriptRecord stcDecoded;
+    stcDecoded.eType = ParseRecordType(svTag);
+    stcDecoded.strTag.assign(svTag);
+    if (!Utils::Base64Decode(std::string(svValue), stcDecoded.strValue) ||
+        !Utils::Base64Decode(std::string(svDetail), stcDecoded.strDetail)) {
+        return false;
+    }
+
+    stcRecord = std::move(stcDecoded);
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：分发一个完整的行（内部辅助）
+*********************************************************************************/
+void ScriptRecordDecoder::Dispatch(std::string_view svLine, const RecordSink& fnSink, const LineSink& fnLine) {
+    ScriptRecord stcRecord;
+    if (DecodeLine(svLine, stcRecord)) {
+        fnSink(stcRecord);
+    } else if (fnLine) {
+        fnLine(svLine);
+    }
+}
+
+/********************************************************************************
+* 函数实现：输入数据块
+*********************************************************************************/
+void ScriptRecordDecoder::Feed(std::string_view svChunk, const RecordSink& fnSink, const LineSink& fnLine) {
+    while (!svChunk.empty()) {
+        // 1. 没有换行符：整块缓存，等待后续数据
+        size_t nNewLine = svChunk.find('\n');
+        if (nNewLine == std::string_view::npos) {
+            m_strPending.append(svChunk);
+            return;
+        }
+
+        // 2. 补齐一行后解码；没有缓存时直接使用输入的视图，不复制
+        std::string_view svLine = svChunk.substr(0, nNewLine);
+        svChunk.remove_prefix(nNewLine + 1);
+        if (!m_strPending.empty()) {
+            m_strPending.append(svLine);
+            Dispatch(m_strPending, fnSink, fnLine);
+            m_strPending.clear();
+        } else {
+            Dispatch(svLine, fnSink, fnLine);
+        }
+    }
+}
+
+/********************************************************************************
+* 函数实现：结束输入
+*********************************************************************************/
+void ScriptRecordDecoder::Finish(const RecordSink& fnSink, const LineSink& fnLine) {
+    if (!m_strPending.empty()) {
+        Dispatch(m_strPending, fnSink, fnLine);
+    }
+    m_strPending.clear();
+}
@@ -0,0 +1,122 @@
+﻿/********************************************************************************
+* 文件名称：ScriptRecord.h
+* 文件功能：定义PowerShell脚本与C++之间的结构化结果记录及其解码器
+*
+* 类说明：
+*    驱动复制和设备验证脚本过去输出VERIFY_OK、[FOUND]、DEVICE_OK:、SUCCESS
+*    等文本标记，C++用std::string::find在完整输出中查找。这要求保留并扫描
+*    全部输出，而且GPU名称或路径中恰好含有这些单词时会误判。
+*    现在脚本通过Emit-Record输出带标记的记录行，ScriptRecordDecoder逐行
+*    （或逐块）解码为带类型的ScriptRecord，普通输出行被忽略。
+*
+* 记录格式（每条记录一行）：
+*    ##SGP-REC## <类型> <Base64(UTF-8值)> <Base64(UTF-8详情)>
+*    值和详情经过Base64编码，任意文本（包括GPU名称、路径、异常信息）都
+*    不会与记录标记或分隔符冲突；空字段编码为空字符串。
+*
+* 依赖项：
+*    - Utils（Base64解码、逐行读取）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <string_view>
+#include <functional>
+
+/********************************************************************************
+* 枚举名称：记录类型
+*********************************************************************************/
+enum class RecordType {
+    Unknown,    // 无法识别的类型（保留原始类型名，便于新旧脚本兼容）
+    Info,       // 提示信息：值为消息
+    Warning,    // 警告：值为消息
+    Error,      // 错误：值为消息
+    Found,      // 验证时找到的文件：值为路径或描述
+    Missing,    // 验证时缺失的文件：值为路径或描述
+    Package,    // 驱动包目录：值为源目录，详情为目标目录
+    File,       // 单个驱动文件：值为源路径，详情为目标路径
+    Verdict,    // 验证结论：值为OK / PARTIAL / FAIL
+    Device,     // 虚拟机内设备状态：值为OK / ERROR / NOT_FOUND / SKIPPED等，详情为设备名或说明
+    Done        // 脚本正常结束
+};
+
+/********************************************************************************
+* 结构体名称：脚本记录
+*********************************************************************************/
+struct ScriptRecord {
+    RecordType  eType = RecordType::Unknown;  // 记录类型
+    std::string strTag;                       // 原始类型名（如"PACKAGE"）
+    std::string strValue;                     // 值（UTF-8）
+    std::string strDetail;                    // 详情（UTF-8，可为空）
+};
+
+// 记录回调：每解码出一条记录调用一次
+using RecordSink = std::function<void(const ScriptRecord&)>;
+// 普通行回调：不是有效记录的行（不含换行符）原样传入
+using LineSink = std::function<void(std::string_view)>;
+
+/********************************************************************************
+* 类名称：脚本记录解码器
+* 类功能：单遍、增量地从PowerShell输出中解码记录
+*
+* 调用示例：
+*    ScriptRecordDecoder objDecoder;
+*    PowerShellExecutor::ExecuteStreaming(ScriptRecordDecoder::PS_PRELUDE + cmd,
+*        [&](std::string_view svLine) {
+*            ScriptRecord stcRecord;
+*            if (ScriptRecordDecoder::DecodeLine(svLine, stcRecord)) {
+*                // 按stcRecord.eType处理
+*            }
+*        }, strError);
+*********************************************************************************/
+class ScriptRecordDecoder {
+public:
+    // 脚本前导代码：定义Emit-Record函数，需拼接在脚本开头
+    //    Emit-Record <类型> [值] [详情]
+    static const char* const PS_PRELUDE;
+
+    // Emit-Record的函数体（含param块），用于注册到ScriptRegistry，
+    // 注册后的脚本函数可以直接调用Emit-Record而无需拼接前导代码
+    static const char* const PS_EMIT_RECORD_BODY;
+
+    /********************************************************************************
+    * 函数名称：解码单行
+    * 函数参数：
+    *    [IN]  std::string_view svLine：一行输出（可带行尾空白）
+    *    [OUT] ScriptRecord& stcRecord：解码出的记录
+    * 返回类型：bool
+    *    是有效的记录行返回true；普通输出或格式错误返回false
+    *********************************************************************************/
+    static bool DecodeLine(std::string_view svLine, ScriptRecord& stcRecord);
+
+    /********************************************************************************
+    * 函数名称：输入数据块
+    * 函数功能：追加一段输出，对其中每个完整的行解码并回调
+    * 函数参数：
+    *    [IN]  std::string_view svChunk：输出数据（可以在任意位置截断）
+    *    [IN]  const RecordSink& fnSink：记录回调
+    *    [IN]  const LineSink& fnLine：普通行回调（可为空）
+    * 注意事项：
+    *    - 不完整的最后一行会被缓存，直到后续数据补齐或调用Finish
+    *    - 格式错误的记录行（如Base64无效）按普通行交给fnLine
+    *********************************************************************************/
+    void Feed(std::string_view svChunk, const RecordSink& fnSink, const LineSink& fnLine = nullptr);
+
+    /********************************************************************************
+    * 函数名称：结束输入
+    * 函数功能：解码缓存中剩余的最后一行（输出末尾没有换行符时）
+    * 函数参数：
+    *    [IN]  const RecordSink& fnSink：记录回调
+    *    [IN]  const LineSink& fnLine：普通行回调（可为空）
+    *********************************************************************************/
+    void Finish(const RecordSink& fnSink, const LineSink& fnLine = nullptr);
+
+private:
+    static void Dispatch(std::string_view svLine, const RecordSink& fnSink, const LineSink& fnLine);
+
+    std::string m_strPending;   // 尚未遇到换行符的部分行
+};
@@ -0,0 +1,138 @@
+﻿/********************************************************************************
+* 文件名称：ScriptRegistry.cpp
+* 文件功能：实现预定义的PowerShell脚本函数注册表
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "ScriptRegistry.h"
+
+/********************************************************************************
+* 函数实现：检查函数名是否在文本中作为独立的单词出现（内部辅助）
+*********************************************************************************/
+static bool ReferencesName(const std::string& strText, const std::string& strName) {
+    auto isNameChar = [](char ch) {
+        return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+               ch == '-' || ch == '_' || ch == ':';
+    };
+    size_t nPos = strText.find(strName);
+    while (nPos != std::string::npos) {
+        size_t nEnd = nPos + strName.size();
+        bool bStartOk = (nPos == 0) || !isNameChar(strText[nPos - 1]);
+        bool bEndOk = (nEnd >= strText.size()) || !isNameChar(strText[nEnd]);
+        if (bStartOk && bEndOk) {
+            return true;
+        }
+        nPos = strText.find(strName, nPos + 1);
+    }
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：字符串参数格式化
+*********************************************************************************/
+std::string ScriptArg<std::string>::Format(const std::string& strValue) {
+    // PowerShell把单引号及其Unicode变体（U+2018~U+201B，UTF-8为E2 80 98~9B）都当作
+    // 单引号字符串的定界符，成对书写表示字面字符
+    std::string strQuoted = "'";
+    for (size_t i = 0; i < strValue.size(); i++) {
+        if (strValue[i] == '\'') {
+            strQuoted += "''";
+            continue;
+        }
+        if (i + 2 < strValue.size() &&
+            static_cast<unsigned char>(strValue[i]) == 0xE2 &&
+            static_cast<unsigned char>(strValue[i + 1]) == 0x80 &&
+            static_cast<unsigned char>(strValue[i + 2]) >= 0x98 &&
+            static_cast<unsigned char>(strValue[i + 2]) <= 0x9B) {
+            strQuoted.append(strValue, i, 3);
+            strQuoted.append(strValue, i, 3);
+            i += 2;
+            continue;
+        }
+        strQuoted += strValue[i];
+    }
+    return strQuoted + "'";
+}
+
+/********************************************************************************
+* 函数实现：获取全局实例
+*********************************************************************************/
+ScriptRegistry& ScriptRegistry::Instance() {
+    // 函数内静态对象：其他翻译单元的静态ScriptFunction注册时保证已构造
+    static ScriptRegistry objInstance;
+    return objInstance;
+}
+
+/********************************************************************************
+* 函数实现：注册函数
+*********************************************************************************/
+void ScriptRegistry::Register(const std::string& strName, const std::string& strBody) {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    for (auto& stcEntry : m_vecEntries) {
+        if (stcEntry.strName == strName) {
+            stcEntry.strBody = strBody;
+            return;
+        }
+    }
+    m_vecEntries.push_back({ strName, strBody });
+}
+
+/********************************************************************************
+* 函数实现：生成会话加载脚本
+*********************************************************************************/
+std::string ScriptRegistry::BuildSessionScript() const {
+    // 宿主以局部作用域执行每条命令，函数必须定义在全局作用域才能被后续命令使用
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    std::string strScript;
+    for (const auto& stcEntry : m_vecEntries) {
+        strScript += "function global:" + stcEntry.strName + " { " + stcEntry.strBody + "}; ";
+    }
+    return strScript;
+}
+
+/********************************************************************************
+* 函数实现：附加函数定义
+*********************************************************************************/
+std::string ScriptRegistry::WithDefinitions(const std::string& strCommand) const {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    if (m_vecEntries.empty()) {
+        return strCommand;
+    }
+
+    // 1. 找出命令直接引用的函数
+    std::vector<bool> vecNeeded(m_vecEntries.size(), false);
+    std::vector<size_t> vecPending;
+    for (size_t i = 0; i < m_vecEntries.size(); i++) {
+        if (ReferencesName(strCommand, m_vecEntries[i].strName)) {
+            vecNeeded[i] = true;
+            vecPending.push_back(i);
+        }
+    }
+    if (vecPending.empty()) {
+        return strCommand;
+    }
+
+    // 2. 沿函数体中的引用补全间接依赖
+    while (!vecPending.empty()) {
+        size_t nCurrent = vecPending.back();
+        vecPending.pop_back();
+        for (size_t i = 0; i < m_vecEntries.size(); i++) {
+            if (!vecNeeded[i] && ReferencesName(m_vecEntries[nCurrent].strBody, m_vecEntries[i].strName)) {
+                vecNeeded[i] = true;
+                vecPending.push_back(i);
+            }
+        }
+    }
+
+    // 3. 按注册顺序输出定义，最后是命令本身
+    std::string strScript;
+    for (size_t i = 0; i < m_vecEntries.size(); i++) {
+        if (vecNeeded[i]) {
+            strScript += "function " + m_vecEntries[i].strName + " { " + m_vecEntries[i].strBody + "}; ";
+        }
+    }
+    return strScript + strCommand;
+}
@@ -0,0 +1,197 @@
+﻿/********************************************************************************
+* 文件名称：ScriptRegistry.h
+* 文件功能：预定义的PowerShell脚本函数注册表及类型化的参数绑定
+*
+* 类说明：
+*    驱动复制、磁盘挂载和设备验证使用5~10KB的脚本，过去每次调用都通过
+*    字符串拼接重新生成，参数值直接拼进脚本（需要手动转义单引号），
+*    常驻宿主每次都要重新解析整段脚本。
+*    现在这些脚本注册为具名的PowerShell函数：
+*    - 常驻宿主启动时一次性加载所有函数（function global:<名称>），之后
+*      每次调用只发送一行"<名称> -参数 值"
+*    - 独立进程执行（流式、异步、宿主不可用时）没有预加载的函数，执行器
+*      在命令前附加它实际引用的函数定义（含间接引用）
+*    - ScriptFunction<参数类型...>根据C++参数类型生成param块，调用时按类型
+*      格式化参数值（字符串使用单引号并转义），参数个数和类型在编译期检查
+*
+* 参数类型映射：
+*    std::string               -> [string]    '值'（单引号及其Unicode变体成对转义）
+*    int / uint64_t            -> [int] / [uint64]
+*    bool                      -> [bool]      $true / $false
+*    std::vector<std::string>  -> [string[]]  @('a', 'b')
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <cstdint>
+
+/********************************************************************************
+* 类名称：脚本函数注册表
+* 类功能：保存具名函数的定义，生成宿主会话的加载脚本和独立执行的前导定义
+*********************************************************************************/
+class ScriptRegistry {
+public:
+    /********************************************************************************
+    * 函数名称：获取全局实例
+    * 返回类型：ScriptRegistry&
+    *********************************************************************************/
+    static ScriptRegistry& Instance();
+
+    /********************************************************************************
+    * 函数名称：注册函数
+    * 函数参数：
+    *    [IN]  const std::string& strName：函数名称（如"Mount-SgpVMDisk"）
+    *    [IN]  const std::string& strBody：函数体（花括号内的内容，含param块）
+    * 注意事项：
+    *    - 通常由ScriptFunction / ScriptDefinition的静态对象在程序启动时注册
+    *    - 同名函数重复注册时保留最后一次的定义
+    *********************************************************************************/
+    void Register(const std::string& strName, const std::string& strBody);
+
+    /********************************************************************************
+    * 函数名称：生成会话加载脚本
+    * 返回类型：std::string
+    *    定义所有已注册函数的脚本（function global:<名称> { ... }），
+    *    没有注册任何函数时返回空字符串
+    *********************************************************************************/
+    std::string BuildSessionScript() const;
+
+    /********************************************************************************
+    * 函数名称：附加函数定义
+    * 函数功能：在命令前附加它引用的已注册函数的定义（按注册顺序，含间接引用）
+    * 函数参数：
+    *    [IN]  const std::string& strCommand：命令文本
+    * 返回类型：std::string
+    *    可以在新会话中独立执行的命令；没有引用任何已注册函数时原样返回
+    *********************************************************************************/
+    std::string WithDefinitions(const std::string& strCommand) const;
+
+private:
+    struct Entry {
+        std::string strName;   // 函数名称
+        std::string strBody;   // 函数体
+    };
+
+    mutable std::mutex  m_mtxEntries;   // 保护m_vecEntries
+    std::vector<Entry>  m_vecEntries;   // 按注册顺序
+
+    ScriptRegistry() = default;
+    ScriptRegistry(const ScriptRegistry&) = delete;
+    ScriptRegistry& operator=(const ScriptRegistry&) = delete;
+};
+
+/********************************************************************************
+* 类名称：脚本参数格式化
+* 类功能：C++类型到PowerShell参数类型和字面量的映射（未列出的类型无法编译）
+*********************************************************************************/
+template <typename T>
+struct ScriptArg;
+
+template <>
+struct ScriptArg<std::string> {
+    static const char* TypeName() { return "[string]"; }
+    static std::string Format(const std::string& strValue);
+};
+
+template <>
+struct ScriptArg<int> {
+    static const char* TypeName() { return "[int]"; }
+    static std::string Format(int nValue) { return std::to_string(nValue); }
+};
+
+template <>
+struct ScriptArg<uint64_t> {
+    static const char* TypeName() { return "[uint64]"; }
+    static std::string Format(uint64_t ui64Value) { return std::to_string(ui64Value); }
+};
+
+template <>
+struct ScriptArg<bool> {
+    static const char* TypeName() { return "[bool]"; }
+    static std::string Format(bool bValue) { return bValue ? "$true" : "$false"; }
+};
+
+template <>
+struct ScriptArg<std::vector<std::string>> {
+    static const char* TypeName() { return "[string[]]"; }
+    static std::string Format(const std::vector<std::string>& vecValues) {
+        std::string strList = "@(";
+        for (size_t i = 0; i < vecValues.size(); i++) {
+            if (i > 0) strList += ", ";
+            strList += ScriptArg<std::string>::Format(vecValues[i]);
+        }
+        return strList + ")";
+    }
+};
+
+/********************************************************************************
+* 类名称：脚本定义
+* 类功能：注册只被其他脚本调用的辅助函数（自行编写param块）
+*
+* 调用示例：
+*    static const ScriptDefinition EMIT_RECORD("Emit-Record", ScriptRecordDecoder::PS_EMIT_RECORD_BODY);
+*********************************************************************************/
+class ScriptDefinition {
+public:
+    ScriptDefinition(const char* pszName, const char* pszBody) {
+        ScriptRegistry::Instance().Register(pszName, pszBody);
+    }
+};
+
+/********************************************************************************
+* 类名称：类型化脚本函数
+* 类功能：注册一个具名函数，并按C++参数类型生成param块和调用命令
+*
+* 调用示例：
+*    static const ScriptFunction<std::string, int> RESIZE_DISK(
+*        "Resize-SgpDisk", { "path", "sizeGB" },
+*        "Resize-VHD -Path $path -SizeBytes ($sizeGB * 1GB); ");
+*    PowerShellExecutor::ExecuteWithCheck(RESIZE_DISK.Invoke(strPath, 64), strOutput, strError);
+*    // 发送给宿主的命令：Resize-SgpDisk -path 'D:\VMs\a.vhdx' -sizeGB 64
+*********************************************************************************/
+template <typename... TArgs>
+class ScriptFunction {
+public:
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  const char* pszName：函数名称
+    *    [IN]  const std::array<const char*, N>& arrParams：参数名称（个数必须与类型个数相同）
+    *    [IN]  const char* pszBody：函数体（不含param块，由参数类型生成）
+    *********************************************************************************/
+    ScriptFunction(const char* pszName, const std::array<const char*, sizeof...(TArgs)>& arrParams,
+                   const char* pszBody)
+        : m_strName(pszName), m_arrParams(arrParams) {
+        std::string strParamBlock = "param(";
+        size_t nIndex = 0;
+        ((strParamBlock += std::string(nIndex > 0 ? ", " : "") + ScriptArg<TArgs>::TypeName() + "$" +
+                           m_arrParams[nIndex], nIndex++), ...);
+        strParamBlock += ") ";
+        ScriptRegistry::Instance().Register(m_strName, strParamBlock + pszBody);
+    }
+
+    /********************************************************************************
+    * 函数名称：生成调用命令
+    * 函数参数：
+    *    [IN]  const TArgs&... args：参数值
+    * 返回类型：std::string
+    *    "<名称> -参数1 值1 -参数2 值2"
+    *********************************************************************************/
+    std::string Invoke(const TArgs&... args) const {
+        std::string strCall = m_strName;
+        size_t nIndex = 0;
+        ((strCall += std::string(" -") + m_arrParams[nIndex++] + " " + ScriptArg<TArgs>::Format(args)), ...);
+        return strCall;
+    }
+
+private:
+    std::string                                 m_strName;     // 函数名称
+    std::array<const char*, sizeof...(TArgs)>   m_arrParams;   // 参数名称
+};
@@ -2,6 +2,9 @@
 #include <commctrl.h>  // 添加这行
 #include "MainWindow.h"
 #include "Utils.h"
+#include "PowerShellExecutor.h"
+#include "TranscriptBackend.h"
+#include "MountRegistry.h"
 
 // 程序入口点
 int WINAPI wWinMain(
@@ -48,9 +51,28 @@ int WINAPI wWinMain(
         return 1;
     }
     
+    // 按环境变量启用命令录制/回放（SMARTGPUPV_RECORD / SMARTGPUPV_REPLAY）
+    std::string transcriptError;
+    if (!Transcript::StartFromEnvironment(transcriptError)) {
+        MessageBoxW(nullptr, Utils::StringToWString(transcriptError).c_str(), L"录制/回放", MB_OK | MB_ICONERROR);
+        return 1;
+    }
+    
+    // 清理上次异常退出时残留的虚拟机磁盘挂载点目录
+    size_t staleMounts = 0;
+    MountRegistry::Instance().CleanupStale(staleMounts);
+    
     // 创建并显示主窗口
     MainWindow mainWindow;
     mainWindow.Show(hInstance);
     
+    // 保存录制的记录文件（回放时检查是否有未命中的命令）
+    if (!Transcript::Finish(transcriptError)) {
+        MessageBoxW(nullptr, Utils::StringToWString(transcriptError).c_str(), L"录制/回放", MB_OK | MB_ICONWARNING);
+    }
+    
+    // 停止常驻PowerShell宿主进程
+    PowerShellExecutor::Shutdown();
+    
     return 0;
 }
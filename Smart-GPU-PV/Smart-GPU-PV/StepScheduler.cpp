@@ -0,0 +1,305 @@
+﻿/********************************************************************************
+* 文件名称：StepScheduler.cpp
+* 文件功能：实现按依赖关系并发执行配置步骤的调度器
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "StepScheduler.h"
+#include "ExecutorTrace.h"
+#include <thread>
+#include <algorithm>
+#include <exception>
+#ifdef _WIN32
+#include <windows.h>
+#include <objbase.h>
+#endif
+
+/********************************************************************************
+* 函数实现：添加步骤
+*********************************************************************************/
+StepScheduler& StepScheduler::AddStep(const std::string& strName,
+                                      std::vector<std::string> vecDependsOn,
+                                      std::vector<std::string> vecLocks,
+                                      StepFunc fnRun,
+                                      RollbackFunc fnRollback) {
+    Step stcStep;
+    stcStep.strName = strName;
+    stcStep.vecDependNames = std::move(vecDependsOn);
+    stcStep.vecLocks = std::move(vecLocks);
+    stcStep.fnRun = std::move(fnRun);
+    stcStep.fnRollback = std::move(fnRollback);
+    m_vecSteps.push_back(std::move(stcStep));
+    return *this;
+}
+
+/********************************************************************************
+* 函数实现：提交到调用线程
+*********************************************************************************/
+void StepScheduler::Post(std::function<void()> fnTask) {
+    {
+        std::lock_guard<std::mutex> lock(m_mtxState);
+        m_deqPosted.push_back(std::move(fnTask));
+    }
+    m_cvState.notify_all();
+}
+
+/********************************************************************************
+* 函数实现：检查步骤能否开始（内部辅助，调用时持有m_mtxState）
+*********************************************************************************/
+bool StepScheduler::CanStart(const Step& stcStep) const {
+    for (size_t nDep : stcStep.vecDependsOn) {
+        if (m_vecSteps[nDep].eState != StepState::Succeeded) {
+            return false;
+        }
+    }
+    for (const auto& strLock : stcStep.vecLocks) {
+        if (std::find(m_vecHeldLocks.begin(), m_vecHeldLocks.end(), strLock) != m_vecHeldLocks.end()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：执行已提交的任务（内部辅助，执行任务时释放锁）
+*********************************************************************************/
+bool StepScheduler::DrainPosted(std::unique_lock<std::mutex>& lock) {
+    bool bRan = false;
+    while (!m_deqPosted.empty()) {
+        std::function<void()> fnTask = std::move(m_deqPosted.front());
+        m_deqPosted.pop_front();
+        lock.unlock();
+        fnTask();
+        lock.lock();
+        bRan = true;
+    }
+    return bRan;
+}
+
+/********************************************************************************
+* 函数实现：执行所有步骤
+*********************************************************************************/
+bool StepScheduler::Run(std::string& strFailedStep, std::string& strError) {
+    strFailedStep.clear();
+    strError.clear();
+
+    // 1. 解析依赖名称（只能依赖先添加的步骤）
+    for (size_t i = 0; i < m_vecSteps.size(); i++) {
+        Step& stcStep = m_vecSteps[i];
+        for (const auto& strDep : stcStep.vecDependNames) {
+            size_t j = 0;
+            while (j < i && m_vecSteps[j].strName != strDep) j++;
+            if (j == i) {
+                strFailedStep = stcStep.strName;
+                strError = "未知的依赖步骤: " + strDep;
+                return false;
+            }
+            stcStep.vecDependsOn.push_back(j);
+        }
+    }
+
+    std::string strParentLabel = ExecutorTrace::CurrentLabel();
+    std::vector<std::thread> vecThreads;
+    size_t nRunning = 0;
+    bool bFailed = false;
+    m_ui64RunStartUs = ExecutorTrace::NowUs();
+
+    std::unique_lock<std::mutex> lock(m_mtxState);
+    while (true) {
+        // 2. 启动所有就绪的步骤（已有步骤失败时不再启动）
+        for (size_t i = 0; i < m_vecSteps.size() && !bFailed; i++) {
+            Step& stcStep = m_vecSteps[i];
+            if (stcStep.eState != StepState::Pending || !CanStart(stcStep)) {
+                continue;
+            }
+            stcStep.eState = StepState::Running;
+            stcStep.ui64StartUs = ExecutorTrace::NowUs();
+            m_vecHeldLocks.insert(m_vecHeldLocks.end(), stcStep.vecLocks.begin(), stcStep.vecLocks.end());
+            nRunning++;
+
+            vecThreads.emplace_back([this, i, strParentLabel]() {
+                // 工作线程：初始化COM（WMI调用需要），继承调用线程的操作标签
+#ifdef _WIN32
+                HRESULT hrCom = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+                Step& stcWork = m_vecSteps[i];
+                std::string strStepError;
+                bool bOk = false;
+                {
+                    ExecutorTrace::Scope objParent(strParentLabel);
+                    ExecutorTrace::Scope objStep(stcWork.strName);
+                    try {
+                        bOk = stcWork.fnRun(strStepError);
+                    } catch (const std::exception& e) {
+                        strStepError = e.what();
+                    } catch (...) {
+                        strStepError = "未处理的异常";
+                    }
+                }
+#ifdef _WIN32
+                if (SUCCEEDED(hrCom)) {
+                    CoUninitialize();
+                }
+#endif
+
+                {
+                    std::lock_guard<std::mutex> lockDone(m_mtxState);
+                    stcWork.eState = bOk ? StepState::Succeeded : StepState::Failed;
+                    stcWork.strError = std::move(strStepError);
+                    stcWork.ui64EndUs = ExecutorTrace::NowUs();
+                    m_deqFinished.push_back(i);
+                }
+                m_cvState.notify_all();
+            });
+        }
+        if (nRunning == 0) {
+            break;
+        }
+
+        // 3. 等待步骤结束，期间在调用线程上执行提交的任务
+        m_cvState.wait(lock, [this]() { return !m_deqFinished.empty() || !m_deqPosted.empty(); });
+        DrainPosted(lock);
+
+        // 4. 处理结束的步骤：释放资源锁，记录完成顺序或第一个失败
+        while (!m_deqFinished.empty()) {
+            Step& stcDone = m_vecSteps[m_deqFinished.front()];
+            size_t nIndex = m_deqFinished.front();
+            m_deqFinished.pop_front();
+            nRunning--;
+            for (const auto& strLock : stcDone.vecLocks) {
+                auto it = std::find(m_vecHeldLocks.begin(), m_vecHeldLocks.end(), strLock);
+                if (it != m_vecHeldLocks.end()) m_vecHeldLocks.erase(it);
+            }
+            if (stcDone.eState == StepState::Succeeded) {
+                m_vecCompleted.push_back(nIndex);
+            } else if (!bFailed) {
+                bFailed = true;
+                strFailedStep = stcDone.strName;
+                strError = stcDone.strError;
+            }
+        }
+    }
+
+    // 5. 回收工作线程，执行剩余的任务，未执行的步骤标记为跳过
+    lock.unlock();
+    for (auto& objThread : vecThreads) {
+        objThread.join();
+    }
+    lock.lock();
+    DrainPosted(lock);
+    for (auto& stcStep : m_vecSteps) {
+        if (stcStep.eState == StepState::Pending) {
+            stcStep.eState = StepState::Skipped;
+        }
+    }
+    m_ui64RunEndUs = ExecutorTrace::NowUs();
+    return !bFailed;
+}
+
+/********************************************************************************
+* 函数实现：回滚
+*********************************************************************************/
+void StepScheduler::Rollback() {
+    // 后完成的步骤可能依赖先完成的步骤的结果，因此逆序撤销
+    for (auto it = m_vecCompleted.rbegin(); it != m_vecCompleted.rend(); ++it) {
+        RollbackFunc fnRollback = std::move(m_vecSteps[*it].fnRollback);
+        m_vecSteps[*it].fnRollback = nullptr;
+        if (fnRollback) {
+            fnRollback();
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(m_mtxState);
+    DrainPosted(lock);
+}
+
+/********************************************************************************
+* 函数实现：关键路径报告
+*********************************************************************************/
+std::string StepScheduler::CriticalPathReport() const {
+    auto fnRan = [](const Step& stcStep) {
+        return stcStep.eState == StepState::Succeeded || stcStep.eState == StepState::Failed;
+    };
+
+    // 1. 找到最后结束的步骤
+    const Step* pLast = nullptr;
+    for (const auto& stcStep : m_vecSteps) {
+        if (fnRan(stcStep) && (!pLast || stcStep.ui64EndUs > pLast->ui64EndUs)) {
+            pLast = &stcStep;
+        }
+    }
+    if (!pLast) {
+        return std::string();
+    }
+
+    // 2. 等锁时间：依赖全部完成（没有依赖时为运行开始）到实际开始之间的时间
+    auto fnLockWaitUs = [this](const Step& stcStep) {
+        uint64_t ui64ReadyUs = m_ui64RunStartUs;
+        for (size_t nDep : stcStep.vecDependsOn) {
+            ui64ReadyUs = (std::max)(ui64ReadyUs, m_vecSteps[nDep].ui64EndUs);
+        }
+        return stcStep.ui64StartUs > ui64ReadyUs ? stcStep.ui64StartUs - ui64ReadyUs : 0;
+    };
+
+    // 3. 沿最晚结束的前驱向前回溯：依赖的步骤，或在本步骤开始前释放了同一把锁的步骤
+    struct PathNode {
+        const Step* pStep;
+        std::string strViaLock;   // 路径上后一个步骤等待的、由本步骤释放的锁（依赖边为空）
+    };
+    std::vector<PathNode> vecPath;
+    std::string strViaLock;
+    for (const Step* pStep = pLast; pStep; ) {
+        vecPath.push_back({ pStep, strViaLock });
+        const Step* pPrev = nullptr;
+        strViaLock.clear();
+        for (size_t nDep : pStep->vecDependsOn) {
+            const Step& stcDep = m_vecSteps[nDep];
+            if (!pPrev || stcDep.ui64EndUs > pPrev->ui64EndUs) {
+                pPrev = &stcDep;
+            }
+        }
+        for (const auto& stcOther : m_vecSteps) {
+            if (&stcOther == pStep || !fnRan(stcOther) || stcOther.ui64EndUs > pStep->ui64StartUs ||
+                (pPrev && stcOther.ui64EndUs <= pPrev->ui64EndUs)) {
+                continue;
+            }
+            for (const auto& strLock : pStep->vecLocks) {
+                if (std::find(stcOther.vecLocks.begin(), stcOther.vecLocks.end(), strLock) != stcOther.vecLocks.end()) {
+                    pPrev = &stcOther;
+                    strViaLock = strLock;
+                    break;
+                }
+            }
+        }
+        pStep = pPrev;
+    }
+    std::reverse(vecPath.begin(), vecPath.end());
+
+    // 4. 格式化：每个步骤的耗时和等锁时间，以及整条路径、整次运行和所有步骤的等锁时间
+    std::string strReport;
+    for (size_t i = 0; i < vecPath.size(); i++) {
+        const Step& stcStep = *vecPath[i].pStep;
+        if (i > 0) {
+            strReport += vecPath[i - 1].strViaLock.empty() ? " -> " : " -[" + vecPath[i - 1].strViaLock + "]-> ";
+        }
+        strReport += stcStep.strName + " " + std::to_string((stcStep.ui64EndUs - stcStep.ui64StartUs) / 1000) + "ms";
+        uint64_t ui64WaitUs = fnLockWaitUs(stcStep);
+        if (ui64WaitUs >= 1000) {
+            strReport += "（等锁 " + std::to_string(ui64WaitUs / 1000) + "ms）";
+        }
+    }
+    uint64_t ui64TotalWaitUs = 0;
+    for (const auto& stcStep : m_vecSteps) {
+        if (fnRan(stcStep)) {
+            ui64TotalWaitUs += fnLockWaitUs(stcStep);
+        }
+    }
+    uint64_t ui64PathUs = pLast->ui64EndUs - vecPath.front().pStep->ui64StartUs;
+    strReport += "（路径 " + std::to_string(ui64PathUs / 1000) + "ms / 总耗时 " +
+                 std::to_string((m_ui64RunEndUs - m_ui64RunStartUs) / 1000) + "ms / 等锁 " +
+                 std::to_string(ui64TotalWaitUs / 1000) + "ms）";
+    return strReport;
+}
@@ -0,0 +1,169 @@
+﻿/********************************************************************************
+* 文件名称：StepScheduler.h
+* 文件功能：按依赖关系并发执行配置步骤的调度器
+*
+* 类说明：
+*    配置流程中的许多步骤彼此独立（例如备份查询与停止虚拟机、挂载磁盘与
+*    修改虚拟机设置），顺序执行会白白等待。StepScheduler把流程表示为
+*    有向无环图：
+*    - 每个步骤声明依赖的步骤（全部成功后才能开始）和需要的资源锁
+*      （例如"vm:<名称>"、"vhd:<名称>"，持有同一把锁的步骤不会同时执行）
+*    - 调度器在工作线程上并发执行所有就绪的步骤
+*    - 任一步骤失败后不再启动新步骤，等待进行中的步骤结束后返回；
+*      Rollback按完成顺序的逆序执行已完成步骤的回滚函数
+*    - 每次运行后可以取得关键路径（决定总耗时的依赖链）
+*
+* 线程说明：
+*    - 步骤函数在工作线程上执行（已初始化COM多线程套间），操作标签继承
+*      调用Run的线程的标签并追加步骤名
+*    - 步骤中需要在调用线程上执行的操作（例如写界面日志）通过Post提交，
+*      Run在等待期间于调用线程上依次执行
+*    - 回滚函数在调用Rollback的线程上执行
+*
+* 依赖项：
+*    - ExecutorTrace（计时、操作标签）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstdint>
+
+/********************************************************************************
+* 类名称：步骤调度器
+* 类功能：依赖图 + 资源锁的并发步骤执行
+*
+* 调用示例：
+*    StepScheduler objScheduler;
+*    objScheduler.AddStep("StopVM", {}, {"vm:Win11"}, [&](std::string& strError) { ... });
+*    objScheduler.AddStep("BackupState", {}, {}, [&](std::string& strError) { ... });
+*    objScheduler.AddStep("Prepare", {"StopVM", "BackupState"}, {"vm:Win11"},
+*                         [&](std::string& strError) { ... }, [&]() { ... 回滚 ... });
+*    std::string strFailedStep, strError;
+*    if (!objScheduler.Run(strFailedStep, strError)) {
+*        objScheduler.Rollback();
+*    }
+*    std::string strPath = objScheduler.CriticalPathReport();
+*********************************************************************************/
+class StepScheduler {
+public:
+    // 步骤函数：成功返回true，失败时写入错误信息
+    using StepFunc = std::function<bool(std::string& strError)>;
+    // 回滚函数：撤销已完成步骤的效果
+    using RollbackFunc = std::function<void()>;
+
+    StepScheduler() = default;
+    StepScheduler(const StepScheduler&) = delete;
+    StepScheduler& operator=(const StepScheduler&) = delete;
+
+    /********************************************************************************
+    * 函数名称：添加步骤
+    * 函数参数：
+    *    [IN]  const std::string& strName：步骤名称（唯一）
+    *    [IN]  std::vector<std::string> vecDependsOn：依赖的步骤名称（必须已添加）
+    *    [IN]  std::vector<std::string> vecLocks：需要独占的资源锁名称
+    *    [IN]  StepFunc fnRun：步骤函数
+    *    [IN]  RollbackFunc fnRollback：回滚函数（可为空）
+    * 返回类型：StepScheduler&
+    *    调度器自身，便于链式调用
+    * 注意事项：
+    *    - 依赖只能指向先添加的步骤，因此图中不会出现环
+    *    - 多个步骤同时就绪且争用同一把锁时，先添加的步骤优先
+    *********************************************************************************/
+    StepScheduler& AddStep(const std::string& strName,
+                           std::vector<std::string> vecDependsOn,
+                           std::vector<std::string> vecLocks,
+                           StepFunc fnRun,
+                           RollbackFunc fnRollback = nullptr);
+
+    /********************************************************************************
+    * 函数名称：提交到调用线程
+    * 函数功能：把任务交给Run所在的线程执行（可以在任何线程调用）
+    * 函数参数：
+    *    [IN]  std::function<void()> fnTask：任务
+    *********************************************************************************/
+    void Post(std::function<void()> fnTask);
+
+    /********************************************************************************
+    * 函数名称：执行所有步骤
+    * 函数参数：
+    *    [OUT] std::string& strFailedStep：失败的步骤名称（成功时为空）
+    *    [OUT] std::string& strError：失败时的错误信息
+    * 返回类型：bool
+    *    所有步骤成功返回true；有步骤失败或依赖声明错误返回false
+    * 注意事项：
+    *    - 返回前等待所有已启动的步骤结束，并执行完所有Post提交的任务
+    *    - 只能调用一次
+    *********************************************************************************/
+    bool Run(std::string& strFailedStep, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：回滚
+    * 函数功能：按完成顺序的逆序执行已成功步骤的回滚函数
+    * 注意事项：
+    *    - 应在Run返回false后调用；每个回滚函数最多执行一次
+    *********************************************************************************/
+    void Rollback();
+
+    /********************************************************************************
+    * 函数名称：关键路径报告
+    * 返回类型：std::string
+    *    例如"StopVM 1520ms -> Prepare 830ms -[vm:Win11]-> AddGPUPartitionAdapter 610ms（等锁 400ms）
+    *    （路径 2960ms / 总耗时 3400ms / 等锁 400ms）"；没有执行过步骤时返回空字符串
+    * 说明：
+    *    从最后结束的步骤开始，每次沿最晚结束的前驱向前回溯。前驱是依赖的步骤，
+    *    或者在本步骤开始之前释放了同一把资源锁的步骤（本步骤因等待该锁而推迟，
+    *    以"-[锁名]->"表示）。等锁时间是依赖全部完成到实际开始之间的时间，
+    *    路径上的步骤单独标出，结尾给出所有步骤的等锁时间之和
+    *********************************************************************************/
+    std::string CriticalPathReport() const;
+
+private:
+    /********************************************************************************
+    * 枚举名称：步骤状态
+    *********************************************************************************/
+    enum class StepState {
+        Pending,    // 等待依赖或资源锁
+        Running,    // 正在工作线程上执行
+        Succeeded,  // 执行成功
+        Failed,     // 执行失败
+        Skipped     // 因其他步骤失败而未执行
+    };
+
+    /********************************************************************************
+    * 结构体名称：步骤
+    *********************************************************************************/
+    struct Step {
+        std::string              strName;            // 步骤名称
+        std::vector<size_t>      vecDependsOn;       // 依赖的步骤序号
+        std::vector<std::string> vecDependNames;     // 依赖的步骤名称（Run时解析）
+        std::vector<std::string> vecLocks;           // 资源锁名称
+        StepFunc                 fnRun;              // 步骤函数
+        RollbackFunc             fnRollback;         // 回滚函数
+        StepState                eState = StepState::Pending;
+        std::string              strError;           // 失败时的错误信息
+        uint64_t                 ui64StartUs = 0;    // 开始时刻
+        uint64_t                 ui64EndUs = 0;      // 结束时刻
+    };
+
+    std::vector<Step>                  m_vecSteps;       // 按添加顺序
+    std::vector<size_t>                m_vecCompleted;   // 成功步骤的完成顺序
+    std::vector<std::string>           m_vecHeldLocks;   // 当前被持有的资源锁
+    std::deque<std::function<void()>>  m_deqPosted;      // 等待在调用线程上执行的任务
+    std::deque<size_t>                 m_deqFinished;    // 已结束、尚未处理的步骤
+    std::mutex                         m_mtxState;       // 保护以上成员及步骤状态
+    std::condition_variable            m_cvState;        // 有步骤结束或有任务提交时通知
+    uint64_t                           m_ui64RunStartUs = 0;
+    uint64_t                           m_ui64RunEndUs = 0;
+
+    bool CanStart(const Step& stcStep) const;
+    bool DrainPosted(std::unique_lock<std::mutex>& lock);
+};
@@ -0,0 +1,291 @@
+﻿/********************************************************************************
+* 文件名称：TranscriptBackend.cpp
+* 文件功能：实现命令录制器、回放器和记录文件读写
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TranscriptBackend.h"
+#include "Utils.h"
+#include <fstream>
+#include <filesystem>
+#include <string_view>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+
+// 记录文件的第一行
+static const char* const TRANSCRIPT_HEADER = "# Smart-GPU-PV transcript v1";
+
+// 当前启用的录制/回放（由SetActive或StartFromEnvironment设置）
+static std::mutex                       g_mtxTranscript;
+static std::shared_ptr<CommandRecorder> g_pActive;
+static std::string                      g_strRecordPath;   // 录制模式下Finish保存的路径
+
+/********************************************************************************
+* 函数名称：读取环境变量（内部辅助函数）
+* 返回类型：std::string
+*    UTF-8编码的值，未设置时返回空字符串
+*********************************************************************************/
+static std::string GetEnvironmentUtf8(const char* pszName) {
+#ifdef _WIN32
+    std::wstring wstrName = Utils::StringToWString(pszName);
+    wchar_t szValue[MAX_PATH * 2] = { 0 };
+    DWORD dwLength = GetEnvironmentVariableW(wstrName.c_str(), szValue, static_cast<DWORD>(MAX_PATH * 2));
+    if (dwLength == 0 || dwLength >= MAX_PATH * 2) {
+        return std::string();
+    }
+    return Utils::WStringToString(std::wstring(szValue, dwLength));
+#else
+    const char* pszValue = std::getenv(pszName);
+    return pszValue ? std::string(pszValue) : std::string();
+#endif
+}
+
+/********************************************************************************
+* 函数名称：取出下一个以空格分隔的字段（内部辅助函数，保留空字段）
+*********************************************************************************/
+static std::string_view NextField(std::string_view& svRest) {
+    size_t nSpace = svRest.find(' ');
+    std::string_view svField = svRest.substr(0, nSpace);
+    svRest = (nSpace == std::string_view::npos) ? std::string_view() : svRest.substr(nSpace + 1);
+    return svField;
+}
+
+/********************************************************************************
+* 函数实现：保存记录文件
+*********************************************************************************/
+bool Transcript::Save(const std::string& strPath, const std::vector<TranscriptEntry>& vecEntries,
+                      std::string& strError) {
+    std::ofstream objFile(std::filesystem::path(Utils::StringToWString(strPath)), std::ios::binary);
+    if (!objFile) {
+        strError = "无法创建记录文件: " + strPath;
+        return false;
+    }
+
+    objFile << TRANSCRIPT_HEADER << "\n";
+    for (const auto& stcEntry : vecEntries) {
+        objFile << stcEntry.strKind << ' '
+                << stcEntry.ui64WallUs << ' '
+                << stcEntry.stcResult.ui64FirstByteUs << ' '
+                << stcEntry.stcResult.nExitCode << ' '
+                << (stcEntry.stcResult.bTimedOut ? 1 : 0) << ' '
+                << Utils::Base64Encode(stcEntry.strCommand) << ' '
+                << Utils::Base64Encode(stcEntry.stcResult.strOutput) << ' '
+                << Utils::Base64Encode(stcEntry.stcResult.strError) << "\n";
+    }
+    if (!objFile) {
+        strError = "写入记录文件失败: " + strPath;
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：加载记录文件
+*********************************************************************************/
+bool Transcript::Load(const std::string& strPath, std::vector<TranscriptEntry>& vecEntries,
+                      std::string& strError) {
+    std::ifstream objFile(std::filesystem::path(Utils::StringToWString(strPath)), std::ios::binary);
+    if (!objFile) {
+        strError = "无法打开记录文件: " + strPath;
+        return false;
+    }
+
+    vecEntries.clear();
+    std::string strLine;
+    size_t nLineNumber = 0;
+    while (std::getline(objFile, strLine)) {
+        nLineNumber++;
+        // 1. 跳过空行和注释
+        std::string_view svLine = Utils::TrimView(strLine);
+        if (svLine.empty() || svLine[0] == '#') {
+            continue;
+        }
+
+        // 2. 依次取出各字段（Base64字段可以为空）
+        std::string_view svKind = NextField(svLine);
+        std::string_view svWall = NextField(svLine);
+        std::string_view svFirstByte = NextField(svLine);
+        std::string_view svExitCode = NextField(svLine);
+        std::string_view svTimedOut = NextField(svLine);
+        std::string_view svCommand = NextField(svLine);
+        std::string_view svOutput = NextField(svLine);
+        std::string_view svError = NextField(svLine);
+
+        TranscriptEntry stcEntry;
+        stcEntry.strKind.assign(svKind);
+        try {
+            stcEntry.ui64WallUs = std::stoull(std::string(svWall));
+            stcEntry.stcResult.ui64FirstByteUs = std::stoull(std::string(svFirstByte));
+            stcEntry.stcResult.nExitCode = std::stoi(std::string(svExitCode));
+        } catch (...) {
+            strError = "记录文件格式错误（第" + std::to_string(nLineNumber) + "行）: " + strPath;
+            return false;
+        }
+        stcEntry.stcResult.bTimedOut = (svTimedOut == "1");
+        if (svCommand.empty() ||
+            !Utils::Base64Decode(std::string(svCommand), stcEntry.strCommand) ||
+            !Utils::Base64Decode(std::string(svOutput), stcEntry.stcResult.strOutput) ||
+            !Utils::Base64Decode(std::string(svError), stcEntry.stcResult.strError)) {
+            strError = "记录文件格式错误（第" + std::to_string(nLineNumber) + "行）: " + strPath;
+            return false;
+        }
+        vecEntries.push_back(std::move(stcEntry));
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：取得当前启用的录制/回放
+*********************************************************************************/
+std::shared_ptr<CommandRecorder> Transcript::Active() {
+    std::lock_guard<std::mutex> lock(g_mtxTranscript);
+    return g_pActive;
+}
+
+/********************************************************************************
+* 函数实现：启用录制/回放
+*********************************************************************************/
+void Transcript::SetActive(std::shared_ptr<CommandRecorder> pRecorder) {
+    std::lock_guard<std::mutex> lock(g_mtxTranscript);
+    g_pActive = std::move(pRecorder);
+    g_strRecordPath.clear();
+}
+
+/********************************************************************************
+* 函数实现：按环境变量启用录制/回放
+* 注意事项：
+*    - 常驻宿主和WMI保持启用：录制点在执行器和WmiHelper的入口，
+*      录制的是生产路径上调用者看到的结果
+*********************************************************************************/
+bool Transcript::StartFromEnvironment(std::string& strError) {
+    std::string strReplayPath = GetEnvironmentUtf8("SMARTGPUPV_REPLAY");
+    std::string strRecordPath = GetEnvironmentUtf8("SMARTGPUPV_RECORD");
+    if (strReplayPath.empty() && strRecordPath.empty()) {
+        return true;
+    }
+
+    if (!strReplayPath.empty()) {
+        // 1. 回放：加载记录文件，读取耗时倍数（无效时不等待）
+        std::vector<TranscriptEntry> vecEntries;
+        if (!Load(strReplayPath, vecEntries, strError)) {
+            return false;
+        }
+        double dTimeScale = 0.0;
+        std::string strScale = GetEnvironmentUtf8("SMARTGPUPV_REPLAY_SCALE");
+        if (!strScale.empty()) {
+            try {
+                dTimeScale = std::stod(strScale);
+            } catch (...) {
+                dTimeScale = 0.0;
+            }
+        }
+        SetActive(std::make_shared<TranscriptReplayer>(std::move(vecEntries), dTimeScale < 0 ? 0.0 : dTimeScale));
+    } else {
+        // 2. 录制：退出时由Finish保存
+        SetActive(std::make_shared<TranscriptRecorder>());
+        std::lock_guard<std::mutex> lock(g_mtxTranscript);
+        g_strRecordPath = strRecordPath;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：结束录制/回放
+*********************************************************************************/
+bool Transcript::Finish(std::string& strError) {
+    std::shared_ptr<CommandRecorder> pActive;
+    std::string strRecordPath;
+    {
+        std::lock_guard<std::mutex> lock(g_mtxTranscript);
+        pActive = g_pActive;
+        strRecordPath = g_strRecordPath;
+    }
+
+    if (auto pRecorder = std::dynamic_pointer_cast<TranscriptRecorder>(pActive)) {
+        return strRecordPath.empty() || Save(strRecordPath, pRecorder->GetEntries(), strError);
+    }
+    auto pReplayer = std::dynamic_pointer_cast<TranscriptReplayer>(pActive);
+    if (pReplayer && pReplayer->GetMissCount() > 0) {
+        strError = "回放时有 " + std::to_string(pReplayer->GetMissCount()) + " 条命令不在记录文件中";
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：录制一条命令
+*********************************************************************************/
+void TranscriptRecorder::Record(const std::string& strKind, const std::string& strCommand,
+                                const CommandResult& stcResult, uint64_t ui64WallUs) {
+    TranscriptEntry stcEntry;
+    stcEntry.strKind = strKind;
+    stcEntry.strCommand = strCommand;
+    stcEntry.stcResult = stcResult;
+    stcEntry.ui64WallUs = ui64WallUs;
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    m_vecEntries.push_back(std::move(stcEntry));
+}
+
+/********************************************************************************
+* 函数实现：获取已录制的条目
+*********************************************************************************/
+std::vector<TranscriptEntry> TranscriptRecorder::GetEntries() const {
+    std::lock_guard<std::mutex> lock(m_mtxEntries);
+    return m_vecEntries;
+}
+
+/********************************************************************************
+* 函数实现：回放器构造函数
+*********************************************************************************/
+TranscriptReplayer::TranscriptReplayer(std::vector<TranscriptEntry> vecEntries, double dTimeScale)
+    : m_dTimeScale(dTimeScale) {
+    for (auto& stcEntry : vecEntries) {
+        std::string strKey = stcEntry.strKind + '\n' + stcEntry.strCommand;
+        m_mapQueues[strKey].vecEntries.push_back(std::move(stcEntry));
+    }
+}
+
+/********************************************************************************
+* 函数实现：回放一条命令
+*********************************************************************************/
+bool TranscriptReplayer::Replay(const std::string& strKind, const std::string& strCommand, CommandResult& stcResult) {
+    // 1. 按方式和命令查找，依次返回；用完后重复返回最后一条
+    TranscriptEntry stcEntry;
+    {
+        std::lock_guard<std::mutex> lock(m_mtxReplay);
+        auto it = m_mapQueues.find(strKind + '\n' + strCommand);
+        if (it == m_mapQueues.end()) {
+            m_nMisses++;
+            stcResult = CommandResult();
+            stcResult.strError = "回放记录中没有该命令";
+            return false;
+        }
+        Queue& stcQueue = it->second;
+        stcEntry = stcQueue.vecEntries[stcQueue.nNext];
+        if (stcQueue.nNext + 1 < stcQueue.vecEntries.size()) {
+            stcQueue.nNext++;
+        }
+    }
+
+    // 2. 按倍数模拟原始耗时（不持有锁，并行的命令可以同时等待）
+    stcResult = std::move(stcEntry.stcResult);
+    stcResult.ui64FirstByteUs = static_cast<uint64_t>(stcResult.ui64FirstByteUs * m_dTimeScale);
+    stcResult.ui64SpawnUs = 0;
+    uint64_t ui64DelayUs = static_cast<uint64_t>(stcEntry.ui64WallUs * m_dTimeScale);
+    if (ui64DelayUs > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(ui64DelayUs));
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：获取未命中次数
+*********************************************************************************/
+size_t TranscriptReplayer::GetMissCount() const {
+    std::lock_guard<std::mutex> lock(m_mtxReplay);
+    return m_nMisses;
+}
@@ -0,0 +1,245 @@
+﻿/********************************************************************************
+* 文件名称：TranscriptBackend.h
+* 文件功能：在执行器和WMI这一层录制和回放PowerShell命令与WMI调用
+*
+* 类说明：
+*    配置流程只能在真实的Hyper-V主机上运行，无法在其他机器上做性能测试或
+*    回归测试。这里提供CommandRecorder接口的两个实现：
+*    1. TranscriptRecorder：PowerShellExecutor和WmiHelper执行完每条命令或
+*       查询后把命令文本、整理后的结果和耗时交给它，结束时保存为记录文件
+*    2. TranscriptReplayer：按命令文本返回录制的结果，执行器和WmiHelper
+*       不再执行命令、不连接WMI；可以按原始耗时（或按比例缩放）等待，也可以
+*       立即返回
+*
+* 录制点：
+*    录制发生在PowerShellExecutor和WmiHelper的入口，而不是进程后端：
+*    常驻宿主、批量执行、WMI等生产路径在录制时照常工作，记录的是调用者看到
+*    的结果。回放时同一条命令无论经过宿主还是独立进程都能命中。
+*    - run：ExecuteWithCheck等单条执行和批次中的每条命令
+*    - stream / async：流式执行和异步执行
+*    - wmi：WQL查询，输出为全部对象属性的快照
+*    - wmimethod：WMI方法调用，键包含对象路径、方法名和输入参数，
+*      退出码为HRESULT，输出为输出参数
+*    不经过这两层的操作（直接读写虚拟磁盘、复制驱动文件）不录制：回放
+*    ConfigureGPUPV时录制时的虚拟磁盘文件必须在同一路径上。
+*
+* 记录文件格式（UTF-8文本，每条记录一行，字段以空格分隔）：
+*    <方式> <总耗时us> <首字节us> <退出码> <超时0/1> <Base64(命令)> <Base64(标准输出)> <Base64(错误输出)>
+*    以#开头的行是注释
+*
+* 回放匹配规则：
+*    - 按方式和命令文本匹配，同一命令的多条记录按录制顺序依次返回，用完后
+*      重复返回最后一条（例如多次查询虚拟机状态）
+*    - 命令不在记录中时返回失败结果（退出码-1），并计入未命中次数
+*
+* 环境变量（由Transcript::StartFromEnvironment读取）：
+*    SMARTGPUPV_RECORD=<文件>        录制到指定文件
+*    SMARTGPUPV_REPLAY=<文件>        从指定文件回放
+*    SMARTGPUPV_REPLAY_SCALE=<倍数>  回放耗时倍数，默认0（不等待），1为原始耗时
+*
+* 依赖项：
+*    - ProcessBackend（CommandResult）
+*    - Utils（Base64编码）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "ProcessBackend.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+/********************************************************************************
+* 结构体名称：记录条目
+*********************************************************************************/
+struct TranscriptEntry {
+    std::string   strKind;             // 方式：run / stream / async / wmi / wmimethod
+    std::string   strCommand;          // 命令文本（WMI为命名空间和查询）
+    CommandResult stcResult;           // 退出码、超时标志、整理后的输出
+    uint64_t      ui64WallUs = 0;      // 总耗时（微秒）
+};
+
+/********************************************************************************
+* 类名称：命令录制/回放接口
+* 类功能：PowerShellExecutor和WmiHelper执行命令前询问是否回放，执行后交给它录制
+*********************************************************************************/
+class CommandRecorder {
+public:
+    virtual ~CommandRecorder() = default;
+
+    /********************************************************************************
+    * 函数名称：是否为回放模式
+    * 返回类型：bool
+    *    true时调用者不执行命令，所有结果都来自Replay()
+    *********************************************************************************/
+    virtual bool IsReplaying() const = 0;
+
+    /********************************************************************************
+    * 函数名称：回放一条命令
+    * 函数参数：
+    *    [IN]  const std::string& strKind：方式
+    *    [IN]  const std::string& strCommand：命令文本
+    *    [OUT] CommandResult& stcResult：录制的结果（未命中时为失败结果）
+    * 返回类型：bool
+    *    找到记录返回true
+    *********************************************************************************/
+    virtual bool Replay(const std::string& strKind, const std::string& strCommand, CommandResult& stcResult) = 0;
+
+    /********************************************************************************
+    * 函数名称：录制一条命令
+    * 函数参数：
+    *    [IN]  const std::string& strKind：方式
+    *    [IN]  const std::string& strCommand：命令文本
+    *    [IN]  const CommandResult& stcResult：整理后的结果
+    *    [IN]  uint64_t ui64WallUs：总耗时（微秒）
+    *********************************************************************************/
+    virtual void Record(const std::string& strKind, const std::string& strCommand, const CommandResult& stcResult,
+                        uint64_t ui64WallUs) = 0;
+};
+
+/********************************************************************************
+* 类名称：记录文件读写
+* 类功能：记录文件的加载、保存，以及当前启用的录制/回放
+*********************************************************************************/
+class Transcript {
+public:
+    /********************************************************************************
+    * 函数名称：保存记录文件
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径（UTF-8）
+    *    [IN]  const std::vector<TranscriptEntry>& vecEntries：记录条目
+    *    [OUT] std::string& strError：失败时的错误信息
+    * 返回类型：bool
+    *    保存成功返回true
+    *********************************************************************************/
+    static bool Save(const std::string& strPath, const std::vector<TranscriptEntry>& vecEntries,
+                     std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：加载记录文件
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径（UTF-8）
+    *    [OUT] std::vector<TranscriptEntry>& vecEntries：记录条目
+    *    [OUT] std::string& strError：失败时的错误信息（含出错的行号）
+    * 返回类型：bool
+    *    加载成功返回true
+    *********************************************************************************/
+    static bool Load(const std::string& strPath, std::vector<TranscriptEntry>& vecEntries,
+                     std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：取得当前启用的录制/回放
+    * 返回类型：std::shared_ptr<CommandRecorder>
+    *    未启用时返回nullptr
+    *********************************************************************************/
+    static std::shared_ptr<CommandRecorder> Active();
+
+    /********************************************************************************
+    * 函数名称：启用录制/回放
+    * 函数参数：
+    *    [IN]  std::shared_ptr<CommandRecorder> pRecorder：录制或回放对象，nullptr表示停用
+    * 注意事项：
+    *    - 应在执行任何命令之前调用
+    *********************************************************************************/
+    static void SetActive(std::shared_ptr<CommandRecorder> pRecorder);
+
+    /********************************************************************************
+    * 函数名称：按环境变量启用录制/回放
+    * 函数功能：设置了SMARTGPUPV_RECORD或SMARTGPUPV_REPLAY时启用对应的录制或回放
+    * 函数参数：
+    *    [OUT] std::string& strError：失败时的错误信息
+    * 返回类型：bool
+    *    未设置环境变量或启用成功返回true，记录文件无法加载返回false
+    * 注意事项：
+    *    - 应在执行任何命令之前调用（通常在程序启动时）
+    *********************************************************************************/
+    static bool StartFromEnvironment(std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：结束录制/回放
+    * 函数功能：录制模式下保存记录文件；回放模式下有未命中的命令时返回错误
+    * 函数参数：
+    *    [OUT] std::string& strError：失败时的错误信息
+    * 返回类型：bool
+    *    未启用、保存成功或回放全部命中返回true
+    *********************************************************************************/
+    static bool Finish(std::string& strError);
+};
+
+/********************************************************************************
+* 类名称：录制器
+* 类功能：保存执行器和WmiHelper交来的每条命令的结果和耗时
+*
+* 调用示例：
+*    auto pRecorder = std::make_shared<TranscriptRecorder>();
+*    Transcript::SetActive(pRecorder);
+*    // ... 执行配置流程 ...
+*    Transcript::Save("C:\\Temp\\configure.sgpt", pRecorder->GetEntries(), strError);
+*********************************************************************************/
+class TranscriptRecorder : public CommandRecorder {
+public:
+    bool IsReplaying() const override { return false; }
+    bool Replay(const std::string&, const std::string&, CommandResult&) override { return false; }
+    void Record(const std::string& strKind, const std::string& strCommand, const CommandResult& stcResult,
+                uint64_t ui64WallUs) override;
+
+    /********************************************************************************
+    * 函数名称：获取已录制的条目
+    * 返回类型：std::vector<TranscriptEntry>
+    *    按完成顺序排列的记录条目（副本）
+    *********************************************************************************/
+    std::vector<TranscriptEntry> GetEntries() const;
+
+private:
+    mutable std::mutex            m_mtxEntries;  // 保护m_vecEntries（异步完成在其他线程）
+    std::vector<TranscriptEntry>  m_vecEntries;  // 已录制的条目
+};
+
+/********************************************************************************
+* 类名称：回放器
+* 类功能：按方式和命令文本返回记录文件中的结果
+*
+* 调用示例：
+*    Transcript::SetActive(std::make_shared<TranscriptReplayer>(vecEntries, 1.0));
+*********************************************************************************/
+class TranscriptReplayer : public CommandRecorder {
+public:
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  std::vector<TranscriptEntry> vecEntries：记录条目
+    *    [IN]  double dTimeScale：耗时倍数，0表示立即返回，1表示按原始耗时等待
+    *********************************************************************************/
+    TranscriptReplayer(std::vector<TranscriptEntry> vecEntries, double dTimeScale);
+
+    bool IsReplaying() const override { return true; }
+    bool Replay(const std::string& strKind, const std::string& strCommand, CommandResult& stcResult) override;
+    void Record(const std::string&, const std::string&, const CommandResult&, uint64_t) override {}
+
+    /********************************************************************************
+    * 函数名称：获取未命中次数
+    * 返回类型：size_t
+    *    命令不在记录中的调用次数
+    *********************************************************************************/
+    size_t GetMissCount() const;
+
+private:
+    /********************************************************************************
+    * 结构体名称：同一命令的记录队列
+    *********************************************************************************/
+    struct Queue {
+        std::vector<TranscriptEntry> vecEntries;   // 按录制顺序排列
+        size_t                       nNext = 0;    // 下一条要返回的记录
+    };
+
+    mutable std::mutex           m_mtxReplay;      // 保护以下成员
+    std::map<std::string, Queue> m_mapQueues;      // 方式+命令 -> 记录队列
+    size_t                       m_nMisses = 0;    // 未命中次数
+    double                       m_dTimeScale;     // 耗时倍数
+};
@@ -12,12 +12,16 @@
 *********************************************************************************/
 
 #include "Utils.h"
+#include "GbkTable.h"
 #include <sstream>
 #include <algorithm>
 #include <locale>
 #include <codecvt>
 #include <cstdio>
+#include <cstring>
+#include <cstdint>
 
+#ifdef _WIN32
 /********************************************************************************
 * 函数实现：窄字符串转宽字符串
 *********************************************************************************/
@@ -64,6 +68,136 @@ std::string Utils::WStringToString(const std::wstring& wstr) {
     return str;
 }
 
+#else
+/********************************************************************************
+* 函数实现：窄字符串转宽字符串（wchar_t为UTF-32的平台）
+*********************************************************************************/
+std::wstring Utils::StringToWString(const std::string& str) {
+    std::wstring wstr;
+    wstr.reserve(str.size());
+    const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(str.data());
+    size_t nPos = 0;
+    while (nPos < str.size()) {
+        // 1. 无效序列替换为U+FFFD，与MultiByteToWideChar的行为一致
+        size_t nInvalid = FindInvalidUTF8(std::string_view(str).substr(nPos, 4));
+        unsigned char ucLead = pBytes[nPos];
+        size_t nLength = (ucLead < 0x80) ? 1 : (ucLead < 0xE0) ? 2 : (ucLead < 0xF0) ? 3 : 4;
+        if (nInvalid == 0 || nPos + nLength > str.size()) {
+            wstr += static_cast<wchar_t>(0xFFFD);
+            nPos++;
+            continue;
+        }
+
+        // 2. 解码一个码点
+        uint32_t ui32Code = (nLength == 1) ? ucLead : (ucLead & (0x7F >> nLength));
+        for (size_t i = 1; i < nLength; i++) {
+            ui32Code = (ui32Code << 6) | (pBytes[nPos + i] & 0x3F);
+        }
+        wstr += static_cast<wchar_t>(ui32Code);
+        nPos += nLength;
+    }
+    return wstr;
+}
+
+/********************************************************************************
+* 函数实现：宽字符串转窄字符串（wchar_t为UTF-32的平台）
+*********************************************************************************/
+std::string Utils::WStringToString(const std::wstring& wstr) {
+    std::string str;
+    str.reserve(wstr.size());
+    for (wchar_t wch : wstr) {
+        uint32_t ui32Code = static_cast<uint32_t>(wch);
+        if (ui32Code > 0x10FFFF || (ui32Code >= 0xD800 && ui32Code <= 0xDFFF)) {
+            ui32Code = 0xFFFD;
+        }
+        if (ui32Code < 0x80) {
+            str += static_cast<char>(ui32Code);
+        } else if (ui32Code < 0x800) {
+            str += static_cast<char>(0xC0 | (ui32Code >> 6));
+            str += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        } else if (ui32Code < 0x10000) {
+            str += static_cast<char>(0xE0 | (ui32Code >> 12));
+            str += static_cast<char>(0x80 | ((ui32Code >> 6) & 0x3F));
+            str += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        } else {
+            str += static_cast<char>(0xF0 | (ui32Code >> 18));
+            str += static_cast<char>(0x80 | ((ui32Code >> 12) & 0x3F));
+            str += static_cast<char>(0x80 | ((ui32Code >> 6) & 0x3F));
+            str += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        }
+    }
+    return str;
+}
+#endif
+
+/********************************************************************************
+* 函数实现：Base64编码
+*********************************************************************************/
+std::string Utils::Base64Encode(const std::string& strData) {
+    static const char szAlphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    
+    // 1. 预分配结果缓冲区（每3字节输出4字符）
+    std::string strResult;
+    strResult.reserve((strData.size() + 2) / 3 * 4);
+    
+    // 2. 每次处理3个字节
+    size_t i = 0;
+    const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(strData.data());
+    for (; i + 2 < strData.size(); i += 3) {
+        uint32_t nTriple = (pBytes[i] << 16) | (pBytes[i + 1] << 8) | pBytes[i + 2];
+        strResult += szAlphabet[(nTriple >> 18) & 0x3F];
+        strResult += szAlphabet[(nTriple >> 12) & 0x3F];
+        strResult += szAlphabet[(nTriple >> 6) & 0x3F];
+        strResult += szAlphabet[nTriple & 0x3F];
+    }
+    
+    // 3. 处理剩余的1或2个字节并补齐'='
+    size_t nRemain = strData.size() - i;
+    if (nRemain > 0) {
+        uint32_t nTriple = pBytes[i] << 16;
+        if (nRemain == 2) nTriple |= pBytes[i + 1] << 8;
+        strResult += szAlphabet[(nTriple >> 18) & 0x3F];
+        strResult += szAlphabet[(nTriple >> 12) & 0x3F];
+        strResult += (nRemain == 2) ? szAlphabet[(nTriple >> 6) & 0x3F] : '=';
+        strResult += '=';
+    }
+    
+    return strResult;
+}
+
+/********************************************************************************
+* 函数实现：Base64解码
+*********************************************************************************/
+bool Utils::Base64Decode(const std::string& strEncoded, std::string& strData) {
+    strData.clear();
+    strData.reserve(strEncoded.size() / 4 * 3);
+    
+    // 1. 逐字符累积6位数据，满8位输出一个字节
+    uint32_t nBuffer = 0;
+    int nBits = 0;
+    for (char c : strEncoded) {
+        int nValue;
+        if (c >= 'A' && c <= 'Z') nValue = c - 'A';
+        else if (c >= 'a' && c <= 'z') nValue = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') nValue = c - '0' + 52;
+        else if (c == '+') nValue = 62;
+        else if (c == '/') nValue = 63;
+        else if (c == '=') break;                                  // 填充字符，结束
+        else if (c == '\r' || c == '\n' || c == ' ') continue;    // 忽略空白
+        else return false;                                         // 非法字符
+        
+        nBuffer = (nBuffer << 6) | static_cast<uint32_t>(nValue);
+        nBits += 6;
+        if (nBits >= 8) {
+            nBits -= 8;
+            strData += static_cast<char>((nBuffer >> nBits) & 0xFF);
+        }
+    }
+    
+    return true;
+}
+
 /********************************************************************************
 * 函数实现：字符串分割
 *********************************************************************************/
@@ -96,6 +230,45 @@ std::string Utils::Trim(const std::string& str) {
     return str.substr(nFirst, nLast - nFirst + 1);
 }
 
+/********************************************************************************
+* 函数实现：字符串视图修剪
+*********************************************************************************/
+std::string_view Utils::TrimView(std::string_view sv) {
+    // 1. 查找第一个非空白字符位置
+    size_t nFirst = sv.find_first_not_of(" \t\r\n");
+    if (nFirst == std::string_view::npos) return std::string_view();
+    
+    // 2. 查找最后一个非空白字符位置
+    size_t nLast = sv.find_last_not_of(" \t\r\n");
+    
+    // 3. 截取子视图
+    return sv.substr(nFirst, nLast - nFirst + 1);
+}
+
+/********************************************************************************
+* 函数实现：逐行读取
+*********************************************************************************/
+bool Utils::NextLine(std::string_view& svText, std::string_view& svLine) {
+    // 1. 文本已读完
+    if (svText.empty()) return false;
+    
+    // 2. 查找换行符，没有换行符时剩余文本即为最后一行
+    size_t nNewLine = svText.find('\n');
+    if (nNewLine == std::string_view::npos) {
+        svLine = svText;
+        svText = std::string_view();
+    } else {
+        svLine = svText.substr(0, nNewLine);
+        svText.remove_prefix(nNewLine + 1);
+    }
+    
+    // 3. 去掉Windows行尾的\r
+    if (!svLine.empty() && svLine.back() == '\r') {
+        svLine.remove_suffix(1);
+    }
+    return true;
+}
+
 /********************************************************************************
 * 函数实现：字符串包含检查
 *********************************************************************************/
@@ -112,7 +285,7 @@ std::string Utils::FormatVRAMSize(uint64_t ui64Bytes) {
     
     // 2. 格式化为字符串
     char szBuffer[64] = {0};
-    sprintf_s(szBuffer, "%.0fMB", dMB);
+    snprintf(szBuffer, sizeof(szBuffer), "%.0fMB", dMB);
     
     return std::string(szBuffer);
 }
@@ -247,6 +420,7 @@ std::string Utils::ExtractJsonValue(const std::string& strJson, const std::strin
     return Trim(strJson.substr(nValueStart, nValueEnd - nValueStart));
 }
 
+#ifdef _WIN32
 /********************************************************************************
 * 函数实现：追加日志到编辑框
 *********************************************************************************/
@@ -289,73 +463,288 @@ void Utils::ShowError(HWND hWnd, const std::wstring& wstrMessage) {
 void Utils::ShowInfo(HWND hWnd, const std::wstring& wstrMessage) {
     MessageBox(hWnd, wstrMessage.c_str(), L"信息", MB_OK | MB_ICONINFORMATION);
 }
+#endif
 
 /********************************************************************************
-* 函数实现：检查UTF-8有效性
+* UTF-8检查的ASCII快速路径：x86/x64上使用SSE2，CPU支持时使用AVX2
+*    MSVC（_M_X64/_M_IX86）和GCC/Clang（__SSE2__）都启用；AVX2函数在GCC/Clang
+*    上以target("avx2")单独编译，不要求整个程序使用-mavx2，运行时按CPU选择
+*********************************************************************************/
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define UTILS_UTF8_SIMD 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#define UTILS_TARGET_AVX2
+#else
+#define UTILS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#include <immintrin.h>
+
+/********************************************************************************
+* 函数实现：最低置位的位置（内部辅助，uMask非零）
+*********************************************************************************/
+static inline size_t LowestSetBit(unsigned int uMask) {
+#ifdef _MSC_VER
+    unsigned long ulIndex = 0;
+    _BitScanForward(&ulIndex, uMask);
+    return ulIndex;
+#else
+    return static_cast<size_t>(__builtin_ctz(uMask));
+#endif
+}
+
+/********************************************************************************
+* 函数实现：检测CPU和操作系统是否支持AVX2（内部辅助）
+*********************************************************************************/
+static bool DetectAVX2() {
+#ifndef _MSC_VER
+    // libgcc/compiler-rt同时检查CPUID和操作系统是否保存YMM寄存器状态
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    int arrInfo[4] = { 0 };
+    __cpuid(arrInfo, 0);
+    if (arrInfo[0] < 7) return false;
+
+    // 1. CPU支持AVX且操作系统启用了XSAVE
+    __cpuid(arrInfo, 1);
+    bool bOsxsave = (arrInfo[2] & (1 << 27)) != 0;
+    bool bAvx = (arrInfo[2] & (1 << 28)) != 0;
+    if (!bOsxsave || !bAvx) return false;
+
+    // 2. 操作系统保存YMM寄存器状态
+    if ((_xgetbv(0) & 0x6) != 0x6) return false;
+
+    // 3. CPU支持AVX2
+    __cpuidex(arrInfo, 7, 0);
+    return (arrInfo[1] & (1 << 5)) != 0;
+#endif
+}
+
+/********************************************************************************
+* 函数实现：跳过ASCII字节（AVX2，内部辅助）
+*********************************************************************************/
+UTILS_TARGET_AVX2
+static size_t SkipAsciiAVX2(const unsigned char* pBytes, size_t nPos, size_t nSize) {
+    while (nSize - nPos >= 32) {
+        __m256i vecChunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pBytes + nPos));
+        unsigned int uMask = static_cast<unsigned int>(_mm256_movemask_epi8(vecChunk));
+        if (uMask != 0) {
+            return nPos + LowestSetBit(uMask);
+        }
+        nPos += 32;
+    }
+    return nPos;
+}
+
+static const Utils::Utf8Simd g_eBestSimd = DetectAVX2() ? Utils::Utf8Simd::AVX2 : Utils::Utf8Simd::SSE2;
+#else
+static const Utils::Utf8Simd g_eBestSimd = Utils::Utf8Simd::Scalar;
+#endif
+
+/********************************************************************************
+* 函数实现：跳过ASCII字节（内部辅助）
+* 返回nPos之后第一个非ASCII字节的位置，全部是ASCII时返回nSize
 *********************************************************************************/
-bool Utils::IsValidUTF8(const std::string& str) {
-    // 1. 获取字节指针
-    const unsigned char* pBytes = (const unsigned char*)str.c_str();
-    
-    // 2. 逐字节检查UTF-8编码规则
-    while (*pBytes) {
-        if ((*pBytes & 0x80) == 0) {
-            // 2.1 ASCII字符（0xxxxxxx）
-            pBytes++;
-        } else if ((*pBytes & 0xE0) == 0xC0) {
-            // 2.2 双字节字符（110xxxxx 10xxxxxx）
-            if ((pBytes[1] & 0xC0) != 0x80) return false;
-            pBytes += 2;
-        } else if ((*pBytes & 0xF0) == 0xE0) {
-            // 2.3 三字节字符（1110xxxx 10xxxxxx 10xxxxxx）
-            if ((pBytes[1] & 0xC0) != 0x80 || (pBytes[2] & 0xC0) != 0x80) return false;
-            pBytes += 3;
-        } else if ((*pBytes & 0xF8) == 0xF0) {
-            // 2.4 四字节字符（11110xxx 10xxxxxx 10xxxxxx 10xxxxxx）
-            if ((pBytes[1] & 0xC0) != 0x80 || (pBytes[2] & 0xC0) != 0x80 || (pBytes[3] & 0xC0) != 0x80) 
-                return false;
-            pBytes += 4;
+static size_t SkipAscii(const unsigned char* pBytes, size_t nPos, size_t nSize, Utils::Utf8Simd eSimd) {
+#ifdef UTILS_UTF8_SIMD
+    // 1. 一次检查32/16字节：movemask取每个字节的最高位，非零即含非ASCII字节
+    if (eSimd == Utils::Utf8Simd::AVX2) {
+        nPos = SkipAsciiAVX2(pBytes, nPos, nSize);
+    }
+    while (eSimd != Utils::Utf8Simd::Scalar && nSize - nPos >= 16) {
+        __m128i vecChunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pBytes + nPos));
+        unsigned int uMask = static_cast<unsigned int>(_mm_movemask_epi8(vecChunk));
+        if (uMask != 0) {
+            return nPos + LowestSetBit(uMask);
+        }
+        nPos += 16;
+    }
+#endif
+
+    // 2. 标量实现一次检查8字节
+    if (eSimd == Utils::Utf8Simd::Scalar) {
+        while (nSize - nPos >= 8) {
+            uint64_t ui64Chunk = 0;
+            memcpy(&ui64Chunk, pBytes + nPos, sizeof(ui64Chunk));
+            if (ui64Chunk & 0x8080808080808080ULL) break;
+            nPos += 8;
+        }
+    }
+
+    // 3. 剩余字节逐个检查
+    while (nPos < nSize && pBytes[nPos] < 0x80) {
+        nPos++;
+    }
+    return nPos;
+}
+
+/********************************************************************************
+* 函数实现：当前CPU可用的最快实现
+*********************************************************************************/
+Utils::Utf8Simd Utils::BestUTF8Simd() {
+    return g_eBestSimd;
+}
+
+/********************************************************************************
+* 函数实现：查找第一个无效的UTF-8字节
+*********************************************************************************/
+size_t Utils::FindInvalidUTF8(std::string_view str) {
+    return FindInvalidUTF8(str, g_eBestSimd);
+}
+
+size_t Utils::FindInvalidUTF8(std::string_view str, Utf8Simd eSimd) {
+    const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(str.data());
+    const size_t nSize = str.size();
+    size_t nPos = 0;
+    if (eSimd > g_eBestSimd) {
+        eSimd = g_eBestSimd;
+    }
+
+    while (true) {
+        // 1. 批量跳过ASCII字节
+        nPos = SkipAscii(pBytes, nPos, nSize, eSimd);
+        if (nPos >= nSize) {
+            return std::string_view::npos;
+        }
+
+        // 2. 按首字节确定序列长度和第二字节的取值范围
+        //    （E0/F0限制下界排除超长编码，ED排除代理区，F4限制上界为U+10FFFF）
+        unsigned char ucLead = pBytes[nPos];
+        size_t nLength = 0;
+        unsigned char ucLow = 0x80;
+        unsigned char ucHigh = 0xBF;
+        if (ucLead >= 0xC2 && ucLead <= 0xDF) {
+            nLength = 2;
+        } else if (ucLead == 0xE0) {
+            nLength = 3;
+            ucLow = 0xA0;
+        } else if (ucLead == 0xED) {
+            nLength = 3;
+            ucHigh = 0x9F;
+        } else if (ucLead >= 0xE1 && ucLead <= 0xEF) {
+            nLength = 3;
+        } else if (ucLead == 0xF0) {
+            nLength = 4;
+            ucLow = 0x90;
+        } else if (ucLead >= 0xF1 && ucLead <= 0xF3) {
+            nLength = 4;
+        } else if (ucLead == 0xF4) {
+            nLength = 4;
+            ucHigh = 0x8F;
         } else {
-            // 2.5 无效的UTF-8字节序列
-            return false;
+            return nPos;
         }
+
+        // 3. 检查后续字节
+        if (nSize - nPos < nLength) {
+            return nPos;
+        }
+        if (pBytes[nPos + 1] < ucLow || pBytes[nPos + 1] > ucHigh) {
+            return nPos;
+        }
+        for (size_t i = 2; i < nLength; i++) {
+            if ((pBytes[nPos + i] & 0xC0) != 0x80) {
+                return nPos;
+            }
+        }
+        nPos += nLength;
     }
-    
-    return true;
+}
+
+/********************************************************************************
+* 函数实现：检查UTF-8有效性
+*********************************************************************************/
+bool Utils::IsValidUTF8(std::string_view str) {
+    return FindInvalidUTF8(str) == std::string_view::npos;
 }
 
 /********************************************************************************
 * 函数实现：GBK转UTF-8
+* 注意事项：
+*    - 按GbkTable逐字符转换（与代码页936一致），不依赖平台的代码页支持
+*    - 无法映射的双字节组合、孤立的首字节和0xFF输出U+FFFD
 *********************************************************************************/
-std::string Utils::ConvertGBKToUTF8(const std::string& str) {
-    // 1. 先将GBK转换为宽字符（Unicode）
-    int nLen = MultiByteToWideChar(936, 0, str.c_str(), -1, NULL, 0);
-    if (nLen <= 0) return str;
-    
-    // 2. 分配缓冲区并执行转换
-    std::wstring wstr(nLen, 0);
-    MultiByteToWideChar(936, 0, str.c_str(), -1, &wstr[0], nLen);
-    
-    // 3. 移除末尾空字符
-    if (nLen > 0 && wstr[nLen-1] == L'\0') 
-        wstr.resize(nLen-1);
-    
-    // 4. 将宽字符转换为UTF-8
-    return WStringToString(wstr);
+std::string Utils::ConvertGBKToUTF8(std::string_view str) {
+    std::string strResult;
+    strResult.reserve(str.size() + str.size() / 2);
+    const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(str.data());
+    const size_t nSize = str.size();
+
+    for (size_t i = 0; i < nSize; i++) {
+        // 1. ASCII原样复制
+        unsigned char ucLead = pBytes[i];
+        if (ucLead < 0x80) {
+            strResult += static_cast<char>(ucLead);
+            continue;
+        }
+
+        // 2. 查表得到码点（0x80为欧元符号；首字节后没有合法尾字节时按单字节处理）
+        uint32_t ui32CodePoint = 0xFFFD;
+        if (ucLead == 0x80) {
+            ui32CodePoint = 0x20AC;
+        } else if (ucLead >= GBK_LEAD_FIRST && ucLead <= 0xFE && i + 1 < nSize &&
+                   pBytes[i + 1] >= GBK_TRAIL_FIRST && pBytes[i + 1] <= 0xFE && pBytes[i + 1] != 0x7F) {
+            uint16_t ui16Mapped = GBK_TO_UNICODE[(ucLead - GBK_LEAD_FIRST) * GBK_TRAIL_COUNT +
+                                                 (pBytes[i + 1] - GBK_TRAIL_FIRST)];
+            if (ui16Mapped != 0) {
+                ui32CodePoint = ui16Mapped;
+            }
+            i++;
+        }
+
+        // 3. 编码为UTF-8（表中只有基本多文种平面的码点）
+        if (ui32CodePoint < 0x800) {
+            strResult += static_cast<char>(0xC0 | (ui32CodePoint >> 6));
+            strResult += static_cast<char>(0x80 | (ui32CodePoint & 0x3F));
+        } else {
+            strResult += static_cast<char>(0xE0 | (ui32CodePoint >> 12));
+            strResult += static_cast<char>(0x80 | ((ui32CodePoint >> 6) & 0x3F));
+            strResult += static_cast<char>(0x80 | (ui32CodePoint & 0x3F));
+        }
+    }
+    return strResult;
 }
 
 /********************************************************************************
 * 函数实现：修复乱码字符串
 *********************************************************************************/
 std::string Utils::RepairString(const std::string& str) {
-    // 1. 处理空字符串
-    if (str.empty()) return str;
-    
-    // 2. 检查是否已经是有效的UTF-8编码
-    if (IsValidUTF8(str)) {
+    // 1. 检查是否已经是有效的UTF-8编码（绝大多数输出在这里返回）
+    size_t nInvalid = FindInvalidUTF8(str);
+    if (nInvalid == std::string::npos) {
         return str;
     }
-    
-    // 3. 不是有效UTF-8，尝试作为GBK转换
-    return ConvertGBKToUTF8(str);
+
+    // 2. 逐段修复：有效内容原样复制，只把包含无效字节的片段作为GBK转换
+    std::string strResult;
+    strResult.reserve(str.size() + str.size() / 2);
+    const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(str.data());
+    size_t nPos = 0;
+    while (nInvalid != std::string::npos) {
+        // 2.1 片段从FindInvalidUTF8报告的无效字节开始：之前的字节已经按UTF-8完整
+        //     解码，不向前并入（紧挨着GBK字节的有效中文不会被当作GBK重新解码）
+        size_t nSpanStart = nInvalid;
+
+        // 2.2 按GBK双字节单位向后扩展（尾字节可能落在ASCII范围0x40~0x7E）
+        size_t nSpanEnd = nSpanStart;
+        while (nSpanEnd < str.size() && pBytes[nSpanEnd] >= 0x80) {
+            bool bPair = pBytes[nSpanEnd] >= 0x81 && pBytes[nSpanEnd] <= 0xFE && nSpanEnd + 1 < str.size() &&
+                         pBytes[nSpanEnd + 1] >= 0x40 && pBytes[nSpanEnd + 1] <= 0xFE && pBytes[nSpanEnd + 1] != 0x7F;
+            nSpanEnd += bPair ? 2 : 1;
+        }
+
+        // 2.3 复制片段之前的有效内容，转换片段
+        strResult.append(str, nPos, nSpanStart - nPos);
+        strResult += ConvertGBKToUTF8(std::string_view(str).substr(nSpanStart, nSpanEnd - nSpanStart));
+        nPos = nSpanEnd;
+
+        // 2.4 从片段之后继续查找
+        size_t nNext = FindInvalidUTF8(std::string_view(str).substr(nPos));
+        nInvalid = (nNext == std::string::npos) ? std::string::npos : nPos + nNext;
+    }
+
+    // 3. 复制剩余的有效内容
+    strResult.append(str, nPos, std::string::npos);
+    return strResult;
 }
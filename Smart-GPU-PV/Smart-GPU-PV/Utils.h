@@ -8,7 +8,7 @@
 *    格式化输出、JSON解析、Windows UI辅助等功能。
 * 
 * 主要功能模块：
-*    1. 字符串编码转换（UTF-8 <-> UTF-16）
+*    1. 字符串编码转换（UTF-8 <-> UTF-16、Base64）
 *    2. 字符串处理（Split、Trim、Contains）
 *    3. 格式化函数（FormatVRAMSize - 字节转GB/MB）
 *    4. 简单JSON值提取（用于解析PowerShell输出）
@@ -21,7 +21,7 @@
 *    - 提供基本错误处理
 * 
 * 依赖项：
-*    - Windows API（字符串转换、UI操作）
+*    - Windows API（字符串转换、UI操作；其他平台上只提供与UI无关的函数）
 *    - 标准C++库（string、vector、sstream）
 * 
 * 作者：Smart-GPU-PV Team
@@ -31,8 +31,12 @@
 
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 /********************************************************************************
 * 类名称：工具函数类
@@ -68,6 +72,30 @@ public:
     *********************************************************************************/
     static std::string WStringToString(const std::wstring& wstr);
     
+    /********************************************************************************
+    * 函数名称：Base64编码
+    * 函数功能：将任意字节序列编码为Base64文本
+    * 函数参数：
+    *    [IN]  const std::string& strData：原始字节
+    * 返回类型：std::string
+    *    Base64编码后的字符串
+    * 调用示例：
+    *    std::string strEncoded = Utils::Base64Encode("hello");
+    *    // strEncoded = "aGVsbG8="
+    *********************************************************************************/
+    static std::string Base64Encode(const std::string& strData);
+    
+    /********************************************************************************
+    * 函数名称：Base64解码
+    * 函数功能：将Base64文本解码为原始字节序列
+    * 函数参数：
+    *    [IN]  const std::string& strEncoded：Base64编码的字符串
+    *    [OUT] std::string& strData：解码后的字节
+    * 返回类型：bool
+    *    解码成功返回true，包含非法字符返回false
+    *********************************************************************************/
+    static bool Base64Decode(const std::string& strEncoded, std::string& strData);
+    
     //==============================================================================
     // 字符串处理
     //==============================================================================
@@ -99,6 +127,35 @@ public:
     *********************************************************************************/
     static std::string Trim(const std::string& str);
     
+    /********************************************************************************
+    * 函数名称：字符串视图修剪
+    * 函数功能：与Trim相同，但返回原字符串的视图，不复制数据
+    * 函数参数：
+    *    [IN]  std::string_view sv：待修剪的字符串视图
+    * 返回类型：std::string_view
+    *    修剪后的视图（指向原字符串）
+    *********************************************************************************/
+    static std::string_view TrimView(std::string_view sv);
+    
+    /********************************************************************************
+    * 函数名称：逐行读取
+    * 函数功能：从文本视图中取出下一行（零拷贝），并将视图推进到下一行开头
+    * 函数参数：
+    *    [IN/OUT] std::string_view& svText：剩余文本，调用后去掉已取出的行
+    *    [OUT]    std::string_view& svLine：取出的行（不含行尾的\r\n）
+    * 返回类型：bool
+    *    取到一行返回true，文本已读完返回false
+    * 调用示例：
+    *    std::string_view svText = strOutput, svLine;
+    *    while (Utils::NextLine(svText, svLine)) {
+    *        // 处理svLine
+    *    }
+    * 注意事项：
+    *    - svLine指向svText的底层数据，原字符串必须在使用期间保持有效
+    *    - 最后一行没有换行符时同样返回
+    *********************************************************************************/
+    static bool NextLine(std::string_view& svText, std::string_view& svLine);
+    
     /********************************************************************************
     * 函数名称：字符串包含检查
     * 函数功能：检查字符串中是否包含指定子字符串
@@ -151,6 +208,7 @@ public:
     *********************************************************************************/
     static std::string ExtractJsonValue(const std::string& strJson, const std::string& strKey);
     
+#ifdef _WIN32
     //==============================================================================
     // Windows UI辅助
     //==============================================================================
@@ -190,6 +248,7 @@ public:
     *    Utils::ShowInfo(hDlg, L"GPU-PV配置完成！");
     *********************************************************************************/
     static void ShowInfo(HWND hWnd, const std::wstring& wstrMessage);
+#endif
 
     //==============================================================================
     // 字符编码修复
@@ -206,27 +265,73 @@ public:
     *    std::string strFixed = Utils::RepairString(output);
     * 注意事项：
     *    主要用于修复PowerShell输出的中文乱码问题（当控制台代码页为GBK时）
+    *    只转换无效的片段（从FindInvalidUTF8报告的无效字节开始的连续非ASCII
+    *    字节段），之前有效的UTF-8内容（包括紧挨着的中文）原样保留，不再
+    *    整体按GBK重新解码
     *********************************************************************************/
     static std::string RepairString(const std::string& str);
 
-private:
     /********************************************************************************
-    * 函数名称：检查UTF-8有效性（内部辅助）
+    * 函数名称：检查UTF-8有效性
     * 函数功能：检查字符串是否为有效的UTF-8编码
     * 函数参数：
-    *    [IN]  const std::string& str：待检查的字符串
+    *    [IN]  std::string_view str：待检查的字符串
     * 返回类型：bool
     *    有效返回true，否则返回false
+    * 注意事项：
+    *    流式输出时先用此函数检查，只有无效时才需要复制并调用RepairString
+    *********************************************************************************/
+    static bool IsValidUTF8(std::string_view str);
+
+    /********************************************************************************
+    * 函数名称：查找第一个无效的UTF-8字节
+    * 函数功能：按严格的UTF-8规则（拒绝超长编码、代理区和超过U+10FFFF的码点）
+    *           查找第一个无效序列的起始位置
+    * 函数参数：
+    *    [IN]  std::string_view str：待检查的字符串
+    * 返回类型：size_t
+    *    第一个无效序列的偏移；全部有效时返回std::string_view::npos
+    * 注意事项：
+    *    ASCII字节按16/32字节一组（SSE2，CPU支持时使用AVX2）批量跳过，
+    *    只有非ASCII字节逐个序列检查；其他架构上按8字节一组跳过
+    *********************************************************************************/
+    static size_t FindInvalidUTF8(std::string_view str);
+
+    // ASCII快速路径的实现（按速度递增）
+    enum class Utf8Simd {
+        Scalar,     // 8字节一组
+        SSE2,       // 16字节一组
+        AVX2        // 32字节一组
+    };
+
+    /********************************************************************************
+    * 函数名称：按指定实现查找第一个无效的UTF-8字节
+    * 函数参数：
+    *    [IN]  std::string_view str：待检查的字符串
+    *    [IN]  Utf8Simd eSimd：ASCII快速路径的实现（超过BestUTF8Simd时按后者）
+    * 返回类型：size_t
+    *    与FindInvalidUTF8(str)相同；测试用它对照各实现的结果
+    *********************************************************************************/
+    static size_t FindInvalidUTF8(std::string_view str, Utf8Simd eSimd);
+
+    /********************************************************************************
+    * 函数名称：取当前CPU可用的最快实现
+    * 返回类型：Utf8Simd
+    *    x86/x64上CPU和操作系统支持AVX2时为AVX2，否则为SSE2；其他架构为Scalar
     *********************************************************************************/
-    static bool IsValidUTF8(const std::string& str);
+    static Utf8Simd BestUTF8Simd();
+
+private:
     
     /********************************************************************************
     * 函数名称：GBK转UTF-8（内部辅助）
     * 函数功能：将GBK编码字符串转换为UTF-8编码
     * 函数参数：
-    *    [IN]  const std::string& str：GBK编码字符串
+    *    [IN]  std::string_view str：GBK编码字符串
     * 返回类型：std::string
-    *    UTF-8编码字符串
+    *    UTF-8编码字符串（无法映射的字节为U+FFFD）
+    * 注意事项：
+    *    使用内置的GbkTable（与代码页936一致），各平台结果相同
     *********************************************************************************/
-    static std::string ConvertGBKToUTF8(const std::string& str);
+    static std::string ConvertGBKToUTF8(std::string_view str);
 };
@@ -4,10 +4,18 @@
 #include "WmiHelper.h"
 #include "HyperVException.h"
 #include "Utils.h"
+#include "QueryCache.h"
+#include "ExecutorTrace.h"
+#include "JsonReader.h"
+#include <algorithm>
 #include <iostream>
 
+// 虚拟机查询结果的缓存有效期（启动/停止虚拟机时主动失效）
+static const DWORD VM_QUERY_TTL_MS = 10 * 1000;
+
 // 获取所有虚拟机列表
 std::vector<VMInfo> VMManager::GetAllVMs() {
+    ExecutorTrace::Scope traceScope("GetAllVMs");
     try {
         return GetAllVMsViaWMI();
     } catch (...) {
@@ -18,20 +26,30 @@ std::vector<VMInfo> VMManager::GetAllVMs() {
 
 // 停止虚拟机
 bool VMManager::StopVM(const std::string& vmName, std::string& error) {
+    ExecutorTrace::Scope traceScope("StopVM");
+    bool result;
     try {
-        return StopVMViaWMI(vmName, error);
+        result = StopVMViaWMI(vmName, error);
     } catch (...) {
-        return StopVMViaPowerShell(vmName, error);
+        result = StopVMViaPowerShell(vmName, error);
     }
+    // WMI方法调用不经过PowerShellExecutor，需要手动清除该虚拟机的缓存；
+    // 在状态改变之后清除，修改期间的查询结果不会留在缓存中
+    QueryCache::Instance().InvalidateScope(vmName);
+    return result;
 }
 
 // 启动虚拟机
 bool VMManager::StartVM(const std::string& vmName, std::string& error) {
+    ExecutorTrace::Scope traceScope("StartVM");
+    bool result;
     try {
-        return StartVMViaWMI(vmName, error);
+        result = StartVMViaWMI(vmName, error);
     } catch (...) {
-        return StartVMViaPowerShell(vmName, error);
+        result = StartVMViaPowerShell(vmName, error);
     }
+    QueryCache::Instance().InvalidateScope(vmName);
+    return result;
 }
 
 // WMI实现：获取所有虚拟机
@@ -43,8 +61,8 @@ std::vector<VMInfo> VMManager::GetAllVMsViaWMI() {
         
         // 查询所有计算机系统（包括主机和虚拟机）
         // 移除 WHERE Caption='Virtual Machine' 以避免本地化问题（例如中文系统下可能是 "虚拟机"）
-        auto result = WmiHelper::Query(session, 
-            L"SELECT * FROM Msvm_ComputerSystem");
+        auto result = WmiHelper::QueryCached(session, 
+            L"SELECT * FROM Msvm_ComputerSystem", QueryCache::SCOPE_ALL_VMS, VM_QUERY_TTL_MS);
         
         IWbemClassObject* pVM = nullptr;
         while (result->Next(&pVM)) {
@@ -70,6 +88,7 @@ std::vector<VMInfo> VMManager::GetAllVMsViaWMI() {
 
             VMInfo vmInfo;
             vmInfo.strName = Utils::WStringToString(WmiHelper::GetProperty(pVM, L"ElementName"));
+            std::string scope = vmInfo.strName;  // 关联查询的缓存作用域
             
             // 获取状态
             uint64_t enabledState = WmiHelper::GetPropertyUInt64(pVM, L"EnabledState");
@@ -88,7 +107,7 @@ std::vector<VMInfo> VMManager::GetAllVMsViaWMI() {
             // Msvm_ComputerSystem -> Msvm_VirtualSystemSettingData (通过 Msvm_SettingsDefineState 关联)
             std::wstring settingQuery = L"ASSOCIATORS OF {" + vmPath + 
                 L"} WHERE AssocClass=Msvm_SettingsDefineState ResultClass=Msvm_VirtualSystemSettingData";
-            auto settingResult = WmiHelper::Query(session, settingQuery);
+            auto settingResult = WmiHelper::QueryCached(session, settingQuery, scope, VM_QUERY_TTL_MS);
             
             IWbemClassObject* pSetting = nullptr;
             if (settingResult->Next(&pSetting)) {
@@ -105,7 +124,7 @@ std::vector<VMInfo> VMManager::GetAllVMsViaWMI() {
                 // Msvm_VirtualSystemSettingData -> Msvm_GpuPartitionSettingData (通过 Msvm_VirtualSystemSettingDataComponent 关联)
                 std::wstring gpuQuery = L"ASSOCIATORS OF {" + WmiHelper::GetObjectPath(pSetting) +
                     L"} WHERE AssocClass=Msvm_VirtualSystemSettingDataComponent ResultClass=Msvm_GpuPartitionSettingData";
-                auto gpuResult = WmiHelper::Query(session, gpuQuery);
+                auto gpuResult = WmiHelper::QueryCached(session, gpuQuery, scope, VM_QUERY_TTL_MS);
                 
                 IWbemClassObject* pGpu = nullptr;
                 if (gpuResult->Next(&pGpu)) {
@@ -337,25 +356,14 @@ std::vector<VMInfo> VMManager::GetAllVMsViaPowerShell() {
         "InstancePath = $ip "
         "} } | ConvertTo-Json";
 
-    std::string output, error;
-    PowerShellExecutor::ExecuteWithCheck(command, output, error);
-    
-    if (!output.empty()) {
-        vms = ParseVMJson(output);
-    }
-    
-    // 如果有开启GPU-PV的虚拟机，尝试获取GPU名称
-    bool hasGpuPvOn = false;
-    for (const auto& vm : vms) {
-        if (vm.strGPUStatus == "On") {
-            hasGpuPvOn = true;
-            break;
-        }
-    }
+    // 异步执行虚拟机查询，同时在当前线程获取GPU列表（用于显示GPU名称），
+    // 两者的耗时相互重叠
+    auto vmsFuture = PowerShellExecutor::ExecuteAsync(command);
+    std::vector<GPUInfo> gpus = GPUManager::GetPartitionableGPUs();
     
-    std::vector<GPUInfo> gpus;
-    if (hasGpuPvOn) {
-        gpus = GPUManager::GetPartitionableGPUs();
+    CommandResult result = vmsFuture.get();
+    if (!result.strOutput.empty()) {
+        vms = ParseVMJson(result.strOutput);
     }
     
     // 构建显示文本
@@ -432,69 +440,34 @@ bool VMManager::StartVMViaPowerShell(const std::string& vmName, std::string& err
 // 获取虚拟机状态
 std::string VMManager::GetVMState(const std::string& vmName) {
     std::string command = "(Get-VM -Name '" + vmName + "').State.ToString()";
-    std::string output = PowerShellExecutor::Execute(command);
-    return Utils::Trim(output);
+    CommandResult result;
+    PowerShellExecutor::ExecuteCached(command, vmName, VM_QUERY_TTL_MS, result);
+    return Utils::Trim(result.strOutput);
 }
 
 // 检查虚拟机是否存在
 bool VMManager::VMExists(const std::string& vmName) {
     std::string command = "Get-VM -Name '" + vmName + "' -ErrorAction SilentlyContinue";
-    std::string output = PowerShellExecutor::Execute(command);
-    return !output.empty();
+    CommandResult result;
+    PowerShellExecutor::ExecuteCached(command, vmName, VM_QUERY_TTL_MS, result);
+    return !result.strOutput.empty();
 }
 
 // 解析虚拟机JSON输出
 std::vector<VMInfo> VMManager::ParseVMJson(const std::string& json) {
     std::vector<VMInfo> vms;
     
-    // 简单的JSON解析（处理单个对象和数组）
-    std::string trimmedJson = Utils::Trim(json);
-    if (trimmedJson.empty()) return vms;
-    
-    // 如果是数组，移除外层的[]
-    if (trimmedJson[0] == '[') {
-        // 找到最后一个 ]
-        size_t lastBracket = trimmedJson.find_last_of(']');
-        if (lastBracket != std::string::npos) {
-            trimmedJson = trimmedJson.substr(1, lastBracket - 1);
-        }
-    }
-    
-    // 分割每个虚拟机对象（通过},{来分割，或者单纯找 {}）
-    size_t pos = 0;
-    while (pos < trimmedJson.length()) {
-        // 查找下一个对象的开始
-        size_t objStart = trimmedJson.find('{', pos);
-        if (objStart == std::string::npos) break;
-        
-        // 查找对象的结束
-        size_t objEnd = trimmedJson.find('}', objStart);
-        if (objEnd == std::string::npos) break;
-        
-        std::string objStr = trimmedJson.substr(objStart, objEnd - objStart + 1);
-        
-        // 提取信息
-        VMInfo vmInfo;
-        vmInfo.strName = Utils::ExtractJsonValue(objStr, "Name");
-        vmInfo.strState = Utils::ExtractJsonValue(objStr, "State");
-        vmInfo.strGPUStatus = Utils::ExtractJsonValue(objStr, "GpuStatus");
-        vmInfo.strGPUInstancePath = Utils::ExtractJsonValue(objStr, "InstancePath");
-        
-        std::string vramStr = Utils::ExtractJsonValue(objStr, "VRAM");
-        if (!vramStr.empty()) {
-            try {
-                vmInfo.ui64VramBytes = std::stoull(vramStr);
-            } catch (...) {
-                vmInfo.ui64VramBytes = 0;
-            }
-        }
-        
-        if (!vmInfo.strName.empty()) {
-            vms.push_back(vmInfo);
-        }
-        
-        pos = objEnd + 1;
+    // 单遍解析（单个虚拟机时输出为对象，多个时为数组）
+    JsonDocument document;
+    std::string error;
+    if (!document.Parse(json, error)) {
+        return vms;
     }
+    document.MapList(vms);
     
+    // 没有名称的条目无法操作，丢弃
+    vms.erase(std::remove_if(vms.begin(), vms.end(),
+                             [](const VMInfo& vm) { return vm.strName.empty(); }),
+              vms.end());
     return vms;
 }
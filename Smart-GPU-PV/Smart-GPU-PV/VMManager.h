@@ -35,6 +35,7 @@
 *********************************************************************************/
 
 #pragma once
+#include "JsonReader.h"
 #include <string>
 #include <vector>
 
@@ -61,6 +62,17 @@ struct VMInfo {
     std::string strDisplayText;       // 显示文本
 };
 
+// GetAllVMsViaPowerShell输出对象的JSON字段
+template <>
+struct JsonFields<VMInfo> {
+    static constexpr auto Fields = std::make_tuple(
+        MakeJsonField("Name", &VMInfo::strName),
+        MakeJsonField("State", &VMInfo::strState),
+        MakeJsonField("GpuStatus", &VMInfo::strGPUStatus),
+        MakeJsonField("VRAM", &VMInfo::ui64VramBytes),
+        MakeJsonField("InstancePath", &VMInfo::strGPUInstancePath));
+};
+
 /********************************************************************************
 * 类名称：虚拟机管理器
 * 类功能：提供Hyper-V虚拟机的查询和控制功能
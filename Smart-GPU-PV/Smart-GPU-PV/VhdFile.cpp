@@ -0,0 +1,489 @@
+﻿/********************************************************************************
+* 文件名称：VhdFile.cpp
+* 文件功能：实现传统VHD虚拟磁盘文件（固定和动态）的解析和扇区级读写
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "VhdFile.h"
+#include <cstring>
+
+// 文件布局（VHD规范）
+static const size_t FOOTER_SIZE = 512;
+static const size_t DYNAMIC_HEADER_SIZE = 1024;
+static const uint32_t BAT_UNUSED = 0xFFFFFFFF;
+static const uint32_t FORMAT_VERSION = 0x00010000;
+static const uint64_t MAX_BLOCK_SIZE = 256 * 1024 * 1024;
+
+// 磁盘类型（尾部偏移60）
+static const uint32_t DISK_TYPE_FIXED = 2;
+static const uint32_t DISK_TYPE_DYNAMIC = 3;
+static const uint32_t DISK_TYPE_DIFFERENCING = 4;
+
+// 大端读写（VHD的所有字段均为大端序）
+static inline uint32_t ReadBE32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+static inline uint64_t ReadBE64(const uint8_t* p) {
+    return (static_cast<uint64_t>(ReadBE32(p)) << 32) | ReadBE32(p + 4);
+}
+static inline void WriteBE32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+/********************************************************************************
+* 函数实现：计算校验和（内部辅助）
+* 说明：除校验和字段外所有字节之和取反
+*********************************************************************************/
+static uint32_t Checksum(const uint8_t* p, size_t nBytes, size_t nChecksumOffset) {
+    uint32_t ui32Sum = 0;
+    for (size_t i = 0; i < nBytes; i++) {
+        if (i < nChecksumOffset || i >= nChecksumOffset + 4) {
+            ui32Sum += p[i];
+        }
+    }
+    return ~ui32Sum;
+}
+
+/********************************************************************************
+* 函数实现：尾部是否有效（内部辅助）
+*********************************************************************************/
+static bool IsValidFooter(const uint8_t* p) {
+    return memcmp(p, "conectix", 8) == 0 && (ReadBE32(p + 12) >> 16) == (FORMAT_VERSION >> 16) &&
+           Checksum(p, FOOTER_SIZE, 64) == ReadBE32(p + 64);
+}
+
+// 扇区位图中的一位（最高位对应块中的第一个扇区）
+static inline bool SectorPresent(const uint8_t* pBitmap, uint64_t ui64Sector) {
+    return ((pBitmap[ui64Sector / 8] >> (7 - ui64Sector % 8)) & 1) != 0;
+}
+
+/********************************************************************************
+* 函数实现：构造函数 / 析构函数
+*********************************************************************************/
+VhdFile::VhdFile(size_t nCacheBytes)
+    : m_objBitmapCache(SECTOR_SIZE, BITMAP_CACHE_BLOCKS),
+      m_objCache(CACHE_PAGE_SIZE, nCacheBytes / CACHE_PAGE_SIZE) {
+}
+
+VhdFile::~VhdFile() {
+    Close();
+}
+
+/********************************************************************************
+* 函数实现：打开VHD文件
+*********************************************************************************/
+bool VhdFile::Open(const std::string& strPath, bool bReadOnly, std::string& strError) {
+    Close();
+    std::lock_guard<std::mutex> lock(m_mtxDisk);
+    m_strPath = strPath;
+
+    // 1. 打开文件
+    if (!m_objFile.Open(strPath, bReadOnly, strError)) {
+        return false;
+    }
+    if (m_objFile.Size() < FOOTER_SIZE) {
+        strError = "不是有效的VHD文件: " + strPath;
+        m_objFile.Close();
+        return false;
+    }
+
+    // 2. 尾部 → 动态磁盘头部 → BAT
+    if (!LoadFooter(strError) || (m_bDynamic && (!LoadDynamicHeader(strError) || !LoadBat(strError)))) {
+        strError = strPath + ": " + strError;
+        m_objFile.Close();
+        m_vecBat.clear();
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：关闭
+*********************************************************************************/
+void VhdFile::Close() {
+    std::lock_guard<std::mutex> lock(m_mtxDisk);
+    if (m_objFile.IsOpen()) {
+        std::string strIgnored;
+        m_objFile.Flush(strIgnored);
+        m_objFile.Close();
+    }
+    m_vecFooter.clear();
+    m_vecBat.clear();
+    m_objBitmapCache.Clear();
+    m_objCache.Clear();
+    m_ui64DiskSize = 0;
+    m_bDynamic = false;
+}
+
+/********************************************************************************
+* 函数实现：加载尾部（内部辅助）
+*********************************************************************************/
+bool VhdFile::LoadFooter(std::string& strError) {
+    // 1. 文件末尾的尾部；损坏时动态磁盘可以使用文件开头的副本
+    m_vecFooter.resize(FOOTER_SIZE);
+    m_ui64FooterOffset = m_objFile.Size() - FOOTER_SIZE;
+    if (!m_objFile.ReadAt(m_ui64FooterOffset, m_vecFooter.data(), FOOTER_SIZE, strError)) {
+        return false;
+    }
+    if (!IsValidFooter(m_vecFooter.data())) {
+        std::vector<uint8_t> vecCopy(FOOTER_SIZE);
+        if (!m_objFile.ReadAt(0, vecCopy.data(), FOOTER_SIZE, strError)) {
+            return false;
+        }
+        if (!IsValidFooter(vecCopy.data()) || ReadBE32(vecCopy.data() + 60) == DISK_TYPE_FIXED) {
+            strError = "不是有效的VHD文件（尾部已损坏）";
+            return false;
+        }
+        m_vecFooter = vecCopy;
+        if (!m_objFile.IsReadOnly() &&
+            (!m_objFile.WriteAt(m_ui64FooterOffset, m_vecFooter.data(), FOOTER_SIZE, strError) || !m_objFile.Flush(strError))) {
+            return false;
+        }
+    }
+
+    // 2. 磁盘类型和大小
+    const uint8_t* p = m_vecFooter.data();
+    uint32_t ui32DiskType = ReadBE32(p + 60);
+    m_ui64DiskSize = ReadBE64(p + 48);
+    if (ui32DiskType == DISK_TYPE_DIFFERENCING) {
+        strError = "差异VHD需要父磁盘，暂不支持";
+        return false;
+    }
+    if (ui32DiskType != DISK_TYPE_FIXED && ui32DiskType != DISK_TYPE_DYNAMIC) {
+        strError = "VHD磁盘类型无效: " + std::to_string(ui32DiskType);
+        return false;
+    }
+    m_bDynamic = ui32DiskType == DISK_TYPE_DYNAMIC;
+    if (m_ui64DiskSize == 0 || m_ui64DiskSize % SECTOR_SIZE != 0) {
+        strError = "VHD虚拟磁盘大小无效: " + std::to_string(m_ui64DiskSize);
+        return false;
+    }
+    if (!m_bDynamic && m_ui64DiskSize > m_ui64FooterOffset) {
+        strError = "固定VHD文件被截断";
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：加载动态磁盘头部（内部辅助）
+*********************************************************************************/
+bool VhdFile::LoadDynamicHeader(std::string& strError) {
+    std::vector<uint8_t> vecHeader(DYNAMIC_HEADER_SIZE);
+    uint64_t ui64HeaderOffset = ReadBE64(m_vecFooter.data() + 16);
+    if (ui64HeaderOffset > m_ui64FooterOffset || DYNAMIC_HEADER_SIZE > m_ui64FooterOffset - ui64HeaderOffset ||
+        !m_objFile.ReadAt(ui64HeaderOffset, vecHeader.data(), DYNAMIC_HEADER_SIZE, strError)) {
+        strError = "VHD动态磁盘头部位置无效";
+        return false;
+    }
+    const uint8_t* p = vecHeader.data();
+    if (memcmp(p, "cxsparse", 8) != 0 || Checksum(p, DYNAMIC_HEADER_SIZE, 36) != ReadBE32(p + 36) ||
+        (ReadBE32(p + 24) >> 16) != (FORMAT_VERSION >> 16)) {
+        strError = "VHD动态磁盘头部已损坏";
+        return false;
+    }
+
+    // 块大小是扇区的整数倍；每个块的扇区位图按扇区对齐
+    m_ui64BatOffset = ReadBE64(p + 16);
+    m_ui32BlockSize = ReadBE32(p + 32);
+    if (m_ui32BlockSize < 8 * SECTOR_SIZE || m_ui32BlockSize > MAX_BLOCK_SIZE || m_ui32BlockSize % (8 * SECTOR_SIZE) != 0) {
+        strError = "VHD块大小无效: " + std::to_string(m_ui32BlockSize);
+        return false;
+    }
+    uint32_t ui32BitmapBytes = m_ui32BlockSize / SECTOR_SIZE / 8;
+    m_ui32BitmapSize = (ui32BitmapBytes + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+    m_objBitmapCache = LruBlockCache(m_ui32BitmapSize, BITMAP_CACHE_BLOCKS);
+
+    uint64_t ui64Blocks = (m_ui64DiskSize + m_ui32BlockSize - 1) / m_ui32BlockSize;
+    if (ReadBE32(p + 28) < ui64Blocks) {
+        strError = "VHD块分配表项数不足";
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：加载块分配表（内部辅助）
+*********************************************************************************/
+bool VhdFile::LoadBat(std::string& strError) {
+    uint64_t ui64Blocks = (m_ui64DiskSize + m_ui32BlockSize - 1) / m_ui32BlockSize;
+    std::vector<uint8_t> vecRaw(static_cast<size_t>(ui64Blocks * sizeof(uint32_t)));
+    if (m_ui64BatOffset > m_ui64FooterOffset || vecRaw.size() > m_ui64FooterOffset - m_ui64BatOffset ||
+        !m_objFile.ReadAt(m_ui64BatOffset, vecRaw.data(), vecRaw.size(), strError)) {
+        strError = "VHD块分配表位置无效";
+        return false;
+    }
+
+    // 已分配的块（位图 + 数据）必须位于末尾的尾部之前
+    m_vecBat.resize(static_cast<size_t>(ui64Blocks));
+    for (uint64_t ui64Block = 0; ui64Block < ui64Blocks; ui64Block++) {
+        uint32_t ui32Sector = ReadBE32(vecRaw.data() + ui64Block * sizeof(uint32_t));
+        m_vecBat[static_cast<size_t>(ui64Block)] = ui32Sector;
+        if (ui32Sector != BAT_UNUSED &&
+            static_cast<uint64_t>(ui32Sector) * SECTOR_SIZE + m_ui32BitmapSize + m_ui32BlockSize > m_ui64FooterOffset) {
+            strError = "VHD块分配表项指向文件之外（块 " + std::to_string(ui64Block) + "）";
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：取块的扇区位图（内部辅助）
+* 说明：返回的指针在下一次调用前有效；失败返回nullptr
+*********************************************************************************/
+const uint8_t* VhdFile::BlockBitmap(uint64_t ui64Block, std::string& strError) {
+    const char* pBitmap = m_objBitmapCache.Lookup(ui64Block);
+    if (!pBitmap) {
+        char* pNew = m_objBitmapCache.Insert(ui64Block);
+        uint64_t ui64Offset = static_cast<uint64_t>(m_vecBat[static_cast<size_t>(ui64Block)]) * SECTOR_SIZE;
+        if (!m_objFile.ReadAt(ui64Offset, pNew, m_ui32BitmapSize, strError)) {
+            m_objBitmapCache.Erase(ui64Block);
+            return nullptr;
+        }
+        pBitmap = pNew;
+    }
+    return reinterpret_cast<const uint8_t*>(pBitmap);
+}
+
+/********************************************************************************
+* 函数实现：读取一个块内的数据（内部辅助）
+* 说明：位图中置位的扇区读取块中的数据，其余扇区和未分配的块读出为0
+*********************************************************************************/
+bool VhdFile::ReadBlock(uint64_t ui64Block, uint32_t ui32InBlock, char* pBuffer, size_t nBytes, std::string& strError) {
+    uint32_t ui32Sector = m_vecBat[static_cast<size_t>(ui64Block)];
+    if (ui32Sector == BAT_UNUSED) {
+        memset(pBuffer, 0, nBytes);
+        return true;
+    }
+    const uint8_t* pBitmap = BlockBitmap(ui64Block, strError);
+    if (!pBitmap) {
+        return false;
+    }
+
+    // 按位图分成连续的段，整段读取或清零
+    uint64_t ui64Data = static_cast<uint64_t>(ui32Sector) * SECTOR_SIZE + m_ui32BitmapSize;
+    size_t nDone = 0;
+    while (nDone < nBytes) {
+        uint32_t ui32Position = ui32InBlock + static_cast<uint32_t>(nDone);
+        bool bPresent = SectorPresent(pBitmap, ui32Position / SECTOR_SIZE);
+        size_t nRun = 0;
+        while (nDone + nRun < nBytes &&
+               SectorPresent(pBitmap, (ui32Position + nRun) / SECTOR_SIZE) == bPresent) {
+            size_t nInSector = SECTOR_SIZE - (ui32Position + nRun) % SECTOR_SIZE;
+            nRun += nInSector < nBytes - nDone - nRun ? nInSector : nBytes - nDone - nRun;
+        }
+        if (bPresent) {
+            if (!m_objFile.ReadAt(ui64Data + ui32Position, pBuffer + nDone, nRun, strError)) {
+                return false;
+            }
+        } else {
+            memset(pBuffer + nDone, 0, nRun);
+        }
+        nDone += nRun;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：不经过缓存读取（内部辅助）
+*********************************************************************************/
+bool VhdFile::ReadUncached(uint64_t ui64Offset, char* pBuffer, size_t nBytes, std::string& strError) {
+    if (!m_bDynamic) {
+        return m_objFile.ReadAt(ui64Offset, pBuffer, nBytes, strError);
+    }
+    while (nBytes > 0) {
+        uint64_t ui64Block = ui64Offset / m_ui32BlockSize;
+        uint32_t ui32InBlock = static_cast<uint32_t>(ui64Offset % m_ui32BlockSize);
+        size_t nChunk = m_ui32BlockSize - ui32InBlock;
+        if (nChunk > nBytes) nChunk = nBytes;
+
+        if (!ReadBlock(ui64Block, ui32InBlock, pBuffer, nChunk, strError)) {
+            return false;
+        }
+        pBuffer += nChunk;
+        ui64Offset += nChunk;
+        nBytes -= nChunk;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取
+*********************************************************************************/
+bool VhdFile::Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) {
+    std::lock_guard<std::mutex> lock(m_mtxDisk);
+    if (!m_objFile.IsOpen()) {
+        strError = "VHD文件未打开";
+        return false;
+    }
+    if (ui64Offset > m_ui64DiskSize || nBytes > m_ui64DiskSize - ui64Offset) {
+        strError = "读取超出虚拟磁盘范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+
+    // 大块顺序读取直接读文件，避免冲掉缓存中的元数据页
+    char* pDest = static_cast<char*>(pBuffer);
+    if (m_objCache.Capacity() == 0 || nBytes >= 4 * CACHE_PAGE_SIZE) {
+        return ReadUncached(ui64Offset, pDest, nBytes, strError);
+    }
+
+    while (nBytes > 0) {
+        uint64_t ui64Page = ui64Offset / CACHE_PAGE_SIZE;
+        size_t nInPage = static_cast<size_t>(ui64Offset % CACHE_PAGE_SIZE);
+        size_t nChunk = CACHE_PAGE_SIZE - nInPage;
+        if (nChunk > nBytes) nChunk = nBytes;
+
+        const char* pPage = m_objCache.Lookup(ui64Page);
+        if (!pPage) {
+            uint64_t ui64PageStart = ui64Page * CACHE_PAGE_SIZE;
+            size_t nPageBytes = CACHE_PAGE_SIZE;
+            if (m_ui64DiskSize - ui64PageStart < nPageBytes) {
+                nPageBytes = static_cast<size_t>(m_ui64DiskSize - ui64PageStart);
+            }
+            char* pNew = m_objCache.Insert(ui64Page);
+            if (!ReadUncached(ui64PageStart, pNew, nPageBytes, strError)) {
+                m_objCache.Erase(ui64Page);
+                return false;
+            }
+            pPage = pNew;
+        }
+        memcpy(pDest, pPage + nInPage, nChunk);
+        pDest += nChunk;
+        ui64Offset += nChunk;
+        nBytes -= nChunk;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：写入一个块内的数据（内部辅助）
+*********************************************************************************/
+bool VhdFile::WriteBlock(uint64_t ui64Block, uint32_t ui32InBlock, const char* pData, size_t nBytes, std::string& strError) {
+    uint32_t ui32Sector = m_vecBat[static_cast<size_t>(ui64Block)];
+
+    // 1. 已分配的块：涉及的扇区在位图中都已置位时直接写入
+    if (ui32Sector != BAT_UNUSED) {
+        const uint8_t* pBitmap = BlockBitmap(ui64Block, strError);
+        if (!pBitmap) {
+            return false;
+        }
+        uint64_t ui64BlockOffset = static_cast<uint64_t>(ui32Sector) * SECTOR_SIZE;
+        bool bAllPresent = true;
+        for (uint64_t ui64Sector = ui32InBlock / SECTOR_SIZE; ui64Sector <= (ui32InBlock + nBytes - 1) / SECTOR_SIZE; ui64Sector++) {
+            if (!SectorPresent(pBitmap, ui64Sector)) {
+                bAllPresent = false;
+                break;
+            }
+        }
+        if (bAllPresent) {
+            return m_objFile.WriteAt(ui64BlockOffset + m_ui32BitmapSize + ui32InBlock, pData, nBytes, strError);
+        }
+
+        // 否则读出整个块（未置位的扇区为0）合并后整块写入，数据落盘后再把位图全部置位
+        std::vector<char> vecMerged(m_ui32BlockSize);
+        if (!ReadBlock(ui64Block, 0, vecMerged.data(), vecMerged.size(), strError)) {
+            return false;
+        }
+        memcpy(vecMerged.data() + ui32InBlock, pData, nBytes);
+        std::vector<uint8_t> vecBitmap(m_ui32BitmapSize, 0);
+        memset(vecBitmap.data(), 0xFF, m_ui32BlockSize / SECTOR_SIZE / 8);
+        if (!m_objFile.WriteAt(ui64BlockOffset + m_ui32BitmapSize, vecMerged.data(), vecMerged.size(), strError) ||
+            !m_objFile.Flush(strError) ||
+            !m_objFile.WriteAt(ui64BlockOffset, vecBitmap.data(), vecBitmap.size(), strError)) {
+            return false;
+        }
+        m_objBitmapCache.Erase(ui64Block);
+        return true;
+    }
+
+    // 2. 新块放在原来尾部的位置：先在新的文件末尾写入尾部，文件末尾始终是有效的尾部
+    uint64_t ui64BlockOffset = (m_ui64FooterOffset + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+    uint64_t ui64NewFooterOffset = ui64BlockOffset + m_ui32BitmapSize + m_ui32BlockSize;
+    if (ui64BlockOffset / SECTOR_SIZE >= BAT_UNUSED) {
+        strError = "VHD文件超出块分配表可寻址的范围";
+        return false;
+    }
+    if (!m_objFile.WriteAt(ui64NewFooterOffset, m_vecFooter.data(), FOOTER_SIZE, strError) || !m_objFile.Flush(strError)) {
+        return false;
+    }
+
+    // 3. 位图（全部置位）和数据覆盖原来的尾部，落盘后再让BAT指向新块
+    std::vector<char> vecBlock(static_cast<size_t>(m_ui32BitmapSize) + m_ui32BlockSize, 0);
+    memset(vecBlock.data(), 0xFF, m_ui32BlockSize / SECTOR_SIZE / 8);
+    memcpy(vecBlock.data() + m_ui32BitmapSize + ui32InBlock, pData, nBytes);
+    if (!m_objFile.WriteAt(ui64BlockOffset, vecBlock.data(), vecBlock.size(), strError) || !m_objFile.Flush(strError)) {
+        return false;
+    }
+    uint8_t ui8Entry[4];
+    WriteBE32(ui8Entry, static_cast<uint32_t>(ui64BlockOffset / SECTOR_SIZE));
+    if (!m_objFile.WriteAt(m_ui64BatOffset + ui64Block * sizeof(uint32_t), ui8Entry, sizeof(ui8Entry), strError)) {
+        return false;
+    }
+    m_vecBat[static_cast<size_t>(ui64Block)] = static_cast<uint32_t>(ui64BlockOffset / SECTOR_SIZE);
+    m_ui64FooterOffset = ui64NewFooterOffset;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：写入
+*********************************************************************************/
+bool VhdFile::Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) {
+    std::lock_guard<std::mutex> lock(m_mtxDisk);
+    if (!m_objFile.IsOpen()) {
+        strError = "VHD文件未打开";
+        return false;
+    }
+    if (m_objFile.IsReadOnly()) {
+        strError = "VHD文件以只读方式打开";
+        return false;
+    }
+    if (ui64Offset > m_ui64DiskSize || nBytes > m_ui64DiskSize - ui64Offset) {
+        strError = "写入超出虚拟磁盘范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+
+    // 固定磁盘直接写入文件
+    if (!m_bDynamic) {
+        if (!m_objFile.WriteAt(ui64Offset, pBuffer, nBytes, strError)) {
+            return false;
+        }
+        m_objCache.Update(ui64Offset, pBuffer, nBytes);
+        return true;
+    }
+
+    const char* pSource = static_cast<const char*>(pBuffer);
+    while (nBytes > 0) {
+        uint64_t ui64Block = ui64Offset / m_ui32BlockSize;
+        uint32_t ui32InBlock = static_cast<uint32_t>(ui64Offset % m_ui32BlockSize);
+        size_t nChunk = m_ui32BlockSize - ui32InBlock;
+        if (nChunk > nBytes) nChunk = nBytes;
+
+        if (!WriteBlock(ui64Block, ui32InBlock, pSource, nChunk, strError)) {
+            return false;
+        }
+        m_objCache.Update(ui64Offset, pSource, nChunk);
+        pSource += nChunk;
+        ui64Offset += nChunk;
+        nBytes -= nChunk;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：刷新
+*********************************************************************************/
+bool VhdFile::Flush(std::string& strError) {
+    std::lock_guard<std::mutex> lock(m_mtxDisk);
+    if (!m_objFile.IsOpen()) {
+        return true;
+    }
+    return m_objFile.Flush(strError);
+}
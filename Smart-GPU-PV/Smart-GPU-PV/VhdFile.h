@@ -0,0 +1,127 @@
+﻿/********************************************************************************
+* 文件名称：VhdFile.h
+* 文件功能：不挂载直接读写传统VHD虚拟磁盘文件（固定磁盘和动态磁盘）
+*
+* 类说明：
+*    较早创建的虚拟机仍然使用.vhd文件，不能走VhdxFile的离线路径，只能挂载。
+*    VhdFile按VHD格式规范（Virtual Hard Disk Image Format Specification）
+*    直接解析文件，与VhdxFile一样实现BlockDevice接口：
+*    - 文件末尾的512字节尾部（动态磁盘在文件开头还有一份副本，末尾的尾部
+*      损坏时使用副本），所有字段为大端序
+*    - 固定磁盘：文件开头就是虚拟磁盘数据，按偏移直接读写
+*    - 动态磁盘：动态磁盘头部 + 块分配表（BAT，每项是块的起始扇区号）；
+*      每个块由扇区位图和数据组成，位图中置位的扇区读取块中的数据，
+*      未置位的扇区和未分配的块读出为0
+*    - LRU块缓存：最近读过的64KB页保存在内存中，写入时同步更新；扇区位图
+*      另有一个小缓存
+*
+* 写入顺序（动态磁盘）：
+*    分配新块时先在新的文件末尾写入尾部，再把位图和数据写到原来尾部的位置，
+*    数据刷到磁盘后最后更新BAT项。任意时刻文件末尾都是有效的尾部，中途断电
+*    最多留下一个未被引用的块。写入位图未置位的扇区时先读出整个块、合并后
+*    整块写入，再把位图全部置位，不会让未写入过的旧数据变为可见。
+*
+* 限制：
+*    - 差异磁盘（磁盘类型4）需要父磁盘，打开时返回错误（调用者改为挂载）
+*    - 逻辑扇区大小固定为512字节
+*
+* 依赖项：
+*    - BlockDevice（块设备接口、文件读写、LRU缓存）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "BlockDevice.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+/********************************************************************************
+* 类名称：VHD虚拟磁盘
+* 类功能：解析固定或动态VHD文件并按虚拟磁盘偏移读写
+*
+* 调用示例：
+*    VhdFile objDisk;
+*    std::string strError;
+*    if (objDisk.Open("D:\\VMs\\Win7.vhd", true, strError)) {
+*        std::vector<char> vecSector(objDisk.SectorSize());
+*        objDisk.Read(0, vecSector.data(), vecSector.size(), strError);
+*    }
+*********************************************************************************/
+class VhdFile : public BlockDevice {
+public:
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  size_t nCacheBytes：LRU块缓存容量（字节，0表示不缓存）
+    *********************************************************************************/
+    explicit VhdFile(size_t nCacheBytes = DEFAULT_CACHE_BYTES);
+    ~VhdFile() override;
+
+    /********************************************************************************
+    * 函数名称：打开VHD文件
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径（UTF-8）
+    *    [IN]  bool bReadOnly：是否只读
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    * 注意事项：
+    *    - 虚拟机必须处于关闭状态（Hyper-V运行时独占打开磁盘文件）
+    *    - 动态磁盘末尾的尾部损坏而开头的副本有效时，读写方式打开会把副本写回末尾
+    *********************************************************************************/
+    bool Open(const std::string& strPath, bool bReadOnly, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：关闭
+    * 函数功能：刷新并关闭文件（析构时自动调用）
+    *********************************************************************************/
+    void Close();
+
+    uint64_t Size() const override { return m_ui64DiskSize; }
+    uint32_t SectorSize() const override { return SECTOR_SIZE; }
+    bool IsReadOnly() const override { return m_objFile.IsReadOnly(); }
+    bool Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) override;
+    bool Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) override;
+    bool Flush(std::string& strError) override;
+
+    bool IsDynamic() const { return m_bDynamic; }
+    uint32_t BlockSize() const { return m_ui32BlockSize; }
+
+    // 默认缓存容量（字节）与页大小
+    static const size_t DEFAULT_CACHE_BYTES = 16 * 1024 * 1024;
+    static const size_t CACHE_PAGE_SIZE = 64 * 1024;
+    // 扇区位图缓存的容量（块数）
+    static const size_t BITMAP_CACHE_BLOCKS = 256;
+    // VHD的扇区大小
+    static const uint32_t SECTOR_SIZE = 512;
+
+private:
+    RawFile               m_objFile;                    // VHD文件
+    std::string           m_strPath;                    // 文件路径
+    std::mutex            m_mtxDisk;                    // 保护以下全部状态
+    std::vector<uint8_t>  m_vecFooter;                  // 尾部（512字节，分配新块时写到新的文件末尾）
+    uint64_t              m_ui64FooterOffset = 0;       // 末尾的尾部在文件中的偏移
+    uint64_t              m_ui64DiskSize = 0;           // 虚拟磁盘大小
+    bool                  m_bDynamic = false;           // 是否动态磁盘（否则为固定磁盘）
+    uint32_t              m_ui32BlockSize = 0;          // 块大小（动态磁盘）
+    uint32_t              m_ui32BitmapSize = 0;         // 每个块的扇区位图大小（按扇区对齐）
+    uint64_t              m_ui64BatOffset = 0;          // BAT在文件中的偏移
+    std::vector<uint32_t> m_vecBat;                     // 块分配表（块起始扇区号，已转换为主机字节序）
+    LruBlockCache         m_objBitmapCache;             // 扇区位图的缓存（键为块号）
+    LruBlockCache         m_objCache;                   // 已读取数据的缓存
+
+    bool LoadFooter(std::string& strError);
+    bool LoadDynamicHeader(std::string& strError);
+    bool LoadBat(std::string& strError);
+    const uint8_t* BlockBitmap(uint64_t ui64Block, std::string& strError);
+    bool ReadUncached(uint64_t ui64Offset, char* pBuffer, size_t nBytes, std::string& strError);
+    bool ReadBlock(uint64_t ui64Block, uint32_t ui32InBlock, char* pBuffer, size_t nBytes, std::string& strError);
+    bool WriteBlock(uint64_t ui64Block, uint32_t ui32InBlock, const char* pData, size_t nBytes, std::string& strError);
+
+    VhdFile(const VhdFile&) = delete;
+    VhdFile& operator=(const VhdFile&) = delete;
+};
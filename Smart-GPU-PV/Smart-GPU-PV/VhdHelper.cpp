@@ -1,16 +1,51 @@
 ﻿#include <initguid.h>
 #include "VhdHelper.h"
 #include <virtdisk.h>
+#include <winioctl.h>
 #include <vector>
-#include <thread>
-#include <chrono>
 
 #pragma comment(lib, "virtdisk.lib")
 #pragma comment(lib, "uuid.lib")
 
+// 取出虚拟磁盘对应的物理磁盘号（物理路径格式：\\.\PhysicalDriveX）
+static bool QueryDiskNumber(HANDLE handle, DWORD& diskNumber) {
+    wchar_t physicalPath[MAX_PATH] = { 0 };
+    ULONG pathSize = sizeof(physicalPath);
+    if (GetVirtualDiskPhysicalPath(handle, &pathSize, physicalPath) != ERROR_SUCCESS) {
+        return false;
+    }
+    std::wstring physical(physicalPath);
+    size_t numberPos = physical.find(L"PhysicalDrive");
+    if (numberPos == std::wstring::npos) {
+        return false;
+    }
+    diskNumber = wcstoul(physical.c_str() + numberPos + 13, nullptr, 10);
+    return true;
+}
+
+// 虚拟磁盘是否已作为物理磁盘联机（磁盘设备已创建并能返回几何信息）
+static bool IsDiskOnline(HANDLE handle) {
+    DWORD diskNumber = 0;
+    if (!QueryDiskNumber(handle, diskNumber)) {
+        return false;
+    }
+    std::wstring diskPath = L"\\\\.\\PhysicalDrive" + std::to_wstring(diskNumber);
+    HANDLE disk = CreateFileW(diskPath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              NULL, OPEN_EXISTING, 0, NULL);
+    if (disk == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DISK_GEOMETRY geometry = { 0 };
+    DWORD returned = 0;
+    BOOL queried = DeviceIoControl(disk, IOCTL_DISK_GET_DRIVE_GEOMETRY, NULL, 0,
+                                   &geometry, sizeof(geometry), &returned, NULL);
+    CloseHandle(disk);
+    return queried != FALSE;
+}
+
 // VhdHandle 实现
-VhdHelper::VhdHandle::VhdHandle() 
-    : m_handle(INVALID_HANDLE_VALUE), m_attached(false) {
+VhdHelper::VhdHandle::VhdHandle(WaitClock& objClock) 
+    : m_handle(INVALID_HANDLE_VALUE), m_objClock(objClock), m_attached(false) {
 }
 
 VhdHelper::VhdHandle::~VhdHandle() {
@@ -67,38 +102,40 @@ bool VhdHelper::VhdHandle::Attach() {
         NULL
     );
     
-    if (result == ERROR_SUCCESS) {
-        m_attached = true;
-        // 等待系统识别磁盘
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        return true;
+    if (result != ERROR_SUCCESS) {
+        return false;
     }
+    m_attached = true;
     
-    return false;
+    // 等待系统识别磁盘：物理磁盘出现并可以查询后立即返回
+    ReadinessWaiter waiter(m_objClock);
+    std::string error;
+    if (!waiter.WaitUntil("虚拟磁盘联机", [this]() { return IsDiskOnline(m_handle); },
+                          ReadinessWaiter::DISK_ARRIVAL, error)) {
+        Detach();
+        return false;
+    }
+    return true;
 }
 
 bool VhdHelper::VhdHandle::Detach() {
     if (m_handle == INVALID_HANDLE_VALUE) return false;
     if (!m_attached) return true;
     
-    // 尝试多次卸载（处理文件句柄占用的情况）
-    for (int retry = 0; retry < 5; retry++) {
-        DWORD result = DetachVirtualDisk(
-            m_handle,
-            DETACH_VIRTUAL_DISK_FLAG_NONE,
-            0
-        );
-        
-        if (result == ERROR_SUCCESS) {
-            m_attached = false;
-            return true;
-        }
-        
-        // 如果失败，等待一下再重试
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    // 卸载失败时按指数退避重试（处理文件句柄占用的情况），成功即返回；
+    // 已经不存在物理磁盘路径说明磁盘已被其他途径卸载，同样视为完成
+    ReadinessWaiter waiter(m_objClock);
+    std::string error;
+    bool detached = waiter.WaitUntil("虚拟磁盘卸载", [this]() {
+        DWORD diskNumber = 0;
+        return DetachVirtualDisk(m_handle, DETACH_VIRTUAL_DISK_FLAG_NONE, 0) == ERROR_SUCCESS ||
+               !QueryDiskNumber(m_handle, diskNumber);
+    }, ReadinessWaiter::DETACH, error);
+    
+    if (detached) {
+        m_attached = false;
     }
-    
-    return false;
+    return detached;
 }
 
 std::wstring VhdHelper::VhdHandle::GetSystemDriveLetter() {
@@ -106,29 +143,43 @@ std::wstring VhdHelper::VhdHandle::GetSystemDriveLetter() {
         return L"";
     }
     
-    // 获取物理磁盘路径
-    wchar_t physicalPath[MAX_PATH] = { 0 };
-    ULONG pathSize = MAX_PATH;
-    
-    DWORD result = GetVirtualDiskPhysicalPath(m_handle, &pathSize, physicalPath);
-    if (result != ERROR_SUCCESS) {
+    // 获取物理磁盘号
+    DWORD diskNumber = 0;
+    if (!QueryDiskNumber(m_handle, diskNumber)) {
         return L"";
     }
     
-    // 物理路径格式：\\.\PhysicalDriveX
-    // 我们需要枚举所有驱动器号，检查哪个对应此物理磁盘
-    
-    // 遍历所有可能的驱动器号
+    // 遍历所有可能的驱动器号，只检查位于该物理磁盘上的卷（避免选中主机自己的系统盘）
     for (wchar_t drive = L'C'; drive <= L'Z'; drive++) {
-        std::wstring drivePath = std::wstring(1, drive) + L":\\";
-        std::wstring windowsPath = drivePath + L"Windows\\System32";
+        std::wstring volumePath = L"\\\\.\\" + std::wstring(1, drive) + L":";
+        HANDLE volume = CreateFileW(volumePath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                    NULL, OPEN_EXISTING, 0, NULL);
+        if (volume == INVALID_HANDLE_VALUE) {
+            continue;
+        }
+        BYTE extentsBuffer[sizeof(VOLUME_DISK_EXTENTS) + 8 * sizeof(DISK_EXTENT)] = { 0 };
+        DWORD returned = 0;
+        BOOL queried = DeviceIoControl(volume, IOCTL_VOLUME_GET_VOLUME_DISK_EXTENTS, NULL, 0,
+                                       extentsBuffer, sizeof(extentsBuffer), &returned, NULL);
+        CloseHandle(volume);
+        if (!queried) {
+            continue;
+        }
+        const VOLUME_DISK_EXTENTS* extents = reinterpret_cast<const VOLUME_DISK_EXTENTS*>(extentsBuffer);
+        bool onVirtualDisk = false;
+        for (DWORD i = 0; i < extents->NumberOfDiskExtents; i++) {
+            if (extents->Extents[i].DiskNumber == diskNumber) {
+                onVirtualDisk = true;
+            }
+        }
+        if (!onVirtualDisk) {
+            continue;
+        }
         
         // 检查是否存在Windows目录
+        std::wstring windowsPath = std::wstring(1, drive) + L":\\Windows\\System32";
         DWORD attrib = GetFileAttributesW(windowsPath.c_str());
         if (attrib != INVALID_FILE_ATTRIBUTES && (attrib & FILE_ATTRIBUTE_DIRECTORY)) {
-            // 这可能是系统盘，但我们需要确认它是否来自我们挂载的VHD
-            // 简化处理：只要找到Windows目录就返回
-            // 更严格的做法是比较物理磁盘编号，但对于VM场景这已足够
             return std::wstring(1, drive) + L":";
         }
     }
@@ -136,6 +187,22 @@ std::wstring VhdHelper::VhdHandle::GetSystemDriveLetter() {
     return L"";
 }
 
+std::wstring VhdHelper::VhdHandle::WaitForSystemDriveLetter() {
+    if (m_handle == INVALID_HANDLE_VALUE || !m_attached) {
+        return L"";
+    }
+    
+    // 卷到达并分配驱动器号后立即返回
+    std::wstring drive;
+    ReadinessWaiter waiter(m_objClock);
+    std::string error;
+    waiter.WaitUntil("系统分区卷到达", [this, &drive]() {
+        drive = GetSystemDriveLetter();
+        return !drive.empty();
+    }, ReadinessWaiter::VOLUME_ARRIVAL, error);
+    return drive;
+}
+
 // 便捷方法：挂载VHD并返回系统驱动器号（保持挂载状态）
 std::wstring VhdHelper::MountAndGetSystemDrive(const std::wstring& vhdPath) {
     // 使用静态handle保持挂载状态（简化方案）
@@ -153,9 +220,7 @@ std::wstring VhdHelper::MountAndGetSystemDrive(const std::wstring& vhdPath) {
     }
     
     // 等待驱动器字母分配
-    std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-    
-    std::wstring drive = handle->GetSystemDriveLetter();
+    std::wstring drive = handle->WaitForSystemDriveLetter();
     
     // 不删除handle，保持挂载状态
     // 注意：会造成内存泄漏，但简化了API使用
@@ -19,6 +19,8 @@
 *    - AttachVirtualDisk挂载虚拟磁盘
 *    - DetachVirtualDisk卸载虚拟磁盘
 *    - 通过查询卷信息识别系统分区
+*    - 挂载后轮询磁盘联机和卷到达，卸载失败时按指数退避重试
+*      （ReadinessWaiter，替代过去的固定延时）
 *    - RAII模式自动管理资源
 * 
 * 使用模式：
@@ -32,6 +34,7 @@
 * 依赖项：
 *    - virtdisk.lib（Virtual Disk API库）
 *    - Windows API（存储管理）
+*    - ReadinessWaiter（就绪等待）
 * 
 * 使用注意：
 *    - 需要管理员权限
@@ -48,6 +51,7 @@
 #include <windows.h>
 #include <string>
 #include <memory>
+#include "ReadinessWaiter.h"
 
 /********************************************************************************
 * 类名称：VHD操作辅助类
@@ -82,10 +86,10 @@ public:
         * 函数名称：构造函数
         * 函数功能：初始化VHD句柄对象
         * 函数参数：
-        *    无
+        *    [IN]  WaitClock& objClock：挂载/卸载等待使用的时钟（默认系统时钟）
         * 返回类型：无（构造函数）
         *********************************************************************************/
-        VhdHandle();
+        explicit VhdHandle(WaitClock& objClock = WaitClock::System());
         
         /********************************************************************************
         * 函数名称：析构函数
@@ -125,6 +129,8 @@ public:
         * 注意事项：
         *    - 必须先调用Open()成功打开文件
         *    - 需要管理员权限
+        *    - 返回前等待物理磁盘路径可用且磁盘可以打开（最长DISK_ARRIVAL），
+        *      超时时卸载并返回false
         *********************************************************************************/
         bool Attach();
         
@@ -141,6 +147,7 @@ public:
         *    }
         * 注意事项：
         *    - 卸载前应确保没有程序占用虚拟磁盘上的文件
+        *    - 失败时按指数退避重试，直到成功或超过DETACH截止时间
         *    - 析构函数会自动调用Detach()
         *********************************************************************************/
         bool Detach();
@@ -159,9 +166,21 @@ public:
         *    }
         * 注意事项：
         *    - 必须先成功挂载虚拟磁盘
-        *    - 通过查找Windows目录识别系统分区
+        *    - 只检查位于该虚拟磁盘上的卷（按卷的磁盘区段比较磁盘号），
+        *      再通过查找Windows目录识别系统分区
+        *    - 只检查一次，不等待卷到达（等待见WaitForSystemDriveLetter）
         *********************************************************************************/
         std::wstring GetSystemDriveLetter();
+
+        /********************************************************************************
+        * 函数名称：等待系统分区驱动器号
+        * 函数功能：轮询GetSystemDriveLetter()，直到系统分区的卷到达并分配了驱动器号
+        * 函数参数：
+        *    无
+        * 返回类型：std::wstring
+        *    驱动器号字符串（如"E:"），超过VOLUME_ARRIVAL截止时间仍未找到返回空字符串
+        *********************************************************************************/
+        std::wstring WaitForSystemDriveLetter();
         
         /********************************************************************************
         * 函数名称：检查句柄有效性
@@ -185,6 +204,7 @@ public:
         
     private:
         HANDLE m_handle;      // VHD文件句柄
+        WaitClock& m_objClock;  // 挂载/卸载等待使用的时钟
         bool m_bAttached;     // 是否已挂载标志
         bool m_attached;      // 修正拼写错误（假设VhdHelper.cpp中使用的是m_attached）
         
@@ -212,6 +232,7 @@ public:
     *    }
     * 注意事项：
     *    - 使用完毕后必须调用Unmount()卸载
+    *    - 挂载后等待系统分区的卷到达，卷到达即返回（不再固定等待）
     *    - 建议使用VhdHandle类以确保自动清理
     *********************************************************************************/
     static std::wstring MountAndGetSystemDrive(const std::wstring& wstrVhdPath);
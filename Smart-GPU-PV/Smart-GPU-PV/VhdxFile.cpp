@@ -0,0 +1,1131 @@
+﻿/********************************************************************************
+* 文件名称：VhdxFile.cpp
+* 文件功能：实现VHDX虚拟磁盘文件的解析、日志回放和扇区级读写
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "VhdxFile.h"
+#include "ContentHash.h"
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+// 文件布局（VHDX规范2.2节）
+static const uint64_t ONE_MB = 1024 * 1024;
+static const uint64_t HEADER_OFFSETS[2] = { 64 * 1024, 128 * 1024 };
+static const uint64_t REGION_TABLE_OFFSETS[2] = { 192 * 1024, 256 * 1024 };
+static const size_t HEADER_SIZE = 4096;
+static const size_t REGION_TABLE_SIZE = 64 * 1024;
+static const size_t METADATA_TABLE_SIZE = 64 * 1024;
+static const size_t LOG_SECTOR_SIZE = 4096;
+static const uint32_t MAX_TABLE_ENTRIES = 2047;
+
+// BAT项状态（低3位）
+static const uint64_t BAT_STATE_MASK = 7;
+static const uint64_t PAYLOAD_BLOCK_NOT_PRESENT = 0;
+static const uint64_t PAYLOAD_BLOCK_UNDEFINED = 1;
+static const uint64_t PAYLOAD_BLOCK_ZERO = 2;
+static const uint64_t PAYLOAD_BLOCK_UNMAPPED = 3;
+static const uint64_t PAYLOAD_BLOCK_FULLY_PRESENT = 6;
+static const uint64_t PAYLOAD_BLOCK_PARTIALLY_PRESENT = 7;
+static const uint64_t SB_BLOCK_NOT_PRESENT = 0;
+static const uint64_t SB_BLOCK_PRESENT = 6;
+
+// 小端读写（x86/x64/ARM64均为小端，memcpy避免未对齐访问）
+static inline uint16_t Read16(const uint8_t* p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint32_t Read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline uint64_t Read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+static inline void Write16(uint8_t* p, uint16_t v) { memcpy(p, &v, sizeof(v)); }
+static inline void Write32(uint8_t* p, uint32_t v) { memcpy(p, &v, sizeof(v)); }
+static inline void Write64(uint8_t* p, uint64_t v) { memcpy(p, &v, sizeof(v)); }
+
+static DiskGuid ReadGuid(const uint8_t* p) {
+    DiskGuid objGuid;
+    memcpy(objGuid.ui8Bytes, p, 16);
+    return objGuid;
+}
+
+// 区域和元数据项的GUID（VHDX规范2.3、2.6节）
+static const DiskGuid GUID_BAT_REGION             = DiskGuid::Make(0x2DC27766, 0xF623, 0x4200, 0x9D64115E9BFD4A08ULL);
+static const DiskGuid GUID_METADATA_REGION        = DiskGuid::Make(0x8B7CA206, 0x4790, 0x4B9A, 0xB8FE575F050F886EULL);
+static const DiskGuid GUID_FILE_PARAMETERS        = DiskGuid::Make(0xCAA16737, 0xFA36, 0x4D43, 0xB3B633F0AA44E76BULL);
+static const DiskGuid GUID_VIRTUAL_DISK_SIZE      = DiskGuid::Make(0x2FA54224, 0xCD1B, 0x4876, 0xB2115DBED83BF4B8ULL);
+static const DiskGuid GUID_VIRTUAL_DISK_ID        = DiskGuid::Make(0xBECA12AB, 0xB2E6, 0x4523, 0x93EFC309E000C746ULL);
+static const DiskGuid GUID_LOGICAL_SECTOR_SIZE    = DiskGuid::Make(0x8141BF1D, 0xA96F, 0x4709, 0xBA47F233A8FAAB5FULL);
+static const DiskGuid GUID_PHYSICAL_SECTOR_SIZE   = DiskGuid::Make(0xCDA348C7, 0x445D, 0x4471, 0x9CC9E9885251C556ULL);
+static const DiskGuid GUID_PARENT_LOCATOR         = DiskGuid::Make(0xA8D35F2D, 0xB30B, 0x454D, 0xABF7D3D84834AB0CULL);
+static const DiskGuid GUID_VHDX_PARENT_LOCATOR    = DiskGuid::Make(0xB04AEFB7, 0xD19E, 0x4A81, 0xB78925B8E9445913ULL);
+
+/********************************************************************************
+* 函数实现：校验带CRC-32C的结构（内部辅助）
+* 说明：校验和字段位于偏移4，计算时按0处理
+*********************************************************************************/
+static bool VerifyChecksum(const uint8_t* p, size_t nBytes) {
+    uint8_t ui8Zero[4] = { 0 };
+    uint32_t ui32Crc = Crc32::Castagnoli(p, 4);
+    ui32Crc = Crc32::Castagnoli(ui8Zero, 4, ui32Crc);
+    ui32Crc = Crc32::Castagnoli(p + 8, nBytes - 8, ui32Crc);
+    return ui32Crc == Read32(p + 4);
+}
+
+/********************************************************************************
+* 函数实现：UTF-16LE转UTF-8（内部辅助）
+* 说明：父磁盘定位器的键和值以UTF-16LE保存
+*********************************************************************************/
+static std::string Utf16LeToUtf8(const uint8_t* p, size_t nBytes) {
+    std::string strResult;
+    for (size_t i = 0; i + 1 < nBytes; i += 2) {
+        uint32_t ui32Code = Read16(p + i);
+        if (ui32Code >= 0xD800 && ui32Code <= 0xDBFF && i + 3 < nBytes) {
+            uint32_t ui32Low = Read16(p + i + 2);
+            if (ui32Low >= 0xDC00 && ui32Low <= 0xDFFF) {
+                ui32Code = 0x10000 + ((ui32Code - 0xD800) << 10) + (ui32Low - 0xDC00);
+                i += 2;
+            }
+        }
+        if (ui32Code < 0x80) {
+            strResult += static_cast<char>(ui32Code);
+        } else if (ui32Code < 0x800) {
+            strResult += static_cast<char>(0xC0 | (ui32Code >> 6));
+            strResult += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        } else if (ui32Code < 0x10000) {
+            strResult += static_cast<char>(0xE0 | (ui32Code >> 12));
+            strResult += static_cast<char>(0x80 | ((ui32Code >> 6) & 0x3F));
+            strResult += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        } else {
+            strResult += static_cast<char>(0xF0 | (ui32Code >> 18));
+            strResult += static_cast<char>(0x80 | ((ui32Code >> 12) & 0x3F));
+            strResult += static_cast<char>(0x80 | ((ui32Code >> 6) & 0x3F));
+            strResult += static_cast<char>(0x80 | (ui32Code & 0x3F));
+        }
+    }
+    return strResult;
+}
+
+/********************************************************************************
+* 函数实现：父磁盘的候选路径（内部辅助）
+* 说明：relative_path相对于差异磁盘所在目录（通常以.\或..\开头），其余为完整路径
+*********************************************************************************/
+static std::string ParentCandidatePath(const std::string& strChildPath, const std::string& strLocatorPath, bool bRelative) {
+    std::string strPath = strLocatorPath;
+    if (bRelative) {
+        size_t nSeparator = strChildPath.find_last_of("\\/");
+        strPath = (nSeparator == std::string::npos ? std::string(".") : strChildPath.substr(0, nSeparator)) + "\\" + strLocatorPath;
+    }
+#ifndef _WIN32
+    std::replace(strPath.begin(), strPath.end(), '\\', '/');
+#endif
+    return strPath;
+}
+
+// GUID文本大写（parent_linkage的大小写不固定）
+static std::string UpperGuidText(std::string strText) {
+    for (char& c : strText) {
+        if (c >= 'a' && c <= 'z') c = static_cast<char>(c - 'a' + 'A');
+    }
+    return strText;
+}
+
+/********************************************************************************
+* 函数实现：构造函数 / 析构函数
+*********************************************************************************/
+VhdxFile::VhdxFile(size_t nCacheBytes)
+    : m_objBitmapCache(ONE_MB, BITMAP_CACHE_BLOCKS),
+      m_objCache(CACHE_PAGE_SIZE, nCacheBytes / CACHE_PAGE_SIZE) {
+}
+
+VhdxFile::~VhdxFile() {
+    Close();
+}
+
+/********************************************************************************
+* 函数实现：打开VHDX文件
+*********************************************************************************/
+bool VhdxFile::Open(const std::string& strPath, bool bReadOnly, std::string& strError) {
+    Close();
+    std::lock_guard<std::mutex> lock(m_mtxDisk);
+    if (!OpenLayer(strPath, bReadOnly, strError)) {
+        return false;
+    }
+
+    // 差异磁盘：逐级打开父磁盘，再生成合并块映射
+    if (m_bHasParent) {
+        if (!OpenParents(strError)) {
+            strError = strPath + ": " + strError;
+            m_vecParents.clear();
+            m_objFile.Close();
+            m_mapLogOverlay.clear();
+            m_vecBat.clear();
+            return false;
+        }
+        BuildBlockMap();
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：打开链上的一个文件（内部辅助）
+* 说明：解析本文件的结构，不打开父磁盘
+*********************************************************************************/
+bool VhdxFile::OpenLayer(const std::string& strPath, bool bReadOnly, std::string& strError) {
+    m_strPath = strPath;
+
+    // 1. 打开文件并检查文件标识
+    if (!m_objFile.Open(strPath, bReadOnly, strError)) {
+        return false;
+    }
+    m_ui64LogicalFileSize = m_objFile.Size();
+    uint8_t ui8Signature[8] = { 0 };
+    if (m_objFile.Size() < REGION_TABLE_OFFSETS[1] + REGION_TABLE_SIZE ||
+        !m_objFile.ReadAt(0, ui8Signature, sizeof(ui8Signature), strError) ||
+        memcmp(ui8Signature, "vhdxfile", 8) != 0) {
+        strError = "不是有效的VHDX文件: " + strPath;
+        m_objFile.Close();
+        return false;
+    }
+
+    // 2. 头部 → 日志（可能修改后续结构）→ 区域表 → 元数据 → BAT
+    if (!LoadHeaders(strError) || !ReplayLog(strError) || !LoadRegionTable(strError) ||
+        !LoadMetadata(strError) || !LoadBat(strError)) {
+        strError = strPath + ": " + strError;
+        m_objFile.Close();
+        m_mapLogOverlay.clear();
+        m_vecBat.clear();
+        return false;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：关闭
+*********************************************************************************/
+void VhdxFile::Close() {
+    std::lock_guard<std::mutex> lock(m_mtxDisk);
+    if (m_objFile.IsOpen()) {
+        std::string strIgnored;
+        m_objFile.Flush(strIgnored);
+        m_objFile.Close();
+    }
+    m_vecBat.clear();
+    m_mapLogOverlay.clear();
+    m_objCache.Clear();
+    m_vecParents.clear();
+    m_vecBlockMap.clear();
+    m_mapParentLocator.clear();
+    m_objBitmapCache.Clear();
+    m_ui32MapUnit = 0;
+    m_ui64DiskSize = 0;
+    m_bHasParent = false;
+    m_bLogReplayed = false;
+    m_bFileWriteGuidUpdated = false;
+    m_bDataWriteGuidUpdated = false;
+}
+
+/********************************************************************************
+* 函数实现：读取文件内容（内部辅助）
+* 说明：只读打开且日志未写回时，用回放的日志扇区覆盖读到的数据
+*********************************************************************************/
+bool VhdxFile::ReadFileAt(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) {
+    uint64_t ui64Limit = m_objFile.Size() > m_ui64LogicalFileSize ? m_objFile.Size() : m_ui64LogicalFileSize;
+    if (ui64Offset > ui64Limit || nBytes > ui64Limit - ui64Offset) {
+        strError = "VHDX结构指向文件末尾之后（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+
+    // 1. 文件中实际存在的部分；日志声明的文件大小之内、实际文件末尾之后的部分为0
+    uint8_t* pDest = static_cast<uint8_t*>(pBuffer);
+    size_t nPhysical = 0;
+    if (ui64Offset < m_objFile.Size()) {
+        uint64_t ui64Available = m_objFile.Size() - ui64Offset;
+        nPhysical = ui64Available < nBytes ? static_cast<size_t>(ui64Available) : nBytes;
+        if (!m_objFile.ReadAt(ui64Offset, pDest, nPhysical, strError)) {
+            return false;
+        }
+    }
+    if (nPhysical < nBytes) {
+        memset(pDest + nPhysical, 0, nBytes - nPhysical);
+    }
+
+    // 2. 覆盖日志扇区
+    if (!m_mapLogOverlay.empty()) {
+        uint64_t ui64End = ui64Offset + nBytes;
+        auto it = m_mapLogOverlay.lower_bound(ui64Offset - ui64Offset % LOG_SECTOR_SIZE);
+        for (; it != m_mapLogOverlay.end() && it->first < ui64End; ++it) {
+            uint64_t ui64Begin = it->first > ui64Offset ? it->first : ui64Offset;
+            uint64_t ui64Stop = it->first + LOG_SECTOR_SIZE < ui64End ? it->first + LOG_SECTOR_SIZE : ui64End;
+            memcpy(pDest + (ui64Begin - ui64Offset), it->second.data() + (ui64Begin - it->first),
+                   static_cast<size_t>(ui64Stop - ui64Begin));
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：加载头部（内部辅助）
+*********************************************************************************/
+bool VhdxFile::LoadHeaders(std::string& strError) {
+    Header stcHeaders[2];
+    bool bValid[2] = { false, false };
+    std::vector<uint8_t> vecBuffer(HEADER_SIZE);
+
+    for (int i = 0; i < 2; i++) {
+        if (!ReadFileAt(HEADER_OFFSETS[i], vecBuffer.data(), HEADER_SIZE, strError)) {
+            return false;
+        }
+        const uint8_t* p = vecBuffer.data();
+        if (memcmp(p, "head", 4) != 0 || !VerifyChecksum(p, HEADER_SIZE)) {
+            continue;
+        }
+        Header& stcHeader = stcHeaders[i];
+        stcHeader.ui64Sequence = Read64(p + 8);
+        stcHeader.objFileWrite = ReadGuid(p + 16);
+        stcHeader.objDataWrite = ReadGuid(p + 32);
+        stcHeader.objLog = ReadGuid(p + 48);
+        stcHeader.ui16LogVersion = Read16(p + 64);
+        stcHeader.ui16Version = Read16(p + 66);
+        stcHeader.ui32LogLength = Read32(p + 68);
+        stcHeader.ui64LogOffset = Read64(p + 72);
+        bValid[i] = stcHeader.ui16Version == 1 && stcHeader.ui16LogVersion == 0 &&
+                    stcHeader.ui32LogLength % ONE_MB == 0 && stcHeader.ui64LogOffset % ONE_MB == 0;
+    }
+
+    // 两份都有效时取序号较大的一份
+    if (!bValid[0] && !bValid[1]) {
+        strError = "两份VHDX头部都已损坏";
+        return false;
+    }
+    if (bValid[0] && bValid[1]) {
+        m_nCurrentHeader = stcHeaders[1].ui64Sequence > stcHeaders[0].ui64Sequence ? 1 : 0;
+    } else {
+        m_nCurrentHeader = bValid[0] ? 0 : 1;
+    }
+    m_stcHeader = stcHeaders[m_nCurrentHeader];
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：回放日志（内部辅助）
+*********************************************************************************/
+bool VhdxFile::ReplayLog(std::string& strError) {
+    if (m_stcHeader.objLog.IsZero()) {
+        return true;
+    }
+    const uint64_t ui64LogLength = m_stcHeader.ui32LogLength;
+    if (ui64LogLength == 0 || m_stcHeader.ui64LogOffset < ONE_MB) {
+        strError = "VHDX日志区域无效";
+        return false;
+    }
+
+    // 1. 读入整个日志（循环缓冲区，通常1MB）
+    std::vector<uint8_t> vecLog(static_cast<size_t>(ui64LogLength));
+    if (!ReadFileAt(m_stcHeader.ui64LogOffset, vecLog.data(), vecLog.size(), strError)) {
+        return false;
+    }
+    auto Sector = [&](uint64_t ui64Position) {
+        return vecLog.data() + (ui64Position % ui64LogLength);
+    };
+
+    // 2. 解析并校验一个日志项：头部、描述符、数据扇区及整项的CRC-32C
+    struct LogEntry {
+        uint64_t ui64Position = 0;          // 在日志中的偏移
+        uint32_t ui32Length = 0;            // 日志项长度
+        uint32_t ui32Tail = 0;              // 序列中第一个日志项的偏移
+        uint64_t ui64Sequence = 0;          // 序号
+        uint32_t ui32Descriptors = 0;       // 描述符数
+        uint64_t ui64DescriptorSectors = 0; // 头部和描述符占用的扇区数
+        uint64_t ui64FlushedFileOffset = 0; // 写入日志时文件至少应有的大小
+        uint64_t ui64LastFileOffset = 0;    // 回放后文件应有的大小
+    };
+    auto ParseEntry = [&](uint64_t ui64Position, LogEntry& stcEntry) -> bool {
+        const uint8_t* p = Sector(ui64Position);
+        if (memcmp(p, "loge", 4) != 0) return false;
+        stcEntry.ui64Position = ui64Position;
+        stcEntry.ui32Length = Read32(p + 8);
+        stcEntry.ui32Tail = Read32(p + 12);
+        stcEntry.ui64Sequence = Read64(p + 16);
+        stcEntry.ui32Descriptors = Read32(p + 24);
+        stcEntry.ui64FlushedFileOffset = Read64(p + 48);
+        stcEntry.ui64LastFileOffset = Read64(p + 56);
+        if (stcEntry.ui32Length == 0 || stcEntry.ui32Length % LOG_SECTOR_SIZE != 0 || stcEntry.ui32Length > ui64LogLength ||
+            stcEntry.ui32Tail % LOG_SECTOR_SIZE != 0 || stcEntry.ui32Tail >= ui64LogLength ||
+            stcEntry.ui64Sequence == 0 || ReadGuid(p + 32) != m_stcHeader.objLog) {
+            return false;
+        }
+        uint64_t ui64Sectors = stcEntry.ui32Length / LOG_SECTOR_SIZE;
+        stcEntry.ui64DescriptorSectors = (64 + 32 * static_cast<uint64_t>(stcEntry.ui32Descriptors) + LOG_SECTOR_SIZE - 1) / LOG_SECTOR_SIZE;
+        if (stcEntry.ui64DescriptorSectors > ui64Sectors) return false;
+
+        uint8_t ui8Zero[4] = { 0 };
+        uint32_t ui32Crc = Crc32::Castagnoli(p, 4);
+        ui32Crc = Crc32::Castagnoli(ui8Zero, 4, ui32Crc);
+        ui32Crc = Crc32::Castagnoli(p + 8, LOG_SECTOR_SIZE - 8, ui32Crc);
+        for (uint64_t i = 1; i < ui64Sectors; i++) {
+            ui32Crc = Crc32::Castagnoli(Sector(ui64Position + i * LOG_SECTOR_SIZE), LOG_SECTOR_SIZE, ui32Crc);
+        }
+        if (ui32Crc != Read32(p + 4)) return false;
+
+        uint64_t ui64DataSectors = 0;
+        for (uint32_t i = 0; i < stcEntry.ui32Descriptors; i++) {
+            uint64_t ui64Byte = 64 + 32 * static_cast<uint64_t>(i);
+            const uint8_t* pDesc = Sector(ui64Position + ui64Byte / LOG_SECTOR_SIZE * LOG_SECTOR_SIZE) + ui64Byte % LOG_SECTOR_SIZE;
+            if (Read64(pDesc + 24) != stcEntry.ui64Sequence || Read64(pDesc + 16) % LOG_SECTOR_SIZE != 0) return false;
+            if (memcmp(pDesc, "zero", 4) == 0) {
+                if (Read64(pDesc + 8) % LOG_SECTOR_SIZE != 0) return false;
+            } else if (memcmp(pDesc, "desc", 4) == 0) {
+                uint64_t ui64Sector = stcEntry.ui64DescriptorSectors + ui64DataSectors++;
+                if (ui64Sector >= ui64Sectors) return false;
+                const uint8_t* pData = Sector(ui64Position + ui64Sector * LOG_SECTOR_SIZE);
+                uint64_t ui64DataSequence = (static_cast<uint64_t>(Read32(pData + 4)) << 32) | Read32(pData + LOG_SECTOR_SIZE - 4);
+                if (memcmp(pData, "data", 4) != 0 || ui64DataSequence != stcEntry.ui64Sequence) return false;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::map<uint64_t, LogEntry> mapEntries;
+    for (uint64_t ui64Position = 0; ui64Position < ui64LogLength; ui64Position += LOG_SECTOR_SIZE) {
+        LogEntry stcEntry;
+        if (ParseEntry(ui64Position, stcEntry)) {
+            mapEntries[ui64Position] = stcEntry;
+        }
+    }
+
+    // 3. 活动序列：从某个日志项的Tail开始，序号连续地走到该日志项本身；
+    //    多个候选时取结尾序号最大的一个
+    std::vector<LogEntry> vecActive;
+    for (const auto& [ui64HeadPosition, stcHead] : mapEntries) {
+        if (!vecActive.empty() && vecActive.back().ui64Sequence >= stcHead.ui64Sequence) continue;
+        std::vector<LogEntry> vecSequence;
+        uint64_t ui64Position = stcHead.ui32Tail;
+        for (size_t nSteps = 0; nSteps < mapEntries.size(); nSteps++) {
+            auto it = mapEntries.find(ui64Position);
+            if (it == mapEntries.end()) break;
+            if (!vecSequence.empty() && it->second.ui64Sequence != vecSequence.back().ui64Sequence + 1) break;
+            vecSequence.push_back(it->second);
+            if (ui64Position == ui64HeadPosition) {
+                vecActive = std::move(vecSequence);
+                break;
+            }
+            ui64Position = (ui64Position + it->second.ui32Length) % ui64LogLength;
+        }
+    }
+
+    // 4. 按顺序收集要写回的扇区（后写的覆盖先写的）
+    if (!vecActive.empty()) {
+        const LogEntry& stcHead = vecActive.back();
+        if (m_objFile.Size() < stcHead.ui64FlushedFileOffset) {
+            strError = "VHDX文件被截断，日志无法回放";
+            return false;
+        }
+        for (const LogEntry& stcEntry : vecActive) {
+            uint64_t ui64DataSectors = 0;
+            for (uint32_t i = 0; i < stcEntry.ui32Descriptors; i++) {
+                uint64_t ui64Byte = 64 + 32 * static_cast<uint64_t>(i);
+                const uint8_t* pDesc = Sector(stcEntry.ui64Position + ui64Byte / LOG_SECTOR_SIZE * LOG_SECTOR_SIZE) + ui64Byte % LOG_SECTOR_SIZE;
+                uint64_t ui64FileOffset = Read64(pDesc + 16);
+                if (memcmp(pDesc, "zero", 4) == 0) {
+                    for (uint64_t ui64Zero = 0; ui64Zero < Read64(pDesc + 8); ui64Zero += LOG_SECTOR_SIZE) {
+                        m_mapLogOverlay[ui64FileOffset + ui64Zero].assign(LOG_SECTOR_SIZE, 0);
+                    }
+                } else {
+                    // 数据扇区 = 描述符中的前8字节 + 数据扇区的4084字节 + 描述符中的后4字节
+                    uint64_t ui64Sector = stcEntry.ui64DescriptorSectors + ui64DataSectors++;
+                    const uint8_t* pData = Sector(stcEntry.ui64Position + ui64Sector * LOG_SECTOR_SIZE);
+                    std::vector<uint8_t>& vecSector = m_mapLogOverlay[ui64FileOffset];
+                    vecSector.resize(LOG_SECTOR_SIZE);
+                    memcpy(vecSector.data(), pDesc + 8, 8);
+                    memcpy(vecSector.data() + 8, pData + 8, LOG_SECTOR_SIZE - 12);
+                    memcpy(vecSector.data() + LOG_SECTOR_SIZE - 4, pDesc + 4, 4);
+                }
+            }
+        }
+        if (stcHead.ui64LastFileOffset > m_ui64LogicalFileSize) {
+            m_ui64LogicalFileSize = stcHead.ui64LastFileOffset;
+        }
+        m_bLogReplayed = true;
+    }
+
+    // 5. 只读：保留在内存中；读写：先更新FileWriteGuid，写回并刷新后清除LogGuid
+    if (m_objFile.IsReadOnly()) {
+        return true;
+    }
+    if (!BeginWrite(false, strError)) {
+        return false;
+    }
+    for (const auto& [ui64FileOffset, vecSector] : m_mapLogOverlay) {
+        if (!m_objFile.WriteAt(ui64FileOffset, vecSector.data(), vecSector.size(), strError)) {
+            return false;
+        }
+    }
+    if (m_objFile.Size() < m_ui64LogicalFileSize && !m_objFile.Resize(m_ui64LogicalFileSize, strError)) {
+        return false;
+    }
+    if (!m_objFile.Flush(strError)) {
+        return false;
+    }
+    m_mapLogOverlay.clear();
+    m_stcHeader.objLog = DiskGuid();
+    return WriteHeaders(strError);
+}
+
+/********************************************************************************
+* 函数实现：加载区域表（内部辅助）
+*********************************************************************************/
+bool VhdxFile::LoadRegionTable(std::string& strError) {
+    std::vector<uint8_t> vecBuffer(REGION_TABLE_SIZE);
+    for (int i = 0; i < 2; i++) {
+        if (!ReadFileAt(REGION_TABLE_OFFSETS[i], vecBuffer.data(), REGION_TABLE_SIZE, strError)) {
+            return false;
+        }
+        const uint8_t* p = vecBuffer.data();
+        uint32_t ui32Entries = Read32(p + 8);
+        if (memcmp(p, "regi", 4) != 0 || !VerifyChecksum(p, REGION_TABLE_SIZE) || ui32Entries > MAX_TABLE_ENTRIES) {
+            continue;
+        }
+
+        bool bBat = false, bMetadata = false;
+        for (uint32_t j = 0; j < ui32Entries; j++) {
+            const uint8_t* pEntry = p + 16 + 32 * j;
+            DiskGuid objGuid = ReadGuid(pEntry);
+            uint64_t ui64Offset = Read64(pEntry + 16);
+            uint32_t ui32Length = Read32(pEntry + 24);
+            bool bRequired = (Read32(pEntry + 28) & 1) != 0;
+            if (objGuid == GUID_BAT_REGION) {
+                m_ui64BatOffset = ui64Offset;
+                m_ui32BatLength = ui32Length;
+                bBat = true;
+            } else if (objGuid == GUID_METADATA_REGION) {
+                m_ui64MetadataOffset = ui64Offset;
+                m_ui32MetadataLength = ui32Length;
+                bMetadata = true;
+            } else if (bRequired) {
+                strError = "VHDX包含不支持的必需区域 " + objGuid.ToString();
+                return false;
+            } else {
+                continue;
+            }
+            if (ui64Offset < ONE_MB || ui64Offset % ONE_MB != 0 || ui32Length % ONE_MB != 0) {
+                strError = "VHDX区域位置无效 " + objGuid.ToString();
+                return false;
+            }
+        }
+        if (!bBat || !bMetadata || m_ui32MetadataLength < METADATA_TABLE_SIZE) {
+            strError = "VHDX区域表缺少BAT或元数据区域";
+            return false;
+        }
+        return true;
+    }
+    strError = "两份VHDX区域表都已损坏";
+    return false;
+}
+
+/********************************************************************************
+* 函数实现：加载元数据（内部辅助）
+*********************************************************************************/
+bool VhdxFile::LoadMetadata(std::string& strError) {
+    std::vector<uint8_t> vecTable(METADATA_TABLE_SIZE);
+    if (!ReadFileAt(m_ui64MetadataOffset, vecTable.data(), METADATA_TABLE_SIZE, strError)) {
+        return false;
+    }
+    const uint8_t* p = vecTable.data();
+    uint16_t ui16Entries = Read16(p + 10);
+    if (memcmp(p, "metadata", 8) != 0 || ui16Entries > MAX_TABLE_ENTRIES) {
+        strError = "VHDX元数据表无效";
+        return false;
+    }
+
+    // 1. 读取已知的元数据项，遇到不认识的必需项时拒绝打开
+    bool bFileParameters = false, bDiskSize = false, bLogicalSector = false, bPhysicalSector = false;
+    for (uint16_t i = 0; i < ui16Entries; i++) {
+        const uint8_t* pEntry = p + 32 + 32 * i;
+        DiskGuid objGuid = ReadGuid(pEntry);
+        uint32_t ui32Offset = Read32(pEntry + 16);
+        uint32_t ui32Length = Read32(pEntry + 20);
+        bool bRequired = (Read32(pEntry + 24) & 4) != 0;
+        if (ui32Length > 0 && (ui32Offset < METADATA_TABLE_SIZE || ui32Offset > m_ui32MetadataLength ||
+                               ui32Length > m_ui32MetadataLength - ui32Offset)) {
+            strError = "VHDX元数据项位置无效 " + objGuid.ToString();
+            return false;
+        }
+        std::vector<uint8_t> vecItem(ui32Length);
+        if (ui32Length > 0 && !ReadFileAt(m_ui64MetadataOffset + ui32Offset, vecItem.data(), ui32Length, strError)) {
+            return false;
+        }
+
+        if (objGuid == GUID_FILE_PARAMETERS && ui32Length >= 8) {
+            m_ui32BlockSize = Read32(vecItem.data());
+            m_bHasParent = (Read32(vecItem.data() + 4) & 2) != 0;
+            bFileParameters = true;
+        } else if (objGuid == GUID_VIRTUAL_DISK_SIZE && ui32Length >= 8) {
+            m_ui64DiskSize = Read64(vecItem.data());
+            bDiskSize = true;
+        } else if (objGuid == GUID_VIRTUAL_DISK_ID && ui32Length >= 16) {
+            m_objDiskId = ReadGuid(vecItem.data());
+        } else if (objGuid == GUID_LOGICAL_SECTOR_SIZE && ui32Length >= 4) {
+            m_ui32LogicalSectorSize = Read32(vecItem.data());
+            bLogicalSector = true;
+        } else if (objGuid == GUID_PHYSICAL_SECTOR_SIZE && ui32Length >= 4) {
+            m_ui32PhysicalSectorSize = Read32(vecItem.data());
+            bPhysicalSector = true;
+        } else if (objGuid == GUID_PARENT_LOCATOR) {
+            // 父磁盘定位器：类型GUID + 键值对数量 + 键值对表（偏移相对于本项开头，UTF-16LE）
+            if (ui32Length < 20 || ReadGuid(vecItem.data()) != GUID_VHDX_PARENT_LOCATOR) {
+                strError = "VHDX父磁盘定位器类型不受支持";
+                return false;
+            }
+            uint16_t ui16Pairs = Read16(vecItem.data() + 18);
+            if (20 + 12 * static_cast<uint64_t>(ui16Pairs) > ui32Length) {
+                strError = "VHDX父磁盘定位器无效";
+                return false;
+            }
+            for (uint16_t j = 0; j < ui16Pairs; j++) {
+                const uint8_t* pPair = vecItem.data() + 20 + 12 * j;
+                uint32_t ui32KeyOffset = Read32(pPair), ui32ValueOffset = Read32(pPair + 4);
+                uint16_t ui16KeyLength = Read16(pPair + 8), ui16ValueLength = Read16(pPair + 10);
+                if (ui32KeyOffset > ui32Length || ui16KeyLength > ui32Length - ui32KeyOffset ||
+                    ui32ValueOffset > ui32Length || ui16ValueLength > ui32Length - ui32ValueOffset) {
+                    strError = "VHDX父磁盘定位器无效";
+                    return false;
+                }
+                m_mapParentLocator[Utf16LeToUtf8(vecItem.data() + ui32KeyOffset, ui16KeyLength)] =
+                    Utf16LeToUtf8(vecItem.data() + ui32ValueOffset, ui16ValueLength);
+            }
+        } else if (bRequired) {
+            strError = "VHDX包含不支持的必需元数据 " + objGuid.ToString();
+            return false;
+        }
+    }
+
+    // 2. 检查取值范围
+    if (!bFileParameters || !bDiskSize || !bLogicalSector || !bPhysicalSector) {
+        strError = "VHDX缺少必需的元数据项";
+        return false;
+    }
+    if (m_ui32BlockSize < ONE_MB || m_ui32BlockSize > 256 * ONE_MB || (m_ui32BlockSize & (m_ui32BlockSize - 1)) != 0) {
+        strError = "VHDX块大小无效: " + std::to_string(m_ui32BlockSize);
+        return false;
+    }
+    if ((m_ui32LogicalSectorSize != 512 && m_ui32LogicalSectorSize != 4096) ||
+        (m_ui32PhysicalSectorSize != 512 && m_ui32PhysicalSectorSize != 4096)) {
+        strError = "VHDX扇区大小无效: " + std::to_string(m_ui32LogicalSectorSize);
+        return false;
+    }
+    if (m_ui64DiskSize == 0 || m_ui64DiskSize % m_ui32LogicalSectorSize != 0 || m_ui64DiskSize > 64 * ONE_MB * ONE_MB) {
+        strError = "VHDX虚拟磁盘大小无效: " + std::to_string(m_ui64DiskSize);
+        return false;
+    }
+    if (m_bHasParent && m_mapParentLocator.find("parent_linkage") == m_mapParentLocator.end()) {
+        strError = "差异磁盘缺少父磁盘定位器";
+        return false;
+    }
+    m_ui64ChunkRatio = (static_cast<uint64_t>(1) << 23) * m_ui32LogicalSectorSize / m_ui32BlockSize;
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：加载块分配表（内部辅助）
+*********************************************************************************/
+bool VhdxFile::LoadBat(std::string& strError) {
+    // 每chunk ratio个数据块之后跟一个扇区位图块的BAT项；差异磁盘最后一个chunk也有位图项
+    uint64_t ui64DataBlocks = (m_ui64DiskSize + m_ui32BlockSize - 1) / m_ui32BlockSize;
+    uint64_t ui64Chunks = (ui64DataBlocks + m_ui64ChunkRatio - 1) / m_ui64ChunkRatio;
+    uint64_t ui64Entries = m_bHasParent ? ui64Chunks * (m_ui64ChunkRatio + 1)
+                                        : ui64DataBlocks + (ui64DataBlocks - 1) / m_ui64ChunkRatio;
+    if (ui64Entries * sizeof(uint64_t) > m_ui32BatLength) {
+        strError = "VHDX块分配表长度不足";
+        return false;
+    }
+    m_vecBat.resize(static_cast<size_t>(ui64Entries));
+    if (!ReadFileAt(m_ui64BatOffset, m_vecBat.data(), m_vecBat.size() * sizeof(uint64_t), strError)) {
+        return false;
+    }
+
+    // 已分配的块必须位于文件之内
+    uint64_t ui64FileSize = m_objFile.Size() > m_ui64LogicalFileSize ? m_objFile.Size() : m_ui64LogicalFileSize;
+    for (uint64_t ui64Block = 0; ui64Block < ui64DataBlocks; ui64Block++) {
+        uint64_t ui64Entry = m_vecBat[static_cast<size_t>(BatIndex(ui64Block))];
+        uint64_t ui64State = ui64Entry & BAT_STATE_MASK;
+        if (ui64State == PAYLOAD_BLOCK_FULLY_PRESENT || (m_bHasParent && ui64State == PAYLOAD_BLOCK_PARTIALLY_PRESENT)) {
+            uint64_t ui64FileOffset = (ui64Entry >> 20) * ONE_MB;
+            if (ui64FileOffset < ONE_MB || ui64FileOffset + m_ui32BlockSize > ui64FileSize) {
+                strError = "VHDX块分配表项指向文件之外（块 " + std::to_string(ui64Block) + "）";
+                return false;
+            }
+        } else if (ui64State != PAYLOAD_BLOCK_NOT_PRESENT && ui64State != PAYLOAD_BLOCK_UNDEFINED &&
+                   ui64State != PAYLOAD_BLOCK_ZERO && ui64State != PAYLOAD_BLOCK_UNMAPPED) {
+            strError = "VHDX块分配表项状态无效（块 " + std::to_string(ui64Block) + "）";
+            return false;
+        }
+    }
+
+    // 差异磁盘的扇区位图块
+    for (uint64_t ui64Chunk = 0; m_bHasParent && ui64Chunk < ui64Chunks; ui64Chunk++) {
+        uint64_t ui64Entry = m_vecBat[static_cast<size_t>(BitmapIndex(ui64Chunk))];
+        uint64_t ui64State = ui64Entry & BAT_STATE_MASK;
+        uint64_t ui64FileOffset = (ui64Entry >> 20) * ONE_MB;
+        if ((ui64State != SB_BLOCK_PRESENT && ui64State != SB_BLOCK_NOT_PRESENT) ||
+            (ui64State == SB_BLOCK_PRESENT && (ui64FileOffset < ONE_MB || ui64FileOffset + ONE_MB > ui64FileSize))) {
+            strError = "VHDX扇区位图项无效（chunk " + std::to_string(ui64Chunk) + "）";
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：逐级打开父磁盘（内部辅助）
+*********************************************************************************/
+bool VhdxFile::OpenParents(std::string& strError) {
+    VhdxFile* pChild = this;
+    while (pChild->m_bHasParent) {
+        if (m_vecParents.size() >= MAX_CHAIN_DEPTH) {
+            strError = "差异磁盘链超过" + std::to_string(MAX_CHAIN_DEPTH) + "层";
+            return false;
+        }
+
+        // 1. 依次尝试relative_path、volume_path、absolute_win32_path（虚拟机目录被整体移动时相对路径仍然有效）
+        const std::map<std::string, std::string>& mapLocator = pChild->m_mapParentLocator;
+        std::unique_ptr<VhdxFile> pParent;
+        std::string strTried;
+        for (const char* pszKey : { "relative_path", "volume_path", "absolute_win32_path" }) {
+            auto it = mapLocator.find(pszKey);
+            if (it == mapLocator.end() || it->second.empty()) {
+                continue;
+            }
+            std::string strCandidate = ParentCandidatePath(pChild->m_strPath, it->second, it->first == "relative_path");
+            auto pCandidate = std::make_unique<VhdxFile>(0);
+            std::string strOpenError;
+            if (pCandidate->OpenLayer(strCandidate, true, strOpenError)) {
+                pParent = std::move(pCandidate);
+                break;
+            }
+            strTried += (strTried.empty() ? "" : "; ") + strOpenError;
+        }
+        if (!pParent) {
+            strError = "找不到 " + pChild->m_strPath + " 的父磁盘" + (strTried.empty() ? "" : "（" + strTried + "）");
+            return false;
+        }
+
+        // 2. parent_linkage（或parent_linkage2）必须是父磁盘当前的DataWriteGuid，
+        //    否则父磁盘在创建差异磁盘之后被单独修改过，链上的数据已不一致
+        std::string strDataWrite = pParent->m_stcHeader.objDataWrite.ToString();
+        auto itLinkage = mapLocator.find("parent_linkage");
+        auto itLinkage2 = mapLocator.find("parent_linkage2");
+        if (UpperGuidText(itLinkage->second) != strDataWrite &&
+            (itLinkage2 == mapLocator.end() || UpperGuidText(itLinkage2->second) != strDataWrite)) {
+            strError = pParent->m_strPath + " 在创建差异磁盘 " + pChild->m_strPath + " 之后被修改过（parent_linkage不匹配）";
+            return false;
+        }
+
+        // 3. 整条链的虚拟磁盘大小和逻辑扇区大小必须一致
+        if (pParent->m_ui64DiskSize != m_ui64DiskSize || pParent->m_ui32LogicalSectorSize != m_ui32LogicalSectorSize) {
+            strError = pParent->m_strPath + " 的磁盘大小或扇区大小与差异磁盘不一致";
+            return false;
+        }
+        m_vecParents.push_back(std::move(pParent));
+        pChild = m_vecParents.back().get();
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：生成合并块映射（内部辅助）
+* 说明：映射单元取链上最小的块大小，每个单元总是落在每一层的某一个块之内
+*********************************************************************************/
+void VhdxFile::BuildBlockMap() {
+    m_ui32MapUnit = m_ui32BlockSize;
+    for (const auto& pParent : m_vecParents) {
+        if (pParent->m_ui32BlockSize < m_ui32MapUnit) {
+            m_ui32MapUnit = pParent->m_ui32BlockSize;
+        }
+    }
+
+    // 每个单元从最上层向下找第一个确定了内容的层；都未提供数据时读出为0
+    uint64_t ui64Units = (m_ui64DiskSize + m_ui32MapUnit - 1) / m_ui32MapUnit;
+    m_vecBlockMap.assign(static_cast<size_t>(ui64Units), BlockMapping());
+    for (uint64_t ui64Unit = 0; ui64Unit < ui64Units; ui64Unit++) {
+        uint64_t ui64Offset = ui64Unit * m_ui32MapUnit;
+        BlockMapping& stcMapping = m_vecBlockMap[static_cast<size_t>(ui64Unit)];
+        for (size_t nLayer = 0; nLayer <= m_vecParents.size(); nLayer++) {
+            VhdxFile& objLayer = Layer(nLayer);
+            uint64_t ui64Entry = objLayer.m_vecBat[static_cast<size_t>(objLayer.BatIndex(ui64Offset / objLayer.m_ui32BlockSize))];
+            uint64_t ui64State = ui64Entry & BAT_STATE_MASK;
+            if (ui64State == PAYLOAD_BLOCK_NOT_PRESENT || ui64State == PAYLOAD_BLOCK_UNDEFINED) {
+                continue;
+            }
+            if (ui64State == PAYLOAD_BLOCK_FULLY_PRESENT || ui64State == PAYLOAD_BLOCK_PARTIALLY_PRESENT) {
+                stcMapping.ui64FileOffset = (ui64Entry >> 20) * ONE_MB + ui64Offset % objLayer.m_ui32BlockSize;
+                stcMapping.ui32Layer = static_cast<uint32_t>(nLayer);
+                stcMapping.eState = ui64State == PAYLOAD_BLOCK_FULLY_PRESENT ? MapState::Present : MapState::Partial;
+            }
+            break;
+        }
+    }
+}
+
+/********************************************************************************
+* 函数实现：写入两份头部（内部辅助）
+* 说明：先写非当前的一份并刷新，再写另一份，任意时刻至少有一份有效
+*********************************************************************************/
+bool VhdxFile::WriteHeaders(std::string& strError) {
+    std::vector<uint8_t> vecBuffer(HEADER_SIZE);
+    for (int i = 0; i < 2; i++) {
+        m_stcHeader.ui64Sequence++;
+        std::fill(vecBuffer.begin(), vecBuffer.end(), static_cast<uint8_t>(0));
+        uint8_t* p = vecBuffer.data();
+        memcpy(p, "head", 4);
+        Write64(p + 8, m_stcHeader.ui64Sequence);
+        memcpy(p + 16, m_stcHeader.objFileWrite.ui8Bytes, 16);
+        memcpy(p + 32, m_stcHeader.objDataWrite.ui8Bytes, 16);
+        memcpy(p + 48, m_stcHeader.objLog.ui8Bytes, 16);
+        Write16(p + 64, m_stcHeader.ui16LogVersion);
+        Write16(p + 66, m_stcHeader.ui16Version);
+        Write32(p + 68, m_stcHeader.ui32LogLength);
+        Write64(p + 72, m_stcHeader.ui64LogOffset);
+        Write32(p + 4, Crc32::Castagnoli(p, HEADER_SIZE));
+
+        int nTarget = 1 - m_nCurrentHeader;
+        if (!m_objFile.WriteAt(HEADER_OFFSETS[nTarget], p, HEADER_SIZE, strError) || !m_objFile.Flush(strError)) {
+            return false;
+        }
+        m_nCurrentHeader = nTarget;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：第一次修改前更新头部GUID（内部辅助）
+*********************************************************************************/
+bool VhdxFile::BeginWrite(bool bDataWrite, std::string& strError) {
+    bool bChanged = false;
+    if (!m_bFileWriteGuidUpdated) {
+        m_stcHeader.objFileWrite = DiskGuid::Random();
+        m_bFileWriteGuidUpdated = true;
+        bChanged = true;
+    }
+    if (bDataWrite && !m_bDataWriteGuidUpdated) {
+        m_stcHeader.objDataWrite = DiskGuid::Random();
+        m_bDataWriteGuidUpdated = true;
+        bChanged = true;
+    }
+    return !bChanged || WriteHeaders(strError);
+}
+
+/********************************************************************************
+* 函数实现：不经过缓存读取（内部辅助）
+*********************************************************************************/
+bool VhdxFile::ReadUncached(uint64_t ui64Offset, char* pBuffer, size_t nBytes, std::string& strError) {
+    // 差异磁盘：按合并块映射直接定位到拥有数据的层
+    if (!m_vecBlockMap.empty()) {
+        while (nBytes > 0) {
+            const BlockMapping& stcMapping = m_vecBlockMap[static_cast<size_t>(ui64Offset / m_ui32MapUnit)];
+            uint32_t ui32InUnit = static_cast<uint32_t>(ui64Offset % m_ui32MapUnit);
+            size_t nChunk = m_ui32MapUnit - ui32InUnit;
+            if (nChunk > nBytes) nChunk = nBytes;
+
+            if (stcMapping.eState == MapState::Present) {
+                if (!Layer(stcMapping.ui32Layer).ReadFileAt(stcMapping.ui64FileOffset + ui32InUnit, pBuffer, nChunk, strError)) {
+                    return false;
+                }
+            } else if (stcMapping.eState == MapState::Partial) {
+                if (!ReadPartial(stcMapping.ui32Layer, stcMapping.ui64FileOffset + ui32InUnit, ui64Offset, pBuffer, nChunk, strError)) {
+                    return false;
+                }
+            } else {
+                memset(pBuffer, 0, nChunk);
+            }
+            pBuffer += nChunk;
+            ui64Offset += nChunk;
+            nBytes -= nChunk;
+        }
+        return true;
+    }
+
+    while (nBytes > 0) {
+        uint64_t ui64Block = ui64Offset / m_ui32BlockSize;
+        uint32_t ui32InBlock = static_cast<uint32_t>(ui64Offset % m_ui32BlockSize);
+        size_t nChunk = m_ui32BlockSize - ui32InBlock;
+        if (nChunk > nBytes) nChunk = nBytes;
+
+        uint64_t ui64Entry = m_vecBat[static_cast<size_t>(BatIndex(ui64Block))];
+        if ((ui64Entry & BAT_STATE_MASK) == PAYLOAD_BLOCK_FULLY_PRESENT) {
+            if (!ReadFileAt((ui64Entry >> 20) * ONE_MB + ui32InBlock, pBuffer, nChunk, strError)) {
+                return false;
+            }
+        } else {
+            // 未分配、零块、已取消映射的块读出为0
+            memset(pBuffer, 0, nChunk);
+        }
+        pBuffer += nChunk;
+        ui64Offset += nChunk;
+        nBytes -= nChunk;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：从链上的某一层开始读取（内部辅助）
+* 说明：部分存在的块中未写入的扇区由下一层提供
+*********************************************************************************/
+bool VhdxFile::ReadLayer(size_t nLayer, uint64_t ui64Offset, char* pBuffer, size_t nBytes, std::string& strError) {
+    VhdxFile& objLayer = Layer(nLayer);
+    while (nBytes > 0) {
+        uint64_t ui64Block = ui64Offset / objLayer.m_ui32BlockSize;
+        uint32_t ui32InBlock = static_cast<uint32_t>(ui64Offset % objLayer.m_ui32BlockSize);
+        size_t nChunk = objLayer.m_ui32BlockSize - ui32InBlock;
+        if (nChunk > nBytes) nChunk = nBytes;
+
+        uint64_t ui64Entry = objLayer.m_vecBat[static_cast<size_t>(objLayer.BatIndex(ui64Block))];
+        uint64_t ui64State = ui64Entry & BAT_STATE_MASK;
+        uint64_t ui64FileOffset = (ui64Entry >> 20) * ONE_MB + ui32InBlock;
+        bool bSuccess = true;
+        if (ui64State == PAYLOAD_BLOCK_FULLY_PRESENT) {
+            bSuccess = objLayer.ReadFileAt(ui64FileOffset, pBuffer, nChunk, strError);
+        } else if (ui64State == PAYLOAD_BLOCK_PARTIALLY_PRESENT) {
+            bSuccess = ReadPartial(nLayer, ui64FileOffset, ui64Offset, pBuffer, nChunk, strError);
+        } else if ((ui64State == PAYLOAD_BLOCK_NOT_PRESENT || ui64State == PAYLOAD_BLOCK_UNDEFINED) && nLayer < m_vecParents.size()) {
+            bSuccess = ReadLayer(nLayer + 1, ui64Offset, pBuffer, nChunk, strError);
+        } else {
+            memset(pBuffer, 0, nChunk);
+        }
+        if (!bSuccess) {
+            return false;
+        }
+        pBuffer += nChunk;
+        ui64Offset += nChunk;
+        nBytes -= nChunk;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取部分存在的块（内部辅助）
+* 说明：范围在该层的一个块之内；ui64FileOffset是ui64Offset在该层文件中的位置。
+*       扇区位图中置位的扇区在该层，其余由下一层提供
+*********************************************************************************/
+bool VhdxFile::ReadPartial(size_t nLayer, uint64_t ui64FileOffset, uint64_t ui64Offset, char* pBuffer, size_t nBytes,
+                           std::string& strError) {
+    VhdxFile& objLayer = Layer(nLayer);
+    uint64_t ui64ChunkBytes = objLayer.m_ui64ChunkRatio * objLayer.m_ui32BlockSize;
+    uint64_t ui64Chunk = ui64Offset / ui64ChunkBytes;
+
+    // 1. 该层该chunk的扇区位图（1MB，每位对应一个逻辑扇区），各层共用一个缓存
+    uint64_t ui64Key = (static_cast<uint64_t>(nLayer) << 40) | ui64Chunk;
+    const char* pBitmap = m_objBitmapCache.Lookup(ui64Key);
+    if (!pBitmap) {
+        char* pNew = m_objBitmapCache.Insert(ui64Key);
+        uint64_t ui64Entry = objLayer.m_vecBat[static_cast<size_t>(objLayer.BitmapIndex(ui64Chunk))];
+        if ((ui64Entry & BAT_STATE_MASK) == SB_BLOCK_PRESENT) {
+            if (!objLayer.ReadFileAt((ui64Entry >> 20) * ONE_MB, pNew, ONE_MB, strError)) {
+                m_objBitmapCache.Erase(ui64Key);
+                return false;
+            }
+        } else {
+            memset(pNew, 0, ONE_MB);
+        }
+        pBitmap = pNew;
+    }
+
+    // 2. 按位图把范围分成连续的段（读取下层时位图可能被淘汰，先全部记下）
+    const uint64_t ui64SectorSize = objLayer.m_ui32LogicalSectorSize;
+    std::vector<std::pair<size_t, bool>> vecRuns;   // 段长度、是否在本层
+    for (size_t nDone = 0; nDone < nBytes;) {
+        uint64_t ui64Position = ui64Offset + nDone;
+        uint64_t ui64Sector = (ui64Position - ui64Chunk * ui64ChunkBytes) / ui64SectorSize;
+        bool bPresent = ((static_cast<uint8_t>(pBitmap[ui64Sector / 8]) >> (ui64Sector % 8)) & 1) != 0;
+        size_t nRun = static_cast<size_t>(ui64SectorSize - ui64Position % ui64SectorSize);
+        if (nRun > nBytes - nDone) nRun = nBytes - nDone;
+        if (!vecRuns.empty() && vecRuns.back().second == bPresent) {
+            vecRuns.back().first += nRun;
+        } else {
+            vecRuns.emplace_back(nRun, bPresent);
+        }
+        nDone += nRun;
+    }
+
+    // 3. 逐段读取
+    for (const auto& [nRun, bPresent] : vecRuns) {
+        bool bSuccess = true;
+        if (bPresent) {
+            bSuccess = objLayer.ReadFileAt(ui64FileOffset, pBuffer, nRun, strError);
+        } else if (nLayer < m_vecParents.size()) {
+            bSuccess = ReadLayer(nLayer + 1, ui64Offset, pBuffer, nRun, strError);
+        } else {
+            memset(pBuffer, 0, nRun);
+        }
+        if (!bSuccess) {
+            return false;
+        }
+        pBuffer += nRun;
+        ui64Offset += nRun;
+        ui64FileOffset += nRun;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：读取
+*********************************************************************************/
+bool VhdxFile::Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) {
+    std::lock_guard<std::mutex> lock(m_mtxDisk);
+    if (!m_objFile.IsOpen()) {
+        strError = "VHDX文件未打开";
+        return false;
+    }
+    if (ui64Offset > m_ui64DiskSize || nBytes > m_ui64DiskSize - ui64Offset) {
+        strError = "读取超出虚拟磁盘范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+
+    // 大块顺序读取直接读文件，避免冲掉缓存中的元数据页
+    char* pDest = static_cast<char*>(pBuffer);
+    if (m_objCache.Capacity() == 0 || nBytes >= 4 * CACHE_PAGE_SIZE) {
+        return ReadUncached(ui64Offset, pDest, nBytes, strError);
+    }
+
+    while (nBytes > 0) {
+        uint64_t ui64Page = ui64Offset / CACHE_PAGE_SIZE;
+        size_t nInPage = static_cast<size_t>(ui64Offset % CACHE_PAGE_SIZE);
+        size_t nChunk = CACHE_PAGE_SIZE - nInPage;
+        if (nChunk > nBytes) nChunk = nBytes;
+
+        const char* pPage = m_objCache.Lookup(ui64Page);
+        if (!pPage) {
+            uint64_t ui64PageStart = ui64Page * CACHE_PAGE_SIZE;
+            size_t nPageBytes = CACHE_PAGE_SIZE;
+            if (m_ui64DiskSize - ui64PageStart < nPageBytes) {
+                nPageBytes = static_cast<size_t>(m_ui64DiskSize - ui64PageStart);
+            }
+            char* pNew = m_objCache.Insert(ui64Page);
+            if (!ReadUncached(ui64PageStart, pNew, nPageBytes, strError)) {
+                m_objCache.Erase(ui64Page);
+                return false;
+            }
+            pPage = pNew;
+        }
+        memcpy(pDest, pPage + nInPage, nChunk);
+        pDest += nChunk;
+        ui64Offset += nChunk;
+        nBytes -= nChunk;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：写入一个块内的数据（内部辅助）
+*********************************************************************************/
+bool VhdxFile::WriteBlock(uint64_t ui64Block, uint32_t ui32InBlock, const char* pData, size_t nBytes, std::string& strError) {
+    size_t nIndex = static_cast<size_t>(BatIndex(ui64Block));
+    uint64_t ui64Entry = m_vecBat[nIndex];
+    if ((ui64Entry & BAT_STATE_MASK) == PAYLOAD_BLOCK_FULLY_PRESENT) {
+        return m_objFile.WriteAt((ui64Entry >> 20) * ONE_MB + ui32InBlock, pData, nBytes, strError);
+    }
+
+    // 1. 差异磁盘：块中其余的数据来自父磁盘或本层已写入的扇区，先经过整条链读出整个块，
+    //    合并后整块写入，块变为完全存在（不需要维护本层的扇区位图）
+    std::vector<char> vecMerged;
+    if (!m_vecBlockMap.empty()) {
+        uint64_t ui64BlockStart = ui64Block * m_ui32BlockSize;
+        uint64_t ui64BlockBytes = m_ui64DiskSize - ui64BlockStart < m_ui32BlockSize ? m_ui64DiskSize - ui64BlockStart : m_ui32BlockSize;
+        vecMerged.assign(m_ui32BlockSize, 0);
+        if (!ReadUncached(ui64BlockStart, vecMerged.data(), static_cast<size_t>(ui64BlockBytes), strError)) {
+            return false;
+        }
+        memcpy(vecMerged.data() + ui32InBlock, pData, nBytes);
+        pData = vecMerged.data();
+        ui32InBlock = 0;
+        nBytes = vecMerged.size();
+    }
+
+    // 2. 部分存在的块原地写入（写入的内容与原来读出的一致，BAT更新前断电不影响读取）；
+    //    其他情况在文件末尾（1MB对齐）分配新块，扩展出的部分读出为0
+    uint64_t ui64FileOffset = 0;
+    if ((ui64Entry & BAT_STATE_MASK) == PAYLOAD_BLOCK_PARTIALLY_PRESENT) {
+        ui64FileOffset = (ui64Entry >> 20) * ONE_MB;
+    } else {
+        ui64FileOffset = (m_objFile.Size() + ONE_MB - 1) / ONE_MB * ONE_MB;
+        if (!m_objFile.Resize(ui64FileOffset + m_ui32BlockSize, strError)) {
+            return false;
+        }
+    }
+    if (!m_objFile.WriteAt(ui64FileOffset + ui32InBlock, pData, nBytes, strError)) {
+        return false;
+    }
+
+    // 3. 数据落盘后再让BAT指向新块
+    if (!m_objFile.Flush(strError)) {
+        return false;
+    }
+    uint64_t ui64NewEntry = ui64FileOffset | PAYLOAD_BLOCK_FULLY_PRESENT;
+    if (!m_objFile.WriteAt(m_ui64BatOffset + nIndex * sizeof(uint64_t), &ui64NewEntry, sizeof(ui64NewEntry), strError)) {
+        return false;
+    }
+    m_vecBat[nIndex] = ui64NewEntry;
+
+    // 4. 合并块映射中该块的单元改为本层
+    if (!m_vecBlockMap.empty()) {
+        uint64_t ui64FirstUnit = ui64Block * m_ui32BlockSize / m_ui32MapUnit;
+        for (uint64_t i = 0; i < m_ui32BlockSize / m_ui32MapUnit && ui64FirstUnit + i < m_vecBlockMap.size(); i++) {
+            BlockMapping& stcMapping = m_vecBlockMap[static_cast<size_t>(ui64FirstUnit + i)];
+            stcMapping.ui64FileOffset = ui64FileOffset + i * m_ui32MapUnit;
+            stcMapping.ui32Layer = 0;
+            stcMapping.eState = MapState::Present;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：写入
+*********************************************************************************/
+bool VhdxFile::Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) {
+    std::lock_guard<std::mutex> lock(m_mtxDisk);
+    if (!m_objFile.IsOpen()) {
+        strError = "VHDX文件未打开";
+        return false;
+    }
+    if (m_objFile.IsReadOnly()) {
+        strError = "VHDX文件以只读方式打开";
+        return false;
+    }
+    if (ui64Offset > m_ui64DiskSize || nBytes > m_ui64DiskSize - ui64Offset) {
+        strError = "写入超出虚拟磁盘范围（偏移 " + std::to_string(ui64Offset) + "）";
+        return false;
+    }
+    if (!BeginWrite(true, strError)) {
+        return false;
+    }
+
+    const char* pSource = static_cast<const char*>(pBuffer);
+    while (nBytes > 0) {
+        uint64_t ui64Block = ui64Offset / m_ui32BlockSize;
+        uint32_t ui32InBlock = static_cast<uint32_t>(ui64Offset % m_ui32BlockSize);
+        size_t nChunk = m_ui32BlockSize - ui32InBlock;
+        if (nChunk > nBytes) nChunk = nBytes;
+
+        if (!WriteBlock(ui64Block, ui32InBlock, pSource, nChunk, strError)) {
+            return false;
+        }
+        m_objCache.Update(ui64Offset, pSource, nChunk);
+        pSource += nChunk;
+        ui64Offset += nChunk;
+        nBytes -= nChunk;
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数实现：刷新
+*********************************************************************************/
+bool VhdxFile::Flush(std::string& strError) {
+    std::lock_guard<std::mutex> lock(m_mtxDisk);
+    if (!m_objFile.IsOpen()) {
+        return true;
+    }
+    return m_objFile.Flush(strError);
+}
@@ -0,0 +1,194 @@
+﻿/********************************************************************************
+* 文件名称：VhdxFile.h
+* 文件功能：不挂载直接读写VHDX虚拟磁盘文件
+*
+* 类说明：
+*    配置虚拟机时通过Mount-VHD/AttachVirtualDisk挂载系统盘，再等待盘符
+*    出现，每次都要固定等待数秒，并且需要管理员挂载权限。VhdxFile按VHDX
+*    格式规范直接解析文件，把虚拟磁盘当作普通的块设备读写：
+*    - 文件标识、两份头部（取序号较大的有效头部）、区域表
+*    - 元数据：块大小、虚拟磁盘大小、逻辑/物理扇区大小、磁盘ID
+*    - 块分配表（BAT）：整表读入内存，按块定位数据
+*    - 日志回放：头部的LogGuid非零时找出最新的有效日志序列并回放；
+*      读写方式打开时写回文件并清除LogGuid，只读方式打开时保存在内存中
+*      只影响读取
+*    - 扇区级读写：固定磁盘和动态磁盘；写入未分配的块时在文件末尾分配
+*      新块（按1MB对齐），数据刷到磁盘后再更新BAT项
+*    - LRU块缓存：最近读过的64KB页保存在内存中，写入时同步更新
+*    - 差异磁盘（AVHDX）：按父磁盘定位器逐级只读打开父磁盘，校验每一级的
+*      parent_linkage与父磁盘的DataWriteGuid一致；打开时为整条链生成合并块
+*      映射，每个块直接对应到拥有数据的那一层，读取不需要逐层查找BAT；部分
+*      存在的块按扇区位图逐扇区落到下层，各层的扇区位图共用一个LRU缓存
+*
+* 写入顺序：
+*    第一次写入前更新头部的FileWriteGuid和DataWriteGuid（两份头部先后
+*    更新）；新块的数据先刷到磁盘，BAT项后写入。中途断电最多留下一个未被
+*    引用的块，不会出现BAT指向未写入数据的情况，因此不使用日志记录BAT更新。
+*    差异磁盘只写入最上层文件，父磁盘始终只读：第一次写入某个块时先经过整条链
+*    读出块的当前内容，合并写入的数据后整块写入本层，再把BAT项改为完全存在；
+*    中途断电时BAT仍指向原来的状态，读出的内容不变。
+*
+* 依赖项：
+*    - BlockDevice（块设备接口、文件读写、LRU缓存）
+*    - ContentHash（CRC-32C）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "BlockDevice.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+/********************************************************************************
+* 类名称：VHDX虚拟磁盘
+* 类功能：解析VHDX文件并按虚拟磁盘偏移读写
+*
+* 调用示例：
+*    VhdxFile objDisk;
+*    std::string strError;
+*    if (objDisk.Open("D:\\VMs\\Win11.vhdx", true, strError)) {
+*        std::vector<char> vecSector(objDisk.SectorSize());
+*        objDisk.Read(0, vecSector.data(), vecSector.size(), strError);
+*    }
+*********************************************************************************/
+class VhdxFile : public BlockDevice {
+public:
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  size_t nCacheBytes：LRU块缓存容量（字节，0表示不缓存）
+    *********************************************************************************/
+    explicit VhdxFile(size_t nCacheBytes = DEFAULT_CACHE_BYTES);
+    ~VhdxFile() override;
+
+    /********************************************************************************
+    * 函数名称：打开VHDX文件
+    * 函数参数：
+    *    [IN]  const std::string& strPath：文件路径（UTF-8）
+    *    [IN]  bool bReadOnly：是否只读
+    *    [OUT] std::string& strError：错误信息
+    * 返回类型：bool
+    * 注意事项：
+    *    - 虚拟机必须处于关闭状态（Hyper-V运行时独占打开磁盘文件）
+    *    - 日志非空时会回放；读写方式打开时回放结果写回文件
+    *    - 差异磁盘的父磁盘总是只读打开，父磁盘在创建差异磁盘之后被修改过
+    *      （DataWriteGuid与parent_linkage不一致）时返回错误
+    *********************************************************************************/
+    bool Open(const std::string& strPath, bool bReadOnly, std::string& strError);
+
+    /********************************************************************************
+    * 函数名称：关闭
+    * 函数功能：刷新并关闭文件（析构时自动调用）
+    *********************************************************************************/
+    void Close();
+
+    uint64_t Size() const override { return m_ui64DiskSize; }
+    uint32_t SectorSize() const override { return m_ui32LogicalSectorSize; }
+    bool IsReadOnly() const override { return m_objFile.IsReadOnly(); }
+    bool Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) override;
+    bool Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) override;
+    bool Flush(std::string& strError) override;
+
+    uint32_t PhysicalSectorSize() const { return m_ui32PhysicalSectorSize; }
+    uint32_t BlockSize() const { return m_ui32BlockSize; }
+    const DiskGuid& VirtualDiskId() const { return m_objDiskId; }
+    bool LogReplayed() const { return m_bLogReplayed; }
+    bool HasParent() const { return m_bHasParent; }
+    // 差异磁盘链上父磁盘的数量（直接父磁盘在前）
+    size_t ParentCount() const { return m_vecParents.size(); }
+    const std::string& ParentPath(size_t nIndex) const { return m_vecParents[nIndex]->m_strPath; }
+
+    // 默认缓存容量（字节）与页大小
+    static const size_t DEFAULT_CACHE_BYTES = 16 * 1024 * 1024;
+    static const size_t CACHE_PAGE_SIZE = 64 * 1024;
+    // 扇区位图缓存的容量（位图块数，每块1MB）
+    static const size_t BITMAP_CACHE_BLOCKS = 8;
+    // 差异磁盘链的最大深度（Hyper-V每台虚拟机最多50个检查点）
+    static const size_t MAX_CHAIN_DEPTH = 64;
+
+private:
+    // 头部（两份中当前有效的一份）
+    struct Header {
+        uint64_t ui64Sequence = 0;
+        DiskGuid objFileWrite;
+        DiskGuid objDataWrite;
+        DiskGuid objLog;
+        uint16_t ui16LogVersion = 0;
+        uint16_t ui16Version = 0;
+        uint32_t ui32LogLength = 0;
+        uint64_t ui64LogOffset = 0;
+    };
+
+    // 合并块映射单元的状态
+    enum class MapState : uint32_t {
+        Zero,       // 整个单元读出为0
+        Present,    // 整个单元在所在层
+        Partial     // 所在层部分存在，其余扇区由下层提供
+    };
+
+    // 合并块映射项：链上拥有该映射单元数据的层（0为本文件，i为第i个父磁盘）
+    struct BlockMapping {
+        uint64_t ui64FileOffset = 0;            // 在所在层文件中的偏移（Zero时无意义）
+        uint32_t ui32Layer = 0;                 // 所在层
+        MapState eState = MapState::Zero;
+    };
+
+    RawFile               m_objFile;                    // VHDX文件
+    std::string           m_strPath;                    // 文件路径
+    std::mutex            m_mtxDisk;                    // 保护以下全部状态
+    Header                m_stcHeader;                  // 当前头部
+    int                   m_nCurrentHeader = 0;         // 当前头部所在位置（0/1）
+    uint64_t              m_ui64BatOffset = 0;          // BAT区域在文件中的偏移
+    uint32_t              m_ui32BatLength = 0;          // BAT区域长度
+    uint64_t              m_ui64MetadataOffset = 0;     // 元数据区域偏移
+    uint32_t              m_ui32MetadataLength = 0;     // 元数据区域长度
+    uint32_t              m_ui32BlockSize = 0;          // 块大小
+    uint32_t              m_ui32LogicalSectorSize = 512;
+    uint32_t              m_ui32PhysicalSectorSize = 4096;
+    uint64_t              m_ui64DiskSize = 0;           // 虚拟磁盘大小
+    uint64_t              m_ui64ChunkRatio = 0;         // 每个扇区位图块对应的数据块数
+    bool                  m_bHasParent = false;         // 是否差异磁盘
+    DiskGuid              m_objDiskId;                  // 虚拟磁盘ID
+    std::map<std::string, std::string> m_mapParentLocator;  // 父磁盘定位器（键 → 值，UTF-8）
+    std::vector<std::unique_ptr<VhdxFile>> m_vecParents;    // 父磁盘链（只读，直接父磁盘在前）
+    std::vector<BlockMapping> m_vecBlockMap;            // 合并块映射（仅差异磁盘）
+    uint32_t              m_ui32MapUnit = 0;            // 映射单元大小（链上最小的块大小）
+    LruBlockCache         m_objBitmapCache;             // 各层扇区位图的缓存（键为层号和chunk号）
+    std::vector<uint64_t> m_vecBat;                     // 块分配表
+    std::map<uint64_t, std::vector<uint8_t>> m_mapLogOverlay;   // 只读打开时回放的日志（4KB对齐偏移 → 扇区）
+    uint64_t              m_ui64LogicalFileSize = 0;    // 考虑日志后文件应有的大小
+    bool                  m_bLogReplayed = false;       // 打开时回放过日志
+    bool                  m_bFileWriteGuidUpdated = false;
+    bool                  m_bDataWriteGuidUpdated = false;
+    LruBlockCache         m_objCache;                   // 已读取数据的缓存
+
+    bool OpenLayer(const std::string& strPath, bool bReadOnly, std::string& strError);
+    bool OpenParents(std::string& strError);
+    void BuildBlockMap();
+    bool ReadFileAt(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError);
+    bool LoadHeaders(std::string& strError);
+    bool ReplayLog(std::string& strError);
+    bool LoadRegionTable(std::string& strError);
+    bool LoadMetadata(std::string& strError);
+    bool LoadBat(std::string& strError);
+    bool WriteHeaders(std::string& strError);
+    bool BeginWrite(bool bDataWrite, std::string& strError);
+    uint64_t BatIndex(uint64_t ui64Block) const { return ui64Block + ui64Block / m_ui64ChunkRatio; }
+    uint64_t BitmapIndex(uint64_t ui64Chunk) const { return ui64Chunk * (m_ui64ChunkRatio + 1) + m_ui64ChunkRatio; }
+    VhdxFile& Layer(size_t nLayer) { return nLayer == 0 ? *this : *m_vecParents[nLayer - 1]; }
+    bool ReadUncached(uint64_t ui64Offset, char* pBuffer, size_t nBytes, std::string& strError);
+    bool ReadLayer(size_t nLayer, uint64_t ui64Offset, char* pBuffer, size_t nBytes, std::string& strError);
+    bool ReadPartial(size_t nLayer, uint64_t ui64FileOffset, uint64_t ui64Offset, char* pBuffer, size_t nBytes,
+                     std::string& strError);
+    bool WriteBlock(uint64_t ui64Block, uint32_t ui32InBlock, const char* pData, size_t nBytes, std::string& strError);
+
+    VhdxFile(const VhdxFile&) = delete;
+    VhdxFile& operator=(const VhdxFile&) = delete;
+};
@@ -1,9 +1,241 @@
 ﻿#include "WmiHelper.h"
+#include "QueryCache.h"
+#include "TranscriptBackend.h"
+#include "ExecutorTrace.h"
+#include "Utils.h"
 #include <stdexcept>
+#include <atomic>
+#include <sstream>
+
+using Snapshot = std::vector<IWbemClassObject*>;
+
+// 创建对象快照（快照释放时统一Release）
+static std::shared_ptr<Snapshot> MakeSnapshot() {
+    return std::shared_ptr<Snapshot>(new Snapshot(), [](Snapshot* p) {
+        for (IWbemClassObject* pObj : *p) {
+            pObj->Release();
+        }
+        delete p;
+    });
+}
+
+// 回放用的内存WMI对象：只支持属性的Get/Put/GetNames，其余方法返回WBEM_E_NOT_SUPPORTED
+class ReplayWmiObject : public IWbemClassObject {
+public:
+    // IUnknown
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppv) override {
+        if (!ppv) return E_POINTER;
+        if (riid == IID_IUnknown || riid == IID_IWbemClassObject) {
+            *ppv = static_cast<IWbemClassObject*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+    ULONG STDMETHODCALLTYPE Release() override {
+        ULONG count = --m_refCount;
+        if (count == 0) delete this;
+        return count;
+    }
+    
+    // 属性读写
+    HRESULT STDMETHODCALLTYPE Get(LPCWSTR wszName, long, VARIANT* pVal, CIMTYPE* pType, long* plFlavor) override {
+        if (!wszName) return WBEM_E_INVALID_PARAMETER;
+        auto it = m_properties.find(wszName);
+        if (it == m_properties.end()) return WBEM_E_NOT_FOUND;
+        if (pVal) {
+            VariantInit(pVal);
+            HRESULT hr = VariantCopy(pVal, &it->second);
+            if (FAILED(hr)) return hr;
+        }
+        if (pType) *pType = CIM_EMPTY;
+        if (plFlavor) *plFlavor = 0;
+        return WBEM_S_NO_ERROR;
+    }
+    HRESULT STDMETHODCALLTYPE Put(LPCWSTR wszName, long, VARIANT* pVal, CIMTYPE) override {
+        if (!wszName) return WBEM_E_INVALID_PARAMETER;
+        m_properties[wszName] = pVal ? _variant_t(*pVal) : _variant_t();
+        return WBEM_S_NO_ERROR;
+    }
+    HRESULT STDMETHODCALLTYPE GetNames(LPCWSTR, long, VARIANT*, SAFEARRAY** pNames) override {
+        if (!pNames) return WBEM_E_INVALID_PARAMETER;
+        SAFEARRAY* psa = SafeArrayCreateVector(VT_BSTR, 0, static_cast<ULONG>(m_properties.size()));
+        if (!psa) return WBEM_E_OUT_OF_MEMORY;
+        LONG i = 0;
+        for (const auto& property : m_properties) {
+            BSTR bstr = SysAllocString(property.first.c_str());
+            SafeArrayPutElement(psa, &i, bstr);
+            SysFreeString(bstr);
+            i++;
+        }
+        *pNames = psa;
+        return WBEM_S_NO_ERROR;
+    }
+    
+    // 不支持的方法
+    HRESULT STDMETHODCALLTYPE GetQualifierSet(IWbemQualifierSet**) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE Delete(LPCWSTR) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE BeginEnumeration(long) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE Next(long, BSTR*, VARIANT*, CIMTYPE*, long*) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE EndEnumeration() override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE GetPropertyQualifierSet(LPCWSTR, IWbemQualifierSet**) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE Clone(IWbemClassObject**) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE GetObjectText(long, BSTR*) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE SpawnDerivedClass(long, IWbemClassObject**) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE SpawnInstance(long, IWbemClassObject**) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE CompareTo(long, IWbemClassObject*) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE GetPropertyOrigin(LPCWSTR, BSTR*) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE InheritsFrom(LPCWSTR) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE GetMethod(LPCWSTR, long, IWbemClassObject**, IWbemClassObject**) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE PutMethod(LPCWSTR, long, IWbemClassObject*, IWbemClassObject*) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE DeleteMethod(LPCWSTR) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE BeginMethodEnumeration(long) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE NextMethod(long, BSTR*, IWbemClassObject**, IWbemClassObject**) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE EndMethodEnumeration() override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE GetMethodQualifierSet(LPCWSTR, IWbemQualifierSet**) override { return WBEM_E_NOT_SUPPORTED; }
+    HRESULT STDMETHODCALLTYPE GetMethodOrigin(LPCWSTR, BSTR*) override { return WBEM_E_NOT_SUPPORTED; }
+    
+private:
+    // WMI属性名不区分大小写
+    struct NameLess {
+        bool operator()(const std::wstring& a, const std::wstring& b) const { return _wcsicmp(a.c_str(), b.c_str()) < 0; }
+    };
+    
+    std::atomic<ULONG> m_refCount{ 1 };
+    std::map<std::wstring, _variant_t, NameLess> m_properties;
+};
+
+// 序列化对象属性（用于录制和方法调用的回放键）
+// 每个属性一行："<名称> <VARTYPE> <值>"，字符串为Base64，字符串数组为逗号分隔的Base64；
+// 空值和无法表示的属性（嵌入对象等）跳过，其余标量转换为字符串
+static std::string SerializeObject(IWbemClassObject* pObject) {
+    std::string text;
+    if (!pObject) return text;
+    
+    std::vector<std::wstring> names;
+    SAFEARRAY* psaNames = nullptr;
+    if (SUCCEEDED(pObject->GetNames(NULL, WBEM_FLAG_NONSYSTEM_ONLY, NULL, &psaNames)) && psaNames) {
+        LONG lower = 0, upper = -1;
+        SafeArrayGetLBound(psaNames, 1, &lower);
+        SafeArrayGetUBound(psaNames, 1, &upper);
+        for (LONG i = lower; i <= upper; i++) {
+            BSTR bstr = nullptr;
+            if (SUCCEEDED(SafeArrayGetElement(psaNames, &i, &bstr)) && bstr) {
+                names.push_back(bstr);
+                SysFreeString(bstr);
+            }
+        }
+        SafeArrayDestroy(psaNames);
+    }
+    names.push_back(L"__PATH");
+    
+    for (const auto& name : names) {
+        _variant_t value;
+        if (FAILED(pObject->Get(name.c_str(), 0, &value, NULL, NULL))) continue;
+        
+        std::string line = Utils::WStringToString(name) + " ";
+        if (value.vt == (VT_ARRAY | VT_BSTR)) {
+            line += std::to_string(VT_ARRAY | VT_BSTR) + " ";
+            LONG lower = 0, upper = -1;
+            SafeArrayGetLBound(value.parray, 1, &lower);
+            SafeArrayGetUBound(value.parray, 1, &upper);
+            for (LONG i = lower; i <= upper; i++) {
+                BSTR bstr = nullptr;
+                SafeArrayGetElement(value.parray, &i, &bstr);
+                if (i > lower) line += ",";
+                line += Utils::Base64Encode(Utils::WStringToString(bstr ? bstr : L""));
+                SysFreeString(bstr);
+            }
+        } else if (value.vt == VT_BOOL) {
+            line += std::to_string(VT_BOOL) + " " + (value.boolVal == VARIANT_TRUE ? "1" : "0");
+        } else if (value.vt == VT_I1 || value.vt == VT_UI1 || value.vt == VT_I2 || value.vt == VT_UI2 ||
+                   value.vt == VT_I4 || value.vt == VT_UI4 || value.vt == VT_I8 || value.vt == VT_UI8) {
+            // 整数统一按VT_I8录制：SetParam写入的类型与WMI返回的类型可能不同，回放键必须一致
+            _variant_t number;
+            if (FAILED(VariantChangeType(&number, &value, 0, VT_I8))) continue;
+            line += std::to_string(VT_I8) + " " + std::to_string(number.llVal);
+        } else if (value.vt != VT_EMPTY && value.vt != VT_NULL && value.vt != VT_UNKNOWN && value.vt != VT_DISPATCH &&
+                   !(value.vt & VT_ARRAY)) {
+            _variant_t string;
+            if (FAILED(VariantChangeType(&string, &value, 0, VT_BSTR))) continue;
+            line += std::to_string(VT_BSTR) + " " + Utils::Base64Encode(Utils::WStringToString(string.bstrVal));
+        } else {
+            continue;
+        }
+        text += line + "\n";
+    }
+    return text;
+}
+
+// 反序列化为回放对象（与SerializeObject对应）
+static IWbemClassObject* DeserializeObject(const std::string& text) {
+    ReplayWmiObject* pObject = new ReplayWmiObject();
+    std::istringstream stream(text);
+    std::string name, value;
+    int vt = 0;
+    while (stream >> name >> vt) {
+        std::getline(stream, value);
+        value = Utils::Trim(value);
+        
+        _variant_t variant;
+        if (vt == (VT_ARRAY | VT_BSTR)) {
+            std::vector<std::wstring> items;
+            for (const auto& item : Utils::Split(value, ',')) {
+                std::string decoded;
+                Utils::Base64Decode(item, decoded);
+                items.push_back(Utils::StringToWString(decoded));
+            }
+            SAFEARRAY* psa = SafeArrayCreateVector(VT_BSTR, 0, static_cast<ULONG>(items.size()));
+            for (LONG i = 0; psa && i < (LONG)items.size(); i++) {
+                BSTR bstr = SysAllocString(items[i].c_str());
+                SafeArrayPutElement(psa, &i, bstr);
+                SysFreeString(bstr);
+            }
+            variant.vt = VT_ARRAY | VT_BSTR;
+            variant.parray = psa;
+        } else if (vt == VT_BSTR) {
+            std::string decoded;
+            Utils::Base64Decode(value, decoded);
+            variant = _bstr_t(Utils::StringToWString(decoded).c_str());
+        } else {
+            long long number = 0;
+            try {
+                number = std::stoll(value);
+            } catch (...) {
+                number = 0;
+            }
+            if (vt == VT_BOOL) {
+                variant = (number != 0);
+            } else {
+                variant = number;
+            }
+        }
+        pObject->Put(Utils::StringToWString(name).c_str(), 0, &variant, 0);
+    }
+    return pObject;
+}
+
+// 当前录制器（回放模式下不为空时IsReplaying()为true）
+static std::shared_ptr<CommandRecorder> ActiveRecorder() {
+    return Transcript::Active();
+}
+
+static bool IsReplaying() {
+    std::shared_ptr<CommandRecorder> pRecorder = ActiveRecorder();
+    return pRecorder && pRecorder->IsReplaying();
+}
 
 // Session 实现
 WmiHelper::Session::Session(const std::wstring& wmiNamespace) 
-    : m_pLoc(nullptr), m_pSvc(nullptr) {
+    : m_pLoc(nullptr), m_pSvc(nullptr), m_wstrNamespace(wmiNamespace), m_bReplay(false) {
+    
+    // 回放模式：结果来自记录文件，不连接WMI
+    if (IsReplaying()) {
+        m_bReplay = true;
+        return;
+    }
     
     HRESULT hr = CoCreateInstance(
         CLSID_WbemLocator,
@@ -58,7 +290,11 @@ WmiHelper::Session::~Session() {
 
 // QueryResult 实现
 WmiHelper::QueryResult::QueryResult(IEnumWbemClassObject* pEnumerator)
-    : m_pEnumerator(pEnumerator) {
+    : m_pEnumerator(pEnumerator), m_nIndex(0) {
+}
+
+WmiHelper::QueryResult::QueryResult(std::shared_ptr<const std::vector<IWbemClassObject*>> pSnapshot)
+    : m_pEnumerator(nullptr), m_pSnapshot(std::move(pSnapshot)), m_nIndex(0) {
 }
 
 WmiHelper::QueryResult::~QueryResult() {
@@ -68,6 +304,14 @@ WmiHelper::QueryResult::~QueryResult() {
 }
 
 bool WmiHelper::QueryResult::Next(IWbemClassObject** ppObject) {
+    // 快照：返回对象的新引用，调用者照常Release
+    if (m_pSnapshot) {
+        if (m_nIndex >= m_pSnapshot->size()) return false;
+        *ppObject = (*m_pSnapshot)[m_nIndex++];
+        (*ppObject)->AddRef();
+        return true;
+    }
+    
     if (!m_pEnumerator) return false;
     
     ULONG uReturn = 0;
@@ -85,6 +329,25 @@ std::unique_ptr<WmiHelper::QueryResult> WmiHelper::Query(
         throw std::runtime_error("Invalid WMI session");
     }
     
+    std::shared_ptr<CommandRecorder> pRecorder = ActiveRecorder();
+    std::string key = Utils::WStringToString(session.GetNamespace() + L":" + query);
+    
+    // 回放：按录制的属性重建对象
+    if (session.IsReplay()) {
+        CommandResult replayed;
+        if (!pRecorder || !pRecorder->Replay("wmi", key, replayed) || replayed.nExitCode != 0) {
+            throw std::runtime_error("WMI query failed");
+        }
+        std::shared_ptr<Snapshot> pSnapshot = MakeSnapshot();
+        for (const auto& objectText : Utils::Split(replayed.strOutput, '\x1e')) {
+            if (!objectText.empty()) {
+                pSnapshot->push_back(DeserializeObject(objectText));
+            }
+        }
+        return std::make_unique<QueryResult>(std::shared_ptr<const Snapshot>(pSnapshot));
+    }
+    
+    uint64_t startUs = ExecutorTrace::NowUs();
     IEnumWbemClassObject* pEnumerator = nullptr;
     HRESULT hr = session.GetServices()->ExecQuery(
         bstr_t("WQL"),
@@ -95,10 +358,65 @@ std::unique_ptr<WmiHelper::QueryResult> WmiHelper::Query(
     );
     
     if (FAILED(hr)) {
+        if (pRecorder) {
+            CommandResult failed;
+            failed.nExitCode = static_cast<int>(hr);
+            pRecorder->Record("wmi", key, failed, ExecutorTrace::NowUs() - startUs);
+        }
         throw std::runtime_error("WMI query failed");
     }
     
-    return std::make_unique<QueryResult>(pEnumerator);
+    if (!pRecorder) {
+        return std::make_unique<QueryResult>(pEnumerator);
+    }
+    
+    // 录制：取回全部对象，属性序列化后录制（对象之间以0x1E分隔）
+    std::shared_ptr<Snapshot> pSnapshot = MakeSnapshot();
+    QueryResult enumerated(pEnumerator);
+    IWbemClassObject* pObj = nullptr;
+    CommandResult recorded;
+    recorded.nExitCode = 0;
+    while (enumerated.Next(&pObj)) {
+        pSnapshot->push_back(pObj);
+        recorded.strOutput += SerializeObject(pObj) + "\x1e";
+    }
+    pRecorder->Record("wmi", key, recorded, ExecutorTrace::NowUs() - startUs);
+    return std::make_unique<QueryResult>(std::shared_ptr<const Snapshot>(pSnapshot));
+}
+
+// 执行WQL查询（带缓存）
+std::unique_ptr<WmiHelper::QueryResult> WmiHelper::QueryCached(
+    Session& session,
+    const std::wstring& query,
+    const std::string& scope,
+    DWORD ttlMs) {
+    
+    // 缓存键：命名空间 + 查询语句（UTF-8）
+    std::wstring keySource = session.GetNamespace() + L":" + query;
+    int len = WideCharToMultiByte(CP_UTF8, 0, keySource.c_str(), -1, NULL, 0, NULL, NULL);
+    std::string key(len > 0 ? len - 1 : 0, '\0');
+    if (len > 1) {
+        WideCharToMultiByte(CP_UTF8, 0, keySource.c_str(), -1, &key[0], len, NULL, NULL);
+    }
+    key = "wmi:" + QueryCache::NormalizeKey(key);
+    
+    uint64_t generation = QueryCache::Instance().Generation(scope);
+    std::shared_ptr<const Snapshot> pCached;
+    if (QueryCache::Instance().Lookup(key, pCached)) {
+        return std::make_unique<QueryResult>(pCached);
+    }
+    
+    // 未命中：取回全部对象作为快照（快照释放时统一Release）
+    std::shared_ptr<Snapshot> pSnapshot = MakeSnapshot();
+    auto pResult = Query(session, query);
+    IWbemClassObject* pObj = nullptr;
+    while (pResult->Next(&pObj)) {
+        pSnapshot->push_back(pObj);
+    }
+    
+    std::shared_ptr<const Snapshot> pConstSnapshot = pSnapshot;
+    QueryCache::Instance().Store(key, scope, pConstSnapshot, ttlMs, generation);
+    return std::make_unique<QueryResult>(pConstSnapshot);
 }
 
 // 获取属性值（字符串）
@@ -187,7 +505,28 @@ HRESULT WmiHelper::ExecuteMethod(
         return E_FAIL;
     }
     
-    return session.GetServices()->ExecMethod(
+    // 回放键：命名空间、对象路径、方法名和输入参数
+    std::shared_ptr<CommandRecorder> pRecorder = ActiveRecorder();
+    std::string key;
+    if (pRecorder) {
+        key = Utils::WStringToString(session.GetNamespace() + L"|" + objectPath + L"|" + methodName) + "|" +
+              SerializeObject(pInParams);
+    }
+    
+    // 回放：返回录制的HRESULT和输出参数
+    if (session.IsReplay()) {
+        CommandResult replayed;
+        if (!pRecorder || !pRecorder->Replay("wmimethod", key, replayed)) {
+            return WBEM_E_FAILED;
+        }
+        if (ppOutParams) {
+            *ppOutParams = SUCCEEDED(replayed.nExitCode) ? DeserializeObject(replayed.strOutput) : nullptr;
+        }
+        return static_cast<HRESULT>(replayed.nExitCode);
+    }
+    
+    uint64_t startUs = ExecutorTrace::NowUs();
+    HRESULT hr = session.GetServices()->ExecMethod(
         _bstr_t(objectPath.c_str()),
         _bstr_t(methodName.c_str()),
         0,
@@ -196,6 +535,16 @@ HRESULT WmiHelper::ExecuteMethod(
         ppOutParams,
         NULL
     );
+    
+    if (pRecorder) {
+        CommandResult recorded;
+        recorded.nExitCode = static_cast<int>(hr);
+        if (SUCCEEDED(hr) && ppOutParams && *ppOutParams) {
+            recorded.strOutput = SerializeObject(*ppOutParams);
+        }
+        pRecorder->Record("wmimethod", key, recorded, ExecutorTrace::NowUs() - startUs);
+    }
+    return hr;
 }
 
 // 创建方法参数对象
@@ -206,6 +555,11 @@ IWbemClassObject* WmiHelper::CreateMethodParams(
     
     if (!session.IsValid()) return nullptr;
     
+    // 回放：参数对象只用于Put和生成回放键
+    if (session.IsReplay()) {
+        return new ReplayWmiObject();
+    }
+    
     IWbemClassObject* pClass = nullptr;
     HRESULT hr = session.GetServices()->GetObject(
         _bstr_t(className.c_str()),
@@ -36,6 +36,12 @@
 *    - Session对象会自动管理COM对象释放
 *    - 建议在程序结束时调用UninitializeCOM()
 * 
+* 录制/回放（Transcript）：
+*    - 录制时查询照常执行，全部对象的属性和__PATH序列化后录制（方式wmi）；
+*      方法调用按对象路径、方法名和输入参数录制HRESULT和输出参数（方式wmimethod）
+*    - 回放时Session不连接WMI，查询结果、方法参数和输出参数都是只实现
+*      Get/Put/GetNames的内存对象
+* 
 * 作者：Smart-GPU-PV Team
 * 日期：2026-01-26
 * 版本：v2.0
@@ -115,11 +121,27 @@ public:
         * 返回类型：bool
         *    连接有效返回true，否则返回false
         *********************************************************************************/
-        bool IsValid() const { return m_pSvc != nullptr; }
+        bool IsValid() const { return m_pSvc != nullptr || m_bReplay; }
+        
+        /********************************************************************************
+        * 函数名称：获取命名空间
+        * 返回类型：const std::wstring&
+        *    构造时连接的WMI命名空间路径
+        *********************************************************************************/
+        const std::wstring& GetNamespace() const { return m_wstrNamespace; }
+        
+        /********************************************************************************
+        * 函数名称：是否为回放会话
+        * 返回类型：bool
+        *    回放模式下创建的会话不连接WMI，GetServices()返回nullptr
+        *********************************************************************************/
+        bool IsReplay() const { return m_bReplay; }
         
     private:
         IWbemLocator* m_pLoc;     // WMI定位器对象
         IWbemServices* m_pSvc;    // WMI服务对象
+        std::wstring m_wstrNamespace;  // 命名空间路径
+        bool m_bReplay;           // 回放会话（未连接WMI）
     };
     
     //==============================================================================
@@ -153,6 +175,15 @@ public:
         *********************************************************************************/
         QueryResult(IEnumWbemClassObject* pEnumerator);
         
+        /********************************************************************************
+        * 函数名称：构造函数（快照）
+        * 函数功能：从缓存的对象快照创建查询结果，遍历时不访问WMI
+        * 函数参数：
+        *    [IN]  std::shared_ptr<const std::vector<IWbemClassObject*>> pSnapshot：对象快照
+        * 返回类型：无（构造函数）
+        *********************************************************************************/
+        QueryResult(std::shared_ptr<const std::vector<IWbemClassObject*>> pSnapshot);
+        
         /********************************************************************************
         * 函数名称：析构函数
         * 函数功能：自动释放枚举器对象
@@ -179,6 +210,8 @@ public:
         
     private:
         IEnumWbemClassObject* m_pEnumerator;  // WMI枚举器对象
+        std::shared_ptr<const std::vector<IWbemClassObject*>> m_pSnapshot;  // 对象快照（缓存命中时）
+        size_t m_nIndex;                      // 快照遍历位置
     };
     
     //==============================================================================
@@ -202,6 +235,31 @@ public:
         const std::wstring& wstrQuery
     );
     
+    /********************************************************************************
+    * 函数名称：执行WQL查询（带缓存）
+    * 函数功能：与Query相同，但在有效期内重复执行同一查询时从QueryCache返回
+    *           上次结果的对象快照，不再访问WMI
+    * 函数参数：
+    *    [IN]  Session& objSession：WMI会话对象
+    *    [IN]  const std::wstring& wstrQuery：只读的WQL查询语句
+    *    [IN]  const std::string& strScope：缓存作用域（虚拟机名称或QueryCache::SCOPE_*）
+    *    [IN]  DWORD dwTtlMs：缓存有效期（毫秒）
+    * 返回类型：std::unique_ptr<QueryResult>
+    *    查询结果对象智能指针，遍历方式与Query相同
+    * 调用示例：
+    *    auto pResult = WmiHelper::QueryCached(objSession,
+    *        L"SELECT * FROM Msvm_PartitionableGpu", QueryCache::SCOPE_HOST, 60000);
+    * 注意事项：
+    *    - 未命中时会一次性取回全部结果对象，适合结果较少的查询
+    *    - 快照中的对象是查询时的副本，属性不会随虚拟机状态变化而更新
+    *********************************************************************************/
+    static std::unique_ptr<QueryResult> QueryCached(
+        Session& objSession,
+        const std::wstring& wstrQuery,
+        const std::string& strScope,
+        DWORD dwTtlMs
+    );
+    
     //==============================================================================
     // 静态方法：属性读取
     //==============================================================================
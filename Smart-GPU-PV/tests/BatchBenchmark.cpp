@@ -0,0 +1,150 @@
+﻿/********************************************************************************
+* 文件名称：BatchBenchmark.cpp
+* 文件功能：在同一个替身后端上比较Batch::Run批量执行与逐条执行的延迟
+*
+* 说明：
+*    替身后端为每次宿主往返和每次启动进程加上固定的模拟耗时，因此结果反映的是
+*    往返次数的差别，而不是PowerShell本身的开销：
+*    - 常驻宿主 + 逐条ExecuteWithCheck：N次往返
+*    - 常驻宿主 + Batch::Run：1次往返
+*    - 禁用宿主（独立进程降级路径）：两种方式都需要N次启动进程
+*    直接运行得到完整结果；CTest以--quick运行，只验证往返次数。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "FakeProcessBackend.h"
+#include "../Smart-GPU-PV/PowerShellExecutor.h"
+#include <chrono>
+#include <cstdio>
+
+static const uint32_t ROUND_TRIP_US = 2000;    // 模拟的宿主往返耗时
+static const uint32_t SPAWN_US = 20000;        // 模拟的进程启动耗时
+
+/********************************************************************************
+* 结构体名称：一种执行方式的测量结果
+*********************************************************************************/
+struct BenchResult {
+    double dMsPerRound = 0;    // 每轮（N条命令）的平均耗时
+    size_t nRequests = 0;      // 宿主往返次数（所有轮次之和）
+    size_t nRuns = 0;          // 独立进程次数（所有轮次之和）
+    bool   bAllOk = true;      // 所有命令是否成功且输出正确
+};
+
+static size_t CommandCount() { return TestHarness::QuickMode() ? 8 : 32; }
+static size_t RoundCount() { return TestHarness::QuickMode() ? 2 : 10; }
+
+static std::vector<std::string> MakeCommands(size_t nCount) {
+    std::vector<std::string> vecCommands;
+    for (size_t i = 0; i < nCount; i++) {
+        vecCommands.push_back("Get-VM -Name 'bench-" + std::to_string(i) + "'");
+    }
+    return vecCommands;
+}
+
+/********************************************************************************
+* 函数名称：创建并安装替身后端
+* 函数参数：
+*    [IN]  bool bUseHost：是否使用常驻宿主
+* 返回类型：std::shared_ptr<FakeProcessBackend>
+* 注意事项：
+*    - 使用宿主时先执行一条命令预热进程池，测量中不包含宿主的启动耗时
+*********************************************************************************/
+static std::shared_ptr<FakeProcessBackend> InstallBackend(bool bUseHost) {
+    auto pBackend = std::make_shared<FakeProcessBackend>();
+    pBackend->stcConfig.ui32RoundTripUs = ROUND_TRIP_US;
+    pBackend->stcConfig.ui32SpawnUs = SPAWN_US;
+    PowerShellExecutor::SetProcessBackend(pBackend);
+    PowerShellExecutor::EnablePersistentHost(bUseHost, 1);
+    if (bUseHost) {
+        std::string strOutput, strError;
+        PowerShellExecutor::ExecuteWithCheck("'warm-up'", strOutput, strError);
+    }
+    pBackend->stcStats.nRequests = 0;
+    pBackend->stcStats.nRuns = 0;
+    return pBackend;
+}
+
+/********************************************************************************
+* 函数名称：测量一种执行方式
+* 函数参数：
+*    [IN]  bool bUseHost：是否使用常驻宿主
+*    [IN]  bool bBatched：true用Batch::Run，false逐条ExecuteWithCheck
+* 返回类型：BenchResult
+*********************************************************************************/
+static BenchResult Measure(bool bUseHost, bool bBatched) {
+    auto pBackend = InstallBackend(bUseHost);
+    std::vector<std::string> vecCommands = MakeCommands(CommandCount());
+    BenchResult stcBench;
+
+    auto tpStart = std::chrono::steady_clock::now();
+    for (size_t nRound = 0; nRound < RoundCount(); nRound++) {
+        std::vector<CommandResult> vecResults;
+        if (bBatched) {
+            PowerShellExecutor::Batch objBatch;
+            for (const auto& strCommand : vecCommands) {
+                objBatch.Add(strCommand);
+            }
+            stcBench.bAllOk = objBatch.Run(vecResults) && stcBench.bAllOk;
+        } else {
+            for (const auto& strCommand : vecCommands) {
+                CommandResult stcResult;
+                stcBench.bAllOk = PowerShellExecutor::ExecuteWithCheck(strCommand, stcResult.strOutput,
+                                                                       stcResult.strError) && stcBench.bAllOk;
+                vecResults.push_back(std::move(stcResult));
+            }
+        }
+        // 替身后端的输出为命令文本本身
+        for (size_t i = 0; i < vecCommands.size(); i++) {
+            stcBench.bAllOk = stcBench.bAllOk && i < vecResults.size() && vecResults[i].strOutput == vecCommands[i];
+        }
+    }
+    auto tpEnd = std::chrono::steady_clock::now();
+
+    stcBench.dMsPerRound = std::chrono::duration<double, std::milli>(tpEnd - tpStart).count() / RoundCount();
+    stcBench.nRequests = pBackend->stcStats.nRequests;
+    stcBench.nRuns = pBackend->stcStats.nRuns;
+    PowerShellExecutor::Shutdown();
+    return stcBench;
+}
+
+static void Report(const char* pszName, const BenchResult& stcBench) {
+    std::printf("  %-32s %9.2f ms/round  %4zu round trips  %4zu spawns\n", pszName, stcBench.dMsPerRound,
+                stcBench.nRequests / RoundCount(), stcBench.nRuns / RoundCount());
+}
+
+TEST_CASE(BatchRunOnHostUsesOneRoundTrip) {
+    BenchResult stcUnbatched = Measure(true, false);
+    BenchResult stcBatched = Measure(true, true);
+
+    std::printf("%zu commands, round trip %u us, spawn %u us\n", CommandCount(), ROUND_TRIP_US, SPAWN_US);
+    Report("host, ExecuteWithCheck x N", stcUnbatched);
+    Report("host, Batch::Run", stcBatched);
+    std::printf("  speedup: %.1fx\n", stcUnbatched.dMsPerRound / stcBatched.dMsPerRound);
+
+    CHECK(stcUnbatched.bAllOk);
+    CHECK(stcBatched.bAllOk);
+    CHECK_EQ(stcUnbatched.nRequests, CommandCount() * RoundCount());
+    CHECK_EQ(stcBatched.nRequests, RoundCount());
+    CHECK_EQ(stcBatched.nRuns, size_t(0));
+    // 逐条执行至少需要N次模拟往返，批量执行只需要一次
+    CHECK(stcBatched.dMsPerRound < stcUnbatched.dMsPerRound);
+}
+
+TEST_CASE(BatchRunWithoutHostFallsBackToOneProcessPerCommand) {
+    BenchResult stcUnbatched = Measure(false, false);
+    BenchResult stcBatched = Measure(false, true);
+
+    std::printf("%zu commands without host, spawn %u us\n", CommandCount(), SPAWN_US);
+    Report("one-shot, ExecuteWithCheck x N", stcUnbatched);
+    Report("one-shot, Batch::Run", stcBatched);
+
+    CHECK(stcUnbatched.bAllOk);
+    CHECK(stcBatched.bAllOk);
+    CHECK_EQ(stcUnbatched.nRuns, CommandCount() * RoundCount());
+    CHECK_EQ(stcBatched.nRuns, CommandCount() * RoundCount());
+    CHECK_EQ(stcBatched.nRequests, size_t(0));
+}
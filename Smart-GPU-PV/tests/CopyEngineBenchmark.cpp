@@ -0,0 +1,211 @@
+﻿/********************************************************************************
+* 文件名称：CopyEngineBenchmark.cpp
+* 文件功能：在生成的DriverStore目录树上测量CopyEngine的吞吐量
+*
+* 说明：
+*    源目录树模拟HostDriverStore\FileRepository：若干驱动包，每个包含大量
+*    小文件（inf、cat、配置）、中等大小的DLL和少数大文件，并有子目录。比较：
+*    - 单线程递归复制（std::filesystem::copy，相当于Copy-Item -Recurse）
+*    - CopyEngine单个工作线程
+*    - CopyEngine默认线程数（按CPU核数，2~8个）
+*    - 按清单增量同步：第二次执行时所有文件未变化
+*    源文件在生成后位于页缓存中，结果反映的是复制路径本身的开销。
+*    直接运行得到完整结果；CTest以--quick运行，只验证结果正确。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/CopyEngine.h"
+#include "../Smart-GPU-PV/ContentHash.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+/********************************************************************************
+* 结构体名称：目录树摘要
+*********************************************************************************/
+struct TreeSummary {
+    uint64_t                           ui64Files = 0;
+    uint64_t                           ui64Bytes = 0;
+    std::map<std::string, uint64_t>    mapHashes;      // 相对路径 -> 内容哈希
+    std::map<std::string, int64_t>     mapWriteTimes;  // 相对路径 -> 修改时间（秒）
+};
+
+/********************************************************************************
+* 函数名称：生成DriverStore目录树
+* 函数参数：
+*    [IN]  const std::filesystem::path& pathRoot：根目录
+* 返回类型：TreeSummary
+*********************************************************************************/
+static TreeSummary MakeDriverStore(const std::filesystem::path& pathRoot) {
+    const bool bQuick = TestHarness::QuickMode();
+    const size_t nPackages = bQuick ? 4 : 24;
+    TestHarness::Random objRandom(2026);
+    std::vector<char> vecData;
+    TreeSummary stcSummary;
+
+    auto fnWrite = [&](const std::filesystem::path& pathFile, uint64_t ui64Size) {
+        std::filesystem::create_directories(pathFile.parent_path());
+        vecData.resize(static_cast<size_t>(ui64Size));
+        objRandom.Fill(vecData.data(), vecData.size());
+        std::ofstream(pathFile, std::ios::binary).write(vecData.data(), static_cast<std::streamsize>(vecData.size()));
+        stcSummary.ui64Files++;
+        stcSummary.ui64Bytes += ui64Size;
+    };
+
+    for (size_t nPackage = 0; nPackage < nPackages; nPackage++) {
+        std::filesystem::path pathPackage = pathRoot / ("nv_dispi.inf_amd64_" + std::to_string(1000 + nPackage));
+        // 小文件：inf、cat、配置和数据文件（1~64KB）
+        for (size_t i = 0; i < 40; i++) {
+            fnWrite(pathPackage / ("nvdata" + std::to_string(i) + ".cfg"), 1024 + objRandom.Below(63 * 1024));
+        }
+        // 中等大小的DLL（256KB~4MB，快速模式下缩小到1/16）
+        for (size_t i = 0; i < 12; i++) {
+            uint64_t ui64Size = (256 * 1024) + objRandom.Below(3840 * 1024);
+            fnWrite(pathPackage / "x64" / ("nvlib" + std::to_string(i) + ".dll"), bQuick ? ui64Size / 16 : ui64Size);
+        }
+        // 大文件（24~40MB，快速模式下缩小到1/64）
+        uint64_t ui64Large = (24 + objRandom.Below(16)) * 1024 * 1024;
+        fnWrite(pathPackage / "nvcompiler64.dll", bQuick ? ui64Large / 64 : ui64Large);
+    }
+    return stcSummary;
+}
+
+/********************************************************************************
+* 函数名称：读取目录树摘要
+*********************************************************************************/
+static TreeSummary Summarize(const std::filesystem::path& pathRoot) {
+    TreeSummary stcSummary;
+    std::vector<char> vecData;
+    for (const auto& objEntry : std::filesystem::recursive_directory_iterator(pathRoot)) {
+        if (!objEntry.is_regular_file()) {
+            continue;
+        }
+        std::ifstream objFile(objEntry.path(), std::ios::binary);
+        vecData.assign(std::istreambuf_iterator<char>(objFile), std::istreambuf_iterator<char>());
+        std::string strRelative = std::filesystem::relative(objEntry.path(), pathRoot).generic_string();
+        stcSummary.ui64Files++;
+        stcSummary.ui64Bytes += vecData.size();
+        stcSummary.mapHashes[strRelative] = XXHash64::Hash(vecData.data(), vecData.size());
+        stcSummary.mapWriteTimes[strRelative] = std::chrono::duration_cast<std::chrono::seconds>(
+            objEntry.last_write_time().time_since_epoch()).count();
+    }
+    return stcSummary;
+}
+
+/********************************************************************************
+* 函数名称：测量一种复制方式
+* 函数参数：
+*    [IN]  const char* pszName：方式名称
+*    [IN]  uint64_t ui64Bytes：源目录树的字节数
+*    [IN]  TFunc fnCopy：执行一次复制
+* 返回类型：double
+*    吞吐量（MB/s）
+*********************************************************************************/
+template <typename TFunc>
+static double Measure(const char* pszName, uint64_t ui64Bytes, TFunc fnCopy) {
+    auto tpStart = std::chrono::steady_clock::now();
+    fnCopy();
+    double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tpStart).count();
+    double dMBps = (ui64Bytes / 1048576.0) / (dSeconds > 0 ? dSeconds : 1e-9);
+    std::printf("  %-34s %8.1f ms  %8.1f MB/s\n", pszName, dSeconds * 1000, dMBps);
+    return dMBps;
+}
+
+TEST_CASE(CopyDriverStoreTree) {
+    TestHarness::TempDir objDir;
+    std::filesystem::path pathSource = objDir.Path() / "FileRepository";
+    TreeSummary stcSource = MakeDriverStore(pathSource);
+    std::printf("synthetic DriverStore: %llu files, %.1f MB\n",
+                static_cast<unsigned long long>(stcSource.ui64Files), stcSource.ui64Bytes / 1048576.0);
+    // 读取摘要时重新计算源的哈希和修改时间
+    stcSource = Summarize(pathSource);
+
+    // 1. 单线程递归复制
+    std::filesystem::path pathBaseline = objDir.Path() / "baseline";
+    Measure("std::filesystem::copy (recursive)", stcSource.ui64Bytes, [&]() {
+        std::filesystem::copy(pathSource, pathBaseline, std::filesystem::copy_options::recursive);
+    });
+
+    // 2. CopyEngine：单个工作线程和默认线程数
+    for (unsigned int nWorkers : { 1u, 0u }) {
+        std::filesystem::path pathDest = objDir.Path() / ("engine" + std::to_string(nWorkers));
+        CopyEngine objEngine(nWorkers);
+        objEngine.Add(pathSource.string(), pathDest.string(), false);
+        CopyReport stcReport;
+        std::vector<std::string> vecMessages;
+        bool bOk = false;
+        Measure(nWorkers == 1 ? "CopyEngine, 1 worker" : "CopyEngine, default workers", stcSource.ui64Bytes, [&]() {
+            bOk = objEngine.Run([&](const std::string& strMessage) { vecMessages.push_back(strMessage); }, stcReport);
+        });
+
+        // 内容、修改时间与源一致，进度回调收到汇总
+        CHECK(bOk);
+        CHECK(stcReport.vecErrors.empty());
+        CHECK_EQ(stcReport.ui64Files, stcSource.ui64Files);
+        CHECK_EQ(stcReport.ui64Bytes, stcSource.ui64Bytes);
+        TreeSummary stcCopy = Summarize(pathDest);
+        CHECK(stcCopy.mapHashes == stcSource.mapHashes);
+        CHECK(stcCopy.mapWriteTimes == stcSource.mapWriteTimes);
+        REQUIRE(!vecMessages.empty());
+        CHECK(vecMessages.back().rfind("复制完成", 0) == 0);
+    }
+}
+
+TEST_CASE(ManifestResyncSkipsUnchangedFiles) {
+    TestHarness::TempDir objDir;
+    std::filesystem::path pathSource = objDir.Path() / "FileRepository";
+    TreeSummary stcSource = MakeDriverStore(pathSource);
+    std::filesystem::path pathVolume = objDir.Path() / "volume";
+    std::string strDest = (pathVolume / "Windows/System32/HostDriverStore/FileRepository").string();
+    std::string strError;
+
+    // 1. 首次同步：全部复制并记入清单
+    {
+        DriverManifest objManifest;
+        REQUIRE(objManifest.Load(pathVolume.string(), strError));
+        CopyEngine objEngine;
+        objEngine.SetManifest(&objManifest);
+        objEngine.Add(pathSource.string(), strDest, false);
+        CopyReport stcReport;
+        REQUIRE(objEngine.Run(nullptr, stcReport));
+        CHECK_EQ(stcReport.ui64Files, stcSource.ui64Files);
+        CHECK_EQ(objManifest.Size(), static_cast<size_t>(stcSource.ui64Files));
+        REQUIRE(objManifest.Save(strError));
+    }
+
+    // 2. 再次同步：大小和修改时间与清单一致，不复制
+    DriverManifest objManifest;
+    REQUIRE(objManifest.Load(pathVolume.string(), strError));
+    CHECK_EQ(objManifest.Size(), static_cast<size_t>(stcSource.ui64Files));
+    CopyEngine objEngine;
+    objEngine.SetManifest(&objManifest);
+    objEngine.Add(pathSource.string(), strDest, false);
+    CopyReport stcReport;
+    Measure("CopyEngine, manifest resync", stcSource.ui64Bytes, [&]() {
+        CHECK(objEngine.Run(nullptr, stcReport));
+    });
+    CHECK_EQ(stcReport.ui64Files, static_cast<uint64_t>(0));
+    CHECK_EQ(stcReport.ui64Unchanged, stcSource.ui64Files);
+    CHECK_EQ(stcReport.ui64BytesSaved, stcSource.ui64Bytes);
+}
+
+TEST_CASE(ErrorsAreCollectedPerFile) {
+    TestHarness::TempDir objDir;
+    std::filesystem::path pathSource = objDir.Path() / "FileRepository";
+    TreeSummary stcSource = MakeDriverStore(pathSource);
+
+    // 不存在的源文件记录一条错误，其他作业照常完成
+    CopyEngine objEngine;
+    objEngine.Add((objDir.Path() / "missing.dll").string(), (objDir.Path() / "out" / "missing.dll").string());
+    objEngine.Add(pathSource.string(), (objDir.Path() / "out" / "FileRepository").string());
+    CopyReport stcReport;
+    CHECK(!objEngine.Run(nullptr, stcReport));
+    REQUIRE(stcReport.vecErrors.size() == 1);
+    CHECK(stcReport.vecErrors[0].strPath.find("missing.dll") != std::string::npos);
+    CHECK_EQ(stcReport.ui64Files, stcSource.ui64Files);
+}
@@ -0,0 +1,235 @@
+﻿/********************************************************************************
+* 文件名称：DriverCacheTest.cpp
+* 文件功能：验证驱动缓存的对象去重、版本清单加载、引用记录和垃圾回收：
+*           仍被某个保留版本的清单引用的对象永远不会被回收
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/DriverCache.h"
+#include "../Smart-GPU-PV/ContentHash.h"
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+
+/********************************************************************************
+* 类名称：缓存测试环境
+* 类功能：在临时目录中生成源文件，并把它们描述为缓存条目
+*********************************************************************************/
+class CacheFixture {
+public:
+    CacheFixture() : m_objCache(m_objDir.File("cache")) {
+        std::filesystem::create_directories(m_objDir.Path() / "src");
+    }
+
+    DriverCache& Cache() { return m_objCache; }
+    std::string Root() const { return m_objDir.File("cache"); }
+
+    // 写入一个源文件，返回对应的条目（源文件名按内容区分，相同内容共用一个源文件）
+    CacheEntry Entry(const std::string& strRelativePath, const std::string& strContent) {
+        CacheEntry stcEntry;
+        stcEntry.strRelativePath = strRelativePath;
+        stcEntry.ui64Size = strContent.size();
+        stcEntry.ui64WriteTime = 133000000000000000ULL;
+        stcEntry.ui64Hash = XXHash64::Hash(strContent.data(), strContent.size());
+        stcEntry.strSourcePath = (m_objDir.Path() / "src" / std::to_string(stcEntry.ui64Hash)).string();
+        std::ofstream objFile(stcEntry.strSourcePath, std::ios::binary | std::ios::trunc);
+        objFile << strContent;
+        return stcEntry;
+    }
+
+    bool ObjectExists(const CacheEntry& stcEntry) const {
+        std::error_code ec;
+        return std::filesystem::exists(m_objCache.ObjectPath(stcEntry), ec);
+    }
+
+    size_t ObjectCount() const {
+        size_t nObjects = 0;
+        std::error_code ec;
+        for (std::filesystem::recursive_directory_iterator it(m_objDir.Path() / "cache" / "objects", ec), itEnd;
+             !ec && it != itEnd; it.increment(ec)) {
+            nObjects += it->is_regular_file();
+        }
+        return nObjects;
+    }
+
+private:
+    TestHarness::TempDir m_objDir;
+    DriverCache          m_objCache;
+};
+
+static std::string ReadFile(const std::string& strPath) {
+    std::ifstream objFile(strPath, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(objFile), std::istreambuf_iterator<char>());
+}
+
+TEST_CASE(VersionKeyIsFileNameSafe) {
+    CHECK_EQ(DriverCache::MakeVersionKey("NVIDIA GeForce RTX 4050", "32.0.15.6094"),
+             std::string("NVIDIA_GeForce_RTX_4050_32.0.15.6094"));
+    CHECK_EQ(DriverCache::MakeVersionKey("AMD\\Radeon:/*?", "1"), std::string("AMD_Radeon_____1"));
+    CHECK(DriverCache::MakeVersionKey("NVIDIA", "").empty());
+}
+
+TEST_CASE(StoreDeduplicatesObjectsAndLoadRequiresAll) {
+    CacheFixture objFixture;
+    std::string strError;
+
+    // 1. 内容相同的文件（不同路径）只保存一份对象
+    std::vector<CacheEntry> vecEntries = {
+        objFixture.Entry("Windows\\System32\\nvapi64.dll", std::string(5000, 'a')),
+        objFixture.Entry("Windows\\System32\\HostDriverStore\\FileRepository\\nv.inf_amd64\\nvapi64.dll",
+                         std::string(5000, 'a')),
+        objFixture.Entry("Windows\\System32\\HostDriverStore\\FileRepository\\nv.inf_amd64\\nv.inf", "[Version]"),
+    };
+    REQUIRE(objFixture.Cache().StoreVersion("gpu_1", "", vecEntries, strError));
+    CHECK_EQ(objFixture.ObjectCount(), size_t(2));
+    CHECK_EQ(ReadFile(objFixture.Cache().ObjectPath(vecEntries[2])), std::string("[Version]"));
+
+    // 2. 加载出的条目与保存时相同（源文件路径不保存）
+    std::vector<CacheEntry> vecLoaded;
+    REQUIRE(objFixture.Cache().LoadVersion("gpu_1", vecLoaded));
+    REQUIRE(vecLoaded.size() == vecEntries.size());
+    for (size_t i = 0; i < vecEntries.size(); i++) {
+        CHECK_EQ(vecLoaded[i].strRelativePath, vecEntries[i].strRelativePath);
+        CHECK_EQ(vecLoaded[i].ui64Hash, vecEntries[i].ui64Hash);
+        CHECK_EQ(vecLoaded[i].ui64Size, vecEntries[i].ui64Size);
+        CHECK_EQ(vecLoaded[i].ui64WriteTime, vecEntries[i].ui64WriteTime);
+        CHECK(vecLoaded[i].strSourcePath.empty());
+    }
+
+    // 3. 另一个实例（同一根目录）也能加载；任何对象缺失时视为未缓存
+    DriverCache objOther(objFixture.Root());
+    CHECK(objOther.LoadVersion("gpu_1", vecLoaded));
+    std::filesystem::remove(objFixture.Cache().ObjectPath(vecEntries[2]));
+    CHECK(!objOther.LoadVersion("gpu_1", vecLoaded));
+    CHECK(vecLoaded.empty());
+    CHECK(!objOther.LoadVersion("missing", vecLoaded));
+    CHECK(!objOther.LoadVersion("", vecLoaded));
+    CHECK(!objFixture.Cache().StoreVersion("empty", "", {}, strError));
+}
+
+TEST_CASE(GarbageCollectionKeepsObjectsOfReferencedVersions) {
+    CacheFixture objFixture;
+    std::string strError;
+    CacheEntry stcOld = objFixture.Entry("old.sys", std::string(3000, 'o'));
+    CacheEntry stcShared = objFixture.Entry("shared.dll", std::string(7000, 's'));
+    CacheEntry stcNew = objFixture.Entry("new.sys", std::string(4000, 'n'));
+    REQUIRE(objFixture.Cache().StoreVersion("v1", "", { stcOld, stcShared }, strError));
+    REQUIRE(objFixture.Cache().StoreVersion("v2", "", { stcShared, stcNew }, strError));
+
+    // 1. 两个版本各有虚拟机引用：什么都不删除
+    size_t nVersions = 0, nObjects = 0;
+    uint64_t ui64Bytes = 0;
+    objFixture.Cache().AddReference("v1", "vm-a");
+    objFixture.Cache().AddReference("v2", "vm-b");
+    objFixture.Cache().CollectGarbage(nVersions, nObjects, ui64Bytes);
+    CHECK_EQ(nVersions, size_t(0));
+    CHECK_EQ(nObjects, size_t(0));
+    CHECK_EQ(objFixture.ObjectCount(), size_t(3));
+
+    // 2. vm-a改用v2后v1没有引用：删除v1和只被v1引用的对象，共用的对象保留
+    objFixture.Cache().AddReference("v2", "vm-a");
+    objFixture.Cache().CollectGarbage(nVersions, nObjects, ui64Bytes);
+    CHECK_EQ(nVersions, size_t(1));
+    CHECK_EQ(nObjects, size_t(1));
+    CHECK_EQ(ui64Bytes, uint64_t(3000));
+    CHECK(!objFixture.ObjectExists(stcOld));
+    CHECK(objFixture.ObjectExists(stcShared));
+    CHECK(objFixture.ObjectExists(stcNew));
+    std::vector<CacheEntry> vecLoaded;
+    CHECK(!objFixture.Cache().LoadVersion("v1", vecLoaded));
+    CHECK(objFixture.Cache().LoadVersion("v2", vecLoaded));
+
+    // 3. 刚保存、还没有引用文件的版本保留；不属于任何版本的对象被回收
+    CacheEntry stcPending = objFixture.Entry("pending.sys", std::string(100, 'p'));
+    REQUIRE(objFixture.Cache().StoreVersion("v3", "", { stcPending, stcOld }, strError));
+    std::filesystem::path pathStray = std::filesystem::path(objFixture.Cache().ObjectPath(stcNew)).parent_path() /
+                                      "00000000deadbeef-5";
+    std::ofstream(pathStray, std::ios::binary) << "stray";
+    objFixture.Cache().CollectGarbage(nVersions, nObjects, ui64Bytes);
+    CHECK_EQ(nVersions, size_t(0));
+    CHECK_EQ(nObjects, size_t(1));
+    CHECK(!std::filesystem::exists(pathStray));
+    CHECK(objFixture.Cache().LoadVersion("v3", vecLoaded));
+    CHECK(objFixture.Cache().LoadVersion("v2", vecLoaded));
+
+    // 4. 重复添加同一虚拟机不重复记录；最后一个虚拟机离开后版本和对象全部回收
+    objFixture.Cache().AddReference("v2", "vm-a");
+    objFixture.Cache().AddReference("v3", "vm-a");
+    objFixture.Cache().AddReference("v3", "vm-b");
+    objFixture.Cache().CollectGarbage(nVersions, nObjects, ui64Bytes);
+    CHECK_EQ(nVersions, size_t(1));
+    CHECK(!objFixture.ObjectExists(stcShared));
+    CHECK(!objFixture.ObjectExists(stcNew));
+    CHECK(objFixture.Cache().LoadVersion("v3", vecLoaded));
+    CHECK_EQ(objFixture.ObjectCount(), size_t(2));
+}
+
+TEST_CASE(RandomReferenceChangesNeverCollectLiveObjects) {
+    // 随机的版本（共用一部分文件）和虚拟机在版本间切换，每次回收后与模型比较
+    CacheFixture objFixture;
+    TestHarness::Random objRandom(16);
+    std::vector<CacheEntry> vecPool;
+    for (int i = 0; i < 24; i++) {
+        vecPool.push_back(objFixture.Entry("file" + std::to_string(i) + ".dll",
+                                           std::string(100 + i * 37, static_cast<char>('a' + i))));
+    }
+
+    std::map<std::string, std::vector<CacheEntry>> mapVersions;   // 缓存中的版本
+    std::map<std::string, std::string> mapVMVersion;              // 虚拟机 -> 版本
+    std::set<std::string> setReferenced;                          // 曾经有过引用文件的版本
+    size_t nSteps = TestHarness::QuickMode() ? 40 : 200;
+    for (size_t nStep = 0; nStep < nSteps; nStep++) {
+        // 1. 保存新版本或让一台虚拟机改用某个版本
+        std::string strError;
+        if (mapVersions.empty() || objRandom.Below(3) == 0) {
+            std::string strKey = "v" + std::to_string(nStep);
+            std::vector<CacheEntry> vecEntries;
+            for (const auto& stcEntry : vecPool) {
+                if (objRandom.Below(4) == 0) vecEntries.push_back(stcEntry);
+            }
+            if (vecEntries.empty()) vecEntries.push_back(vecPool[objRandom.Below(vecPool.size())]);
+            REQUIRE(objFixture.Cache().StoreVersion(strKey, "", vecEntries, strError));
+            mapVersions[strKey] = vecEntries;
+        } else {
+            auto itVersion = std::next(mapVersions.begin(), objRandom.Below(mapVersions.size()));
+            std::string strVM = "vm" + std::to_string(objRandom.Below(4));
+            objFixture.Cache().AddReference(itVersion->first, strVM);
+            mapVMVersion[strVM] = itVersion->first;
+            setReferenced.insert(itVersion->first);
+        }
+
+        // 2. 模型：有引用文件且引用为空的版本被删除
+        size_t nExpectedVersions = 0;
+        for (auto it = mapVersions.begin(); it != mapVersions.end();) {
+            bool bUsed = false;
+            for (const auto& [strVM, strKey] : mapVMVersion) bUsed |= strKey == it->first;
+            if (setReferenced.count(it->first) > 0 && !bUsed) {
+                it = mapVersions.erase(it);
+                nExpectedVersions++;
+            } else {
+                ++it;
+            }
+        }
+
+        // 3. 回收后保留的版本都能完整加载，没有版本引用的对象都已删除
+        size_t nVersions = 0, nObjects = 0;
+        uint64_t ui64Bytes = 0;
+        objFixture.Cache().CollectGarbage(nVersions, nObjects, ui64Bytes);
+        CHECK_EQ(nVersions, nExpectedVersions);
+        std::set<uint64_t> setLive;
+        for (const auto& [strKey, vecEntries] : mapVersions) {
+            std::vector<CacheEntry> vecLoaded;
+            CHECK(objFixture.Cache().LoadVersion(strKey, vecLoaded));
+            for (const auto& stcEntry : vecEntries) setLive.insert(stcEntry.ui64Hash);
+        }
+        for (const auto& stcEntry : vecPool) {
+            CHECK_EQ(objFixture.ObjectExists(stcEntry), setLive.count(stcEntry.ui64Hash) > 0);
+        }
+        CHECK_EQ(objFixture.ObjectCount(), setLive.size());
+    }
+}
@@ -0,0 +1,176 @@
+﻿/********************************************************************************
+* 文件名称：DriverVerifierTest.cpp
+* 文件功能：验证复制驱动文件步骤的验证：按同步清单逐个校验文件，本次写入的文件
+*           哈希或大小不一致、关键驱动文件缺失时验证失败，虚拟机中被修改的
+*           未写入文件只作为警告
+*
+* 说明：
+*    临时目录中的host\和vm\分别模拟主机驱动目录和虚拟机系统卷，CopyEngine
+*    按DriverManifest同步，与复制步骤的流程相同
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/DriverVerifier.h"
+#include "../Smart-GPU-PV/DriverManifest.h"
+#include "../Smart-GPU-PV/CopyEngine.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+static const char* const NVIDIA_GPU = "NVIDIA GeForce RTX 4050 Laptop GPU";
+
+// 驱动文件：主机上的相对路径 -> 虚拟机中的相对路径
+static const char* const DRIVER_FILES[][2] = {
+    { "nvlddmkm.sys", "Windows/System32/drivers/nvlddmkm.sys" },
+    { "nvapi64.dll",  "Windows/System32/nvapi64.dll" },
+    { "nvoglv64.dll", "Windows/System32/nvoglv64.dll" },
+    { "repo/nv.inf",  "Windows/System32/HostDriverStore/FileRepository/nv_dispi.inf_amd64/nv.inf" },
+    { "repo/nv.cat",  "Windows/System32/HostDriverStore/FileRepository/nv_dispi.inf_amd64/nv.cat" },
+};
+
+/********************************************************************************
+* 类名称：复制步骤测试环境
+* 类功能：生成主机驱动文件，并按清单同步到模拟的虚拟机系统卷
+*********************************************************************************/
+class CopyFixture {
+public:
+    CopyFixture() {
+        TestHarness::Random objRandom(17);
+        for (const auto& pszFile : DRIVER_FILES) {
+            std::filesystem::path pathSource = m_objDir.Path() / "host" / pszFile[0];
+            std::filesystem::create_directories(pathSource.parent_path());
+            std::string strContent(20000 + objRandom.Below(300000), '\0');
+            objRandom.Fill(&strContent[0], strContent.size());
+            std::ofstream(pathSource, std::ios::binary) << strContent;
+        }
+        std::filesystem::create_directories(m_objDir.Path() / "vm");
+    }
+
+    std::string VolumeRoot() const { return m_objDir.File("vm"); }
+    std::filesystem::path VolumeFile(size_t nIndex) const { return m_objDir.Path() / "vm" / DRIVER_FILES[nIndex][1]; }
+
+    // 按清单同步全部驱动文件（跳过下标为nSkip的文件），与复制步骤一样加载清单后同步
+    bool Sync(DriverManifest& objManifest, size_t nSkip = SIZE_MAX) {
+        std::string strError;
+        if (!objManifest.Load(VolumeRoot(), strError)) {
+            return false;
+        }
+        CopyEngine objEngine;
+        objEngine.SetManifest(&objManifest);
+        for (size_t i = 0; i < sizeof(DRIVER_FILES) / sizeof(DRIVER_FILES[0]); i++) {
+            if (i != nSkip) {
+                objEngine.Add((m_objDir.Path() / "host" / DRIVER_FILES[i][0]).string(),
+                              (m_objDir.Path() / "vm" / DRIVER_FILES[i][1]).string());
+            }
+        }
+        CopyReport stcReport;
+        return objEngine.Run(nullptr, stcReport);
+    }
+
+private:
+    TestHarness::TempDir m_objDir;
+};
+
+// 修改文件中的一个字节（大小不变）
+static void FlipByte(const std::filesystem::path& path, uint64_t ui64Offset) {
+    std::fstream objFile(path, std::ios::binary | std::ios::in | std::ios::out);
+    objFile.seekg(static_cast<std::streamoff>(ui64Offset));
+    char c = 0;
+    objFile.get(c);
+    objFile.seekp(static_cast<std::streamoff>(ui64Offset));
+    objFile.put(static_cast<char>(c ^ 0x5A));
+}
+
+TEST_CASE(CompleteCopyPassesVerification) {
+    CopyFixture objFixture;
+    DriverManifest objManifest;
+    REQUIRE(objFixture.Sync(objManifest));
+
+    // 本次写入的文件全部计算哈希，关键文件和驱动包齐全
+    DriverCheckResult stcResult;
+    CHECK(DriverVerifier::VerifyCopy(objFixture.VolumeRoot(), NVIDIA_GPU, objManifest, nullptr, stcResult));
+    CHECK_EQ(stcResult.stcReport.ui64Files, uint64_t(5));
+    CHECK_EQ(stcResult.stcReport.ui64Hashed, uint64_t(5));
+    CHECK(stcResult.stcReport.vecMismatches.empty());
+    CHECK_EQ(stcResult.nWrittenMismatches, size_t(0));
+    CHECK_EQ(stcResult.vecFound.size(), size_t(4));
+    CHECK(stcResult.vecMissing.empty());
+}
+
+TEST_CASE(WrittenFileMismatchFailsCopyStep) {
+    // 内容被改动（大小不变）、截断、被删除的三种情况
+    for (int nCase = 0; nCase < 3; nCase++) {
+        CopyFixture objFixture;
+        DriverManifest objManifest;
+        REQUIRE(objFixture.Sync(objManifest));
+        std::filesystem::path pathDamaged = objFixture.VolumeFile(nCase == 0 ? 0 : 3);
+        if (nCase == 0) {
+            FlipByte(pathDamaged, 12345);
+        } else if (nCase == 1) {
+            std::filesystem::resize_file(pathDamaged, std::filesystem::file_size(pathDamaged) / 2);
+        } else {
+            std::filesystem::remove(pathDamaged);
+        }
+
+        DriverCheckResult stcResult;
+        CHECK(!DriverVerifier::VerifyCopy(objFixture.VolumeRoot(), NVIDIA_GPU, objManifest, nullptr, stcResult));
+        REQUIRE(stcResult.stcReport.vecMismatches.size() == 1);
+        const VerifyMismatch& stcMismatch = stcResult.stcReport.vecMismatches[0];
+        CHECK(stcMismatch.bWritten);
+        CHECK_EQ(stcResult.nWrittenMismatches, size_t(1));
+        const char* pszReason = nCase == 0 ? "内容与源文件不一致" : nCase == 1 ? "大小不一致" : "文件不存在";
+        CHECK(stcMismatch.strReason.find(pszReason) != std::string::npos);
+        CHECK(stcMismatch.strPath.find(std::string(nCase == 0 ? "nvlddmkm.sys" : "nv.inf")) != std::string::npos);
+    }
+}
+
+TEST_CASE(MissingKeyDriverFailsCopyStep) {
+    // 1. nvapi64.dll没有复制：清单中的文件都一致，但关键文件缺失
+    CopyFixture objFixture;
+    DriverManifest objManifest;
+    REQUIRE(objFixture.Sync(objManifest, 1));
+    DriverCheckResult stcResult;
+    CHECK(!DriverVerifier::VerifyCopy(objFixture.VolumeRoot(), NVIDIA_GPU, objManifest, nullptr, stcResult));
+    CHECK(stcResult.stcReport.vecMismatches.empty());
+    REQUIRE(stcResult.vecMissing.size() == 1);
+    CHECK(stcResult.vecMissing[0].find("nvapi64.dll") != std::string::npos);
+
+    // 2. 其他厂商的GPU不检查NVIDIA文件，只要求有驱动包
+    CHECK(DriverVerifier::VerifyCopy(objFixture.VolumeRoot(), "AMD Radeon RX 7600", objManifest, nullptr, stcResult));
+    std::filesystem::remove_all(objFixture.VolumeFile(3).parent_path());
+    std::vector<std::string> vecFound, vecMissing;
+    CHECK(!DriverVerifier::CheckKeyFiles(objFixture.VolumeRoot(), "AMD Radeon RX 7600", nullptr, vecFound, vecMissing));
+    CHECK(vecFound.empty());
+    REQUIRE(vecMissing.size() == 1);
+    CHECK(vecMissing[0].find("HostDriverStore") != std::string::npos);
+}
+
+TEST_CASE(ModifiedUnwrittenFileIsOnlyWarning) {
+    // 1. 第一次同步后保存清单；第二次同步时文件都未变化，校验走快速路径
+    CopyFixture objFixture;
+    DriverManifest objFirst;
+    REQUIRE(objFixture.Sync(objFirst));
+    std::string strError;
+    REQUIRE(objFirst.Save(strError));
+    DriverManifest objSecond;
+    REQUIRE(objFixture.Sync(objSecond));
+    DriverCheckResult stcResult;
+    CHECK(DriverVerifier::VerifyCopy(objFixture.VolumeRoot(), NVIDIA_GPU, objSecond, nullptr, stcResult));
+    CHECK_EQ(stcResult.stcReport.ui64FastPath, uint64_t(5));
+    CHECK_EQ(stcResult.stcReport.ui64Hashed, uint64_t(0));
+
+    // 2. 同步之后虚拟机中的文件被修改（修改时间随之改变）：报告不一致，但不是复制不完整
+    FlipByte(objFixture.VolumeFile(2), 7);
+    std::filesystem::last_write_time(objFixture.VolumeFile(2),
+                                     std::filesystem::last_write_time(objFixture.VolumeFile(2)) + std::chrono::hours(1));
+    CHECK(DriverVerifier::VerifyCopy(objFixture.VolumeRoot(), NVIDIA_GPU, objSecond, nullptr, stcResult));
+    REQUIRE(stcResult.stcReport.vecMismatches.size() == 1);
+    CHECK(!stcResult.stcReport.vecMismatches[0].bWritten);
+    CHECK_EQ(stcResult.nWrittenMismatches, size_t(0));
+    CHECK_EQ(stcResult.stcReport.ui64Hashed, uint64_t(1));
+}
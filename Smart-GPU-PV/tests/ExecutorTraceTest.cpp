@@ -0,0 +1,188 @@
+﻿/********************************************************************************
+* 文件名称：ExecutorTraceTest.cpp
+* 文件功能：验证调用记录环形缓冲区的覆盖与快照顺序、汇总中的最近秩百分位数、
+*           命令摘要按UTF-8字符边界截断，以及Chrome trace JSON的转义
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/ExecutorTrace.h"
+#include "../Smart-GPU-PV/JsonReader.h"
+#include "../Smart-GPU-PV/Utils.h"
+#include <algorithm>
+
+// 记录一条调用（开始时刻作为序号，便于检查顺序）
+static void RecordCall(const std::string& strLabel, uint64_t ui64StartUs, uint64_t ui64WallUs,
+                       const std::string& strCommand = "Get-VM") {
+    TraceRecord stcRecord;
+    stcRecord.strLabel = strLabel;
+    stcRecord.strKind = "host";
+    stcRecord.strCommand = strCommand;
+    stcRecord.ui64StartUs = ui64StartUs;
+    stcRecord.ui64WallUs = ui64WallUs;
+    stcRecord.dwThreadId = 1;
+    ExecutorTrace::Record(stcRecord);
+}
+
+static std::vector<uint64_t> SnapshotStarts() {
+    std::vector<uint64_t> vecStarts;
+    for (const auto& stcRecord : ExecutorTrace::Snapshot()) {
+        vecStarts.push_back(stcRecord.ui64StartUs);
+    }
+    return vecStarts;
+}
+
+// 汇总中某个标签的一行
+static std::string SummaryLine(const std::string& strLabel) {
+    std::string strSummary = ExecutorTrace::Summary();
+    size_t nPos = strSummary.find(strLabel + ":");
+    if (nPos == std::string::npos) {
+        return std::string();
+    }
+    return strSummary.substr(nPos, strSummary.find('\n', nPos) - nPos);
+}
+
+TEST_CASE(RingBufferOverwritesOldestAndSnapshotIsChronological) {
+    // 1. 未满时按顺序追加
+    ExecutorTrace::SetCapacity(4);
+    for (uint64_t i = 1; i <= 3; i++) RecordCall("a", i, 10);
+    CHECK(SnapshotStarts() == std::vector<uint64_t>({ 1, 2, 3 }));
+
+    // 2. 满后覆盖最早的记录，每个写入位置（含回到0）的快照都从最早的开始
+    std::vector<uint64_t> vecExpected = { 1, 2, 3 };
+    for (uint64_t i = 4; i <= 13; i++) {
+        RecordCall("a", i, 10);
+        vecExpected.push_back(i);
+        if (vecExpected.size() > 4) vecExpected.erase(vecExpected.begin());
+        CHECK(SnapshotStarts() == vecExpected);
+    }
+
+    // 3. Clear之后重新从头追加；SetCapacity清空已有记录
+    ExecutorTrace::Clear();
+    CHECK(ExecutorTrace::Snapshot().empty());
+    RecordCall("a", 100, 10);
+    RecordCall("a", 101, 10);
+    CHECK(SnapshotStarts() == std::vector<uint64_t>({ 100, 101 }));
+    ExecutorTrace::SetCapacity(2);
+    CHECK(ExecutorTrace::Snapshot().empty());
+    for (uint64_t i = 200; i < 205; i++) RecordCall("a", i, 10);
+    CHECK(SnapshotStarts() == std::vector<uint64_t>({ 203, 204 }));
+
+    // 4. 容量为0时停止记录
+    ExecutorTrace::SetCapacity(0);
+    RecordCall("a", 300, 10);
+    CHECK(ExecutorTrace::Snapshot().empty());
+    CHECK(ExecutorTrace::Summary().empty());
+    ExecutorTrace::SetCapacity(ExecutorTrace::DEFAULT_CAPACITY);
+}
+
+TEST_CASE(SummaryUsesNearestRankPercentiles) {
+    ExecutorTrace::SetCapacity(ExecutorTrace::DEFAULT_CAPACITY);
+
+    // 1. 单个样本：p50、p95和最大值都是它
+    RecordCall("one", 0, 7000);
+    CHECK_EQ(SummaryLine("one"), std::string("one: n=1 p50=7.0ms p95=7.0ms max=7.0ms bytes=0"));
+
+    // 2. 三个样本（乱序记录）：p50取第2个（秩⌈1.5⌉），p95取第3个（秩⌈2.85⌉）
+    RecordCall("three", 0, 3000);
+    RecordCall("three", 0, 1000);
+    RecordCall("three", 0, 2000);
+    CHECK_EQ(SummaryLine("three"), std::string("three: n=3 p50=2.0ms p95=3.0ms max=3.0ms bytes=0"));
+
+    // 3. 十个样本：p50取第5个，p95取第10个；二十个样本：p95取第19个
+    TestHarness::Random objRandom(8);
+    std::vector<uint64_t> vecTen = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    std::vector<uint64_t> vecTwenty;
+    for (uint64_t i = 1; i <= 20; i++) vecTwenty.push_back(i);
+    for (size_t i = vecTen.size(); i > 1; i--) std::swap(vecTen[i - 1], vecTen[objRandom.Below(i)]);
+    for (size_t i = vecTwenty.size(); i > 1; i--) std::swap(vecTwenty[i - 1], vecTwenty[objRandom.Below(i)]);
+    for (uint64_t ui64Ms : vecTen) RecordCall("ten", 0, ui64Ms * 1000);
+    for (uint64_t ui64Ms : vecTwenty) RecordCall("twenty", 0, ui64Ms * 1000);
+    CHECK_EQ(SummaryLine("ten"), std::string("ten: n=10 p50=5.0ms p95=10.0ms max=10.0ms bytes=0"));
+    CHECK_EQ(SummaryLine("twenty"), std::string("twenty: n=20 p50=10.0ms p95=19.0ms max=20.0ms bytes=0"));
+
+    // 4. 没有标签的记录单独汇总；输出字节数累加
+    TraceRecord stcRecord;
+    stcRecord.ui64WallUs = 1500;
+    stcRecord.ui64StdoutBytes = 100;
+    stcRecord.ui64StderrBytes = 20;
+    ExecutorTrace::Record(stcRecord);
+    CHECK_EQ(SummaryLine("(无标签)"), std::string("(无标签): n=1 p50=1.5ms p95=1.5ms max=1.5ms bytes=120"));
+    ExecutorTrace::Clear();
+}
+
+TEST_CASE(CommandIsTruncatedOnCharacterBoundary) {
+    ExecutorTrace::SetCapacity(ExecutorTrace::DEFAULT_CAPACITY);
+    const size_t nMax = ExecutorTrace::MAX_COMMAND_LENGTH;
+    const std::string strChinese = "\xE8\x99\x9A\xE6\x8B\x9F\xE6\x9C\xBA";      // "虚拟机"，每字3字节
+
+    // 1. 中文字符跨过截断点的每种对齐：结果是有效UTF-8，且只去掉跨界的那个字符
+    for (size_t nPrefix = nMax - 6; nPrefix <= nMax; nPrefix++) {
+        ExecutorTrace::Clear();
+        std::string strCommand = std::string(nPrefix, 'a') + strChinese + strChinese;
+        RecordCall("cut", 0, 1, strCommand);
+        std::string strStored = ExecutorTrace::Snapshot().at(0).strCommand;
+        CHECK(Utils::IsValidUTF8(strStored));
+        REQUIRE(strStored.size() >= 3 && strStored.compare(strStored.size() - 3, 3, "...") == 0);
+        std::string strKept = strStored.substr(0, strStored.size() - 3);
+        CHECK(strKept.size() <= nMax);
+        CHECK(strKept.size() > nMax - 3);                          // 最多退回一个字符的后续字节
+        CHECK_EQ(strKept, strCommand.substr(0, strKept.size()));
+    }
+
+    // 2. 四字节字符和恰好等于上限的命令
+    ExecutorTrace::Clear();
+    std::string strEmoji = std::string(nMax - 1, 'b') + "\xF0\x9F\x98\x80";
+    RecordCall("cut", 0, 1, strEmoji);
+    std::string strExact(nMax, 'c');
+    RecordCall("cut", 0, 1, strExact);
+    RecordCall("cut", 0, 1, "first line\nsecond line");
+    std::vector<TraceRecord> vecRecords = ExecutorTrace::Snapshot();
+    CHECK_EQ(vecRecords[0].strCommand, std::string(nMax - 1, 'b') + "...");
+    CHECK_EQ(vecRecords[1].strCommand, strExact);
+    CHECK_EQ(vecRecords[2].strCommand, std::string("first line"));
+    ExecutorTrace::Clear();
+}
+
+TEST_CASE(ChromeTraceEscapesStrings) {
+    ExecutorTrace::SetCapacity(ExecutorTrace::DEFAULT_CAPACITY);
+    ExecutorTrace::Clear();
+    const std::string strCommand = "Get-VM -Name \"VM \\\\ 1\"\t\x01\x1F\r C:\\\xE8\x99\x9A\xE6\x8B\x9F\xE6\x9C\xBA";
+    const std::string strLabel = "Configure\"GPU\"/Copy\\Drivers";
+    RecordCall(strLabel, 1234, 5678, strCommand);
+    RecordCall("", 2000, 10, "Get-VMGpuPartitionAdapter");
+
+    // 1. 转义后的字符
+    std::string strJson = ExecutorTrace::ToChromeTrace();
+    CHECK(strJson.find("\\\"VM \\\\\\\\ 1\\\"\\t\\u0001\\u001f\\r C:\\\\") != std::string::npos);
+    CHECK(strJson.find("\"name\":\"Configure\\\"GPU\\\"/Copy\\\\Drivers\"") != std::string::npos);
+    for (char c : strJson) {
+        CHECK(static_cast<unsigned char>(c) >= 0x20 || c == '\n');
+    }
+
+    // 2. 整个输出是有效JSON，解析后的字符串与原值相同；没有标签时名称为命令摘要
+    JsonDocument objDocument;
+    std::string strError;
+    REQUIRE(objDocument.Parse(strJson, strError));
+    const JsonValue* pEvents = objDocument.Root()->Find("traceEvents");
+    REQUIRE(pEvents && pEvents->nChildren == 2);
+    const JsonValue* pFirst = pEvents->pFirstChild;
+    CHECK_EQ(pFirst->Find("name")->AsString(), strLabel);
+    CHECK_EQ(pFirst->Find("cat")->AsString(), std::string("host"));
+    CHECK_EQ(pFirst->Find("ph")->AsString(), std::string("X"));
+    CHECK_EQ(pFirst->Find("ts")->AsString(), std::string("1234"));
+    CHECK_EQ(pFirst->Find("dur")->AsString(), std::string("5678"));
+    CHECK_EQ(pFirst->Find("args")->Find("command")->AsString(), strCommand);
+    bool bTimedOut = true;
+    CHECK(pFirst->Find("args")->Find("timed_out")->AsBool(bTimedOut) && !bTimedOut);
+    CHECK_EQ(pFirst->pNext->Find("name")->AsString(), std::string("Get-VMGpuPartitionAdapter"));
+
+    // 3. 没有记录时是空数组
+    ExecutorTrace::Clear();
+    std::string strEmpty = ExecutorTrace::ToChromeTrace();                 // 文档引用源文本
+    REQUIRE(objDocument.Parse(strEmpty, strError));
+    CHECK_EQ(objDocument.Root()->Find("traceEvents")->nChildren, 0u);
+}
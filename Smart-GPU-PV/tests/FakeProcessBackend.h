@@ -0,0 +1,322 @@
+﻿/********************************************************************************
+* 文件名称：FakeProcessBackend.h
+* 文件功能：测试用的替身进程后端，在进程内模拟常驻PowerShell宿主
+*
+* 类说明：
+*    FakeHostProcess实现ChildProcess，按PowerShellHost的帧协议工作：
+*    启动后输出就绪标记，从WriteInput收到请求行后逐条"执行"命令并输出
+*    响应帧。命令的结果由测试提供的处理函数决定，以下命令文本有特殊含义：
+*    - "crash"：宿主在输出该命令的响应帧之前退出
+*    - "hang"：宿主不再输出任何内容，直到截止时间到达或被结束
+*    读取指定数量的请求后宿主可以停止读取stdin（nRequestsBeforeStall），
+*    之后的WriteInput像管道已满一样阻塞，直到截止时间到达或进程被结束。
+*    FakeProcessBackend实现ProcessBackend：Spawn返回FakeHostProcess，
+*    Run/RunStreaming把独立进程的命令行交给同一个处理函数。可以设置每次
+*    往返和每次启动进程的模拟耗时，用于比较批量和逐条执行的延迟。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "../Smart-GPU-PV/ProcessBackend.h"
+#include "../Smart-GPU-PV/Utils.h"
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+/********************************************************************************
+* 结构体名称：替身后端统计
+*********************************************************************************/
+struct FakeBackendStats {
+    std::atomic<size_t> nSpawns{ 0 };        // 启动的宿主进程数
+    std::atomic<size_t> nRuns{ 0 };          // 独立进程执行次数
+    std::atomic<size_t> nRequests{ 0 };      // 宿主收到的请求行数（往返次数）
+    std::atomic<size_t> nCommands{ 0 };      // 宿主执行的命令数
+};
+
+/********************************************************************************
+* 结构体名称：替身后端配置
+*********************************************************************************/
+struct FakeBackendConfig {
+    // 命令处理函数（默认：退出码0，输出为命令文本）
+    std::function<CommandResult(const std::string&)> fnHandler;
+    // 每个响应帧之前额外输出的行（参数为请求序号），用于验证帧解析的容错
+    std::function<std::vector<std::string>(uint64_t)> fnExtraLines;
+    uint32_t ui32RoundTripUs = 0;   // 宿主每次往返的模拟耗时（微秒）
+    uint32_t ui32SpawnUs = 0;       // 启动一个进程的模拟耗时（微秒）
+    bool     bFailSpawn = false;    // Spawn是否失败
+    bool     bNoReady = false;      // 宿主是否在输出就绪标记前退出
+    size_t   nRequestsBeforeStall = SIZE_MAX;   // 读取多少个请求后不再读取stdin
+};
+
+/********************************************************************************
+* 类名称：替身宿主进程
+*********************************************************************************/
+class FakeHostProcess : public ChildProcess {
+public:
+    FakeHostProcess(const FakeBackendConfig& stcConfig, FakeBackendStats& stcStats)
+        : m_stcConfig(stcConfig), m_stcStats(stcStats) {
+        if (m_stcConfig.bNoReady) {
+            m_bAlive = false;
+        } else {
+            m_deqLines.push_back("Windows PowerShell banner");
+            m_deqLines.push_back("##SGP-READY##");
+        }
+    }
+
+    bool WriteInput(const std::string& strData) override {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        if (!m_bAlive) {
+            return false;
+        }
+
+        // 宿主不再读取stdin：写入阻塞到截止时间到达或进程被结束，然后失败
+        if (m_nRequestsRead >= m_stcConfig.nRequestsBeforeStall) {
+            while (m_bAlive) {
+                if (!m_bHasDeadline) {
+                    m_cv.wait(lock);
+                } else if (m_cv.wait_until(lock, m_tpDeadline) == std::cv_status::timeout) {
+                    m_bExpired = true;
+                    m_bAlive = false;
+                }
+            }
+            m_cv.notify_all();
+            return false;
+        }
+
+        m_strInput += strData;
+        size_t nNewLine;
+        while ((nNewLine = m_strInput.find('\n')) != std::string::npos) {
+            std::string strRequest = m_strInput.substr(0, nNewLine);
+            m_strInput.erase(0, nNewLine + 1);
+            m_nRequestsRead++;
+            HandleRequest(strRequest, lock);
+        }
+        m_cv.notify_all();
+        return true;
+    }
+
+    bool ReadOutputLine(std::string& strLine) override {
+        std::unique_lock<std::mutex> lock(m_mtx);
+        while (true) {
+            if (!m_deqLines.empty()) {
+                strLine = std::move(m_deqLines.front());
+                m_deqLines.pop_front();
+                return true;
+            }
+            if (!m_bAlive) {
+                return false;
+            }
+            // 截止时间到达：与真实后端一样结束进程，读取随之失败
+            if (m_bHasDeadline) {
+                if (m_cv.wait_until(lock, m_tpDeadline) == std::cv_status::timeout && m_deqLines.empty()) {
+                    m_bExpired = true;
+                    m_bAlive = false;
+                }
+            } else {
+                m_cv.wait(lock);
+            }
+        }
+    }
+
+    bool IsAlive() override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_bAlive;
+    }
+
+    void Terminate() override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_bAlive = false;
+        m_cv.notify_all();
+    }
+
+    void SetDeadline(DWORD dwTimeoutMs) override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (dwTimeoutMs == INFINITE) {
+            m_bHasDeadline = false;
+        } else {
+            m_bHasDeadline = true;
+            m_bExpired = false;
+            m_tpDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(dwTimeoutMs);
+        }
+        m_cv.notify_all();
+    }
+
+    bool DeadlineExpired() override {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        return m_bExpired;
+    }
+
+private:
+    FakeBackendConfig                     m_stcConfig;
+    FakeBackendStats&                     m_stcStats;
+    std::mutex                            m_mtx;
+    std::condition_variable               m_cv;
+    std::deque<std::string>               m_deqLines;       // 待读取的输出行
+    std::string                           m_strInput;       // 未组成完整行的输入
+    bool                                  m_bAlive = true;  // 是否存活
+    bool                                  m_bHung = false;  // 是否已挂起
+    size_t                                m_nRequestsRead = 0;   // 已读取的请求数
+    bool                                  m_bHasDeadline = false;
+    bool                                  m_bExpired = false;
+    std::chrono::steady_clock::time_point m_tpDeadline;
+
+    /********************************************************************************
+    * 函数名称：处理一个请求行（与宿主引导脚本的循环相同）
+    *********************************************************************************/
+    void HandleRequest(const std::string& strRequest, std::unique_lock<std::mutex>& lock) {
+        if (m_bHung) {
+            return;
+        }
+        std::istringstream objStream(strRequest);
+        std::string strSeq, strMode, strCommands;
+        if (!(objStream >> strSeq >> strMode >> strCommands)) {
+            return;
+        }
+        m_stcStats.nRequests++;
+        uint64_t ui64Seq = std::stoull(strSeq);
+
+        // 1. 模拟往返耗时（解锁，允许其他线程操作其他宿主）
+        if (m_stcConfig.ui32RoundTripUs > 0) {
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::microseconds(m_stcConfig.ui32RoundTripUs));
+            lock.lock();
+        }
+
+        // 2. 逐条执行，失败即停止模式下跳过其余命令
+        bool bFailed = false;
+        for (const std::string& strB64 : Utils::Split(strCommands, ',')) {
+            std::string strCommand;
+            Utils::Base64Decode(strB64, strCommand);
+            CommandResult stcResult;
+            if (bFailed && strMode == "1") {
+                stcResult.nExitCode = -1;
+            } else if (strCommand == "crash") {
+                m_bAlive = false;
+                return;
+            } else if (strCommand == "hang") {
+                m_bHung = true;
+                return;
+            } else {
+                m_stcStats.nCommands++;
+                if (m_stcConfig.fnHandler) {
+                    stcResult = m_stcConfig.fnHandler(strCommand);
+                } else {
+                    stcResult.nExitCode = 0;
+                    stcResult.strOutput = strCommand;
+                }
+            }
+            bFailed = bFailed || stcResult.nExitCode != 0;
+
+            if (m_stcConfig.fnExtraLines) {
+                for (auto& strExtra : m_stcConfig.fnExtraLines(ui64Seq)) {
+                    m_deqLines.push_back(std::move(strExtra));
+                }
+            }
+            m_deqLines.push_back("##SGP-FRAME## " + strSeq + " " + std::to_string(stcResult.nExitCode) + " " +
+                                 Utils::Base64Encode(stcResult.strOutput) + " " +
+                                 Utils::Base64Encode(stcResult.strError));
+        }
+    }
+};
+
+/********************************************************************************
+* 类名称：替身进程后端
+*********************************************************************************/
+class FakeProcessBackend : public ProcessBackend {
+public:
+    FakeBackendConfig stcConfig;   // 创建进程前可修改
+    FakeBackendStats  stcStats;
+
+    bool Run(const std::string& strCmdLine, DWORD, CommandResult& stcResult) override {
+        stcStats.nRuns++;
+        Delay(stcConfig.ui32SpawnUs);
+        stcResult = Handle(ExtractCommand(strCmdLine));
+        return true;
+    }
+
+    bool RunStreaming(const std::string& strCmdLine, DWORD, const LineSink& fnSink,
+                      CommandResult& stcResult) override {
+        stcStats.nRuns++;
+        Delay(stcConfig.ui32SpawnUs);
+        CommandResult stcFull = Handle(ExtractCommand(strCmdLine));
+        std::string_view svText = stcFull.strOutput, svLine;
+        while (Utils::NextLine(svText, svLine)) {
+            fnSink(svLine);
+        }
+        stcResult.nExitCode = stcFull.nExitCode;
+        stcResult.strError = stcFull.strError;
+        return true;
+    }
+
+    std::unique_ptr<ChildProcess> Spawn(const std::string&, std::string& strError) override {
+        if (stcConfig.bFailSpawn) {
+            strError = "fake spawn failure";
+            return nullptr;
+        }
+        stcStats.nSpawns++;
+        Delay(stcConfig.ui32SpawnUs);
+        auto pProcess = std::make_unique<FakeHostProcess>(stcConfig, stcStats);
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_vecProcesses.push_back(pProcess.get());
+        return pProcess;
+    }
+
+    /********************************************************************************
+    * 函数名称：结束最近启动的宿主（模拟宿主在空闲时崩溃）
+    * 注意事项：
+    *    - 调用时该宿主必须仍然存在（例如空闲地留在进程池中）
+    *********************************************************************************/
+    void KillLastHost() {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (!m_vecProcesses.empty()) {
+            m_vecProcesses.back()->Terminate();
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：从独立进程命令行中取出命令文本
+    * 函数功能：去掉PowerShellExecutor::BuildCommandLine添加的前缀、编码设置和引号
+    *********************************************************************************/
+    static std::string ExtractCommand(const std::string& strCmdLine) {
+        static const std::string strPrefix = "[Console]::OutputEncoding = [System.Text.Encoding]::UTF8; ";
+        size_t nStart = strCmdLine.find(strPrefix);
+        if (nStart == std::string::npos) {
+            return strCmdLine;
+        }
+        std::string strCommand = strCmdLine.substr(nStart + strPrefix.size());
+        if (!strCommand.empty() && strCommand.back() == '"') {
+            strCommand.pop_back();
+        }
+        return strCommand;
+    }
+
+private:
+    std::mutex                     m_mtx;
+    std::vector<FakeHostProcess*>  m_vecProcesses;   // 已启动的宿主（仅KillLastHost使用）
+
+    CommandResult Handle(const std::string& strCommand) {
+        if (stcConfig.fnHandler) {
+            return stcConfig.fnHandler(strCommand);
+        }
+        CommandResult stcResult;
+        stcResult.nExitCode = 0;
+        stcResult.strOutput = strCommand;
+        return stcResult;
+    }
+
+    static void Delay(uint32_t ui32Us) {
+        if (ui32Us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(ui32Us));
+        }
+    }
+};
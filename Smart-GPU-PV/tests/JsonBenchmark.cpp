@@ -0,0 +1,218 @@
+﻿/********************************************************************************
+* 文件名称：JsonBenchmark.cpp
+* 文件功能：在生成的虚拟机清单上比较单遍JSON解析与旧的按'}'切分的解析
+*
+* 说明：
+*    输入模拟GetAllVMsViaPowerShell中ConvertTo-Json的输出（缩进格式，
+*    实例路径含转义的反斜杠），规模为1,000和5,000台虚拟机：
+*    - 旧实现：按下一个'}'切分对象，每个键调用一次Utils::ExtractJsonValue
+*      （实例路径中的{GUID}也会被当作对象结尾）
+*    - 新实现：JsonDocument::Parse一遍扫描，MapList按JsonFields<VMInfo>映射
+*    另外验证嵌套对象（旧实现在此切错对象）和JsonFields<GPUInfo>的映射。
+*    直接运行得到完整结果；CTest以--quick运行，只验证结果正确。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/VMManager.h"
+#include "../Smart-GPU-PV/GPUManager.h"
+#include "../Smart-GPU-PV/Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+/********************************************************************************
+* 函数名称：旧实现：按下一个'}'切分对象，逐键提取
+*********************************************************************************/
+static std::vector<VMInfo> LegacyParseVMJson(const std::string& json) {
+    std::vector<VMInfo> vms;
+    std::string trimmedJson = Utils::Trim(json);
+    if (trimmedJson.empty()) return vms;
+    if (trimmedJson[0] == '[') {
+        size_t lastBracket = trimmedJson.find_last_of(']');
+        if (lastBracket != std::string::npos) {
+            trimmedJson = trimmedJson.substr(1, lastBracket - 1);
+        }
+    }
+    size_t pos = 0;
+    while (pos < trimmedJson.length()) {
+        size_t objStart = trimmedJson.find('{', pos);
+        if (objStart == std::string::npos) break;
+        size_t objEnd = trimmedJson.find('}', objStart);
+        if (objEnd == std::string::npos) break;
+        std::string objStr = trimmedJson.substr(objStart, objEnd - objStart + 1);
+
+        VMInfo vmInfo;
+        vmInfo.strName = Utils::ExtractJsonValue(objStr, "Name");
+        vmInfo.strState = Utils::ExtractJsonValue(objStr, "State");
+        vmInfo.strGPUStatus = Utils::ExtractJsonValue(objStr, "GpuStatus");
+        vmInfo.strGPUInstancePath = Utils::ExtractJsonValue(objStr, "InstancePath");
+        std::string vramStr = Utils::ExtractJsonValue(objStr, "VRAM");
+        if (!vramStr.empty()) {
+            try {
+                vmInfo.ui64VramBytes = std::stoull(vramStr);
+            } catch (...) {
+                vmInfo.ui64VramBytes = 0;
+            }
+        }
+        if (!vmInfo.strName.empty()) {
+            vms.push_back(vmInfo);
+        }
+        pos = objEnd + 1;
+    }
+    return vms;
+}
+
+/********************************************************************************
+* 函数名称：新实现：与VMManager::ParseVMJson相同
+*********************************************************************************/
+static std::vector<VMInfo> ParseVMJson(const std::string& json) {
+    std::vector<VMInfo> vms;
+    JsonDocument document;
+    std::string error;
+    if (document.Parse(json, error)) {
+        document.MapList(vms);
+    }
+    return vms;
+}
+
+/********************************************************************************
+* 函数名称：生成虚拟机清单
+* 函数参数：
+*    [IN]  size_t nVMs：虚拟机数量
+*    [IN]  bool bNested：是否为每台虚拟机附加一个嵌套对象（适配器详情）
+*********************************************************************************/
+static std::string MakeVMInventory(size_t nVMs, bool bNested) {
+    static const char* const STATES[] = { "Running", "Off", "Saved", "Paused" };
+    TestHarness::Random objRandom(13);
+    std::string strJson = "[\r\n";
+    for (size_t i = 0; i < nVMs; i++) {
+        bool bGpu = objRandom.Below(3) != 0;
+        std::string strPath = bGpu ? "\\\\\\\\?\\\\PCI#VEN_10DE&DEV_28A1&SUBSYS_" + std::to_string(objRandom.Below(100000)) +
+                                     "#4&1f5b3a&0&0008#{064092b3-625e-43bf-9eb5-dc845897dd59}" : "";
+        strJson += "    {\r\n";
+        strJson += "        \"Name\":  \"vm-" + std::to_string(i) + "\",\r\n";
+        strJson += "        \"State\":  \"" + std::string(STATES[objRandom.Below(4)]) + "\",\r\n";
+        if (bNested) {
+            strJson += "        \"Adapter\":  {\r\n"
+                       "                        \"Name\":  \"adapter\",\r\n"
+                       "                        \"Slot\":  0\r\n"
+                       "                    },\r\n";
+        }
+        strJson += "        \"GpuStatus\":  \"" + std::string(bGpu ? "On" : "Off") + "\",\r\n";
+        strJson += "        \"VRAM\":  " + std::to_string(bGpu ? (objRandom.Below(16) + 1) << 30 : 0) + ",\r\n";
+        strJson += "        \"InstancePath\":  \"" + strPath + "\"\r\n";
+        strJson += (i + 1 < nVMs) ? "    },\r\n" : "    }\r\n";
+    }
+    return strJson + "]";
+}
+
+/********************************************************************************
+* 函数名称：测量每次解析的平均耗时（毫秒）
+*********************************************************************************/
+template <typename TFunc>
+static double MeasureMs(TFunc fnRun) {
+    size_t nRounds = TestHarness::QuickMode() ? 2 : 20;
+    auto tpStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < nRounds; i++) {
+        fnRun();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpStart).count() / nRounds;
+}
+
+TEST_CASE(VMInventoryOfThousandsOfVMs) {
+    std::vector<size_t> vecSizes = { 1000 };
+    if (!TestHarness::QuickMode()) {
+        vecSizes.push_back(5000);
+    }
+    for (size_t nVMs : vecSizes) {
+        std::string strJson = MakeVMInventory(nVMs, false);
+        std::vector<VMInfo> vecLegacy, vecCurrent;
+        double dParseOnly = MeasureMs([&]() {
+            JsonDocument document;
+            std::string error;
+            document.Parse(strJson, error);
+        });
+        double dLegacy = MeasureMs([&]() { vecLegacy = LegacyParseVMJson(strJson); });
+        double dCurrent = MeasureMs([&]() { vecCurrent = ParseVMJson(strJson); });
+
+        std::printf("%zu VMs, %zu KB\n", nVMs, strJson.size() >> 10);
+        std::printf("  legacy split + ExtractJsonValue  %8.2f ms\n", dLegacy);
+        std::printf("  JsonDocument::Parse              %8.2f ms\n", dParseOnly);
+        std::printf("  Parse + MapList<VMInfo>          %8.2f ms  (%.1fx)\n", dCurrent, dLegacy / dCurrent);
+
+        // 实例路径以{GUID}结尾，旧实现在字符串中的'}'处切断对象，路径丢失；
+        // 其余字段两种实现一致
+        REQUIRE(vecCurrent.size() == nVMs);
+        REQUIRE(vecLegacy.size() == nVMs);
+        bool bSame = true;
+        size_t nPathsLost = 0;
+        for (size_t i = 0; i < nVMs; i++) {
+            bSame = bSame && vecCurrent[i].strName == vecLegacy[i].strName &&
+                    vecCurrent[i].strState == vecLegacy[i].strState &&
+                    vecCurrent[i].strGPUStatus == vecLegacy[i].strGPUStatus &&
+                    vecCurrent[i].ui64VramBytes == vecLegacy[i].ui64VramBytes;
+            bool bHasPath = vecCurrent[i].strGPUStatus == "On";
+            bSame = bSame && bHasPath == (vecCurrent[i].strGPUInstancePath.size() > 0) &&
+                    (!bHasPath || vecCurrent[i].strGPUInstancePath.back() == '}');
+            nPathsLost += (vecLegacy[i].strGPUInstancePath != vecCurrent[i].strGPUInstancePath) ? 1 : 0;
+        }
+        std::printf("  instance paths lost by legacy split: %zu\n", nPathsLost);
+        CHECK(bSame);
+        CHECK_EQ(vecCurrent[0].strName, std::string("vm-0"));
+    }
+}
+
+TEST_CASE(NestedObjectsDoNotSplitVMs) {
+    std::string strJson = MakeVMInventory(1000, true);
+    std::vector<VMInfo> vecLegacy = LegacyParseVMJson(strJson);
+    std::vector<VMInfo> vecCurrent = ParseVMJson(strJson);
+    std::printf("1000 VMs with nested objects: legacy %zu entries (GpuStatus lost on %zu), current %zu entries\n",
+                vecLegacy.size(),
+                static_cast<size_t>(std::count_if(vecLegacy.begin(), vecLegacy.end(),
+                                                  [](const VMInfo& vm) { return vm.strGPUStatus.empty(); })),
+                vecCurrent.size());
+
+    // 嵌套对象的Name不覆盖虚拟机名称，其后的字段照常映射
+    REQUIRE(vecCurrent.size() == 1000);
+    CHECK_EQ(vecCurrent[7].strName, std::string("vm-7"));
+    CHECK(!vecCurrent[7].strGPUStatus.empty());
+    CHECK(std::all_of(vecCurrent.begin(), vecCurrent.end(), [](const VMInfo& vm) {
+        return vm.strGPUStatus == "Off" || vm.ui64VramBytes != 0;
+    }));
+}
+
+TEST_CASE(GpuInventoryMapsIntoGPUInfo) {
+    // ConvertTo-Json：单块显卡输出为对象，多块时为数组；驱动路径含转义的反斜杠
+    const std::string strSingle =
+        "{\r\n"
+        "    \"Name\":  \"NVIDIA GeForce RTX 4090\",\r\n"
+        "    \"PNPDeviceID\":  \"PCI\\\\VEN_10DE\\u0026DEV_2684\\u0026SUBSYS_16F310DE\\\\4\\u00261F5B3A\",\r\n"
+        "    \"DriverPath\":  \"C:\\\\Windows\\\\System32\\\\DriverStore\\\\FileRepository\\\\nv_dispi.inf_amd64_abc\"\r\n"
+        "}";
+    std::vector<GPUInfo> vecGPUs;
+    JsonDocument objSingle;
+    std::string strError;
+    REQUIRE(objSingle.Parse(strSingle, strError));
+    objSingle.MapList(vecGPUs);
+    REQUIRE(vecGPUs.size() == 1);
+    CHECK_EQ(vecGPUs[0].strFriendlyName, std::string("NVIDIA GeForce RTX 4090"));
+    CHECK_EQ(vecGPUs[0].strPnpDeviceID, std::string("PCI\\VEN_10DE&DEV_2684&SUBSYS_16F310DE\\4&1F5B3A"));
+    CHECK_EQ(vecGPUs[0].strDriverPath,
+             std::string("C:\\Windows\\System32\\DriverStore\\FileRepository\\nv_dispi.inf_amd64_abc"));
+
+    const std::string strList =
+        "[{\"Name\":\"Microsoft Basic Display Adapter\",\"PNPDeviceID\":\"ROOT\\\\BasicDisplay\",\"DriverPath\":\"\"},"
+        " {\"Name\":\"AMD Radeon RX 7900\",\"PNPDeviceID\":\"PCI\\\\VEN_1002\\u0026DEV_744C\",\"DriverPath\":\"C:\\\\amd\"}]";
+    vecGPUs.clear();
+    JsonDocument objList;
+    REQUIRE(objList.Parse(strList, strError));
+    objList.MapList(vecGPUs);
+    REQUIRE(vecGPUs.size() == 2);
+    CHECK_EQ(vecGPUs[1].strPnpDeviceID, std::string("PCI\\VEN_1002&DEV_744C"));
+    CHECK_EQ(vecGPUs[1].strDriverPath, std::string("C:\\amd"));
+    CHECK_EQ(vecGPUs[1].ui64VramBytes, static_cast<uint64_t>(0));   // 显存来自DXGI，不在字段表中
+}
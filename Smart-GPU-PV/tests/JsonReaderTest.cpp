@@ -0,0 +1,272 @@
+﻿/********************************************************************************
+* 文件名称：JsonReaderTest.cpp
+* 文件功能：验证JsonDocument的转义与代理对、嵌套结构、错误输入的拒绝，
+*           以及MapObject/MapList对ConvertTo-Json单个对象和数组输出的映射
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/JsonReader.h"
+#include "../Smart-GPU-PV/VMManager.h"
+
+// 含布尔字段的结构体（VMInfo没有布尔成员）
+struct JsonTestAdapter {
+    std::string strPath;
+    uint64_t    ui64Vram = 0;
+    bool        bCache = false;
+};
+
+template <>
+struct JsonFields<JsonTestAdapter> {
+    static constexpr auto Fields = std::make_tuple(
+        MakeJsonField("Path", &JsonTestAdapter::strPath),
+        MakeJsonField("Vram", &JsonTestAdapter::ui64Vram),
+        MakeJsonField("Cache", &JsonTestAdapter::bCache));
+};
+
+// 解析只含一个字符串的数组，返回反转义后的值
+static std::string DecodeString(const std::string& strLiteral) {
+    std::string strJson = "[\"" + strLiteral + "\"]";
+    JsonDocument objDocument;
+    std::string strError;
+    if (!objDocument.Parse(strJson, strError) || !objDocument.Root()->pFirstChild) {
+        return "<解析失败：" + strError + ">";
+    }
+    return objDocument.Root()->pFirstChild->AsString();
+}
+
+TEST_CASE(StringEscapesAreDecoded) {
+    CHECK_EQ(DecodeString("plain"), std::string("plain"));
+    CHECK_EQ(DecodeString("a\\\"b\\\\c\\/d"), std::string("a\"b\\c/d"));
+    CHECK_EQ(DecodeString("\\b\\f\\n\\r\\t"), std::string("\b\f\n\r\t"));
+    CHECK_EQ(DecodeString("\\u0041\\u00e9\\u4E2D"), std::string("A\xC3\xA9\xE4\xB8\xAD"));
+    CHECK_EQ(DecodeString("C:\\\\VMs\\\\\xE6\xB5\x8B\xE8\xAF\x95"), std::string("C:\\VMs\\\xE6\xB5\x8B\xE8\xAF\x95"));
+    CHECK_EQ(DecodeString("\\\\"), std::string("\\"));
+    CHECK_EQ(DecodeString(""), std::string());
+
+    // 没有转义时直接引用源文本，bEscaped只在有转义时置位
+    std::string strJson = "{\"a\":\"x\",\"b\":\"\\n\"}";
+    JsonDocument objDocument;
+    std::string strError;
+    REQUIRE(objDocument.Parse(strJson, strError));
+    CHECK(!objDocument.Root()->Find("a")->bEscaped);
+    CHECK(objDocument.Root()->Find("a")->svText.data() == strJson.data() + 6);
+    CHECK(objDocument.Root()->Find("b")->bEscaped);
+}
+
+TEST_CASE(SurrogatePairsCombineAndLoneSurrogatesAreReplaced) {
+    const std::string strReplacement = "\xEF\xBF\xBD";
+    CHECK_EQ(DecodeString("\\uD83D\\uDE00"), std::string("\xF0\x9F\x98\x80"));
+    CHECK_EQ(DecodeString("\\ud83d\\ude00!"), std::string("\xF0\x9F\x98\x80!"));
+    CHECK_EQ(DecodeString("\\uD83D"), strReplacement);                     // 高代理在结尾
+    CHECK_EQ(DecodeString("\\uD83Dabc"), strReplacement + "abc");           // 高代理后是普通字符
+    CHECK_EQ(DecodeString("\\uD83D\\u0041"), strReplacement + "A");         // 高代理后不是低代理
+    CHECK_EQ(DecodeString("\\uD83D\\uD83D\\uDE00"), strReplacement + "\xF0\x9F\x98\x80");
+    CHECK_EQ(DecodeString("\\uDE00x"), strReplacement + "x");               // 孤立的低代理
+    CHECK_EQ(DecodeString("\\uD83D\\n"), strReplacement + "\n");
+}
+
+TEST_CASE(NestedObjectsAndArraysFormATree) {
+    std::string strJson =
+        "{ \"Name\": \"VM1\", \"Adapters\": [ { \"Path\": \"a\", \"Vram\": 1 }, { \"Path\": \"b\", \"Vram\": 2 } ],"
+        "  \"Empty\": {}, \"List\": [], \"Nested\": [[1, [2, null]], {\"k\": {\"k\": true}}],"
+        "  \"na\\u006De\": \"escaped key\" }";
+    JsonDocument objDocument;
+    std::string strError;
+    REQUIRE(objDocument.Parse(strJson, strError));
+    const JsonValue* pRoot = objDocument.Root();
+    REQUIRE(pRoot && pRoot->eType == JsonType::Object);
+    CHECK_EQ(pRoot->nChildren, 6u);
+
+    // 1. 对象数组
+    const JsonValue* pAdapters = pRoot->Find("Adapters");
+    REQUIRE(pAdapters && pAdapters->eType == JsonType::Array);
+    CHECK_EQ(pAdapters->nChildren, 2u);
+    const JsonValue* pSecond = pAdapters->pFirstChild->pNext;
+    REQUIRE(pSecond && !pSecond->pNext);
+    CHECK_EQ(pSecond->Find("Path")->AsString(), std::string("b"));
+    JsonTestAdapter stcAdapter;
+    JsonDocument::MapObject(*pSecond, stcAdapter);
+    CHECK_EQ(stcAdapter.ui64Vram, uint64_t(2));
+
+    // 2. 空对象、空数组和多层嵌套
+    CHECK(pRoot->Find("Empty")->eType == JsonType::Object && pRoot->Find("Empty")->nChildren == 0);
+    CHECK(pRoot->Find("List")->eType == JsonType::Array && !pRoot->Find("List")->pFirstChild);
+    const JsonValue* pNested = pRoot->Find("Nested");
+    const JsonValue* pInner = pNested->pFirstChild->pFirstChild->pNext;     // [2, null]
+    REQUIRE(pInner && pInner->eType == JsonType::Array);
+    CHECK_EQ(pInner->pFirstChild->AsString(), std::string("2"));
+    CHECK(pInner->pFirstChild->pNext->eType == JsonType::Null);
+    bool bValue = false;
+    CHECK(pNested->pFirstChild->pNext->Find("k")->Find("k")->AsBool(bValue) && bValue);
+
+    // 3. 键中的转义：按反转义后的键查找；查找只在对象上进行
+    CHECK(pRoot->Find("name") && pRoot->Find("name")->AsString() == "escaped key");
+    CHECK(!pRoot->Find("Missing"));
+    CHECK(!pAdapters->Find("Path"));
+
+    // 4. 嵌套深度：MAX_DEPTH层可以解析，再多一层失败
+    const int nMax = JsonDocument::MAX_DEPTH;
+    std::string strDeep = std::string(nMax, '[') + std::string(nMax, ']');
+    CHECK(objDocument.Parse(strDeep, strError));
+    std::string strTooDeep = std::string(nMax + 1, '[') + std::string(nMax + 1, ']');
+    CHECK(!objDocument.Parse(strTooDeep, strError));
+    CHECK(strError.find("嵌套层数过深") != std::string::npos);
+}
+
+TEST_CASE(MalformedAndTruncatedInputIsRejected) {
+    struct BadInput {
+        std::string strJson;
+        const char* pszError;
+    };
+    const BadInput stcInputs[] = {
+        { "", "意外的输入结束" },
+        { "   \r\n", "意外的输入结束" },
+        { "{\"Name\": \"VM1\"", "对象未结束" },
+        { "{\"Name\": ", "意外的输入结束" },
+        { "[1, 2", "数组未结束" },
+        { "[1, 2,", "意外的输入结束" },
+        { "[1, ]", "意外的字符" },
+        { "[1 2]", "数组中缺少','或']'" },
+        { "{\"a\" 1}", "对象中缺少':'" },
+        { "{a: 1}", "对象中缺少键" },
+        { "{\"a\": 1,}", "对象中缺少键" },
+        { "{\"a\": 1 \"b\": 2}", "对象中缺少','或'}'" },
+        { "\"abc", "字符串未结束" },
+        { "\"abc\\", "字符串未结束" },
+        { "\"\\x\"", "无效的转义字符" },
+        { "\"\\u12G4\"", "无效的\\u转义" },
+        { "\"\\u12\"", "无效的\\u转义" },
+        { "\"a\x01" "b\"", "字符串中含有控制字符" },
+        { "\"a\nb\"", "字符串中含有控制字符" },
+        { "tru", "无效的字面量" },
+        { "nul", "无效的字面量" },
+        { "False", "意外的字符" },
+        { "01", "数字不能以0开头" },
+        { "-", "无效的数字" },
+        { "1.", "无效的数字" },
+        { "1e+", "无效的数字" },
+        { "@", "意外的字符" },
+    };
+    for (const auto& stcInput : stcInputs) {
+        JsonDocument objDocument;
+        std::string strError;
+        bool bParsed = objDocument.Parse(stcInput.strJson, strError);
+        CHECK(!bParsed);
+        CHECK(objDocument.Root() == nullptr);
+        if (strError.find(stcInput.pszError) == std::string::npos) {
+            CHECK_EQ(strError, std::string(stcInput.pszError));
+        }
+    }
+
+    // 错误信息包含位置；失败后同一文档可以重新解析
+    JsonDocument objDocument;
+    std::string strError;
+    CHECK(!objDocument.Parse("[1, 2, x]", strError));
+    CHECK_EQ(strError, std::string("意外的字符（位置 7）"));
+    CHECK(objDocument.Parse("[1]", strError));
+    CHECK_EQ(objDocument.Root()->nChildren, 1u);
+
+    // 第一个完整的值之后的内容被忽略；开头的UTF-8 BOM被跳过
+    CHECK(objDocument.Parse("{\"a\": 1} trailing", strError));
+    CHECK(objDocument.Parse("\xEF\xBB\xBF[true]", strError));
+    CHECK(objDocument.Root()->eType == JsonType::Array);
+}
+
+TEST_CASE(ScalarConversions) {
+    std::string strJson = "[18446744073709551615, 18446744073709551616, -1, 1.5, 1e3, \"42\", \" 42\","
+                          " true, \"True\", \"False\", \"yes\", null, \"\"]";
+    JsonDocument objDocument;
+    std::string strError;
+    REQUIRE(objDocument.Parse(strJson, strError));
+    std::vector<const JsonValue*> vecItems;
+    for (const JsonValue* pItem = objDocument.Root()->pFirstChild; pItem; pItem = pItem->pNext) {
+        vecItems.push_back(pItem);
+    }
+    REQUIRE(vecItems.size() == 13);
+
+    uint64_t ui64Value = 7;
+    CHECK(vecItems[0]->AsUInt64(ui64Value) && ui64Value == 18446744073709551615ULL);
+    CHECK(!vecItems[1]->AsUInt64(ui64Value));                  // 溢出
+    CHECK(!vecItems[2]->AsUInt64(ui64Value));                  // 负数
+    CHECK(!vecItems[3]->AsUInt64(ui64Value));                  // 小数
+    CHECK(!vecItems[4]->AsUInt64(ui64Value));                  // 指数形式
+    CHECK(vecItems[5]->AsUInt64(ui64Value) && ui64Value == 42);  // 内容为整数的字符串
+    CHECK(!vecItems[6]->AsUInt64(ui64Value));
+    CHECK(!vecItems[11]->AsUInt64(ui64Value));
+
+    bool bValue = false;
+    CHECK(vecItems[7]->AsBool(bValue) && bValue);
+    CHECK(vecItems[8]->AsBool(bValue) && bValue);               // PowerShell的"True"
+    CHECK(vecItems[9]->AsBool(bValue) && !bValue);
+    CHECK(!vecItems[10]->AsBool(bValue));
+    CHECK(!vecItems[0]->AsBool(bValue));
+
+    CHECK_EQ(vecItems[3]->AsString(), std::string("1.5"));     // 数字和布尔值返回源文本
+    CHECK_EQ(vecItems[7]->AsString(), std::string("true"));
+    CHECK(vecItems[11]->AsString().empty());
+    CHECK(vecItems[12]->AsString().empty());
+}
+
+TEST_CASE(MapListHandlesSingleObjectAndArray) {
+    // 1. ConvertTo-Json只有一个结果时输出对象（缩进格式，冒号后两个空格）
+    std::string strSingle =
+        "{\r\n    \"Name\":  \"\xE6\xB5\x8B\xE8\xAF\x95 VM\",\r\n    \"State\":  \"Running\",\r\n"
+        "    \"GpuStatus\":  \"On\",\r\n    \"VRAM\":  1000000000,\r\n"
+        "    \"InstancePath\":  \"\\\\\\\\?\\\\PCI#VEN_10DE&DEV_28E1#{1234}\",\r\n"
+        "    \"Extra\":  { \"Name\": \"nested\" }\r\n}";
+    JsonDocument objDocument;
+    std::string strError;
+    REQUIRE(objDocument.Parse(strSingle, strError));
+    std::vector<VMInfo> vecVMs;
+    objDocument.MapList(vecVMs);
+    REQUIRE(vecVMs.size() == 1);
+    CHECK_EQ(vecVMs[0].strName, std::string("\xE6\xB5\x8B\xE8\xAF\x95 VM"));
+    CHECK_EQ(vecVMs[0].strState, std::string("Running"));
+    CHECK_EQ(vecVMs[0].strGPUStatus, std::string("On"));
+    CHECK_EQ(vecVMs[0].ui64VramBytes, uint64_t(1000000000));
+    CHECK_EQ(vecVMs[0].strGPUInstancePath, std::string("\\\\?\\PCI#VEN_10DE&DEV_28E1#{1234}"));
+
+    // 2. 多个结果时输出数组；非对象元素被跳过，结果追加到已有元素之后
+    std::string strArray =
+        "[{\"Name\": \"A\", \"VRAM\": null, \"State\": \"Off\"}, 5, null,"
+        " {\"Name\": \"B\", \"VRAM\": \"2048\", \"GpuStatus\": [\"On\"]}, {\"VRAM\": -3}]";
+    REQUIRE(objDocument.Parse(strArray, strError));
+    objDocument.MapList(vecVMs);
+    REQUIRE(vecVMs.size() == 4);
+    CHECK_EQ(vecVMs[0].strName, std::string("\xE6\xB5\x8B\xE8\xAF\x95 VM"));
+    CHECK_EQ(vecVMs[1].strName, std::string("A"));
+    CHECK_EQ(vecVMs[1].ui64VramBytes, uint64_t(0));
+    CHECK_EQ(vecVMs[2].strName, std::string("B"));
+    CHECK_EQ(vecVMs[2].ui64VramBytes, uint64_t(2048));
+    CHECK(vecVMs[2].strGPUStatus.empty());                      // 数组值映射到字符串为空
+    CHECK(vecVMs[3].strName.empty());
+    CHECK_EQ(vecVMs[3].ui64VramBytes, uint64_t(0));
+
+    // 3. 空数组和标量根不产生元素；未解析的文档不做任何事
+    std::vector<VMInfo> vecNone;
+    REQUIRE(objDocument.Parse("[]", strError));
+    objDocument.MapList(vecNone);
+    REQUIRE(objDocument.Parse("\"text\"", strError));
+    objDocument.MapList(vecNone);
+    JsonDocument objEmpty;
+    objEmpty.MapList(vecNone);
+    CHECK(vecNone.empty());
+
+    // 4. 布尔字段、重复的键取最后一个，MapObject对非对象不做任何事
+    REQUIRE(objDocument.Parse("{\"Path\": \"p\", \"Cache\": \"True\", \"Vram\": 1, \"Vram\": 9}", strError));
+    JsonTestAdapter stcAdapter;
+    JsonDocument::MapObject(*objDocument.Root(), stcAdapter);
+    CHECK_EQ(stcAdapter.strPath, std::string("p"));
+    CHECK(stcAdapter.bCache);
+    CHECK_EQ(stcAdapter.ui64Vram, uint64_t(9));
+    REQUIRE(objDocument.Parse("{\"Cache\": 1}", strError));
+    JsonDocument::MapObject(*objDocument.Root(), stcAdapter);
+    CHECK(!stcAdapter.bCache);                                  // 无法转换时取默认值
+    REQUIRE(objDocument.Parse("[{\"Path\": \"q\"}]", strError));
+    JsonDocument::MapObject(*objDocument.Root(), stcAdapter);
+    CHECK_EQ(stcAdapter.strPath, std::string("p"));
+}
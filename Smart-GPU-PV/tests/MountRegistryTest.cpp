@@ -0,0 +1,165 @@
+﻿/********************************************************************************
+* 文件名称：MountRegistryTest.cpp
+* 文件功能：验证挂载点注册表：分配、查找和释放，删除失败的挂载点保持跟踪并在
+*           下次分配时重试，所有者进程识别，以及启动时的残留清理
+*
+* 说明：
+*    非Windows平台上挂载点是普通目录；在目录中放一个文件即可模拟删除失败
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/MountRegistry.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// 写入所有者文件（与Acquire的格式相同）
+static void WriteOwner(const std::filesystem::path& path, uint64_t ui64ProcessId, uint64_t ui64Started) {
+    std::ofstream(path, std::ios::binary) << ui64ProcessId << " " << ui64Started << " Test\n";
+}
+
+// 读取所有者文件中的进程号和进程创建时间
+static bool ReadOwner(const std::string& strPath, uint64_t& ui64ProcessId, uint64_t& ui64Started) {
+    std::ifstream objFile(strPath, std::ios::binary);
+    return static_cast<bool>(objFile >> ui64ProcessId >> ui64Started);
+}
+
+// 不存在的进程号
+static const uint64_t DEAD_PROCESS_ID = 0x7FFFFFF0;
+
+TEST_CASE(AcquireFindReleaseRoundTrip) {
+    TestHarness::TempDir objDir;
+    MountRegistry objRegistry(objDir.File("mounts"));
+    CHECK_EQ(objRegistry.Root(), objDir.File("mounts"));
+
+    // 1. 分配：目录为空，所有者文件已写入
+    std::string strPath, strError;
+    REQUIRE(objRegistry.Acquire("Win 11/Dev", strPath, strError));
+    CHECK(std::filesystem::is_directory(strPath));
+    CHECK(std::filesystem::is_empty(strPath));
+    CHECK(std::filesystem::exists(strPath + ".owner"));
+    CHECK(std::filesystem::path(strPath).filename().string().rfind("Win_11_Dev-", 0) == 0);
+    CHECK_EQ(objRegistry.Find("Win 11/Dev"), strPath);
+    CHECK_EQ(objRegistry.Find("Other"), std::string());
+
+    // 2. 同一虚拟机不能同时挂载两次，其他虚拟机分配不同的目录
+    std::string strSecond;
+    CHECK(!objRegistry.Acquire("Win 11/Dev", strSecond, strError));
+    CHECK(strError.find(strPath) != std::string::npos);
+    REQUIRE(objRegistry.Acquire("Other", strSecond, strError));
+    CHECK(strSecond != strPath);
+
+    // 3. 释放：目录和所有者文件都删除，不是本实例分配的路径返回失败
+    CHECK(objRegistry.Release(strPath, strError));
+    CHECK(!std::filesystem::exists(strPath));
+    CHECK(!std::filesystem::exists(strPath + ".owner"));
+    CHECK_EQ(objRegistry.Find("Win 11/Dev"), std::string());
+    CHECK(!objRegistry.Release(strPath, strError));
+    CHECK(objRegistry.Release(strSecond, strError));
+}
+
+TEST_CASE(FailedReleaseStaysTracked) {
+    TestHarness::TempDir objDir;
+    MountRegistry objRegistry(objDir.File("mounts"));
+    std::string strPath, strError;
+    REQUIRE(objRegistry.Acquire("Win11", strPath, strError));
+
+    // 1. 目录不为空时删除失败：记录和所有者文件保留，可以再次释放
+    std::filesystem::path pathBlocker = std::filesystem::path(strPath) / "busy";
+    std::ofstream(pathBlocker) << "x";
+    CHECK(!objRegistry.Release(strPath, strError));
+    CHECK(!strError.empty());
+    CHECK_EQ(objRegistry.Find("Win11"), strPath);
+    CHECK(std::filesystem::exists(strPath + ".owner"));
+    CHECK(MountRegistry::IsOwnerAlive(strPath + ".owner"));
+    CHECK(!objRegistry.Release(strPath, strError));
+    CHECK_EQ(objRegistry.Find("Win11"), strPath);
+
+    // 2. 仍无法删除时同一虚拟机不能分配新的挂载点
+    std::string strNext;
+    CHECK(!objRegistry.Acquire("Win11", strNext, strError));
+    CHECK(strError.find(strPath) != std::string::npos);
+
+    // 3. 可以删除后，分配先删除上次的目录和所有者文件，再分配新目录
+    std::filesystem::remove(pathBlocker);
+    REQUIRE(objRegistry.Acquire("Win11", strNext, strError));
+    CHECK(strNext != strPath);
+    CHECK(!std::filesystem::exists(strPath));
+    CHECK(!std::filesystem::exists(strPath + ".owner"));
+    CHECK_EQ(objRegistry.Find("Win11"), strNext);
+
+    // 4. 正在使用的挂载点（未请求释放）不会被分配重试删除
+    CHECK(!objRegistry.Acquire("Win11", strPath, strError));
+    CHECK(std::filesystem::is_directory(strNext));
+    CHECK(objRegistry.Release(strNext, strError));
+}
+
+TEST_CASE(OwnerAliveRequiresMatchingStartTime) {
+    TestHarness::TempDir objDir;
+    MountRegistry objRegistry(objDir.File("mounts"));
+    std::string strPath, strError;
+    REQUIRE(objRegistry.Acquire("Win11", strPath, strError));
+    uint64_t ui64ProcessId = 0, ui64Started = 0;
+    REQUIRE(ReadOwner(strPath + ".owner", ui64ProcessId, ui64Started));
+
+    // 本进程写入的所有者文件：进程在运行
+    CHECK(MountRegistry::IsOwnerAlive(strPath + ".owner"));
+
+    // 进程号相同但创建时间不同（进程号被复用）、进程不存在：已退出
+    WriteOwner(objDir.Path() / "reused.owner", ui64ProcessId, ui64Started + 1);
+    CHECK(!MountRegistry::IsOwnerAlive(objDir.File("reused.owner")));
+    WriteOwner(objDir.Path() / "dead.owner", DEAD_PROCESS_ID, ui64Started);
+    CHECK(!MountRegistry::IsOwnerAlive(objDir.File("dead.owner")));
+
+    // 格式错误或文件不存在：视为已退出
+    std::ofstream(objDir.Path() / "bad.owner") << "not a process\n";
+    CHECK(!MountRegistry::IsOwnerAlive(objDir.File("bad.owner")));
+    CHECK(!MountRegistry::IsOwnerAlive(objDir.File("missing.owner")));
+    CHECK(objRegistry.Release(strPath, strError));
+}
+
+TEST_CASE(CleanupStaleKeepsLiveOwners) {
+    TestHarness::TempDir objDir;
+    std::filesystem::path pathRoot = objDir.Path() / "mounts";
+    MountRegistry objRunning(pathRoot.string());
+    std::string strLive, strError;
+    REQUIRE(objRunning.Acquire("Live", strLive, strError));
+    std::ifstream objOwner(strLive + ".owner", std::ios::binary);
+    std::stringstream objLiveOwner;
+    objLiveOwner << objOwner.rdbuf();
+
+    // 1. 上次异常退出的残留：所有者已退出的目录、没有所有者文件的目录、
+    //    创建目录前中断留下的所有者文件；以及正在创建目录的运行中实例
+    std::filesystem::create_directory(pathRoot / "Dead-1-0");
+    WriteOwner(pathRoot / "Dead-1-0.owner", DEAD_PROCESS_ID, 1);
+    std::filesystem::create_directory(pathRoot / "Orphan-1-0");
+    WriteOwner(pathRoot / "Gone-1-0.owner", DEAD_PROCESS_ID, 1);
+    std::ofstream(pathRoot / "Pending-1-0.owner", std::ios::binary) << objLiveOwner.str();
+    std::filesystem::create_directory(pathRoot / "Busy-1-0");
+    std::ofstream(pathRoot / "Busy-1-0" / "busy") << "x";
+
+    // 2. 另一个实例启动时清理：只删除所有者已退出且能删除的目录
+    MountRegistry objStarting(pathRoot.string());
+    size_t nRemoved = 0;
+    objStarting.CleanupStale(nRemoved);
+    CHECK_EQ(nRemoved, size_t(2));
+    CHECK(!std::filesystem::exists(pathRoot / "Dead-1-0"));
+    CHECK(!std::filesystem::exists(pathRoot / "Dead-1-0.owner"));
+    CHECK(!std::filesystem::exists(pathRoot / "Orphan-1-0"));
+    CHECK(!std::filesystem::exists(pathRoot / "Gone-1-0.owner"));
+    CHECK(std::filesystem::exists(pathRoot / "Pending-1-0.owner"));
+    CHECK(std::filesystem::exists(pathRoot / "Busy-1-0"));
+    CHECK(std::filesystem::is_directory(strLive));
+    CHECK(std::filesystem::exists(strLive + ".owner"));
+
+    // 3. 运行中的实例仍能正常释放；空的工作目录不报错
+    CHECK(objRunning.Release(strLive, strError));
+    MountRegistry objEmpty(objDir.File("none"));
+    objEmpty.CleanupStale(nRemoved);
+    CHECK_EQ(nRemoved, size_t(0));
+}
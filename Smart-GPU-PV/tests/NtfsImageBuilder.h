@@ -0,0 +1,930 @@
+﻿/********************************************************************************
+* 文件名称：NtfsImageBuilder.h
+* 文件功能：测试用的NTFS卷生成器，在内存中从零写出NtfsVolume和NtfsWriter能打开的卷
+*
+* 类说明：
+*    测试环境中没有mkntfs，这里按NTFS 3.1的磁盘格式直接排布一个最小的卷：
+*    - 引导扇区（簇大小可选512~4096字节，MFT记录1KB，索引块4KB）和末尾的备份
+*    - 元数据记录0~11：$MFT（含$BITMAP）、$MFTMirr、$LogFile（全为0xFF，
+*      即已重置的日志）、$Volume（3.1版，标志为0）、根目录、$Bitmap、$UpCase
+*      （除ASCII外也映射Latin-1字母，用于验证比较使用的是卷上的表）等
+*    - 用户记录从24开始，簇按顺序分配，也可以由测试指定运行列表
+*    目录索引在Build时生成：项能放进记录时只用索引根，否则自底向上装入
+*    INDX块，分隔项放不进索引根时再加一层，得到多层的B+树。
+*    文件可以是常驻的、按指定运行（含稀疏运行、已初始化大小小于数据大小）
+*    存放的、LZNT1压缩的，或者$DATA分成多个片段、除第一个片段外都放在扩展
+*    记录中（通过$ATTRIBUTE_LIST找到）的。
+*
+*    tools/gen_ntfs_fixture.py可以在装有mkntfs和ntfs-3g的机器上生成真实的
+*    卷，作为这个生成器之外的补充验证（测试不依赖它）。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "../Smart-GPU-PV/BlockDevice.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/********************************************************************************
+* 类名称：内存块设备
+* 类功能：在内存缓冲区上实现BlockDevice，记录刷新次数
+*********************************************************************************/
+class MemoryBlockDevice : public BlockDevice {
+public:
+    explicit MemoryBlockDevice(std::vector<uint8_t> vecData, bool bReadOnly = false)
+        : m_vecData(std::move(vecData)), m_bReadOnly(bReadOnly) {}
+
+    uint64_t Size() const override { return m_vecData.size(); }
+    uint32_t SectorSize() const override { return 512; }
+    bool IsReadOnly() const override { return m_bReadOnly; }
+
+    bool Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) override {
+        std::lock_guard<std::mutex> objLock(m_mtxData);
+        if (ui64Offset > m_vecData.size() || nBytes > m_vecData.size() - ui64Offset) {
+            strError = "读取超出设备范围";
+            return false;
+        }
+        memcpy(pBuffer, m_vecData.data() + ui64Offset, nBytes);
+        return true;
+    }
+
+    bool Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) override {
+        std::lock_guard<std::mutex> objLock(m_mtxData);
+        if (m_bReadOnly || ui64Offset > m_vecData.size() || nBytes > m_vecData.size() - ui64Offset) {
+            strError = m_bReadOnly ? "设备只读" : "写入超出设备范围";
+            return false;
+        }
+        memcpy(m_vecData.data() + ui64Offset, pBuffer, nBytes);
+        return true;
+    }
+
+    bool Flush(std::string&) override {
+        std::lock_guard<std::mutex> objLock(m_mtxData);
+        m_nFlushes++;
+        return true;
+    }
+
+    std::vector<uint8_t> Data() const {
+        std::lock_guard<std::mutex> objLock(m_mtxData);
+        return m_vecData;
+    }
+
+    size_t Flushes() const {
+        std::lock_guard<std::mutex> objLock(m_mtxData);
+        return m_nFlushes;
+    }
+
+private:
+    mutable std::mutex   m_mtxData;
+    std::vector<uint8_t> m_vecData;
+    bool                 m_bReadOnly;
+    size_t               m_nFlushes = 0;
+};
+
+/********************************************************************************
+* 类名称：NTFS卷生成器
+*
+* 调用示例：
+*    NtfsImageBuilder objBuilder;
+*    uint64_t ui64Dir = objBuilder.AddDirectory(NtfsImageBuilder::ROOT, u"Drivers");
+*    objBuilder.AddFile(ui64Dir, u"a.sys", vecData);
+*    MemoryBlockDevice objDevice(objBuilder.Build());
+*********************************************************************************/
+class NtfsImageBuilder {
+public:
+    static constexpr uint64_t SPARSE = ~0ULL;
+    static constexpr uint64_t ROOT = 5;
+    static constexpr uint64_t FIRST_USER_RECORD = 24;
+    static constexpr uint32_t RECORD_SIZE = 1024;
+    static constexpr uint32_t INDEX_BLOCK_SIZE = 4096;
+    static constexpr uint32_t COMPRESSION_UNIT = 16;          // 压缩单元的簇数
+    static constexpr uint64_t FILE_TIME = 132000000000000000ULL;
+    static constexpr uint64_t MB = 1024 * 1024;
+
+    // 一个运行：起始LCN（SPARSE表示稀疏）和簇数
+    struct Run {
+        uint64_t ui64Lcn;
+        uint64_t ui64Length;
+    };
+
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  uint64_t ui64VolumeSize：卷大小（字节）
+    *    [IN]  uint32_t ui32ClusterSize：簇大小（512~4096）
+    *    [IN]  uint32_t ui32MftRecords：$MFT的记录数
+    *********************************************************************************/
+    explicit NtfsImageBuilder(uint64_t ui64VolumeSize = 16 * MB, uint32_t ui32ClusterSize = 4096,
+                              uint32_t ui32MftRecords = 128)
+        : m_ui32ClusterSize(ui32ClusterSize), m_ui32MftRecords(ui32MftRecords),
+          m_vecImage(static_cast<size_t>(ui64VolumeSize), 0) {
+        m_ui64TotalSectors = ui64VolumeSize / 512 - 1;      // 最后一个扇区是备份引导扇区
+        m_ui64TotalClusters = m_ui64TotalSectors / (ui32ClusterSize / 512);
+        m_vecClusterBits.assign(static_cast<size_t>(Align8((m_ui64TotalClusters + 7) / 8)), 0);
+        for (uint64_t i = 0; i < 65536; i++) m_vecUpcase.push_back(static_cast<char16_t>(i));
+        for (char16_t ch = u'a'; ch <= u'z'; ch++) m_vecUpcase[ch] = static_cast<char16_t>(ch - 0x20);
+        for (char16_t ch = 0xE0; ch <= 0xFE; ch++) {
+            if (ch != 0xF7) m_vecUpcase[ch] = static_cast<char16_t>(ch - 0x20);
+        }
+
+        // 元数据的簇：引导区（8KB）、$MFT、$MFTMirr、$LogFile、$Bitmap、$MFT的位图、$UpCase
+        m_ui64BootLcn = Allocate(Clusters(8192));
+        m_ui64MftLcn = Allocate(Clusters(static_cast<uint64_t>(ui32MftRecords) * RECORD_SIZE));
+        m_ui64MirrorLcn = Allocate(Clusters(4 * RECORD_SIZE));
+        m_ui64LogLcn = Allocate(Clusters(64 * 1024));
+        m_ui64BitmapLcn = Allocate(Clusters(m_vecClusterBits.size()));
+        m_ui64MftBitmapLcn = Allocate(Clusters(4096));
+        m_ui64UpcaseLcn = Allocate(Clusters(65536 * 2));
+        memset(&m_vecImage[static_cast<size_t>(m_ui64LogLcn * ui32ClusterSize)], 0xFF, 64 * 1024);
+        for (size_t i = 0; i < 65536; i++) {
+            Put16(&m_vecImage[static_cast<size_t>(m_ui64UpcaseLcn * ui32ClusterSize + 2 * i)], m_vecUpcase[i]);
+        }
+
+        static const char16_t* const pszNames[12] = { u"$MFT", u"$MFTMirr", u"$LogFile", u"$Volume", u"$AttrDef",
+            u".", u"$Bitmap", u"$Boot", u"$BadClus", u"$Secure", u"$UpCase", u"$Extend" };
+        for (uint64_t i = 0; i < 12; i++) {
+            AddNode(i, ROOT, pszNames[i], i == ROOT);
+        }
+        uint64_t ui64MftBytes = static_cast<uint64_t>(ui32MftRecords) * RECORD_SIZE;
+        SetData(0, NonResident(0x80, u"", { { m_ui64MftLcn, Clusters(ui64MftBytes) } }, ui64MftBytes, ui64MftBytes));
+        m_mapNodes[0].vecAttributes.push_back(NonResident(0xB0, u"", { { m_ui64MftBitmapLcn, Clusters(4096) } },
+            Align8((ui32MftRecords + 7) / 8), Align8((ui32MftRecords + 7) / 8)));
+        SetData(1, NonResident(0x80, u"", { { m_ui64MirrorLcn, Clusters(4 * RECORD_SIZE) } }, 4 * RECORD_SIZE,
+                               4 * RECORD_SIZE));
+        SetData(2, NonResident(0x80, u"", { { m_ui64LogLcn, Clusters(64 * 1024) } }, 64 * 1024, 64 * 1024));
+        SetData(6, NonResident(0x80, u"", { { m_ui64BitmapLcn, Clusters(m_vecClusterBits.size()) } },
+                               m_vecClusterBits.size(), m_vecClusterBits.size()));
+        SetData(7, NonResident(0x80, u"", { { m_ui64BootLcn, Clusters(8192) } }, 8192, 8192));
+        SetData(10, NonResident(0x80, u"", { { m_ui64UpcaseLcn, Clusters(65536 * 2) } }, 65536 * 2, 65536 * 2));
+        std::vector<uint8_t> vecVolumeInfo(12, 0);
+        vecVolumeInfo[8] = 3;
+        vecVolumeInfo[9] = 1;
+        m_mapNodes[3].vecAttributes.push_back(Resident(0x70, u"", vecVolumeInfo));
+        for (uint64_t i : { 4, 8, 9, 11 }) SetData(i, Resident(0x80, u"", {}));
+    }
+
+    uint32_t ClusterSize() const { return m_ui32ClusterSize; }
+    uint64_t TotalClusters() const { return m_ui64TotalClusters; }
+
+    // 记录在生成的镜像中的偏移（$MFT是连续的）
+    uint64_t RecordOffset(uint64_t ui64Record) const {
+        return m_ui64MftLcn * m_ui32ClusterSize + ui64Record * RECORD_SIZE;
+    }
+
+    // 设置$Volume中的卷标志（如0x0001表示需要检查）
+    void SetVolumeFlags(uint16_t ui16Flags) { m_ui16VolumeFlags = ui16Flags; }
+
+    // 目录的索引块所在的簇（Build之后有效，没有索引块时长度为0）
+    Run IndexAllocation(uint64_t ui64Directory) const {
+        auto it = m_mapIndexAllocations.find(ui64Directory);
+        return it == m_mapIndexAllocations.end() ? Run{ SPARSE, 0 } : it->second;
+    }
+
+    // 分配连续的簇（跳过已使用的簇），返回起始LCN
+    uint64_t Allocate(uint64_t ui64Count) {
+        for (uint64_t ui64Lcn = m_ui64NextLcn; ui64Lcn + ui64Count <= m_ui64TotalClusters; ui64Lcn++) {
+            uint64_t i = 0;
+            while (i < ui64Count && !IsUsed(ui64Lcn + i)) i++;
+            if (i == ui64Count) {
+                MarkUsed(ui64Lcn, ui64Count);
+                m_ui64NextLcn = ui64Lcn + ui64Count;
+                return ui64Lcn;
+            }
+            ui64Lcn += i;
+        }
+        throw std::length_error("NtfsImageBuilder：卷空间不足");
+    }
+
+    /********************************************************************************
+    * 函数名称：添加目录
+    * 返回类型：uint64_t
+    *    目录的记录号
+    *********************************************************************************/
+    uint64_t AddDirectory(uint64_t ui64Parent, const std::u16string& strName) {
+        uint64_t ui64Record = NewRecord();
+        AddNode(ui64Record, ui64Parent, strName, true);
+        return ui64Record;
+    }
+
+    /********************************************************************************
+    * 函数名称：添加文件
+    * 说明：不超过256字节的数据为常驻属性，否则分配连续的簇
+    *********************************************************************************/
+    uint64_t AddFile(uint64_t ui64Parent, const std::u16string& strName, const std::vector<uint8_t>& vecData) {
+        if (vecData.size() <= 256) {
+            uint64_t ui64Record = NewRecord();
+            AddNode(ui64Record, ui64Parent, strName, false);
+            SetData(ui64Record, Resident(0x80, u"", vecData));
+            return ui64Record;
+        }
+        uint64_t ui64Clusters = Clusters(vecData.size());
+        return AddRunsFile(ui64Parent, strName, vecData, { { Allocate(ui64Clusters), ui64Clusters } }, vecData.size());
+    }
+
+    /********************************************************************************
+    * 函数名称：按指定的运行列表添加文件
+    * 函数参数：
+    *    [IN]  const std::vector<Run>& vecRuns：运行（按VCN顺序），稀疏运行对应的数据应为0
+    *    [IN]  uint64_t ui64InitializedSize：已初始化大小（默认等于数据大小）；
+    *          之后的簇填入非0字节，读出时应为0
+    *********************************************************************************/
+    uint64_t AddFileWithRuns(uint64_t ui64Parent, const std::u16string& strName, const std::vector<uint8_t>& vecData,
+                             const std::vector<Run>& vecRuns, uint64_t ui64InitializedSize = ~0ULL) {
+        Claim(vecRuns);
+        return AddRunsFile(ui64Parent, strName, vecData, vecRuns, std::min<uint64_t>(ui64InitializedSize, vecData.size()));
+    }
+
+    /********************************************************************************
+    * 函数名称：添加LZNT1压缩的文件
+    * 说明：每个压缩单元（16簇）：全为0时稀疏；压缩后能少占至少一个簇时写入
+    *       压缩数据，其余簇稀疏；否则原样存放（单元全部分配）
+    *    pRuns返回生成的运行列表
+    *********************************************************************************/
+    uint64_t AddCompressedFile(uint64_t ui64Parent, const std::u16string& strName, const std::vector<uint8_t>& vecData,
+                               std::vector<Run>* pRuns = nullptr) {
+        const uint64_t ui64UnitBytes = static_cast<uint64_t>(COMPRESSION_UNIT) * m_ui32ClusterSize;
+        std::vector<Run> vecRuns;
+        uint64_t ui64Compressed = 0;
+        auto AddSparse = [&](uint64_t ui64Count) {
+            if (!vecRuns.empty() && vecRuns.back().ui64Lcn == SPARSE) vecRuns.back().ui64Length += ui64Count;
+            else vecRuns.push_back({ SPARSE, ui64Count });
+        };
+        for (uint64_t ui64Offset = 0; ui64Offset < vecData.size(); ui64Offset += ui64UnitBytes) {
+            size_t nBytes = static_cast<size_t>(std::min<uint64_t>(ui64UnitBytes, vecData.size() - ui64Offset));
+            const uint8_t* pUnit = vecData.data() + ui64Offset;
+            if (std::all_of(pUnit, pUnit + nBytes, [](uint8_t b) { return b == 0; })) {
+                AddSparse(COMPRESSION_UNIT);
+                continue;
+            }
+            std::vector<uint8_t> vecPacked = Lznt1Compress(pUnit, nBytes);
+            uint64_t ui64Clusters = Clusters(vecPacked.size());
+            if (ui64Clusters >= COMPRESSION_UNIT) {
+                vecPacked.assign(pUnit, pUnit + nBytes);
+                ui64Clusters = COMPRESSION_UNIT;
+            }
+            uint64_t ui64Lcn = Allocate(ui64Clusters);
+            memcpy(&m_vecImage[static_cast<size_t>(ui64Lcn * m_ui32ClusterSize)], vecPacked.data(), vecPacked.size());
+            vecRuns.push_back({ ui64Lcn, ui64Clusters });
+            ui64Compressed += ui64Clusters * m_ui32ClusterSize;
+            if (ui64Clusters < COMPRESSION_UNIT) AddSparse(COMPRESSION_UNIT - ui64Clusters);
+        }
+
+        uint64_t ui64Record = NewRecord();
+        AddNode(ui64Record, ui64Parent, strName, false);
+        std::vector<uint8_t> vecAttr = NonResident(0x80, u"", vecRuns, vecData.size(), vecData.size(), 0x48);
+        Put16(&vecAttr[0x0C], 0x0001);
+        Put16(&vecAttr[0x22], 4);
+        Put64(&vecAttr[0x40], ui64Compressed);
+        SetData(ui64Record, vecAttr);
+        Put32(&m_mapNodes[ui64Record].vecStandardInformation[0x20], 0x00000800);
+        if (pRuns) *pRuns = vecRuns;
+        return ui64Record;
+    }
+
+    /********************************************************************************
+    * 函数名称：添加$DATA分为多个片段的文件
+    * 函数参数：
+    *    [IN]  const std::vector<std::vector<Run>>& vecExtents：各片段的运行；第一个
+    *          片段在基本记录中，其余片段放在一个扩展记录中，基本记录带$ATTRIBUTE_LIST
+    *    [OUT] uint64_t* pExtension：扩展记录号
+    *********************************************************************************/
+    uint64_t AddFileWithAttributeList(uint64_t ui64Parent, const std::u16string& strName,
+                                      const std::vector<uint8_t>& vecData,
+                                      const std::vector<std::vector<Run>>& vecExtents, uint64_t* pExtension = nullptr) {
+        uint64_t ui64Record = NewRecord();
+        uint64_t ui64Extension = NewRecord();
+        AddNode(ui64Record, ui64Parent, strName, false);
+        Node& objNode = m_mapNodes[ui64Record];
+        objNode.ui64Extension = ui64Extension;
+
+        std::vector<Run> vecAll;
+        for (const std::vector<Run>& vecRuns : vecExtents) vecAll.insert(vecAll.end(), vecRuns.begin(), vecRuns.end());
+        Claim(vecAll);
+        WriteRuns(vecAll, vecData, vecData.size());
+        uint64_t ui64Vcn = 0;
+        for (size_t i = 0; i < vecExtents.size(); i++) {
+            std::vector<uint8_t> vecAttr = NonResident(0x80, u"", vecExtents[i], vecData.size(), vecData.size());
+            uint64_t ui64Clusters = 0;
+            for (const Run& stcRun : vecExtents[i]) ui64Clusters += stcRun.ui64Length;
+            Put64(&vecAttr[0x10], ui64Vcn);
+            Put64(&vecAttr[0x18], ui64Vcn + ui64Clusters - 1);
+            if (i > 0) {
+                memset(&vecAttr[0x28], 0, 0x18);        // 后续片段不含大小
+                Put16(&vecAttr[0x0E], static_cast<uint16_t>(i - 1));
+                objNode.vecExtensionAttributes.push_back(vecAttr);
+            } else {
+                objNode.vecAttributes.push_back(vecAttr);
+            }
+            ui64Vcn += ui64Clusters;
+        }
+        objNode.ui64Allocated = ui64Vcn * m_ui32ClusterSize;
+        objNode.ui64Size = vecData.size();
+        if (pExtension) *pExtension = ui64Extension;
+        return ui64Record;
+    }
+
+    /********************************************************************************
+    * 函数名称：生成卷
+    * 返回类型：std::vector<uint8_t>
+    *    卷的全部字节（只能调用一次）
+    *********************************************************************************/
+    std::vector<uint8_t> Build() {
+        // 1. 目录索引（可能分配索引块的簇，必须在写$Bitmap之前）
+        for (auto& pairNode : m_mapNodes) {
+            if (pairNode.second.bDirectory) BuildIndex(pairNode.first, pairNode.second);
+        }
+
+        // 2. 记录：SI、FN之外的属性已经准备好，补上属性列表后按类型排序
+        for (std::vector<uint8_t>& vecAttr : m_mapNodes[3].vecAttributes) {
+            if (vecAttr[0] == 0x70) Put16(&vecAttr[0x18 + 0x0A], m_ui16VolumeFlags);
+        }
+        for (uint64_t i = 0; i < m_ui32MftRecords; i++) {
+            std::vector<uint8_t> vecRecord(RECORD_SIZE, 0);
+            auto it = m_mapNodes.find(i);
+            uint64_t ui64Base = 0;
+            if (it != m_mapNodes.end()) {
+                ComposeNode(it->first, it->second, vecRecord);
+            } else if (IsExtension(i, ui64Base)) {
+                ComposeRecord(i, m_mapNodes[ui64Base].vecExtensionAttributes, 0x0001, ui64Base | (1ULL << 48), vecRecord);
+            } else {
+                ComposeRecord(i, {}, 0, 0, vecRecord);
+            }
+            Protect(vecRecord.data(), RECORD_SIZE);
+            memcpy(&m_vecImage[static_cast<size_t>(RecordOffset(i))], vecRecord.data(), RECORD_SIZE);
+        }
+        memcpy(&m_vecImage[static_cast<size_t>(m_ui64MirrorLcn * m_ui32ClusterSize)],
+               &m_vecImage[static_cast<size_t>(RecordOffset(0))], 4 * RECORD_SIZE);
+
+        // 3. 位图：$MFT的记录位图（0~23保留）和簇位图
+        uint8_t* pMftBits = &m_vecImage[static_cast<size_t>(m_ui64MftBitmapLcn * m_ui32ClusterSize)];
+        for (uint64_t i = 0; i < m_ui64NextRecord; i++) pMftBits[i >> 3] |= static_cast<uint8_t>(1 << (i & 7));
+        memcpy(&m_vecImage[static_cast<size_t>(m_ui64BitmapLcn * m_ui32ClusterSize)], m_vecClusterBits.data(),
+               m_vecClusterBits.size());
+
+        // 4. 引导扇区和备份
+        uint8_t* pBoot = m_vecImage.data();
+        pBoot[0] = 0xEB;
+        pBoot[1] = 0x52;
+        pBoot[2] = 0x90;
+        memcpy(pBoot + 3, "NTFS    ", 8);
+        Put16(pBoot + 0x0B, 512);
+        pBoot[0x0D] = static_cast<uint8_t>(m_ui32ClusterSize / 512);
+        pBoot[0x15] = 0xF8;
+        Put64(pBoot + 0x28, m_ui64TotalSectors);
+        Put64(pBoot + 0x30, m_ui64MftLcn);
+        Put64(pBoot + 0x38, m_ui64MirrorLcn);
+        pBoot[0x40] = 0xF6;                                     // 2^10 = 1024字节
+        pBoot[0x44] = static_cast<uint8_t>(INDEX_BLOCK_SIZE / m_ui32ClusterSize);
+        Put64(pBoot + 0x48, 0x1234567887654321ULL);
+        pBoot[510] = 0x55;
+        pBoot[511] = 0xAA;
+        memcpy(&m_vecImage[static_cast<size_t>(m_ui64TotalSectors * 512)], pBoot, 512);
+        return m_vecImage;
+    }
+
+private:
+    /********************************************************************************
+    * 结构体名称：一个文件或目录
+    *********************************************************************************/
+    struct Node {
+        uint64_t                          ui64Parent = ROOT;
+        std::u16string                    strName;
+        bool                              bDirectory = false;
+        uint64_t                          ui64Size = 0;             // 数据大小（$FILE_NAME中）
+        uint64_t                          ui64Allocated = 0;        // 分配大小（$FILE_NAME中）
+        std::vector<uint8_t>              vecStandardInformation;   // $STANDARD_INFORMATION的值
+        std::vector<std::vector<uint8_t>> vecAttributes;            // 其他属性（实例号在组合记录时分配）
+        uint64_t                          ui64Extension = 0;        // 扩展记录（0表示没有）
+        std::vector<std::vector<uint8_t>> vecExtensionAttributes;   // 扩展记录中的属性（实例号已确定）
+    };
+
+    uint32_t                   m_ui32ClusterSize;
+    uint32_t                   m_ui32MftRecords;
+    std::vector<uint8_t>       m_vecImage;
+    uint64_t                   m_ui64TotalSectors = 0;
+    uint64_t                   m_ui64TotalClusters = 0;
+    std::vector<uint8_t>       m_vecClusterBits;
+    std::vector<char16_t>      m_vecUpcase;
+    uint64_t                   m_ui64NextLcn = 0;
+    uint64_t                   m_ui64NextRecord = FIRST_USER_RECORD;
+    uint16_t                   m_ui16VolumeFlags = 0;
+    uint64_t                   m_ui64BootLcn = 0;
+    uint64_t                   m_ui64MftLcn = 0;
+    uint64_t                   m_ui64MirrorLcn = 0;
+    uint64_t                   m_ui64LogLcn = 0;
+    uint64_t                   m_ui64BitmapLcn = 0;
+    uint64_t                   m_ui64MftBitmapLcn = 0;
+    uint64_t                   m_ui64UpcaseLcn = 0;
+    std::map<uint64_t, Node>   m_mapNodes;
+    std::map<uint64_t, Run>    m_mapIndexAllocations;   // 目录 -> 索引块所在的簇
+
+    static void Put16(uint8_t* p, uint16_t v) { memcpy(p, &v, sizeof(v)); }
+    static void Put32(uint8_t* p, uint32_t v) { memcpy(p, &v, sizeof(v)); }
+    static void Put64(uint8_t* p, uint64_t v) { memcpy(p, &v, sizeof(v)); }
+    static uint64_t Align8(uint64_t n) { return (n + 7) & ~7ULL; }
+
+    uint64_t Clusters(uint64_t ui64Bytes) const { return (ui64Bytes + m_ui32ClusterSize - 1) / m_ui32ClusterSize; }
+    bool IsUsed(uint64_t ui64Lcn) const { return (m_vecClusterBits[static_cast<size_t>(ui64Lcn >> 3)] >> (ui64Lcn & 7)) & 1; }
+    void MarkUsed(uint64_t ui64Lcn, uint64_t ui64Count) {
+        for (uint64_t i = ui64Lcn; i < ui64Lcn + ui64Count; i++) {
+            m_vecClusterBits[static_cast<size_t>(i >> 3)] |= static_cast<uint8_t>(1 << (i & 7));
+        }
+    }
+
+    uint64_t NewRecord() {
+        if (m_ui64NextRecord >= m_ui32MftRecords) throw std::length_error("NtfsImageBuilder：MFT记录不足");
+        return m_ui64NextRecord++;
+    }
+
+    bool IsExtension(uint64_t ui64Record, uint64_t& ui64Base) const {
+        for (const auto& pairNode : m_mapNodes) {
+            if (pairNode.second.ui64Extension == ui64Record && ui64Record != 0) {
+                ui64Base = pairNode.first;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void AddNode(uint64_t ui64Record, uint64_t ui64Parent, const std::u16string& strName, bool bDirectory) {
+        Node& objNode = m_mapNodes[ui64Record];
+        objNode.ui64Parent = ui64Parent;
+        objNode.strName = strName;
+        objNode.bDirectory = bDirectory;
+        objNode.vecStandardInformation.assign(0x48, 0);
+        for (int i = 0; i < 4; i++) Put64(&objNode.vecStandardInformation[8 * i], FILE_TIME + ui64Record);
+        if (ui64Record < FIRST_USER_RECORD) Put32(&objNode.vecStandardInformation[0x20], 0x00000006);   // 隐藏、系统
+    }
+
+    // 设置文件的未命名$DATA，同时更新$FILE_NAME中的大小
+    void SetData(uint64_t ui64Record, const std::vector<uint8_t>& vecAttr) {
+        Node& objNode = m_mapNodes[ui64Record];
+        if (vecAttr[8] == 0) {
+            uint32_t ui32Length = 0;
+            memcpy(&ui32Length, &vecAttr[0x10], 4);
+            objNode.ui64Size = ui32Length;
+            objNode.ui64Allocated = Align8(ui32Length);
+        } else {
+            memcpy(&objNode.ui64Allocated, &vecAttr[0x28], 8);
+            memcpy(&objNode.ui64Size, &vecAttr[0x30], 8);
+        }
+        objNode.vecAttributes.push_back(vecAttr);
+    }
+
+    // 调用者指定的运行：簇必须在卷内且未被占用
+    void Claim(const std::vector<Run>& vecRuns) {
+        for (const Run& stcRun : vecRuns) {
+            if (stcRun.ui64Lcn == SPARSE) continue;
+            for (uint64_t i = stcRun.ui64Lcn; i < stcRun.ui64Lcn + stcRun.ui64Length; i++) {
+                if (i >= m_ui64TotalClusters || IsUsed(i)) {
+                    throw std::invalid_argument("NtfsImageBuilder：簇 " + std::to_string(i) + " 已被占用");
+                }
+            }
+            MarkUsed(stcRun.ui64Lcn, stcRun.ui64Length);
+        }
+    }
+
+    uint64_t AddRunsFile(uint64_t ui64Parent, const std::u16string& strName, const std::vector<uint8_t>& vecData,
+                         const std::vector<Run>& vecRuns, uint64_t ui64InitializedSize) {
+        uint64_t ui64Record = NewRecord();
+        AddNode(ui64Record, ui64Parent, strName, false);
+        WriteRuns(vecRuns, vecData, ui64InitializedSize);
+        SetData(ui64Record, NonResident(0x80, u"", vecRuns, vecData.size(), ui64InitializedSize));
+        return ui64Record;
+    }
+
+    // 把数据写入运行指向的簇；已初始化大小之后的部分写入0xA5
+    void WriteRuns(const std::vector<Run>& vecRuns, const std::vector<uint8_t>& vecData, uint64_t ui64Initialized) {
+        uint64_t ui64Offset = 0;
+        for (const Run& stcRun : vecRuns) {
+            if (stcRun.ui64Lcn != SPARSE) {
+                for (uint64_t i = 0; i < stcRun.ui64Length * m_ui32ClusterSize; i++) {
+                    uint64_t ui64Source = ui64Offset + i;
+                    uint8_t ui8Value = ui64Source < ui64Initialized ? vecData[static_cast<size_t>(ui64Source)] :
+                                       ui64Source < vecData.size() ? 0xA5 : 0;
+                    m_vecImage[static_cast<size_t>(stcRun.ui64Lcn * m_ui32ClusterSize + i)] = ui8Value;
+                }
+            }
+            ui64Offset += stcRun.ui64Length * m_ui32ClusterSize;
+        }
+    }
+
+    /********************************************************************************
+    * 函数名称：构造属性（内部辅助）
+    * 说明：实例号暂为0，组合记录时分配；运行列表的偏移用最少的字节数编码
+    *********************************************************************************/
+    static std::vector<uint8_t> Resident(uint32_t ui32Type, const std::u16string& strName,
+                                         const std::vector<uint8_t>& vecValue) {
+        size_t nValueOffset = static_cast<size_t>(Align8(0x18 + strName.size() * 2));
+        std::vector<uint8_t> vecAttr(static_cast<size_t>(Align8(nValueOffset + vecValue.size())), 0);
+        Put32(&vecAttr[0], ui32Type);
+        Put32(&vecAttr[4], static_cast<uint32_t>(vecAttr.size()));
+        vecAttr[9] = static_cast<uint8_t>(strName.size());
+        Put16(&vecAttr[0x0A], 0x18);
+        Put32(&vecAttr[0x10], static_cast<uint32_t>(vecValue.size()));
+        Put16(&vecAttr[0x14], static_cast<uint16_t>(nValueOffset));
+        vecAttr[0x16] = ui32Type == 0x30 ? 1 : 0;
+        if (!strName.empty()) memcpy(&vecAttr[0x18], strName.data(), strName.size() * 2);
+        if (!vecValue.empty()) memcpy(&vecAttr[nValueOffset], vecValue.data(), vecValue.size());
+        return vecAttr;
+    }
+
+    static std::vector<uint8_t> EncodeRuns(const std::vector<Run>& vecRuns) {
+        std::vector<uint8_t> vecBytes;
+        int64_t i64Previous = 0;
+        for (const Run& stcRun : vecRuns) {
+            std::vector<uint8_t> vecLength;
+            for (uint64_t v = stcRun.ui64Length; v != 0; v >>= 8) vecLength.push_back(static_cast<uint8_t>(v));
+            std::vector<uint8_t> vecOffset;
+            if (stcRun.ui64Lcn != SPARSE) {
+                int64_t i64Delta = static_cast<int64_t>(stcRun.ui64Lcn) - i64Previous;
+                i64Previous = static_cast<int64_t>(stcRun.ui64Lcn);
+                // 有符号的最少字节数：剩余部分只是符号扩展时停止
+                while (true) {
+                    vecOffset.push_back(static_cast<uint8_t>(i64Delta & 0xFF));
+                    bool bNegative = (vecOffset.back() & 0x80) != 0;
+                    i64Delta >>= 8;
+                    if ((i64Delta == 0 && !bNegative) || (i64Delta == -1 && bNegative)) break;
+                }
+            }
+            vecBytes.push_back(static_cast<uint8_t>(vecLength.size() | (vecOffset.size() << 4)));
+            vecBytes.insert(vecBytes.end(), vecLength.begin(), vecLength.end());
+            vecBytes.insert(vecBytes.end(), vecOffset.begin(), vecOffset.end());
+        }
+        vecBytes.push_back(0);
+        return vecBytes;
+    }
+
+    std::vector<uint8_t> NonResident(uint32_t ui32Type, const std::u16string& strName, const std::vector<Run>& vecRuns,
+                                     uint64_t ui64DataSize, uint64_t ui64InitializedSize, size_t nHeader = 0x40) const {
+        std::vector<uint8_t> vecRunBytes = EncodeRuns(vecRuns);
+        size_t nRunsOffset = static_cast<size_t>(Align8(nHeader + strName.size() * 2));
+        std::vector<uint8_t> vecAttr(static_cast<size_t>(Align8(nRunsOffset + vecRunBytes.size())), 0);
+        uint64_t ui64Clusters = 0;
+        for (const Run& stcRun : vecRuns) ui64Clusters += stcRun.ui64Length;
+        Put32(&vecAttr[0], ui32Type);
+        Put32(&vecAttr[4], static_cast<uint32_t>(vecAttr.size()));
+        vecAttr[8] = 1;
+        vecAttr[9] = static_cast<uint8_t>(strName.size());
+        Put16(&vecAttr[0x0A], static_cast<uint16_t>(nHeader));
+        Put64(&vecAttr[0x18], ui64Clusters - 1);
+        Put16(&vecAttr[0x20], static_cast<uint16_t>(nRunsOffset));
+        Put64(&vecAttr[0x28], ui64Clusters * m_ui32ClusterSize);
+        Put64(&vecAttr[0x30], ui64DataSize);
+        Put64(&vecAttr[0x38], ui64InitializedSize);
+        if (!strName.empty()) memcpy(&vecAttr[nHeader], strName.data(), strName.size() * 2);
+        memcpy(&vecAttr[nRunsOffset], vecRunBytes.data(), vecRunBytes.size());
+        return vecAttr;
+    }
+
+    // $FILE_NAME的值（也是目录索引的键）
+    std::vector<uint8_t> FileName(uint64_t ui64Record, const Node& objNode) const {
+        std::vector<uint8_t> vecValue(0x42 + objNode.strName.size() * 2, 0);
+        uint32_t ui32Attributes = 0;
+        memcpy(&ui32Attributes, &objNode.vecStandardInformation[0x20], 4);
+        Put64(&vecValue[0], objNode.ui64Parent | (1ULL << 48));
+        for (int i = 1; i <= 4; i++) Put64(&vecValue[8 * i], FILE_TIME + ui64Record);
+        Put64(&vecValue[0x28], objNode.bDirectory ? 0 : objNode.ui64Allocated);
+        Put64(&vecValue[0x30], objNode.bDirectory ? 0 : objNode.ui64Size);
+        Put32(&vecValue[0x38], ui32Attributes | (objNode.bDirectory ? 0x10000000 : 0));
+        vecValue[0x40] = static_cast<uint8_t>(objNode.strName.size());
+        vecValue[0x41] = 1;                                     // Win32命名空间
+        memcpy(&vecValue[0x42], objNode.strName.data(), objNode.strName.size() * 2);
+        return vecValue;
+    }
+
+    // 按$UpCase表比较文件名（与NTFS的排序规则一致）
+    int CompareNames(const std::u16string& strA, const std::u16string& strB) const {
+        for (size_t i = 0; i < strA.size() && i < strB.size(); i++) {
+            char16_t chA = m_vecUpcase[strA[i]];
+            char16_t chB = m_vecUpcase[strB[i]];
+            if (chA != chB) return chA < chB ? -1 : 1;
+        }
+        return strA.size() == strB.size() ? 0 : (strA.size() < strB.size() ? -1 : 1);
+    }
+
+    /********************************************************************************
+    * 函数名称：组合MFT记录（内部辅助）
+    * 说明：属性按类型排序并依次编号；有扩展记录时加入属性列表，列出基本记录和
+    *       扩展记录中的全部属性
+    *********************************************************************************/
+    std::vector<std::vector<uint8_t>> NodeAttributes(uint64_t ui64Record, const Node& objNode) const {
+        std::vector<std::vector<uint8_t>> vecAttributes;
+        vecAttributes.push_back(Resident(0x10, u"", objNode.vecStandardInformation));
+        vecAttributes.push_back(Resident(0x30, u"", FileName(ui64Record, objNode)));
+        vecAttributes.insert(vecAttributes.end(), objNode.vecAttributes.begin(), objNode.vecAttributes.end());
+        std::stable_sort(vecAttributes.begin(), vecAttributes.end(),
+            [](const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) { return a[0] + 256 * a[1] < b[0] + 256 * b[1]; });
+        for (size_t i = 0; i < vecAttributes.size(); i++) Put16(&vecAttributes[i][0x0E], static_cast<uint16_t>(i));
+        if (objNode.ui64Extension == 0) {
+            return vecAttributes;
+        }
+
+        struct ListItem {
+            uint32_t ui32Type;
+            uint64_t ui64Vcn;
+            uint64_t ui64Record;
+            uint16_t ui16Instance;
+        };
+        std::vector<ListItem> vecItems;
+        auto Collect = [&](const std::vector<std::vector<uint8_t>>& vecFrom, uint64_t ui64In) {
+            for (const std::vector<uint8_t>& vecAttr : vecFrom) {
+                ListItem stcItem = { 0, 0, ui64In, 0 };
+                memcpy(&stcItem.ui32Type, &vecAttr[0], 4);
+                if (vecAttr[8] != 0) memcpy(&stcItem.ui64Vcn, &vecAttr[0x10], 8);
+                memcpy(&stcItem.ui16Instance, &vecAttr[0x0E], 2);
+                vecItems.push_back(stcItem);
+            }
+        };
+        Collect(vecAttributes, ui64Record);
+        Collect(objNode.vecExtensionAttributes, objNode.ui64Extension);
+        std::stable_sort(vecItems.begin(), vecItems.end(), [](const ListItem& a, const ListItem& b) {
+            return a.ui32Type != b.ui32Type ? a.ui32Type < b.ui32Type : a.ui64Vcn < b.ui64Vcn;
+        });
+        std::vector<uint8_t> vecList;
+        for (const ListItem& stcItem : vecItems) {
+            size_t nPos = vecList.size();
+            vecList.resize(nPos + 0x20, 0);
+            Put32(&vecList[nPos], stcItem.ui32Type);
+            Put16(&vecList[nPos + 4], 0x20);
+            vecList[nPos + 7] = 0x1A;
+            Put64(&vecList[nPos + 8], stcItem.ui64Vcn);
+            Put64(&vecList[nPos + 0x10], stcItem.ui64Record | (1ULL << 48));
+            Put16(&vecList[nPos + 0x18], stcItem.ui16Instance);
+        }
+        std::vector<uint8_t> vecListAttr = Resident(0x20, u"", vecList);
+        Put16(&vecListAttr[0x0E], static_cast<uint16_t>(vecAttributes.size()));
+        vecAttributes.insert(vecAttributes.begin() + 1, vecListAttr);
+        return vecAttributes;
+    }
+
+    static size_t RecordBytes(const std::vector<std::vector<uint8_t>>& vecAttributes) {
+        size_t nBytes = 0x38 + 8;
+        for (const std::vector<uint8_t>& vecAttr : vecAttributes) nBytes += vecAttr.size();
+        return nBytes;
+    }
+
+    static void ComposeRecord(uint64_t ui64Record, const std::vector<std::vector<uint8_t>>& vecAttributes,
+                              uint16_t ui16Flags, uint64_t ui64BaseReference, std::vector<uint8_t>& vecRecord) {
+        if (RecordBytes(vecAttributes) > RECORD_SIZE) throw std::length_error("NtfsImageBuilder：MFT记录空间不足");
+        uint8_t* p = vecRecord.data();
+        memcpy(p, "FILE", 4);
+        Put16(p + 4, 0x30);
+        Put16(p + 6, RECORD_SIZE / 512 + 1);
+        Put16(p + 0x10, 1);
+        Put16(p + 0x12, (ui16Flags & 0x0001) && ui64BaseReference == 0 ? 1 : 0);
+        Put16(p + 0x14, 0x38);
+        Put16(p + 0x16, ui16Flags);
+        Put32(p + 0x1C, RECORD_SIZE);
+        Put64(p + 0x20, ui64BaseReference);
+        Put32(p + 0x2C, static_cast<uint32_t>(ui64Record));
+        size_t nPos = 0x38;
+        uint16_t ui16NextInstance = 0;
+        for (const std::vector<uint8_t>& vecAttr : vecAttributes) {
+            memcpy(p + nPos, vecAttr.data(), vecAttr.size());
+            nPos += vecAttr.size();
+            uint16_t ui16Instance = 0;
+            memcpy(&ui16Instance, &vecAttr[0x0E], 2);
+            ui16NextInstance = std::max<uint16_t>(ui16NextInstance, static_cast<uint16_t>(ui16Instance + 1));
+        }
+        Put32(p + nPos, 0xFFFFFFFF);
+        Put32(p + 0x18, static_cast<uint32_t>(nPos + 8));
+        Put16(p + 0x28, ui16NextInstance);
+    }
+
+    void ComposeNode(uint64_t ui64Record, const Node& objNode, std::vector<uint8_t>& vecRecord) const {
+        ComposeRecord(ui64Record, NodeAttributes(ui64Record, objNode),
+                      static_cast<uint16_t>(0x0001 | (objNode.bDirectory ? 0x0002 : 0)), 0, vecRecord);
+    }
+
+    // 更新序列：每个512字节段的最后两个字节保存到数组中，替换为序列号1
+    static void Protect(uint8_t* p, size_t nBytes) {
+        uint16_t ui16Offset = 0;
+        memcpy(&ui16Offset, p + 4, 2);
+        Put16(p + ui16Offset, 1);
+        for (size_t i = 1; i <= nBytes / 512; i++) {
+            memcpy(p + ui16Offset + 2 * i, p + i * 512 - 2, 2);
+            Put16(p + i * 512 - 2, 1);
+        }
+    }
+
+    static void AppendEntry(std::vector<uint8_t>& vecOut, uint64_t ui64Reference, const std::vector<uint8_t>* pKey,
+                            bool bSubnode, uint64_t ui64SubnodeVcn) {
+        size_t nKey = pKey ? pKey->size() : 0;
+        size_t nLength = static_cast<size_t>(Align8(0x10 + nKey)) + (bSubnode ? 8 : 0);
+        size_t nPos = vecOut.size();
+        vecOut.resize(nPos + nLength, 0);
+        uint8_t* p = vecOut.data() + nPos;
+        if (pKey) {
+            Put64(p, ui64Reference);
+            memcpy(p + 0x10, pKey->data(), nKey);
+        }
+        Put16(p + 8, static_cast<uint16_t>(nLength));
+        Put16(p + 10, static_cast<uint16_t>(nKey));
+        Put16(p + 12, static_cast<uint16_t>((pKey ? 0 : 0x0002) | (bSubnode ? 0x0001 : 0)));
+        if (bSubnode) Put64(p + nLength - 8, ui64SubnodeVcn);
+    }
+
+    /********************************************************************************
+    * 函数名称：生成目录索引（内部辅助）
+    * 说明：项按文件名排序后先尝试全部放进索引根；放不下时把当前层装入INDX块，
+    *       每块之后的一项提升到上一层作为分隔项（左子节点为该块），直到
+    *       一层的项能放进索引根
+    *********************************************************************************/
+    void BuildIndex(uint64_t ui64Directory, Node& objDirectory) {
+        std::vector<std::pair<uint64_t, std::vector<uint8_t>>> vecItems;
+        for (const auto& pairNode : m_mapNodes) {
+            if (pairNode.second.ui64Parent == ui64Directory && (pairNode.first != ui64Directory || ui64Directory == ROOT)) {
+                vecItems.emplace_back(pairNode.first | (1ULL << 48), FileName(pairNode.first, pairNode.second));
+            }
+        }
+        std::sort(vecItems.begin(), vecItems.end(), [&](const auto& a, const auto& b) {
+            auto Name = [](const std::vector<uint8_t>& vecKey) {
+                std::u16string strName(vecKey[0x40], u'\0');
+                memcpy(&strName[0], &vecKey[0x42], strName.size() * 2);
+                return strName;
+            };
+            return CompareNames(Name(a.second), Name(b.second)) < 0;
+        });
+
+        struct Item {
+            size_t  nItem;
+            int64_t i64Child;
+        };
+        struct Block {
+            std::vector<Item> vecItems;
+            int64_t           i64EndChild;
+            bool              bChildren;
+        };
+        const uint64_t ui64BlockClusters = INDEX_BLOCK_SIZE / m_ui32ClusterSize;
+        const size_t nCapacity = INDEX_BLOCK_SIZE - 0x40;
+        auto MakeRoot = [&](const std::vector<Item>& vecLevel, bool bChildren, int64_t i64Trailing,
+                            const std::vector<Block>& vecBlocks) {
+            std::vector<uint8_t> vecEntries;
+            for (const Item& stcItem : vecLevel) {
+                AppendEntry(vecEntries, vecItems[stcItem.nItem].first, &vecItems[stcItem.nItem].second, bChildren,
+                            static_cast<uint64_t>(stcItem.i64Child) * ui64BlockClusters);
+            }
+            AppendEntry(vecEntries, 0, nullptr, bChildren, static_cast<uint64_t>(i64Trailing) * ui64BlockClusters);
+            std::vector<uint8_t> vecValue(0x20, 0);
+            Put32(&vecValue[0], 0x30);
+            Put32(&vecValue[4], 1);
+            Put32(&vecValue[8], INDEX_BLOCK_SIZE);
+            vecValue[12] = static_cast<uint8_t>(ui64BlockClusters);
+            Put32(&vecValue[0x10], 0x10);
+            Put32(&vecValue[0x14], static_cast<uint32_t>(0x10 + vecEntries.size()));
+            Put32(&vecValue[0x18], static_cast<uint32_t>(0x10 + vecEntries.size()));
+            vecValue[0x1C] = bChildren ? 1 : 0;
+            vecValue.insert(vecValue.end(), vecEntries.begin(), vecEntries.end());
+            std::vector<std::vector<uint8_t>> vecAttributes = { Resident(0x90, u"$I30", vecValue) };
+            if (!vecBlocks.empty()) {
+                uint64_t ui64Clusters = vecBlocks.size() * ui64BlockClusters;
+                vecAttributes.push_back(NonResident(0xA0, u"$I30", { { m_ui64TotalClusters - 1, ui64Clusters } },
+                                                    vecBlocks.size() * INDEX_BLOCK_SIZE, vecBlocks.size() * INDEX_BLOCK_SIZE));
+                vecAttributes.push_back(Resident(0xB0, u"$I30", std::vector<uint8_t>(
+                    static_cast<size_t>(Align8((vecBlocks.size() + 7) / 8)), 0)));
+            }
+            return vecAttributes;
+        };
+        auto Fits = [&](const std::vector<std::vector<uint8_t>>& vecIndex) {
+            Node objTrial = objDirectory;
+            objTrial.vecAttributes.insert(objTrial.vecAttributes.end(), vecIndex.begin(), vecIndex.end());
+            return RecordBytes(NodeAttributes(ui64Directory, objTrial)) <= RECORD_SIZE;
+        };
+
+        std::vector<Block> vecBlocks;
+        std::vector<Item> vecLevel;
+        for (size_t i = 0; i < vecItems.size(); i++) vecLevel.push_back({ i, -1 });
+        bool bChildren = false;
+        int64_t i64Trailing = -1;
+        while (!Fits(MakeRoot(vecLevel, bChildren, i64Trailing, vecBlocks))) {
+            auto EntrySize = [&](const Item& stcItem) {
+                return static_cast<size_t>(Align8(0x10 + vecItems[stcItem.nItem].second.size())) + (bChildren ? 8 : 0);
+            };
+            std::vector<Item> vecParent;
+            size_t i = 0;
+            while (true) {
+                Block objBlock = { {}, -1, bChildren };
+                size_t nUsed = 0x10 + (bChildren ? 8 : 0);
+                while (i < vecLevel.size() && nUsed + EntrySize(vecLevel[i]) <= nCapacity) {
+                    nUsed += EntrySize(vecLevel[i]);
+                    objBlock.vecItems.push_back(vecLevel[i++]);
+                }
+                if (i == vecLevel.size()) {
+                    objBlock.i64EndChild = i64Trailing;
+                    vecBlocks.push_back(objBlock);
+                    break;
+                }
+                if (i + 1 == vecLevel.size() && objBlock.vecItems.size() >= 2) {   // 避免最后一块为空
+                    objBlock.vecItems.pop_back();
+                    i--;
+                }
+                objBlock.i64EndChild = vecLevel[i].i64Child;
+                vecParent.push_back({ vecLevel[i].nItem, static_cast<int64_t>(vecBlocks.size()) });
+                vecBlocks.push_back(objBlock);
+                i++;
+            }
+            i64Trailing = static_cast<int64_t>(vecBlocks.size()) - 1;
+            vecLevel = vecParent;
+            bChildren = true;
+        }
+
+        std::vector<std::vector<uint8_t>> vecIndex = MakeRoot(vecLevel, bChildren, i64Trailing, vecBlocks);
+        if (!vecBlocks.empty()) {
+            uint64_t ui64Lcn = Allocate(vecBlocks.size() * ui64BlockClusters);
+            for (size_t n = 0; n < vecBlocks.size(); n++) {
+                const Block& objBlock = vecBlocks[n];
+                std::vector<uint8_t> vecEntries;
+                for (const Item& stcItem : objBlock.vecItems) {
+                    AppendEntry(vecEntries, vecItems[stcItem.nItem].first, &vecItems[stcItem.nItem].second,
+                                objBlock.bChildren, static_cast<uint64_t>(stcItem.i64Child) * ui64BlockClusters);
+                }
+                AppendEntry(vecEntries, 0, nullptr, objBlock.bChildren,
+                            static_cast<uint64_t>(objBlock.i64EndChild) * ui64BlockClusters);
+                uint8_t* p = &m_vecImage[static_cast<size_t>((ui64Lcn + n * ui64BlockClusters) * m_ui32ClusterSize)];
+                memcpy(p, "INDX", 4);
+                Put16(p + 4, 0x28);
+                Put16(p + 6, INDEX_BLOCK_SIZE / 512 + 1);
+                Put64(p + 0x10, n * ui64BlockClusters);
+                Put32(p + 0x18, 0x40 - 0x18);
+                Put32(p + 0x1C, static_cast<uint32_t>(0x40 - 0x18 + vecEntries.size()));
+                Put32(p + 0x20, INDEX_BLOCK_SIZE - 0x18);
+                p[0x24] = objBlock.bChildren ? 1 : 0;
+                memcpy(p + 0x40, vecEntries.data(), vecEntries.size());
+                Protect(p, INDEX_BLOCK_SIZE);
+            }
+            vecIndex[1] = NonResident(0xA0, u"$I30", { { ui64Lcn, vecBlocks.size() * ui64BlockClusters } },
+                                      vecBlocks.size() * INDEX_BLOCK_SIZE, vecBlocks.size() * INDEX_BLOCK_SIZE);
+            std::vector<uint8_t> vecBits(static_cast<size_t>(Align8((vecBlocks.size() + 7) / 8)), 0);
+            for (size_t n = 0; n < vecBlocks.size(); n++) vecBits[n >> 3] |= static_cast<uint8_t>(1 << (n & 7));
+            vecIndex[2] = Resident(0xB0, u"$I30", vecBits);
+            m_mapIndexAllocations[ui64Directory] = { ui64Lcn, vecBlocks.size() * ui64BlockClusters };
+        }
+        objDirectory.vecAttributes.insert(objDirectory.vecAttributes.end(), vecIndex.begin(), vecIndex.end());
+    }
+
+    /********************************************************************************
+    * 函数名称：LZNT1压缩一个压缩单元（内部辅助）
+    * 说明：每4KB一块，块内贪心查找最长匹配；压缩后不变小的块原样存放
+    *********************************************************************************/
+    static std::vector<uint8_t> Lznt1Compress(const uint8_t* pData, size_t nBytes) {
+        std::vector<uint8_t> vecOut;
+        for (size_t nStart = 0; nStart < nBytes; nStart += 4096) {
+            const uint8_t* pChunk = pData + nStart;
+            size_t nChunk = std::min<size_t>(4096, nBytes - nStart);
+            std::vector<uint8_t> vecPacked;
+            size_t nPos = 0;
+            while (nPos < nChunk) {
+                size_t nFlags = vecPacked.size();
+                vecPacked.push_back(0);
+                for (int nBit = 0; nBit < 8 && nPos < nChunk; nBit++) {
+                    int nLengthShift = 0;
+                    for (size_t i = nPos == 0 ? 0 : nPos - 1; i >= 0x10; i >>= 1) nLengthShift++;
+                    size_t nMaxLength = std::min<size_t>((0x0FFFu >> nLengthShift) + 3, nChunk - nPos);
+                    size_t nMaxDistance = std::min<size_t>(nPos, static_cast<size_t>(1) << (4 + nLengthShift));
+                    size_t nBestLength = 0;
+                    size_t nBestDistance = 0;
+                    for (size_t nDistance = 1; nDistance <= nMaxDistance; nDistance++) {
+                        size_t nLength = 0;
+                        while (nLength < nMaxLength && pChunk[nPos + nLength] == pChunk[nPos + nLength - nDistance]) {
+                            nLength++;
+                        }
+                        if (nLength > nBestLength) {
+                            nBestLength = nLength;
+                            nBestDistance = nDistance;
+                        }
+                    }
+                    if (nBestLength >= 3) {
+                        uint16_t ui16Token = static_cast<uint16_t>(((nBestDistance - 1) << (12 - nLengthShift)) |
+                                                                   (nBestLength - 3));
+                        vecPacked[nFlags] |= static_cast<uint8_t>(1 << nBit);
+                        vecPacked.push_back(static_cast<uint8_t>(ui16Token));
+                        vecPacked.push_back(static_cast<uint8_t>(ui16Token >> 8));
+                        nPos += nBestLength;
+                    } else {
+                        vecPacked.push_back(pChunk[nPos++]);
+                    }
+                }
+            }
+            uint8_t ui8Header[2];
+            if (vecPacked.size() < nChunk) {
+                Put16(ui8Header, static_cast<uint16_t>(0xB000 | (vecPacked.size() - 1)));
+                vecOut.insert(vecOut.end(), ui8Header, ui8Header + 2);
+                vecOut.insert(vecOut.end(), vecPacked.begin(), vecPacked.end());
+            } else {
+                Put16(ui8Header, static_cast<uint16_t>(0x3000 | (nChunk - 1)));
+                vecOut.insert(vecOut.end(), ui8Header, ui8Header + 2);
+                vecOut.insert(vecOut.end(), pChunk, pChunk + nChunk);
+            }
+        }
+        return vecOut;
+    }
+};
@@ -0,0 +1,330 @@
+﻿/********************************************************************************
+* 文件名称：NtfsVolumeTest.cpp
+* 文件功能：在生成的NTFS卷上验证运行列表、$I30查找、属性列表和LZNT1压缩流的读取
+*
+* 说明：
+*    设置SMARTGPUPV_NTFS_FIXTURE=<目录>时，另外读取tools/gen_ntfs_fixture.py
+*    用mkntfs生成的卷，按其中的清单逐个比较文件内容
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "NtfsImageBuilder.h"
+#include "../Smart-GPU-PV/ContentHash.h"
+#include "../Smart-GPU-PV/NtfsVolume.h"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+using Run = NtfsImageBuilder::Run;
+static const uint64_t SPARSE = NtfsImageBuilder::SPARSE;
+
+static std::vector<uint8_t> RandomBytes(TestHarness::Random& objRandom, size_t nBytes) {
+    std::vector<uint8_t> vecData(nBytes);
+    objRandom.Fill(vecData.data(), nBytes);
+    return vecData;
+}
+
+// 可压缩的数据：重复的文本行，行号使内容不完全相同
+static std::vector<uint8_t> TextBytes(size_t nBytes, uint32_t ui32Seed) {
+    std::string strText;
+    for (uint32_t i = 0; strText.size() < nBytes; i++) {
+        strText += "oem" + std::to_string(ui32Seed) + ".inf,DriverVer=10.0." + std::to_string(i % 37) + "\r\n";
+    }
+    return std::vector<uint8_t>(strText.begin(), strText.begin() + nBytes);
+}
+
+static std::vector<uint8_t> ToBytes(const std::vector<char>& vecData) {
+    return std::vector<uint8_t>(vecData.begin(), vecData.end());
+}
+
+// 按随机偏移和长度分段读取，与模型比较
+static bool RandomReadsMatch(NtfsFile& objFile, const std::vector<uint8_t>& vecModel, TestHarness::Random& objRandom,
+                             int nReads) {
+    std::string strError;
+    std::vector<uint8_t> vecBuffer;
+    for (int i = 0; i < nReads; i++) {
+        uint64_t ui64Offset = objRandom.Below(vecModel.size());
+        size_t nBytes = static_cast<size_t>(1 + objRandom.Below(3 * 4096));
+        size_t nExpected = static_cast<size_t>(std::min<uint64_t>(nBytes, vecModel.size() - ui64Offset));
+        vecBuffer.assign(nBytes, 0xEE);
+        size_t nRead = 0;
+        if (!objFile.Read(ui64Offset, vecBuffer.data(), nBytes, nRead, strError) || nRead != nExpected ||
+            memcmp(vecBuffer.data(), vecModel.data() + ui64Offset, nExpected) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE(RunlistsWithSparseAndNegativeDeltasAreMapped) {
+    // 512字节的簇，24MB的卷有约49000个簇，LCN差值需要1~3个字节
+    NtfsImageBuilder objBuilder(24 * NtfsImageBuilder::MB, 512);
+    TestHarness::Random objRandom(20);
+    std::vector<Run> vecRuns = {
+        { 45000, 3 },       // +45000：0xAFC8最高位为1，需要3字节
+        { 2000, 300 },      // -43000：3字节负数；长度300需要2字节
+        { SPARSE, 5 },      // 稀疏：没有偏移字段
+        { 1900, 2 },        // -100：1字节负数
+        { 40000, 4 },       // +38100：3字节
+    };
+    const size_t nSize = (3 + 300 + 5 + 2 + 4) * 512 - 100;
+    std::vector<uint8_t> vecModel = RandomBytes(objRandom, nSize);
+    std::fill(vecModel.begin() + 303 * 512, vecModel.begin() + 308 * 512, 0);
+    objBuilder.AddFileWithRuns(NtfsImageBuilder::ROOT, u"fragmented.bin", vecModel, vecRuns);
+
+    // 已初始化大小之后的数据在磁盘上不为0，读出时应为0
+    std::vector<uint8_t> vecPartial = RandomBytes(objRandom, 10000);
+    objBuilder.AddFileWithRuns(NtfsImageBuilder::ROOT, u"partial.bin", vecPartial, { { 20000, 20 } }, 6000);
+    std::fill(vecPartial.begin() + 6000, vecPartial.end(), 0);
+
+    MemoryBlockDevice objDevice(objBuilder.Build(), true);
+    NtfsVolume objVolume;
+    std::string strError;
+    REQUIRE(objVolume.Open(objDevice, strError));
+    CHECK_EQ(objVolume.ClusterSize(), uint32_t(512));
+
+    std::vector<char> vecData;
+    REQUIRE(objVolume.ReadFile("fragmented.bin", vecData, strError));
+    CHECK(ToBytes(vecData) == vecModel);
+    NtfsFile objFile;
+    REQUIRE(objVolume.OpenFile("\\FRAGMENTED.BIN", objFile, strError));
+    CHECK_EQ(objFile.Size(), uint64_t(nSize));
+    CHECK(RandomReadsMatch(objFile, vecModel, objRandom, 200));
+    size_t nRead = 0;
+    char szTail[16];
+    CHECK(objFile.Read(nSize - 4, szTail, sizeof(szTail), nRead, strError));
+    CHECK_EQ(nRead, size_t(4));
+
+    REQUIRE(objVolume.ReadFile("partial.bin", vecData, strError));
+    CHECK(ToBytes(vecData) == vecPartial);
+
+    std::vector<NtfsFileInfo> vecEntries;
+    REQUIRE(objVolume.ListDirectory("", vecEntries, strError));
+    REQUIRE(vecEntries.size() == 2);             // 元数据文件不列出
+    CHECK_EQ(vecEntries[0].strName, std::string("fragmented.bin"));
+    CHECK_EQ(vecEntries[0].ui64Size, uint64_t(nSize));
+    CHECK_EQ(vecEntries[1].strName, std::string("partial.bin"));
+}
+
+TEST_CASE(TornRecordIsRejected) {
+    NtfsImageBuilder objBuilder;
+    uint64_t ui64Record = objBuilder.AddFile(NtfsImageBuilder::ROOT, u"a.txt", { 'a', 'b', 'c' });
+    std::vector<uint8_t> vecImage = objBuilder.Build();
+    vecImage[static_cast<size_t>(objBuilder.RecordOffset(ui64Record) + 510)] ^= 0xFF;   // 第一个扇区的更新序列
+    MemoryBlockDevice objDevice(vecImage, true);
+    NtfsVolume objVolume;
+    std::string strError;
+    REQUIRE(objVolume.Open(objDevice, strError));
+    std::vector<char> vecData;
+    CHECK(!objVolume.ReadFile("a.txt", vecData, strError));
+    CHECK(strError.find("已损坏") != std::string::npos);
+}
+
+TEST_CASE(DirectoryLookupDescendsIndexBlocksCaseInsensitively) {
+    NtfsImageBuilder objBuilder(16 * NtfsImageBuilder::MB, 4096, 1024);
+    uint64_t ui64Many = objBuilder.AddDirectory(NtfsImageBuilder::ROOT, u"Many");
+    uint64_t ui64Some = objBuilder.AddDirectory(NtfsImageBuilder::ROOT, u"Some");
+
+    // 600项需要多个INDX块，分隔项放不进索引根，得到两层索引块；100项时分隔项在索引根中
+    std::map<std::string, std::string> mapMany;
+    for (int i = 0; i < 600; i++) {
+        char szName[32];
+        snprintf(szName, sizeof(szName), i % 2 ? "oem%03d.INF" : "Oem%03d_x64.cat", i);
+        std::string strContent = "content of " + std::string(szName);
+        objBuilder.AddFile(ui64Many, std::u16string(szName, szName + strlen(szName)),
+                           std::vector<uint8_t>(strContent.begin(), strContent.end()));
+        mapMany[szName] = strContent;
+    }
+    for (int i = 0; i < 100; i++) {
+        std::string strName = "file" + std::to_string(i) + ".sys";
+        objBuilder.AddFile(ui64Some, std::u16string(strName.begin(), strName.end()), { static_cast<uint8_t>(i) });
+    }
+    objBuilder.AddFile(ui64Many, u"résumé.txt", { 'r' });
+    MemoryBlockDevice objDevice(objBuilder.Build(), true);
+    REQUIRE(objBuilder.IndexAllocation(ui64Many).ui64Length >= 3);
+    REQUIRE(objBuilder.IndexAllocation(ui64Some).ui64Length >= 2);
+
+    NtfsVolume objVolume;
+    std::string strError;
+    REQUIRE(objVolume.Open(objDevice, strError));
+
+    // 1. 每个名称都能以不同的大小写找到（包括索引块中的分隔项和叶子项）
+    size_t nFound = 0;
+    for (const auto& pairFile : mapMany) {
+        std::string strUpper = pairFile.first;
+        for (char& ch : strUpper) ch = static_cast<char>(toupper(static_cast<unsigned char>(ch)));
+        std::vector<char> vecData;
+        if (objVolume.ReadFile("many\\" + strUpper, vecData, strError) &&
+            std::string(vecData.begin(), vecData.end()) == pairFile.second) {
+            nFound++;
+        }
+    }
+    CHECK_EQ(nFound, mapMany.size());
+    for (int i = 0; i < 100; i++) {
+        NtfsFileInfo stcInfo;
+        CHECK(objVolume.Stat("SOME/FILE" + std::to_string(i) + ".SYS", stcInfo, strError) && stcInfo.ui64Size == 1);
+    }
+
+    // 2. 非ASCII字母按卷上的$UpCase表比较
+    NtfsFileInfo stcInfo;
+    REQUIRE(objVolume.Stat("Many\\R\xC3\x89SUM\xC3\x89.TXT", stcInfo, strError));
+    CHECK_EQ(stcInfo.strName, std::string("r\xC3\xA9sum\xC3\xA9.txt"));
+    CHECK(!objVolume.Stat("Many\\oem999.inf", stcInfo, strError));
+    CHECK(strError.find("找不到") != std::string::npos);
+    CHECK(!objVolume.Stat("Many\\oem001.INF\\x", stcInfo, strError));
+
+    // 3. 遍历按文件名排序（中序遍历索引块）
+    std::vector<NtfsFileInfo> vecEntries;
+    REQUIRE(objVolume.ListDirectory("Many", vecEntries, strError));
+    REQUIRE(vecEntries.size() == mapMany.size() + 1);
+    std::vector<std::string> vecExpected;
+    for (const auto& pairFile : mapMany) {
+        std::string strUpper = pairFile.first;
+        for (char& ch : strUpper) ch = static_cast<char>(toupper(static_cast<unsigned char>(ch)));
+        vecExpected.push_back(strUpper);
+    }
+    std::sort(vecExpected.begin(), vecExpected.end());
+    bool bOrdered = true;
+    for (size_t i = 0; i < vecExpected.size(); i++) {
+        std::string strUpper = vecEntries[i].strName;
+        for (char& ch : strUpper) ch = static_cast<char>(toupper(static_cast<unsigned char>(ch)));
+        bOrdered = bOrdered && strUpper == vecExpected[i];
+    }
+    CHECK(bOrdered);
+    CHECK_EQ(vecEntries.back().strName, std::string("r\xC3\xA9sum\xC3\xA9.txt"));
+    REQUIRE(objVolume.ListDirectory("", vecEntries, strError));
+    CHECK_EQ(vecEntries.size(), size_t(2));
+    CHECK(vecEntries[0].bDirectory);
+
+    // 4. 索引块损坏时查找和遍历都报告错误（说明确实经过了INDX块）
+    std::vector<uint8_t> vecImage = objDevice.Data();
+    Run stcBlocks = objBuilder.IndexAllocation(ui64Many);
+    vecImage[static_cast<size_t>(stcBlocks.ui64Lcn * 4096 + 510)] ^= 0xFF;
+    MemoryBlockDevice objCorrupt(vecImage, true);
+    NtfsVolume objCorruptVolume;
+    REQUIRE(objCorruptVolume.Open(objCorrupt, strError));
+    CHECK(!objCorruptVolume.ListDirectory("Many", vecEntries, strError));
+    CHECK(strError.find("索引块已损坏") != std::string::npos);
+}
+
+TEST_CASE(AttributeListJoinsExtentsFromExtensionRecord) {
+    NtfsImageBuilder objBuilder;
+    TestHarness::Random objRandom(2020);
+    std::vector<uint8_t> vecModel = RandomBytes(objRandom, 40 * 4096 - 123);
+    std::fill(vecModel.begin() + 25 * 4096, vecModel.begin() + 30 * 4096, 0);
+    std::vector<std::vector<Run>> vecExtents = {
+        { { 3000, 10 } },                       // 基本记录中的片段（VCN 0~9）
+        { { 1500, 15 }, { SPARSE, 5 } },        // 扩展记录中的片段（VCN 10~29）
+        { { 3500, 10 } },                       // 扩展记录中的片段（VCN 30~39）
+    };
+    uint64_t ui64Extension = 0;
+    objBuilder.AddFileWithAttributeList(NtfsImageBuilder::ROOT, u"catalog.cat", vecModel, vecExtents, &ui64Extension);
+    std::vector<uint8_t> vecImage = objBuilder.Build();
+
+    MemoryBlockDevice objDevice(vecImage, true);
+    NtfsVolume objVolume;
+    std::string strError;
+    REQUIRE(objVolume.Open(objDevice, strError));
+    NtfsFileInfo stcInfo;
+    REQUIRE(objVolume.Stat("catalog.cat", stcInfo, strError));
+    CHECK_EQ(stcInfo.ui64Size, uint64_t(vecModel.size()));
+    std::vector<char> vecData;
+    REQUIRE(objVolume.ReadFile("catalog.cat", vecData, strError));
+    CHECK(ToBytes(vecData) == vecModel);
+    NtfsFile objFile;
+    REQUIRE(objVolume.OpenFile("catalog.cat", objFile, strError));
+    CHECK(RandomReadsMatch(objFile, vecModel, objRandom, 100));
+
+    // 扩展记录指向其他基本记录时不能使用
+    uint64_t ui64WrongBase = 7 | (1ULL << 48);
+    memcpy(&vecImage[static_cast<size_t>(objBuilder.RecordOffset(ui64Extension) + 0x20)], &ui64WrongBase, 8);
+    MemoryBlockDevice objCorrupt(vecImage, true);
+    NtfsVolume objCorruptVolume;
+    REQUIRE(objCorruptVolume.Open(objCorrupt, strError));
+    CHECK(!objCorruptVolume.ReadFile("catalog.cat", vecData, strError));
+    CHECK(strError.find("不属于") != std::string::npos);
+}
+
+TEST_CASE(CompressedStreamMixesLznt1RawAndSparseUnits) {
+    NtfsImageBuilder objBuilder;
+    TestHarness::Random objRandom(1);
+    const size_t nUnit = 16 * 4096;
+    std::vector<uint8_t> vecModel;
+    auto Append = [&](const std::vector<uint8_t>& vecPart) { vecModel.insert(vecModel.end(), vecPart.begin(), vecPart.end()); };
+    Append(TextBytes(nUnit, 0));                                    // 单元0：压缩
+    Append(std::vector<uint8_t>(nUnit, 0));                         // 单元1：稀疏
+    Append(RandomBytes(objRandom, nUnit));                          // 单元2：不可压缩，原样存放
+    Append(RandomBytes(objRandom, 4096));                           // 单元3：第一块原样（未压缩块），其余压缩
+    Append(TextBytes(nUnit - 4096, 3));
+    Append(TextBytes(10000, 4));                                    // 单元4：不完整的最后一个单元
+    std::vector<Run> vecRuns;
+    objBuilder.AddCompressedFile(NtfsImageBuilder::ROOT, u"driver.dll", vecModel, &vecRuns);
+
+    // 运行列表：压缩单元后面跟着稀疏运行，稀疏单元合并进去，原样存放的单元占满16簇
+    REQUIRE(vecRuns.size() >= 6);
+    CHECK(vecRuns[0].ui64Lcn != SPARSE && vecRuns[0].ui64Length < 16);
+    CHECK(vecRuns[1].ui64Lcn == SPARSE && vecRuns[1].ui64Length == 16 + 16 - vecRuns[0].ui64Length);
+    CHECK(vecRuns[2].ui64Lcn != SPARSE && vecRuns[2].ui64Length == 16);
+    CHECK(vecRuns[3].ui64Lcn != SPARSE && vecRuns[3].ui64Length < 16);
+
+    std::vector<uint8_t> vecImage = objBuilder.Build();
+    MemoryBlockDevice objDevice(vecImage, true);
+    NtfsVolume objVolume;
+    std::string strError;
+    REQUIRE(objVolume.Open(objDevice, strError));
+    std::vector<char> vecData;
+    REQUIRE(objVolume.ReadFile("driver.dll", vecData, strError));
+    CHECK(ToBytes(vecData) == vecModel);
+    NtfsFile objFile;
+    REQUIRE(objVolume.OpenFile("driver.dll", objFile, strError));
+    CHECK(RandomReadsMatch(objFile, vecModel, objRandom, 200));
+
+    // 单元0第一个压缩块的第一个标记改为回溯引用：此时还没有可引用的输出
+    REQUIRE(vecImage[static_cast<size_t>(vecRuns[0].ui64Lcn * 4096 + 1)] & 0x80);
+    vecImage[static_cast<size_t>(vecRuns[0].ui64Lcn * 4096 + 2)] |= 0x01;
+    MemoryBlockDevice objCorrupt(vecImage, true);
+    NtfsVolume objCorruptVolume;
+    REQUIRE(objCorruptVolume.Open(objCorrupt, strError));
+    CHECK(!objCorruptVolume.ReadFile("driver.dll", vecData, strError));
+    CHECK(strError.find("压缩数据已损坏") != std::string::npos);
+}
+
+TEST_CASE(GeneratedFixtureMatchesManifest) {
+    // tools/gen_ntfs_fixture.py生成的卷（mkntfs），未设置时跳过
+    const char* pszFixture = getenv("SMARTGPUPV_NTFS_FIXTURE");
+    if (!pszFixture || !*pszFixture) {
+        return;
+    }
+    std::string strDir = pszFixture;
+    std::string strError;
+    FileBlockDevice objDevice;
+    REQUIRE(objDevice.Open(strDir + "/ntfs.img", true, strError));
+    NtfsVolume objVolume;
+    REQUIRE(objVolume.Open(objDevice, strError));
+
+    // 清单每行：<CRC32十六进制> <大小> <路径>
+    std::ifstream objManifest(strDir + "/manifest.txt");
+    REQUIRE(objManifest.good());
+    std::string strLine;
+    size_t nFiles = 0;
+    while (std::getline(objManifest, strLine)) {
+        std::istringstream objLine(strLine);
+        std::string strCrc;
+        uint64_t ui64Size = 0;
+        std::string strPath;
+        objLine >> strCrc >> ui64Size;
+        std::getline(objLine >> std::ws, strPath);
+        std::vector<char> vecData;
+        bool bRead = objVolume.ReadFile(strPath, vecData, strError);
+        CHECK(bRead);
+        if (!bRead) continue;
+        CHECK_EQ(uint64_t(vecData.size()), ui64Size);
+        CHECK_EQ(Crc32::Ieee(vecData.data(), vecData.size()), static_cast<uint32_t>(std::stoul(strCrc, nullptr, 16)));
+        nFiles++;
+    }
+    CHECK(nFiles > 0);
+}
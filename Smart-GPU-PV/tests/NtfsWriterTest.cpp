@@ -0,0 +1,457 @@
+﻿/********************************************************************************
+* 文件名称：NtfsWriterTest.cpp
+* 文件功能：在生成的NTFS卷上验证离线写入的回读、刷新屏障处的崩溃一致性和设备故障
+*
+* 说明：
+*    BarrierBlockDevice记录每次写入发生在第几次刷新之后：崩溃镜像由原始镜像
+*    加上某次刷新之前的全部写入、再加上该刷新之后任意一部分写入得到（同一
+*    屏障之间的写入可能以任意顺序落盘）。也可以在N次刷新后让写入和刷新失败。
+*    设置SMARTGPUPV_NTFS_FIXTURE=<目录>时另外写入tools/gen_ntfs_fixture.py
+*    生成的卷，结果保存为written.img，可用该脚本的--check由ntfs-3g回读
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "NtfsImageBuilder.h"
+#include "../Smart-GPU-PV/ContentHash.h"
+#include "../Smart-GPU-PV/NtfsWriter.h"
+#include <cstdlib>
+#include <fstream>
+
+/********************************************************************************
+* 类名称：屏障记录块设备
+* 类功能：转发到内存块设备，记录每次写入所在的屏障序号（之前的刷新次数）；
+*         设置了故障点时，第N次刷新之后的写入和刷新都失败
+*********************************************************************************/
+class BarrierBlockDevice : public BlockDevice {
+public:
+    struct WriteRecord {
+        size_t               nEpoch;        // 写入之前完成的刷新次数
+        uint64_t             ui64Offset;
+        std::vector<uint8_t> vecData;
+    };
+
+    explicit BarrierBlockDevice(MemoryBlockDevice& objInner, size_t nFailAfterFlushes = ~size_t(0))
+        : m_objInner(objInner), m_nFailAfterFlushes(nFailAfterFlushes) {}
+
+    uint64_t Size() const override { return m_objInner.Size(); }
+    uint32_t SectorSize() const override { return m_objInner.SectorSize(); }
+    bool IsReadOnly() const override { return m_objInner.IsReadOnly(); }
+    bool Read(uint64_t ui64Offset, void* pBuffer, size_t nBytes, std::string& strError) override {
+        return m_objInner.Read(ui64Offset, pBuffer, nBytes, strError);
+    }
+    bool Write(uint64_t ui64Offset, const void* pBuffer, size_t nBytes, std::string& strError) override {
+        if (m_nFlushes >= m_nFailAfterFlushes) {
+            strError = "模拟的设备故障";
+            return false;
+        }
+        const uint8_t* pBytes = static_cast<const uint8_t*>(pBuffer);
+        m_vecWrites.push_back({ m_nFlushes, ui64Offset, std::vector<uint8_t>(pBytes, pBytes + nBytes) });
+        return m_objInner.Write(ui64Offset, pBuffer, nBytes, strError);
+    }
+    bool Flush(std::string& strError) override {
+        if (m_nFlushes >= m_nFailAfterFlushes) {
+            strError = "模拟的设备故障";
+            return false;
+        }
+        m_nFlushes++;
+        return m_objInner.Flush(strError);
+    }
+
+    size_t Flushes() const { return m_nFlushes; }
+    const std::vector<WriteRecord>& Writes() const { return m_vecWrites; }
+
+    /********************************************************************************
+    * 函数名称：生成崩溃镜像
+    * 函数参数：
+    *    [IN]  std::vector<uint8_t> vecImage：会话开始前的镜像
+    *    [IN]  size_t nEpoch：崩溃发生在第nEpoch次刷新之后、下一次刷新完成之前
+    *    [IN]  TestHarness::Random* pRandom：该屏障之后的写入各以1/2概率落盘（nullptr表示都不落盘）
+    *********************************************************************************/
+    std::vector<uint8_t> CrashImage(std::vector<uint8_t> vecImage, size_t nEpoch, TestHarness::Random* pRandom) const {
+        for (const WriteRecord& stcWrite : m_vecWrites) {
+            if (stcWrite.nEpoch > nEpoch || (stcWrite.nEpoch == nEpoch && (!pRandom || pRandom->Below(2) == 0))) {
+                continue;
+            }
+            std::copy(stcWrite.vecData.begin(), stcWrite.vecData.end(),
+                      vecImage.begin() + static_cast<ptrdiff_t>(stcWrite.ui64Offset));
+        }
+        return vecImage;
+    }
+
+private:
+    MemoryBlockDevice&       m_objInner;
+    size_t                   m_nFailAfterFlushes;
+    size_t                   m_nFlushes = 0;
+    std::vector<WriteRecord> m_vecWrites;
+};
+
+static const std::string STORE = "Windows\\System32\\HostDriverStore";
+static const std::string PACKAGE = "Windows\\System32\\HostDriverStore\\FileRepository\\nv_dispi.inf_amd64";
+static const size_t OLD_FILES = 20;
+static const size_t NEW_FILES = 150;
+
+static std::vector<uint8_t> Content(const std::string& strName, size_t nBytes, uint32_t ui32Version) {
+    std::vector<uint8_t> vecData(nBytes);
+    uint64_t ui64State = XXHash64::Hash(strName.data(), strName.size(), ui32Version);
+    for (size_t i = 0; i < nBytes; i++) {
+        ui64State = ui64State * 6364136223846793005ULL + 1442695040888963407ULL;
+        vecData[i] = static_cast<uint8_t>(ui64State >> 56);
+    }
+    return vecData;
+}
+
+static size_t NewFileSize(size_t i) {
+    return i % 10 == 0 ? 200000 + i * 1000 : 100 + i * 37;     // 常驻和非常驻都有
+}
+
+/********************************************************************************
+* 函数名称：生成写入前的卷
+* 说明：驱动目录中有OLD_FILES个文件，另有一个不被修改的文件
+*********************************************************************************/
+static std::vector<uint8_t> BaseImage(NtfsImageBuilder& objBuilder) {
+    uint64_t ui64Windows = objBuilder.AddDirectory(NtfsImageBuilder::ROOT, u"Windows");
+    uint64_t ui64System32 = objBuilder.AddDirectory(ui64Windows, u"System32");
+    uint64_t ui64Store = objBuilder.AddDirectory(ui64System32, u"HostDriverStore");
+    for (size_t i = 0; i < OLD_FILES; i++) {
+        std::string strName = "old" + std::to_string(i) + ".dll";
+        objBuilder.AddFile(ui64Store, std::u16string(strName.begin(), strName.end()), Content(strName, 3000 + i * 500, 1));
+    }
+    objBuilder.AddFile(NtfsImageBuilder::ROOT, u"keep.txt", Content("keep.txt", 5000, 1));
+    return objBuilder.Build();
+}
+
+static bool WriteBytes(NtfsWriter& objWriter, const std::string& strPath, const std::vector<uint8_t>& vecData,
+                       std::string& strError) {
+    NtfsFileProperties stcProperties;
+    stcProperties.ui64Size = vecData.size();
+    stcProperties.ui64ModifiedTime = NtfsImageBuilder::FILE_TIME;
+    stcProperties.ui32Attributes = 0x20;
+    size_t nOffset = 0;
+    return objWriter.WriteFile(strPath, stcProperties, [&](char* pBuffer, size_t nBytes, std::string&) {
+        memcpy(pBuffer, vecData.data() + nOffset, nBytes);
+        nOffset += nBytes;
+        return true;
+    }, strError);
+}
+
+/********************************************************************************
+* 函数名称：执行一次写入会话
+* 说明：覆盖old0.dll，删除old1.dll，在新建的驱动包目录中写入NEW_FILES个文件
+*       （目录索引需要INDX块，记录数超过生成时的MFT，需要扩展$MFT），然后提交
+*********************************************************************************/
+static bool RunSession(BlockDevice& objDevice, NtfsWriter& objWriter, std::string& strError) {
+    if (!objWriter.Begin(objDevice, strError)) {
+        return false;
+    }
+    bool bOk = WriteBytes(objWriter, STORE + "\\old0.dll", Content("old0.dll", 9000, 2), strError) &&
+               objWriter.RemoveFile(STORE + "\\old1.dll", strError) &&
+               objWriter.CreateDirectories(PACKAGE, 0x10, strError);
+    for (size_t i = 0; bOk && i < NEW_FILES; i++) {
+        std::string strName = "file" + std::to_string(i) + ".sys";
+        bOk = WriteBytes(objWriter, PACKAGE + "\\" + strName, Content(strName, NewFileSize(i), 2), strError);
+    }
+    std::string strCommitError;
+    bool bCommitted = objWriter.Commit(strCommitError);
+    if (bOk && !bCommitted) {
+        strError = strCommitError;
+    }
+    return bOk && bCommitted;
+}
+
+/********************************************************************************
+* 函数名称：读取$Volume的卷标志
+*********************************************************************************/
+static uint16_t VolumeFlags(const std::vector<uint8_t>& vecImage, const NtfsImageBuilder& objBuilder) {
+    const uint8_t* pRecord = &vecImage[static_cast<size_t>(objBuilder.RecordOffset(3))];
+    uint32_t ui32Offset = 0;
+    memcpy(&ui32Offset, pRecord + 0x14, 2);
+    while (ui32Offset + 8 <= NtfsImageBuilder::RECORD_SIZE) {
+        uint32_t ui32Type = 0, ui32Length = 0;
+        memcpy(&ui32Type, pRecord + ui32Offset, 4);
+        memcpy(&ui32Length, pRecord + ui32Offset + 4, 4);
+        if (ui32Type == 0xFFFFFFFF || ui32Length == 0) break;
+        if (ui32Type == 0x70) {
+            uint16_t ui16Value = 0, ui16Flags = 0;
+            memcpy(&ui16Value, pRecord + ui32Offset + 0x14, 2);
+            memcpy(&ui16Flags, pRecord + ui32Offset + ui16Value + 0x0A, 2);
+            return ui16Flags;
+        }
+        ui32Offset += ui32Length;
+    }
+    return 0xFFFF;
+}
+
+static bool ReadsAs(NtfsVolume& objVolume, const std::string& strPath, const std::vector<uint8_t>& vecExpected) {
+    std::vector<char> vecData;
+    std::string strError;
+    return objVolume.ReadFile(strPath, vecData, strError) &&
+           std::vector<uint8_t>(vecData.begin(), vecData.end()) == vecExpected;
+}
+
+/********************************************************************************
+* 函数名称：检查崩溃后的卷
+* 说明：卷能打开；未修改的文件不变；被覆盖或删除的文件是旧内容或新状态；
+*       驱动包中列出的文件都是完整的新内容；没有"需要检查"标记时修改全部
+*       落盘或全部没有落盘
+*********************************************************************************/
+static bool CheckCrashImage(const std::vector<uint8_t>& vecImage, const NtfsImageBuilder& objBuilder,
+                            std::string& strProblem) {
+    MemoryBlockDevice objDevice(vecImage, true);
+    NtfsVolume objVolume;
+    std::string strError;
+    if (!objVolume.Open(objDevice, strError)) {
+        strProblem = "打开失败：" + strError;
+        return false;
+    }
+    if (!ReadsAs(objVolume, "keep.txt", Content("keep.txt", 5000, 1))) {
+        strProblem = "keep.txt已改变";
+        return false;
+    }
+    bool bOldOverwritten = !ReadsAs(objVolume, STORE + "\\old0.dll", Content("old0.dll", 3000, 1));
+    if (bOldOverwritten && !ReadsAs(objVolume, STORE + "\\old0.dll", Content("old0.dll", 9000, 2))) {
+        strProblem = "old0.dll既不是旧内容也不是新内容";
+        return false;
+    }
+    NtfsFileInfo stcInfo;
+    bool bOldRemoved = !objVolume.Stat(STORE + "\\old1.dll", stcInfo, strError);
+    if (!bOldRemoved && !ReadsAs(objVolume, STORE + "\\old1.dll", Content("old1.dll", 3500, 1))) {
+        strProblem = "old1.dll已损坏";
+        return false;
+    }
+    for (size_t i = 2; i < OLD_FILES; i++) {
+        std::string strName = "old" + std::to_string(i) + ".dll";
+        if (!ReadsAs(objVolume, STORE + "\\" + strName, Content(strName, 3000 + i * 500, 1))) {
+            strProblem = strName + "已改变";
+            return false;
+        }
+    }
+    std::vector<NtfsFileInfo> vecEntries;
+    size_t nNewFiles = 0;
+    if (objVolume.Stat(PACKAGE, stcInfo, strError)) {
+        if (!objVolume.ListDirectory(PACKAGE, vecEntries, strError)) {
+            strProblem = "驱动包目录无法遍历：" + strError;
+            return false;
+        }
+        for (const NtfsFileInfo& stcEntry : vecEntries) {
+            size_t i = std::stoul(stcEntry.strName.substr(4));
+            if (!ReadsAs(objVolume, PACKAGE + "\\" + stcEntry.strName, Content(stcEntry.strName, NewFileSize(i), 2))) {
+                strProblem = stcEntry.strName + "不完整";
+                return false;
+            }
+        }
+        nNewFiles = vecEntries.size();
+    }
+    if (!(VolumeFlags(vecImage, objBuilder) & 1)) {
+        bool bNothing = !bOldOverwritten && !bOldRemoved && nNewFiles == 0;
+        bool bEverything = bOldOverwritten && bOldRemoved && nNewFiles == NEW_FILES;
+        if (!bNothing && !bEverything) {
+            strProblem = "没有检查标记，但只有部分修改落盘";
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE(CommittedFilesReadBackThroughFreshVolume) {
+    NtfsImageBuilder objBuilder;
+    std::vector<uint8_t> vecBase = BaseImage(objBuilder);
+    MemoryBlockDevice objDevice(vecBase);
+    NtfsWriter objWriter;
+    std::string strError;
+    REQUIRE(RunSession(objDevice, objWriter, strError));
+    CHECK(!objWriter.IsActive());
+    CHECK(!objWriter.HasUnsupported());
+    CHECK_EQ(objWriter.Stats().ui64FilesWritten, uint64_t(NEW_FILES + 1));
+    CHECK_EQ(objWriter.Stats().ui64FilesDeleted, uint64_t(1));
+    CHECK(objWriter.Stats().ui64MftRecordsAdded > 0);
+
+    std::vector<uint8_t> vecImage = objDevice.Data();
+    CHECK_EQ(VolumeFlags(vecImage, objBuilder), uint16_t(0));
+    NtfsVolume objVolume;
+    REQUIRE(objVolume.Open(objDevice, strError));
+    CHECK(ReadsAs(objVolume, STORE + "\\OLD0.DLL", Content("old0.dll", 9000, 2)));
+    NtfsFileInfo stcInfo;
+    CHECK(!objVolume.Stat(STORE + "\\old1.dll", stcInfo, strError));
+    std::vector<NtfsFileInfo> vecEntries;
+    REQUIRE(objVolume.ListDirectory(PACKAGE, vecEntries, strError));
+    CHECK_EQ(vecEntries.size(), NEW_FILES);
+    size_t nMatched = 0;
+    for (size_t i = 0; i < NEW_FILES; i++) {
+        std::string strName = "file" + std::to_string(i) + ".sys";
+        nMatched += ReadsAs(objVolume, PACKAGE + "\\" + strName, Content(strName, NewFileSize(i), 2)) ? 1 : 0;
+    }
+    CHECK_EQ(nMatched, NEW_FILES);
+
+    std::string strProblem;
+    CHECK(CheckCrashImage(vecImage, objBuilder, strProblem));
+
+    // 再开始一次会话：提交后的卷满足开始条件，可以继续写入
+    NtfsWriter objSecond;
+    REQUIRE(objSecond.Begin(objDevice, strError));
+    CHECK(WriteBytes(objSecond, PACKAGE + "\\file0.sys", Content("file0.sys", 10, 3), strError));
+    REQUIRE(objSecond.Commit(strError));
+    NtfsVolume objReopened;
+    REQUIRE(objReopened.Open(objDevice, strError));
+    CHECK(ReadsAs(objReopened, PACKAGE + "\\file0.sys", Content("file0.sys", 10, 3)));
+}
+
+TEST_CASE(CrashAtAnyBarrierLeavesOldOrCompleteNewContent) {
+    NtfsImageBuilder objBuilder;
+    std::vector<uint8_t> vecBase = BaseImage(objBuilder);
+    MemoryBlockDevice objMemory(vecBase);
+    BarrierBlockDevice objDevice(objMemory);
+    NtfsWriter objWriter;
+    std::string strError;
+    REQUIRE(RunSession(objDevice, objWriter, strError));
+    REQUIRE(objDevice.Flushes() >= 5);                      // 开始、数据、记录、目录、释放、清除标记
+
+    // 每个屏障：之后的写入都没有落盘、以及若干组随机子集落盘
+    TestHarness::Random objRandom(21);
+    const int nSubsets = TestHarness::QuickMode() ? 3 : 10;
+    size_t nChecked = 0;
+    std::string strFailure;
+    for (size_t nEpoch = 0; nEpoch <= objDevice.Flushes(); nEpoch++) {
+        for (int nSubset = 0; nSubset <= nSubsets; nSubset++) {
+            std::vector<uint8_t> vecCrash = objDevice.CrashImage(vecBase, nEpoch, nSubset ? &objRandom : nullptr);
+            std::string strProblem;
+            if (CheckCrashImage(vecCrash, objBuilder, strProblem)) {
+                nChecked++;
+            } else if (strFailure.empty()) {
+                strFailure = "屏障 " + std::to_string(nEpoch) + "：" + strProblem;
+            }
+        }
+    }
+    CHECK_EQ(strFailure, std::string());
+    CHECK_EQ(nChecked, (objDevice.Flushes() + 1) * static_cast<size_t>(nSubsets + 1));
+
+    // 最后一个屏障之后的写入全部落盘即为完整的结果；开始前的崩溃不改变卷
+    CHECK(objDevice.CrashImage(vecBase, objDevice.Flushes(), nullptr) == objMemory.Data());
+    CHECK(objDevice.CrashImage(vecBase, 0, nullptr) == vecBase);
+}
+
+TEST_CASE(DeviceFailureStopsSessionAndLeavesVolumeMarked) {
+    NtfsImageBuilder objBuilder;
+    std::vector<uint8_t> vecBase = BaseImage(objBuilder);
+    size_t nFlushes = 0;
+    {
+        MemoryBlockDevice objMemory(vecBase);
+        BarrierBlockDevice objDevice(objMemory);
+        NtfsWriter objWriter;
+        std::string strError;
+        REQUIRE(RunSession(objDevice, objWriter, strError));
+        nFlushes = objDevice.Flushes();
+    }
+
+    for (size_t nFailAfter = 0; nFailAfter < nFlushes; nFailAfter++) {
+        MemoryBlockDevice objMemory(vecBase);
+        BarrierBlockDevice objDevice(objMemory, nFailAfter);
+        NtfsWriter objWriter;
+        std::string strError;
+        CHECK(!RunSession(objDevice, objWriter, strError));
+        std::string strProblem;
+        CHECK(CheckCrashImage(objMemory.Data(), objBuilder, strProblem));
+        if (nFailAfter == 0) {
+            CHECK(objMemory.Data() == vecBase);             // 设置检查标记的写入就失败了
+            continue;
+        }
+        CHECK(strError.find("写入虚拟磁盘失败") != std::string::npos);
+        CHECK(VolumeFlags(objMemory.Data(), objBuilder) & 1);
+        CHECK(!objWriter.Commit(strError));                 // 失败后会话不可继续
+    }
+}
+
+TEST_CASE(BeginRejectsVolumesThatAreNotCleanlyShutDown) {
+    std::string strError;
+    {
+        NtfsImageBuilder objBuilder;
+        objBuilder.SetVolumeFlags(0x0001);
+        MemoryBlockDevice objDevice(objBuilder.Build());
+        NtfsWriter objWriter;
+        CHECK(!objWriter.Begin(objDevice, strError));
+        CHECK(strError.find("需要检查") != std::string::npos);
+    }
+    {
+        NtfsImageBuilder objBuilder;
+        std::vector<uint8_t> vecImage = objBuilder.Build();
+        MemoryBlockDevice objDevice(vecImage, true);
+        NtfsWriter objWriter;
+        CHECK(!objWriter.Begin(objDevice, strError));
+    }
+    {
+        // 休眠文件以"hibr"开头：Windows处于休眠或快速启动，卷在虚拟机关机后还会被改写
+        NtfsImageBuilder objBuilder;
+        std::vector<uint8_t> vecHiber(8192, 0x11);
+        memcpy(vecHiber.data(), "HIBR", 4);
+        objBuilder.AddFile(NtfsImageBuilder::ROOT, u"hiberfil.sys", vecHiber);
+        std::vector<uint8_t> vecImage = objBuilder.Build();
+        MemoryBlockDevice objDevice(vecImage);
+        NtfsWriter objWriter;
+        CHECK(!objWriter.Begin(objDevice, strError));
+        CHECK(strError.find("休眠") != std::string::npos);
+        CHECK(objDevice.Data() == vecImage);
+    }
+}
+
+TEST_CASE(AttributeListFileIsReportedAsUnsupported) {
+    NtfsImageBuilder objBuilder;
+    TestHarness::Random objRandom(7);
+    std::vector<uint8_t> vecData(12 * 4096);
+    objRandom.Fill(vecData.data(), vecData.size());
+    objBuilder.AddFileWithAttributeList(NtfsImageBuilder::ROOT, u"big.cat", vecData, { { { 1500, 6 } }, { { 1600, 6 } } });
+    MemoryBlockDevice objDevice(objBuilder.Build());
+    NtfsWriter objWriter;
+    std::string strError;
+    REQUIRE(objWriter.Begin(objDevice, strError));
+    CHECK(!WriteBytes(objWriter, "big.cat", Content("big.cat", 100, 2), strError));
+    CHECK(strError.find("不能离线修改") != std::string::npos);
+    CHECK(objWriter.HasUnsupported());
+    CHECK(WriteBytes(objWriter, "other.txt", Content("other.txt", 100, 2), strError));
+    REQUIRE(objWriter.Commit(strError));
+    CHECK(objWriter.HasUnsupported());                      // 提交后仍可查询，调用者据此改为挂载
+
+    NtfsVolume objVolume;
+    REQUIRE(objVolume.Open(objDevice, strError));
+    CHECK(ReadsAs(objVolume, "big.cat", vecData));
+    CHECK(ReadsAs(objVolume, "other.txt", Content("other.txt", 100, 2)));
+}
+
+TEST_CASE(GeneratedFixtureAcceptsWrites) {
+    // tools/gen_ntfs_fixture.py生成的卷（mkntfs），未设置时跳过；结果由该脚本的--check回读
+    const char* pszFixture = getenv("SMARTGPUPV_NTFS_FIXTURE");
+    if (!pszFixture || !*pszFixture) {
+        return;
+    }
+    std::string strDir = pszFixture;
+    std::ifstream objInput(strDir + "/ntfs.img", std::ios::binary);
+    REQUIRE(objInput.good());
+    std::vector<uint8_t> vecImage((std::istreambuf_iterator<char>(objInput)), std::istreambuf_iterator<char>());
+    MemoryBlockDevice objDevice(vecImage);
+    NtfsWriter objWriter;
+    std::string strError;
+    REQUIRE(objWriter.Begin(objDevice, strError));
+    bool bWritten = objWriter.CreateDirectories(PACKAGE, 0x10, strError);
+    for (size_t i = 0; bWritten && i < NEW_FILES; i++) {
+        std::string strName = "file" + std::to_string(i) + ".sys";
+        bWritten = WriteBytes(objWriter, PACKAGE + "\\" + strName, Content(strName, NewFileSize(i), 2), strError);
+    }
+    CHECK(bWritten);
+    REQUIRE(objWriter.Commit(strError));
+
+    // 写入后的卷和新文件的清单（格式与gen_ntfs_fixture.py的清单相同）
+    std::vector<uint8_t> vecWritten = objDevice.Data();
+    std::ofstream objOutput(strDir + "/written.img", std::ios::binary);
+    objOutput.write(reinterpret_cast<const char*>(vecWritten.data()), static_cast<std::streamsize>(vecWritten.size()));
+    std::ofstream objManifest(strDir + "/written-manifest.txt");
+    for (size_t i = 0; i < NEW_FILES; i++) {
+        std::string strName = "file" + std::to_string(i) + ".sys";
+        std::vector<uint8_t> vecData = Content(strName, NewFileSize(i), 2);
+        char szCrc[16];
+        snprintf(szCrc, sizeof(szCrc), "%08x", Crc32::Ieee(vecData.data(), vecData.size()));
+        objManifest << szCrc << ' ' << vecData.size() << ' ' << PACKAGE << '\\' << strName << '\n';
+    }
+    CHECK(objOutput.good() && objManifest.good());
+}
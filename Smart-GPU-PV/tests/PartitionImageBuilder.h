@@ -0,0 +1,237 @@
+﻿/********************************************************************************
+* 文件名称：PartitionImageBuilder.h
+* 文件功能：测试用的分区磁盘生成器，在内存中写出GPT或MBR分区表
+*
+* 类说明：
+*    与VhdxImageBuilder、NtfsImageBuilder一样按规范从零生成，扇区固定为512字节：
+*    - GPT：保护性MBR；LBA 1主头部；LBA 2起128项分区数组（32个扇区）；
+*      磁盘末尾33个扇区为备份数组和备份头部
+*    - MBR：4个主分区项；SetExtended之后添加的逻辑分区依次放在扩展分区中，
+*      每个逻辑分区前是它的EBR（EBR与分区之间相隔m_ui32LogicalGap个扇区）
+*    CorruptPrimaryHeader、CorruptPrimaryArray、CorruptBackupHeader在写出CRC
+*    之后修改字节，用于验证校验和备份分区表；PlaceVolume把卷内容（例如
+*    NtfsImageBuilder生成的卷）放到指定偏移。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "../Smart-GPU-PV/BlockDevice.h"
+#include "../Smart-GPU-PV/ContentHash.h"
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+/********************************************************************************
+* 类名称：分区磁盘生成器
+*
+* 调用示例：
+*    PartitionImageBuilder objBuilder(32 * 1024 * 1024);
+*    objBuilder.AddGptPartition(PartitionImageBuilder::GptBasicData(), 2048, 10239, u"Windows");
+*    objBuilder.PlaceVolume(2048 * 512, vecVolume);
+*    MemoryBlockDevice objDisk(objBuilder.BuildGpt());
+*********************************************************************************/
+class PartitionImageBuilder {
+public:
+    static constexpr uint32_t SECTOR_SIZE = 512;
+    static constexpr uint32_t GPT_ENTRIES = 128;
+    static constexpr uint32_t GPT_ENTRY_SIZE = 128;
+    static constexpr uint64_t GPT_ARRAY_SECTORS = GPT_ENTRIES * GPT_ENTRY_SIZE / SECTOR_SIZE;
+
+    // GPT分区项
+    struct GptEntry {
+        DiskGuid        objType;
+        uint64_t        ui64FirstLba;
+        uint64_t        ui64LastLba;
+        std::u16string  strName;
+        uint64_t        ui64Attributes;
+    };
+
+    // MBR分区项（逻辑分区的ui32FirstLba由生成器决定）
+    struct MbrEntry {
+        uint8_t         ui8Type;
+        uint32_t        ui32FirstLba;
+        uint32_t        ui32Sectors;
+        bool            bActive;
+    };
+
+    explicit PartitionImageBuilder(uint64_t ui64DiskSize, uint32_t ui32LogicalGap = 63)
+        : m_ui64DiskSize(ui64DiskSize), m_ui32LogicalGap(ui32LogicalGap) {
+    }
+
+    static DiskGuid GptBasicData() { return DiskGuid::Make(0xEBD0A0A2, 0xB9E5, 0x4433, 0x87C068B6B72699C7ULL); }
+    static DiskGuid GptEfiSystem() { return DiskGuid::Make(0xC12A7328, 0xF81F, 0x11D2, 0xBA4B00A0C93EC93BULL); }
+    static DiskGuid GptMsr() { return DiskGuid::Make(0xE3C9E316, 0x0B5C, 0x4DB8, 0x817DF92DF00215AEULL); }
+    static DiskGuid GptRecovery() { return DiskGuid::Make(0xDE94BBA4, 0x06D1, 0x4D40, 0xA16ABFD50179D6ACULL); }
+
+    uint64_t LastLba() const { return m_ui64DiskSize / SECTOR_SIZE - 1; }
+    uint64_t FirstUsableLba() const { return 2 + GPT_ARRAY_SECTORS; }
+    uint64_t LastUsableLba() const { return LastLba() - 1 - GPT_ARRAY_SECTORS; }
+
+    // 添加GPT分区（按添加顺序写入分区数组，可以不在可用区域内，用于验证被忽略）
+    void AddGptPartition(const DiskGuid& objType, uint64_t ui64FirstLba, uint64_t ui64LastLba,
+                         const std::u16string& strName = u"", uint64_t ui64Attributes = 0) {
+        m_vecGpt.push_back({ objType, ui64FirstLba, ui64LastLba, strName, ui64Attributes });
+    }
+
+    // 添加MBR主分区
+    void AddPrimary(uint8_t ui8Type, uint32_t ui32FirstLba, uint32_t ui32Sectors, bool bActive = false) {
+        m_vecPrimary.push_back({ ui8Type, ui32FirstLba, ui32Sectors, bActive });
+    }
+
+    // 设置扩展分区（占一个主分区项）；之后用AddLogical在其中依次添加逻辑分区
+    void SetExtended(uint32_t ui32FirstLba, uint32_t ui32Sectors, uint8_t ui8Type = 0x0F) {
+        m_vecPrimary.push_back({ ui8Type, ui32FirstLba, ui32Sectors, false });
+        m_ui32ExtendedLba = ui32FirstLba;
+        m_ui32NextEbr = ui32FirstLba;
+    }
+
+    // 添加逻辑分区，返回分区的起始LBA
+    uint32_t AddLogical(uint8_t ui8Type, uint32_t ui32Sectors) {
+        uint32_t ui32Ebr = m_ui32NextEbr;
+        m_vecLogical.push_back({ ui8Type, ui32Ebr, ui32Sectors, false });
+        m_ui32NextEbr = ui32Ebr + m_ui32LogicalGap + ui32Sectors;
+        return ui32Ebr + m_ui32LogicalGap;
+    }
+
+    // 把卷内容放到磁盘偏移处
+    void PlaceVolume(uint64_t ui64Offset, const std::vector<uint8_t>& vecVolume) {
+        m_mapVolumes[ui64Offset] = vecVolume;
+    }
+
+    void CorruptPrimaryHeader() { m_bCorruptPrimaryHeader = true; }
+    void CorruptPrimaryArray() { m_bCorruptPrimaryArray = true; }
+    void CorruptBackupHeader() { m_bCorruptBackupHeader = true; }
+
+    /********************************************************************************
+    * 函数名称：生成GPT磁盘
+    * 返回类型：std::vector<uint8_t>
+    *********************************************************************************/
+    std::vector<uint8_t> BuildGpt() {
+        std::vector<uint8_t> vecDisk = NewDisk();
+        uint8_t* pDisk = vecDisk.data();
+
+        // 1. 保护性MBR：一个0xEE分区覆盖整个磁盘
+        uint8_t* pEntry = pDisk + 446;
+        pEntry[4] = 0xEE;
+        Put32(pEntry + 8, 1);
+        Put32(pEntry + 12, static_cast<uint32_t>(LastLba() > 0xFFFFFFFF ? 0xFFFFFFFF : LastLba()));
+        pDisk[510] = 0x55;
+        pDisk[511] = 0xAA;
+
+        // 2. 分区数组（主备内容相同）
+        std::vector<uint8_t> vecArray(GPT_ENTRIES * GPT_ENTRY_SIZE, 0);
+        for (size_t i = 0; i < m_vecGpt.size() && i < GPT_ENTRIES; i++) {
+            const GptEntry& stcEntry = m_vecGpt[i];
+            uint8_t* p = vecArray.data() + i * GPT_ENTRY_SIZE;
+            memcpy(p, stcEntry.objType.ui8Bytes, 16);
+            for (int j = 0; j < 16; j++) p[16 + j] = static_cast<uint8_t>(0xA0 + i + j);
+            Put64(p + 32, stcEntry.ui64FirstLba);
+            Put64(p + 40, stcEntry.ui64LastLba);
+            Put64(p + 48, stcEntry.ui64Attributes);
+            for (size_t j = 0; j < stcEntry.strName.size() && j < 36; j++) {
+                Put16(p + 56 + 2 * j, static_cast<uint16_t>(stcEntry.strName[j]));
+            }
+        }
+        uint32_t ui32ArrayCrc = Crc32::Ieee(vecArray.data(), vecArray.size());
+        const uint64_t ui64BackupArrayLba = LastLba() - GPT_ARRAY_SECTORS;
+        memcpy(pDisk + 2 * SECTOR_SIZE, vecArray.data(), vecArray.size());
+        memcpy(pDisk + ui64BackupArrayLba * SECTOR_SIZE, vecArray.data(), vecArray.size());
+
+        // 3. 主头部和备份头部：自身LBA、对方LBA和数组位置互换
+        WriteGptHeader(pDisk + SECTOR_SIZE, 1, LastLba(), 2, ui32ArrayCrc);
+        WriteGptHeader(pDisk + LastLba() * SECTOR_SIZE, LastLba(), 1, ui64BackupArrayLba, ui32ArrayCrc);
+
+        // 4. 在CRC写好之后破坏（头部签名仍然有效，只有校验和不符）
+        if (m_bCorruptPrimaryHeader) pDisk[SECTOR_SIZE + 40] ^= 0x01;
+        if (m_bCorruptPrimaryArray) pDisk[2 * SECTOR_SIZE + 32] ^= 0x01;
+        if (m_bCorruptBackupHeader) pDisk[LastLba() * SECTOR_SIZE + 40] ^= 0x01;
+        return vecDisk;
+    }
+
+    /********************************************************************************
+    * 函数名称：生成MBR磁盘
+    * 返回类型：std::vector<uint8_t>
+    *********************************************************************************/
+    std::vector<uint8_t> BuildMbr() {
+        std::vector<uint8_t> vecDisk = NewDisk();
+        uint8_t* pDisk = vecDisk.data();
+
+        // 1. 主分区表
+        for (size_t i = 0; i < m_vecPrimary.size() && i < 4; i++) {
+            WriteMbrEntry(pDisk + 446 + 16 * i, m_vecPrimary[i].ui8Type, m_vecPrimary[i].ui32FirstLba,
+                          m_vecPrimary[i].ui32Sectors, m_vecPrimary[i].bActive);
+        }
+        pDisk[510] = 0x55;
+        pDisk[511] = 0xAA;
+
+        // 2. EBR链：第一项相对当前EBR，第二项指向下一个EBR（相对扩展分区起点）
+        for (size_t i = 0; i < m_vecLogical.size(); i++) {
+            const MbrEntry& stcLogical = m_vecLogical[i];
+            uint8_t* pEbr = pDisk + static_cast<uint64_t>(stcLogical.ui32FirstLba) * SECTOR_SIZE;
+            WriteMbrEntry(pEbr + 446, stcLogical.ui8Type, m_ui32LogicalGap, stcLogical.ui32Sectors, false);
+            if (i + 1 < m_vecLogical.size()) {
+                const MbrEntry& stcNext = m_vecLogical[i + 1];
+                WriteMbrEntry(pEbr + 462, 0x05, stcNext.ui32FirstLba - m_ui32ExtendedLba,
+                              m_ui32LogicalGap + stcNext.ui32Sectors, false);
+            }
+            pEbr[510] = 0x55;
+            pEbr[511] = 0xAA;
+        }
+        return vecDisk;
+    }
+
+private:
+    uint64_t                                     m_ui64DiskSize;
+    uint32_t                                     m_ui32LogicalGap;
+    uint32_t                                     m_ui32ExtendedLba = 0;
+    uint32_t                                     m_ui32NextEbr = 0;
+    bool                                         m_bCorruptPrimaryHeader = false;
+    bool                                         m_bCorruptPrimaryArray = false;
+    bool                                         m_bCorruptBackupHeader = false;
+    std::vector<GptEntry>                        m_vecGpt;
+    std::vector<MbrEntry>                        m_vecPrimary;
+    std::vector<MbrEntry>                        m_vecLogical;
+    std::map<uint64_t, std::vector<uint8_t>>     m_mapVolumes;
+
+    static void Put16(uint8_t* p, uint16_t v) { memcpy(p, &v, sizeof(v)); }
+    static void Put32(uint8_t* p, uint32_t v) { memcpy(p, &v, sizeof(v)); }
+    static void Put64(uint8_t* p, uint64_t v) { memcpy(p, &v, sizeof(v)); }
+
+    // 空磁盘，卷内容先放入（分区表随后写入，不会被卷覆盖）
+    std::vector<uint8_t> NewDisk() const {
+        std::vector<uint8_t> vecDisk(static_cast<size_t>(m_ui64DiskSize), 0);
+        for (const auto& [ui64Offset, vecVolume] : m_mapVolumes) {
+            memcpy(vecDisk.data() + ui64Offset, vecVolume.data(), vecVolume.size());
+        }
+        return vecDisk;
+    }
+
+    void WriteGptHeader(uint8_t* p, uint64_t ui64MyLba, uint64_t ui64AlternateLba, uint64_t ui64EntryLba,
+                        uint32_t ui32ArrayCrc) const {
+        memcpy(p, "EFI PART", 8);
+        Put32(p + 8, 0x00010000);
+        Put32(p + 12, 92);
+        Put64(p + 24, ui64MyLba);
+        Put64(p + 32, ui64AlternateLba);
+        Put64(p + 40, FirstUsableLba());
+        Put64(p + 48, LastUsableLba());
+        for (int i = 0; i < 16; i++) p[56 + i] = static_cast<uint8_t>(0x10 + i);
+        Put64(p + 72, ui64EntryLba);
+        Put32(p + 80, GPT_ENTRIES);
+        Put32(p + 84, GPT_ENTRY_SIZE);
+        Put32(p + 88, ui32ArrayCrc);
+        Put32(p + 16, Crc32::Ieee(p, 92));
+    }
+
+    static void WriteMbrEntry(uint8_t* p, uint8_t ui8Type, uint32_t ui32FirstLba, uint32_t ui32Sectors, bool bActive) {
+        p[0] = bActive ? 0x80 : 0x00;
+        p[4] = ui8Type;
+        Put32(p + 8, ui32FirstLba);
+        Put32(p + 12, ui32Sectors);
+    }
+};
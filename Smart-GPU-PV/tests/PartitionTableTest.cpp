@@ -0,0 +1,248 @@
+﻿/********************************************************************************
+* 文件名称：PartitionTableTest.cpp
+* 文件功能：在生成的磁盘上验证GPT校验与备份分区表、MBR的EBR链、整盘NTFS卷
+*           以及FindWindowsPartition的分区筛选和探测
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "NtfsImageBuilder.h"
+#include "PartitionImageBuilder.h"
+#include "../Smart-GPU-PV/NtfsVolume.h"
+#include "../Smart-GPU-PV/PartitionTable.h"
+
+static const uint64_t MB = NtfsImageBuilder::MB;
+static const uint64_t SECTOR = PartitionImageBuilder::SECTOR_SIZE;
+
+// NTFS卷；bWindows时包含Windows\System32目录
+static std::vector<uint8_t> NtfsVolumeImage(uint64_t ui64Size, bool bWindows) {
+    NtfsImageBuilder objBuilder(ui64Size);
+    if (bWindows) {
+        uint64_t ui64Windows = objBuilder.AddDirectory(NtfsImageBuilder::ROOT, u"Windows");
+        objBuilder.AddDirectory(ui64Windows, u"System32");
+    } else {
+        objBuilder.AddFile(NtfsImageBuilder::ROOT, u"data.bin", { 1, 2, 3 });
+    }
+    return objBuilder.Build();
+}
+
+/********************************************************************************
+* GPT磁盘（24MB）：分区表顺序与磁盘上的位置不同
+*    1 EFI系统分区        2048~4095
+*    2 MSR                4096~6143
+*    3 恢复分区           30720~34815   含Windows\System32，但不是基本数据分区
+*    - 起点在可用区域之前的项（被忽略）
+*    4 基本数据"Data"     6144~22527    8MB，不含Windows
+*    5 基本数据"Windows"  22528~30719   4MB，含Windows\System32
+*    6 基本数据（未格式化）34816~36863
+*********************************************************************************/
+static PartitionImageBuilder GptDisk() {
+    PartitionImageBuilder objBuilder(24 * MB);
+    objBuilder.AddGptPartition(PartitionImageBuilder::GptEfiSystem(), 2048, 4095, u"EFI system partition", 0x8000000000000000ULL);
+    objBuilder.AddGptPartition(PartitionImageBuilder::GptMsr(), 4096, 6143, u"Microsoft reserved partition");
+    objBuilder.AddGptPartition(PartitionImageBuilder::GptRecovery(), 30720, 34815, u"Recovery");
+    objBuilder.AddGptPartition(PartitionImageBuilder::GptBasicData(), 10, 100, u"Outside");
+    objBuilder.AddGptPartition(PartitionImageBuilder::GptBasicData(), 6144, 22527, u"Data");
+    objBuilder.AddGptPartition(PartitionImageBuilder::GptBasicData(), 22528, 30719, u"Windows \U0001F600");
+    objBuilder.AddGptPartition(PartitionImageBuilder::GptBasicData(), 34816, 36863);
+    objBuilder.PlaceVolume(30720 * SECTOR, NtfsVolumeImage(2 * MB, true));
+    objBuilder.PlaceVolume(6144 * SECTOR, NtfsVolumeImage(8 * MB, false));
+    objBuilder.PlaceVolume(22528 * SECTOR, NtfsVolumeImage(4 * MB, true));
+    return objBuilder;
+}
+
+// 检查GptDisk()的分区（不论来自主分区表还是备份分区表）
+static void CheckGptPartitions(const std::vector<PartitionInfo>& vecPartitions) {
+    REQUIRE(vecPartitions.size() == 6);
+    const uint64_t ui64Expected[6][2] = {
+        { 2048, 4095 }, { 4096, 6143 }, { 30720, 34815 }, { 6144, 22527 }, { 22528, 30719 }, { 34816, 36863 }
+    };
+    for (size_t i = 0; i < vecPartitions.size(); i++) {
+        CHECK_EQ(vecPartitions[i].nNumber, static_cast<uint32_t>(i + 1));
+        CHECK(vecPartitions[i].bGpt);
+        CHECK_EQ(vecPartitions[i].ui64Offset, ui64Expected[i][0] * SECTOR);
+        CHECK_EQ(vecPartitions[i].ui64Length, (ui64Expected[i][1] - ui64Expected[i][0] + 1) * SECTOR);
+    }
+    CHECK_EQ(vecPartitions[0].TypeName(), std::string("EFI系统分区"));
+    CHECK_EQ(vecPartitions[0].ui64Attributes, 0x8000000000000000ULL);
+    CHECK_EQ(vecPartitions[0].strName, std::string("EFI system partition"));
+    CHECK_EQ(vecPartitions[1].TypeName(), std::string("Microsoft保留分区"));
+    CHECK_EQ(vecPartitions[2].TypeName(), std::string("Windows恢复分区"));
+    CHECK(!vecPartitions[2].IsBasicData());
+    CHECK(vecPartitions[3].IsBasicData());
+    CHECK_EQ(vecPartitions[4].strName, std::string("Windows \xF0\x9F\x98\x80"));     // UTF-16代理对
+    CHECK(vecPartitions[5].strName.empty());
+}
+
+TEST_CASE(GptPartitionsAreReadInTableOrder) {
+    MemoryBlockDevice objDisk(GptDisk().BuildGpt());
+    PartitionScheme eScheme;
+    std::vector<PartitionInfo> vecPartitions;
+    std::string strError;
+    REQUIRE(PartitionTable::Read(objDisk, eScheme, vecPartitions, strError));
+    CHECK(eScheme == PartitionScheme::Gpt);
+    CheckGptPartitions(vecPartitions);
+}
+
+TEST_CASE(CorruptPrimaryGptHeaderFallsBackToBackup) {
+    PartitionImageBuilder objBuilder = GptDisk();
+    objBuilder.CorruptPrimaryHeader();
+    MemoryBlockDevice objDisk(objBuilder.BuildGpt());
+    PartitionScheme eScheme;
+    std::vector<PartitionInfo> vecPartitions;
+    std::string strError;
+    REQUIRE(PartitionTable::Read(objDisk, eScheme, vecPartitions, strError));
+    CHECK(eScheme == PartitionScheme::Gpt);
+    CheckGptPartitions(vecPartitions);
+
+    // 主头部损坏时按磁盘最后一个LBA找备份；备份也损坏时两处的错误都返回
+    PartitionImageBuilder objBoth = GptDisk();
+    objBoth.CorruptPrimaryHeader();
+    objBoth.CorruptBackupHeader();
+    MemoryBlockDevice objBroken(objBoth.BuildGpt());
+    CHECK(!PartitionTable::Read(objBroken, eScheme, vecPartitions, strError));
+    CHECK(strError.find("都已损坏") != std::string::npos);
+    CHECK(strError.find("GPT头部校验失败（LBA 1）") != std::string::npos);
+    CHECK(vecPartitions.empty());
+}
+
+TEST_CASE(BadPrimaryArrayCrcFallsBackToBackup) {
+    // 1. 主数组第一项的起始LBA被改为2049：CRC不符，读出的仍是备份数组中的2048
+    PartitionImageBuilder objBuilder = GptDisk();
+    objBuilder.CorruptPrimaryArray();
+    MemoryBlockDevice objDisk(objBuilder.BuildGpt());
+    PartitionScheme eScheme;
+    std::vector<PartitionInfo> vecPartitions;
+    std::string strError;
+    REQUIRE(PartitionTable::Read(objDisk, eScheme, vecPartitions, strError));
+    CheckGptPartitions(vecPartitions);
+
+    // 2. 主数组损坏且备份头部损坏
+    PartitionImageBuilder objBoth = GptDisk();
+    objBoth.CorruptPrimaryArray();
+    objBoth.CorruptBackupHeader();
+    MemoryBlockDevice objBroken(objBoth.BuildGpt());
+    CHECK(!PartitionTable::Read(objBroken, eScheme, vecPartitions, strError));
+    CHECK(strError.find("GPT分区项数组校验失败") != std::string::npos);
+
+    // 3. 定位系统分区同样使用备份数组
+    PartitionInfo stcPartition;
+    CHECK(PartitionTable::FindWindowsPartition(objDisk, NtfsVolume::IsWindowsSystemVolume, stcPartition, strError));
+    CHECK_EQ(stcPartition.ui64Offset, 22528 * SECTOR);
+}
+
+TEST_CASE(MbrWalksExtendedPartitionChain) {
+    // 两个主分区 + 扩展分区中的三个逻辑分区；逻辑分区排在主分区之后编号
+    PartitionImageBuilder objBuilder(16 * MB);
+    objBuilder.AddPrimary(0x07, 2048, 2048, true);
+    objBuilder.AddPrimary(0x0B, 4096, 2048);
+    objBuilder.SetExtended(8192, 24000);
+    uint32_t ui32First = objBuilder.AddLogical(0x07, 6144);
+    uint32_t ui32Second = objBuilder.AddLogical(0x07, 4096);
+    uint32_t ui32Third = objBuilder.AddLogical(0x83, 1024);
+    objBuilder.PlaceVolume(ui32First * SECTOR, NtfsVolumeImage(3 * MB, false));
+    objBuilder.PlaceVolume(ui32Second * SECTOR, NtfsVolumeImage(2 * MB, true));
+    std::vector<uint8_t> vecImage = objBuilder.BuildMbr();
+
+    MemoryBlockDevice objDisk(vecImage);
+    PartitionScheme eScheme;
+    std::vector<PartitionInfo> vecPartitions;
+    std::string strError;
+    REQUIRE(PartitionTable::Read(objDisk, eScheme, vecPartitions, strError));
+    CHECK(eScheme == PartitionScheme::Mbr);
+    REQUIRE(vecPartitions.size() == 5);
+    const uint64_t ui64Expected[5][3] = {
+        { 0x07, 2048, 2048 }, { 0x0B, 4096, 2048 },
+        { 0x07, ui32First, 6144 }, { 0x07, ui32Second, 4096 }, { 0x83, ui32Third, 1024 }
+    };
+    for (size_t i = 0; i < vecPartitions.size(); i++) {
+        CHECK_EQ(vecPartitions[i].nNumber, static_cast<uint32_t>(i + 1));
+        CHECK(!vecPartitions[i].bGpt);
+        CHECK_EQ(static_cast<uint64_t>(vecPartitions[i].ui8MbrType), ui64Expected[i][0]);
+        CHECK_EQ(vecPartitions[i].ui64Offset, ui64Expected[i][1] * SECTOR);
+        CHECK_EQ(vecPartitions[i].ui64Length, ui64Expected[i][2] * SECTOR);
+    }
+    CHECK(vecPartitions[0].bActive);
+    CHECK(!vecPartitions[1].bActive);
+    CHECK_EQ(vecPartitions[1].TypeName(), std::string("FAT32"));
+    CHECK_EQ(vecPartitions[4].TypeName(), std::string("MBR 0x83"));
+
+    // 第二个逻辑分区中的Windows卷（第一个逻辑分区更大但不含Windows）
+    PartitionInfo stcPartition;
+    REQUIRE(PartitionTable::FindWindowsPartition(objDisk, NtfsVolume::IsWindowsSystemVolume, stcPartition, strError));
+    CHECK_EQ(stcPartition.nNumber, 4u);
+    CHECK_EQ(stcPartition.ui64Offset, static_cast<uint64_t>(ui32Second) * SECTOR);
+
+    // 第二个EBR没有0x55AA签名：链在此结束，只剩第一个逻辑分区
+    const uint64_t ui64SecondEbr = ui32Second - 63;
+    vecImage[ui64SecondEbr * SECTOR + 510] = 0;
+    MemoryBlockDevice objTruncated(vecImage);
+    REQUIRE(PartitionTable::Read(objTruncated, eScheme, vecPartitions, strError));
+    REQUIRE(vecPartitions.size() == 3);
+    CHECK_EQ(vecPartitions[2].ui64Offset, static_cast<uint64_t>(ui32First) * SECTOR);
+}
+
+TEST_CASE(WholeDiskNtfsVolumeIsOnePartition) {
+    // NTFS引导扇区也带0x55AA签名，不能被当作MBR解析
+    MemoryBlockDevice objDisk(NtfsVolumeImage(4 * MB, true));
+    PartitionScheme eScheme;
+    std::vector<PartitionInfo> vecPartitions;
+    std::string strError;
+    REQUIRE(PartitionTable::Read(objDisk, eScheme, vecPartitions, strError));
+    CHECK(eScheme == PartitionScheme::None);
+    REQUIRE(vecPartitions.size() == 1);
+    CHECK_EQ(vecPartitions[0].ui64Offset, uint64_t(0));
+    CHECK_EQ(vecPartitions[0].ui64Length, 4 * MB);
+    CHECK(vecPartitions[0].IsBasicData());
+
+    PartitionInfo stcPartition;
+    CHECK(PartitionTable::FindWindowsPartition(objDisk, NtfsVolume::IsWindowsSystemVolume, stcPartition, strError));
+    CHECK_EQ(stcPartition.ui64Length, 4 * MB);
+}
+
+TEST_CASE(FindWindowsPartitionProbesOnlyBasicDataNtfsVolumes) {
+    MemoryBlockDevice objDisk(GptDisk().BuildGpt());
+    std::string strError;
+
+    // 1. 探测函数只收到基本数据分区中的NTFS卷（恢复分区和未格式化分区被排除）
+    std::vector<uint64_t> vecProbed;
+    auto fnProbe = [&vecProbed](BlockDevice& objVolume) {
+        vecProbed.push_back(objVolume.Size());
+        return NtfsVolume::IsWindowsSystemVolume(objVolume);
+    };
+    PartitionInfo stcPartition;
+    REQUIRE(PartitionTable::FindWindowsPartition(objDisk, fnProbe, stcPartition, strError));
+    CHECK_EQ(stcPartition.nNumber, 5u);
+    CHECK_EQ(stcPartition.ui64Offset, 22528 * SECTOR);
+    CHECK(vecProbed == std::vector<uint64_t>({ 8 * MB, 4 * MB }));
+
+    // 2. 没有探测函数时返回最大的NTFS基本数据分区
+    REQUIRE(PartitionTable::FindWindowsPartition(objDisk, nullptr, stcPartition, strError));
+    CHECK_EQ(stcPartition.nNumber, 4u);
+    CHECK_EQ(stcPartition.strName, std::string("Data"));
+
+    // 3. 探测全部失败
+    CHECK(!PartitionTable::FindWindowsPartition(objDisk, [](BlockDevice&) { return false; }, stcPartition, strError));
+    CHECK_EQ(strError, std::string("没有找到包含Windows系统的分区"));
+}
+
+TEST_CASE(DiskWithoutPartitionTable) {
+    // 1. 没有0x55AA签名：成功读取，没有分区
+    MemoryBlockDevice objEmpty(std::vector<uint8_t>(MB, 0));
+    PartitionScheme eScheme = PartitionScheme::Gpt;
+    std::vector<PartitionInfo> vecPartitions(1);
+    std::string strError;
+    CHECK(PartitionTable::Read(objEmpty, eScheme, vecPartitions, strError));
+    CHECK(eScheme == PartitionScheme::None);
+    CHECK(vecPartitions.empty());
+    PartitionInfo stcPartition;
+    CHECK(!PartitionTable::FindWindowsPartition(objEmpty, nullptr, stcPartition, strError));
+    CHECK_EQ(strError, std::string("没有找到NTFS基本数据分区"));
+
+    // 2. 不足两个扇区
+    MemoryBlockDevice objTiny(std::vector<uint8_t>(512, 0));
+    CHECK(!PartitionTable::Read(objTiny, eScheme, vecPartitions, strError));
+}
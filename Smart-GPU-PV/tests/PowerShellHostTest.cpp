@@ -0,0 +1,465 @@
+﻿/********************************************************************************
+* 文件名称：PowerShellHostTest.cpp
+* 文件功能：通过替身进程验证宿主帧协议、宿主进程池和崩溃重建
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "FakeProcessBackend.h"
+#include "../Smart-GPU-PV/PowerShellExecutor.h"
+#include "../Smart-GPU-PV/PowerShellHost.h"
+#include "../Smart-GPU-PV/ScriptRegistry.h"
+#include <thread>
+
+// 测试用的脚本函数：宿主启动时应在第一条请求中加载
+static const ScriptDefinition TEST_FUNCTION("Test-SgpHostFunction", "'loaded'");
+
+static std::shared_ptr<FakeProcessBackend> MakeBackend() {
+    return std::make_shared<FakeProcessBackend>();
+}
+
+TEST_CASE(StartWaitsForReadyAndLoadsScriptFunctions) {
+    auto pBackend = MakeBackend();
+    std::vector<std::string> vecSeen;
+    pBackend->stcConfig.fnHandler = [&vecSeen](const std::string& strCommand) {
+        vecSeen.push_back(strCommand);
+        CommandResult stcResult;
+        stcResult.nExitCode = 0;
+        return stcResult;
+    };
+
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+    CHECK(objHost.IsHealthy());
+    REQUIRE(vecSeen.size() == 1);
+    CHECK(vecSeen[0] == ScriptRegistry::Instance().BuildSessionScript());
+    CHECK(vecSeen[0].find("Test-SgpHostFunction") != std::string::npos);
+}
+
+TEST_CASE(StartFailsWhenScriptFunctionsFailToLoad) {
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.fnHandler = [](const std::string&) {
+        CommandResult stcResult;
+        stcResult.nExitCode = 1;
+        stcResult.strError = "parse error";
+        return stcResult;
+    };
+
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    CHECK(!objHost.Start(strError));
+    CHECK(!objHost.IsHealthy());
+    CHECK(strError.find("parse error") != std::string::npos);
+}
+
+TEST_CASE(StartFailsWhenHostExitsBeforeReady) {
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.bNoReady = true;
+
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    CHECK(!objHost.Start(strError));
+    CHECK(!strError.empty());
+    CHECK(!objHost.IsHealthy());
+}
+
+TEST_CASE(ExecuteRoundTripsBinaryAndUnicodeOutput) {
+    auto pBackend = MakeBackend();
+    const std::string strPayload = std::string("行1 ##SGP-FRAME## 99 0 x y\r\n\0tail", 37);
+    pBackend->stcConfig.fnHandler = [&strPayload](const std::string& strCommand) {
+        CommandResult stcResult;
+        stcResult.nExitCode = strCommand == "fail" ? 7 : 0;
+        stcResult.strOutput = strPayload;
+        stcResult.strError = strCommand == "fail" ? "错误" : "";
+        return stcResult;
+    };
+
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+
+    CommandResult stcResult;
+    bool bSent = false;
+    REQUIRE(objHost.Execute("Get-VM", 5000, stcResult, bSent));
+    CHECK(bSent);
+    CHECK_EQ(stcResult.nExitCode, 0);
+    CHECK(stcResult.strOutput == strPayload);
+
+    REQUIRE(objHost.Execute("fail", 5000, stcResult, bSent));
+    CHECK_EQ(stcResult.nExitCode, 7);
+    CHECK(stcResult.strError == "错误");
+    CHECK(objHost.IsHealthy());
+}
+
+TEST_CASE(NoiseAndStaleFramesAreIgnored) {
+    auto pBackend = MakeBackend();
+    // 每个响应帧之前输出：普通文本、残缺帧、序号过期的帧、序号不是数字的帧
+    pBackend->stcConfig.fnExtraLines = [](uint64_t ui64Seq) {
+        return std::vector<std::string>{
+            "WARNING: something",
+            "##SGP-FRAME##",
+            "##SGP-FRAME## " + std::to_string(ui64Seq - 1) + " 0 " + Utils::Base64Encode("stale") + " ",
+            "##SGP-FRAME## abc 0 eA== eA==",
+            " ##SGP-FRAME## " + std::to_string(ui64Seq) + " 5 eA== eA==",
+        };
+    };
+
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+
+    for (int i = 0; i < 3; i++) {
+        CommandResult stcResult;
+        bool bSent = false;
+        REQUIRE(objHost.Execute("cmd" + std::to_string(i), 5000, stcResult, bSent));
+        CHECK_EQ(stcResult.nExitCode, 0);
+        CHECK_EQ(stcResult.strOutput, "cmd" + std::to_string(i));
+    }
+}
+
+TEST_CASE(ErrorWithEmptyOutputStaysInErrorField) {
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.fnHandler = [](const std::string& strCommand) {
+        CommandResult stcResult;
+        stcResult.nExitCode = strCommand == "x" ? 1 : 0;
+        stcResult.strError = strCommand == "x" ? "only stderr" : "";
+        return stcResult;
+    };
+
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+    CommandResult stcResult;
+    bool bSent = false;
+    REQUIRE(objHost.Execute("x", 5000, stcResult, bSent));
+    CHECK_EQ(stcResult.nExitCode, 1);
+    CHECK(stcResult.strOutput.empty());
+    CHECK_EQ(stcResult.strError, std::string("only stderr"));
+}
+
+TEST_CASE(FrameWithEmptyOutputFieldsParses) {
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.fnHandler = [](const std::string& strCommand) {
+        CommandResult stcResult;
+        stcResult.nExitCode = strCommand == "x" ? 3 : 0;
+        return stcResult;
+    };
+
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+    CommandResult stcResult;
+    stcResult.strOutput = "previous";
+    bool bSent = false;
+    REQUIRE(objHost.Execute("x", 5000, stcResult, bSent));
+    CHECK_EQ(stcResult.nExitCode, 3);
+    CHECK(stcResult.strOutput.empty());
+    CHECK(stcResult.strError.empty());
+}
+
+TEST_CASE(BatchReturnsResultPerCommandAndStopsOnError) {
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.fnHandler = [](const std::string& strCommand) {
+        CommandResult stcResult;
+        stcResult.nExitCode = strCommand == "bad" ? 2 : 0;
+        stcResult.strOutput = strCommand;
+        return stcResult;
+    };
+
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+    size_t nRequestsBefore = pBackend->stcStats.nRequests;
+
+    std::vector<CommandResult> vecResults;
+    bool bSent = false;
+    REQUIRE(objHost.ExecuteBatch({ "a", "bad", "c" }, false, 5000, vecResults, bSent));
+    REQUIRE(vecResults.size() == 3);
+    CHECK_EQ(vecResults[0].strOutput, "a");
+    CHECK_EQ(vecResults[1].nExitCode, 2);
+    CHECK_EQ(vecResults[2].strOutput, "c");
+
+    REQUIRE(objHost.ExecuteBatch({ "a", "bad", "c" }, true, 5000, vecResults, bSent));
+    REQUIRE(vecResults.size() == 3);
+    CHECK_EQ(vecResults[1].nExitCode, 2);
+    CHECK_EQ(vecResults[2].nExitCode, -1);
+    CHECK(vecResults[2].strOutput.empty());
+
+    // 每个批次只有一次往返
+    CHECK_EQ(pBackend->stcStats.nRequests - nRequestsBefore, static_cast<size_t>(2));
+}
+
+TEST_CASE(CrashMidBatchKeepsCompletedResultsAndBreaksHost) {
+    auto pBackend = MakeBackend();
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+
+    std::vector<CommandResult> vecResults;
+    bool bSent = false;
+    CHECK(!objHost.ExecuteBatch({ "a", "crash", "c" }, false, 5000, vecResults, bSent));
+    CHECK(bSent);
+    REQUIRE(vecResults.size() == 1);
+    CHECK_EQ(vecResults[0].strOutput, "a");
+    CHECK(!vecResults[0].bTimedOut);
+    CHECK(!objHost.IsHealthy());
+
+    // 损坏后不再发送请求
+    CHECK(!objHost.ExecuteBatch({ "a" }, false, 5000, vecResults, bSent));
+    CHECK(!bSent);
+}
+
+TEST_CASE(HungHostTimesOutAndMarksRemainingCommands) {
+    auto pBackend = MakeBackend();
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+
+    std::vector<CommandResult> vecResults;
+    bool bSent = false;
+    ULONGLONG ui64Start = GetTickCount64();
+    CHECK(!objHost.ExecuteBatch({ "a", "hang", "c" }, false, 100, vecResults, bSent));
+    ULONGLONG ui64Elapsed = GetTickCount64() - ui64Start;
+    CHECK(ui64Elapsed >= 90);
+    CHECK(ui64Elapsed < 5000);
+    REQUIRE(vecResults.size() == 3);
+    CHECK(!vecResults[0].bTimedOut);
+    CHECK(vecResults[1].bTimedOut);
+    CHECK(vecResults[2].bTimedOut);
+    CHECK_EQ(vecResults[2].nExitCode, static_cast<int>(ERROR_TIMEOUT));
+    CHECK(!objHost.IsHealthy());
+}
+
+TEST_CASE(DeadlineCoversRequestWriteWhenHostStopsReading) {
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.nRequestsBeforeStall = 1;   // 只读取加载脚本函数的请求
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+
+    std::vector<CommandResult> vecResults;
+    bool bSent = false;
+    ULONGLONG ui64Start = GetTickCount64();
+    CHECK(!objHost.ExecuteBatch({ "a", "b" }, false, 100, vecResults, bSent));
+    CHECK(GetTickCount64() - ui64Start < 5000);
+    CHECK(bSent);   // 请求可能已部分写入，不能降级重试
+    REQUIRE(vecResults.size() == 2);
+    CHECK(vecResults[0].bTimedOut);
+    CHECK(vecResults[1].bTimedOut);
+    CHECK(!objHost.IsHealthy());
+}
+
+TEST_CASE(PoolReusesHealthyHost) {
+    auto pBackend = MakeBackend();
+    PowerShellHostPool objPool(pBackend, 2);
+    std::string strError;
+    for (int i = 0; i < 5; i++) {
+        auto objLease = objPool.Acquire(strError);
+        REQUIRE(objLease);
+        CommandResult stcResult;
+        bool bSent = false;
+        CHECK(objLease->Execute("x", 5000, stcResult, bSent));
+    }
+    CHECK_EQ(pBackend->stcStats.nSpawns.load(), static_cast<size_t>(1));
+    CHECK_EQ(objPool.GetRespawnCount(), static_cast<size_t>(0));
+}
+
+TEST_CASE(PoolRespawnsAfterCrashAndBrokenLease) {
+    auto pBackend = MakeBackend();
+    PowerShellHostPool objPool(pBackend, 1);
+    std::string strError;
+
+    // 1. 命令执行中崩溃：租约被标记为损坏，归还时丢弃
+    {
+        auto objLease = objPool.Acquire(strError);
+        REQUIRE(objLease);
+        CommandResult stcResult;
+        bool bSent = false;
+        if (!objLease->Execute("crash", 5000, stcResult, bSent)) {
+            objLease.MarkBroken();
+        }
+    }
+    CHECK_EQ(objPool.GetRespawnCount(), static_cast<size_t>(1));
+
+    // 2. 下次借用时重新启动
+    {
+        auto objLease = objPool.Acquire(strError);
+        REQUIRE(objLease);
+        CommandResult stcResult;
+        bool bSent = false;
+        CHECK(objLease->Execute("ok", 5000, stcResult, bSent));
+    }
+    CHECK_EQ(pBackend->stcStats.nSpawns.load(), static_cast<size_t>(2));
+
+    // 3. 空闲时退出的宿主在借用时被发现并重建
+    pBackend->KillLastHost();
+    {
+        auto objLease = objPool.Acquire(strError);
+        REQUIRE(objLease);
+        CHECK(objLease->IsHealthy());
+    }
+    CHECK_EQ(objPool.GetRespawnCount(), static_cast<size_t>(2));
+    CHECK_EQ(pBackend->stcStats.nSpawns.load(), static_cast<size_t>(3));
+}
+
+TEST_CASE(PoolReturnsEmptyLeaseWhenSpawnFails) {
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.bFailSpawn = true;
+    PowerShellHostPool objPool(pBackend, 1);
+    std::string strError;
+    auto objLease = objPool.Acquire(strError);
+    CHECK(!objLease);
+    CHECK(!strError.empty());
+
+    // 失败的启动不占用名额
+    pBackend->stcConfig.bFailSpawn = false;
+    auto objRetry = objPool.Acquire(strError);
+    CHECK(objRetry);
+}
+
+TEST_CASE(PoolStopsStartingHostsAfterRepeatedFailures) {
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.bNoReady = true;
+    PowerShellHostPool objPool(pBackend, 2);
+    const size_t nLimit = PowerShellHostPool::MAX_START_FAILURES;
+    std::string strError;
+
+    // 1. 连续失败达到上限后不再启动宿主，直接返回空租约
+    for (size_t i = 0; i < nLimit; i++) {
+        CHECK(!objPool.Acquire(strError));
+    }
+    CHECK_EQ(pBackend->stcStats.nSpawns.load(), nLimit);
+    pBackend->stcConfig.bNoReady = false;
+    strError.clear();
+    CHECK(!objPool.Acquire(strError));
+    CHECK(strError.find("已停用") != std::string::npos);
+    CHECK_EQ(pBackend->stcStats.nSpawns.load(), nLimit);
+
+    // 2. Shutdown后重新允许启动；启动成功清零失败计数
+    objPool.Shutdown();
+    CHECK_EQ(objPool.GetStartFailures(), static_cast<size_t>(0));
+    {
+        auto objLease = objPool.Acquire(strError);
+        CHECK(objLease);
+    }
+    pBackend->stcConfig.bNoReady = true;
+    pBackend->KillLastHost();
+    CHECK(!objPool.Acquire(strError));
+    CHECK_EQ(objPool.GetStartFailures(), static_cast<size_t>(1));
+}
+
+TEST_CASE(ExecutorFallsBackWithoutWaitingOnceHostIsDisabled) {
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.bNoReady = true;
+    PowerShellExecutor::SetProcessBackend(pBackend);
+    PowerShellExecutor::EnablePersistentHost(true, 1);
+
+    // 每条命令都由独立进程完成；达到失败上限后不再启动宿主
+    for (int i = 0; i < 5; i++) {
+        CommandResult stcResult;
+        CHECK(PowerShellExecutor::ExecuteWithResult("Get-VM", stcResult));
+        CHECK_EQ(stcResult.strOutput, std::string("Get-VM"));
+    }
+    const size_t nLimit = PowerShellHostPool::MAX_START_FAILURES;
+    CHECK_EQ(pBackend->stcStats.nRuns.load(), static_cast<size_t>(5));
+    CHECK_EQ(pBackend->stcStats.nSpawns.load(), nLimit);
+    PowerShellExecutor::Shutdown();
+}
+
+TEST_CASE(NonTerminatingErrorGivesSameExitCodeOnHostAndOneShot) {
+    // 替身按powershell -Command的语义执行：Write-Error只写错误输出，throw使退出码为1
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.fnHandler = [](const std::string& strCommand) {
+        CommandResult stcResult;
+        stcResult.nExitCode = 0;
+        if (strCommand.find("Write-Error") != std::string::npos) {
+            stcResult.strOutput = "done";
+            stcResult.strError = "Write-Error: disk not found";
+        } else if (strCommand.find("throw") != std::string::npos) {
+            stcResult.nExitCode = 1;
+            stcResult.strError = "fatal";
+        }
+        return stcResult;
+    };
+    PowerShellExecutor::SetProcessBackend(pBackend);
+
+    struct Outcome { bool bOk; int nExitCode; std::string strOutput, strError; };
+    auto Run = [](bool bUseHost, const std::string& strCommand) {
+        PowerShellExecutor::EnablePersistentHost(bUseHost, 1);
+        CommandResult stcResult;
+        bool bOk = PowerShellExecutor::ExecuteWithResult(strCommand, stcResult);
+        return Outcome{ bOk, stcResult.nExitCode, stcResult.strOutput, stcResult.strError };
+    };
+    for (const char* pszCommand : { "Write-Error 'disk not found'; 'done'", "throw 'fatal'" }) {
+        Outcome stcHost = Run(true, pszCommand);
+        Outcome stcOneShot = Run(false, pszCommand);
+        CHECK_EQ(stcHost.bOk, stcOneShot.bOk);
+        CHECK_EQ(stcHost.nExitCode, stcOneShot.nExitCode);
+        CHECK_EQ(stcHost.strOutput, stcOneShot.strOutput);
+        CHECK_EQ(stcHost.strError, stcOneShot.strError);            // 错误流作为错误输出透传
+    }
+    CHECK(Run(true, "Write-Error 'disk not found'; 'done'").bOk);
+    CHECK(pBackend->stcStats.nSpawns.load() > 0);
+    CHECK(pBackend->stcStats.nRuns.load() > 0);
+    PowerShellExecutor::EnablePersistentHost(true, 2);
+    PowerShellExecutor::Shutdown();
+}
+
+TEST_CASE(PoolBlocksAtLimitUntilRelease) {
+    auto pBackend = MakeBackend();
+    PowerShellHostPool objPool(pBackend, 2);
+    std::string strError;
+
+    auto objLease1 = objPool.Acquire(strError);
+    auto objLease2 = objPool.Acquire(strError);
+    REQUIRE(objLease1);
+    REQUIRE(objLease2);
+
+    std::atomic<bool> bAcquired{ false };
+    std::thread objWaiter([&]() {
+        std::string strWaiterError;
+        auto objLease3 = objPool.Acquire(strWaiterError);
+        bAcquired = static_cast<bool>(objLease3);
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!bAcquired);
+    objLease1 = PowerShellHostPool::Lease();
+    objWaiter.join();
+    CHECK(bAcquired);
+    CHECK_EQ(pBackend->stcStats.nSpawns.load(), static_cast<size_t>(2));
+}
+
+TEST_CASE(PoolServesConcurrentCallers) {
+    auto pBackend = MakeBackend();
+    pBackend->stcConfig.ui32RoundTripUs = 200;
+    PowerShellHostPool objPool(pBackend, 3);
+
+    std::atomic<size_t> nMismatches{ 0 };
+    std::vector<std::thread> vecThreads;
+    for (int t = 0; t < 6; t++) {
+        vecThreads.emplace_back([&, t]() {
+            for (int i = 0; i < 50; i++) {
+                std::string strError;
+                auto objLease = objPool.Acquire(strError);
+                std::string strCommand = std::to_string(t) + ":" + std::to_string(i);
+                CommandResult stcResult;
+                bool bSent = false;
+                if (!objLease || !objLease->Execute(strCommand, 5000, stcResult, bSent) ||
+                    stcResult.strOutput != strCommand) {
+                    nMismatches++;
+                }
+            }
+        });
+    }
+    for (auto& objThread : vecThreads) {
+        objThread.join();
+    }
+    CHECK_EQ(nMismatches.load(), static_cast<size_t>(0));
+    CHECK(pBackend->stcStats.nSpawns.load() <= 3);
+    CHECK_EQ(pBackend->stcStats.nCommands.load(), static_cast<size_t>(300) + pBackend->stcStats.nSpawns.load());
+}
@@ -0,0 +1,453 @@
+﻿/********************************************************************************
+* 文件名称：ProcessBackendTest.cpp
+* 文件功能：验证POSIX进程后端的截止时间、进程组结束、输出读取和epoll完成循环
+*           （大量并发、取消、超时），并以sh脚本代替powershell.exe，通过真实
+*           管道验证宿主协议
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/ProcessBackend.h"
+#include "../Smart-GPU-PV/PowerShellHost.h"
+#include "../Smart-GPU-PV/Utils.h"
+#include <fstream>
+#include <future>
+#include <thread>
+#include <signal.h>
+
+/********************************************************************************
+* 函数名称：检查进程是否已结束
+* 函数功能：进程不存在或已成为僵尸进程（等待容器中的init回收）都视为已结束；
+*           最多等待dwWaitMs
+*********************************************************************************/
+static bool ProcessGone(long nPid, DWORD dwWaitMs = 2000) {
+    ULONGLONG ui64Deadline = GetTickCount64() + dwWaitMs;
+    while (true) {
+        std::ifstream objStat("/proc/" + std::to_string(nPid) + "/stat");
+        std::string strStat;
+        if (!objStat || !std::getline(objStat, strStat)) {
+            return true;
+        }
+        size_t nParen = strStat.rfind(')');
+        if (nParen != std::string::npos && nParen + 2 < strStat.size() && strStat[nParen + 2] == 'Z') {
+            return true;
+        }
+        if (GetTickCount64() >= ui64Deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+}
+
+static long FirstNumber(const std::string& strText) {
+    return std::atol(Utils::Trim(strText).c_str());
+}
+
+TEST_CASE(RunCapturesOutputErrorAndExitCode) {
+    PosixProcessBackend objBackend;
+    CommandResult stcResult;
+    REQUIRE(objBackend.Run("printf 'out\\n'; printf 'err' >&2; exit 3", 10000, stcResult));
+    CHECK_EQ(stcResult.nExitCode, 3);
+    CHECK_EQ(stcResult.strOutput, std::string("out\n"));
+    CHECK_EQ(stcResult.strError, std::string("err"));
+    CHECK(!stcResult.bTimedOut);
+    CHECK(stcResult.ui64FirstByteUs > 0);
+
+    REQUIRE(objBackend.Run("no-such-command-sgp", 10000, stcResult));
+    CHECK_EQ(stcResult.nExitCode, 127);
+}
+
+TEST_CASE(RunDrainsLargeOutputOnBothStreams) {
+    PosixProcessBackend objBackend;
+    CommandResult stcResult;
+    REQUIRE(objBackend.Run("head -c 300000 /dev/zero | tr '\\0' e >&2; head -c 500000 /dev/zero | tr '\\0' o",
+                           30000, stcResult));
+    CHECK_EQ(stcResult.nExitCode, 0);
+    CHECK_EQ(stcResult.strOutput.size(), static_cast<size_t>(500000));
+    CHECK_EQ(stcResult.strError.size(), static_cast<size_t>(300000));
+}
+
+TEST_CASE(RunTimeoutKillsWholeProcessGroup) {
+    PosixProcessBackend objBackend;
+    CommandResult stcResult;
+    ULONGLONG ui64Start = GetTickCount64();
+    REQUIRE(objBackend.Run("sleep 30 & echo $!; wait", 300, stcResult));
+    ULONGLONG ui64Elapsed = GetTickCount64() - ui64Start;
+
+    CHECK(stcResult.bTimedOut);
+    CHECK_EQ(stcResult.nExitCode, static_cast<int>(ERROR_TIMEOUT));
+    CHECK(ui64Elapsed >= 290);
+    CHECK(ui64Elapsed < 3000);
+    long nGrandchild = FirstNumber(stcResult.strOutput);
+    REQUIRE(nGrandchild > 0);
+    CHECK(ProcessGone(nGrandchild));
+}
+
+TEST_CASE(RunReturnsWhenGrandchildKeepsPipeOpen) {
+    // 主进程立即退出，后台进程继承了输出管道：宽限期后结束进程组，不等到截止时间
+    PosixProcessBackend objBackend;
+    CommandResult stcResult;
+    ULONGLONG ui64Start = GetTickCount64();
+    REQUIRE(objBackend.Run("sleep 30 & echo $!", 60000, stcResult));
+    ULONGLONG ui64Elapsed = GetTickCount64() - ui64Start;
+
+    CHECK(!stcResult.bTimedOut);
+    CHECK_EQ(stcResult.nExitCode, 0);
+    CHECK(ui64Elapsed < 6000);
+    long nGrandchild = FirstNumber(stcResult.strOutput);
+    REQUIRE(nGrandchild > 0);
+    CHECK(ProcessGone(nGrandchild));
+}
+
+TEST_CASE(RunStreamingDeliversLinesAndSplitsLongLines) {
+    PosixProcessBackend objBackend;
+    std::vector<std::string> vecLines;
+    CommandResult stcResult;
+    REQUIRE(objBackend.RunStreaming(
+        "printf 'a\\nb\\r\\n'; head -c 70000 /dev/zero | tr '\\0' x; printf '\\nlast'; echo warn >&2; exit 2",
+        10000, [&vecLines](std::string_view svLine) { vecLines.emplace_back(svLine); }, stcResult));
+
+    CHECK_EQ(stcResult.nExitCode, 2);
+    CHECK(stcResult.strOutput.empty());
+    CHECK_EQ(stcResult.strError, std::string("warn\n"));
+    REQUIRE(vecLines.size() == 5);
+    CHECK_EQ(vecLines[0], std::string("a"));
+    CHECK_EQ(vecLines[1], std::string("b"));
+    // 超过单个缓冲区（64KB）的行被分段推送
+    CHECK_EQ(vecLines[2].size() + vecLines[3].size(), static_cast<size_t>(70000));
+    CHECK_EQ(vecLines[4], std::string("last"));
+}
+
+TEST_CASE(RunStreamingTimeoutKillsProcessGroup) {
+    PosixProcessBackend objBackend;
+    std::vector<std::string> vecLines;
+    CommandResult stcResult;
+    ULONGLONG ui64Start = GetTickCount64();
+    REQUIRE(objBackend.RunStreaming("echo $$; sleep 30", 300,
+        [&vecLines](std::string_view svLine) { vecLines.emplace_back(svLine); }, stcResult));
+    CHECK(stcResult.bTimedOut);
+    CHECK_EQ(stcResult.nExitCode, static_cast<int>(ERROR_TIMEOUT));
+    CHECK(GetTickCount64() - ui64Start < 3000);
+    REQUIRE(vecLines.size() == 1);
+    CHECK(ProcessGone(FirstNumber(vecLines[0])));
+}
+
+TEST_CASE(SpawnedProcessReadsInputAndMergesStderr) {
+    PosixProcessBackend objBackend;
+    std::string strError;
+    auto pProcess = objBackend.Spawn("while read l; do echo \"got $l\"; echo \"err $l\" >&2; done", strError);
+    REQUIRE(pProcess);
+    CHECK(pProcess->IsAlive());
+    REQUIRE(pProcess->WriteInput("x\ny\n"));
+
+    std::string strLine;
+    std::vector<std::string> vecLines;
+    for (int i = 0; i < 4 && pProcess->ReadOutputLine(strLine); i++) {
+        vecLines.push_back(strLine);
+    }
+    REQUIRE(vecLines.size() == 4);
+    CHECK_EQ(vecLines[0], std::string("got x"));
+    CHECK_EQ(vecLines[1], std::string("err x"));
+    CHECK_EQ(vecLines[3], std::string("err y"));
+
+    pProcess->Terminate();
+    CHECK(!pProcess->IsAlive());
+    CHECK(!pProcess->WriteInput("z\n"));
+    CHECK(!pProcess->ReadOutputLine(strLine));
+}
+
+TEST_CASE(SpawnedProcessDeadlineEndsBlockedRead) {
+    PosixProcessBackend objBackend;
+    std::string strError;
+    auto pProcess = objBackend.Spawn("sleep 30", strError);
+    REQUIRE(pProcess);
+
+    ULONGLONG ui64Start = GetTickCount64();
+    pProcess->SetDeadline(200);
+    std::string strLine;
+    CHECK(!pProcess->ReadOutputLine(strLine));
+    CHECK(pProcess->DeadlineExpired());
+    CHECK(GetTickCount64() - ui64Start < 3000);
+}
+
+TEST_CASE(SpawnedProcessDeadlineEndsBlockedWrite) {
+    // 子进程不读取stdin：写入超过管道容量的数据会阻塞，截止时间到达后写入失败
+    PosixProcessBackend objBackend;
+    std::string strError;
+    auto pProcess = objBackend.Spawn("sleep 30", strError);
+    REQUIRE(pProcess);
+
+    ULONGLONG ui64Start = GetTickCount64();
+    pProcess->SetDeadline(200);
+    CHECK(!pProcess->WriteInput(std::string(8 * 1024 * 1024, 'x')));
+    CHECK(pProcess->DeadlineExpired());
+    CHECK(GetTickCount64() - ui64Start < 3000);
+}
+
+TEST_CASE(SpawnedProcessDeadlineCanBeCancelled) {
+    PosixProcessBackend objBackend;
+    std::string strError;
+    auto pProcess = objBackend.Spawn("cat", strError);
+    REQUIRE(pProcess);
+
+    pProcess->SetDeadline(100);
+    pProcess->SetDeadline(INFINITE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    CHECK(pProcess->IsAlive());
+    CHECK(!pProcess->DeadlineExpired());
+    REQUIRE(pProcess->WriteInput("ping\n"));
+    std::string strLine;
+    REQUIRE(pProcess->ReadOutputLine(strLine));
+    CHECK_EQ(strLine, std::string("ping"));
+}
+
+/********************************************************************************
+* 函数名称：异步执行并等待结果
+*********************************************************************************/
+static CommandResult RunAsyncAndWait(PosixProcessBackend& objBackend, const std::string& strCmdLine,
+                                     DWORD dwTimeoutMs, const CancellationToken& objCancel = CancellationToken()) {
+    auto pPromise = std::make_shared<std::promise<CommandResult>>();
+    std::future<CommandResult> objFuture = pPromise->get_future();
+    objBackend.RunAsync(strCmdLine, dwTimeoutMs, objCancel, [pPromise](const CommandResult& stcResult) {
+        pPromise->set_value(stcResult);
+    });
+    return objFuture.get();
+}
+
+TEST_CASE(RunAsyncCapturesOutputErrorAndExitCode) {
+    PosixProcessBackend objBackend;
+    CommandResult stcResult = RunAsyncAndWait(objBackend, "printf 'out\\n'; printf 'err' >&2; exit 3", 10000);
+    CHECK_EQ(stcResult.nExitCode, 3);
+    CHECK_EQ(stcResult.strOutput, std::string("out\n"));
+    CHECK_EQ(stcResult.strError, std::string("err"));
+    CHECK(!stcResult.bTimedOut);
+    CHECK(!stcResult.bCancelled);
+    CHECK(stcResult.ui64FirstByteUs > 0);
+
+    stcResult = RunAsyncAndWait(objBackend, "head -c 300000 /dev/zero | tr '\\0' e >&2; "
+                                            "head -c 500000 /dev/zero | tr '\\0' o", 30000);
+    CHECK_EQ(stcResult.nExitCode, 0);
+    CHECK_EQ(stcResult.strOutput.size(), static_cast<size_t>(500000));
+    CHECK_EQ(stcResult.strError.size(), static_cast<size_t>(300000));
+}
+
+TEST_CASE(RunAsyncRunsManyCommandsConcurrentlyOnOneLoop) {
+    // 64条各需300ms的命令同时进行：总耗时接近一条命令，而不是64条之和
+    const size_t nCount = 64;
+    PosixProcessBackend objBackend;
+    std::vector<std::future<CommandResult>> vecFutures;
+    ULONGLONG ui64Start = GetTickCount64();
+    for (size_t i = 0; i < nCount; i++) {
+        auto pPromise = std::make_shared<std::promise<CommandResult>>();
+        vecFutures.push_back(pPromise->get_future());
+        objBackend.RunAsync("sleep 0.3; echo " + std::to_string(i) + "; exit " + std::to_string(i % 3),
+                            30000, CancellationToken(), [pPromise](const CommandResult& stcResult) {
+                                pPromise->set_value(stcResult);
+                            });
+    }
+    for (size_t i = 0; i < nCount; i++) {
+        CommandResult stcResult = vecFutures[i].get();
+        CHECK_EQ(Utils::Trim(stcResult.strOutput), std::to_string(i));
+        CHECK_EQ(stcResult.nExitCode, static_cast<int>(i % 3));
+    }
+    CHECK(GetTickCount64() - ui64Start < 5000);
+}
+
+TEST_CASE(RunAsyncTimeoutKillsWholeProcessGroup) {
+    PosixProcessBackend objBackend;
+    ULONGLONG ui64Start = GetTickCount64();
+    CommandResult stcResult = RunAsyncAndWait(objBackend, "sleep 30 & echo $!; wait", 300);
+    ULONGLONG ui64Elapsed = GetTickCount64() - ui64Start;
+
+    CHECK(stcResult.bTimedOut);
+    CHECK_EQ(stcResult.nExitCode, static_cast<int>(ERROR_TIMEOUT));
+    CHECK(ui64Elapsed >= 290);
+    CHECK(ui64Elapsed < 3000);
+    long nGrandchild = FirstNumber(stcResult.strOutput);
+    REQUIRE(nGrandchild > 0);
+    CHECK(ProcessGone(nGrandchild));
+}
+
+TEST_CASE(RunAsyncCancelKillsOnlyTheCancelledCommand) {
+    PosixProcessBackend objBackend;
+    CancellationToken objCancel;
+    auto pCancelled = std::make_shared<std::promise<CommandResult>>();
+    auto pOther = std::make_shared<std::promise<CommandResult>>();
+    std::future<CommandResult> objCancelled = pCancelled->get_future();
+    std::future<CommandResult> objOther = pOther->get_future();
+
+    ULONGLONG ui64Start = GetTickCount64();
+    objBackend.RunAsync("sleep 30 & echo $!; wait", 60000, objCancel, [pCancelled](const CommandResult& stcResult) {
+        pCancelled->set_value(stcResult);
+    });
+    objBackend.RunAsync("sleep 0.5; echo done", 60000, CancellationToken(), [pOther](const CommandResult& stcResult) {
+        pOther->set_value(stcResult);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    objCancel.Cancel();
+
+    CommandResult stcResult = objCancelled.get();
+    CHECK(stcResult.bCancelled);
+    CHECK(!stcResult.bTimedOut);
+    CHECK_EQ(stcResult.nExitCode, static_cast<int>(ERROR_CANCELLED));
+    CHECK(GetTickCount64() - ui64Start < 3000);
+    long nGrandchild = FirstNumber(stcResult.strOutput);
+    REQUIRE(nGrandchild > 0);
+    CHECK(ProcessGone(nGrandchild));
+
+    stcResult = objOther.get();
+    CHECK(!stcResult.bCancelled);
+    CHECK_EQ(stcResult.nExitCode, 0);
+    CHECK_EQ(stcResult.strOutput, std::string("done\n"));
+
+    // 已取消的令牌：命令不再启动，回调在调用线程上立即执行
+    stcResult = RunAsyncAndWait(objBackend, "echo never", 10000, objCancel);
+    CHECK(stcResult.bCancelled);
+    CHECK(stcResult.strOutput.empty());
+}
+
+TEST_CASE(RunAsyncReturnsWhenGrandchildKeepsPipeOpen) {
+    PosixProcessBackend objBackend;
+    ULONGLONG ui64Start = GetTickCount64();
+    CommandResult stcResult = RunAsyncAndWait(objBackend, "sleep 30 & echo $!", 60000);
+    ULONGLONG ui64Elapsed = GetTickCount64() - ui64Start;
+
+    CHECK(!stcResult.bTimedOut);
+    CHECK_EQ(stcResult.nExitCode, 0);
+    CHECK(ui64Elapsed < 6000);
+    long nGrandchild = FirstNumber(stcResult.strOutput);
+    REQUIRE(nGrandchild > 0);
+    CHECK(ProcessGone(nGrandchild));
+}
+
+TEST_CASE(RunAsyncBackendDestructionCancelsInFlightCommands) {
+    std::vector<std::future<CommandResult>> vecFutures;
+    ULONGLONG ui64Start = GetTickCount64();
+    {
+        PosixProcessBackend objBackend;
+        for (int i = 0; i < 4; i++) {
+            auto pPromise = std::make_shared<std::promise<CommandResult>>();
+            vecFutures.push_back(pPromise->get_future());
+            objBackend.RunAsync("sleep 30", INFINITE, CancellationToken(), [pPromise](const CommandResult& stcResult) {
+                pPromise->set_value(stcResult);
+            });
+        }
+    }
+    // 析构返回时所有回调都已执行
+    for (auto& objFuture : vecFutures) {
+        REQUIRE(objFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+        CHECK(objFuture.get().bCancelled);
+    }
+    CHECK(GetTickCount64() - ui64Start < 3000);
+}
+
+/********************************************************************************
+* 类名称：sh宿主后端
+* 类功能：Spawn时以实现同一帧协议的sh脚本代替powershell.exe，其余照常
+*         由POSIX后端执行；每条命令在独立的sh中执行，输出经base64编码
+*********************************************************************************/
+class ShHostBackend : public PosixProcessBackend {
+public:
+    explicit ShHostBackend(const std::string& strWorkDir) : m_strWorkDir(strWorkDir) {}
+
+    std::unique_ptr<ChildProcess> Spawn(const std::string&, std::string& strError) override {
+        std::string strScript =
+            "d='" + m_strWorkDir + "'/$$; mkdir -p \"$d\" || exit 1\n"
+            "echo '##SGP-READY##'\n"
+            "while IFS=' ' read -r seq mode cmds; do\n"
+            "  failed=0\n"
+            "  for b64 in $(printf '%s' \"$cmds\" | tr ',' ' '); do\n"
+            "    if [ \"$failed\" = 1 ] && [ \"$mode\" = 1 ]; then echo \"##SGP-FRAME## $seq -1  \"; continue; fi\n"
+            "    printf '%s' \"$b64\" | base64 -d > \"$d/cmd\"\n"
+            "    sh \"$d/cmd\" > \"$d/out\" 2> \"$d/err\" < /dev/null\n"
+            "    code=$?\n"
+            "    [ \"$code\" = 0 ] || failed=1\n"
+            "    echo \"##SGP-FRAME## $seq $code $(base64 < \"$d/out\" | tr -d '\\n') $(base64 < \"$d/err\" | tr -d '\\n')\"\n"
+            "  done\n"
+            "done\n";
+        return PosixProcessBackend::Spawn(strScript, strError);
+    }
+
+private:
+    std::string m_strWorkDir;   // 宿主脚本的临时文件目录
+};
+
+TEST_CASE(ShHostRoundTripsResultsOverRealPipes) {
+    TestHarness::TempDir objDir;
+    auto pBackend = std::make_shared<ShHostBackend>(objDir.Path().string());
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+
+    CommandResult stcResult;
+    bool bSent = false;
+    REQUIRE(objHost.Execute("echo hello; echo oops >&2; exit 4", 10000, stcResult, bSent));
+    CHECK_EQ(stcResult.nExitCode, 4);
+    CHECK_EQ(stcResult.strOutput, std::string("hello\n"));
+    CHECK_EQ(stcResult.strError, std::string("oops\n"));
+
+    // 标准输出为空时帧中出现空字段，错误输出不能错位
+    REQUIRE(objHost.Execute("echo only >&2; exit 1", 10000, stcResult, bSent));
+    CHECK(stcResult.strOutput.empty());
+    CHECK_EQ(stcResult.strError, std::string("only\n"));
+
+    std::vector<CommandResult> vecResults;
+    REQUIRE(objHost.ExecuteBatch({ "echo 1", "exit 5", "echo 3" }, true, 10000, vecResults, bSent));
+    REQUIRE(vecResults.size() == 3);
+    CHECK_EQ(vecResults[0].strOutput, std::string("1\n"));
+    CHECK_EQ(vecResults[1].nExitCode, 5);
+    CHECK_EQ(vecResults[2].nExitCode, -1);
+    CHECK(objHost.IsHealthy());
+}
+
+TEST_CASE(ShHostCrashIsRespawnedByPool) {
+    TestHarness::TempDir objDir;
+    auto pBackend = std::make_shared<ShHostBackend>(objDir.Path().string());
+    PowerShellHostPool objPool(pBackend, 1);
+    std::string strError;
+    {
+        auto objLease = objPool.Acquire(strError);
+        REQUIRE(objLease);
+        CommandResult stcResult;
+        bool bSent = false;
+        // 命令结束自己的宿主进程
+        if (!objLease->Execute("kill -9 $PPID", 10000, stcResult, bSent)) {
+            objLease.MarkBroken();
+        }
+        CHECK(bSent);
+    }
+    CHECK_EQ(objPool.GetRespawnCount(), static_cast<size_t>(1));
+
+    auto objLease = objPool.Acquire(strError);
+    REQUIRE(objLease);
+    CommandResult stcResult;
+    bool bSent = false;
+    REQUIRE(objLease->Execute("echo again", 10000, stcResult, bSent));
+    CHECK_EQ(stcResult.strOutput, std::string("again\n"));
+}
+
+TEST_CASE(ShHostDeadlineKillsHostAndItsChildren) {
+    TestHarness::TempDir objDir;
+    auto pBackend = std::make_shared<ShHostBackend>(objDir.Path().string());
+    PowerShellHost objHost(pBackend);
+    std::string strError;
+    REQUIRE(objHost.Start(strError));
+
+    std::string strPidFile = objDir.File("sleep.pid");
+    CommandResult stcResult;
+    bool bSent = false;
+    ULONGLONG ui64Start = GetTickCount64();
+    CHECK(!objHost.Execute("sleep 30 & echo $! > '" + strPidFile + "'; wait", 300, stcResult, bSent));
+    CHECK(GetTickCount64() - ui64Start < 3000);
+    CHECK(stcResult.bTimedOut);
+    CHECK_EQ(stcResult.nExitCode, static_cast<int>(ERROR_TIMEOUT));
+    CHECK(!objHost.IsHealthy());
+
+    std::ifstream objPid(strPidFile);
+    long nPid = 0;
+    REQUIRE(objPid >> nPid);
+    CHECK(ProcessGone(nPid));
+}
@@ -0,0 +1,116 @@
+﻿/********************************************************************************
+* 文件名称：QueryCacheTest.cpp
+* 文件功能：验证查询缓存的作用域失效和代数检查（查询期间被清除的结果不保存）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "FakeProcessBackend.h"
+#include "../Smart-GPU-PV/PowerShellExecutor.h"
+#include "../Smart-GPU-PV/QueryCache.h"
+#include <future>
+#include <thread>
+
+static std::shared_ptr<const CommandResult> MakeValue(const std::string& strOutput) {
+    auto pResult = std::make_shared<CommandResult>();
+    pResult->nExitCode = 0;
+    pResult->strOutput = strOutput;
+    return pResult;
+}
+
+static bool Cached(const std::string& strKey) {
+    std::shared_ptr<const CommandResult> pCached;
+    return QueryCache::Instance().Lookup(strKey, pCached);
+}
+
+TEST_CASE(StoreIsDiscardedWhenScopeWasInvalidatedDuringQuery) {
+    QueryCache& objCache = QueryCache::Instance();
+    objCache.Clear();
+    uint64_t ui64Stale = objCache.GetStats().ui64StaleStores;
+
+    // 1. vm1的查询开始后，修改vm1的命令清除了缓存：迟到的结果不保存
+    uint64_t ui64Vm1 = objCache.Generation("vm1");
+    uint64_t ui64Vm2 = objCache.Generation("vm2");
+    uint64_t ui64All = objCache.Generation(QueryCache::SCOPE_ALL_VMS);
+    objCache.InvalidateMatching("Set-VMProcessor -VMName 'vm1' -Count 4");
+    objCache.Store("k1", "vm1", MakeValue("old"), 60000, ui64Vm1);
+    objCache.Store("k2", "vm2", MakeValue("vm2"), 60000, ui64Vm2);
+    objCache.Store("k3", QueryCache::SCOPE_ALL_VMS, MakeValue("list"), 60000, ui64All);
+    CHECK(!Cached("k1"));
+    CHECK(Cached("k2"));
+    CHECK(!Cached("k3"));
+    CHECK_EQ(objCache.GetStats().ui64StaleStores - ui64Stale, static_cast<uint64_t>(2));
+
+    // 2. 清除之后开始的查询照常保存
+    objCache.Store("k1", "vm1", MakeValue("new"), 60000, objCache.Generation("vm1"));
+    std::shared_ptr<const CommandResult> pCached;
+    REQUIRE(objCache.Lookup("k1", pCached));
+    CHECK_EQ(pCached->strOutput, std::string("new"));
+}
+
+TEST_CASE(InvalidateScopeAndClearDiscardInFlightStores) {
+    QueryCache& objCache = QueryCache::Instance();
+    objCache.Clear();
+
+    uint64_t ui64Vm = objCache.Generation("vm1");
+    uint64_t ui64Host = objCache.Generation(QueryCache::SCOPE_HOST);
+    objCache.InvalidateScope("vm1");
+    objCache.Store("k1", "vm1", MakeValue("old"), 60000, ui64Vm);
+    objCache.Store("host", QueryCache::SCOPE_HOST, MakeValue("gpus"), 60000, ui64Host);
+    CHECK(!Cached("k1"));
+    CHECK(Cached("host"));   // 主机级作用域不受虚拟机修改影响
+
+    ui64Host = objCache.Generation(QueryCache::SCOPE_HOST);
+    objCache.Clear();
+    objCache.Store("host", QueryCache::SCOPE_HOST, MakeValue("gpus"), 60000, ui64Host);
+    CHECK(!Cached("host"));
+}
+
+TEST_CASE(ExecuteCachedDoesNotCacheResultOverlappingAMutation) {
+    // 查询在宿主中执行时，另一个线程通过第二个宿主修改了同一台虚拟机
+    QueryCache::Instance().Clear();
+    auto pBackend = std::make_shared<FakeProcessBackend>();
+    std::promise<void> objQueryStarted, objMutationDone;
+    std::shared_future<void> objMutationDoneFuture = objMutationDone.get_future().share();
+    std::atomic<int> nQueries{ 0 };
+    pBackend->stcConfig.fnHandler = [&](const std::string& strCommand) {
+        CommandResult stcResult;
+        stcResult.nExitCode = 0;
+        if (strCommand.rfind("Get-VM", 0) == 0 && nQueries++ == 0) {
+            objQueryStarted.set_value();
+            objMutationDoneFuture.wait();
+            stcResult.strOutput = "Running";
+        } else {
+            stcResult.strOutput = strCommand.rfind("Get-VM", 0) == 0 ? "Off" : "";
+        }
+        return stcResult;
+    };
+    PowerShellExecutor::SetProcessBackend(pBackend);
+    PowerShellExecutor::EnablePersistentHost(true, 2);
+
+    const std::string strQuery = "Get-VM -Name 'vm1' | Select-Object -ExpandProperty State";
+    std::thread objQuery([&]() {
+        CommandResult stcResult;
+        CHECK(PowerShellExecutor::ExecuteCached(strQuery, "vm1", 60000, stcResult));
+        CHECK_EQ(stcResult.strOutput, std::string("Running"));
+    });
+    objQueryStarted.get_future().wait();
+    std::string strOutput, strError;
+    CHECK(PowerShellExecutor::ExecuteWithCheck("Stop-VM -Name 'vm1' -Force", strOutput, strError));
+    objMutationDone.set_value();
+    objQuery.join();
+
+    // 修改之前的结果没有进入缓存：再次查询重新执行并得到新状态
+    CommandResult stcResult;
+    CHECK(PowerShellExecutor::ExecuteCached(strQuery, "vm1", 60000, stcResult));
+    CHECK_EQ(stcResult.strOutput, std::string("Off"));
+    CHECK_EQ(nQueries.load(), 2);
+
+    // 之后的查询命中缓存
+    CHECK(PowerShellExecutor::ExecuteCached(strQuery, "vm1", 60000, stcResult));
+    CHECK_EQ(nQueries.load(), 2);
+    PowerShellExecutor::Shutdown();
+}
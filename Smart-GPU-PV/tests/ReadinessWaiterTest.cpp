@@ -0,0 +1,134 @@
+﻿/********************************************************************************
+* 文件名称：ReadinessWaiterTest.cpp
+* 文件功能：用假时钟验证就绪等待的立即返回、退避间隔、最后一次截短的休眠和超时信息
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/ReadinessWaiter.h"
+#include <vector>
+
+/********************************************************************************
+* 类名称：假时钟
+* 类功能：休眠只推进时间并记录时长；Advance模拟条件检查本身的耗时
+*********************************************************************************/
+class FakeWaitClock : public WaitClock {
+public:
+    uint64_t NowMs() override { return m_ui64Now; }
+    void SleepMs(uint32_t ui32Ms) override {
+        m_vecSleeps.push_back(ui32Ms);
+        m_ui64Now += ui32Ms;
+    }
+
+    void Advance(uint64_t ui64Ms) { m_ui64Now += ui64Ms; }
+    const std::vector<uint32_t>& Sleeps() const { return m_vecSleeps; }
+
+private:
+    uint64_t              m_ui64Now = 1000000;      // 起点任意，等待只使用相对时间
+    std::vector<uint32_t> m_vecSleeps;
+};
+
+// 第ui32ReadyAt次检查时条件满足（0表示永不满足）
+static ReadinessWaiter::Condition ReadyAt(uint32_t& ui32Checks, uint32_t ui32ReadyAt) {
+    return [&ui32Checks, ui32ReadyAt]() { return ++ui32Checks == ui32ReadyAt; };
+}
+
+TEST_CASE(ReadyConditionReturnsWithoutSleeping) {
+    FakeWaitClock objClock;
+    ReadinessWaiter objWaiter(objClock);
+    uint32_t ui32Checks = 0;
+    std::string strError;
+    CHECK(objWaiter.WaitUntil("虚拟磁盘联机", ReadyAt(ui32Checks, 1), ReadinessWaiter::DISK_ARRIVAL, strError));
+    CHECK_EQ(objWaiter.Attempts(), 1u);
+    CHECK_EQ(objWaiter.ElapsedMs(), uint64_t(0));
+    CHECK(objClock.Sleeps().empty());
+    CHECK(strError.empty());
+}
+
+TEST_CASE(IntervalDoublesUpToMaximum) {
+    // 1. 50毫秒起每次翻倍，到1000毫秒后保持不变
+    {
+        FakeWaitClock objClock;
+        ReadinessWaiter objWaiter(objClock);
+        uint32_t ui32Checks = 0;
+        std::string strError;
+        CHECK(objWaiter.WaitUntil("卷挂载", ReadyAt(ui32Checks, 9), { 50, 1000, 30000 }, strError));
+        CHECK(objClock.Sleeps() == std::vector<uint32_t>({ 50, 100, 200, 400, 800, 1000, 1000, 1000 }));
+        CHECK_EQ(objWaiter.Attempts(), 9u);
+        CHECK_EQ(objWaiter.ElapsedMs(), uint64_t(4550));
+    }
+
+    // 2. 翻倍会超过上限时取上限；初始间隔为0时按1毫秒
+    {
+        FakeWaitClock objClock;
+        ReadinessWaiter objWaiter(objClock);
+        uint32_t ui32Checks = 0;
+        std::string strError;
+        CHECK(objWaiter.WaitUntil("卸载", ReadyAt(ui32Checks, 5), { 300, 1000, 30000 }, strError));
+        CHECK(objClock.Sleeps() == std::vector<uint32_t>({ 300, 600, 1000, 1000 }));
+        ui32Checks = 0;
+        CHECK(objWaiter.WaitUntil("卸载", ReadyAt(ui32Checks, 4), { 0, 4, 30000 }, strError));
+        CHECK(std::vector<uint32_t>(objClock.Sleeps().begin() + 4, objClock.Sleeps().end()) ==
+              std::vector<uint32_t>({ 1, 2, 4 }));
+        CHECK_EQ(objWaiter.Attempts(), 4u);                 // 每次等待重新计数
+    }
+}
+
+TEST_CASE(FinalSleepIsClampedToDeadline) {
+    // 1. 间隔之和超过截止时间：最后一次休眠只到截止时刻，截止时刻再检查一次
+    {
+        FakeWaitClock objClock;
+        ReadinessWaiter objWaiter(objClock);
+        uint32_t ui32Checks = 0;
+        std::string strError;
+        CHECK(!objWaiter.WaitUntil("虚拟磁盘联机", ReadyAt(ui32Checks, 0), { 50, 1000, 3000 }, strError));
+        CHECK(objClock.Sleeps() == std::vector<uint32_t>({ 50, 100, 200, 400, 800, 1000, 450 }));
+        CHECK_EQ(objWaiter.Attempts(), 8u);
+        CHECK_EQ(objWaiter.ElapsedMs(), uint64_t(3000));
+    }
+
+    // 2. 截止时刻的最后一次检查满足条件时仍然成功
+    {
+        FakeWaitClock objClock;
+        ReadinessWaiter objWaiter(objClock);
+        uint32_t ui32Checks = 0;
+        std::string strError;
+        CHECK(objWaiter.WaitUntil("虚拟磁盘联机", ReadyAt(ui32Checks, 8), { 50, 1000, 3000 }, strError));
+        CHECK_EQ(objWaiter.ElapsedMs(), uint64_t(3000));
+        CHECK(strError.empty());
+    }
+
+    // 3. 条件检查本身耗时：剩余时间按检查之后的时刻计算
+    {
+        FakeWaitClock objClock;
+        ReadinessWaiter objWaiter(objClock);
+        uint32_t ui32Checks = 0;
+        std::string strError;
+        auto fnSlow = [&]() { objClock.Advance(70); ui32Checks++; return false; };
+        CHECK(!objWaiter.WaitUntil("卸载", fnSlow, { 50, 1000, 1000 }, strError));
+        CHECK(objClock.Sleeps() == std::vector<uint32_t>({ 50, 100, 200, 370 }));
+        CHECK_EQ(objWaiter.Attempts(), 5u);                 // 0、120、290、560和截止时刻1000
+        CHECK_EQ(ui32Checks, 5u);
+        CHECK_EQ(objWaiter.ElapsedMs(), uint64_t(1070));
+    }
+}
+
+TEST_CASE(TimeoutMessageNamesConditionAndAttempts) {
+    FakeWaitClock objClock;
+    ReadinessWaiter objWaiter(objClock);
+    uint32_t ui32Checks = 0;
+    std::string strError;
+    CHECK(!objWaiter.WaitUntil("虚拟磁盘联机", ReadyAt(ui32Checks, 0), { 50, 1000, 3000 }, strError));
+    CHECK_EQ(strError, std::string("等待虚拟磁盘联机超时（3000毫秒，共检查8次）"));
+
+    // 截止时间为0：只检查一次，不休眠
+    FakeWaitClock objImmediate;
+    ReadinessWaiter objOnce(objImmediate);
+    ui32Checks = 0;
+    CHECK(!objOnce.WaitUntil("卸载完成", ReadyAt(ui32Checks, 0), { 100, 2000, 0 }, strError));
+    CHECK_EQ(strError, std::string("等待卸载完成超时（0毫秒，共检查1次）"));
+    CHECK(objImmediate.Sleeps().empty());
+}
@@ -0,0 +1,156 @@
+﻿/********************************************************************************
+* 文件名称：RepairStringTest.cpp
+* 文件功能：验证UTF-8检查和GBK片段修复（内置GBK表，不依赖代码页936）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/Utils.h"
+#include "../Smart-GPU-PV/GbkTable.h"
+#include <cstring>
+#include <vector>
+
+// "显卡驱动已安装"、"错误"的GBK编码
+static const char* const GBK_DRIVER_INSTALLED = "\xCF\xD4\xBF\xA8\xC7\xFD\xB6\xAF\xD2\xD1\xB0\xB2\xD7\xB0";
+static const char* const GBK_ERROR = "\xB4\xED\xCE\xF3";
+
+/********************************************************************************
+* 函数名称：参考实现：按Unicode标准表3-7逐字节查找第一个无效序列
+*********************************************************************************/
+static size_t ReferenceFindInvalid(std::string_view str) {
+    size_t i = 0;
+    while (i < str.size()) {
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+        size_t nLength = (c >= 0xC2 && c <= 0xDF) ? 2 : (c >= 0xE0 && c <= 0xEF) ? 3 : (c >= 0xF0 && c <= 0xF4) ? 4 : 0;
+        if (nLength == 0 || i + nLength > str.size()) return i;
+        uint32_t ui32CodePoint = c & (0xFF >> (nLength + 1));
+        for (size_t k = 1; k < nLength; k++) {
+            unsigned char t = static_cast<unsigned char>(str[i + k]);
+            if ((t & 0xC0) != 0x80) return i;
+            ui32CodePoint = (ui32CodePoint << 6) | (t & 0x3F);
+        }
+        static const uint32_t MIN_FOR_LENGTH[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+        if (ui32CodePoint < MIN_FOR_LENGTH[nLength] || ui32CodePoint > 0x10FFFF ||
+            (ui32CodePoint >= 0xD800 && ui32CodePoint <= 0xDFFF)) {
+            return i;
+        }
+        i += nLength;
+    }
+    return std::string_view::npos;
+}
+
+TEST_CASE(GbkOutputIsConvertedWithBuiltInTable) {
+    CHECK_EQ(Utils::RepairString(std::string("Status: ") + GBK_DRIVER_INSTALLED),
+             std::string("Status: 显卡驱动已安装"));
+    // 尾字节落在ASCII范围（0x40~0x7E）的双字节字符
+    CHECK_EQ(Utils::RepairString("\x81\x40 ok"), std::string("丂 ok"));
+    // 代码页936的单字节欧元符号
+    CHECK_EQ(Utils::RepairString("\x80"), std::string("€"));
+}
+
+TEST_CASE(ValidUtf8IsKeptAndOnlyInvalidSpansConverted) {
+    std::string strMixed = std::string("设备名称: ") + GBK_ERROR + " / 状态正常";
+    CHECK_EQ(Utils::RepairString(strMixed), std::string("设备名称: 错误 / 状态正常"));
+    std::string strValid = "C:\\Windows\\System32\\DriverStore\\显卡.inf";
+    CHECK_EQ(Utils::RepairString(strValid), strValid);
+}
+
+TEST_CASE(UnmappableBytesBecomeReplacementCharacter) {
+    CHECK_EQ(Utils::RepairString("a\xFF" "b"), std::string("a\xEF\xBF\xBD" "b"));
+    CHECK_EQ(Utils::RepairString("end\xB4"), std::string("end\xEF\xBF\xBD"));   // 末尾孤立的首字节
+}
+
+TEST_CASE(GbkTableCoversAllMappedPairs) {
+    // 由gen_gbk_table.py生成：gbk映射21791个组合，用户自定义区按gb18030再映射2149个
+    size_t nMapped = 0;
+    for (size_t i = 0; i < GBK_LEAD_COUNT * GBK_TRAIL_COUNT; i++) {
+        nMapped += GBK_TO_UNICODE[i] != 0;
+    }
+    CHECK_EQ(nMapped, size_t(21791 + 2149));
+    CHECK_EQ(GBK_TO_UNICODE[(0xD6 - GBK_LEAD_FIRST) * GBK_TRAIL_COUNT + (0xD0 - GBK_TRAIL_FIRST)], uint16_t(0x4E2D));
+}
+
+TEST_CASE(FindInvalidUtf8MatchesReference) {
+    // 随机拼接ASCII、各种长度的有效序列、边界附近的无效序列和随机字节
+    static const char* const PIECES[] = {
+        "a", "0123456789abcdefghijklmnopqrstuvwxyz", "\xC3\xA9", "\xE4\xB8\xAD", "\xF0\x9F\x98\x80",
+        "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xE4\xB8", "\x80", "\xFF",
+        "\xEF\xBF\xBD", "\xF4\x8F\xBF\xBF", "\xE0\xA0\x80",
+    };
+    TestHarness::Random objRandom(12);
+    size_t nCases = TestHarness::QuickMode() ? 2000 : 20000;
+    for (size_t n = 0; n < nCases; n++) {
+        std::string str;
+        size_t nPieces = objRandom.Next() % 24;
+        for (size_t k = 0; k < nPieces; k++) {
+            uint64_t ui64Pick = objRandom.Next();
+            if (ui64Pick % 8 == 0) {
+                str += static_cast<char>(ui64Pick >> 8);
+            } else {
+                str += PIECES[(ui64Pick >> 3) % (sizeof(PIECES) / sizeof(PIECES[0]))];
+            }
+        }
+        size_t nExpected = ReferenceFindInvalid(str);
+        CHECK_EQ(Utils::FindInvalidUTF8(str), nExpected);
+        if (nExpected == std::string_view::npos) {
+            CHECK_EQ(Utils::RepairString(str), str);
+        } else {
+            CHECK(Utils::IsValidUTF8(Utils::RepairString(str)));
+        }
+    }
+}
+
+TEST_CASE(ValidCjkDirectlyFollowedByGbkIsKept) {
+    // 有效的UTF-8中文紧挨着其后的GBK字节：片段从第一个无效字节开始，之前的中文不被并入
+    //（GBK之后的内容以ASCII分隔，GBK双字节本身可能恰好是有效的UTF-8，无法向后区分）
+    CHECK_EQ(Utils::RepairString(std::string("中文") + GBK_ERROR), std::string("中文错误"));
+    CHECK_EQ(Utils::RepairString(std::string("状态：") + GBK_DRIVER_INSTALLED + " 虚拟机"),
+             std::string("状态：显卡驱动已安装 虚拟机"));
+    CHECK_EQ(Utils::RepairString(std::string("café") + GBK_ERROR + " 😀"), std::string("café错误 😀"));
+    CHECK_EQ(Utils::RepairString(std::string("设备") + GBK_ERROR + " 设备" + GBK_ERROR),
+             std::string("设备错误 设备错误"));
+}
+
+TEST_CASE(SimdPathsMatchScalarAtEveryBlockOffset) {
+    // x86/x64上必须实际使用SIMD实现（Linux上由GCC/Clang的__SSE2__启用）
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    CHECK(Utils::BestUTF8Simd() != Utils::Utf8Simd::Scalar);
+#endif
+    std::vector<Utils::Utf8Simd> vecLevels = { Utils::Utf8Simd::Scalar };
+    if (Utils::BestUTF8Simd() >= Utils::Utf8Simd::SSE2) vecLevels.push_back(Utils::Utf8Simd::SSE2);
+    if (Utils::BestUTF8Simd() >= Utils::Utf8Simd::AVX2) vecLevels.push_back(Utils::Utf8Simd::AVX2);
+
+    // 无效序列（以及作为对照的有效多字节字符）放在两个32字节块内的每个偏移，
+    // 字符串起点相对缓冲区也逐字节移动，使16/32字节的读取覆盖各种对齐
+    static const char* const PIECES[] = {
+        "\x80", "\xFF", "\xC0\xAF", "\xE4\xB8", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xC3",
+        "\xC3\xA9", "\xE4\xB8\xAD", "\xF0\x9F\x98\x80",
+    };
+    const std::string strTail = std::string(40, 'z') + "\xE4\xB8\xAD" + std::string(20, 'y');
+    for (const char* pszPiece : PIECES) {
+        for (size_t nOffset = 0; nOffset < 64; nOffset++) {
+            for (size_t nShift = 0; nShift < 32; nShift += TestHarness::QuickMode() ? 7 : 1) {
+                std::string strBuffer = std::string(nShift, '#') + std::string(nOffset, 'a') + pszPiece + strTail;
+                std::string_view svText = std::string_view(strBuffer).substr(nShift);
+                size_t nExpected = ReferenceFindInvalid(svText);
+                for (Utils::Utf8Simd eLevel : vecLevels) {
+                    CHECK_EQ(Utils::FindInvalidUTF8(svText, eLevel), nExpected);
+                }
+                CHECK_EQ(Utils::FindInvalidUTF8(svText), nExpected);
+
+                // 截断在序列中间（片段位于字符串末尾）
+                std::string_view svCut = svText.substr(0, nOffset + strlen(pszPiece) - 1);
+                for (Utils::Utf8Simd eLevel : vecLevels) {
+                    CHECK_EQ(Utils::FindInvalidUTF8(svCut, eLevel), ReferenceFindInvalid(svCut));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,188 @@
+﻿/********************************************************************************
+* 文件名称：ScriptRecordTest.cpp
+* 文件功能：验证脚本记录行的解码、按任意位置分块输入、末尾不完整行的处理，
+*           以及无效Base64、未知类型和普通输出行
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/ScriptRecord.h"
+#include "../Smart-GPU-PV/Utils.h"
+#include <vector>
+
+// 按Emit-Record的格式生成一行记录（不含换行符）
+static std::string RecordLine(const std::string& strTag, const std::string& strValue, const std::string& strDetail = "") {
+    return "##SGP-REC## " + strTag + " " + Utils::Base64Encode(strValue) + " " + Utils::Base64Encode(strDetail);
+}
+
+/********************************************************************************
+* 类名称：解码结果收集器
+* 类功能：按到达顺序记录解码出的记录和普通行
+*********************************************************************************/
+struct DecodedOutput {
+    std::vector<ScriptRecord> vecRecords;
+    std::vector<std::string>  vecLines;
+
+    RecordSink Records() { return [this](const ScriptRecord& stcRecord) { vecRecords.push_back(stcRecord); }; }
+    LineSink Lines() { return [this](std::string_view svLine) { vecLines.emplace_back(svLine); }; }
+};
+
+TEST_CASE(DecodeLineParsesRecordFields) {
+    // 1. 各类型和UTF-8的值、详情（含空格和路径）
+    const std::string strGpu = "NVIDIA GeForce RTX 4050 \xE7\xAC\x94\xE8\xAE\xB0\xE6\x9C\xAC";
+    const std::string strTarget = "D:\\Windows\\System32\\HostDriverStore\\FileRepository\\nv_dispsi.inf_amd64";
+    struct Expected {
+        const char* pszTag;
+        RecordType  eType;
+    };
+    const Expected stcTypes[] = {
+        { "INFO", RecordType::Info }, { "WARN", RecordType::Warning }, { "ERROR", RecordType::Error },
+        { "FOUND", RecordType::Found }, { "MISSING", RecordType::Missing }, { "PACKAGE", RecordType::Package },
+        { "FILE", RecordType::File }, { "VERDICT", RecordType::Verdict }, { "DEVICE", RecordType::Device },
+        { "DONE", RecordType::Done },
+    };
+    for (const auto& stcType : stcTypes) {
+        ScriptRecord stcRecord;
+        REQUIRE(ScriptRecordDecoder::DecodeLine(RecordLine(stcType.pszTag, strGpu, strTarget), stcRecord));
+        CHECK(stcRecord.eType == stcType.eType);
+        CHECK_EQ(stcRecord.strTag, std::string(stcType.pszTag));
+        CHECK_EQ(stcRecord.strValue, strGpu);
+        CHECK_EQ(stcRecord.strDetail, strTarget);
+    }
+
+    // 2. 行尾的\r和前后空白被忽略；空字段解码为空字符串
+    ScriptRecord stcRecord;
+    CHECK(ScriptRecordDecoder::DecodeLine("  " + RecordLine("VERDICT", "OK") + " \r", stcRecord));
+    CHECK_EQ(stcRecord.strValue, std::string("OK"));
+    CHECK(stcRecord.strDetail.empty());
+    CHECK(ScriptRecordDecoder::DecodeLine("##SGP-REC## DONE", stcRecord));
+    CHECK(stcRecord.eType == RecordType::Done);
+    CHECK(stcRecord.strValue.empty() && stcRecord.strDetail.empty());
+}
+
+TEST_CASE(UnknownRecordKindKeepsTag) {
+    ScriptRecord stcRecord;
+    REQUIRE(ScriptRecordDecoder::DecodeLine(RecordLine("PROGRESS", "42", "copy"), stcRecord));
+    CHECK(stcRecord.eType == RecordType::Unknown);
+    CHECK_EQ(stcRecord.strTag, std::string("PROGRESS"));
+    CHECK_EQ(stcRecord.strValue, std::string("42"));
+    CHECK_EQ(stcRecord.strDetail, std::string("copy"));
+
+    // 类型名区分大小写
+    REQUIRE(ScriptRecordDecoder::DecodeLine(RecordLine("info", "x"), stcRecord));
+    CHECK(stcRecord.eType == RecordType::Unknown);
+    CHECK_EQ(stcRecord.strTag, std::string("info"));
+}
+
+TEST_CASE(InvalidRecordLinesAreRejected) {
+    // 解码失败时stcRecord保持不变
+    ScriptRecord stcRecord;
+    stcRecord.strTag = "KEEP";
+    const std::string strLines[] = {
+        "##SGP-REC## INFO aGVsbG8* ",                              // 值中有非法字符
+        "##SGP-REC## INFO aGVsbG8= !!!",                           // 详情中有非法字符
+        "##SGP-REC## INFO " + Utils::Base64Encode("\xE4\xB8\xAD") + "-",
+        "##SGP-REC##  aGVsbG8=",                                    // 类型为空
+        "##SGP-REC##",
+        "##SGP-REC##INFO aGVsbG8=",                                 // 标记后没有空格
+        "",
+    };
+    for (const auto& strLine : strLines) {
+        CHECK(!ScriptRecordDecoder::DecodeLine(strLine, stcRecord));
+        CHECK_EQ(stcRecord.strTag, std::string("KEEP"));
+    }
+
+    // 流式解码中无效的记录行按普通行原样交给普通行回调
+    ScriptRecordDecoder objDecoder;
+    DecodedOutput stcOutput;
+    objDecoder.Feed(strLines[0] + "\n" + RecordLine("INFO", "ok") + "\n", stcOutput.Records(), stcOutput.Lines());
+    REQUIRE(stcOutput.vecRecords.size() == 1);
+    CHECK_EQ(stcOutput.vecRecords[0].strValue, std::string("ok"));
+    CHECK(stcOutput.vecLines == std::vector<std::string>({ strLines[0] }));
+}
+
+TEST_CASE(PlainLinesPassThroughUnchanged) {
+    // 旧脚本的文本标记、行中间出现的记录标记、空行和CRLF行都不是记录
+    const std::vector<std::string> vecPlain = {
+        "VERIFY_OK",
+        "[FOUND] nvlddmkm.sys",
+        "GPU name contains ##SGP-REC## INFO aGVsbG8= ",
+        "",
+        "  indented \xE4\xB8\xAD\xE6\x96\x87\r",
+    };
+    std::string strOutput;
+    for (const auto& strLine : vecPlain) {
+        strOutput += strLine + "\n";
+        strOutput += RecordLine("FOUND", "after " + std::to_string(strOutput.size())) + "\r\n";
+    }
+
+    ScriptRecordDecoder objDecoder;
+    DecodedOutput stcOutput;
+    objDecoder.Feed(strOutput, stcOutput.Records(), stcOutput.Lines());
+    objDecoder.Finish(stcOutput.Records(), stcOutput.Lines());
+    CHECK(stcOutput.vecLines == vecPlain);
+    CHECK_EQ(stcOutput.vecRecords.size(), vecPlain.size());
+
+    // 没有普通行回调时普通行被忽略
+    ScriptRecordDecoder objQuiet;
+    DecodedOutput stcQuiet;
+    objQuiet.Feed(strOutput, stcQuiet.Records());
+    objQuiet.Finish(stcQuiet.Records());
+    CHECK_EQ(stcQuiet.vecRecords.size(), vecPlain.size());
+}
+
+TEST_CASE(MarkerSplitAcrossFeedChunks) {
+    const std::string strOutput = "plain\r\n" + RecordLine("PACKAGE", "C:\\src", "D:\\dst") + "\r\n" +
+                                  RecordLine("DEVICE", "OK", "GPU") + "\n" + "tail\n";
+
+    // 1. 在每个位置切成两块（包括记录标记中间和\r\n之间）
+    for (size_t nSplit = 0; nSplit <= strOutput.size(); nSplit++) {
+        ScriptRecordDecoder objDecoder;
+        DecodedOutput stcOutput;
+        objDecoder.Feed(std::string_view(strOutput).substr(0, nSplit), stcOutput.Records(), stcOutput.Lines());
+        objDecoder.Feed(std::string_view(strOutput).substr(nSplit), stcOutput.Records(), stcOutput.Lines());
+        objDecoder.Finish(stcOutput.Records(), stcOutput.Lines());
+        REQUIRE(stcOutput.vecRecords.size() == 2);
+        CHECK(stcOutput.vecRecords[0].eType == RecordType::Package);
+        CHECK_EQ(stcOutput.vecRecords[0].strDetail, std::string("D:\\dst"));
+        CHECK_EQ(stcOutput.vecRecords[1].strDetail, std::string("GPU"));
+        CHECK(stcOutput.vecLines == std::vector<std::string>({ "plain\r", "tail" }));
+    }
+
+    // 2. 逐字节输入
+    ScriptRecordDecoder objDecoder;
+    DecodedOutput stcOutput;
+    for (char c : strOutput) {
+        objDecoder.Feed(std::string_view(&c, 1), stcOutput.Records(), stcOutput.Lines());
+    }
+    CHECK_EQ(stcOutput.vecRecords.size(), size_t(2));
+    CHECK_EQ(stcOutput.vecLines.size(), size_t(2));
+}
+
+TEST_CASE(FinishFlushesTrailingPartialLine) {
+    // 1. 输出末尾没有换行符：Feed只缓存，Finish时解码
+    ScriptRecordDecoder objDecoder;
+    DecodedOutput stcOutput;
+    objDecoder.Feed("x\n" + RecordLine("VERDICT", "PARTIAL"), stcOutput.Records(), stcOutput.Lines());
+    CHECK(stcOutput.vecRecords.empty());
+    objDecoder.Finish(stcOutput.Records(), stcOutput.Lines());
+    REQUIRE(stcOutput.vecRecords.size() == 1);
+    CHECK_EQ(stcOutput.vecRecords[0].strValue, std::string("PARTIAL"));
+
+    // 2. 再次Finish不重复输出；之后可以继续使用
+    objDecoder.Finish(stcOutput.Records(), stcOutput.Lines());
+    CHECK_EQ(stcOutput.vecRecords.size(), size_t(1));
+    objDecoder.Feed("no newline", stcOutput.Records(), stcOutput.Lines());
+    objDecoder.Finish(stcOutput.Records(), stcOutput.Lines());
+    CHECK(stcOutput.vecLines == std::vector<std::string>({ "x", "no newline" }));
+
+    // 3. 以换行符结尾时Finish没有剩余内容
+    objDecoder.Feed(RecordLine("DONE", "") + "\n", stcOutput.Records(), stcOutput.Lines());
+    CHECK_EQ(stcOutput.vecRecords.size(), size_t(2));
+    objDecoder.Finish(stcOutput.Records(), stcOutput.Lines());
+    CHECK_EQ(stcOutput.vecRecords.size(), size_t(2));
+    CHECK_EQ(stcOutput.vecLines.size(), size_t(2));
+}
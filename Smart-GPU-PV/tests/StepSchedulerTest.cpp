@@ -0,0 +1,52 @@
+﻿/********************************************************************************
+* 文件名称：StepSchedulerTest.cpp
+* 文件功能：验证步骤调度器的关键路径报告（依赖边与资源锁等待）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/StepScheduler.h"
+#include <chrono>
+#include <thread>
+
+static StepScheduler::StepFunc SleepStep(int nMs) {
+    return [nMs](std::string&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(nMs));
+        return true;
+    };
+}
+
+TEST_CASE(CriticalPathFollowsDependencies) {
+    StepScheduler objScheduler;
+    objScheduler.AddStep("StopVM", {}, {}, SleepStep(30));
+    objScheduler.AddStep("Backup", {}, {}, SleepStep(5));
+    objScheduler.AddStep("Prepare", { "StopVM", "Backup" }, {}, SleepStep(10));
+    std::string strFailedStep, strError;
+    REQUIRE(objScheduler.Run(strFailedStep, strError));
+
+    std::string strReport = objScheduler.CriticalPathReport();
+    CHECK(strReport.rfind("StopVM ", 0) == 0);
+    CHECK(strReport.find(" -> Prepare ") != std::string::npos);
+    CHECK(strReport.find("Backup") == std::string::npos);
+    CHECK(strReport.find("等锁 0ms）") != std::string::npos);
+}
+
+TEST_CASE(CriticalPathIncludesStepThatHeldTheLock) {
+    // Mount和SetProcessor互不依赖，但争用同一台虚拟机的锁：SetProcessor等到Mount结束才开始
+    StepScheduler objScheduler;
+    objScheduler.AddStep("Mount", {}, { "vm:Win11" }, SleepStep(40));
+    objScheduler.AddStep("SetProcessor", {}, { "vm:Win11" }, SleepStep(10));
+    std::string strFailedStep, strError;
+    REQUIRE(objScheduler.Run(strFailedStep, strError));
+
+    // 只按依赖回溯时路径只有SetProcessor，看不出40ms花在等锁上
+    std::string strReport = objScheduler.CriticalPathReport();
+    CHECK(strReport.rfind("Mount ", 0) == 0);
+    CHECK(strReport.find(" -[vm:Win11]-> SetProcessor ") != std::string::npos);
+    size_t nWait = strReport.find("（等锁 ");
+    REQUIRE(nWait != std::string::npos);
+    CHECK(std::stoi(strReport.substr(nWait + std::string("（等锁 ").size())) >= 35);
+}
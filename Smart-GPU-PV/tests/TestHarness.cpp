@@ -0,0 +1,125 @@
+﻿/********************************************************************************
+* 文件名称：TestHarness.cpp
+* 文件功能：测试注册、运行和结果汇总（各测试可执行文件的main函数）
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <mutex>
+
+namespace TestHarness {
+
+struct TestEntry {
+    const char*  pszName;   // 测试名称
+    TestFunction fnTest;    // 测试函数
+};
+
+// 注册表使用函数内静态对象，不受各翻译单元静态初始化顺序影响
+static std::vector<TestEntry>& Registry() {
+    static std::vector<TestEntry> s_vecTests;
+    return s_vecTests;
+}
+
+static std::mutex g_mtxFail;        // 测试中的工作线程也可能记录失败
+static size_t     g_nFailures = 0;  // 当前测试的失败次数
+static bool       g_bQuick = false; // 是否为快速模式
+
+Registrar::Registrar(const char* pszName, TestFunction fnTest) {
+    Registry().push_back({ pszName, fnTest });
+}
+
+void Fail(const char* pszFile, int nLine, const std::string& strMessage) {
+    std::lock_guard<std::mutex> lock(g_mtxFail);
+    g_nFailures++;
+    fprintf(stderr, "    %s:%d: CHECK failed: %s\n", pszFile, nLine, strMessage.c_str());
+}
+
+bool QuickMode() {
+    return g_bQuick;
+}
+
+/********************************************************************************
+* 函数实现：临时目录
+*********************************************************************************/
+TempDir::TempDir() {
+    static std::atomic<unsigned> s_nSerial(0);
+    auto ui64Now = std::chrono::steady_clock::now().time_since_epoch().count();
+    m_pathDir = std::filesystem::temp_directory_path() /
+                ("sgp-test-" + std::to_string(ui64Now) + "-" + std::to_string(++s_nSerial));
+    std::filesystem::create_directories(m_pathDir);
+}
+
+TempDir::~TempDir() {
+    std::error_code ec;
+    std::filesystem::remove_all(m_pathDir, ec);
+}
+
+}  // namespace TestHarness
+
+/********************************************************************************
+* 函数实现：运行测试
+* 命令行：[--quick] [测试名称...]
+*********************************************************************************/
+int main(int argc, char* argv[]) {
+    using namespace TestHarness;
+
+    // 1. 解析参数
+    std::vector<std::string> vecFilters;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            g_bQuick = true;
+        } else {
+            vecFilters.push_back(argv[i]);
+        }
+    }
+
+    // 2. 逐个运行
+    size_t nRun = 0, nFailed = 0;
+    for (const TestEntry& stcTest : Registry()) {
+        if (!vecFilters.empty()) {
+            bool bSelected = false;
+            for (const auto& strFilter : vecFilters) {
+                bSelected = bSelected || strFilter == stcTest.pszName;
+            }
+            if (!bSelected) continue;
+        }
+
+        printf("[ RUN  ] %s\n", stcTest.pszName);
+        fflush(stdout);
+        g_nFailures = 0;
+        auto tpStart = std::chrono::steady_clock::now();
+        try {
+            stcTest.fnTest();
+        } catch (const RequireFailure&) {
+            // 失败已记录
+        } catch (const std::exception& e) {
+            Fail(__FILE__, __LINE__, std::string("unexpected exception: ") + e.what());
+        } catch (...) {
+            Fail(__FILE__, __LINE__, "unexpected exception");
+        }
+        auto llMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - tpStart).count();
+
+        nRun++;
+        if (g_nFailures > 0) {
+            nFailed++;
+            printf("[ FAIL ] %s (%lld ms)\n", stcTest.pszName, static_cast<long long>(llMs));
+        } else {
+            printf("[  OK  ] %s (%lld ms)\n", stcTest.pszName, static_cast<long long>(llMs));
+        }
+        fflush(stdout);
+    }
+
+    // 3. 汇总
+    printf("%zu test(s), %zu failed\n", nRun, nFailed);
+    return (nFailed == 0 && nRun > 0) ? 0 : 1;
+}
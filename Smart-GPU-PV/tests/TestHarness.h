@@ -0,0 +1,145 @@
+﻿/********************************************************************************
+* 文件名称：TestHarness.h
+* 文件功能：不依赖第三方库的最小测试框架
+*
+* 说明：
+*    每个测试文件编译为一个独立的可执行文件，由CTest逐个运行。
+*    - TEST_CASE定义并注册测试函数
+*    - CHECK失败时记录并继续，REQUIRE失败时结束当前测试
+*    - 命令行参数为测试名称时只运行这些测试；--quick让基准测试缩小规模
+*      （CTest以--quick运行基准测试，只验证其能正常完成）
+*    - TempDir在系统临时目录下创建唯一的目录，析构时递归删除
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <filesystem>
+#include <cstdint>
+
+namespace TestHarness {
+
+using TestFunction = void (*)();
+
+/********************************************************************************
+* 类名称：测试注册器
+* 类功能：静态对象构造时把测试函数加入全局列表
+*********************************************************************************/
+class Registrar {
+public:
+    Registrar(const char* pszName, TestFunction fnTest);
+};
+
+// REQUIRE失败时抛出，结束当前测试
+struct RequireFailure {};
+
+/********************************************************************************
+* 函数名称：记录失败
+* 函数参数：
+*    [IN]  const char* pszFile：源文件
+*    [IN]  int nLine：行号
+*    [IN]  const std::string& strMessage：失败的表达式或说明
+*********************************************************************************/
+void Fail(const char* pszFile, int nLine, const std::string& strMessage);
+
+/********************************************************************************
+* 函数名称：是否为快速模式
+* 返回类型：bool
+*    命令行带--quick时返回true（基准测试据此缩小数据规模和迭代次数）
+*********************************************************************************/
+bool QuickMode();
+
+/********************************************************************************
+* 函数名称：格式化值（CHECK_EQ的失败信息）
+*********************************************************************************/
+template <typename T>
+std::string Describe(const T& value) {
+    std::ostringstream objStream;
+    objStream << value;
+    return objStream.str();
+}
+
+/********************************************************************************
+* 类名称：临时目录
+* 类功能：构造时创建唯一的空目录，析构时递归删除
+*********************************************************************************/
+class TempDir {
+public:
+    TempDir();
+    ~TempDir();
+
+    const std::filesystem::path& Path() const { return m_pathDir; }
+
+    // 目录中的文件路径（UTF-8字符串）
+    std::string File(const std::string& strName) const { return (m_pathDir / strName).string(); }
+
+private:
+    std::filesystem::path m_pathDir;
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+};
+
+/********************************************************************************
+* 函数名称：确定性伪随机数（xorshift64*）
+* 函数功能：测试数据和随机访问序列在每次运行时相同，失败可以复现
+*********************************************************************************/
+class Random {
+public:
+    explicit Random(uint64_t ui64Seed) : m_ui64State(ui64Seed ? ui64Seed : 0x9E3779B97F4A7C15ULL) {}
+
+    uint64_t Next() {
+        m_ui64State ^= m_ui64State >> 12;
+        m_ui64State ^= m_ui64State << 25;
+        m_ui64State ^= m_ui64State >> 27;
+        return m_ui64State * 0x2545F4914F6CDD1DULL;
+    }
+
+    // [0, ui64Bound)范围内的整数
+    uint64_t Below(uint64_t ui64Bound) { return ui64Bound ? Next() % ui64Bound : 0; }
+
+    // 用伪随机字节填充缓冲区
+    void Fill(void* pBuffer, size_t nBytes) {
+        unsigned char* pBytes = static_cast<unsigned char*>(pBuffer);
+        for (size_t i = 0; i < nBytes; i++) {
+            pBytes[i] = static_cast<unsigned char>(Next() >> 56);
+        }
+    }
+
+private:
+    uint64_t m_ui64State;
+};
+
+}  // namespace TestHarness
+
+#define TEST_CASE(name)                                                          \
+    static void name();                                                          \
+    static const TestHarness::Registrar g_objRegistrar_##name(#name, name);      \
+    static void name()
+
+#define CHECK(expr)                                                              \
+    do {                                                                         \
+        if (!(expr)) TestHarness::Fail(__FILE__, __LINE__, #expr);               \
+    } while (0)
+
+#define REQUIRE(expr)                                                            \
+    do {                                                                         \
+        if (!(expr)) {                                                           \
+            TestHarness::Fail(__FILE__, __LINE__, #expr);                        \
+            throw TestHarness::RequireFailure();                                 \
+        }                                                                        \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                               \
+    do {                                                                         \
+        const auto& _objActual = (actual);                                       \
+        const auto& _objExpected = (expected);                                   \
+        if (!(_objActual == _objExpected)) {                                     \
+            TestHarness::Fail(__FILE__, __LINE__, std::string(#actual " == " #expected ", actual: ") + \
+                              TestHarness::Describe(_objActual) + ", expected: " +                     \
+                              TestHarness::Describe(_objExpected));                                    \
+        }                                                                        \
+    } while (0)
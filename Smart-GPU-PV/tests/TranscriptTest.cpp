@@ -0,0 +1,154 @@
+﻿/********************************************************************************
+* 文件名称：TranscriptTest.cpp
+* 文件功能：验证在执行器入口录制（常驻宿主保持启用）并在没有后端的情况下回放
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "FakeProcessBackend.h"
+#include "../Smart-GPU-PV/PowerShellExecutor.h"
+#include "../Smart-GPU-PV/QueryCache.h"
+#include "../Smart-GPU-PV/TranscriptBackend.h"
+#include <chrono>
+
+/********************************************************************************
+* 结构体名称：一次配置流程的输出
+*********************************************************************************/
+struct FlowOutput {
+    bool                     bAllOk = true;
+    std::string              strSingle;      // ExecuteWithCheck的输出
+    std::vector<std::string> vecBatch;       // Batch::Run的输出
+    std::vector<std::string> vecLines;       // ExecuteStreaming推送的行
+    std::string              strAsync;       // ExecuteAsync的输出
+};
+
+/********************************************************************************
+* 函数名称：按配置流程的方式执行一组命令（单条、批量、流式、异步）
+*********************************************************************************/
+static FlowOutput RunFlow() {
+    FlowOutput stcFlow;
+    std::string strError;
+    stcFlow.bAllOk = PowerShellExecutor::ExecuteWithCheck("Get-VM -Name 'vm1'", stcFlow.strSingle, strError);
+
+    PowerShellExecutor::Batch objBatch;
+    objBatch.Add("Set-VMProcessor -VMName 'vm1' -Count 4").Add("Get-VMProcessor -VMName 'vm1'");
+    std::vector<CommandResult> vecResults;
+    stcFlow.bAllOk = objBatch.Run(vecResults) && stcFlow.bAllOk;
+    for (const auto& stcResult : vecResults) {
+        stcFlow.vecBatch.push_back(stcResult.strOutput);
+    }
+
+    stcFlow.bAllOk = PowerShellExecutor::ExecuteStreaming("Copy-Drivers", [&](std::string_view svLine) {
+        stcFlow.vecLines.emplace_back(svLine);
+    }, strError) && stcFlow.bAllOk;
+
+    CommandResult stcAsync = PowerShellExecutor::ExecuteAsync("Start-VM -Name 'vm1'", CancellationToken()).get();
+    stcFlow.bAllOk = stcFlow.bAllOk && stcAsync.nExitCode == 0;
+    stcFlow.strAsync = stcAsync.strOutput;
+    return stcFlow;
+}
+
+TEST_CASE(RecordsAtExecutorWithHostEnabledAndReplaysWithoutBackend) {
+    QueryCache::Instance().Clear();
+    TestHarness::TempDir objDir;
+
+    // 1. 录制：常驻宿主保持启用，单条和批量命令经过宿主
+    auto pBackend = std::make_shared<FakeProcessBackend>();
+    pBackend->stcConfig.fnHandler = [](const std::string& strCommand) {
+        CommandResult stcResult;
+        stcResult.nExitCode = 0;
+        stcResult.strOutput = (strCommand == "Copy-Drivers") ? "file1\nfile2\nfile3" : "out:" + strCommand;
+        return stcResult;
+    };
+    PowerShellExecutor::SetProcessBackend(pBackend);
+    PowerShellExecutor::EnablePersistentHost(true, 1);
+    auto pRecorder = std::make_shared<TranscriptRecorder>();
+    Transcript::SetActive(pRecorder);
+
+    FlowOutput stcRecorded = RunFlow();
+    CHECK(stcRecorded.bAllOk);
+    CHECK_EQ(stcRecorded.strSingle, std::string("out:Get-VM -Name 'vm1'"));
+    CHECK_EQ(stcRecorded.vecLines.size(), size_t(3));
+    CHECK_EQ(pBackend->stcStats.nRequests.load(), size_t(2));   // 单条和批量各一次往返
+    CHECK_EQ(pBackend->stcStats.nRuns.load(), size_t(2));       // 流式和异步使用独立进程
+
+    // 2. 每条命令各一条记录，键为命令文本（不含命令行前缀）
+    std::vector<TranscriptEntry> vecEntries = pRecorder->GetEntries();
+    REQUIRE(vecEntries.size() == 5);
+    CHECK_EQ(vecEntries[0].strKind, std::string("run"));
+    CHECK_EQ(vecEntries[0].strCommand, std::string("Get-VM -Name 'vm1'"));
+    CHECK_EQ(vecEntries[2].strCommand, std::string("Get-VMProcessor -VMName 'vm1'"));
+    CHECK_EQ(vecEntries[3].strKind, std::string("stream"));
+    CHECK_EQ(vecEntries[4].strKind, std::string("async"));
+
+    // 3. 保存后重新加载
+    std::string strError;
+    REQUIRE(Transcript::Save(objDir.File("flow.sgpt"), vecEntries, strError));
+    std::vector<TranscriptEntry> vecLoaded;
+    REQUIRE(Transcript::Load(objDir.File("flow.sgpt"), vecLoaded, strError));
+    REQUIRE(vecLoaded.size() == vecEntries.size());
+    CHECK_EQ(vecLoaded[3].stcResult.strOutput, vecEntries[3].stcResult.strOutput);
+
+    // 4. 回放：后端的所有命令都失败，结果必须完全来自记录文件
+    auto pDeadBackend = std::make_shared<FakeProcessBackend>();
+    std::atomic<int> nBackendCalls{ 0 };
+    pDeadBackend->stcConfig.fnHandler = [&](const std::string&) {
+        nBackendCalls++;
+        CommandResult stcResult;
+        stcResult.nExitCode = 1;
+        return stcResult;
+    };
+    PowerShellExecutor::SetProcessBackend(pDeadBackend);
+    PowerShellExecutor::EnablePersistentHost(true, 1);
+    auto pReplayer = std::make_shared<TranscriptReplayer>(vecLoaded, 0.0);
+    Transcript::SetActive(pReplayer);
+
+    FlowOutput stcReplayed = RunFlow();
+    CHECK(stcReplayed.bAllOk);
+    CHECK_EQ(stcReplayed.strSingle, stcRecorded.strSingle);
+    CHECK(stcReplayed.vecBatch == stcRecorded.vecBatch);
+    CHECK(stcReplayed.vecLines == stcRecorded.vecLines);
+    CHECK_EQ(stcReplayed.strAsync, stcRecorded.strAsync);
+    CHECK_EQ(nBackendCalls.load(), 0);
+    CHECK_EQ(pDeadBackend->stcStats.nSpawns.load(), size_t(0));
+    CHECK_EQ(pReplayer->GetMissCount(), size_t(0));
+    CHECK(Transcript::Finish(strError));
+
+    // 5. 不在记录中的命令失败并计入未命中，Finish报告错误
+    std::string strOutput;
+    CHECK(!PowerShellExecutor::ExecuteWithCheck("Remove-VM -Name 'vm1'", strOutput, strError));
+    CHECK_EQ(pReplayer->GetMissCount(), size_t(1));
+    CHECK(!Transcript::Finish(strError));
+
+    Transcript::SetActive(nullptr);
+    PowerShellExecutor::Shutdown();
+}
+
+TEST_CASE(ReplayReturnsEntriesInOrderThenRepeatsLast) {
+    std::vector<TranscriptEntry> vecEntries(2);
+    for (size_t i = 0; i < vecEntries.size(); i++) {
+        vecEntries[i].strKind = "run";
+        vecEntries[i].strCommand = "(Get-VM -Name 'vm1').State";
+        vecEntries[i].stcResult.nExitCode = 0;
+        vecEntries[i].stcResult.strOutput = (i == 0) ? "Running" : "Off";
+        vecEntries[i].ui64WallUs = 20000;
+    }
+    TranscriptReplayer objReplayer(vecEntries, 1.0);
+
+    CommandResult stcResult;
+    auto tpStart = std::chrono::steady_clock::now();
+    REQUIRE(objReplayer.Replay("run", "(Get-VM -Name 'vm1').State", stcResult));
+    CHECK(std::chrono::steady_clock::now() - tpStart >= std::chrono::milliseconds(20));   // 按原始耗时等待
+    CHECK_EQ(stcResult.strOutput, std::string("Running"));
+    REQUIRE(objReplayer.Replay("run", "(Get-VM -Name 'vm1').State", stcResult));
+    CHECK_EQ(stcResult.strOutput, std::string("Off"));
+    REQUIRE(objReplayer.Replay("run", "(Get-VM -Name 'vm1').State", stcResult));
+    CHECK_EQ(stcResult.strOutput, std::string("Off"));
+
+    // 方式不同视为不同的命令
+    CHECK(!objReplayer.Replay("stream", "(Get-VM -Name 'vm1').State", stcResult));
+    CHECK_EQ(objReplayer.GetMissCount(), size_t(1));
+}
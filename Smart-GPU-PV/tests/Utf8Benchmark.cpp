@@ -0,0 +1,150 @@
+﻿/********************************************************************************
+* 文件名称：Utf8Benchmark.cpp
+* 文件功能：比较UTF-8检查和乱码修复的新旧实现
+*
+* 说明：
+*    输入模拟驱动文件枚举的输出（数MB的路径行，少量中文行）：
+*    - 旧实现：逐字节检查UTF-8（不拒绝超长编码和代理区），无效时整个缓冲区
+*      按GBK重新解码（有效的UTF-8中文随之变成乱码）
+*    - 新实现：Utils::FindInvalidUTF8批量跳过ASCII，RepairString只转换无效片段
+*    两种实现的GBK解码都使用内置GBK表，差别只在检查和片段划分。
+*    直接运行得到完整结果；CTest以--quick运行，只验证结果正确。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "../Smart-GPU-PV/Utils.h"
+#include "../Smart-GPU-PV/GbkTable.h"
+#include <chrono>
+#include <cstdio>
+
+/********************************************************************************
+* 函数名称：旧实现：逐字节检查UTF-8
+*********************************************************************************/
+static bool LegacyIsValidUTF8(const std::string& str) {
+    const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(str.c_str());
+    while (*pBytes) {
+        if ((*pBytes & 0x80) == 0) {
+            pBytes++;
+        } else if ((*pBytes & 0xE0) == 0xC0) {
+            if ((pBytes[1] & 0xC0) != 0x80) return false;
+            pBytes += 2;
+        } else if ((*pBytes & 0xF0) == 0xE0) {
+            if ((pBytes[1] & 0xC0) != 0x80 || (pBytes[2] & 0xC0) != 0x80) return false;
+            pBytes += 3;
+        } else if ((*pBytes & 0xF8) == 0xF0) {
+            if ((pBytes[1] & 0xC0) != 0x80 || (pBytes[2] & 0xC0) != 0x80 || (pBytes[3] & 0xC0) != 0x80) return false;
+            pBytes += 4;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数名称：旧实现：整个缓冲区按GBK解码
+*********************************************************************************/
+static std::string LegacyRepairString(const std::string& str) {
+    if (LegacyIsValidUTF8(str)) {
+        return str;
+    }
+    std::string strResult;
+    const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(str.data());
+    for (size_t i = 0; i < str.size(); i++) {
+        uint32_t ui32CodePoint = pBytes[i];
+        if (pBytes[i] >= 0x80) {
+            ui32CodePoint = 0xFFFD;
+            if (pBytes[i] >= GBK_LEAD_FIRST && pBytes[i] <= 0xFE && i + 1 < str.size() &&
+                pBytes[i + 1] >= GBK_TRAIL_FIRST && pBytes[i + 1] <= 0xFE && pBytes[i + 1] != 0x7F) {
+                uint16_t ui16Mapped = GBK_TO_UNICODE[(pBytes[i] - GBK_LEAD_FIRST) * GBK_TRAIL_COUNT +
+                                                     (pBytes[i + 1] - GBK_TRAIL_FIRST)];
+                ui32CodePoint = ui16Mapped ? ui16Mapped : 0xFFFD;
+                i++;
+            }
+        }
+        if (ui32CodePoint < 0x80) {
+            strResult += static_cast<char>(ui32CodePoint);
+        } else if (ui32CodePoint < 0x800) {
+            strResult += static_cast<char>(0xC0 | (ui32CodePoint >> 6));
+            strResult += static_cast<char>(0x80 | (ui32CodePoint & 0x3F));
+        } else {
+            strResult += static_cast<char>(0xE0 | (ui32CodePoint >> 12));
+            strResult += static_cast<char>(0x80 | ((ui32CodePoint >> 6) & 0x3F));
+            strResult += static_cast<char>(0x80 | (ui32CodePoint & 0x3F));
+        }
+    }
+    return strResult;
+}
+
+/********************************************************************************
+* 函数名称：生成模拟驱动文件枚举的输出
+* 函数参数：
+*    [IN]  size_t nBytes：目标大小
+*    [IN]  bool bWithGbk：是否每200行插入一行GBK编码的中文
+*********************************************************************************/
+static std::string MakeDriverListing(size_t nBytes, bool bWithGbk) {
+    std::string strText;
+    TestHarness::Random objRandom(7);
+    for (size_t nLine = 0; strText.size() < nBytes; nLine++) {
+        if (nLine % 20 == 0) {
+            strText += "[INFO] 正在复制驱动包 nv_dispi.inf_amd64_" + std::to_string(objRandom.Below(100000)) + "\n";
+        } else if (bWithGbk && nLine % 200 == 7) {
+            strText += "[WARN] \xCF\xD4\xBF\xA8\xC7\xFD\xB6\xAF\xD2\xD1\xB0\xB2\xD7\xB0\n";   // GBK："显卡驱动已安装"
+        } else {
+            std::string strName = "nv" + std::to_string(objRandom.Below(1000000)) + ".dll";
+            strText += "[FILE] C:\\Windows\\System32\\DriverStore\\FileRepository\\nv_dispi.inf_amd64\\" + strName +
+                       " -> E:\\Windows\\System32\\HostDriverStore\\FileRepository\\nv_dispi.inf_amd64\\" + strName + "\n";
+        }
+    }
+    return strText;
+}
+
+/********************************************************************************
+* 函数名称：测量函数的吞吐量（MB/s）
+*********************************************************************************/
+template <typename TFunc>
+static double MeasureMBps(const std::string& strInput, TFunc fnRun) {
+    size_t nRounds = TestHarness::QuickMode() ? 2 : 20;
+    auto tpStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < nRounds; i++) {
+        fnRun();
+    }
+    double dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tpStart).count();
+    return (strInput.size() * nRounds / 1048576.0) / (dSeconds > 0 ? dSeconds : 1e-9);
+}
+
+TEST_CASE(ValidationOfCleanDriverListing) {
+    std::string strInput = MakeDriverListing(TestHarness::QuickMode() ? (256 << 10) : (8 << 20), false);
+    volatile bool bSink = false;
+    double dLegacy = MeasureMBps(strInput, [&]() { bSink = LegacyIsValidUTF8(strInput); });
+    double dCurrent = MeasureMBps(strInput, [&]() { bSink = Utils::IsValidUTF8(strInput); });
+
+    std::printf("clean listing, %zu KB\n", strInput.size() >> 10);
+    std::printf("  legacy byte-at-a-time      %9.1f MB/s\n", dLegacy);
+    std::printf("  FindInvalidUTF8            %9.1f MB/s  (%.1fx)\n", dCurrent, dCurrent / dLegacy);
+    CHECK(LegacyIsValidUTF8(strInput));
+    CHECK(Utils::IsValidUTF8(strInput));
+    CHECK_EQ(Utils::RepairString(strInput), strInput);
+    (void)bSink;
+}
+
+TEST_CASE(RepairOfListingWithGbkLines) {
+    std::string strInput = MakeDriverListing(TestHarness::QuickMode() ? (256 << 10) : (8 << 20), true);
+    std::string strLegacy, strCurrent;
+    double dLegacy = MeasureMBps(strInput, [&]() { strLegacy = LegacyRepairString(strInput); });
+    double dCurrent = MeasureMBps(strInput, [&]() { strCurrent = Utils::RepairString(strInput); });
+
+    std::printf("listing with GBK lines, %zu KB\n", strInput.size() >> 10);
+    std::printf("  legacy whole-buffer decode %9.1f MB/s\n", dLegacy);
+    std::printf("  RepairString (spans)       %9.1f MB/s  (%.1fx)\n", dCurrent, dCurrent / dLegacy);
+
+    // 新实现：GBK行被修复，UTF-8中文行保持不变；旧实现把UTF-8中文也当作GBK解码
+    CHECK(Utils::IsValidUTF8(strCurrent));
+    CHECK(strCurrent.find("[WARN] 显卡驱动已安装\n") != std::string::npos);
+    CHECK(strCurrent.find("[INFO] 正在复制驱动包") != std::string::npos);
+    CHECK(strLegacy.find("[INFO] 正在复制驱动包") == std::string::npos);
+}
@@ -0,0 +1,336 @@
+﻿/********************************************************************************
+* 文件名称：VhdFileTest.cpp
+* 文件功能：在生成的VHD文件上验证尾部和BAT的解析、扇区位图和动态磁盘的块分配
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "VhdImageBuilder.h"
+#include "../Smart-GPU-PV/VhdFile.h"
+#include <fstream>
+#include <iterator>
+
+static const uint64_t MB = 1024 * 1024;
+static const uint32_t SECTOR = VhdImageBuilder::SECTOR_SIZE;
+
+static std::vector<uint8_t> ReadWholeFile(const std::string& strPath) {
+    std::ifstream objFile(strPath, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(objFile), std::istreambuf_iterator<char>());
+}
+
+static void WriteWholeFile(const std::string& strPath, const std::vector<uint8_t>& vecFile) {
+    std::ofstream objFile(strPath, std::ios::binary | std::ios::trunc);
+    objFile.write(reinterpret_cast<const char*>(vecFile.data()), static_cast<std::streamsize>(vecFile.size()));
+}
+
+static std::vector<uint8_t> RandomBytes(TestHarness::Random& objRandom, size_t nBytes) {
+    std::vector<uint8_t> vecData(nBytes);
+    objRandom.Fill(vecData.data(), nBytes);
+    return vecData;
+}
+
+// 整个虚拟磁盘与模型一致（按1MB分段读取，不经过缓存）
+static bool MatchesModel(VhdFile& objDisk, const std::vector<uint8_t>& vecModel) {
+    std::vector<uint8_t> vecBuffer(MB);
+    std::string strError;
+    for (uint64_t ui64Offset = 0; ui64Offset < vecModel.size(); ui64Offset += MB) {
+        if (!objDisk.Read(ui64Offset, vecBuffer.data(), MB, strError) ||
+            memcmp(vecBuffer.data(), vecModel.data() + ui64Offset, MB) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 随机的小范围读取（经过64KB页缓存，可以跨块）与模型一致
+static bool RandomReadsMatch(VhdFile& objDisk, const std::vector<uint8_t>& vecModel, TestHarness::Random& objRandom) {
+    std::vector<uint8_t> vecBuffer(64 * 1024);
+    std::string strError;
+    for (int i = 0; i < 200; i++) {
+        size_t nBytes = 1 + static_cast<size_t>(objRandom.Below(vecBuffer.size()));
+        uint64_t ui64Offset = objRandom.Below(vecModel.size() - nBytes + 1);
+        if (!objDisk.Read(ui64Offset, vecBuffer.data(), nBytes, strError) ||
+            memcmp(vecBuffer.data(), vecModel.data() + ui64Offset, nBytes) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/********************************************************************************
+* 函数名称：生成部分存在的块
+* 说明：vecData为文件中的块内容；返回的模型中未置位的扇区为0
+*********************************************************************************/
+static std::vector<uint8_t> PartialBlock(TestHarness::Random& objRandom, uint32_t ui32BlockSize,
+                                         std::vector<uint8_t>& vecData, std::vector<bool>& vecPresent) {
+    vecData = RandomBytes(objRandom, ui32BlockSize);
+    vecPresent.assign(ui32BlockSize / SECTOR, false);
+    std::vector<uint8_t> vecModel(ui32BlockSize, 0);
+    for (size_t i = 0; i < vecPresent.size(); i++) {
+        vecPresent[i] = objRandom.Below(3) != 0;
+        if (vecPresent[i]) {
+            memcpy(vecModel.data() + i * SECTOR, vecData.data() + i * SECTOR, SECTOR);
+        }
+    }
+    return vecModel;
+}
+
+static uint32_t BatEntry(const std::vector<uint8_t>& vecFile, const VhdLayout& stcLayout, uint64_t ui64Block) {
+    return VhdImageBuilder::Get32(vecFile.data() + stcLayout.ui64BatOffset + ui64Block * 4);
+}
+
+// 块的扇区位图是否全部置位
+static bool BitmapFull(const std::vector<uint8_t>& vecFile, uint32_t ui32Entry, uint32_t ui32BlockSize) {
+    const uint8_t* pBitmap = vecFile.data() + static_cast<uint64_t>(ui32Entry) * SECTOR;
+    for (uint32_t i = 0; i < ui32BlockSize / SECTOR / 8; i++) {
+        if (pBitmap[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE(FixedDiskReadsAndWritesInPlace) {
+    TestHarness::TempDir objDir;
+    TestHarness::Random objRandom(23);
+    const uint64_t ui64DiskSize = 6 * MB + 7 * SECTOR;             // 不是块大小的整数倍
+    std::vector<uint8_t> vecModel = RandomBytes(objRandom, ui64DiskSize);
+    VhdImageBuilder objBuilder(ui64DiskSize, 2 * MB, true);
+    for (uint64_t ui64Block = 0; ui64Block * 2 * MB < ui64DiskSize; ui64Block++) {
+        uint64_t ui64End = std::min<uint64_t>((ui64Block + 1) * 2 * MB, ui64DiskSize);
+        objBuilder.SetBlock(ui64Block, std::vector<uint8_t>(vecModel.begin() + ui64Block * 2 * MB, vecModel.begin() + ui64End));
+    }
+    std::string strPath = objDir.File("fixed.vhd");
+    REQUIRE(objBuilder.Save(strPath));
+    const uint64_t ui64FileSize = objBuilder.Layout().ui64FileSize;
+    CHECK_EQ(ui64FileSize, ui64DiskSize + VhdImageBuilder::FOOTER_SIZE);
+
+    // 1. 尾部：大小和类型
+    VhdFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strPath, false, strError));
+    CHECK_EQ(objDisk.Size(), ui64DiskSize);
+    CHECK(!objDisk.IsDynamic());
+    CHECK_EQ(objDisk.SectorSize(), SECTOR);
+    CHECK(RandomReadsMatch(objDisk, vecModel, objRandom));
+
+    // 2. 随机写入（含磁盘末尾的不完整MB）原地完成，文件大小不变
+    for (int i = 0; i < 50; i++) {
+        size_t nBytes = 1 + static_cast<size_t>(objRandom.Below(300 * 1024));
+        uint64_t ui64Offset = objRandom.Below(ui64DiskSize - nBytes + 1);
+        objRandom.Fill(vecModel.data() + ui64Offset, nBytes);
+        REQUIRE(objDisk.Write(ui64Offset, vecModel.data() + ui64Offset, nBytes, strError));
+    }
+    std::vector<uint8_t> vecBuffer(8192);
+    CHECK(!objDisk.Read(ui64DiskSize - 100, vecBuffer.data(), 200, strError));       // 超出范围
+    CHECK(!objDisk.Write(ui64DiskSize - 100, vecBuffer.data(), 200, strError));
+    CHECK(RandomReadsMatch(objDisk, vecModel, objRandom));
+    objDisk.Close();
+
+    // 3. 文件就是数据 + 尾部；重新以只读方式打开后内容一致
+    std::vector<uint8_t> vecFile = ReadWholeFile(strPath);
+    REQUIRE(vecFile.size() == ui64FileSize);
+    CHECK(memcmp(vecFile.data(), vecModel.data(), static_cast<size_t>(ui64DiskSize)) == 0);
+    CHECK(memcmp(vecFile.data() + ui64DiskSize, "conectix", 8) == 0);
+    REQUIRE(objDisk.Open(strPath, true, strError));
+    std::vector<uint8_t> vecWhole(static_cast<size_t>(ui64DiskSize));
+    REQUIRE(objDisk.Read(0, vecWhole.data(), vecWhole.size(), strError));
+    CHECK(vecWhole == vecModel);
+    CHECK(!objDisk.Write(0, vecModel.data(), SECTOR, strError));                     // 只读
+}
+
+TEST_CASE(DynamicDiskReadsOnlySectorsMarkedInBitmap) {
+    TestHarness::TempDir objDir;
+    TestHarness::Random objRandom(230);
+    const uint64_t ui64DiskSize = 16 * MB;
+    const uint32_t ui32BlockSize = 2 * MB;
+    std::vector<uint8_t> vecModel(ui64DiskSize, 0);
+    VhdImageBuilder objBuilder(ui64DiskSize, ui32BlockSize, false);
+    std::vector<uint8_t> vecFull = RandomBytes(objRandom, ui32BlockSize);
+    memcpy(vecModel.data() + ui32BlockSize, vecFull.data(), ui32BlockSize);
+    objBuilder.SetBlock(1, vecFull);
+    for (uint64_t ui64Block : { 4, 7 }) {
+        std::vector<uint8_t> vecData;
+        std::vector<bool> vecPresent;
+        std::vector<uint8_t> vecBlock = PartialBlock(objRandom, ui32BlockSize, vecData, vecPresent);
+        memcpy(vecModel.data() + ui64Block * ui32BlockSize, vecBlock.data(), ui32BlockSize);
+        objBuilder.SetPartialBlock(ui64Block, vecData, vecPresent);
+    }
+    std::string strPath = objDir.File("dynamic.vhd");
+    REQUIRE(objBuilder.Save(strPath));
+
+    // 1. 头部和BAT：块大小、已分配的块；未分配的块和未置位的扇区读出为0
+    VhdFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strPath, true, strError));
+    CHECK(objDisk.IsDynamic());
+    CHECK_EQ(objDisk.Size(), ui64DiskSize);
+    CHECK_EQ(objDisk.BlockSize(), ui32BlockSize);
+    CHECK(MatchesModel(objDisk, vecModel));
+    CHECK(RandomReadsMatch(objDisk, vecModel, objRandom));
+
+    // 2. 缓存容量为0时结果相同
+    VhdFile objUncached(0);
+    REQUIRE(objUncached.Open(strPath, true, strError));
+    CHECK(RandomReadsMatch(objUncached, vecModel, objRandom));
+}
+
+TEST_CASE(DynamicDiskAllocatesBlocksAtFooterPosition) {
+    TestHarness::TempDir objDir;
+    TestHarness::Random objRandom(2300);
+    const uint64_t ui64DiskSize = 16 * MB;
+    const uint32_t ui32BlockSize = 2 * MB;
+    std::vector<uint8_t> vecModel(ui64DiskSize, 0);
+    VhdImageBuilder objBuilder(ui64DiskSize, ui32BlockSize, false);
+    std::vector<uint8_t> vecFull = RandomBytes(objRandom, ui32BlockSize);
+    memcpy(vecModel.data() + ui32BlockSize, vecFull.data(), ui32BlockSize);
+    objBuilder.SetBlock(1, vecFull);
+    std::vector<std::vector<bool>> vecPresent(2);
+    for (uint64_t ui64Block : { 2, 3 }) {
+        std::vector<uint8_t> vecData;
+        std::vector<uint8_t> vecBlock = PartialBlock(objRandom, ui32BlockSize, vecData, vecPresent[ui64Block - 2]);
+        memcpy(vecModel.data() + ui64Block * ui32BlockSize, vecBlock.data(), ui32BlockSize);
+        objBuilder.SetPartialBlock(ui64Block, vecData, vecPresent[ui64Block - 2]);
+    }
+    std::string strPath = objDir.File("dynamic.vhd");
+    REQUIRE(objBuilder.Save(strPath));
+    const VhdLayout stcLayout = objBuilder.Layout();
+    const std::vector<uint8_t> vecOriginal = ReadWholeFile(strPath);
+
+    VhdFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strPath, false, strError));
+    auto Write = [&](uint64_t ui64Offset, size_t nBytes) {
+        objRandom.Fill(vecModel.data() + ui64Offset, nBytes);
+        REQUIRE(objDisk.Write(ui64Offset, vecModel.data() + ui64Offset, nBytes, strError));
+    };
+
+    // 1. 位图中已置位的扇区原地写入：块2中找一段连续存在的扇区
+    size_t nPresent = 0;
+    while (!(vecPresent[0][nPresent] && vecPresent[0][nPresent + 1])) nPresent++;
+    Write(2 * ui32BlockSize + nPresent * SECTOR + 10, SECTOR + 100);
+    Write(ui32BlockSize + 100, 100000);                             // 完全存在的块
+
+    // 2. 块3中包含未置位扇区的写入：整块合并，未写入的未置位扇区仍读出为0
+    size_t nAbsent = 0;
+    while (vecPresent[1][nAbsent]) nAbsent++;
+    Write(3 * ui32BlockSize + nAbsent * SECTOR + 200, 100);
+
+    // 3. 写入未分配的块：新块依次放在原来尾部的位置
+    Write(5 * ui32BlockSize + 12345, 4096);
+    Write(7 * ui32BlockSize - 1000, 3000);                          // 跨块6、7
+    CHECK(MatchesModel(objDisk, vecModel));
+    CHECK(RandomReadsMatch(objDisk, vecModel, objRandom));
+    objDisk.Close();
+
+    // 4. BAT指向原尾部位置起的新块，位图全部置位；文件末尾和开头都是原来的尾部
+    std::vector<uint8_t> vecFile = ReadWholeFile(strPath);
+    const uint64_t ui64BlockBytes = stcLayout.ui32BitmapSize + ui32BlockSize;
+    REQUIRE(vecFile.size() == stcLayout.ui64FileSize + 3 * ui64BlockBytes);
+    const uint64_t ui64Expected[][2] = { { 5, stcLayout.ui64FooterOffset }, { 6, stcLayout.ui64FooterOffset + ui64BlockBytes },
+                                         { 7, stcLayout.ui64FooterOffset + 2 * ui64BlockBytes },
+                                         { 1, stcLayout.mapBlockOffsets.at(1) }, { 2, stcLayout.mapBlockOffsets.at(2) },
+                                         { 3, stcLayout.mapBlockOffsets.at(3) } };
+    for (const auto& ui64Pair : ui64Expected) {
+        CHECK_EQ(BatEntry(vecFile, stcLayout, ui64Pair[0]), static_cast<uint32_t>(ui64Pair[1] / SECTOR));
+    }
+    CHECK_EQ(BatEntry(vecFile, stcLayout, 0), VhdImageBuilder::BAT_UNUSED);
+    CHECK_EQ(BatEntry(vecFile, stcLayout, 4), VhdImageBuilder::BAT_UNUSED);
+    for (uint64_t ui64Block : { 3, 5, 6, 7 }) {
+        CHECK(BitmapFull(vecFile, BatEntry(vecFile, stcLayout, ui64Block), ui32BlockSize));
+    }
+    CHECK(!BitmapFull(vecFile, BatEntry(vecFile, stcLayout, 2), ui32BlockSize));  // 原地写入不改变位图
+    CHECK(memcmp(vecFile.data() + vecFile.size() - VhdImageBuilder::FOOTER_SIZE,
+                 vecOriginal.data() + stcLayout.ui64FooterOffset, VhdImageBuilder::FOOTER_SIZE) == 0);
+    CHECK(memcmp(vecFile.data(), vecOriginal.data(), VhdImageBuilder::FOOTER_SIZE) == 0);
+
+    // 5. 重新打开后内容一致
+    REQUIRE(objDisk.Open(strPath, true, strError));
+    CHECK(MatchesModel(objDisk, vecModel));
+}
+
+TEST_CASE(CorruptTailFooterFallsBackToCopy) {
+    TestHarness::TempDir objDir;
+    TestHarness::Random objRandom(23000);
+    const uint64_t ui64DiskSize = 8 * MB;
+    std::vector<uint8_t> vecModel(ui64DiskSize, 0);
+    VhdImageBuilder objBuilder(ui64DiskSize, 2 * MB, false);
+    std::vector<uint8_t> vecBlock = RandomBytes(objRandom, 2 * MB);
+    memcpy(vecModel.data() + 2 * MB, vecBlock.data(), vecBlock.size());
+    objBuilder.SetBlock(1, vecBlock);
+    objBuilder.CorruptFooter();
+    std::string strPath = objDir.File("dynamic.vhd");
+    REQUIRE(objBuilder.Save(strPath));
+    const std::vector<uint8_t> vecOriginal = ReadWholeFile(strPath);
+    const uint64_t ui64FooterOffset = objBuilder.Layout().ui64FooterOffset;
+
+    // 1. 只读打开时使用开头的副本，文件不变
+    VhdFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strPath, true, strError));
+    CHECK(MatchesModel(objDisk, vecModel));
+    objDisk.Close();
+    CHECK(ReadWholeFile(strPath) == vecOriginal);
+
+    // 2. 读写打开时把副本写回末尾
+    REQUIRE(objDisk.Open(strPath, false, strError));
+    CHECK(MatchesModel(objDisk, vecModel));
+    objDisk.Close();
+    std::vector<uint8_t> vecFile = ReadWholeFile(strPath);
+    REQUIRE(vecFile.size() == vecOriginal.size());
+    CHECK(memcmp(vecFile.data() + ui64FooterOffset, vecFile.data(), VhdImageBuilder::FOOTER_SIZE) == 0);
+
+    // 3. 固定磁盘没有副本，尾部损坏时拒绝打开
+    VhdImageBuilder objFixed(4 * MB, 2 * MB, true);
+    objFixed.CorruptFooter();
+    std::string strFixed = objDir.File("fixed.vhd");
+    REQUIRE(objFixed.Save(strFixed));
+    CHECK(!objDisk.Open(strFixed, true, strError));
+    CHECK(strError.find("尾部已损坏") != std::string::npos);
+}
+
+TEST_CASE(InvalidImagesAreRejected) {
+    TestHarness::TempDir objDir;
+    VhdFile objDisk;
+    std::string strError;
+    auto Rejects = [&](const std::string& strPath, const std::string& strExpected) {
+        bool bRejected = !objDisk.Open(strPath, true, strError);
+        return bRejected && strError.find(strExpected) != std::string::npos && strError.find(strPath) != std::string::npos;
+    };
+
+    // 1. 差异磁盘需要父磁盘（调用者改为挂载）
+    VhdImageBuilder objDifferencing(8 * MB, 2 * MB, false);
+    objDifferencing.SetDiskType(VhdImageBuilder::DISK_TYPE_DIFFERENCING);
+    REQUIRE(objDifferencing.Save(objDir.File("diff.vhd")));
+    CHECK(Rejects(objDir.File("diff.vhd"), "差异"));
+
+    // 2. 动态磁盘头部校验和错误
+    VhdImageBuilder objHeader(8 * MB, 2 * MB, false);
+    objHeader.CorruptHeader();
+    REQUIRE(objHeader.Save(objDir.File("header.vhd")));
+    CHECK(Rejects(objDir.File("header.vhd"), "头部已损坏"));
+
+    // 3. BAT项指向尾部之后
+    VhdImageBuilder objBat(8 * MB, 2 * MB, false);
+    objBat.SetBlock(2, std::vector<uint8_t>(100, 1));
+    std::vector<uint8_t> vecFile = objBat.Build();
+    vecFile[objBat.Layout().ui64BatOffset + 3 * 4] = 0x00;        // 块3：扇区0x00FFFFFF
+    WriteWholeFile(objDir.File("bat.vhd"), vecFile);
+    CHECK(Rejects(objDir.File("bat.vhd"), "块 3"));
+
+    // 4. 固定磁盘的数据比尾部记录的大小短
+    VhdImageBuilder objFixed(4 * MB, 2 * MB, true);
+    vecFile = objFixed.Build();
+    vecFile.erase(vecFile.begin(), vecFile.begin() + MB);
+    WriteWholeFile(objDir.File("truncated.vhd"), vecFile);
+    CHECK(Rejects(objDir.File("truncated.vhd"), "被截断"));
+
+    // 5. 比尾部还短的文件
+    WriteWholeFile(objDir.File("short.vhd"), std::vector<uint8_t>(100, 0));
+    CHECK(Rejects(objDir.File("short.vhd"), "不是有效的VHD文件"));
+    char szBuffer[SECTOR];
+    CHECK(!objDisk.Read(0, szBuffer, SECTOR, strError));            // 打开失败后不可读取
+}
@@ -0,0 +1,238 @@
+﻿/********************************************************************************
+* 文件名称：VhdImageBuilder.h
+* 文件功能：测试用的VHD文件生成器，按规范从零写出固定和动态镜像
+*
+* 类说明：
+*    与VhdxImageBuilder一样不依赖Hyper-V或qemu-img，字段均为大端序：
+*    - 固定磁盘：虚拟磁盘数据 + 512字节尾部
+*    - 动态磁盘：0：尾部副本；512：动态磁盘头部（1KB）；1536：BAT（按扇区对齐）；
+*      之后按块号顺序放置已分配的块（扇区位图 + 数据），最后是尾部
+*    SetBlock设置完全存在的块；SetPartialBlock只在位图中标记部分扇区，
+*    其余扇区在文件中填入非零的内容，用于验证未置位的扇区读出为0。
+*    SetDiskType、CorruptFooter、CorruptHeader用于构造损坏或不支持的文件。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/********************************************************************************
+* 结构体名称：生成的VHD文件布局
+*********************************************************************************/
+struct VhdLayout {
+    uint64_t                     ui64BatOffset = 0;         // BAT偏移（动态磁盘）
+    uint32_t                     ui32BitmapSize = 0;        // 每个块的扇区位图大小（按扇区对齐）
+    uint64_t                     ui64FooterOffset = 0;      // 末尾的尾部偏移
+    uint64_t                     ui64FileSize = 0;          // 文件大小
+    std::map<uint64_t, uint64_t> mapBlockOffsets;           // 块号 -> 块（位图起始）的文件偏移
+};
+
+/********************************************************************************
+* 类名称：VHD文件生成器
+*
+* 调用示例：
+*    VhdImageBuilder objBuilder(16 * 1024 * 1024, 2 * 1024 * 1024, false);
+*    objBuilder.SetBlock(3, vecData);
+*    objBuilder.Save(objDir.File("dynamic.vhd"));
+*********************************************************************************/
+class VhdImageBuilder {
+public:
+    // 磁盘类型（尾部偏移60）
+    static constexpr uint32_t DISK_TYPE_FIXED = 2;
+    static constexpr uint32_t DISK_TYPE_DYNAMIC = 3;
+    static constexpr uint32_t DISK_TYPE_DIFFERENCING = 4;
+    static constexpr uint32_t BAT_UNUSED = 0xFFFFFFFF;
+    static constexpr uint32_t SECTOR_SIZE = 512;
+    static constexpr uint64_t FOOTER_SIZE = 512;
+    static constexpr uint64_t HEADER_OFFSET = 512;
+    static constexpr uint64_t HEADER_SIZE = 1024;
+
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  uint64_t ui64DiskSize：虚拟磁盘大小（扇区的整数倍）
+    *    [IN]  uint32_t ui32BlockSize：块大小（动态磁盘，通常为2MB）
+    *    [IN]  bool bFixed：固定磁盘
+    *********************************************************************************/
+    VhdImageBuilder(uint64_t ui64DiskSize, uint32_t ui32BlockSize, bool bFixed)
+        : m_ui64DiskSize(ui64DiskSize), m_ui32BlockSize(ui32BlockSize), m_bFixed(bFixed),
+          m_ui32DiskType(bFixed ? DISK_TYPE_FIXED : DISK_TYPE_DYNAMIC) {
+    }
+
+    // 设置块的内容（不足一块时其余为0）；动态磁盘中该块的位图全部置位
+    void SetBlock(uint64_t ui64Block, const std::vector<uint8_t>& vecData) {
+        m_mapBlocks[ui64Block] = vecData;
+        m_mapBlocks[ui64Block].resize(m_ui32BlockSize, 0);
+        m_mapPresent.erase(ui64Block);
+    }
+
+    // 设置部分存在的块（动态磁盘）：vecPresent[i]为真的扇区在位图中置位，其余扇区的数据仍写入文件
+    void SetPartialBlock(uint64_t ui64Block, const std::vector<uint8_t>& vecData, const std::vector<bool>& vecPresent) {
+        SetBlock(ui64Block, vecData);
+        m_mapPresent[ui64Block] = vecPresent;
+        m_mapPresent[ui64Block].resize(m_ui32BlockSize / SECTOR_SIZE, false);
+    }
+
+    // 写入的磁盘类型（默认按bFixed为固定或动态）
+    void SetDiskType(uint32_t ui32DiskType) { m_ui32DiskType = ui32DiskType; }
+    // 破坏文件末尾的尾部（动态磁盘开头的副本不变）
+    void CorruptFooter() { m_bCorruptFooter = true; }
+    // 破坏动态磁盘头部的校验和
+    void CorruptHeader() { m_bCorruptHeader = true; }
+
+    const VhdLayout& Layout() const { return m_stcLayout; }
+
+    /********************************************************************************
+    * 函数名称：生成文件内容
+    * 返回类型：std::vector<uint8_t>
+    *********************************************************************************/
+    std::vector<uint8_t> Build() {
+        // 1. 布局：动态磁盘的块依次排在BAT之后
+        const uint64_t ui64Blocks = (m_ui64DiskSize + m_ui32BlockSize - 1) / m_ui32BlockSize;
+        const uint32_t ui32BitmapBytes = m_ui32BlockSize / SECTOR_SIZE / 8;
+        m_stcLayout = VhdLayout();
+        m_stcLayout.ui32BitmapSize = (ui32BitmapBytes + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+        uint64_t ui64Next = m_ui64DiskSize;
+        if (!m_bFixed) {
+            m_stcLayout.ui64BatOffset = HEADER_OFFSET + HEADER_SIZE;
+            ui64Next = m_stcLayout.ui64BatOffset + (ui64Blocks * 4 + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+            for (const auto& [ui64Block, vecData] : m_mapBlocks) {
+                m_stcLayout.mapBlockOffsets[ui64Block] = ui64Next;
+                ui64Next += m_stcLayout.ui32BitmapSize + m_ui32BlockSize;
+            }
+        }
+        m_stcLayout.ui64FooterOffset = ui64Next;
+        m_stcLayout.ui64FileSize = ui64Next + FOOTER_SIZE;
+        std::vector<uint8_t> vecFile(static_cast<size_t>(m_stcLayout.ui64FileSize), 0);
+        uint8_t* pFile = vecFile.data();
+
+        // 2. 尾部：动态磁盘在文件开头另有一份副本
+        uint8_t ui8Footer[FOOTER_SIZE] = {};
+        memcpy(ui8Footer, "conectix", 8);
+        Put32(ui8Footer + 8, 2);
+        Put32(ui8Footer + 12, 0x00010000);
+        Put64(ui8Footer + 16, m_bFixed ? ~static_cast<uint64_t>(0) : HEADER_OFFSET);
+        memcpy(ui8Footer + 28, "sgpt", 4);
+        Put32(ui8Footer + 32, 0x00010000);
+        memcpy(ui8Footer + 36, "Wi2k", 4);
+        Put64(ui8Footer + 40, m_ui64DiskSize);
+        Put64(ui8Footer + 48, m_ui64DiskSize);
+        Put32(ui8Footer + 56, Geometry(m_ui64DiskSize / SECTOR_SIZE));
+        Put32(ui8Footer + 60, m_ui32DiskType);
+        for (int i = 0; i < 16; i++) {
+            ui8Footer[68 + i] = static_cast<uint8_t>(0x40 + i);
+        }
+        Put32(ui8Footer + 64, Checksum(ui8Footer, FOOTER_SIZE));
+        memcpy(pFile + m_stcLayout.ui64FooterOffset, ui8Footer, FOOTER_SIZE);
+        if (m_bCorruptFooter) {
+            pFile[m_stcLayout.ui64FooterOffset + 50] ^= 0xFF;
+        }
+
+        // 3. 固定磁盘：数据直接按偏移排列
+        if (m_bFixed) {
+            for (const auto& [ui64Block, vecData] : m_mapBlocks) {
+                uint64_t ui64Offset = ui64Block * m_ui32BlockSize;
+                size_t nBytes = static_cast<size_t>(std::min<uint64_t>(m_ui32BlockSize, m_ui64DiskSize - ui64Offset));
+                memcpy(pFile + ui64Offset, vecData.data(), nBytes);
+            }
+            return vecFile;
+        }
+        memcpy(pFile, ui8Footer, FOOTER_SIZE);
+
+        // 4. 动态磁盘头部
+        uint8_t* pHeader = pFile + HEADER_OFFSET;
+        memcpy(pHeader, "cxsparse", 8);
+        Put64(pHeader + 8, ~static_cast<uint64_t>(0));
+        Put64(pHeader + 16, m_stcLayout.ui64BatOffset);
+        Put32(pHeader + 24, 0x00010000);
+        Put32(pHeader + 28, static_cast<uint32_t>(ui64Blocks));
+        Put32(pHeader + 32, m_ui32BlockSize);
+        Put32(pHeader + 36, Checksum(pHeader, HEADER_SIZE, 36) ^ (m_bCorruptHeader ? 1u : 0u));
+
+        // 5. BAT和块：位图最高位对应块中的第一个扇区，未置位扇区的数据也写入文件
+        memset(pFile + m_stcLayout.ui64BatOffset, 0xFF, static_cast<size_t>(ui64Blocks * 4));
+        for (const auto& [ui64Block, ui64Offset] : m_stcLayout.mapBlockOffsets) {
+            Put32(pFile + m_stcLayout.ui64BatOffset + ui64Block * 4, static_cast<uint32_t>(ui64Offset / SECTOR_SIZE));
+            uint8_t* pBitmap = pFile + ui64Offset;
+            auto itPresent = m_mapPresent.find(ui64Block);
+            if (itPresent == m_mapPresent.end()) {
+                memset(pBitmap, 0xFF, ui32BitmapBytes);
+            } else {
+                for (size_t i = 0; i < itPresent->second.size(); i++) {
+                    if (itPresent->second[i]) {
+                        pBitmap[i / 8] |= static_cast<uint8_t>(0x80 >> (i % 8));
+                    }
+                }
+            }
+            memcpy(pBitmap + m_stcLayout.ui32BitmapSize, m_mapBlocks[ui64Block].data(), m_ui32BlockSize);
+        }
+        return vecFile;
+    }
+
+    /********************************************************************************
+    * 函数名称：生成并保存到文件
+    * 返回类型：bool
+    *********************************************************************************/
+    bool Save(const std::string& strPath) {
+        std::vector<uint8_t> vecFile = Build();
+        std::ofstream objFile(strPath, std::ios::binary | std::ios::trunc);
+        objFile.write(reinterpret_cast<const char*>(vecFile.data()), static_cast<std::streamsize>(vecFile.size()));
+        return static_cast<bool>(objFile);
+    }
+
+    // 大端读取（测试检查BAT项和尾部）
+    static uint32_t Get32(const uint8_t* p) {
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+               (static_cast<uint32_t>(p[2]) << 8) | p[3];
+    }
+
+    // 校验和：除校验和字段外所有字节之和取反
+    static uint32_t Checksum(const uint8_t* p, size_t nBytes, size_t nChecksumOffset = 64) {
+        uint32_t ui32Sum = 0;
+        for (size_t i = 0; i < nBytes; i++) {
+            if (i < nChecksumOffset || i >= nChecksumOffset + 4) {
+                ui32Sum += p[i];
+            }
+        }
+        return ~ui32Sum;
+    }
+
+private:
+    uint64_t                                     m_ui64DiskSize;
+    uint32_t                                     m_ui32BlockSize;
+    bool                                         m_bFixed;
+    uint32_t                                     m_ui32DiskType;
+    bool                                         m_bCorruptFooter = false;
+    bool                                         m_bCorruptHeader = false;
+    std::map<uint64_t, std::vector<uint8_t>>     m_mapBlocks;
+    std::map<uint64_t, std::vector<bool>>        m_mapPresent;
+    VhdLayout                                    m_stcLayout;
+
+    static void Put32(uint8_t* p, uint32_t v) {
+        p[0] = static_cast<uint8_t>(v >> 24);
+        p[1] = static_cast<uint8_t>(v >> 16);
+        p[2] = static_cast<uint8_t>(v >> 8);
+        p[3] = static_cast<uint8_t>(v);
+    }
+    static void Put64(uint8_t* p, uint64_t v) {
+        Put32(p, static_cast<uint32_t>(v >> 32));
+        Put32(p + 4, static_cast<uint32_t>(v));
+    }
+
+    // CHS几何（VHD规范附录：柱面16位、磁头8位、每磁道扇区8位）
+    static uint32_t Geometry(uint64_t ui64Sectors) {
+        uint64_t ui64Heads = 16, ui64PerTrack = 63;
+        uint64_t ui64Cylinders = ui64Sectors / (ui64Heads * ui64PerTrack);
+        if (ui64Cylinders > 65535) ui64Cylinders = 65535;
+        return static_cast<uint32_t>((ui64Cylinders << 16) | (ui64Heads << 8) | ui64PerTrack);
+    }
+};
@@ -0,0 +1,422 @@
+﻿/********************************************************************************
+* 文件名称：VhdxFileTest.cpp
+* 文件功能：在生成的VHDX文件上验证日志回放、固定和动态磁盘的读写以及块分配
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#include "TestHarness.h"
+#include "VhdxImageBuilder.h"
+#include "../Smart-GPU-PV/VhdxFile.h"
+#include <fstream>
+#include <iterator>
+
+static const uint64_t MB = 1024 * 1024;
+
+static std::vector<uint8_t> ReadWholeFile(const std::string& strPath) {
+    std::ifstream objFile(strPath, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(objFile), std::istreambuf_iterator<char>());
+}
+
+static uint64_t FileEntry(const std::vector<uint8_t>& vecFile, uint64_t ui64Offset) {
+    uint64_t ui64Value = 0;
+    memcpy(&ui64Value, vecFile.data() + ui64Offset, sizeof(ui64Value));
+    return ui64Value;
+}
+
+static std::vector<uint8_t> RandomBytes(TestHarness::Random& objRandom, size_t nBytes) {
+    std::vector<uint8_t> vecData(nBytes);
+    objRandom.Fill(vecData.data(), nBytes);
+    return vecData;
+}
+
+// 整个虚拟磁盘与模型一致（按1MB分段读取）
+static bool MatchesModel(VhdxFile& objDisk, const std::vector<uint8_t>& vecModel) {
+    std::vector<uint8_t> vecBuffer(MB);
+    std::string strError;
+    for (uint64_t ui64Offset = 0; ui64Offset < vecModel.size(); ui64Offset += MB) {
+        if (!objDisk.Read(ui64Offset, vecBuffer.data(), MB, strError) ||
+            memcmp(vecBuffer.data(), vecModel.data() + ui64Offset, MB) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE(FixedDiskReadsAndWritesInPlace) {
+    TestHarness::TempDir objDir;
+    TestHarness::Random objRandom(18);
+    const uint64_t ui64DiskSize = 8 * MB;
+    std::vector<uint8_t> vecModel = RandomBytes(objRandom, ui64DiskSize);
+    VhdxImageBuilder objBuilder(ui64DiskSize, MB, true);
+    for (uint64_t ui64Block = 0; ui64Block < 8; ui64Block++) {
+        objBuilder.SetBlock(ui64Block, std::vector<uint8_t>(vecModel.begin() + ui64Block * MB,
+                                                            vecModel.begin() + (ui64Block + 1) * MB));
+    }
+    std::string strPath = objDir.File("fixed.vhdx");
+    REQUIRE(objBuilder.Save(strPath));
+    const uint64_t ui64FileSize = objBuilder.Layout().ui64FileSize;
+
+    VhdxFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strPath, false, strError));
+    CHECK_EQ(objDisk.Size(), ui64DiskSize);
+    CHECK_EQ(objDisk.BlockSize(), static_cast<uint32_t>(MB));
+    CHECK_EQ(objDisk.SectorSize(), 512u);
+    CHECK(!objDisk.LogReplayed());
+
+    // 1. 随机读取：小块经过缓存，大块直接读文件，范围可以跨块
+    std::vector<uint8_t> vecBuffer(2 * MB);
+    for (int i = 0; i < 200; i++) {
+        size_t nBytes = 1 + static_cast<size_t>(objRandom.Below(i % 4 == 0 ? 2 * MB : 8192));
+        uint64_t ui64Offset = objRandom.Below(ui64DiskSize - nBytes + 1);
+        REQUIRE(objDisk.Read(ui64Offset, vecBuffer.data(), nBytes, strError));
+        CHECK(memcmp(vecBuffer.data(), vecModel.data() + ui64Offset, nBytes) == 0);
+    }
+
+    // 2. 随机写入（含跨块写入）原地完成，文件大小不变
+    for (int i = 0; i < 50; i++) {
+        size_t nBytes = 1 + static_cast<size_t>(objRandom.Below(300 * 1024));
+        uint64_t ui64Offset = objRandom.Below(ui64DiskSize - nBytes + 1);
+        objRandom.Fill(vecModel.data() + ui64Offset, nBytes);
+        REQUIRE(objDisk.Write(ui64Offset, vecModel.data() + ui64Offset, nBytes, strError));
+    }
+    CHECK(MatchesModel(objDisk, vecModel));
+    objDisk.Close();
+
+    // 3. 写入前两份头部依次更新，重新打开后内容一致
+    std::vector<uint8_t> vecFile = ReadWholeFile(strPath);
+    CHECK_EQ(static_cast<uint64_t>(vecFile.size()), ui64FileSize);
+    CHECK(FileEntry(vecFile, 64 * 1024 + 8) > 2 || FileEntry(vecFile, 128 * 1024 + 8) > 2);
+    REQUIRE(objDisk.Open(strPath, true, strError));
+    CHECK(MatchesModel(objDisk, vecModel));
+    CHECK(!objDisk.Write(0, vecModel.data(), 512, strError));   // 只读
+}
+
+TEST_CASE(DynamicDiskAllocatesBlocksAtEndOfFile) {
+    TestHarness::TempDir objDir;
+    TestHarness::Random objRandom(180);
+    const uint64_t ui64DiskSize = 16 * MB;
+    const uint32_t ui32BlockSize = 2 * MB;
+    std::vector<uint8_t> vecModel(ui64DiskSize, 0);
+    objRandom.Fill(vecModel.data() + ui32BlockSize, ui32BlockSize);
+    VhdxImageBuilder objBuilder(ui64DiskSize, ui32BlockSize, false);
+    objBuilder.SetBlock(1, std::vector<uint8_t>(vecModel.begin() + ui32BlockSize, vecModel.begin() + 2 * ui32BlockSize));
+    objBuilder.SetBlockState(3, VhdxImageBuilder::PAYLOAD_BLOCK_ZERO);
+    objBuilder.SetBlockState(4, VhdxImageBuilder::PAYLOAD_BLOCK_UNMAPPED);
+    std::string strPath = objDir.File("dynamic.vhdx");
+    REQUIRE(objBuilder.Save(strPath));
+    const VhdxLayout stcLayout = objBuilder.Layout();
+
+    // 1. 未分配、零块和未映射的块读出为0，已分配的块读出内容
+    VhdxFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strPath, false, strError));
+    CHECK(MatchesModel(objDisk, vecModel));
+
+    // 2. 写入未分配的块：在文件末尾分配新块，块中其余部分为0
+    auto Write = [&](uint64_t ui64Offset, size_t nBytes) {
+        objRandom.Fill(vecModel.data() + ui64Offset, nBytes);
+        REQUIRE(objDisk.Write(ui64Offset, vecModel.data() + ui64Offset, nBytes, strError));
+    };
+    Write(5 * ui32BlockSize + 12345, 4096);
+    Write(7 * ui32BlockSize - 1000, 3000);          // 跨块6、7
+    Write(3 * ui32BlockSize + 512, 512);            // 零块
+    Write(ui32BlockSize + 100, 100000);             // 已分配的块原地写入
+    CHECK(MatchesModel(objDisk, vecModel));
+    objDisk.Close();
+
+    // 3. 新块按写入顺序从原文件末尾开始（1MB对齐）排列，BAT项为完全存在
+    std::vector<uint8_t> vecFile = ReadWholeFile(strPath);
+    const uint64_t ui64End = stcLayout.ui64FileSize;
+    const uint64_t ui64Expected[][2] = { { 5, ui64End }, { 6, ui64End + ui32BlockSize },
+                                         { 7, ui64End + 2 * ui32BlockSize }, { 3, ui64End + 3 * ui32BlockSize },
+                                         { 1, stcLayout.mapBlockOffsets.at(1) } };
+    for (const auto& ui64Pair : ui64Expected) {
+        CHECK_EQ(FileEntry(vecFile, stcLayout.ui64BatOffset + 8 * stcLayout.BatIndex(ui64Pair[0])),
+                 ui64Pair[1] | VhdxImageBuilder::PAYLOAD_BLOCK_FULLY_PRESENT);
+    }
+    CHECK_EQ(static_cast<uint64_t>(vecFile.size()), ui64End + 4 * ui32BlockSize);
+    CHECK_EQ(FileEntry(vecFile, stcLayout.ui64BatOffset + 8 * stcLayout.BatIndex(4)), VhdxImageBuilder::PAYLOAD_BLOCK_UNMAPPED);
+    CHECK_EQ(FileEntry(vecFile, stcLayout.ui64BatOffset + 8 * stcLayout.BatIndex(2)), VhdxImageBuilder::PAYLOAD_BLOCK_NOT_PRESENT);
+
+    REQUIRE(objDisk.Open(strPath, true, strError));
+    CHECK(MatchesModel(objDisk, vecModel));
+}
+
+TEST_CASE(BatSkipsSectorBitmapEntries) {
+    // 256MB的块、512字节扇区：每16个数据块的BAT项之后有一个扇区位图项
+    TestHarness::TempDir objDir;
+    const uint32_t ui32BlockSize = 256 * MB;
+    VhdxImageBuilder objBuilder(24ULL * ui32BlockSize, ui32BlockSize, false);
+    std::string strPath = objDir.File("large-blocks.vhdx");
+    REQUIRE(objBuilder.Save(strPath));
+    const VhdxLayout stcLayout = objBuilder.Layout();
+    CHECK_EQ(stcLayout.ui64ChunkRatio, static_cast<uint64_t>(16));
+
+    VhdxFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strPath, false, strError));
+    std::vector<uint8_t> vecSector(512, 0x5A), vecRead(512);
+    REQUIRE(objDisk.Write(17ULL * ui32BlockSize, vecSector.data(), vecSector.size(), strError));
+    REQUIRE(objDisk.Write(15ULL * ui32BlockSize + ui32BlockSize - 512, vecSector.data(), vecSector.size(), strError));
+    objDisk.Close();
+
+    std::vector<uint8_t> vecBat(static_cast<size_t>(26 * 8));
+    std::ifstream objFile(strPath, std::ios::binary);
+    objFile.seekg(static_cast<std::streamoff>(stcLayout.ui64BatOffset));
+    objFile.read(reinterpret_cast<char*>(vecBat.data()), static_cast<std::streamsize>(vecBat.size()));
+    CHECK_EQ(FileEntry(vecBat, 8 * 15) & 7, VhdxImageBuilder::PAYLOAD_BLOCK_FULLY_PRESENT);
+    CHECK_EQ(FileEntry(vecBat, 8 * 16), static_cast<uint64_t>(0));     // 扇区位图项不变
+    CHECK_EQ(FileEntry(vecBat, 8 * 18) & 7, VhdxImageBuilder::PAYLOAD_BLOCK_FULLY_PRESENT);
+    CHECK_EQ(FileEntry(vecBat, 8 * 17), static_cast<uint64_t>(0));     // 块16未分配
+
+    REQUIRE(objDisk.Open(strPath, true, strError));
+    REQUIRE(objDisk.Read(17ULL * ui32BlockSize, vecRead.data(), vecRead.size(), strError));
+    CHECK(vecRead == vecSector);
+    REQUIRE(objDisk.Read(16ULL * ui32BlockSize, vecRead.data(), vecRead.size(), strError));
+    CHECK(vecRead == std::vector<uint8_t>(512, 0));
+}
+
+/********************************************************************************
+* 函数名称：生成带日志的动态磁盘
+* 函数功能：块0、1已分配；日志把块0中的一个4KB扇区改为新数据、把块1开头
+*           8KB清零，并通过修改BAT扇区在文件末尾之后分配块2
+* 函数参数：
+*    [IN]  const std::string& strPath：文件路径
+*    [OUT] std::vector<uint8_t>& vecModel：回放后虚拟磁盘的内容
+*    [OUT] uint64_t& ui64ReplayedSize：回放后的文件大小
+*********************************************************************************/
+static void MakeLoggedDisk(const std::string& strPath, std::vector<uint8_t>& vecModel, uint64_t& ui64ReplayedSize) {
+    TestHarness::Random objRandom(1800);
+    vecModel.assign(8 * MB, 0);
+    objRandom.Fill(vecModel.data(), 2 * MB);
+    VhdxImageBuilder objBuilder(8 * MB, MB, false);
+    objBuilder.SetBlock(0, std::vector<uint8_t>(vecModel.begin(), vecModel.begin() + MB));
+    objBuilder.SetBlock(1, std::vector<uint8_t>(vecModel.begin() + MB, vecModel.begin() + 2 * MB));
+    std::vector<uint8_t> vecFile = objBuilder.Build();
+    const VhdxLayout stcLayout = objBuilder.Layout();
+
+    VhdxImageBuilder::LogEntry& stcEntry = objBuilder.AddLogEntry(42);
+    std::vector<uint8_t> vecSector = RandomBytes(objRandom, 4096);
+    stcEntry.vecData.emplace_back(stcLayout.mapBlockOffsets.at(0) + 8192, vecSector);
+    memcpy(vecModel.data() + 8192, vecSector.data(), 4096);
+    stcEntry.vecZero.emplace_back(stcLayout.mapBlockOffsets.at(1), 8192);
+    memset(vecModel.data() + MB, 0, 8192);
+
+    const uint64_t ui64NewBlock = stcLayout.ui64FileSize;
+    std::vector<uint8_t> vecBatSector(vecFile.begin() + stcLayout.ui64BatOffset,
+                                      vecFile.begin() + stcLayout.ui64BatOffset + 4096);
+    uint64_t ui64Entry = ui64NewBlock | VhdxImageBuilder::PAYLOAD_BLOCK_FULLY_PRESENT;
+    memcpy(vecBatSector.data() + 8 * stcLayout.BatIndex(2), &ui64Entry, 8);
+    stcEntry.vecData.emplace_back(stcLayout.ui64BatOffset, vecBatSector);
+    vecSector = RandomBytes(objRandom, 4096);
+    stcEntry.vecData.emplace_back(ui64NewBlock + 4096, vecSector);
+    memcpy(vecModel.data() + 2 * MB + 4096, vecSector.data(), 4096);
+    stcEntry.ui64LastFileOffset = ui64NewBlock + MB;
+    ui64ReplayedSize = ui64NewBlock + MB;
+    REQUIRE(objBuilder.Save(strPath));
+}
+
+TEST_CASE(LogIsReplayedInMemoryWhenReadOnly) {
+    TestHarness::TempDir objDir;
+    std::string strPath = objDir.File("logged.vhdx");
+    std::vector<uint8_t> vecModel;
+    uint64_t ui64ReplayedSize = 0;
+    MakeLoggedDisk(strPath, vecModel, ui64ReplayedSize);
+    std::vector<uint8_t> vecBefore = ReadWholeFile(strPath);
+
+    VhdxFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strPath, true, strError));
+    CHECK(objDisk.LogReplayed());
+    CHECK(MatchesModel(objDisk, vecModel));
+    objDisk.Close();
+    CHECK(ReadWholeFile(strPath) == vecBefore);     // 文件没有被修改
+}
+
+TEST_CASE(LogIsWrittenBackWhenReadWrite) {
+    TestHarness::TempDir objDir;
+    std::string strPath = objDir.File("logged.vhdx");
+    std::vector<uint8_t> vecModel;
+    uint64_t ui64ReplayedSize = 0;
+    MakeLoggedDisk(strPath, vecModel, ui64ReplayedSize);
+
+    VhdxFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strPath, false, strError));
+    CHECK(objDisk.LogReplayed());
+    CHECK(MatchesModel(objDisk, vecModel));
+    objDisk.Close();
+
+    // 回放结果写回文件并清除LogGuid：再次打开不需要回放
+    CHECK_EQ(static_cast<uint64_t>(ReadWholeFile(strPath).size()), ui64ReplayedSize);
+    REQUIRE(objDisk.Open(strPath, true, strError));
+    CHECK(!objDisk.LogReplayed());
+    CHECK(MatchesModel(objDisk, vecModel));
+}
+
+TEST_CASE(LogReplayUsesLatestCompleteSequence) {
+    TestHarness::TempDir objDir;
+    TestHarness::Random objRandom(18000);
+    VhdxImageBuilder objBuilder(4 * MB, MB, false);
+    objBuilder.SetBlock(0, std::vector<uint8_t>(MB, 0x11));
+    objBuilder.Build();
+    const uint64_t ui64Target = objBuilder.Layout().mapBlockOffsets.at(0) + 4096;
+
+    // 序号7、8连续且8的Tail指向7；序号9的校验和错误（写了一半），不参与回放
+    std::vector<uint8_t> vecFirst = RandomBytes(objRandom, 4096);
+    std::vector<uint8_t> vecSecond = RandomBytes(objRandom, 4096);
+    std::vector<uint8_t> vecTorn = RandomBytes(objRandom, 4096);
+    objBuilder.AddLogEntry(7).vecData.emplace_back(ui64Target, vecFirst);
+    objBuilder.AddLogEntry(8).vecData.emplace_back(ui64Target, vecSecond);
+    VhdxImageBuilder::LogEntry& stcTorn = objBuilder.AddLogEntry(9);
+    stcTorn.vecData.emplace_back(ui64Target, vecTorn);
+    stcTorn.bCorruptChecksum = true;
+    std::string strPath = objDir.File("sequence.vhdx");
+    REQUIRE(objBuilder.Save(strPath));
+
+    VhdxFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strPath, true, strError));
+    std::vector<uint8_t> vecRead(4096);
+    REQUIRE(objDisk.Read(4096, vecRead.data(), vecRead.size(), strError));
+    CHECK(vecRead == vecSecond);
+    REQUIRE(objDisk.Read(0, vecRead.data(), vecRead.size(), strError));
+    CHECK(vecRead == std::vector<uint8_t>(4096, 0x11));
+}
+
+TEST_CASE(LogRequiringLongerFileIsRejected) {
+    // 日志写入时文件至少有FlushedFileOffset字节，文件更短说明被截断，不能回放
+    TestHarness::TempDir objDir;
+    VhdxImageBuilder objBuilder(4 * MB, MB, false);
+    objBuilder.SetBlock(0, std::vector<uint8_t>(MB, 0x22));
+    objBuilder.Build();
+    VhdxImageBuilder::LogEntry& stcEntry = objBuilder.AddLogEntry(3);
+    stcEntry.vecData.emplace_back(objBuilder.Layout().mapBlockOffsets.at(0), std::vector<uint8_t>(4096, 0x33));
+    stcEntry.ui64FlushedFileOffset = objBuilder.Layout().ui64FileSize + 4 * MB;
+    std::string strPath = objDir.File("truncated.vhdx");
+    REQUIRE(objBuilder.Save(strPath));
+
+    VhdxFile objDisk;
+    std::string strError;
+    CHECK(!objDisk.Open(strPath, true, strError));
+    CHECK(strError.find("截断") != std::string::npos);
+}
+
+/********************************************************************************
+* 函数名称：在模型和生成器中设置差异磁盘的一个块
+* 说明：vecPresent为空时整块存在，否则只有置位的扇区属于这一层
+*********************************************************************************/
+static void LayerBlock(VhdxImageBuilder& objBuilder, std::vector<uint8_t>& vecModel, uint64_t ui64Block,
+                       TestHarness::Random& objRandom, bool bPartial) {
+    std::vector<uint8_t> vecData = RandomBytes(objRandom, MB);
+    std::vector<bool> vecPresent(MB / 512, !bPartial);
+    for (size_t i = 0; bPartial && i < vecPresent.size(); i++) {
+        vecPresent[i] = (i / 7 + objRandom.Below(3)) % 2 == 0;      // 连续的段和零散的扇区都有
+    }
+    for (size_t i = 0; i < vecPresent.size(); i++) {
+        if (vecPresent[i]) {
+            memcpy(vecModel.data() + ui64Block * MB + i * 512, vecData.data() + i * 512, 512);
+        }
+    }
+    if (bPartial) {
+        objBuilder.SetPartialBlock(ui64Block, vecData, vecPresent);
+    } else {
+        objBuilder.SetBlock(ui64Block, vecData);
+    }
+}
+
+TEST_CASE(DifferencingChainReadsThroughParentsAndWritesOnlyLeaf) {
+    // 三层：base.vhdx（2MB块）← mid.avhdx（1MB块）← snap/leaf.avhdx（1MB块，相对路径指向上一级目录）
+    TestHarness::TempDir objDir;
+    std::filesystem::create_directory(objDir.Path() / "snap");
+    TestHarness::Random objRandom(22);
+    const uint64_t ui64DiskSize = 16 * MB;
+    std::vector<uint8_t> vecModel(ui64DiskSize, 0);
+
+    VhdxImageBuilder objBase(ui64DiskSize, 2 * MB, false);
+    for (uint64_t ui64Block : { 0, 1, 2, 4, 6, 7 }) {
+        std::vector<uint8_t> vecData = RandomBytes(objRandom, 2 * MB);
+        memcpy(vecModel.data() + ui64Block * 2 * MB, vecData.data(), vecData.size());
+        objBase.SetBlock(ui64Block, vecData);
+    }
+    objBase.SetBlockState(3, VhdxImageBuilder::PAYLOAD_BLOCK_ZERO);
+    REQUIRE(objBase.Save(objDir.File("base.vhdx")));
+
+    VhdxImageBuilder objMid(ui64DiskSize, MB, false);
+    objMid.SetParent(objBase.DataWriteGuid().ToString(), ".\\base.vhdx");
+    for (uint64_t ui64Block : { 2, 9 }) LayerBlock(objMid, vecModel, ui64Block, objRandom, false);
+    for (uint64_t ui64Block : { 0, 4, 10, 15 }) LayerBlock(objMid, vecModel, ui64Block, objRandom, true);
+    REQUIRE(objMid.Save(objDir.File("mid.avhdx")));
+
+    VhdxImageBuilder objLeaf(ui64DiskSize, MB, false);
+    objLeaf.SetParent(objMid.DataWriteGuid().ToString(), "..\\mid.avhdx");
+    LayerBlock(objLeaf, vecModel, 1, objRandom, false);
+    for (uint64_t ui64Block : { 0, 4, 12 }) LayerBlock(objLeaf, vecModel, ui64Block, objRandom, true);
+    const std::string strLeaf = (objDir.Path() / "snap" / "leaf.avhdx").string();
+    REQUIRE(objLeaf.Save(strLeaf));
+    const VhdxLayout stcLayout = objLeaf.Layout();
+    REQUIRE(stcLayout.mapBitmapOffsets.size() == 1);
+    const std::vector<uint8_t> vecBaseFile = ReadWholeFile(objDir.File("base.vhdx"));
+    const std::vector<uint8_t> vecMidFile = ReadWholeFile(objDir.File("mid.avhdx"));
+
+    // 1. 整体和随机读取：部分存在的块逐扇区落到下层，链上块大小不同
+    VhdxFile objDisk;
+    std::string strError;
+    REQUIRE(objDisk.Open(strLeaf, false, strError));
+    CHECK(objDisk.HasParent());
+    CHECK_EQ(objDisk.ParentCount(), size_t(2));
+    CHECK(MatchesModel(objDisk, vecModel));
+    std::vector<uint8_t> vecBuffer(3 * MB);
+    bool bRandomMatches = true;
+    for (int i = 0; i < 300; i++) {
+        size_t nBytes = 1 + static_cast<size_t>(objRandom.Below(i % 5 == 0 ? 3 * MB : 20000));
+        uint64_t ui64Offset = objRandom.Below(ui64DiskSize - nBytes + 1);
+        bRandomMatches = bRandomMatches && objDisk.Read(ui64Offset, vecBuffer.data(), nBytes, strError) &&
+                         memcmp(vecBuffer.data(), vecModel.data() + ui64Offset, nBytes) == 0;
+    }
+    CHECK(bRandomMatches);
+
+    // 2. 写入最上层：部分存在的块原地合并为完全存在，未分配的块经过整条链读出后在文件末尾分配
+    auto Write = [&](uint64_t ui64Offset, size_t nBytes) {
+        objRandom.Fill(vecModel.data() + ui64Offset, nBytes);
+        REQUIRE(objDisk.Write(ui64Offset, vecModel.data() + ui64Offset, nBytes, strError));
+    };
+    Write(4 * MB + 1000, 5000);
+    Write(10 * MB + 300000, 700);                   // 最上层未分配，中间层部分存在
+    Write(7 * MB - 100, 200);                       // 跨块6、7，只有底层有数据
+    CHECK(MatchesModel(objDisk, vecModel));
+    objDisk.Close();
+
+    std::vector<uint8_t> vecFile = ReadWholeFile(strLeaf);
+    CHECK_EQ(FileEntry(vecFile, stcLayout.ui64BatOffset + 8 * stcLayout.BatIndex(4)),
+             stcLayout.mapBlockOffsets.at(4) | VhdxImageBuilder::PAYLOAD_BLOCK_FULLY_PRESENT);
+    for (uint64_t ui64Block : { 6, 7, 10 }) {
+        uint64_t ui64Entry = FileEntry(vecFile, stcLayout.ui64BatOffset + 8 * stcLayout.BatIndex(ui64Block));
+        CHECK_EQ(ui64Entry & 7, VhdxImageBuilder::PAYLOAD_BLOCK_FULLY_PRESENT);
+        CHECK((ui64Entry & ~0xFFFFFULL) >= stcLayout.ui64FileSize);
+    }
+    CHECK_EQ(FileEntry(vecFile, stcLayout.ui64BatOffset + 8 * stcLayout.BatIndex(12)) & 7,
+             VhdxImageBuilder::PAYLOAD_BLOCK_PARTIALLY_PRESENT);
+    CHECK(ReadWholeFile(objDir.File("base.vhdx")) == vecBaseFile);      // 父磁盘不被修改
+    CHECK(ReadWholeFile(objDir.File("mid.avhdx")) == vecMidFile);
+    REQUIRE(objDisk.Open(strLeaf, true, strError));
+    CHECK(MatchesModel(objDisk, vecModel));
+    objDisk.Close();
+
+    // 3. parent_linkage与父磁盘的DataWriteGuid不一致：父磁盘在创建差异磁盘后被修改过
+    VhdxImageBuilder objStale(ui64DiskSize, MB, false);
+    objStale.SetParent(DiskGuid::Random().ToString(), "base.vhdx");
+    REQUIRE(objStale.Save(objDir.File("stale.avhdx")));
+    CHECK(!objDisk.Open(objDir.File("stale.avhdx"), true, strError));
+    CHECK(strError.find("parent_linkage") != std::string::npos);
+
+    // 4. 父磁盘不存在
+    std::filesystem::remove(objDir.File("base.vhdx"));
+    CHECK(!objDisk.Open(strLeaf, true, strError));
+    CHECK(strError.find("找不到") != std::string::npos);
+    CHECK(strError.find("mid.avhdx") != std::string::npos);
+}
@@ -0,0 +1,356 @@
+﻿/********************************************************************************
+* 文件名称：VhdxImageBuilder.h
+* 文件功能：测试用的VHDX文件生成器，按规范从零写出固定、动态和带日志的镜像
+*
+* 类说明：
+*    测试不依赖Hyper-V或qemu-img，直接在内存中按VHDX规范排布文件：
+*    - 0：文件标识；64KB/128KB：两份头部；192KB/256KB：两份区域表
+*    - 1MB：日志区域（1MB）；2MB：元数据区域（1MB）；3MB起：BAT区域
+*    - BAT之后按块号顺序放置已分配的数据块（1MB对齐）
+*    固定磁盘的每个块都完全存在；动态磁盘只分配SetBlock设置过的块，
+*    SetBlockState可以把块设置为零块、未映射等状态。AddLogEntry生成
+*    日志项（数据扇区和清零描述符），用于验证打开时的日志回放；日志项
+*    中的偏移是文件偏移，测试通过Layout()取得各结构的位置。
+*    SetParent生成差异磁盘：文件参数带HasParent标志，元数据中有父磁盘
+*    定位器，BAT按chunk数 ×（ChunkRatio + 1）排布；SetPartialBlock写入
+*    部分存在的块，所在chunk的扇区位图块放在数据块之后。
+*
+* 作者：Smart-GPU-PV Team
+* 日期：2026-10-16
+* 版本：v2.1
+*********************************************************************************/
+
+#pragma once
+#include "../Smart-GPU-PV/BlockDevice.h"
+#include "../Smart-GPU-PV/ContentHash.h"
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/********************************************************************************
+* 结构体名称：生成的VHDX文件布局
+*********************************************************************************/
+struct VhdxLayout {
+    uint64_t                     ui64LogOffset = 0;         // 日志区域偏移
+    uint64_t                     ui64MetadataOffset = 0;    // 元数据区域偏移
+    uint64_t                     ui64BatOffset = 0;         // BAT区域偏移
+    uint64_t                     ui64ChunkRatio = 0;        // 每个扇区位图项对应的数据块数
+    uint64_t                     ui64FileSize = 0;          // 文件大小
+    std::map<uint64_t, uint64_t> mapBlockOffsets;           // 块号 -> 数据块的文件偏移
+    std::map<uint64_t, uint64_t> mapBitmapOffsets;          // chunk号 -> 扇区位图块的文件偏移（差异磁盘）
+
+    // 块号对应的BAT项序号（每ChunkRatio个数据块之后有一个扇区位图项）
+    uint64_t BatIndex(uint64_t ui64Block) const { return ui64Block + ui64Block / ui64ChunkRatio; }
+};
+
+/********************************************************************************
+* 类名称：VHDX文件生成器
+*
+* 调用示例：
+*    VhdxImageBuilder objBuilder(64 * 1024 * 1024, 1024 * 1024, false);
+*    objBuilder.SetBlock(3, vecData);
+*    objBuilder.Save(objDir.File("dynamic.vhdx"));
+*********************************************************************************/
+class VhdxImageBuilder {
+public:
+    // BAT项状态（VHDX规范2.5.1节）
+    static constexpr uint64_t PAYLOAD_BLOCK_NOT_PRESENT = 0;
+    static constexpr uint64_t PAYLOAD_BLOCK_ZERO = 2;
+    static constexpr uint64_t PAYLOAD_BLOCK_UNMAPPED = 3;
+    static constexpr uint64_t PAYLOAD_BLOCK_FULLY_PRESENT = 6;
+    static constexpr uint64_t PAYLOAD_BLOCK_PARTIALLY_PRESENT = 7;
+    static constexpr uint64_t SB_BLOCK_PRESENT = 6;
+    static constexpr uint64_t ONE_MB = 1024 * 1024;
+    static constexpr size_t LOG_SECTOR_SIZE = 4096;
+
+    /********************************************************************************
+    * 结构体名称：日志项
+    *********************************************************************************/
+    struct LogEntry {
+        uint64_t ui64Sequence = 0;                                      // 序号
+        int64_t  i64Tail = -1;                                          // 序列开头的日志项序号（-1表示第一个日志项）
+        std::vector<std::pair<uint64_t, std::vector<uint8_t>>> vecData; // 文件偏移 -> 4KB数据
+        std::vector<std::pair<uint64_t, uint64_t>> vecZero;             // 文件偏移 -> 清零长度
+        uint64_t ui64FlushedFileOffset = 0;                             // 0表示生成的文件大小
+        uint64_t ui64LastFileOffset = 0;                                // 0表示生成的文件大小
+        bool     bCorruptChecksum = false;                              // 写入错误的校验和（写了一半的日志项）
+    };
+
+    /********************************************************************************
+    * 函数名称：构造函数
+    * 函数参数：
+    *    [IN]  uint64_t ui64DiskSize：虚拟磁盘大小
+    *    [IN]  uint32_t ui32BlockSize：块大小（1MB~256MB，2的幂）
+    *    [IN]  bool bFixed：固定磁盘（所有块完全存在）
+    *    [IN]  uint32_t ui32SectorSize：逻辑扇区大小
+    *********************************************************************************/
+    VhdxImageBuilder(uint64_t ui64DiskSize, uint32_t ui32BlockSize, bool bFixed, uint32_t ui32SectorSize = 512)
+        : m_ui64DiskSize(ui64DiskSize), m_ui32BlockSize(ui32BlockSize), m_ui32SectorSize(ui32SectorSize),
+          m_bFixed(bFixed), m_objDataWrite(DiskGuid::Random()) {
+        m_stcLayout.ui64ChunkRatio = (static_cast<uint64_t>(1) << 23) * ui32SectorSize / ui32BlockSize;
+    }
+
+    // 设置块的内容（不足一块时其余为0）；动态磁盘中该块变为完全存在
+    void SetBlock(uint64_t ui64Block, const std::vector<uint8_t>& vecData) {
+        m_mapBlocks[ui64Block] = vecData;
+        m_mapBlocks[ui64Block].resize(m_ui32BlockSize, 0);
+        m_mapStates[ui64Block] = PAYLOAD_BLOCK_FULLY_PRESENT;
+    }
+
+    // 设置未分配块的BAT状态（零块、未映射等）
+    void SetBlockState(uint64_t ui64Block, uint64_t ui64State) { m_mapStates[ui64Block] = ui64State; }
+
+    // 设置部分存在的块（差异磁盘）：vecPresent[i]为真的扇区在本层，其余扇区由父磁盘提供
+    void SetPartialBlock(uint64_t ui64Block, const std::vector<uint8_t>& vecData, const std::vector<bool>& vecPresent) {
+        SetBlock(ui64Block, vecData);
+        m_mapStates[ui64Block] = PAYLOAD_BLOCK_PARTIALLY_PRESENT;
+        m_mapPresent[ui64Block] = vecPresent;
+        m_mapPresent[ui64Block].resize(m_ui32BlockSize / m_ui32SectorSize, false);
+    }
+
+    // 设为差异磁盘：strLinkage为父磁盘的DataWriteGuid文本，strRelativePath相对于本文件所在目录
+    void SetParent(const std::string& strLinkage, const std::string& strRelativePath) {
+        m_bHasParent = true;
+        m_vecLocator = { { "parent_linkage", strLinkage }, { "relative_path", strRelativePath } };
+    }
+
+    // 添加日志项（按添加顺序依次放在日志区域中），头部的LogGuid随之非零
+    LogEntry& AddLogEntry(uint64_t ui64Sequence) {
+        m_vecLog.emplace_back();
+        m_vecLog.back().ui64Sequence = ui64Sequence;
+        return m_vecLog.back();
+    }
+
+    const DiskGuid& DataWriteGuid() const { return m_objDataWrite; }
+    const VhdxLayout& Layout() const { return m_stcLayout; }
+
+    /********************************************************************************
+    * 函数名称：生成文件内容
+    * 返回类型：std::vector<uint8_t>
+    *********************************************************************************/
+    std::vector<uint8_t> Build() {
+        // 1. 布局：日志、元数据、BAT各占整MB，数据块依次排在后面
+        const uint64_t ui64DataBlocks = (m_ui64DiskSize + m_ui32BlockSize - 1) / m_ui32BlockSize;
+        const uint64_t ui64Chunks = (ui64DataBlocks + m_stcLayout.ui64ChunkRatio - 1) / m_stcLayout.ui64ChunkRatio;
+        const uint64_t ui64BatEntries = m_bHasParent ? ui64Chunks * (m_stcLayout.ui64ChunkRatio + 1)
+                                                     : ui64DataBlocks + (ui64DataBlocks - 1) / m_stcLayout.ui64ChunkRatio;
+        m_stcLayout.ui64LogOffset = ONE_MB;
+        m_stcLayout.ui64MetadataOffset = 2 * ONE_MB;
+        m_stcLayout.ui64BatOffset = 3 * ONE_MB;
+        uint64_t ui64BatLength = (ui64BatEntries * 8 + ONE_MB - 1) / ONE_MB * ONE_MB;
+        uint64_t ui64Next = m_stcLayout.ui64BatOffset + ui64BatLength;
+        m_stcLayout.mapBlockOffsets.clear();
+        for (uint64_t ui64Block = 0; ui64Block < ui64DataBlocks; ui64Block++) {
+            if (m_bFixed || m_mapBlocks.count(ui64Block)) {
+                m_stcLayout.mapBlockOffsets[ui64Block] = ui64Next;
+                ui64Next += (m_ui32BlockSize + ONE_MB - 1) / ONE_MB * ONE_MB;
+            }
+        }
+        m_stcLayout.mapBitmapOffsets.clear();
+        for (const auto& [ui64Block, vecPresent] : m_mapPresent) {
+            uint64_t ui64Chunk = ui64Block / m_stcLayout.ui64ChunkRatio;
+            if (!m_stcLayout.mapBitmapOffsets.count(ui64Chunk)) {
+                m_stcLayout.mapBitmapOffsets[ui64Chunk] = ui64Next;
+                ui64Next += ONE_MB;
+            }
+        }
+        m_stcLayout.ui64FileSize = ui64Next;
+        std::vector<uint8_t> vecFile(static_cast<size_t>(ui64Next), 0);
+        uint8_t* pFile = vecFile.data();
+
+        // 2. 文件标识、头部、区域表
+        memcpy(pFile, "vhdxfile", 8);
+        DiskGuid objLog = m_vecLog.empty() ? DiskGuid() : DiskGuid::Random();
+        for (int i = 0; i < 2; i++) {
+            uint8_t* p = pFile + (i + 1) * 64 * 1024;
+            memcpy(p, "head", 4);
+            Put64(p + 8, 1 + i);
+            DiskGuid objFileWrite = DiskGuid::Random();
+            memcpy(p + 16, objFileWrite.ui8Bytes, 16);
+            memcpy(p + 32, m_objDataWrite.ui8Bytes, 16);
+            memcpy(p + 48, objLog.ui8Bytes, 16);
+            Put16(p + 66, 1);
+            Put32(p + 68, static_cast<uint32_t>(ONE_MB));
+            Put64(p + 72, m_stcLayout.ui64LogOffset);
+            Put32(p + 4, Crc32::Castagnoli(p, 4096));
+        }
+        for (int i = 0; i < 2; i++) {
+            uint8_t* p = pFile + (i + 3) * 64 * 1024;
+            memcpy(p, "regi", 4);
+            Put32(p + 8, 2);
+            PutGuid(p + 16, 0x2DC27766, 0xF623, 0x4200, 0x9D64115E9BFD4A08ULL);    // BAT
+            Put64(p + 32, m_stcLayout.ui64BatOffset);
+            Put32(p + 40, static_cast<uint32_t>(ui64BatLength));
+            Put32(p + 44, 1);
+            PutGuid(p + 48, 0x8B7CA206, 0x4790, 0x4B9A, 0xB8FE575F050F886EULL);    // 元数据
+            Put64(p + 64, m_stcLayout.ui64MetadataOffset);
+            Put32(p + 72, static_cast<uint32_t>(ONE_MB));
+            Put32(p + 76, 1);
+            Put32(p + 4, Crc32::Castagnoli(p, 64 * 1024));
+        }
+
+        // 3. 元数据表和元数据项（项的内容从64KB开始）
+        uint8_t* pMeta = pFile + m_stcLayout.ui64MetadataOffset;
+        memcpy(pMeta, "metadata", 8);
+        uint32_t ui32ItemOffset = 64 * 1024;
+        uint16_t ui16Entries = 0;
+        auto AddItem = [&](uint32_t d1, uint16_t d2, uint16_t d3, uint64_t d4, const void* pData, uint32_t ui32Length,
+                           uint32_t ui32Flags) {
+            uint8_t* pEntry = pMeta + 32 + 32 * ui16Entries++;
+            PutGuid(pEntry, d1, d2, d3, d4);
+            Put32(pEntry + 16, ui32ItemOffset);
+            Put32(pEntry + 20, ui32Length);
+            Put32(pEntry + 24, ui32Flags);
+            memcpy(pMeta + ui32ItemOffset, pData, ui32Length);
+            ui32ItemOffset += (ui32Length + 7) / 8 * 8;
+        };
+        uint32_t ui32FileParameters[2] = { m_ui32BlockSize, (m_bFixed ? 1u : 0u) | (m_bHasParent ? 2u : 0u) };
+        DiskGuid objDiskId = DiskGuid::Random();
+        AddItem(0xCAA16737, 0xFA36, 0x4D43, 0xB3B633F0AA44E76BULL, ui32FileParameters, 8, 4);
+        AddItem(0x2FA54224, 0xCD1B, 0x4876, 0xB2115DBED83BF4B8ULL, &m_ui64DiskSize, 8, 2 | 4);
+        AddItem(0xBECA12AB, 0xB2E6, 0x4523, 0x93EFC309E000C746ULL, objDiskId.ui8Bytes, 16, 2 | 4);
+        AddItem(0x8141BF1D, 0xA96F, 0x4709, 0xBA47F233A8FAAB5FULL, &m_ui32SectorSize, 4, 2 | 4);
+        uint32_t ui32Physical = 4096;
+        AddItem(0xCDA348C7, 0x445D, 0x4471, 0x9CC9E9885251C556ULL, &ui32Physical, 4, 2 | 4);
+        if (m_bHasParent) {
+            // 父磁盘定位器：类型GUID、保留、键值对数量、键值对表（偏移相对于本项开头），之后是UTF-16LE字符串
+            std::vector<uint8_t> vecItem(20 + 12 * m_vecLocator.size());
+            PutGuid(vecItem.data(), 0xB04AEFB7, 0xD19E, 0x4A81, 0xB78925B8E9445913ULL);
+            Put16(&vecItem[18], static_cast<uint16_t>(m_vecLocator.size()));
+            for (size_t i = 0; i < m_vecLocator.size(); i++) {
+                const std::string* pStrings[2] = { &m_vecLocator[i].first, &m_vecLocator[i].second };
+                for (int j = 0; j < 2; j++) {
+                    // 键值对：键偏移、值偏移（各4字节），键长度、值长度（各2字节）
+                    Put32(&vecItem[20 + 12 * i + 4 * j], static_cast<uint32_t>(vecItem.size()));
+                    Put16(&vecItem[20 + 12 * i + 8 + 2 * j], static_cast<uint16_t>(pStrings[j]->size() * 2));
+                    for (char ch : *pStrings[j]) {
+                        vecItem.push_back(static_cast<uint8_t>(ch));
+                        vecItem.push_back(0);
+                    }
+                }
+            }
+            AddItem(0xA8D35F2D, 0xB30B, 0x454D, 0xABF7D3D84834AB0CULL, vecItem.data(), static_cast<uint32_t>(vecItem.size()), 4);
+        }
+        Put16(pMeta + 10, ui16Entries);
+
+        // 4. BAT和数据块
+        for (uint64_t ui64Block = 0; ui64Block < ui64DataBlocks; ui64Block++) {
+            uint64_t ui64Entry = PAYLOAD_BLOCK_NOT_PRESENT;
+            auto itOffset = m_stcLayout.mapBlockOffsets.find(ui64Block);
+            if (itOffset != m_stcLayout.mapBlockOffsets.end()) {
+                ui64Entry = itOffset->second | (m_mapPresent.count(ui64Block) ? PAYLOAD_BLOCK_PARTIALLY_PRESENT
+                                                                              : PAYLOAD_BLOCK_FULLY_PRESENT);
+                auto itData = m_mapBlocks.find(ui64Block);
+                if (itData != m_mapBlocks.end()) {
+                    memcpy(pFile + itOffset->second, itData->second.data(), m_ui32BlockSize);
+                }
+            } else if (m_mapStates.count(ui64Block)) {
+                ui64Entry = m_mapStates[ui64Block];
+            }
+            Put64(pFile + m_stcLayout.ui64BatOffset + 8 * m_stcLayout.BatIndex(ui64Block), ui64Entry);
+        }
+
+        // 扇区位图块：每位对应chunk中的一个逻辑扇区（低位在前），BAT项在每个chunk的数据块之后
+        const uint64_t ui64SectorsPerBlock = m_ui32BlockSize / m_ui32SectorSize;
+        for (const auto& [ui64Block, vecPresent] : m_mapPresent) {
+            uint64_t ui64Chunk = ui64Block / m_stcLayout.ui64ChunkRatio;
+            uint8_t* pBitmap = pFile + m_stcLayout.mapBitmapOffsets[ui64Chunk];
+            uint64_t ui64FirstSector = (ui64Block % m_stcLayout.ui64ChunkRatio) * ui64SectorsPerBlock;
+            for (uint64_t i = 0; i < ui64SectorsPerBlock; i++) {
+                if (vecPresent[static_cast<size_t>(i)]) {
+                    pBitmap[(ui64FirstSector + i) / 8] |= static_cast<uint8_t>(1 << ((ui64FirstSector + i) % 8));
+                }
+            }
+        }
+        for (const auto& [ui64Chunk, ui64Offset] : m_stcLayout.mapBitmapOffsets) {
+            Put64(pFile + m_stcLayout.ui64BatOffset + 8 * ((ui64Chunk + 1) * (m_stcLayout.ui64ChunkRatio + 1) - 1),
+                  ui64Offset | SB_BLOCK_PRESENT);
+        }
+
+        // 5. 日志项依次排列，序列的Tail默认指向第一个日志项
+        std::vector<uint64_t> vecPositions;
+        uint64_t ui64Position = 0;
+        for (const LogEntry& stcEntry : m_vecLog) {
+            vecPositions.push_back(ui64Position);
+            ui64Position += EntryLength(stcEntry);
+        }
+        for (size_t i = 0; i < m_vecLog.size(); i++) {
+            const LogEntry& stcEntry = m_vecLog[i];
+            uint8_t* p = pFile + m_stcLayout.ui64LogOffset + vecPositions[i];
+            uint32_t ui32Length = static_cast<uint32_t>(EntryLength(stcEntry));
+            uint32_t ui32Descriptors = static_cast<uint32_t>(stcEntry.vecData.size() + stcEntry.vecZero.size());
+            memcpy(p, "loge", 4);
+            Put32(p + 8, ui32Length);
+            Put32(p + 12, static_cast<uint32_t>(vecPositions[stcEntry.i64Tail < 0 ? 0 : stcEntry.i64Tail]));
+            Put64(p + 16, stcEntry.ui64Sequence);
+            Put32(p + 24, ui32Descriptors);
+            memcpy(p + 32, objLog.ui8Bytes, 16);
+            Put64(p + 48, stcEntry.ui64FlushedFileOffset ? stcEntry.ui64FlushedFileOffset : ui64Next);
+            Put64(p + 56, stcEntry.ui64LastFileOffset ? stcEntry.ui64LastFileOffset : ui64Next);
+            uint8_t* pDesc = p + 64;
+            uint8_t* pData = p + DescriptorSectors(stcEntry) * LOG_SECTOR_SIZE;
+            for (const auto& [ui64Offset, vecSector] : stcEntry.vecData) {
+                memcpy(pDesc, "desc", 4);
+                memcpy(pDesc + 4, vecSector.data() + LOG_SECTOR_SIZE - 4, 4);
+                memcpy(pDesc + 8, vecSector.data(), 8);
+                Put64(pDesc + 16, ui64Offset);
+                Put64(pDesc + 24, stcEntry.ui64Sequence);
+                memcpy(pData, "data", 4);
+                Put32(pData + 4, static_cast<uint32_t>(stcEntry.ui64Sequence >> 32));
+                memcpy(pData + 8, vecSector.data() + 8, LOG_SECTOR_SIZE - 12);
+                Put32(pData + LOG_SECTOR_SIZE - 4, static_cast<uint32_t>(stcEntry.ui64Sequence));
+                pDesc += 32;
+                pData += LOG_SECTOR_SIZE;
+            }
+            for (const auto& [ui64Offset, ui64Length] : stcEntry.vecZero) {
+                memcpy(pDesc, "zero", 4);
+                Put64(pDesc + 8, ui64Length);
+                Put64(pDesc + 16, ui64Offset);
+                Put64(pDesc + 24, stcEntry.ui64Sequence);
+                pDesc += 32;
+            }
+            Put32(p + 4, Crc32::Castagnoli(p, ui32Length) ^ (stcEntry.bCorruptChecksum ? 1u : 0u));
+        }
+        return vecFile;
+    }
+
+    /********************************************************************************
+    * 函数名称：生成并保存到文件
+    * 返回类型：bool
+    *********************************************************************************/
+    bool Save(const std::string& strPath) {
+        std::vector<uint8_t> vecFile = Build();
+        std::ofstream objFile(strPath, std::ios::binary | std::ios::trunc);
+        objFile.write(reinterpret_cast<const char*>(vecFile.data()), static_cast<std::streamsize>(vecFile.size()));
+        return static_cast<bool>(objFile);
+    }
+
+private:
+    uint64_t                                   m_ui64DiskSize;
+    uint32_t                                   m_ui32BlockSize;
+    uint32_t                                   m_ui32SectorSize;
+    bool                                       m_bFixed;
+    bool                                       m_bHasParent = false;
+    std::vector<std::pair<std::string, std::string>> m_vecLocator;   // 父磁盘定位器的键值对（ASCII）
+    std::map<uint64_t, std::vector<bool>>      m_mapPresent;    // 部分存在的块 -> 各扇区是否在本层
+    DiskGuid                                   m_objDataWrite;
+    std::map<uint64_t, std::vector<uint8_t>>   m_mapBlocks;     // 块号 -> 内容
+    std::map<uint64_t, uint64_t>               m_mapStates;     // 块号 -> BAT状态
+    std::vector<LogEntry>                      m_vecLog;        // 日志项
+    VhdxLayout                                 m_stcLayout;
+
+    static void Put16(uint8_t* p, uint16_t v) { memcpy(p, &v, sizeof(v)); }
+    static void Put32(uint8_t* p, uint32_t v) { memcpy(p, &v, sizeof(v)); }
+    static void Put64(uint8_t* p, uint64_t v) { memcpy(p, &v, sizeof(v)); }
+    static void PutGuid(uint8_t* p, uint32_t d1, uint16_t d2, uint16_t d3, uint64_t d4) {
+        memcpy(p, DiskGuid::Make(d1, d2, d3, d4).ui8Bytes, 16);
+    }
+    static uint64_t DescriptorSectors(const LogEntry& stcEntry) {
+        return (64 + 32 * (stcEntry.vecData.size() + stcEntry.vecZero.size()) + LOG_SECTOR_SIZE - 1) / LOG_SECTOR_SIZE;
+    }
+    static uint64_t EntryLength(const LogEntry& stcEntry) {
+        return (DescriptorSectors(stcEntry) + stcEntry.vecData.size()) * LOG_SECTOR_SIZE;
+    }
+};
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# 文件名称：gen_gbk_table.py
+# 文件功能：生成GbkTable.cpp（GBK双字节编码到Unicode的映射表）
+#
+# 说明：
+#    Utils::RepairString在所有平台上用这张表把GBK片段转换为UTF-8，不依赖
+#    Windows的代码页936，因此可以在Linux上测试。映射取自Python的gbk编解码器；
+#    gbk中没有的用户自定义区按gb18030映射到私用区（与代码页936相同），
+#    仍无法映射的位置为0，转换时输出U+FFFD。
+#
+# 用法：
+#    python3 Smart-GPU-PV/tools/gen_gbk_table.py > Smart-GPU-PV/Smart-GPU-PV/GbkTable.cpp
+#
+# 作者：Smart-GPU-PV Team
+# 日期：2026-10-16
+# 版本：v2.1
+
+import sys
+
+LEAD_FIRST, LEAD_LAST = 0x81, 0xFE
+TRAIL_FIRST, TRAIL_LAST = 0x40, 0xFE
+
+
+def decode(lead, trail):
+    data = bytes([lead, trail])
+    for codec in ("gbk", "gb18030"):
+        try:
+            text = data.decode(codec)
+        except UnicodeDecodeError:
+            continue
+        if len(text) == 1 and ord(text) <= 0xFFFF:
+            return ord(text)
+    return 0
+
+
+def main():
+    lines = []
+    lines.append("﻿")
+    lines.append("/********************************************************************************\n")
+    lines.append("* 文件名称：GbkTable.cpp\n")
+    lines.append("* 文件功能：GBK双字节编码到Unicode的映射表（由tools/gen_gbk_table.py生成，请勿手工修改）\n")
+    lines.append("*\n")
+    lines.append("* 作者：Smart-GPU-PV Team\n")
+    lines.append("* 日期：2026-10-16\n")
+    lines.append("* 版本：v2.1\n")
+    lines.append("*********************************************************************************/\n")
+    lines.append("\n")
+    lines.append('#include "GbkTable.h"\n')
+    lines.append("\n")
+    lines.append("const uint16_t GBK_TO_UNICODE[GBK_LEAD_COUNT * GBK_TRAIL_COUNT] = {\n")
+    for lead in range(LEAD_FIRST, LEAD_LAST + 1):
+        values = [decode(lead, trail) for trail in range(TRAIL_FIRST, TRAIL_LAST + 1)]
+        lines.append("    // 0x%02X\n" % lead)
+        for i in range(0, len(values), 16):
+            lines.append("    " + " ".join("0x%04X," % v for v in values[i:i + 16]) + "\n")
+    lines.append("};\n")
+    # 仓库中的源文件为UTF-8（带BOM）和CRLF换行
+    sys.stdout.buffer.write("".join(lines).replace("\n", "\r\n").encode("utf-8"))
+
+
+if __name__ == "__main__":
+    main()
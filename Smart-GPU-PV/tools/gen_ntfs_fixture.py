@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+# 文件名称：gen_ntfs_fixture.py
+# 文件功能：用mkntfs和ntfs-3g生成真实的NTFS卷和文件清单，供NtfsVolumeTest比较
+#
+# 说明：
+#    NtfsVolumeTest默认只使用NtfsImageBuilder生成的卷，不需要这个脚本；
+#    设置SMARTGPUPV_NTFS_FIXTURE=<输出目录>时另外读取这里生成的ntfs.img，
+#    按manifest.txt（每行"<CRC32十六进制> <大小> <路径>"）逐个比较文件内容。
+#    卷中包含数百个大小写混合命名的文件（多级$I30索引）、跨多个运行的大文件、
+#    稀疏文件，ntfs-3g支持时还有压缩目录中的文件。
+#    NtfsWriterTest在同一目录写入written.img和written-manifest.txt，--check用
+#    ntfs-3g只读挂载written.img并按清单回读，作为NtfsVolume之外的独立校验。
+#    需要mkntfs（ntfsprogs）、ntfs-3g和挂载权限（通常为root）。
+#
+# 用法：
+#    sudo python3 Smart-GPU-PV/tools/gen_ntfs_fixture.py /tmp/ntfs-fixture
+#    SMARTGPUPV_NTFS_FIXTURE=/tmp/ntfs-fixture ctest --test-dir build -R Ntfs
+#    sudo python3 Smart-GPU-PV/tools/gen_ntfs_fixture.py --check /tmp/ntfs-fixture
+#
+# 作者：Smart-GPU-PV Team
+# 日期：2026-10-16
+# 版本：v2.1
+
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import zlib
+
+VOLUME_SIZE = 64 * 1024 * 1024
+CLUSTER_SIZE = 4096
+
+
+def run(args):
+    subprocess.run(args, check=True, stdout=subprocess.DEVNULL)
+
+
+def write_file(root, path, data, files):
+    full = os.path.join(root, *path.split("\\"))
+    os.makedirs(os.path.dirname(full), exist_ok=True)
+    with open(full, "wb") as f:
+        f.write(data)
+    files.append((path, data))
+
+
+def populate(root, rng):
+    files = []
+    # 1. 多级索引：大小写混合的驱动文件名
+    for i in range(800):
+        name = ("oem%03d.INF" if i % 2 else "Oem%03d_x64.cat") % i
+        write_file(root, "Windows\\System32\\HostDriverStore\\" + name, ("content of %s\n" % name).encode() * (i % 7 + 1), files)
+
+    # 2. 大文件：先交错写入两个文件使运行分散，再删除其中一个后追加
+    big = os.path.join(root, "big.bin")
+    filler = os.path.join(root, "filler.bin")
+    data = bytearray()
+    with open(big, "wb") as b, open(filler, "wb") as f:
+        for _ in range(64):
+            chunk = rng.randbytes(3 * CLUSTER_SIZE + 100)
+            b.write(chunk)
+            b.flush()
+            data += chunk
+            f.write(rng.randbytes(CLUSTER_SIZE))
+            f.flush()
+    os.remove(filler)
+    files.append(("big.bin", bytes(data)))
+
+    # 3. 稀疏文件：中间的空洞不分配簇
+    sparse = os.path.join(root, "sparse.bin")
+    head, tail = rng.randbytes(10000), rng.randbytes(5000)
+    with open(sparse, "wb") as f:
+        f.write(head)
+        f.seek(4 * 1024 * 1024)
+        f.write(tail)
+    files.append(("sparse.bin", head + bytes(4 * 1024 * 1024 - len(head)) + tail))
+
+    # 4. 压缩目录：ntfs-3g以compression选项挂载时新文件继承压缩属性
+    compressed = os.path.join(root, "Compressed")
+    os.makedirs(compressed)
+    try:
+        subprocess.run(["setfattr", "-n", "system.ntfs_attrib_be", "-v", "0x00000800", compressed],
+                       check=True, stderr=subprocess.DEVNULL)
+        text = b"".join(b"DriverVer=10.0.%d\r\n" % (i % 37) for i in range(20000))
+        write_file(root, "Compressed\\text.inf", text, files)
+        write_file(root, "Compressed\\mixed.dll", rng.randbytes(70000) + bytes(70000) + text[:50000], files)
+    except (OSError, subprocess.CalledProcessError):
+        print("ntfs-3g不支持设置压缩属性，跳过压缩文件", file=sys.stderr)
+    return files
+
+
+def check(out_dir):
+    image = os.path.join(out_dir, "written.img")
+    if shutil.which("ntfsfix") is not None:
+        result = subprocess.run(["ntfsfix", "-n", image], capture_output=True, text=True)
+        if result.returncode != 0:
+            print("ntfsfix报告错误：\n" + result.stdout + result.stderr, file=sys.stderr)
+            return 1
+    mount_point = tempfile.mkdtemp(prefix="sgp-ntfs-")
+    mismatches = 0
+    count = 0
+    try:
+        run(["ntfs-3g", "-o", "ro", image, mount_point])
+        try:
+            with open(os.path.join(out_dir, "written-manifest.txt"), encoding="utf-8") as f:
+                for line in f:
+                    crc, size, path = line.rstrip("\n").split(" ", 2)
+                    with open(os.path.join(mount_point, *path.split("\\")), "rb") as g:
+                        data = g.read()
+                    count += 1
+                    if len(data) != int(size) or "%08x" % (zlib.crc32(data) & 0xFFFFFFFF) != crc:
+                        print("内容不一致：" + path, file=sys.stderr)
+                        mismatches += 1
+        finally:
+            run(["umount", mount_point])
+    finally:
+        os.rmdir(mount_point)
+    print("%s：%d个文件，%d个不一致" % (image, count, mismatches))
+    return 1 if mismatches else 0
+
+
+def main():
+    if len(sys.argv) == 3 and sys.argv[1] == "--check":
+        return check(sys.argv[2])
+    if len(sys.argv) != 2:
+        print("用法：gen_ntfs_fixture.py [--check] <输出目录>", file=sys.stderr)
+        return 2
+    for tool in ("mkntfs", "ntfs-3g"):
+        if shutil.which(tool) is None:
+            print("找不到%s（需要安装ntfs-3g/ntfsprogs）" % tool, file=sys.stderr)
+            return 1
+    out_dir = sys.argv[1]
+    os.makedirs(out_dir, exist_ok=True)
+    image = os.path.join(out_dir, "ntfs.img")
+    with open(image, "wb") as f:
+        f.truncate(VOLUME_SIZE)
+    run(["mkntfs", "-F", "-f", "-q", "-c", str(CLUSTER_SIZE), "-L", "fixture", image])
+
+    mount_point = tempfile.mkdtemp(prefix="sgp-ntfs-")
+    try:
+        run(["ntfs-3g", "-o", "compression", image, mount_point])
+        try:
+            files = populate(mount_point, random.Random(20))
+        finally:
+            run(["umount", mount_point])
+    finally:
+        os.rmdir(mount_point)
+
+    with open(os.path.join(out_dir, "manifest.txt"), "w", encoding="utf-8", newline="\n") as f:
+        for path, data in files:
+            f.write("%08x %d %s\n" % (zlib.crc32(data) & 0xFFFFFFFF, len(data), path))
+    print("%s：%d个文件" % (image, len(files)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())